@@ -0,0 +1,268 @@
+#include "CoherentCuller.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	// Spreads the low 10 bits of v out to every third bit, for Morton codes.
+	UINT Part1By2(UINT v)
+	{
+		v &= 0x000003ff;
+		v = (v ^ (v << 16)) & 0xff0000ff;
+		v = (v ^ (v << 8)) & 0x0300f00f;
+		v = (v ^ (v << 4)) & 0x030c30c3;
+		v = (v ^ (v << 2)) & 0x09249249;
+		return v;
+	}
+
+	const XMFLOAT3& Element(const XMFLOAT3* first, UINT stride, UINT i)
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const char*>(first) + (size_t)i*stride);
+	}
+
+	float Distance(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		float dx = a.x - b.x;
+		float dy = a.y - b.y;
+		float dz = a.z - b.z;
+		return sqrtf(dx*dx + dy*dy + dz*dz);
+	}
+}
+
+CoherentCuller::CoherentCuller()
+{
+	mStats = Stats();
+}
+
+void CoherentCuller::Reset(const XMFLOAT3* centers, const XMFLOAT3* extents, UINT stride, UINT count, UINT groupSize)
+{
+	mBoxes.resize(count);
+	mIndices.resize(count);
+	mRejectingPlane.assign(count, (BYTE)NoPlane);
+	mGroups.clear();
+	mStats = Stats();
+
+	if( count == 0 )
+		return;
+
+	//
+	// Order the instances along a Morton curve through their centers, so that
+	// runs of groupSize of them are compact clusters.
+	//
+
+	XMFLOAT3 lo = Element(centers, stride, 0);
+	XMFLOAT3 hi = lo;
+	for(UINT i = 1; i < count; ++i)
+	{
+		const XMFLOAT3& c = Element(centers, stride, i);
+		lo = XMFLOAT3(std::min(lo.x, c.x), std::min(lo.y, c.y), std::min(lo.z, c.z));
+		hi = XMFLOAT3(std::max(hi.x, c.x), std::max(hi.y, c.y), std::max(hi.z, c.z));
+	}
+
+	float scaleX = hi.x > lo.x ? 1023.0f / (hi.x - lo.x) : 0.0f;
+	float scaleY = hi.y > lo.y ? 1023.0f / (hi.y - lo.y) : 0.0f;
+	float scaleZ = hi.z > lo.z ? 1023.0f / (hi.z - lo.z) : 0.0f;
+
+	std::vector<std::pair<UINT, UINT>> keys(count);
+	for(UINT i = 0; i < count; ++i)
+	{
+		const XMFLOAT3& c = Element(centers, stride, i);
+		UINT x = (UINT)((c.x - lo.x)*scaleX);
+		UINT y = (UINT)((c.y - lo.y)*scaleY);
+		UINT z = (UINT)((c.z - lo.z)*scaleZ);
+		keys[i] = std::make_pair(Part1By2(x) | (Part1By2(y) << 1) | (Part1By2(z) << 2), i);
+	}
+	std::sort(keys.begin(), keys.end());
+
+	for(UINT k = 0; k < count; ++k)
+	{
+		UINT i = keys[k].second;
+		mBoxes[k].Center = Element(centers, stride, i);
+		mBoxes[k].Extents = Element(extents, stride, i);
+		mIndices[k] = i;
+	}
+
+	//
+	// Cut the curve into groups.
+	//
+
+	groupSize = std::max(groupSize, 1u);
+	for(UINT first = 0; first < count; first += groupSize)
+	{
+		Group group;
+		group.First = first;
+		group.Count = std::min(groupSize, count - first);
+
+		XMVECTOR vMin = XMVectorReplicate(+FLT_MAX);
+		XMVECTOR vMax = XMVectorReplicate(-FLT_MAX);
+		for(UINT k = first; k < first + group.Count; ++k)
+		{
+			XMVECTOR c = XMLoadFloat3(&mBoxes[k].Center);
+			XMVECTOR e = XMLoadFloat3(&mBoxes[k].Extents);
+			vMin = XMVectorMin(vMin, c - e);
+			vMax = XMVectorMax(vMax, c + e);
+		}
+
+		XMStoreFloat3(&group.Bounds.Center, 0.5f*(vMin + vMax));
+		XMStoreFloat3(&group.Bounds.Extents, 0.5f*(vMax - vMin));
+		group.Radius = XMVectorGetX(XMVector3Length(0.5f*(vMax - vMin)));
+
+		group.State = Unknown;
+		group.Margin = 0.0f;
+		group.Eye = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		group.Orientation = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+
+		mGroups.push_back(group);
+	}
+}
+
+void CoherentCuller::Invalidate()
+{
+	for(size_t g = 0; g < mGroups.size(); ++g)
+		mGroups[g].State = Unknown;
+}
+
+void CoherentCuller::Cull(const XMVECTOR* planes, FXMVECTOR eye, FXMVECTOR orientation, std::vector<UINT>& visible)
+{
+	mStats = Stats();
+
+	XMFLOAT4 p[6];
+	for(UINT i = 0; i < 6; ++i)
+		XMStoreFloat4(&p[i], planes[i]);
+
+	XMFLOAT3 e;
+	XMFLOAT4 q;
+	XMStoreFloat3(&e, eye);
+	XMStoreFloat4(&q, orientation);
+
+	for(size_t g = 0; g < mGroups.size(); ++g)
+	{
+		Group& group = mGroups[g];
+
+		if( group.State == Outside || group.State == Inside )
+		{
+			// Since the group was tested, the planes have turned with the camera
+			// and followed the eye.  Turning through an angle a moves a unit
+			// normal by 2 sin(a/2), which is the length of the vector part of
+			// the quaternion between the two orientations, so no point of the
+			// group has moved relative to a plane by more than this.
+			XMVECTOR turn = XMQuaternionMultiply(orientation, XMQuaternionConjugate(XMLoadFloat4(&group.Orientation)));
+			float reach = Distance(group.Bounds.Center, group.Eye) + group.Radius;
+			float move = 2.0f*XMVectorGetX(XMVector3Length(turn))*reach + Distance(e, group.Eye);
+
+			if( move < group.Margin )
+			{
+				++mStats.GroupsSkipped;
+
+				if( group.State == Inside )
+				{
+					for(UINT k = group.First; k < group.First + group.Count; ++k)
+						visible.push_back(mIndices[k]);
+				}
+				continue;
+			}
+		}
+
+		++mStats.GroupsTested;
+
+		group.Eye = e;
+		group.Orientation = q;
+		TestGroup(group, p, visible);
+	}
+}
+
+void CoherentCuller::TestGroup(Group& group, const XMFLOAT4* planes, std::vector<UINT>& visible)
+{
+	//
+	// The group as a whole: how far it is outside the plane it is farthest
+	// outside of, or inside the plane it is nearest to.
+	//
+
+	float outside = -FLT_MAX;
+	float inside = FLT_MAX;
+
+	const Box& bounds = group.Bounds;
+	for(UINT i = 0; i < 6; ++i)
+	{
+		const XMFLOAT4& p = planes[i];
+		float dist = bounds.Center.x*p.x + bounds.Center.y*p.y + bounds.Center.z*p.z + p.w;
+		float radius = bounds.Extents.x*fabsf(p.x) + bounds.Extents.y*fabsf(p.y) + bounds.Extents.z*fabsf(p.z);
+
+		outside = std::max(outside, dist - radius);
+		inside = std::min(inside, -dist - radius);
+	}
+	mStats.PlaneTests += 6;
+
+	if( outside > 0.0f )
+	{
+		group.State = Outside;
+		group.Margin = outside;
+		return;
+	}
+
+	if( inside >= 0.0f )
+	{
+		group.State = Inside;
+		group.Margin = inside;
+
+		for(UINT k = group.First; k < group.First + group.Count; ++k)
+			visible.push_back(mIndices[k]);
+		return;
+	}
+
+	//
+	// The group straddles the frustum; test its instances.
+	//
+
+	group.State = Straddling;
+
+	for(UINT k = group.First; k < group.First + group.Count; ++k)
+	{
+		const Box& box = mBoxes[k];
+		BYTE cached = mRejectingPlane[k];
+
+		++mStats.InstancesTested;
+
+		BYTE rejecting = NoPlane;
+		for(UINT n = 0; n < 7 && rejecting == NoPlane; ++n)
+		{
+			// The cached plane first, then the others in order.
+			UINT i;
+			if( n == 0 )
+			{
+				if( cached == NoPlane )
+					continue;
+				i = cached;
+			}
+			else
+			{
+				i = n - 1;
+				if( i == cached )
+					continue;
+			}
+
+			const XMFLOAT4& p = planes[i];
+			float dist = box.Center.x*p.x + box.Center.y*p.y + box.Center.z*p.z + p.w;
+			float radius = box.Extents.x*fabsf(p.x) + box.Extents.y*fabsf(p.y) + box.Extents.z*fabsf(p.z);
+
+			++mStats.PlaneTests;
+
+			if( dist > radius )
+				rejecting = (BYTE)i;
+
+			if( n == 0 )
+			{
+				if( rejecting != NoPlane )
+					++mStats.PlaneCacheHits;
+				else
+					++mStats.PlaneCacheMisses;
+			}
+		}
+
+		mRejectingPlane[k] = rejecting;
+
+		if( rejecting == NoPlane )
+			visible.push_back(mIndices[k]);
+	}
+}
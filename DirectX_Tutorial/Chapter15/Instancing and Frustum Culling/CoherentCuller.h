@@ -0,0 +1,113 @@
+#pragma once
+
+#include <Windows.h>
+#include <directxmath.h>
+#include <vector>
+
+using namespace DirectX;
+
+///<summary>
+/// Frustum culling of static instances that makes use of how little the
+/// camera moves from one frame to the next.
+///
+/// The instances are split into groups of nearby instances.  When a group is
+/// wholly inside or wholly outside the frustum, the culler keeps that result
+/// together with how far the frustum planes could move before it might change.
+/// Until the camera has moved or turned that much, the group is not tested
+/// again.  Groups that straddle the frustum test their instances one by one,
+/// each trying first the plane that rejected it last time.
+///
+/// The frustum must keep its shape between calls; call Invalidate after the
+/// projection changes.
+///</summary>
+class CoherentCuller
+{
+public:
+	// Counts for the last call to Cull.
+	struct Stats
+	{
+		// Groups whose last result still held, and groups that were tested.
+		UINT GroupsSkipped;
+		UINT GroupsTested;
+
+		// Instances of straddling groups tested one by one.
+		UINT InstancesTested;
+
+		// Of those rejected last time they were tested, the ones the same plane
+		// rejected again first try, and the ones it did not.
+		UINT PlaneCacheHits;
+		UINT PlaneCacheMisses;
+
+		// Box against plane tests, of groups and instances.
+		UINT PlaneTests;
+	};
+
+public:
+	CoherentCuller();
+
+	// Takes the world space boxes of the instances: the center and extents of
+	// instance i are read from (const char*)centers + i*stride and
+	// (const char*)extents + i*stride.  Groups are formed of groupSize
+	// instances each.
+	void Reset(const XMFLOAT3* centers, const XMFLOAT3* extents, UINT stride, UINT count, UINT groupSize = 64);
+
+	// Forgets every cached result.
+	void Invalidate();
+
+	// Appends the indices of the instances outside none of the planes to
+	// visible.  The planes (a, b, c, d) are normalized, with the outside on the
+	// positive side, as from ComputePlanesFromFrustum for a frustum at eye
+	// with the given orientation.
+	void Cull(const XMVECTOR* planes, FXMVECTOR eye, FXMVECTOR orientation, std::vector<UINT>& visible);
+
+	const Stats& GetStats()const { return mStats; }
+
+private:
+	enum GroupState
+	{
+		Unknown,
+		Outside,
+		Inside,
+		Straddling
+	};
+
+	struct Box
+	{
+		XMFLOAT3 Center;
+		XMFLOAT3 Extents;
+	};
+
+	struct Group
+	{
+		// Bounds of the instances of the group.
+		Box Bounds;
+		float Radius;
+
+		// Instances [First, First + Count) of mBoxes.
+		UINT First;
+		UINT Count;
+
+		// Last result, and the camera it was found for.  It holds while no
+		// point of the group has moved more than Margin relative to the planes.
+		GroupState State;
+		float Margin;
+		XMFLOAT3 Eye;
+		XMFLOAT4 Orientation;
+	};
+
+	static const BYTE NoPlane = 0xff;
+
+	void TestGroup(Group& group, const XMFLOAT4* planes, std::vector<UINT>& visible);
+
+private:
+	// Instances in group order, with their index as given to Reset.
+	std::vector<Box> mBoxes;
+	std::vector<UINT> mIndices;
+
+	// The plane that last rejected each instance, or NoPlane.
+	std::vector<BYTE> mRejectingPlane;
+
+	std::vector<Group> mGroups;
+
+	Stats mStats;
+};
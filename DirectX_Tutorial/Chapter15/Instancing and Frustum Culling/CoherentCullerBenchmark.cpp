@@ -0,0 +1,204 @@
+//***************************************************************************************
+// CoherentCullerBenchmark.cpp
+//
+// Headless benchmark of CoherentCuller against the flat loop, which tests the
+// world space box of every instance against the six planes of the frustum.
+// Skull sized instances sit on an n*n*n grid, ten units apart, and a scripted
+// camera flies around it: it orbits slowly while zooming in and out, stops
+// for a while, and now and then cuts to a new heading.  For every grid size it
+// reports
+//   -the average time of a frame for the flat loop and the coherent culler,
+//   -the share of groups whose result was reused rather than retested,
+//   -the share of rejected instances whose cached plane rejected them again,
+//   -the box against plane tests the coherent culler made per frame.
+// Every frame the culler must return exactly the instances the flat loop
+// finds.  Returns 1 if any frame differs.
+//
+// Build with:
+//   cl /EHsc /O2 CoherentCuller.cpp CoherentCullerBenchmark.cpp
+//
+// Usage: CoherentCullerBenchmark [n ...]      (default 5 20 50 100)
+//***************************************************************************************
+
+#include "CoherentCuller.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	const UINT FrameCount = 600;
+
+	struct Box
+	{
+		XMFLOAT3 Center;
+		XMFLOAT3 Extents;
+	};
+
+	struct Planes
+	{
+		XMVECTOR P[6];
+	};
+
+	// The planes ComputePlanesFromFrustum makes for a camera at eye looking
+	// along +z rotated by q, with a 45 degree field of view.
+	Planes MakeFrustum(FXMVECTOR eye, FXMVECTOR q)
+	{
+		float top = tanf(0.125f*XM_PI);
+		float right = top*800.0f/600.0f;
+		float nearZ = 1.0f;
+		float farZ = 1000.0f;
+
+		Planes planes;
+		planes.P[0] = XMVectorSet(0.0f, 0.0f, -1.0f, nearZ);
+		planes.P[1] = XMVectorSet(0.0f, 0.0f, 1.0f, -farZ);
+		planes.P[2] = XMVectorSet(1.0f, 0.0f, -right, 0.0f);
+		planes.P[3] = XMVectorSet(-1.0f, 0.0f, -right, 0.0f);
+		planes.P[4] = XMVectorSet(0.0f, 1.0f, -top, 0.0f);
+		planes.P[5] = XMVectorSet(0.0f, -1.0f, -top, 0.0f);
+
+		for(UINT i = 0; i < 6; ++i)
+		{
+			XMVECTOR normal = XMVector3Rotate(planes.P[i], q);
+			float d = XMVectorGetW(planes.P[i]) - XMVectorGetX(XMVector3Dot(normal, eye));
+			planes.P[i] = XMPlaneNormalize(XMVectorSetW(normal, d));
+		}
+		return planes;
+	}
+
+	// The camera of frame f, circling a grid of the given side centered on
+	// the origin.
+	void CameraPath(UINT f, float side, XMVECTOR& eye, XMVECTOR& q)
+	{
+		// Stand still for frames [200, 300).
+		float t = (float)(f < 200 ? f : f < 300 ? 200 : f - 100);
+
+		// A quarter turn over the path, with a cut every 150 frames.
+		float yaw = 0.5f*XM_PI*t/FrameCount + 1.3f*(f / 150);
+		float pitch = 0.35f + 0.1f*sinf(0.02f*t);
+		float distance = side*(0.7f + 0.3f*sinf(0.01f*t));
+
+		XMVECTOR qPitch = XMVectorSet(sinf(0.5f*pitch), 0.0f, 0.0f, cosf(0.5f*pitch));
+		XMVECTOR qYaw = XMVectorSet(0.0f, sinf(0.5f*yaw), 0.0f, cosf(0.5f*yaw));
+		q = XMQuaternionMultiply(qPitch, qYaw);
+
+		XMVECTOR forward = XMVector3Rotate(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), q);
+		eye = -distance*forward;
+	}
+
+	void FlatFrustum(const std::vector<Box>& boxes, const Planes& planes, std::vector<UINT>& ids)
+	{
+		XMFLOAT4 p[6];
+		for(UINT i = 0; i < 6; ++i)
+			XMStoreFloat4(&p[i], planes.P[i]);
+
+		for(UINT id = 0; id < (UINT)boxes.size(); ++id)
+		{
+			const Box& b = boxes[id];
+			bool outside = false;
+			for(UINT i = 0; i < 6 && !outside; ++i)
+			{
+				float dist = b.Center.x*p[i].x + b.Center.y*p[i].y + b.Center.z*p[i].z + p[i].w;
+				float radius = b.Extents.x*fabsf(p[i].x) + b.Extents.y*fabsf(p[i].y) + b.Extents.z*fabsf(p[i].z);
+				outside = dist > radius;
+			}
+			if( !outside )
+				ids.push_back(id);
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<UINT> sizes;
+	for(int i = 1; i < argc; ++i)
+		sizes.push_back((UINT)std::max(1, atoi(argv[i])));
+	if( sizes.empty() )
+	{
+		sizes.push_back(5);
+		sizes.push_back(20);
+		sizes.push_back(50);
+		sizes.push_back(100);
+	}
+
+	printf("%-10s %7s %9s %9s %12s %8s %9s %10s %14s %8s\n", "instances", "groups", "visible", "flat ms",
+		"coherent ms", "speedup", "skipped", "cache hit", "plane tests", "mismatch");
+
+	bool passed = true;
+
+	for(size_t s = 0; s < sizes.size(); ++s)
+	{
+		UINT n = sizes[s];
+		UINT count = n*n*n;
+		float side = 10.0f*n;
+
+		std::vector<Box> boxes(count);
+		for(UINT i = 0; i < count; ++i)
+		{
+			Box& b = boxes[i];
+			b.Center = XMFLOAT3(10.0f*(i % n) - 0.5f*side, 10.0f*((i / n) % n) - 0.5f*side, 10.0f*(i / (n*n)) - 0.5f*side);
+			b.Extents = XMFLOAT3(3.2f, 3.9f, 3.6f);
+		}
+
+		CoherentCuller culler;
+		culler.Reset(&boxes[0].Center, &boxes[0].Extents, sizeof(Box), count);
+
+		std::vector<UINT> a, b;
+		a.reserve(count);
+		b.reserve(count);
+
+		double flatTime = 0.0;
+		double coherentTime = 0.0;
+		size_t visible = 0;
+		double skipped = 0.0, groups = 0.0, hits = 0.0, rejected = 0.0, planeTests = 0.0;
+		UINT mismatches = 0;
+
+		for(UINT f = 0; f < FrameCount; ++f)
+		{
+			XMVECTOR eye, q;
+			CameraPath(f, side, eye, q);
+			Planes planes = MakeFrustum(eye, q);
+
+			b.clear();
+			double start = Now();
+			FlatFrustum(boxes, planes, b);
+			flatTime += Now() - start;
+
+			a.clear();
+			start = Now();
+			culler.Cull(planes.P, eye, q, a);
+			coherentTime += Now() - start;
+
+			const CoherentCuller::Stats& stats = culler.GetStats();
+			skipped += stats.GroupsSkipped;
+			groups += stats.GroupsSkipped + stats.GroupsTested;
+			hits += stats.PlaneCacheHits;
+			rejected += stats.PlaneCacheHits + stats.PlaneCacheMisses;
+			planeTests += stats.PlaneTests;
+			visible += b.size();
+
+			std::sort(a.begin(), a.end());
+			if( a != b )
+				++mismatches;
+		}
+
+		printf("%-10u %7.0f %9u %9.3f %12.3f %8.1f %8.1f%% %9.1f%% %14.0f %8u\n", count, groups/FrameCount,
+			(UINT)(visible / FrameCount), flatTime*1000.0/FrameCount, coherentTime*1000.0/FrameCount,
+			flatTime/coherentTime, 100.0*skipped/groups, rejected > 0.0 ? 100.0*hits/rejected : 0.0,
+			planeTests/FrameCount, mismatches);
+
+		if( mismatches > 0 )
+			passed = false;
+	}
+
+	printf("\n%s\n", passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
@@ -9,7 +9,11 @@
 	#include "MathHelper.h"
 	#include "LightHelper.h"
 	#include "Effects.h"
+	#include "LooseOctree.h"
+	#include "CoherentCuller.h"
 	#include "Windows.h"
+	#include "../../Common/JobSystem.h"
+	#include "../../Common/MeshSimplifier.h"
 
 	using namespace DirectX;
 
@@ -22,13 +26,6 @@
 		XMFLOAT3 Extents;           // Distance from the center to each side.
 	};
 
-	struct OrientedBox
-	{
-		XMFLOAT3 Center;            // Center of the box.
-		XMFLOAT3 Extents;           // Distance from the center to each side.
-		XMFLOAT4 Orientation;       // Unit quaternion representing rotation (box -> world).
-	};
-
 	struct Frustum
 	{
 		XMFLOAT3 Origin;            // Origin of the frustum (and projection).
@@ -54,8 +51,21 @@
 	XMFLOAT4X4		g_SkullWorld;
 	AxisAlignedBox  g_SkullBox;
 
+	// Levels of detail of the skull, one after another in g_SkullIndexBuffer, each
+	// with a quarter of the triangles of the one before.  The instances drawn with
+	// each level this frame lie together in g_SkullInstancedBuffer.
+	const UINT SkullLodCount = 4;
+	std::vector<MeshLod> g_SkullLods;
+	UINT g_LodInstanceStart[SkullLodCount];
+	UINT g_LodInstanceCount[SkullLodCount];
+	std::vector<UINT> g_InstanceLods;
+	bool bUseLod = true;
+
 	CModelViewerCamera			g_Camera;
 	Frustum						g_CameraFrustum;
+	float						g_CameraFovY;
+	float						g_CameraNearZ;
+	float						g_ViewportHeight;
 
 	std::vector <InstancedData> g_InstancedData;
 
@@ -63,7 +73,20 @@
 	Material			g_SkullMaterial;
 
 	bool bUseFrustumCulling = true;
+	enum CullingMethod
+	{
+		CullWithOctree,		// through the loose octree
+		CullAllInstances,	// every instance, on all cores
+		CullCoherently		// reusing last frame's results where the camera allows
+	};
+	CullingMethod g_CullingMethod = CullWithOctree;
 	UINT g_VisibleObjectCount;
+	std::vector<AxisAlignedBox> g_InstanceBounds;	// world space bounds of each instance
+	std::vector<UINT> g_VisibleInstances;
+	LooseOctree g_InstanceTree;
+	CoherentCuller g_CoherentCuller;
+
+	JobSystem* g_JobSystem;
 	std::wstring mMainWndCaption;
 		
 	//--------------------------------------------------------------------------------------
@@ -122,6 +145,18 @@
 
 		fin.close();
 
+		if (vcount == 0 || icount == 0)
+			return;
+
+		// Most of the skulls are far from the camera; build coarser levels that
+		// draw from the same vertices.
+		std::vector<UINT> lodIndices;
+		g_SkullLods.clear();
+		MeshSimplifier::BuildLodChain(&vertices[0].Pos.x, vcount, sizeof(Vertex::Basic32), &indices[0],
+			g_SkullIndexCount, SkullLodCount, 0.25f, lodIndices, g_SkullLods);
+		if (lodIndices.empty())
+			return;
+
 		D3D11_BUFFER_DESC vbd;
 		vbd.ByteWidth = sizeof(Vertex::Basic32) * vcount;
 		vbd.Usage = D3D11_USAGE_IMMUTABLE;
@@ -133,16 +168,32 @@
 		HRESULT hr = pd3dDevice->CreateBuffer(&vbd, &vInitData, &g_SkullVetexBuffer);
 
 		D3D11_BUFFER_DESC ibd;
-		ibd.ByteWidth = sizeof(UINT) * g_SkullIndexCount;
+		ibd.ByteWidth = sizeof(UINT) * lodIndices.size();
 		ibd.Usage = D3D11_USAGE_IMMUTABLE;
 		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 		ibd.CPUAccessFlags = 0;
 		ibd.MiscFlags = 0;
 		D3D11_SUBRESOURCE_DATA iInitData;
-		iInitData.pSysMem = &indices[0];
+		iInitData.pSysMem = &lodIndices[0];
 		hr = pd3dDevice->CreateBuffer(&ibd, &iInitData, &g_SkullIndexBuffer);
 	}
 
+	// World space bounds of a box placed by a world matrix: the center is moved
+	// and the extents become those of the transformed axes.
+	AxisAlignedBox TransformAxisAlignedBox(const AxisAlignedBox& box, FXMMATRIX world)
+	{
+		XMVECTOR extents = XMLoadFloat3(&box.Extents);
+
+		XMVECTOR worldExtents = XMVectorAbs(world.r[0]) * XMVectorSplatX(extents) +
+			XMVectorAbs(world.r[1]) * XMVectorSplatY(extents) +
+			XMVectorAbs(world.r[2]) * XMVectorSplatZ(extents);
+
+		AxisAlignedBox out;
+		XMStoreFloat3(&out.Center, XMVector3TransformCoord(XMLoadFloat3(&box.Center), world));
+		XMStoreFloat3(&out.Extents, worldExtents);
+		return out;
+	}
+
 	void BuildInstancedBuffer(ID3D11Device* pd3dDevice)
 	{
 		const int n = 5;
@@ -183,6 +234,41 @@
 			}
 		}
 
+		// The instances do not move, so their world space bounds are computed once
+		// and culled against the world space frustum every frame.
+		g_InstanceBounds.resize(g_InstancedData.size());
+		g_VisibleInstances.resize(g_InstancedData.size());
+		g_InstanceLods.resize(g_InstancedData.size());
+		for (UINT i = 0; i < g_InstancedData.size(); i++)
+			g_InstanceBounds[i] = TransformAxisAlignedBox(g_SkullBox, XMLoadFloat4x4(&g_InstancedData[i].World));
+
+		// The octree covers the cube around all the instances, deep enough that
+		// its smallest cells hold about eight of them.
+		XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+		XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+		for (UINT i = 0; i < g_InstanceBounds.size(); i++)
+		{
+			XMVECTOR C = XMLoadFloat3(&g_InstanceBounds[i].Center);
+			vMin = XMVectorMin(vMin, C);
+			vMax = XMVectorMax(vMax, C);
+		}
+
+		XMFLOAT3 center;
+		XMFLOAT3 halfSize;
+		XMStoreFloat3(&center, 0.5f * (vMin + vMax));
+		XMStoreFloat3(&halfSize, 0.5f * (vMax - vMin));
+
+		UINT depth = 1;
+		while (depth < 9 && (8u << (3 * depth)) < g_InstanceBounds.size())
+			++depth;
+
+		g_InstanceTree.Reset(center, MathHelper::Max(halfSize.x, MathHelper::Max(halfSize.y, halfSize.z)), depth);
+		for (UINT i = 0; i < g_InstanceBounds.size(); i++)
+			g_InstanceTree.Insert(i, g_InstanceBounds[i].Center, g_InstanceBounds[i].Extents);
+
+		g_CoherentCuller.Reset(&g_InstanceBounds[0].Center, &g_InstanceBounds[0].Extents, sizeof(AxisAlignedBox),
+			(UINT)g_InstanceBounds.size());
+
 
 		D3D11_BUFFER_DESC vbd;
 		vbd.ByteWidth = sizeof(InstancedData) * g_InstancedData.size();
@@ -195,6 +281,52 @@
 		HRESULT hr = pd3dDevice->CreateBuffer(&vbd, 0, &g_SkullInstancedBuffer);
 	}
 
+	// Writes the instances to the instance buffer grouped by the level of detail
+	// each is drawn with: the coarsest whose error covers at most a pixel of the
+	// screen at the point of its bounds nearest the eye.
+	void WriteInstancesByLod(ID3D11DeviceContext* pd3dImmediateContext, const std::vector<UINT>& instances, UINT count)
+	{
+		XMVECTOR eyePos = g_Camera.GetEyePt();
+
+		for (UINT lod = 0; lod < SkullLodCount; lod++)
+			g_LodInstanceCount[lod] = 0;
+
+		for (UINT i = 0; i < count; i++)
+		{
+			const AxisAlignedBox& bounds = g_InstanceBounds[instances[i]];
+			float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+			float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Center) - eyePos)) - radius;
+
+			float pixelsPerUnit = MeshSimplifier::PixelsPerUnit(MathHelper::Max(distance, g_CameraNearZ),
+				g_CameraFovY, g_ViewportHeight);
+			UINT lod = (bUseLod && !g_SkullLods.empty()) ? MeshSimplifier::SelectLod(&g_SkullLods[0], (UINT)g_SkullLods.size(), pixelsPerUnit) : 0;
+
+			g_InstanceLods[i] = lod;
+			g_LodInstanceCount[lod]++;
+		}
+
+		UINT start = 0;
+		for (UINT lod = 0; lod < SkullLodCount; lod++)
+		{
+			g_LodInstanceStart[lod] = start;
+			start += g_LodInstanceCount[lod];
+		}
+
+		D3D11_MAPPED_SUBRESOURCE mappedData;
+		pd3dImmediateContext->Map(g_SkullInstancedBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData);
+
+		InstancedData* dataView = reinterpret_cast<InstancedData*>(mappedData.pData);
+
+		UINT next[SkullLodCount];
+		for (UINT lod = 0; lod < SkullLodCount; lod++)
+			next[lod] = g_LodInstanceStart[lod];
+
+		for (UINT i = 0; i < count; i++)
+			dataView[next[g_InstanceLods[i]]++] = g_InstancedData[instances[i]];
+
+		pd3dImmediateContext->Unmap(g_SkullInstancedBuffer, 0);
+	}
+
 	void BuildLighting()
 	{
 		g_DirectionLight[0].Ambient = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
@@ -301,242 +433,157 @@
 		return;
 	}
 
-	static const XMVECTOR g_UnitQuaternionEpsilon =
-	{
-		1.0e-4f, 1.0e-4f, 1.0e-4f, 1.0e-4f
-	};
-	static const XMVECTOR g_UnitVectorEpsilon =
+	static inline XMVECTOR TransformPlane(FXMVECTOR Plane, FXMVECTOR Rotation, FXMVECTOR Translation)
 	{
-		1.0e-4f, 1.0e-4f, 1.0e-4f, 1.0e-4f
-	};
-	static const XMVECTOR g_UnitPlaneEpsilon =
-	{
-		1.0e-4f, 1.0e-4f, 1.0e-4f, 1.0e-4f
-	};
+		XMVECTOR Normal = XMVector3Rotate(Plane, Rotation);
+		XMVECTOR D = XMVectorSplatW(Plane) - XMVector3Dot(Normal, Translation);
 
-	static inline BOOL XMQuaternionIsUnit(FXMVECTOR Q)
-	{
-		XMVECTOR Difference = XMVector4Length(Q) - XMVectorSplatOne();
-
-		return XMVector4Less(XMVectorAbs(Difference), g_UnitQuaternionEpsilon);
+		return XMVectorInsert(Normal, D, 0, 0, 0, 0, 1);
 	}
 
-	static inline BOOL XMVector3AnyTrue(FXMVECTOR V)
+	void ComputePlanesFromFrustum(const Frustum* pVolume, XMVECTOR* pPlanes)
 	{
-		XMVECTOR C;
+		// Load origin and orientation of the frustum.
+		XMVECTOR Origin = XMLoadFloat3(&pVolume->Origin);
+		XMVECTOR Orientation = XMLoadFloat4(&pVolume->Orientation);
 
-		// Duplicate the fourth element from the first element.
-		C = XMVectorSwizzle(V, 0, 1, 2, 0);
+		// Build the frustum planes.
+		pPlanes[0] = XMVectorSet(0.0f, 0.0f, -1.0f, pVolume->Near);
+		pPlanes[1] = XMVectorSet(0.0f, 0.0f, 1.0f, -pVolume->Far);
+		pPlanes[2] = XMVectorSet(1.0f, 0.0f, -pVolume->RightSlope, 0.0f);
+		pPlanes[3] = XMVectorSet(-1.0f, 0.0f, pVolume->LeftSlope, 0.0f);
+		pPlanes[4] = XMVectorSet(0.0f, 1.0f, -pVolume->TopSlope, 0.0f);
+		pPlanes[5] = XMVectorSet(0.0f, -1.0f, pVolume->BottomSlope, 0.0f);
 
-		return XMComparisonAnyTrue(XMVector4EqualIntR(C, XMVectorTrueInt()));
+		for (INT i = 0; i < 6; i++)
+			pPlanes[i] = XMPlaneNormalize(TransformPlane(pPlanes[i], Orientation, Origin));
 	}
 
-	int IntersectOrientedBoxFrustum(const OrientedBox* pVolumeA, const Frustum* pVolumeB)
+	//
+	// Batch frustum culling, as CullAxisAlignedBoxes in Common/xnacollision.cpp.
+	// The planes of the world space frustum are built once a frame and tested
+	// against four world space boxes at a time, instead of moving the frustum
+	// into the local space of every instance.
+	//
+	struct CullPlanes
 	{
-		static const XMVECTORI32 SelectY =
-		{
-			XM_SELECT_0, XM_SELECT_1, XM_SELECT_0, XM_SELECT_0
-		};
-		static const XMVECTORI32 SelectZ =
-		{
-			XM_SELECT_0, XM_SELECT_0, XM_SELECT_1, XM_SELECT_0
-		};
-
-		XMVECTOR Zero = XMVectorZero();
+		XMVECTOR Nx[6], Ny[6], Nz[6], D[6];
+		XMVECTOR AbsNx[6], AbsNy[6], AbsNz[6];
+	};
 
-		// Build the frustum planes.
-		XMVECTOR Planes[6];
-		Planes[0] = XMVectorSet(0.0f, 0.0f, -1.0f, pVolumeB->Near);
-		Planes[1] = XMVectorSet(0.0f, 0.0f, 1.0f, -pVolumeB->Far);
-		Planes[2] = XMVectorSet(1.0f, 0.0f, -pVolumeB->RightSlope, 0.0f);
-		Planes[3] = XMVectorSet(-1.0f, 0.0f, pVolumeB->LeftSlope, 0.0f);
-		Planes[4] = XMVectorSet(0.0f, 1.0f, -pVolumeB->TopSlope, 0.0f);
-		Planes[5] = XMVectorSet(0.0f, -1.0f, pVolumeB->BottomSlope, 0.0f);
+	// Returns a bit for each of the four boxes that is outside a plane.
+	UINT CullAxisAlignedBoxes4(const CullPlanes& planes, const AxisAlignedBox* pVolumes)
+	{
+		XMMATRIX Center(XMLoadFloat3(&pVolumes[0].Center), XMLoadFloat3(&pVolumes[1].Center),
+			XMLoadFloat3(&pVolumes[2].Center), XMLoadFloat3(&pVolumes[3].Center));
+		XMMATRIX Extents(XMLoadFloat3(&pVolumes[0].Extents), XMLoadFloat3(&pVolumes[1].Extents),
+			XMLoadFloat3(&pVolumes[2].Extents), XMLoadFloat3(&pVolumes[3].Extents));
 
-		// Load origin and orientation of the frustum.
-		XMVECTOR Origin = XMLoadFloat3(&pVolumeB->Origin);
-		XMVECTOR FrustumOrientation = XMLoadFloat4(&pVolumeB->Orientation);
+		// One component of all four boxes in each row.
+		Center = XMMatrixTranspose(Center);
+		Extents = XMMatrixTranspose(Extents);
 
-		XMQuaternionIsUnit(FrustumOrientation);
-	
+		XMVECTOR AnyOutside = XMVectorFalseInt();
 
-		// Load the box.
-		XMVECTOR Center = XMLoadFloat3(&pVolumeA->Center);
-		XMVECTOR Extents = XMLoadFloat3(&pVolumeA->Extents);
-		XMVECTOR BoxOrientation = XMLoadFloat4(&pVolumeA->Orientation);
-
-		XMQuaternionIsUnit(BoxOrientation);
+		for (INT i = 0; i < 6; i++)
+		{
+			XMVECTOR Dist = Center.r[0] * planes.Nx[i] + Center.r[1] * planes.Ny[i] +
+				Center.r[2] * planes.Nz[i] + planes.D[i];
+			XMVECTOR Radius = Extents.r[0] * planes.AbsNx[i] + Extents.r[1] * planes.AbsNy[i] +
+				Extents.r[2] * planes.AbsNz[i];
 
-		// Transform the oriented box into the space of the frustum in order to 
-		// minimize the number of transforms we have to do.
-		Center = XMVector3InverseRotate(Center - Origin, FrustumOrientation);
-		BoxOrientation = XMQuaternionMultiply(BoxOrientation, XMQuaternionConjugate(FrustumOrientation));
+			AnyOutside = XMVectorOrInt(AnyOutside, XMVectorGreater(Dist, Radius));
 
-		// Set w of the center to one so we can dot4 with the plane.
-		Center = XMVectorInsert(Center, XMVectorSplatOne(), 0, 0, 0, 0, 1);
+			if (XMVector4EqualInt(AnyOutside, XMVectorTrueInt()))
+				break;
+		}
 
-		// Build the 3x3 rotation matrix that defines the box axes.
-		XMMATRIX R = XMMatrixRotationQuaternion(BoxOrientation);
+		XMVECTORU32 Mask;
+		Mask.v = AnyOutside;
 
-		// Check against each plane of the frustum.
-		XMVECTOR Outside = XMVectorFalseInt();
-		XMVECTOR InsideAll = XMVectorTrueInt();
-		XMVECTOR CenterInsideAll = XMVectorTrueInt();
+		return (Mask.u[0] & 1) | (Mask.u[1] & 2) | (Mask.u[2] & 4) | (Mask.u[3] & 8);
+	}
 
-		for (INT i = 0; i < 6; i++)
-		{
-			// Compute the distance to the center of the box.
-			XMVECTOR Dist = XMVector4Dot(Center, Planes[i]);
-
-			// Project the axes of the box onto the normal of the plane.  Half the
-			// length of the projection (sometime called the "radius") is equal to
-			// h(u) * abs(n dot b(u))) + h(v) * abs(n dot b(v)) + h(w) * abs(n dot b(w))
-			// where h(i) are extents of the box, n is the plane normal, and b(i) are the 
-			// axes of the box.
-			XMVECTOR Radius = XMVector3Dot(Planes[i], R.r[0]);
-			Radius = XMVectorSelect(Radius, XMVector3Dot(Planes[i], R.r[1]), SelectY);
-			Radius = XMVectorSelect(Radius, XMVector3Dot(Planes[i], R.r[2]), SelectZ);
-			Radius = XMVector3Dot(Extents, XMVectorAbs(Radius));
-
-			// Outside the plane?
-			Outside = XMVectorOrInt(Outside, XMVectorGreater(Dist, Radius));
-
-			// Fully inside the plane?
-			InsideAll = XMVectorAndInt(InsideAll, XMVectorLessOrEqual(Dist, -Radius));
-
-			// Check if the center is inside the plane.
-			CenterInsideAll = XMVectorAndInt(CenterInsideAll, XMVectorLessOrEqual(Dist, Zero));
-		}
+	UINT CullAxisAlignedBoxRange(const CullPlanes& planes, const AxisAlignedBox* pVolumes, UINT first, UINT last,
+		UINT* pVisibleIndices)
+	{
+		UINT visibleCount = 0;
 
-		// If the box is outside any of the planes it is outside. 
-		if (XMVector4EqualInt(Outside, XMVectorTrueInt()))
-			return 0;
-
-		// If the box is inside all planes it is fully inside.
-		if (XMVector4EqualInt(InsideAll, XMVectorTrueInt()))
-			return 2;
-
-		// If the center of the box is inside all planes and the box intersects 
-		// one or more planes then it must intersect.
-		if (XMVector4EqualInt(CenterInsideAll, XMVectorTrueInt()))
-			return 1;
-
-		// Build the corners of the frustum.
-		XMVECTOR RightTop = XMVectorSet(pVolumeB->RightSlope, pVolumeB->TopSlope, 1.0f, 0.0f);
-		XMVECTOR RightBottom = XMVectorSet(pVolumeB->RightSlope, pVolumeB->BottomSlope, 1.0f, 0.0f);
-		XMVECTOR LeftTop = XMVectorSet(pVolumeB->LeftSlope, pVolumeB->TopSlope, 1.0f, 0.0f);
-		XMVECTOR LeftBottom = XMVectorSet(pVolumeB->LeftSlope, pVolumeB->BottomSlope, 1.0f, 0.0f);
-		XMVECTOR Near = XMVectorReplicatePtr(&pVolumeB->Near);
-		XMVECTOR Far = XMVectorReplicatePtr(&pVolumeB->Far);
-
-		XMVECTOR Corners[8];
-		Corners[0] = RightTop * Near;
-		Corners[1] = RightBottom * Near;
-		Corners[2] = LeftTop * Near;
-		Corners[3] = LeftBottom * Near;
-		Corners[4] = RightTop * Far;
-		Corners[5] = RightBottom * Far;
-		Corners[6] = LeftTop * Far;
-		Corners[7] = LeftBottom * Far;
-
-		// Test against box axes (3)
+		for (UINT i = first; i < last; i += 4)
 		{
-			// Find the min/max values of the projection of the frustum onto each axis.
-			XMVECTOR FrustumMin, FrustumMax;
+			// Pad the last few boxes out to four with copies of the last one.
+			AxisAlignedBox Tail[4];
+			const AxisAlignedBox* pBoxes = pVolumes + i;
+			if (last - i < 4)
+			{
+				for (UINT k = 0; k < 4; k++)
+					Tail[k] = pVolumes[(i + k < last) ? i + k : last - 1];
+				pBoxes = Tail;
+			}
 
-			FrustumMin = XMVector3Dot(Corners[0], R.r[0]);
-			FrustumMin = XMVectorSelect(FrustumMin, XMVector3Dot(Corners[0], R.r[1]), SelectY);
-			FrustumMin = XMVectorSelect(FrustumMin, XMVector3Dot(Corners[0], R.r[2]), SelectZ);
-			FrustumMax = FrustumMin;
+			UINT outside = CullAxisAlignedBoxes4(planes, pBoxes);
 
-			for (INT i = 1; i < 8; i++)
+			for (UINT k = 0; k < 4 && i + k < last; k++)
 			{
-				XMVECTOR Temp = XMVector3Dot(Corners[i], R.r[0]);
-				Temp = XMVectorSelect(Temp, XMVector3Dot(Corners[i], R.r[1]), SelectY);
-				Temp = XMVectorSelect(Temp, XMVector3Dot(Corners[i], R.r[2]), SelectZ);
-
-				FrustumMin = XMVectorMin(FrustumMin, Temp);
-				FrustumMax = XMVectorMax(FrustumMax, Temp);
+				pVisibleIndices[visibleCount] = i + k;
+				visibleCount += (~outside >> k) & 1;
 			}
+		}
 
-			// Project the center of the box onto the axes.
-			XMVECTOR BoxDist = XMVector3Dot(Center, R.r[0]);
-			BoxDist = XMVectorSelect(BoxDist, XMVector3Dot(Center, R.r[1]), SelectY);
-			BoxDist = XMVectorSelect(BoxDist, XMVector3Dot(Center, R.r[2]), SelectZ);
+		return visibleCount;
+	}
 
-			// The projection of the box onto the axis is just its Center and Extents.
-			// if (min > box_max || max < box_min) reject;
-			XMVECTOR Result = XMVectorOrInt(XMVectorGreater(FrustumMin, BoxDist + Extents),
-				XMVectorLess(FrustumMax, BoxDist - Extents));
+	// Writes the indices of the boxes that are not outside any plane of the
+	// frustum to pVisibleIndices, in order, and returns how many there are.  Like
+	// IntersectAxisAlignedBox6Planes this is conservative: a box just off a corner
+	// of the frustum is kept.
+	UINT CullAxisAlignedBoxes(const Frustum* pFrustum, const AxisAlignedBox* pVolumes, UINT Count,
+		UINT* pVisibleIndices, JobSystem* pJobSystem)
+	{
+		static const UINT ChunkSize = 4096;
 
-			if (XMVector3AnyTrue(Result))
-				return 0;
+		XMVECTOR Planes[6];
+		ComputePlanesFromFrustum(pFrustum, Planes);
+
+		CullPlanes planes;
+		for (INT i = 0; i < 6; i++)
+		{
+			planes.Nx[i] = XMVectorSplatX(Planes[i]);
+			planes.Ny[i] = XMVectorSplatY(Planes[i]);
+			planes.Nz[i] = XMVectorSplatZ(Planes[i]);
+			planes.D[i] = XMVectorSplatW(Planes[i]);
+			planes.AbsNx[i] = XMVectorAbs(planes.Nx[i]);
+			planes.AbsNy[i] = XMVectorAbs(planes.Ny[i]);
+			planes.AbsNz[i] = XMVectorAbs(planes.Nz[i]);
 		}
 
-		// Test against edge/edge axes (3*6).
-		XMVECTOR FrustumEdgeAxis[6];
+		if (pJobSystem == nullptr || Count <= ChunkSize)
+			return CullAxisAlignedBoxRange(planes, pVolumes, 0, Count, pVisibleIndices);
 
-		FrustumEdgeAxis[0] = RightTop;
-		FrustumEdgeAxis[1] = RightBottom;
-		FrustumEdgeAxis[2] = LeftTop;
-		FrustumEdgeAxis[3] = LeftBottom;
-		FrustumEdgeAxis[4] = RightTop - LeftTop;
-		FrustumEdgeAxis[5] = LeftBottom - LeftTop;
+		// Each chunk writes its visible indices to the start of its own part of the
+		// output, and the parts are then moved down to follow each other.
+		UINT chunkCount = (Count + ChunkSize - 1) / ChunkSize;
+		std::vector<UINT> visibleCounts(chunkCount);
 
-		for (INT i = 0; i < 3; i++)
+		pJobSystem->ParallelFor(0, chunkCount, 1, [&](UINT firstChunk, UINT lastChunk)
 		{
-			for (INT j = 0; j < 6; j++)
+			for (UINT c = firstChunk; c < lastChunk; c++)
 			{
-				// Compute the axis we are going to test.
-				XMVECTOR Axis = XMVector3Cross(R.r[i], FrustumEdgeAxis[j]);
+				UINT first = c * ChunkSize;
+				UINT last = (Count - first > ChunkSize) ? first + ChunkSize : Count;
 
-				// Find the min/max values of the projection of the frustum onto the axis.
-				XMVECTOR FrustumMin, FrustumMax;
-
-				FrustumMin = FrustumMax = XMVector3Dot(Axis, Corners[0]);
-
-				for (INT k = 1; k < 8; k++)
-				{
-					XMVECTOR Temp = XMVector3Dot(Axis, Corners[k]);
-					FrustumMin = XMVectorMin(FrustumMin, Temp);
-					FrustumMax = XMVectorMax(FrustumMax, Temp);
-				}
-
-				// Project the center of the box onto the axis.
-				XMVECTOR Dist = XMVector3Dot(Center, Axis);
-
-				// Project the axes of the box onto the axis to find the "radius" of the box.
-				XMVECTOR Radius = XMVector3Dot(Axis, R.r[0]);
-				Radius = XMVectorSelect(Radius, XMVector3Dot(Axis, R.r[1]), SelectY);
-				Radius = XMVectorSelect(Radius, XMVector3Dot(Axis, R.r[2]), SelectZ);
-				Radius = XMVector3Dot(Extents, XMVectorAbs(Radius));
-
-				// if (center > max + radius || center < min - radius) reject;
-				Outside = XMVectorOrInt(Outside, XMVectorGreater(Dist, FrustumMax + Radius));
-				Outside = XMVectorOrInt(Outside, XMVectorLess(Dist, FrustumMin - Radius));
+				visibleCounts[c] = CullAxisAlignedBoxRange(planes, pVolumes, first, last, pVisibleIndices + first);
 			}
-		}
-
-		if (XMVector4EqualInt(Outside, XMVectorTrueInt()))
-			return 0;
-
-		// If we did not find a separating plane then the box must intersect the frustum.
-		return 1;
-	}
+		});
 
-	int IntersectAxisAlignedBoxFrustum(const AxisAlignedBox* pVolumeA, const Frustum* pVolumeB)
-	{
-		// Make the axis aligned box oriented and do an OBB vs frustum test.
-		OrientedBox BoxA;
-
-		BoxA.Center = pVolumeA->Center;
-		BoxA.Extents = pVolumeA->Extents;
-		BoxA.Orientation.x = 0.0f;
-		BoxA.Orientation.y = 0.0f;
-		BoxA.Orientation.z = 0.0f;
-		BoxA.Orientation.w = 1.0f;
+		UINT visibleCount = visibleCounts[0];
+		for (UINT c = 1; c < chunkCount; c++)
+		{
+			memmove(pVisibleIndices + visibleCount, pVisibleIndices + c * ChunkSize, visibleCounts[c] * sizeof(UINT));
+			visibleCount += visibleCounts[c];
+		}
 
-		return IntersectOrientedBoxFrustum(&BoxA, pVolumeB);
+		return visibleCount;
 	}
 
 
@@ -577,6 +624,8 @@
 	{
 		HRESULT hr = S_OK;
 
+		g_JobSystem = new JobSystem();
+
 		//
 		// Lighting
 		//
@@ -669,7 +718,14 @@
 
 
 			activeTech->GetPassByIndex(p)->Apply(0, pd3dImmediateContext);
-			pd3dImmediateContext->DrawIndexedInstanced(g_SkullIndexCount, g_VisibleObjectCount, 0, 0, 0);
+
+			// One draw per level of detail, over its instances.
+			for (UINT lod = 0; lod < g_SkullLods.size(); lod++)
+			{
+				if (g_LodInstanceCount[lod] > 0)
+					pd3dImmediateContext->DrawIndexedInstanced(g_SkullLods[lod].IndexCount, g_LodInstanceCount[lod],
+						g_SkullLods[lod].IndexStart, 0, g_LodInstanceStart[lod]);
+			}
 		}
 	}
 
@@ -693,61 +749,98 @@
 		if (GetAsyncKeyState('2') & 0x8000)
 			bUseFrustumCulling = false;
 
+		if (GetAsyncKeyState('3') & 0x8000)
+			g_CullingMethod = CullWithOctree;
+
+		if (GetAsyncKeyState('4') & 0x8000)
+			g_CullingMethod = CullAllInstances;
+
+		if (GetAsyncKeyState('5') & 0x8000)
+			g_CullingMethod = CullCoherently;
+
+		if (GetAsyncKeyState('6') & 0x8000)
+			bUseLod = true;
+
+		if (GetAsyncKeyState('7') & 0x8000)
+			bUseLod = false;
+
 		g_VisibleObjectCount = 0;
 		if (bUseFrustumCulling)
 		{
 			XMVECTOR detViewMatrix = XMMatrixDeterminant(g_Camera.GetViewMatrix());
 			XMMATRIX invViewMatrix = XMMatrixInverse(&detViewMatrix, g_Camera.GetViewMatrix());
-		
-			D3D11_MAPPED_SUBRESOURCE mappedData;
-			pd3dImmediateContext->Map(g_SkullInstancedBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData);
 
-			InstancedData* dataView = reinterpret_cast<InstancedData*>(mappedData.pData);
-
-			for (UINT i = 0; i < g_InstancedData.size(); i++)
+			// Move the camera frustum into world space once, then cull the world
+			// space bounds of the instances against it: through the octree, which
+			// only visits the cells the frustum reaches, all of them on all cores, or
+			// through the coherent culler, which retests only what the camera's
+			// motion since the last frame could have changed.
+			XMVECTOR scale;
+			XMVECTOR rotQuat;
+			XMVECTOR translation;
+			XMMatrixDecompose(&scale, &rotQuat, &translation, invViewMatrix);
+
+			Frustum worldSpaceFrustum;
+			TransformFrustum(&worldSpaceFrustum, &g_CameraFrustum, XMVectorGetX(scale), rotQuat, translation);
+
+			UINT visibleCount = 0;
+			if (g_CullingMethod == CullWithOctree)
 			{
-				XMMATRIX World = XMLoadFloat4x4(&g_InstancedData[i].World);
-				XMVECTOR detWorld = XMMatrixDeterminant(World);
-				XMMATRIX invWorld = XMMatrixInverse(&detWorld, World);
-
-				// View space to the object's local space.
-				XMMATRIX toLocal = invViewMatrix * invWorld;
+				XMVECTOR planes[6];
+				ComputePlanesFromFrustum(&worldSpaceFrustum, planes);
 
-				// Decompose the into its individual parts
-				XMVECTOR scale;
-				XMVECTOR rotQuat;
-				XMVECTOR translation;
-				XMMatrixDecompose(&scale, &rotQuat, &translation, toLocal);
-
-				Frustum localSpaceFrustum;
-				TransformFrustum(&localSpaceFrustum, &g_CameraFrustum, XMVectorGetX(scale), rotQuat, translation);
+				g_VisibleInstances.clear();
+				g_InstanceTree.QueryFrustum(planes, g_VisibleInstances);
+				visibleCount = (UINT)g_VisibleInstances.size();
+			}
+			else if (g_CullingMethod == CullCoherently)
+			{
+				XMVECTOR planes[6];
+				ComputePlanesFromFrustum(&worldSpaceFrustum, planes);
 
-				// Check intersection
-				if (IntersectAxisAlignedBoxFrustum(&g_SkullBox, &localSpaceFrustum) != 0)
-					dataView[g_VisibleObjectCount++] = g_InstancedData[i];
+				g_VisibleInstances.clear();
+				g_CoherentCuller.Cull(planes, translation, rotQuat, g_VisibleInstances);
+				visibleCount = (UINT)g_VisibleInstances.size();
+			}
+			else
+			{
+				g_VisibleInstances.resize(g_InstanceBounds.size());
+				visibleCount = CullAxisAlignedBoxes(&worldSpaceFrustum, &g_InstanceBounds[0],
+					(UINT)g_InstanceBounds.size(), &g_VisibleInstances[0], g_JobSystem);
 			}
 
-			pd3dImmediateContext->Unmap(g_SkullInstancedBuffer, 0);
+			g_VisibleObjectCount = visibleCount;
 		}
 		else
 		{
-			
-			D3D11_MAPPED_SUBRESOURCE mappedData;
-			pd3dImmediateContext->Map(g_SkullInstancedBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData);
-			InstancedData* dataView = reinterpret_cast<InstancedData*>(mappedData.pData);
+			g_VisibleInstances.resize(g_InstancedData.size());
 			for (UINT i = 0; i < g_InstancedData.size(); ++i)
-			{
-				dataView[g_VisibleObjectCount++] = g_InstancedData[i];
-			}
-			pd3dImmediateContext->Unmap(g_SkullInstancedBuffer, 0);
-			
+				g_VisibleInstances[i] = i;
+
+			g_VisibleObjectCount = (UINT)g_InstancedData.size();
 		}
 
+		WriteInstancesByLod(pd3dImmediateContext, g_VisibleInstances, g_VisibleObjectCount);
+
+		UINT triangleCount = 0;
+		for (UINT lod = 0; lod < g_SkullLods.size(); lod++)
+			triangleCount += g_LodInstanceCount[lod] * g_SkullLods[lod].IndexCount / 3;
+
 		std::wostringstream outs;
 		outs.precision(6);
 		outs << L"Instancing and Culling Demo" <<
 			L"    " << g_VisibleObjectCount <<
-			L" objects visible out of " << g_InstancedData.size();
+			L" objects visible out of " << g_InstancedData.size() <<
+			L"    " << triangleCount << L" triangles";
+
+		if (bUseFrustumCulling && g_CullingMethod == CullCoherently)
+		{
+			const CoherentCuller::Stats& stats = g_CoherentCuller.GetStats();
+			UINT groups = stats.GroupsSkipped + stats.GroupsTested;
+			UINT rejected = stats.PlaneCacheHits + stats.PlaneCacheMisses;
+			outs << L"    groups reused " << (groups > 0 ? 100 * stats.GroupsSkipped / groups : 0) << L"%" <<
+				L"    plane cache hits " << (rejected > 0 ? 100 * stats.PlaneCacheHits / rejected : 0) << L"%";
+		}
 		
 		HWND hWnd = DXUTGetHWND();  // Get the handle to the window
 		SetWindowText(hWnd, outs.str().c_str());
@@ -763,7 +856,7 @@
 	//--------------------------------------------------------------------------------------
 	void CALLBACK OnD3D11DestroyDevice(void* pUserContext)
 	{
-
+		SAFE_DELETE(g_JobSystem);
 	}
 
 
@@ -839,6 +932,9 @@
 		float fAspect = static_cast<float>(pBackBufferSurfaceDesc->Width) / static_cast<float>(pBackBufferSurfaceDesc->Height);
 
 		g_Camera.SetProjParams(fFOV, fAspect, fNearPlane, fFarPlane);
+		g_CameraFovY = fFOV;
+		g_CameraNearZ = fNearPlane;
+		g_ViewportHeight = static_cast<float>(pBackBufferSurfaceDesc->Height);
 		g_Camera.SetWindow(pBackBufferSurfaceDesc->Width, pBackBufferSurfaceDesc->Height);
 		g_Camera.SetButtonMasks(MOUSE_LEFT_BUTTON, MOUSE_WHEEL, MOUSE_MIDDLE_BUTTON);
 
@@ -846,6 +942,9 @@
 		XMMATRIX projView = g_Camera.GetProjMatrix();
 		ComputeFrustumFromProjection(&g_CameraFrustum, &projView);
 
+		// The frustum changed shape, so the culler's cached results no longer hold.
+		g_CoherentCuller.Invalidate();
+
 		return S_OK;
 	}
 
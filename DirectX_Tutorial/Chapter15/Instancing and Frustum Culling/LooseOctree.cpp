@@ -0,0 +1,422 @@
+#include "LooseOctree.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+	float MaxExtent(const XMFLOAT3& extents)
+	{
+		return std::max(extents.x, std::max(extents.y, extents.z));
+	}
+
+	// True if a cube of half size looseSize about cellCenter holds a box of
+	// half size `size` (its largest extent) about center.
+	bool Holds(const XMFLOAT3& cellCenter, float looseSize, const XMFLOAT3& center, float size)
+	{
+		return fabsf(center.x - cellCenter.x) + size <= looseSize &&
+			fabsf(center.y - cellCenter.y) + size <= looseSize &&
+			fabsf(center.z - cellCenter.z) + size <= looseSize;
+	}
+}
+
+LooseOctree::LooseOctree()
+{
+	Reset(XMFLOAT3(0.0f, 0.0f, 0.0f), 1.0f, 0);
+}
+
+void LooseOctree::Reset(const XMFLOAT3& center, float halfSize, UINT maxDepth)
+{
+	mNodes.clear();
+	mFreeNodes.clear();
+	mObjects.clear();
+
+	mObjectCount = 0;
+	mMaxDepth = maxDepth;
+	mOutsideCount = 0;
+
+	NewNode(InvalidIndex, center, halfSize);
+}
+
+bool LooseOctree::Contains(UINT id)const
+{
+	return id < mObjects.size() && mObjects[id].Node != InvalidIndex;
+}
+
+void LooseOctree::Insert(UINT id, const XMFLOAT3& center, const XMFLOAT3& extents)
+{
+	assert(!Contains(id));
+
+	if( id >= mObjects.size() )
+	{
+		Object empty;
+		empty.Node = InvalidIndex;
+		mObjects.resize(id + 1, empty);
+	}
+
+	Object& object = mObjects[id];
+	object.Center = center;
+	object.Extents = extents;
+
+	float size = MaxExtent(extents);
+	UINT node = FindNode(center, size, true);
+	if( node == 0 && !FitsRoot(center, size) )
+		++mOutsideCount;
+
+	Link(id, node);
+	++mObjectCount;
+}
+
+void LooseOctree::Remove(UINT id)
+{
+	assert(Contains(id));
+
+	const Object& object = mObjects[id];
+	if( object.Node == 0 && !FitsRoot(object.Center, MaxExtent(object.Extents)) )
+		--mOutsideCount;
+
+	Unlink(id);
+	--mObjectCount;
+}
+
+void LooseOctree::Update(UINT id, const XMFLOAT3& center, const XMFLOAT3& extents)
+{
+	assert(Contains(id));
+
+	Object& object = mObjects[id];
+
+	float size = MaxExtent(extents);
+	UINT node = FindNode(center, size, false);
+	if( node != object.Node )
+	{
+		Remove(id);
+		Insert(id, center, extents);
+		return;
+	}
+
+	// Still in the same cell; only the root needs to know whether it sticks out.
+	if( node == 0 )
+	{
+		mOutsideCount -= FitsRoot(object.Center, MaxExtent(object.Extents)) ? 0 : 1;
+		mOutsideCount += FitsRoot(center, size) ? 0 : 1;
+	}
+
+	object.Center = center;
+	object.Extents = extents;
+}
+
+bool LooseOctree::FitsRoot(const XMFLOAT3& center, float size)const
+{
+	const Node& root = mNodes[0];
+	return Holds(root.Center, 2.0f*root.HalfSize, center, size);
+}
+
+// Walks down from the root to the deepest cell whose loose bounds hold the
+// box.  Missing cells are created, or if create is false InvalidIndex is
+// returned as soon as one is needed.
+UINT LooseOctree::FindNode(const XMFLOAT3& center, float size, bool create)
+{
+	UINT node = 0;
+	if( !FitsRoot(center, size) )
+		return node;
+
+	for(UINT depth = 0; depth < mMaxDepth; ++depth)
+	{
+		const Node& parent = mNodes[node];
+
+		// The child whose cell holds the center.
+		UINT slot = (center.x >= parent.Center.x ? 1 : 0) |
+			(center.y >= parent.Center.y ? 2 : 0) |
+			(center.z >= parent.Center.z ? 4 : 0);
+
+		float childHalfSize = 0.5f*parent.HalfSize;
+		XMFLOAT3 childCenter(
+			parent.Center.x + ((slot & 1) ? childHalfSize : -childHalfSize),
+			parent.Center.y + ((slot & 2) ? childHalfSize : -childHalfSize),
+			parent.Center.z + ((slot & 4) ? childHalfSize : -childHalfSize));
+
+		if( !Holds(childCenter, 2.0f*childHalfSize, center, size) )
+			break;
+
+		UINT child = parent.Children[slot];
+		if( child == InvalidIndex )
+		{
+			if( !create )
+				return InvalidIndex;
+
+			// NewNode may move mNodes, so parent is not used past this point.
+			child = NewNode(node, childCenter, childHalfSize);
+			mNodes[node].Children[slot] = child;
+		}
+
+		node = child;
+	}
+
+	return node;
+}
+
+UINT LooseOctree::NewNode(UINT parent, const XMFLOAT3& center, float halfSize)
+{
+	UINT index;
+	if( !mFreeNodes.empty() )
+	{
+		index = mFreeNodes.back();
+		mFreeNodes.pop_back();
+	}
+	else
+	{
+		index = (UINT)mNodes.size();
+		mNodes.push_back(Node());
+	}
+
+	Node& node = mNodes[index];
+	node.Center = center;
+	node.HalfSize = halfSize;
+	std::fill(node.Children, node.Children + 8, InvalidIndex);
+	node.Parent = parent;
+	node.FirstObject = InvalidIndex;
+	node.ObjectCount = 0;
+	node.Pad = 0;
+
+	return index;
+}
+
+void LooseOctree::Link(UINT id, UINT node)
+{
+	Object& object = mObjects[id];
+	object.Node = node;
+	object.Prev = InvalidIndex;
+	object.Next = mNodes[node].FirstObject;
+
+	if( object.Next != InvalidIndex )
+		mObjects[object.Next].Prev = id;
+	mNodes[node].FirstObject = id;
+
+	for(UINT n = node; n != InvalidIndex; n = mNodes[n].Parent)
+		++mNodes[n].ObjectCount;
+}
+
+void LooseOctree::Unlink(UINT id)
+{
+	Object& object = mObjects[id];
+
+	if( object.Prev != InvalidIndex )
+		mObjects[object.Prev].Next = object.Next;
+	else
+		mNodes[object.Node].FirstObject = object.Next;
+
+	if( object.Next != InvalidIndex )
+		mObjects[object.Next].Prev = object.Prev;
+
+	// Count the object out of every node above it and give back the ones left
+	// empty.  A node only empties after its children have, so they are already
+	// gone.
+	UINT n = object.Node;
+	while( n != InvalidIndex )
+	{
+		Node& node = mNodes[n];
+		UINT parent = node.Parent;
+
+		if( --node.ObjectCount == 0 && parent != InvalidIndex )
+		{
+			UINT* children = mNodes[parent].Children;
+			*std::find(children, children + 8, n) = InvalidIndex;
+			mFreeNodes.push_back(n);
+		}
+
+		n = parent;
+	}
+
+	object.Node = InvalidIndex;
+}
+
+void LooseOctree::QueryFrustum(const XMVECTOR* planes, std::vector<UINT>& ids)const
+{
+	XMFLOAT4 p[6];
+	for(UINT i = 0; i < 6; ++i)
+		XMStoreFloat4(&p[i], planes[i]);
+
+	QueryFrustum(0, p, 0x3f, ids);
+}
+
+// planeMask has a bit for each plane the node is not yet known to be inside;
+// the children of a node inside a plane need not be tested against it.
+void LooseOctree::QueryFrustum(UINT n, const XMFLOAT4* planes, UINT planeMask, std::vector<UINT>& ids)const
+{
+	const Node& node = mNodes[n];
+	if( node.ObjectCount == 0 )
+		return;
+
+	if( n != 0 || mOutsideCount == 0 )
+	{
+		float looseSize = 2.0f*node.HalfSize;
+
+		for(UINT i = 0; i < 6; ++i)
+		{
+			if( (planeMask & (1 << i)) == 0 )
+				continue;
+
+			const XMFLOAT4& p = planes[i];
+			float dist = node.Center.x*p.x + node.Center.y*p.y + node.Center.z*p.z + p.w;
+			float radius = looseSize*(fabsf(p.x) + fabsf(p.y) + fabsf(p.z));
+
+			if( dist > radius )
+				return;
+			if( dist < -radius )
+				planeMask &= ~(1 << i);
+		}
+
+		if( planeMask == 0 )
+		{
+			AppendAll(n, ids);
+			return;
+		}
+	}
+
+	for(UINT id = node.FirstObject; id != InvalidIndex; id = mObjects[id].Next)
+	{
+		const Object& object = mObjects[id];
+
+		bool outside = false;
+		for(UINT i = 0; i < 6 && !outside; ++i)
+		{
+			if( (planeMask & (1 << i)) == 0 )
+				continue;
+
+			const XMFLOAT4& p = planes[i];
+			float dist = object.Center.x*p.x + object.Center.y*p.y + object.Center.z*p.z + p.w;
+			float radius = object.Extents.x*fabsf(p.x) + object.Extents.y*fabsf(p.y) + object.Extents.z*fabsf(p.z);
+			outside = dist > radius;
+		}
+
+		if( !outside )
+			ids.push_back(id);
+	}
+
+	for(UINT k = 0; k < 8; ++k)
+	{
+		if( node.Children[k] != InvalidIndex )
+			QueryFrustum(node.Children[k], planes, planeMask, ids);
+	}
+}
+
+void LooseOctree::QuerySphere(FXMVECTOR center, float radius, std::vector<UINT>& ids)const
+{
+	XMFLOAT3 c;
+	XMStoreFloat3(&c, center);
+
+	QuerySphere(0, c, radius, ids);
+}
+
+void LooseOctree::QuerySphere(UINT n, const XMFLOAT3& center, float radius, std::vector<UINT>& ids)const
+{
+	const Node& node = mNodes[n];
+	if( node.ObjectCount == 0 )
+		return;
+
+	float radiusSq = radius*radius;
+
+	if( n != 0 || mOutsideCount == 0 )
+	{
+		float looseSize = 2.0f*node.HalfSize;
+		float dx = fabsf(center.x - node.Center.x);
+		float dy = fabsf(center.y - node.Center.y);
+		float dz = fabsf(center.z - node.Center.z);
+
+		// Distance from the sphere center to the nearest and the farthest point of
+		// the loose bounds.
+		float nx = std::max(dx - looseSize, 0.0f);
+		float ny = std::max(dy - looseSize, 0.0f);
+		float nz = std::max(dz - looseSize, 0.0f);
+		if( nx*nx + ny*ny + nz*nz > radiusSq )
+			return;
+
+		float fx = dx + looseSize;
+		float fy = dy + looseSize;
+		float fz = dz + looseSize;
+		if( fx*fx + fy*fy + fz*fz <= radiusSq )
+		{
+			AppendAll(n, ids);
+			return;
+		}
+	}
+
+	for(UINT id = node.FirstObject; id != InvalidIndex; id = mObjects[id].Next)
+	{
+		const Object& object = mObjects[id];
+
+		float nx = std::max(fabsf(center.x - object.Center.x) - object.Extents.x, 0.0f);
+		float ny = std::max(fabsf(center.y - object.Center.y) - object.Extents.y, 0.0f);
+		float nz = std::max(fabsf(center.z - object.Center.z) - object.Extents.z, 0.0f);
+
+		if( nx*nx + ny*ny + nz*nz <= radiusSq )
+			ids.push_back(id);
+	}
+
+	for(UINT k = 0; k < 8; ++k)
+	{
+		if( node.Children[k] != InvalidIndex )
+			QuerySphere(node.Children[k], center, radius, ids);
+	}
+}
+
+void LooseOctree::QueryBox(const XMFLOAT3& center, const XMFLOAT3& extents, std::vector<UINT>& ids)const
+{
+	QueryBox(0, center, extents, ids);
+}
+
+void LooseOctree::QueryBox(UINT n, const XMFLOAT3& center, const XMFLOAT3& extents, std::vector<UINT>& ids)const
+{
+	const Node& node = mNodes[n];
+	if( node.ObjectCount == 0 )
+		return;
+
+	if( n != 0 || mOutsideCount == 0 )
+	{
+		float looseSize = 2.0f*node.HalfSize;
+		float dx = fabsf(center.x - node.Center.x);
+		float dy = fabsf(center.y - node.Center.y);
+		float dz = fabsf(center.z - node.Center.z);
+
+		if( dx > extents.x + looseSize || dy > extents.y + looseSize || dz > extents.z + looseSize )
+			return;
+
+		if( dx + looseSize <= extents.x && dy + looseSize <= extents.y && dz + looseSize <= extents.z )
+		{
+			AppendAll(n, ids);
+			return;
+		}
+	}
+
+	for(UINT id = node.FirstObject; id != InvalidIndex; id = mObjects[id].Next)
+	{
+		const Object& object = mObjects[id];
+
+		if( fabsf(center.x - object.Center.x) <= extents.x + object.Extents.x &&
+			fabsf(center.y - object.Center.y) <= extents.y + object.Extents.y &&
+			fabsf(center.z - object.Center.z) <= extents.z + object.Extents.z )
+		{
+			ids.push_back(id);
+		}
+	}
+
+	for(UINT k = 0; k < 8; ++k)
+	{
+		if( node.Children[k] != InvalidIndex )
+			QueryBox(node.Children[k], center, extents, ids);
+	}
+}
+
+void LooseOctree::AppendAll(UINT n, std::vector<UINT>& ids)const
+{
+	const Node& node = mNodes[n];
+
+	for(UINT id = node.FirstObject; id != InvalidIndex; id = mObjects[id].Next)
+		ids.push_back(id);
+
+	for(UINT k = 0; k < 8; ++k)
+	{
+		if( node.Children[k] != InvalidIndex )
+			AppendAll(node.Children[k], ids);
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <Windows.h>
+#include <directxmath.h>
+#include <vector>
+
+using namespace DirectX;
+
+///<summary>
+/// Loose octree over the bounding boxes of many objects, so that a query costs
+/// in proportion to what it finds rather than to the number of objects.
+///
+/// Every cell of the tree is enlarged to twice its size, which lets an object
+/// live in the one cell that holds its center and is no smaller than the
+/// object: it never straddles cells and moving it is a constant time relink.
+/// Cells are created as objects need them and given back when they empty.
+///
+/// Objects are named by an id chosen by the caller, such as the index of an
+/// instance; the queries return those ids.  Queries are const and can run on
+/// several threads at once, but not while the tree is changed.
+///</summary>
+class LooseOctree
+{
+public:
+	LooseOctree();
+
+	// Empties the tree and sets the cube it covers.  Objects are never placed
+	// in cells smaller than halfSize / 2^maxDepth; pick maxDepth so that the
+	// smallest cells hold a few objects each.  Objects outside the cube are
+	// still found, they just sit in the root and are tested by every query.
+	void Reset(const XMFLOAT3& center, float halfSize, UINT maxDepth);
+
+	// Adds a box given by its center and half extents.  id must not be in the
+	// tree; the tree keeps an array as long as the largest id.
+	void Insert(UINT id, const XMFLOAT3& center, const XMFLOAT3& extents);
+
+	void Remove(UINT id);
+
+	// Moves an object.  An object that stays in its cell is not relinked.
+	void Update(UINT id, const XMFLOAT3& center, const XMFLOAT3& extents);
+
+	bool Contains(UINT id)const;
+
+	// Append the ids of the objects whose boxes pass the query to ids, in no
+	// particular order.  Below a cell found to be inside the query, objects are
+	// taken without being tested.
+	//
+	// The frustum is given by six planes (a, b, c, d) with the outside on the
+	// positive side, as from ComputePlanesFromFrustum; boxes outside none of
+	// them pass.
+	void QueryFrustum(const XMVECTOR* planes, std::vector<UINT>& ids)const;
+	void QuerySphere(FXMVECTOR center, float radius, std::vector<UINT>& ids)const;
+	void QueryBox(const XMFLOAT3& center, const XMFLOAT3& extents, std::vector<UINT>& ids)const;
+
+	UINT GetObjectCount()const { return mObjectCount; }
+	UINT GetNodeCount()const { return (UINT)(mNodes.size() - mFreeNodes.size()); }
+
+private:
+	// 64 bytes, one cache line.
+	struct Node
+	{
+		XMFLOAT3 Center;
+
+		// Half the size of the cell; objects in it lie within twice that of the center.
+		float HalfSize;
+
+		UINT Children[8];
+		UINT Parent;
+
+		// Head of the list of objects stored in this node.
+		UINT FirstObject;
+
+		// Objects in this node and below it.
+		UINT ObjectCount;
+
+		UINT Pad;
+	};
+
+	struct Object
+	{
+		XMFLOAT3 Center;
+		XMFLOAT3 Extents;
+
+		// InvalidIndex when the id is not in the tree.
+		UINT Node;
+
+		// Links of the list of objects of the node.
+		UINT Prev;
+		UINT Next;
+	};
+
+	static const UINT InvalidIndex = 0xffffffff;
+
+	bool FitsRoot(const XMFLOAT3& center, float size)const;
+	UINT FindNode(const XMFLOAT3& center, float size, bool create);
+	UINT NewNode(UINT parent, const XMFLOAT3& center, float halfSize);
+	void Link(UINT id, UINT node);
+	void Unlink(UINT id);
+
+	void QueryFrustum(UINT node, const XMFLOAT4* planes, UINT planeMask, std::vector<UINT>& ids)const;
+	void QuerySphere(UINT node, const XMFLOAT3& center, float radius, std::vector<UINT>& ids)const;
+	void QueryBox(UINT node, const XMFLOAT3& center, const XMFLOAT3& extents, std::vector<UINT>& ids)const;
+	void AppendAll(UINT node, std::vector<UINT>& ids)const;
+
+private:
+	// mNodes[0] is the root.
+	std::vector<Node> mNodes;
+	std::vector<UINT> mFreeNodes;
+
+	// Indexed by id.
+	std::vector<Object> mObjects;
+
+	UINT mObjectCount;
+	UINT mMaxDepth;
+
+	// Objects in the root that stick out of its loose bounds.  While there are
+	// any, the root is never culled or taken whole.
+	UINT mOutsideCount;
+};
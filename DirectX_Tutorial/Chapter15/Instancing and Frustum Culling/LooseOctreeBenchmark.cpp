@@ -0,0 +1,367 @@
+//***************************************************************************************
+// LooseOctreeBenchmark.cpp
+//
+// Headless benchmark of LooseOctree against the flat loop, which tests the
+// world space box of every instance against the six planes of the frustum.
+// Skull sized instances are scattered through a cube that grows with their
+// number, ten units apart, and seen from a few camera poses inside it.  For
+// every scene size it reports
+//   -the time to insert every instance,
+//   -instances culled per millisecond by the flat loop and by the octree,
+//   -the time to move a tenth of the instances with Update,
+//   -the time of a sphere and a box query of radius 50.
+// Every query must return exactly the instances a brute force test over all of
+// them finds, after building, after the moves, and after half the instances
+// have been removed.  Returns 1 if any differs.
+//
+// Build with:
+//   cl /EHsc /O2 LooseOctree.cpp LooseOctreeBenchmark.cpp
+//
+// Usage: LooseOctreeBenchmark [instances ...]      (default 1000 10000 100000 1000000)
+//***************************************************************************************
+
+#include "LooseOctree.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	float RandF(UINT& state)
+	{
+		state = state*1664525u + 1013904223u;
+		return (state >> 8) / 16777216.0f;
+	}
+
+	const UINT PoseCount = 8;
+
+	struct Box
+	{
+		XMFLOAT3 Center;
+		XMFLOAT3 Extents;
+	};
+
+	struct Planes
+	{
+		XMVECTOR P[6];
+	};
+
+	// The planes ComputePlanesFromFrustum makes for a camera at eye looking
+	// along +z rotated by q, with a 45 degree field of view.
+	Planes MakeFrustum(FXMVECTOR eye, FXMVECTOR q)
+	{
+		float top = tanf(0.125f*XM_PI);
+		float right = top*800.0f/600.0f;
+		float nearZ = 1.0f;
+		float farZ = 1000.0f;
+
+		Planes planes;
+		planes.P[0] = XMVectorSet(0.0f, 0.0f, -1.0f, nearZ);
+		planes.P[1] = XMVectorSet(0.0f, 0.0f, 1.0f, -farZ);
+		planes.P[2] = XMVectorSet(1.0f, 0.0f, -right, 0.0f);
+		planes.P[3] = XMVectorSet(-1.0f, 0.0f, -right, 0.0f);
+		planes.P[4] = XMVectorSet(0.0f, 1.0f, -top, 0.0f);
+		planes.P[5] = XMVectorSet(0.0f, -1.0f, -top, 0.0f);
+
+		for(UINT i = 0; i < 6; ++i)
+		{
+			XMVECTOR normal = XMVector3Rotate(planes.P[i], q);
+			float d = XMVectorGetW(planes.P[i]) - XMVectorGetX(XMVector3Dot(normal, eye));
+			planes.P[i] = XMPlaneNormalize(XMVectorSetW(normal, d));
+		}
+		return planes;
+	}
+
+	//
+	// The flat loop, and the brute force answers to the other queries.
+	//
+
+	void FlatFrustum(const std::vector<Box>& boxes, const std::vector<char>& present, const Planes& planes, std::vector<UINT>& ids)
+	{
+		XMFLOAT4 p[6];
+		for(UINT i = 0; i < 6; ++i)
+			XMStoreFloat4(&p[i], planes.P[i]);
+
+		for(UINT id = 0; id < (UINT)boxes.size(); ++id)
+		{
+			if( !present[id] )
+				continue;
+
+			const Box& b = boxes[id];
+			bool outside = false;
+			for(UINT i = 0; i < 6 && !outside; ++i)
+			{
+				float dist = b.Center.x*p[i].x + b.Center.y*p[i].y + b.Center.z*p[i].z + p[i].w;
+				float radius = b.Extents.x*fabsf(p[i].x) + b.Extents.y*fabsf(p[i].y) + b.Extents.z*fabsf(p[i].z);
+				outside = dist > radius;
+			}
+			if( !outside )
+				ids.push_back(id);
+		}
+	}
+
+	void FlatSphere(const std::vector<Box>& boxes, const std::vector<char>& present, const XMFLOAT3& c, float r, std::vector<UINT>& ids)
+	{
+		for(UINT id = 0; id < (UINT)boxes.size(); ++id)
+		{
+			const Box& b = boxes[id];
+			float nx = std::max(fabsf(c.x - b.Center.x) - b.Extents.x, 0.0f);
+			float ny = std::max(fabsf(c.y - b.Center.y) - b.Extents.y, 0.0f);
+			float nz = std::max(fabsf(c.z - b.Center.z) - b.Extents.z, 0.0f);
+			if( present[id] && nx*nx + ny*ny + nz*nz <= r*r )
+				ids.push_back(id);
+		}
+	}
+
+	void FlatBox(const std::vector<Box>& boxes, const std::vector<char>& present, const XMFLOAT3& c, const XMFLOAT3& e, std::vector<UINT>& ids)
+	{
+		for(UINT id = 0; id < (UINT)boxes.size(); ++id)
+		{
+			const Box& b = boxes[id];
+			if( present[id] && fabsf(c.x - b.Center.x) <= e.x + b.Extents.x &&
+				fabsf(c.y - b.Center.y) <= e.y + b.Extents.y && fabsf(c.z - b.Center.z) <= e.z + b.Extents.z )
+			{
+				ids.push_back(id);
+			}
+		}
+	}
+
+	bool SameIds(std::vector<UINT> a, std::vector<UINT> b)
+	{
+		std::sort(a.begin(), a.end());
+		std::sort(b.begin(), b.end());
+		return a == b;
+	}
+
+	struct Scene
+	{
+		std::vector<Box> Boxes;
+		std::vector<char> Present;
+		Planes Frustums[PoseCount];
+		XMFLOAT3 QueryCenters[PoseCount];
+		float Side;
+	};
+
+	// Runs every query against the tree and brute force and counts the ones
+	// that differ.
+	UINT Check(const LooseOctree& tree, const Scene& scene)
+	{
+		UINT mismatches = 0;
+		std::vector<UINT> a, b;
+
+		for(UINT k = 0; k < PoseCount; ++k)
+		{
+			a.clear(); b.clear();
+			tree.QueryFrustum(scene.Frustums[k].P, a);
+			FlatFrustum(scene.Boxes, scene.Present, scene.Frustums[k], b);
+			mismatches += SameIds(a, b) ? 0 : 1;
+
+			const XMFLOAT3& c = scene.QueryCenters[k];
+
+			a.clear(); b.clear();
+			tree.QuerySphere(XMLoadFloat3(&c), 50.0f, a);
+			FlatSphere(scene.Boxes, scene.Present, c, 50.0f, b);
+			mismatches += SameIds(a, b) ? 0 : 1;
+
+			a.clear(); b.clear();
+			tree.QueryBox(c, XMFLOAT3(50.0f, 50.0f, 50.0f), a);
+			FlatBox(scene.Boxes, scene.Present, c, XMFLOAT3(50.0f, 50.0f, 50.0f), b);
+			mismatches += SameIds(a, b) ? 0 : 1;
+		}
+
+		return mismatches;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<UINT> counts;
+	for(int i = 1; i < argc; ++i)
+		counts.push_back((UINT)std::max(1, atoi(argv[i])));
+	if( counts.empty() )
+	{
+		counts.push_back(1000);
+		counts.push_back(10000);
+		counts.push_back(100000);
+		counts.push_back(1000000);
+	}
+
+	printf("%-10s %6s %8s %9s %9s %12s %12s %8s %10s %10s %10s %8s\n", "instances", "depth", "nodes", "visible",
+		"build ms", "flat inst/ms", "tree inst/ms", "speedup", "update ns", "sphere us", "box us", "mismatch");
+
+	bool passed = true;
+
+	for(size_t c = 0; c < counts.size(); ++c)
+	{
+		UINT count = counts[c];
+
+		//
+		// Scene.
+		//
+
+		Scene scene;
+		scene.Side = 10.0f*powf((float)count, 1.0f/3.0f);
+		scene.Boxes.resize(count);
+		scene.Present.assign(count, 1);
+
+		UINT random = 86420;
+		for(UINT i = 0; i < count; ++i)
+		{
+			Box& b = scene.Boxes[i];
+			b.Center = XMFLOAT3(scene.Side*(RandF(random) - 0.5f), scene.Side*(RandF(random) - 0.5f), scene.Side*(RandF(random) - 0.5f));
+			b.Extents = XMFLOAT3(3.2f, 3.9f, 3.6f);
+		}
+
+		for(UINT k = 0; k < PoseCount; ++k)
+		{
+			XMVECTOR axis = XMVector3Normalize(XMVectorSet(RandF(random) - 0.5f, RandF(random) - 0.5f, RandF(random) - 0.5f, 0.0f));
+			float angle = XM_2PI*RandF(random);
+			XMVECTOR q = XMVectorSetW(sinf(0.5f*angle)*axis, cosf(0.5f*angle));
+			XMVECTOR eye = XMVectorSet(0.5f*scene.Side*(RandF(random) - 0.5f), 0.5f*scene.Side*(RandF(random) - 0.5f),
+				0.5f*scene.Side*(RandF(random) - 0.5f), 0.0f);
+
+			scene.Frustums[k] = MakeFrustum(eye, q);
+			XMStoreFloat3(&scene.QueryCenters[k], eye);
+		}
+
+		// Deep enough that the smallest cells hold about eight instances.
+		UINT depth = 1;
+		while( depth < 9 && (8u << (3*depth)) < count )
+			++depth;
+
+		//
+		// Build.
+		//
+
+		LooseOctree tree;
+		double start = Now();
+		tree.Reset(XMFLOAT3(0.0f, 0.0f, 0.0f), 0.5f*scene.Side, depth);
+		for(UINT i = 0; i < count; ++i)
+			tree.Insert(i, scene.Boxes[i].Center, scene.Boxes[i].Extents);
+		double buildTime = Now() - start;
+
+		UINT mismatches = Check(tree, scene);
+
+		//
+		// Cull, about a second of the flat loop for every size.
+		//
+
+		UINT frames = std::max(PoseCount, 4000000u / count);
+		std::vector<UINT> ids;
+		ids.reserve(count);
+
+		size_t flatVisible = 0;
+		start = Now();
+		for(UINT f = 0; f < frames; ++f)
+		{
+			ids.clear();
+			FlatFrustum(scene.Boxes, scene.Present, scene.Frustums[f % PoseCount], ids);
+			flatVisible += ids.size();
+		}
+		double flatTime = (Now() - start) / frames;
+
+		size_t treeVisible = 0;
+		start = Now();
+		for(UINT f = 0; f < frames; ++f)
+		{
+			ids.clear();
+			tree.QueryFrustum(scene.Frustums[f % PoseCount].P, ids);
+			treeVisible += ids.size();
+		}
+		double treeTime = (Now() - start) / frames;
+
+		if( treeVisible != flatVisible )
+			++mismatches;
+
+		//
+		// Other queries.
+		//
+
+		UINT queries = std::max(PoseCount, 100000000u / count);
+		start = Now();
+		for(UINT q = 0; q < queries; ++q)
+		{
+			ids.clear();
+			tree.QuerySphere(XMLoadFloat3(&scene.QueryCenters[q % PoseCount]), 50.0f, ids);
+		}
+		double sphereTime = (Now() - start) / queries;
+
+		start = Now();
+		for(UINT q = 0; q < queries; ++q)
+		{
+			ids.clear();
+			tree.QueryBox(scene.QueryCenters[q % PoseCount], XMFLOAT3(50.0f, 50.0f, 50.0f), ids);
+		}
+		double boxTime = (Now() - start) / queries;
+
+		//
+		// Move a tenth of the instances a little, as moving objects would.
+		//
+
+		UINT moves = std::max(1u, count / 10);
+		std::vector<UINT> moved(moves);
+		for(UINT m = 0; m < moves; ++m)
+		{
+			UINT id = (UINT)(RandF(random)*count) % count;
+			moved[m] = id;
+
+			Box& b = scene.Boxes[id];
+			b.Center.x += 2.0f*(RandF(random) - 0.5f);
+			b.Center.y += 2.0f*(RandF(random) - 0.5f);
+			b.Center.z += 2.0f*(RandF(random) - 0.5f);
+		}
+
+		start = Now();
+		for(UINT m = 0; m < moves; ++m)
+			tree.Update(moved[m], scene.Boxes[moved[m]].Center, scene.Boxes[moved[m]].Extents);
+		double updateTime = (Now() - start) / moves;
+
+		mismatches += Check(tree, scene);
+
+		// A few far jumps, some of them out of the cube the tree covers.
+		for(UINT m = 0; m < std::min(count, 64u); ++m)
+		{
+			Box& b = scene.Boxes[m];
+			b.Center = XMFLOAT3(1.5f*scene.Side*(RandF(random) - 0.5f), 1.5f*scene.Side*(RandF(random) - 0.5f),
+				1.5f*scene.Side*(RandF(random) - 0.5f));
+			tree.Update(m, b.Center, b.Extents);
+		}
+		mismatches += Check(tree, scene);
+
+		UINT nodes = tree.GetNodeCount();
+
+		// Remove every other instance.
+		for(UINT i = 0; i < count; i += 2)
+		{
+			tree.Remove(i);
+			scene.Present[i] = 0;
+		}
+		mismatches += Check(tree, scene);
+		if( tree.GetObjectCount() != count / 2 )
+			++mismatches;
+
+		// Removing the rest must give back every node but the root.
+		for(UINT i = 1; i < count; i += 2)
+			tree.Remove(i);
+		if( tree.GetObjectCount() != 0 || tree.GetNodeCount() != 1 )
+			++mismatches;
+
+		printf("%-10u %6u %8u %9u %9.2f %12.0f %12.0f %8.1f %10.1f %10.2f %10.2f %8u\n", count, depth, nodes,
+			(UINT)(flatVisible / frames), buildTime*1000.0, count/(flatTime*1000.0), count/(treeTime*1000.0),
+			flatTime/treeTime, updateTime*1e9, sphereTime*1e6, boxTime*1e6, mismatches);
+
+		if( mismatches > 0 )
+			passed = false;
+	}
+
+	printf("\n%s\n", passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,1068 @@
+#include "MeshBVH.h"
+#include <DirectXCollision.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+	// Leaves hold at most this many triangles.
+	const UINT MaxLeafTriangles = 4;
+
+	// Candidate split planes per axis are the boundaries between this many
+	// equal bins of triangle centroids.
+	const UINT BinCount = 16;
+
+	// Nodes this deep are split at the median instead, which halves the
+	// triangles every level and bounds the depth of the tree, and so the size
+	// of the traversal stack, by MaxDepth.
+	const UINT MaxDepth = 64;
+
+	struct Box
+	{
+		XMFLOAT3 Min;
+		XMFLOAT3 Max;
+
+		void Reset()
+		{
+			Min = XMFLOAT3(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+			Max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		}
+
+		void Grow(const XMFLOAT3& p)
+		{
+			Min = XMFLOAT3(std::min(Min.x, p.x), std::min(Min.y, p.y), std::min(Min.z, p.z));
+			Max = XMFLOAT3(std::max(Max.x, p.x), std::max(Max.y, p.y), std::max(Max.z, p.z));
+		}
+
+		void Grow(const Box& b)
+		{
+			Grow(b.Min);
+			Grow(b.Max);
+		}
+
+		// Half the surface area, which is all the heuristic needs.
+		float HalfArea()const
+		{
+			float dx = Max.x - Min.x;
+			float dy = Max.y - Min.y;
+			float dz = Max.z - Min.z;
+			return dx < 0.0f ? 0.0f : dx*dy + dy*dz + dz*dx;
+		}
+	};
+
+	float Axis(const XMFLOAT3& v, UINT axis)
+	{
+		return (&v.x)[axis];
+	}
+
+	const XMFLOAT3& Position(const XMFLOAT3* positions, UINT vertexStride, UINT i)
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const char*>(positions) + (size_t)i*vertexStride);
+	}
+
+	XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x*b.x + a.y*b.y + a.z*b.z;
+	}
+
+	// Slab test of the ray against [boundsMin, boundsMax] between 0 and
+	// maxDistance.  Axes the ray is parallel to give NaNs or infinities that
+	// the comparisons leave out.
+	bool IntersectBox(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax, const XMFLOAT3& origin,
+					  const XMFLOAT3& invDirection, float maxDistance, float& entry)
+	{
+		float tmin = 0.0f;
+		float tmax = maxDistance;
+
+		for(UINT axis = 0; axis < 3; ++axis)
+		{
+			float t0 = (Axis(boundsMin, axis) - Axis(origin, axis)) * Axis(invDirection, axis);
+			float t1 = (Axis(boundsMax, axis) - Axis(origin, axis)) * Axis(invDirection, axis);
+			if( t0 > t1 )
+				std::swap(t0, t1);
+
+			if( t0 > tmin ) tmin = t0;
+			if( t1 < tmax ) tmax = t1;
+		}
+
+		entry = tmin;
+		return tmin <= tmax;
+	}
+
+	XMFLOAT3 Add(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z);
+	}
+
+	XMFLOAT3 Scale(const XMFLOAT3& a, float s)
+	{
+		return XMFLOAT3(a.x*s, a.y*s, a.z*s);
+	}
+
+	// Point of the triangle v0, v0 + e1, v0 + e2 nearest to p, found from the
+	// Voronoi region of the triangle p lies in.
+	XMFLOAT3 NearestPointOnTriangle(const XMFLOAT3& p, const XMFLOAT3& v0, const XMFLOAT3& e1, const XMFLOAT3& e2)
+	{
+		XMFLOAT3 ap = Subtract(p, v0);
+		float d1 = Dot(e1, ap);
+		float d2 = Dot(e2, ap);
+		if( d1 <= 0.0f && d2 <= 0.0f )
+			return v0;
+
+		XMFLOAT3 bp = Subtract(ap, e1);
+		float d3 = Dot(e1, bp);
+		float d4 = Dot(e2, bp);
+		if( d3 >= 0.0f && d4 <= d3 )
+			return Add(v0, e1);
+
+		float vc = d1*d4 - d3*d2;
+		if( vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f )
+			return Add(v0, Scale(e1, d1 / (d1 - d3)));
+
+		XMFLOAT3 cp = Subtract(ap, e2);
+		float d5 = Dot(e1, cp);
+		float d6 = Dot(e2, cp);
+		if( d6 >= 0.0f && d5 <= d6 )
+			return Add(v0, e2);
+
+		float vb = d5*d2 - d1*d6;
+		if( vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f )
+			return Add(v0, Scale(e2, d2 / (d2 - d6)));
+
+		float va = d3*d6 - d5*d4;
+		if( va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f )
+		{
+			XMFLOAT3 e3 = Subtract(e2, e1);
+			return Add(Add(v0, e1), Scale(e3, (d4 - d3) / ((d4 - d3) + (d5 - d6))));
+		}
+
+		float denom = 1.0f / (va + vb + vc);
+		return Add(v0, Add(Scale(e1, vb*denom), Scale(e2, vc*denom)));
+	}
+
+	//
+	// Sweeps of a sphere moving from center along velocity, which find the
+	// first time in [0, time] at which it touches a point, a segment or a
+	// triangle it is not touching at the start.  On a hit they lower time.
+	//
+
+	bool SweepSpherePoint(const XMFLOAT3& center, const XMFLOAT3& velocity, float radius,
+						  const XMFLOAT3& point, float& time)
+	{
+		// |m + t*velocity|^2 = radius^2, taking the smaller root.
+		XMFLOAT3 m = Subtract(center, point);
+		float b = Dot(m, velocity);
+		if( b >= 0.0f )
+			return false;
+
+		float a = Dot(velocity, velocity);
+		float c = Dot(m, m) - radius*radius;
+		float discriminant = b*b - a*c;
+		if( discriminant < 0.0f )
+			return false;
+
+		float t = (-b - sqrtf(discriminant)) / a;
+		if( t > time )
+			return false;
+
+		time = std::max(t, 0.0f);
+		return true;
+	}
+
+	// The segment a, a + d without its end points, as a cylinder of the
+	// sphere's radius around it.  Returns where along the segment it is touched.
+	bool SweepSphereSegment(const XMFLOAT3& center, const XMFLOAT3& velocity, float radius,
+							const XMFLOAT3& a, const XMFLOAT3& d, float& time, float& param)
+	{
+		// The same quadratic as for a point, in the plane across the segment and
+		// scaled by d.d.
+		XMFLOAT3 m = Subtract(center, a);
+		float dd = Dot(d, d);
+		float md = Dot(m, d);
+		float vd = Dot(velocity, d);
+
+		float qa = dd*Dot(velocity, velocity) - vd*vd;
+		float qb = dd*Dot(m, velocity) - md*vd;
+		float qc = dd*(Dot(m, m) - radius*radius) - md*md;
+
+		// Moving along the line or away from it, or already within the radius
+		// of the line, so that an end point is touched first.
+		if( qa <= 0.0f || qb >= 0.0f || qc <= 0.0f )
+			return false;
+
+		float discriminant = qb*qb - qa*qc;
+		if( discriminant < 0.0f )
+			return false;
+
+		float t = (-qb - sqrtf(discriminant)) / qa;
+		if( t > time )
+			return false;
+
+		float s = (md + t*vd) / dd;
+		if( s < 0.0f || s > 1.0f )
+			return false;
+
+		time = t;
+		param = s;
+		return true;
+	}
+
+	// Either side of the triangle v0, v0 + e1, v0 + e2.  A sphere touching it
+	// at the start hits at time 0.  Returns the point touched.
+	bool SweepSphereTriangle(const XMFLOAT3& center, const XMFLOAT3& velocity, float radius,
+							 const XMFLOAT3& v0, const XMFLOAT3& e1, const XMFLOAT3& e2,
+							 float& time, XMFLOAT3& point)
+	{
+		// A sphere that reaches the plane inside the triangle touches the face
+		// first, and one that does not reach the plane misses.  Only a sphere
+		// that already cuts the plane can touch the triangle at the start.
+		bool cutsPlane = true;
+		XMFLOAT3 normal = Cross(e1, e2);
+		float length = sqrtf(Dot(normal, normal));
+		if( length > 0.0f )
+		{
+			normal = Scale(normal, 1.0f / length);
+			float distance = Dot(Subtract(center, v0), normal);
+			float speed = Dot(velocity, normal);
+			if( distance < 0.0f )
+			{
+				normal = Scale(normal, -1.0f);
+				distance = -distance;
+				speed = -speed;
+			}
+
+			if( distance > radius )
+			{
+				if( speed >= 0.0f || distance - radius > -speed*time )
+					return false;
+
+				float t = (distance - radius) / -speed;
+				XMFLOAT3 p = Subtract(Add(center, Scale(velocity, t)), Scale(normal, radius));
+
+				// Barycentric coordinates of p.
+				XMFLOAT3 w = Subtract(p, v0);
+				float d00 = Dot(e1, e1);
+				float d01 = Dot(e1, e2);
+				float d11 = Dot(e2, e2);
+				float d20 = Dot(w, e1);
+				float d21 = Dot(w, e2);
+				float denom = d00*d11 - d01*d01;
+				float u = (d11*d20 - d01*d21) / denom;
+				float v = (d00*d21 - d01*d20) / denom;
+				if( u >= 0.0f && v >= 0.0f && u + v <= 1.0f )
+				{
+					time = t;
+					point = p;
+					return true;
+				}
+
+				cutsPlane = false;
+			}
+		}
+
+		if( cutsPlane )
+		{
+			XMFLOAT3 nearest = NearestPointOnTriangle(center, v0, e1, e2);
+			XMFLOAT3 offset = Subtract(center, nearest);
+			if( Dot(offset, offset) <= radius*radius )
+			{
+				time = 0.0f;
+				point = nearest;
+				return true;
+			}
+		}
+
+		// Otherwise the sphere first touches an edge or a corner.
+		XMFLOAT3 v1 = Add(v0, e1);
+		XMFLOAT3 v2 = Add(v0, e2);
+		bool found = false;
+		float s;
+
+		if( SweepSphereSegment(center, velocity, radius, v0, e1, time, s) )
+		{
+			point = Add(v0, Scale(e1, s));
+			found = true;
+		}
+		if( SweepSphereSegment(center, velocity, radius, v0, e2, time, s) )
+		{
+			point = Add(v0, Scale(e2, s));
+			found = true;
+		}
+		XMFLOAT3 e3 = Subtract(e2, e1);
+		if( SweepSphereSegment(center, velocity, radius, v1, e3, time, s) )
+		{
+			point = Add(v1, Scale(e3, s));
+			found = true;
+		}
+
+		if( SweepSpherePoint(center, velocity, radius, v0, time) )
+		{
+			point = v0;
+			found = true;
+		}
+		if( SweepSpherePoint(center, velocity, radius, v1, time) )
+		{
+			point = v1;
+			found = true;
+		}
+		if( SweepSpherePoint(center, velocity, radius, v2, time) )
+		{
+			point = v2;
+			found = true;
+		}
+
+		return found;
+	}
+
+	// Separating axis test between the bounds of a node of one tree and a node
+	// of another, placed in the first one's space by a fixed rotation, uniform
+	// scale and translation, after Gottschalk's OBBTree.  The second box is an
+	// oriented box there; since every pair of nodes shares the rotation, the
+	// terms of the 15 axes that depend on it are set up once.
+	struct BoxOverlapTest
+	{
+		// R[i][j] is axis j of the other space along axis i of this one.
+		float R[3][3];
+
+		// |R| grown a little, so that nearly parallel axes, whose cross
+		// products are nearly zero, do not reject boxes that overlap.
+		float AbsR[3][3];
+
+		float Scale;
+		XMFLOAT4X4 Transform;
+
+		void Set(FXMMATRIX otherToThis)
+		{
+			XMStoreFloat4x4(&Transform, otherToThis);
+
+			// Row j of the matrix is axis j of the other space, scaled.
+			Scale = sqrtf(Transform.m[0][0]*Transform.m[0][0] + Transform.m[0][1]*Transform.m[0][1] +
+				Transform.m[0][2]*Transform.m[0][2]);
+			assert(Scale > 0.0f);
+
+			for(UINT i = 0; i < 3; ++i)
+			{
+				for(UINT j = 0; j < 3; ++j)
+				{
+					R[i][j] = Transform.m[j][i] / Scale;
+					AbsR[i][j] = fabsf(R[i][j]) + 1e-6f;
+				}
+			}
+		}
+
+		bool Overlaps(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax,
+					  const XMFLOAT3& otherMin, const XMFLOAT3& otherMax)const
+		{
+			float a[3] = { 0.5f*(boundsMax.x - boundsMin.x), 0.5f*(boundsMax.y - boundsMin.y), 0.5f*(boundsMax.z - boundsMin.z) };
+			float b[3] = { 0.5f*Scale*(otherMax.x - otherMin.x), 0.5f*Scale*(otherMax.y - otherMin.y), 0.5f*Scale*(otherMax.z - otherMin.z) };
+
+			// The offset between the centers, along the axes of this space.
+			XMFLOAT3 c(0.5f*(otherMin.x + otherMax.x), 0.5f*(otherMin.y + otherMax.y), 0.5f*(otherMin.z + otherMax.z));
+			float t[3];
+			for(UINT i = 0; i < 3; ++i)
+			{
+				t[i] = c.x*Transform.m[0][i] + c.y*Transform.m[1][i] + c.z*Transform.m[2][i] + Transform.m[3][i] -
+					0.5f*(Axis(boundsMin, i) + Axis(boundsMax, i));
+			}
+
+			// The axes of this box, then of the other.
+			for(UINT i = 0; i < 3; ++i)
+			{
+				if( fabsf(t[i]) > a[i] + b[0]*AbsR[i][0] + b[1]*AbsR[i][1] + b[2]*AbsR[i][2] )
+					return false;
+			}
+
+			for(UINT j = 0; j < 3; ++j)
+			{
+				float d = t[0]*R[0][j] + t[1]*R[1][j] + t[2]*R[2][j];
+				if( fabsf(d) > a[0]*AbsR[0][j] + a[1]*AbsR[1][j] + a[2]*AbsR[2][j] + b[j] )
+					return false;
+			}
+
+			// The cross products of an axis of each.
+			for(UINT i = 0; i < 3; ++i)
+			{
+				UINT i1 = (i + 1) % 3;
+				UINT i2 = (i + 2) % 3;
+				for(UINT j = 0; j < 3; ++j)
+				{
+					UINT j1 = (j + 1) % 3;
+					UINT j2 = (j + 2) % 3;
+
+					float ra = a[i1]*AbsR[i2][j] + a[i2]*AbsR[i1][j];
+					float rb = b[j1]*AbsR[i][j2] + b[j2]*AbsR[i][j1];
+					if( fabsf(t[i2]*R[i1][j] - t[i1]*R[i2][j]) > ra + rb )
+						return false;
+				}
+			}
+
+			return true;
+		}
+	};
+}
+
+struct MeshBVH::BuildTriangle
+{
+	Box Bounds;
+	XMFLOAT3 Centroid;
+	UINT Index;
+};
+
+MeshBVH::MeshBVH()
+{
+}
+
+void MeshBVH::Build(const XMFLOAT3* positions, UINT vertexCount, UINT vertexStride,
+					const UINT* indices, UINT triangleCount)
+{
+	mNodes.clear();
+	mTriangles.clear();
+	mTriangleIndices.clear();
+	mIndices.clear();
+
+	if( triangleCount == 0 )
+		return;
+
+	std::vector<BuildTriangle> triangles(triangleCount);
+	for(UINT k = 0; k < triangleCount; ++k)
+	{
+		BuildTriangle& tri = triangles[k];
+		tri.Bounds.Reset();
+		for(UINT corner = 0; corner < 3; ++corner)
+		{
+			assert(indices[3*k + corner] < vertexCount);
+			tri.Bounds.Grow(Position(positions, vertexStride, indices[3*k + corner]));
+		}
+
+		tri.Centroid = XMFLOAT3(
+			0.5f*(tri.Bounds.Min.x + tri.Bounds.Max.x),
+			0.5f*(tri.Bounds.Min.y + tri.Bounds.Max.y),
+			0.5f*(tri.Bounds.Min.z + tri.Bounds.Max.z));
+		tri.Index = k;
+	}
+
+	// A binary tree with leaves of at least one triangle.
+	mNodes.reserve(2*triangleCount - 1);
+	BuildNode(triangles, 0, triangleCount, 0);
+
+	// Copy the triangles into leaf order.
+	mTriangles.resize(triangleCount);
+	mTriangleIndices.resize(triangleCount);
+	mIndices.resize(3*triangleCount);
+	for(UINT k = 0; k < triangleCount; ++k)
+	{
+		UINT index = triangles[k].Index;
+		mTriangleIndices[k] = index;
+		mIndices[3*k + 0] = indices[3*index + 0];
+		mIndices[3*k + 1] = indices[3*index + 1];
+		mIndices[3*k + 2] = indices[3*index + 2];
+		SetTriangle(k, positions, vertexStride);
+	}
+}
+
+void MeshBVH::Build(const GeometryGenerator::MeshData& meshData)
+{
+	if( meshData.Vertices.empty() || meshData.Indices.empty() )
+	{
+		Build(0, 0, 0, 0, 0);
+		return;
+	}
+
+	Build(&meshData.Vertices[0].Position, (UINT)meshData.Vertices.size(), sizeof(GeometryGenerator::Vertex),
+		&meshData.Indices[0], (UINT)meshData.Indices.size() / 3);
+}
+
+UINT MeshBVH::BuildNode(std::vector<BuildTriangle>& triangles, UINT first, UINT last, UINT depth)
+{
+	UINT nodeIndex = (UINT)mNodes.size();
+	mNodes.push_back(Node());
+
+	Box bounds, centroidBounds;
+	bounds.Reset();
+	centroidBounds.Reset();
+	for(UINT k = first; k < last; ++k)
+	{
+		bounds.Grow(triangles[k].Bounds);
+		centroidBounds.Grow(triangles[k].Centroid);
+	}
+
+	mNodes[nodeIndex].BoundsMin = bounds.Min;
+	mNodes[nodeIndex].BoundsMax = bounds.Max;
+
+	UINT count = last - first;
+	if( count <= MaxLeafTriangles )
+	{
+		mNodes[nodeIndex].Offset = first;
+		mNodes[nodeIndex].Count = count;
+		return nodeIndex;
+	}
+
+	//
+	// Sort the centroids into bins along each axis and price every boundary
+	// between bins as a split: a ray that hits this node hits a child with
+	// probability proportional to the child's surface area, and then tests
+	// its triangles.
+	//
+
+	float bestCost = FLT_MAX;
+	UINT bestAxis = 0;
+	UINT bestSplit = 0;
+
+	for(UINT axis = 0; axis < 3 && depth < MaxDepth/2; ++axis)
+	{
+		float axisMin = Axis(centroidBounds.Min, axis);
+		float extent = Axis(centroidBounds.Max, axis) - axisMin;
+		if( extent <= 0.0f )
+			continue;
+
+		Box binBounds[BinCount];
+		UINT binCounts[BinCount] = {};
+		for(UINT b = 0; b < BinCount; ++b)
+			binBounds[b].Reset();
+
+		float scale = BinCount / extent;
+		for(UINT k = first; k < last; ++k)
+		{
+			UINT b = std::min((UINT)((Axis(triangles[k].Centroid, axis) - axisMin)*scale), BinCount - 1);
+			binBounds[b].Grow(triangles[k].Bounds);
+			++binCounts[b];
+		}
+
+		// Costs of everything left of boundary b, bins 0 to b-1.
+		float leftCosts[BinCount];
+		Box left;
+		left.Reset();
+		UINT leftCount = 0;
+		for(UINT b = 1; b < BinCount; ++b)
+		{
+			left.Grow(binBounds[b-1]);
+			leftCount += binCounts[b-1];
+			leftCosts[b] = leftCount*left.HalfArea();
+		}
+
+		Box right;
+		right.Reset();
+		UINT rightCount = 0;
+		for(UINT b = BinCount - 1; b > 0; --b)
+		{
+			right.Grow(binBounds[b]);
+			rightCount += binCounts[b];
+
+			float cost = leftCosts[b] + rightCount*right.HalfArea();
+			if( rightCount < count && rightCount > 0 && cost < bestCost )
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b;
+			}
+		}
+	}
+
+	UINT middle;
+	if( bestCost < FLT_MAX )
+	{
+		float axisMin = Axis(centroidBounds.Min, bestAxis);
+		float scale = BinCount / (Axis(centroidBounds.Max, bestAxis) - axisMin);
+		BuildTriangle* split = std::partition(&triangles[0] + first, &triangles[0] + last,
+			[=](const BuildTriangle& tri)
+			{
+				return std::min((UINT)((Axis(tri.Centroid, bestAxis) - axisMin)*scale), BinCount - 1) < bestSplit;
+			});
+		middle = (UINT)(split - &triangles[0]);
+	}
+	else
+	{
+		// Every centroid is in the same place, or the tree is already deep:
+		// halve the triangles along the widest axis.
+		XMFLOAT3 extent = Subtract(centroidBounds.Max, centroidBounds.Min);
+		UINT axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+		middle = first + count/2;
+		std::nth_element(&triangles[0] + first, &triangles[0] + middle, &triangles[0] + last,
+			[=](const BuildTriangle& a, const BuildTriangle& b)
+			{
+				return Axis(a.Centroid, axis) < Axis(b.Centroid, axis);
+			});
+	}
+
+	// The left child is built first, so it lands right after this node.
+	BuildNode(triangles, first, middle, depth + 1);
+	UINT right = BuildNode(triangles, middle, last, depth + 1);
+
+	mNodes[nodeIndex].Offset = right;
+	mNodes[nodeIndex].Count = 0;
+	return nodeIndex;
+}
+
+void MeshBVH::SetTriangle(UINT k, const XMFLOAT3* positions, UINT vertexStride)
+{
+	const XMFLOAT3& v0 = Position(positions, vertexStride, mIndices[3*k + 0]);
+	const XMFLOAT3& v1 = Position(positions, vertexStride, mIndices[3*k + 1]);
+	const XMFLOAT3& v2 = Position(positions, vertexStride, mIndices[3*k + 2]);
+
+	mTriangles[k].V0 = v0;
+	mTriangles[k].E1 = Subtract(v1, v0);
+	mTriangles[k].E2 = Subtract(v2, v0);
+}
+
+void MeshBVH::Refit(const XMFLOAT3* positions, UINT vertexStride)
+{
+	for(UINT k = 0; k < (UINT)mTriangles.size(); ++k)
+		SetTriangle(k, positions, vertexStride);
+
+	// Children come after their parents, so walking the nodes backwards
+	// visits both children of a node before the node itself.
+	for(UINT n = (UINT)mNodes.size(); n-- > 0; )
+	{
+		Node& node = mNodes[n];
+
+		Box bounds;
+		bounds.Reset();
+
+		if( node.Count > 0 )
+		{
+			for(UINT k = 3*node.Offset; k < 3*(node.Offset + node.Count); ++k)
+				bounds.Grow(Position(positions, vertexStride, mIndices[k]));
+		}
+		else
+		{
+			const Node& left = mNodes[n + 1];
+			const Node& right = mNodes[node.Offset];
+			bounds.Grow(left.BoundsMin);
+			bounds.Grow(left.BoundsMax);
+			bounds.Grow(right.BoundsMin);
+			bounds.Grow(right.BoundsMax);
+		}
+
+		node.BoundsMin = bounds.Min;
+		node.BoundsMax = bounds.Max;
+	}
+}
+
+void MeshBVH::Refit(const GeometryGenerator::MeshData& meshData)
+{
+	if( !meshData.Vertices.empty() )
+		Refit(&meshData.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
+}
+
+bool MeshBVH::IntersectRay(FXMVECTOR origin, FXMVECTOR direction, Hit* hit, float maxDistance)const
+{
+	assert(hit);
+	return Traverse<false>(origin, direction, hit, maxDistance);
+}
+
+bool MeshBVH::IntersectRayAny(FXMVECTOR origin, FXMVECTOR direction, float maxDistance)const
+{
+	return Traverse<true>(origin, direction, 0, maxDistance);
+}
+
+bool MeshBVH::SweepSphere(FXMVECTOR center, float radius, FXMVECTOR velocity, SweepHit* hit, float maxTime)const
+{
+	assert(hit);
+	return TraverseSweep<false>(center, radius, velocity, hit, maxTime);
+}
+
+bool MeshBVH::IntersectSphere(FXMVECTOR center, float radius)const
+{
+	return TraverseSweep<true>(center, radius, XMVectorZero(), 0, 0.0f);
+}
+
+bool MeshBVH::IntersectMesh(const MeshBVH& other, FXMMATRIX otherToThis, std::vector<TrianglePair>& pairs)const
+{
+	return TraverseMesh<false>(other, otherToThis, &pairs);
+}
+
+bool MeshBVH::IntersectMeshAny(const MeshBVH& other, FXMMATRIX otherToThis)const
+{
+	return TraverseMesh<true>(other, otherToThis, 0);
+}
+
+void MeshBVH::GetBounds(XMFLOAT3& boundsMin, XMFLOAT3& boundsMax)const
+{
+	if( mNodes.empty() )
+	{
+		boundsMin = boundsMax = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		return;
+	}
+
+	boundsMin = mNodes[0].BoundsMin;
+	boundsMax = mNodes[0].BoundsMax;
+}
+
+template<bool AnyHit>
+bool MeshBVH::Traverse(FXMVECTOR origin, FXMVECTOR direction, Hit* hit, float maxDistance)const
+{
+	if( mNodes.empty() )
+		return false;
+
+	XMFLOAT3 o, d;
+	XMStoreFloat3(&o, origin);
+	XMStoreFloat3(&d, direction);
+	XMFLOAT3 invD(1.0f / d.x, 1.0f / d.y, 1.0f / d.z);
+
+	float closest = maxDistance;
+	bool found = false;
+
+	float entry;
+	if( !IntersectBox(mNodes[0].BoundsMin, mNodes[0].BoundsMax, o, invD, closest, entry) )
+		return false;
+
+	// Nodes still to visit, with the distance at which the ray enters them.
+	struct StackEntry
+	{
+		UINT Node;
+		float Entry;
+	};
+	StackEntry stack[MaxDepth];
+	UINT stackSize = 0;
+
+	UINT n = 0;
+	for(;;)
+	{
+		const Node& node = mNodes[n];
+
+		if( node.Count > 0 )
+		{
+			for(UINT k = node.Offset; k < node.Offset + node.Count; ++k)
+			{
+				// Moller-Trumbore, taking both sides of the triangle like the
+				// per-triangle loop Pick() used before the tree.
+				const Triangle& tri = mTriangles[k];
+
+				XMFLOAT3 p = Cross(d, tri.E2);
+				float det = Dot(tri.E1, p);
+				if( fabsf(det) < 1e-20f )
+					continue;
+				float invDet = 1.0f / det;
+
+				XMFLOAT3 s = Subtract(o, tri.V0);
+				float u = Dot(s, p) * invDet;
+				if( u < 0.0f || u > 1.0f )
+					continue;
+
+				XMFLOAT3 q = Cross(s, tri.E1);
+				float v = Dot(d, q) * invDet;
+				if( v < 0.0f || u + v > 1.0f )
+					continue;
+
+				float t = Dot(tri.E2, q) * invDet;
+				if( t < 0.0f || t >= closest )
+					continue;
+
+				if( AnyHit )
+					return true;
+
+				closest = t;
+				found = true;
+				hit->Triangle = mTriangleIndices[k];
+				hit->Distance = t;
+				hit->U = u;
+				hit->V = v;
+			}
+		}
+		else
+		{
+			UINT left = n + 1;
+			UINT right = node.Offset;
+
+			float leftEntry, rightEntry;
+			bool hitLeft = IntersectBox(mNodes[left].BoundsMin, mNodes[left].BoundsMax, o, invD, closest, leftEntry);
+			bool hitRight = IntersectBox(mNodes[right].BoundsMin, mNodes[right].BoundsMax, o, invD, closest, rightEntry);
+
+			if( hitLeft && hitRight )
+			{
+				// Nearer child first, so closer hits cut the other one short.
+				if( rightEntry < leftEntry )
+				{
+					std::swap(left, right);
+					std::swap(leftEntry, rightEntry);
+				}
+
+				assert(stackSize < MaxDepth);
+				stack[stackSize].Node = right;
+				stack[stackSize].Entry = rightEntry;
+				++stackSize;
+
+				n = left;
+				continue;
+			}
+
+			if( hitLeft || hitRight )
+			{
+				n = hitLeft ? left : right;
+				continue;
+			}
+		}
+
+		// Skip nodes that start beyond the closest hit found since they were
+		// pushed.
+		for(;;)
+		{
+			if( stackSize == 0 )
+				return found;
+
+			--stackSize;
+			if( stack[stackSize].Entry <= closest )
+				break;
+		}
+
+		n = stack[stackSize].Node;
+	}
+}
+
+template<bool AnyHit>
+bool MeshBVH::TraverseSweep(FXMVECTOR center, float radius, FXMVECTOR velocity, SweepHit* hit, float maxTime)const
+{
+	if( mNodes.empty() )
+		return false;
+
+	// The center of the sphere moves like a ray; the boxes it can hit are the
+	// node bounds grown by the radius.  A sphere that does not move gets
+	// infinite or NaN slabs, which the box test takes as covering it where its
+	// center is inside them.
+	XMFLOAT3 c, v;
+	XMStoreFloat3(&c, center);
+	XMStoreFloat3(&v, velocity);
+	XMFLOAT3 invV(1.0f / v.x, 1.0f / v.y, 1.0f / v.z);
+	XMFLOAT3 grow(radius, radius, radius);
+
+	float closest = maxTime;
+	bool found = false;
+	UINT closestTriangle = 0;
+	XMFLOAT3 closestPoint;
+
+	float entry;
+	if( !IntersectBox(Subtract(mNodes[0].BoundsMin, grow), Add(mNodes[0].BoundsMax, grow), c, invV, closest, entry) )
+		return false;
+
+	struct StackEntry
+	{
+		UINT Node;
+		float Entry;
+	};
+	StackEntry stack[MaxDepth];
+	UINT stackSize = 0;
+
+	UINT n = 0;
+	for(;;)
+	{
+		const Node& node = mNodes[n];
+
+		if( node.Count > 0 )
+		{
+			for(UINT k = node.Offset; k < node.Offset + node.Count; ++k)
+			{
+				const Triangle& tri = mTriangles[k];
+				if( !SweepSphereTriangle(c, v, radius, tri.V0, tri.E1, tri.E2, closest, closestPoint) )
+					continue;
+
+				if( AnyHit )
+					return true;
+
+				found = true;
+				closestTriangle = k;
+			}
+		}
+		else
+		{
+			UINT left = n + 1;
+			UINT right = node.Offset;
+
+			float leftEntry, rightEntry;
+			bool hitLeft = IntersectBox(Subtract(mNodes[left].BoundsMin, grow), Add(mNodes[left].BoundsMax, grow),
+				c, invV, closest, leftEntry);
+			bool hitRight = IntersectBox(Subtract(mNodes[right].BoundsMin, grow), Add(mNodes[right].BoundsMax, grow),
+				c, invV, closest, rightEntry);
+
+			if( hitLeft && hitRight )
+			{
+				if( rightEntry < leftEntry )
+				{
+					std::swap(left, right);
+					std::swap(leftEntry, rightEntry);
+				}
+
+				assert(stackSize < MaxDepth);
+				stack[stackSize].Node = right;
+				stack[stackSize].Entry = rightEntry;
+				++stackSize;
+
+				n = left;
+				continue;
+			}
+
+			if( hitLeft || hitRight )
+			{
+				n = hitLeft ? left : right;
+				continue;
+			}
+		}
+
+		// Skip nodes the sphere enters after the first hit found since they
+		// were pushed.
+		while( stackSize > 0 && stack[stackSize - 1].Entry > closest )
+			--stackSize;
+
+		if( stackSize == 0 )
+			break;
+
+		n = stack[--stackSize].Node;
+	}
+
+	if( !found )
+		return false;
+
+	// The normal at the point touched points to the center of the sphere
+	// there.  A sphere of no radius touches at its center; use the side of the
+	// triangle it came from.
+	const Triangle& tri = mTriangles[closestTriangle];
+	XMFLOAT3 toCenter = Subtract(Add(c, Scale(v, closest)), closestPoint);
+	float length = sqrtf(Dot(toCenter, toCenter));
+	if( length <= 1e-6f*radius || length == 0.0f )
+	{
+		toCenter = Cross(tri.E1, tri.E2);
+		if( Dot(toCenter, Subtract(c, tri.V0)) < 0.0f )
+			toCenter = Scale(toCenter, -1.0f);
+		length = sqrtf(Dot(toCenter, toCenter));
+	}
+
+	hit->Triangle = mTriangleIndices[closestTriangle];
+	hit->Time = closest;
+	hit->Point = closestPoint;
+	hit->Normal = Scale(toCenter, 1.0f / length);
+	return true;
+}
+
+template<bool AnyHit>
+bool MeshBVH::TraverseMesh(const MeshBVH& other, FXMMATRIX otherToThis, std::vector<TrianglePair>* pairs)const
+{
+	if( mNodes.empty() || other.mNodes.empty() )
+		return false;
+
+	BoxOverlapTest test;
+	test.Set(otherToThis);
+
+	if( !test.Overlaps(mNodes[0].BoundsMin, mNodes[0].BoundsMax, other.mNodes[0].BoundsMin, other.mNodes[0].BoundsMax) )
+		return false;
+
+	// Pairs of nodes still to visit.  Each step replaces a pair with at most
+	// two that go one level deeper in one of the trees, so the stack holds no
+	// more than the depths of both trees together.
+	struct StackEntry
+	{
+		UINT Node;
+		UINT OtherNode;
+	};
+	StackEntry stack[2*MaxDepth];
+	UINT stackSize = 0;
+
+	bool found = false;
+
+	UINT n = 0;
+	UINT otherN = 0;
+	for(;;)
+	{
+		const Node& node = mNodes[n];
+		const Node& otherNode = other.mNodes[otherN];
+
+		if( node.Count > 0 && otherNode.Count > 0 )
+		{
+			// The other leaf's triangles, moved into this space.
+			XMVECTOR otherVertices[MaxLeafTriangles][3];
+			for(UINT k = 0; k < otherNode.Count; ++k)
+			{
+				const Triangle& tri = other.mTriangles[otherNode.Offset + k];
+				XMVECTOR v0 = XMVector3Transform(XMLoadFloat3(&tri.V0), otherToThis);
+				otherVertices[k][0] = v0;
+				otherVertices[k][1] = v0 + XMVector3TransformNormal(XMLoadFloat3(&tri.E1), otherToThis);
+				otherVertices[k][2] = v0 + XMVector3TransformNormal(XMLoadFloat3(&tri.E2), otherToThis);
+			}
+
+			for(UINT k = node.Offset; k < node.Offset + node.Count; ++k)
+			{
+				const Triangle& tri = mTriangles[k];
+				XMVECTOR v0 = XMLoadFloat3(&tri.V0);
+				XMVECTOR v1 = v0 + XMLoadFloat3(&tri.E1);
+				XMVECTOR v2 = v0 + XMLoadFloat3(&tri.E2);
+
+				for(UINT j = 0; j < otherNode.Count; ++j)
+				{
+					if( !TriangleTests::Intersects(v0, v1, v2, otherVertices[j][0], otherVertices[j][1], otherVertices[j][2]) )
+						continue;
+
+					if( AnyHit )
+						return true;
+
+					TrianglePair pair;
+					pair.Triangle = mTriangleIndices[k];
+					pair.OtherTriangle = other.mTriangleIndices[otherNode.Offset + j];
+					pairs->push_back(pair);
+					found = true;
+				}
+			}
+		}
+		else
+		{
+			// Open the node that is not a leaf, or the larger of the two, so
+			// that the boxes tested stay about the same size.
+			Box box = { node.BoundsMin, node.BoundsMax };
+			Box otherBox = { otherNode.BoundsMin, otherNode.BoundsMax };
+			bool openThis = otherNode.Count > 0 ||
+				(node.Count == 0 && box.HalfArea() >= otherBox.HalfArea()*test.Scale*test.Scale);
+
+			StackEntry children[2];
+			if( openThis )
+			{
+				children[0].Node = n + 1;
+				children[1].Node = node.Offset;
+				children[0].OtherNode = children[1].OtherNode = otherN;
+			}
+			else
+			{
+				children[0].OtherNode = otherN + 1;
+				children[1].OtherNode = otherNode.Offset;
+				children[0].Node = children[1].Node = n;
+			}
+
+			bool overlaps[2];
+			for(UINT c = 0; c < 2; ++c)
+			{
+				const Node& a = mNodes[children[c].Node];
+				const Node& b = other.mNodes[children[c].OtherNode];
+				overlaps[c] = test.Overlaps(a.BoundsMin, a.BoundsMax, b.BoundsMin, b.BoundsMax);
+			}
+
+			if( overlaps[0] && overlaps[1] )
+			{
+				assert(stackSize < 2*MaxDepth);
+				stack[stackSize++] = children[1];
+			}
+
+			if( overlaps[0] || overlaps[1] )
+			{
+				const StackEntry& next = children[overlaps[0] ? 0 : 1];
+				n = next.Node;
+				otherN = next.OtherNode;
+				continue;
+			}
+		}
+
+		if( stackSize == 0 )
+			return found;
+
+		--stackSize;
+		n = stack[stackSize].Node;
+		otherN = stack[stackSize].OtherNode;
+	}
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <Windows.h>
+#include <directxmath.h>
+#include <cfloat>
+#include <vector>
+#include "GeometryGenerator.h"
+
+using namespace DirectX;
+
+///<summary>
+/// Bounding volume hierarchy over the triangles of an indexed mesh, for ray
+/// and sphere queries that visit a few dozen triangles instead of all of them,
+/// and for finding where two meshes intersect.
+///
+/// The tree is built top down, splitting each node where the surface area
+/// heuristic says rays will do the least work.  Nodes are stored depth first in
+/// one array, so the left child of a node is the node after it and only the
+/// right child needs an index; the triangles are copied into leaf order next to
+/// them.  When the vertices of an animated mesh move, Refit updates the bounds
+/// without rebuilding the tree.
+///
+/// Queries are const and can run on several threads at once.
+///</summary>
+class MeshBVH
+{
+public:
+	struct Hit
+	{
+		// Index of the triangle in the mesh, as in indices[3*Triangle].
+		UINT Triangle;
+
+		// Distance along the ray, in units of the ray direction.
+		float Distance;
+
+		// Barycentric coordinates of the hit point: V0 + U*(V1-V0) + V*(V2-V0).
+		float U;
+		float V;
+	};
+
+	struct SweepHit
+	{
+		// Index of the triangle in the mesh, as in indices[3*Triangle].
+		UINT Triangle;
+
+		// Fraction of the velocity the sphere moves before it touches the
+		// triangle, 0 if it touches at the start.
+		float Time;
+
+		// The point of the triangle the sphere touches, and the unit normal
+		// there, pointing from the triangle to the center of the sphere.
+		XMFLOAT3 Point;
+		XMFLOAT3 Normal;
+	};
+
+	struct TrianglePair
+	{
+		// Index of a triangle of this mesh and of one of the other mesh that
+		// it intersects.
+		UINT Triangle;
+		UINT OtherTriangle;
+	};
+
+public:
+	MeshBVH();
+
+	// The position of vertex i is read from (const char*)positions + i*vertexStride,
+	// so positions can point into an array of vertex structures.
+	void Build(const XMFLOAT3* positions, UINT vertexCount, UINT vertexStride,
+		const UINT* indices, UINT triangleCount);
+	void Build(const GeometryGenerator::MeshData& meshData);
+
+	// Moves the triangles to new vertex positions, with the indices given to
+	// Build, and recomputes the bounds of every node.  The tree keeps its shape,
+	// so rays slow down if the mesh deforms a lot; build it again then.
+	void Refit(const XMFLOAT3* positions, UINT vertexStride);
+	void Refit(const GeometryGenerator::MeshData& meshData);
+
+	// Finds the nearest triangle the ray hits closer than maxDistance.  Like the
+	// picking tests, both sides of a triangle count.
+	bool IntersectRay(FXMVECTOR origin, FXMVECTOR direction, Hit* hit,
+		float maxDistance = FLT_MAX)const;
+
+	// Returns true as soon as any triangle is found closer than maxDistance,
+	// which is all a shadow or line of sight test needs.
+	bool IntersectRayAny(FXMVECTOR origin, FXMVECTOR direction,
+		float maxDistance = FLT_MAX)const;
+
+	// Moves a sphere from center to center + maxTime*velocity and finds the
+	// first triangle it touches.  One sweep covers the whole move, so a fast
+	// sphere cannot pass through a thin wall between two positions the way it
+	// can with substeps.  Both sides of a triangle count.
+	bool SweepSphere(FXMVECTOR center, float radius, FXMVECTOR velocity, SweepHit* hit,
+		float maxTime = 1.0f)const;
+
+	// Returns true if the sphere touches any triangle, as for a camera that
+	// must not end up inside the mesh.
+	bool IntersectSphere(FXMVECTOR center, float radius)const;
+
+	// Appends to pairs every triangle of this mesh that intersects a triangle
+	// of other, with both indices, and returns true if there are any.  The
+	// other mesh is placed in the space of this one by otherToThis, which may
+	// rotate, scale alike on every axis and translate, such as the other
+	// mesh's world matrix times the inverse of this one's.  Both trees are
+	// walked together, testing pairs of nodes as oriented boxes, so only the
+	// triangles of leaves that overlap are tested against each other.
+	bool IntersectMesh(const MeshBVH& other, FXMMATRIX otherToThis, std::vector<TrianglePair>& pairs)const;
+
+	// Returns true as soon as any pair is found.
+	bool IntersectMeshAny(const MeshBVH& other, FXMMATRIX otherToThis)const;
+
+	UINT GetTriangleCount()const { return (UINT)mTriangleIndices.size(); }
+	UINT GetNodeCount()const { return (UINT)mNodes.size(); }
+
+	// Bounds of the whole mesh.
+	void GetBounds(XMFLOAT3& boundsMin, XMFLOAT3& boundsMax)const;
+
+private:
+	// 32 bytes, two to a cache line.
+	struct Node
+	{
+		XMFLOAT3 BoundsMin;
+
+		// Interior nodes: index of the right child.  Leaves: the first of their
+		// triangles in leaf order.
+		UINT Offset;
+
+		XMFLOAT3 BoundsMax;
+
+		// Number of triangles in a leaf, 0 for an interior node.
+		UINT Count;
+	};
+
+	// A triangle in leaf order, with the edges the ray test needs.
+	struct Triangle
+	{
+		XMFLOAT3 V0;
+		XMFLOAT3 E1;
+		XMFLOAT3 E2;
+	};
+
+	struct BuildTriangle;
+
+	UINT BuildNode(std::vector<BuildTriangle>& triangles, UINT first, UINT last, UINT depth);
+	void SetTriangle(UINT k, const XMFLOAT3* positions, UINT vertexStride);
+
+	template<bool AnyHit>
+	bool Traverse(FXMVECTOR origin, FXMVECTOR direction, Hit* hit, float maxDistance)const;
+
+	template<bool AnyHit>
+	bool TraverseSweep(FXMVECTOR center, float radius, FXMVECTOR velocity, SweepHit* hit, float maxTime)const;
+
+	template<bool AnyHit>
+	bool TraverseMesh(const MeshBVH& other, FXMMATRIX otherToThis, std::vector<TrianglePair>* pairs)const;
+
+private:
+	std::vector<Node> mNodes;
+
+	// mTriangles[k] is triangle mTriangleIndices[k] of the mesh; its vertices
+	// are mIndices[3k], mIndices[3k+1] and mIndices[3k+2].
+	std::vector<Triangle> mTriangles;
+	std::vector<UINT> mTriangleIndices;
+	std::vector<UINT> mIndices;
+};
@@ -0,0 +1,347 @@
+//***************************************************************************************
+// MeshBVHBenchmark.cpp
+//
+// Headless benchmark of MeshBVH against the loop Pick() used before it, which tests
+// the ray against every triangle of the mesh with IntersectRayTriangle.  For every
+// model it fires the same random rays at the mesh (most hit, some miss) and reports
+//   -the time to build and to refit the tree,
+//   -rays per second for the old loop, the closest hit and the any hit queries,
+// and checks that the closest hits agree with the old loop, before and after the
+// vertices are moved and the tree refit.  Rays that graze an edge shared by two
+// triangles can pick either; those count as agreeing when the distances match.
+// Returns 1 if any ray disagrees.
+//
+// Build with:
+//   cl /EHsc /O2 MeshBVH.cpp MeshBVHBenchmark.cpp
+//
+// Usage: MeshBVHBenchmark [rays [model ...]]      (default 10000 Models/car.txt Models/skull.txt)
+//***************************************************************************************
+
+#include "MeshBVH.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+namespace
+{
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	float RandF(UINT& state)
+	{
+		state = state*1664525u + 1013904223u;
+		return (state >> 8) / 16777216.0f;
+	}
+
+	// Reads the "VertexCount/TriangleCount" text models in Models/.
+	bool LoadModel(const char* filename, std::vector<XMFLOAT3>& positions, std::vector<UINT>& indices)
+	{
+		std::ifstream fin(filename);
+		if( !fin )
+			return false;
+
+		UINT vcount = 0;
+		UINT tcount = 0;
+		std::string ignore;
+
+		fin >> ignore >> vcount;
+		fin >> ignore >> tcount;
+		fin >> ignore >> ignore >> ignore >> ignore;
+
+		positions.resize(vcount);
+		for(UINT i = 0; i < vcount; ++i)
+		{
+			XMFLOAT3 normal;
+			fin >> positions[i].x >> positions[i].y >> positions[i].z;
+			fin >> normal.x >> normal.y >> normal.z;
+		}
+
+		fin >> ignore >> ignore >> ignore;
+
+		indices.resize(3*tcount);
+		for(UINT i = 0; i < 3*tcount; ++i)
+			fin >> indices[i];
+
+		return !fin.fail();
+	}
+
+	//
+	// The test Pick() ran on every triangle, as it was in Picking.cpp.
+	//
+
+	bool IntersectRayTriangle(FXMVECTOR Origin, FXMVECTOR Direction, FXMVECTOR V0, CXMVECTOR V1, CXMVECTOR V2, FLOAT* pDist)
+	{
+		static const XMVECTOR Epsilon =
+		{
+			1e-20f, 1e-20f, 1e-20f, 1e-20f
+		};
+
+		XMVECTOR Zero = XMVectorZero();
+
+		XMVECTOR e1 = V1 - V0;
+		XMVECTOR e2 = V2 - V0;
+
+		XMVECTOR p = XMVector3Cross(Direction, e2);
+		XMVECTOR det = XMVector3Dot(e1, p);
+
+		XMVECTOR u, v, t;
+
+		if (XMVector3GreaterOrEqual(det, Epsilon))
+		{
+			XMVECTOR s = Origin - V0;
+			u = XMVector3Dot(s, p);
+
+			XMVECTOR NoIntersection = XMVectorLess(u, Zero);
+			NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(u, det));
+
+			XMVECTOR q = XMVector3Cross(s, e1);
+			v = XMVector3Dot(Direction, q);
+
+			NoIntersection = XMVectorOrInt(NoIntersection, XMVectorLess(v, Zero));
+			NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(u + v, det));
+
+			t = XMVector3Dot(e2, q);
+
+			NoIntersection = XMVectorOrInt(NoIntersection, XMVectorLess(t, Zero));
+
+			if (XMVector4EqualInt(NoIntersection, XMVectorTrueInt()))
+				return FALSE;
+		}
+		else if (XMVector3LessOrEqual(det, -Epsilon))
+		{
+			XMVECTOR s = Origin - V0;
+			u = XMVector3Dot(s, p);
+
+			XMVECTOR NoIntersection = XMVectorGreater(u, Zero);
+			NoIntersection = XMVectorOrInt(NoIntersection, XMVectorLess(u, det));
+
+			XMVECTOR q = XMVector3Cross(s, e1);
+			v = XMVector3Dot(Direction, q);
+
+			NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(v, Zero));
+			NoIntersection = XMVectorOrInt(NoIntersection, XMVectorLess(u + v, det));
+
+			t = XMVector3Dot(e2, q);
+
+			NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(t, Zero));
+
+			if (XMVector4EqualInt(NoIntersection, XMVectorTrueInt()))
+				return FALSE;
+		}
+		else
+		{
+			return FALSE;
+		}
+
+		XMVECTOR inv_det = XMVectorReciprocal(det);
+
+		t *= inv_det;
+
+		XMStoreFloat(pDist, t);
+
+		return TRUE;
+	}
+
+	bool ReferencePick(const std::vector<XMFLOAT3>& positions, const std::vector<UINT>& indices,
+					   FXMVECTOR rayOrigin, FXMVECTOR rayDir, UINT& picked, float& tmin)
+	{
+		bool found = false;
+		tmin = FLT_MAX;
+		for (UINT i = 0; i < indices.size() / 3; ++i)
+		{
+			XMVECTOR v0 = XMLoadFloat3(&positions[indices[i * 3 + 0]]);
+			XMVECTOR v1 = XMLoadFloat3(&positions[indices[i * 3 + 1]]);
+			XMVECTOR v2 = XMLoadFloat3(&positions[indices[i * 3 + 2]]);
+
+			float t = 0.0f;
+			if (IntersectRayTriangle(rayOrigin, rayDir, v0, v1, v2, &t))
+			{
+				if (t < tmin)
+				{
+					tmin = t;
+					picked = i;
+					found = true;
+				}
+			}
+		}
+		return found;
+	}
+
+	struct Ray
+	{
+		XMFLOAT3 Origin;
+		XMFLOAT3 Direction;
+	};
+
+	// Rays from a sphere around the mesh towards random points of its bounds.
+	void MakeRays(const MeshBVH& bvh, UINT count, std::vector<Ray>& rays)
+	{
+		XMFLOAT3 boundsMin, boundsMax;
+		bvh.GetBounds(boundsMin, boundsMax);
+
+		XMVECTOR vMin = XMLoadFloat3(&boundsMin);
+		XMVECTOR vMax = XMLoadFloat3(&boundsMax);
+		XMVECTOR center = 0.5f*(vMin + vMax);
+		float radius = 2.0f*XMVectorGetX(XMVector3Length(vMax - center));
+
+		UINT random = 2468;
+		rays.resize(count);
+		for(UINT k = 0; k < count; ++k)
+		{
+			XMVECTOR onSphere;
+			do
+			{
+				onSphere = XMVectorSet(2.0f*RandF(random) - 1.0f, 2.0f*RandF(random) - 1.0f, 2.0f*RandF(random) - 1.0f, 0.0f);
+			} while( XMVectorGetX(XMVector3LengthSq(onSphere)) > 1.0f || XMVectorGetX(XMVector3LengthSq(onSphere)) < 1e-4f );
+
+			XMVECTOR origin = center + radius*XMVector3Normalize(onSphere);
+			XMVECTOR target = XMVectorLerpV(vMin, vMax, XMVectorSet(RandF(random), RandF(random), RandF(random), 0.0f));
+
+			XMStoreFloat3(&rays[k].Origin, origin);
+			XMStoreFloat3(&rays[k].Direction, XMVector3Normalize(target - origin));
+		}
+	}
+
+	// Fires every ray with both the old loop and the BVH and counts the rays
+	// they disagree on.
+	UINT Check(const MeshBVH& bvh, const std::vector<XMFLOAT3>& positions, const std::vector<UINT>& indices,
+			   const std::vector<Ray>& rays, UINT& hits)
+	{
+		UINT mismatches = 0;
+		hits = 0;
+
+		for(size_t k = 0; k < rays.size(); ++k)
+		{
+			XMVECTOR origin = XMLoadFloat3(&rays[k].Origin);
+			XMVECTOR direction = XMLoadFloat3(&rays[k].Direction);
+
+			UINT picked = 0;
+			float t = 0.0f;
+			bool referenceHit = ReferencePick(positions, indices, origin, direction, picked, t);
+
+			MeshBVH::Hit hit;
+			bool bvhHit = bvh.IntersectRay(origin, direction, &hit);
+			bool anyHit = bvh.IntersectRayAny(origin, direction);
+
+			hits += referenceHit ? 1 : 0;
+
+			bool agree = referenceHit == bvhHit && anyHit == bvhHit;
+			if( agree && referenceHit && hit.Triangle != picked )
+				agree = fabsf(hit.Distance - t) <= 1e-4f*std::max(1.0f, t);
+
+			mismatches += agree ? 0 : 1;
+		}
+
+		return mismatches;
+	}
+
+	template<typename F>
+	double RaysPerSecond(const std::vector<Ray>& rays, F query)
+	{
+		double start = Now();
+		UINT hits = 0;
+		for(size_t k = 0; k < rays.size(); ++k)
+			hits += query(XMLoadFloat3(&rays[k].Origin), XMLoadFloat3(&rays[k].Direction)) ? 1 : 0;
+		double time = Now() - start;
+
+		// Keep the queries from being optimized away.
+		if( hits > rays.size() )
+			printf("?");
+
+		return rays.size() / time;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	UINT rayCount = argc > 1 ? (UINT)std::max(1, atoi(argv[1])) : 10000;
+
+	std::vector<const char*> models;
+	for(int i = 2; i < argc; ++i)
+		models.push_back(argv[i]);
+	if( models.empty() )
+	{
+		models.push_back("Models/car.txt");
+		models.push_back("Models/skull.txt");
+	}
+
+	printf("%u rays per model\n\n", rayCount);
+	printf("%-20s %9s %6s %9s %9s %12s %12s %12s %8s %10s\n",
+		"model", "triangles", "nodes", "build ms", "refit ms", "old rays/s", "bvh rays/s", "any rays/s", "speedup", "mismatch");
+
+	bool passed = true;
+
+	for(size_t m = 0; m < models.size(); ++m)
+	{
+		std::vector<XMFLOAT3> positions;
+		std::vector<UINT> indices;
+		if( !LoadModel(models[m], positions, indices) )
+		{
+			printf("%s not found\n", models[m]);
+			passed = false;
+			continue;
+		}
+
+		UINT triangleCount = (UINT)indices.size() / 3;
+
+		MeshBVH bvh;
+		double start = Now();
+		bvh.Build(&positions[0], (UINT)positions.size(), sizeof(XMFLOAT3), &indices[0], triangleCount);
+		double buildTime = Now() - start;
+
+		std::vector<Ray> rays;
+		MakeRays(bvh, rayCount, rays);
+
+		double referenceRate = RaysPerSecond(rays, [&](FXMVECTOR o, FXMVECTOR d)
+		{
+			UINT picked;
+			float t;
+			return ReferencePick(positions, indices, o, d, picked, t);
+		});
+
+		double closestRate = RaysPerSecond(rays, [&](FXMVECTOR o, FXMVECTOR d)
+		{
+			MeshBVH::Hit hit;
+			return bvh.IntersectRay(o, d, &hit);
+		});
+
+		double anyRate = RaysPerSecond(rays, [&](FXMVECTOR o, FXMVECTOR d)
+		{
+			return bvh.IntersectRayAny(o, d);
+		});
+
+		UINT hits = 0;
+		UINT mismatches = Check(bvh, positions, indices, rays, hits);
+
+		// Ripple the mesh as an animation would and refit the tree to it.
+		for(size_t i = 0; i < positions.size(); ++i)
+		{
+			XMFLOAT3& p = positions[i];
+			p.y += 0.05f*sinf(3.0f*p.x) * cosf(2.0f*p.z);
+		}
+
+		start = Now();
+		bvh.Refit(&positions[0], sizeof(XMFLOAT3));
+		double refitTime = Now() - start;
+
+		UINT refitHits = 0;
+		mismatches += Check(bvh, positions, indices, rays, refitHits);
+
+		printf("%-20s %9u %6u %9.2f %9.3f %12.0f %12.0f %12.0f %8.1f %10u\n",
+			models[m], triangleCount, bvh.GetNodeCount(), buildTime*1000.0, refitTime*1000.0,
+			referenceRate, closestRate, anyRate, closestRate/referenceRate, mismatches);
+
+		if( mismatches > 0 )
+			passed = false;
+	}
+
+	printf("\n%s\n", passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
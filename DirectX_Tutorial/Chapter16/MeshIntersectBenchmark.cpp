@@ -0,0 +1,275 @@
+//***************************************************************************************
+// MeshIntersectBenchmark.cpp
+//
+// Headless benchmark of MeshBVH::IntersectMesh and IntersectMeshAny, which find the
+// triangles where two meshes intersect, against testing every triangle of one with
+// every triangle of the other.  The second model is placed over the first at random
+// orientations, offsets and scales, most of them overlapping it, and for each it
+// reports
+//   -milliseconds per placement for IntersectMesh and IntersectMeshAny,
+//   -the same for all n*m triangle tests, estimated from a sample of them, and for
+//    a loop that only tests triangles whose bounds overlap,
+//   -how many placements intersect and the mean number of triangle pairs.
+//
+// The pairs must equal those of the loop, and IntersectMeshAny must agree with
+// them; returns 1 if they do not.
+//
+// Build with:
+//   cl /EHsc /O2 MeshBVH.cpp MeshIntersectBenchmark.cpp
+//
+// Usage: MeshIntersectBenchmark [placements [model other]]
+//        (default 50 Models/car.txt Models/skull.txt)
+//***************************************************************************************
+
+#include "MeshBVH.h"
+#include <DirectXCollision.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+namespace
+{
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	float RandF(UINT& state)
+	{
+		state = state*1664525u + 1013904223u;
+		return (state >> 8) / 16777216.0f;
+	}
+
+	// Reads the "VertexCount/TriangleCount" text models in Models/.
+	bool LoadModel(const char* filename, std::vector<XMFLOAT3>& positions, std::vector<UINT>& indices)
+	{
+		std::ifstream fin(filename);
+		if( !fin )
+			return false;
+
+		UINT vcount = 0;
+		UINT tcount = 0;
+		std::string ignore;
+
+		fin >> ignore >> vcount;
+		fin >> ignore >> tcount;
+		fin >> ignore >> ignore >> ignore >> ignore;
+
+		positions.resize(vcount);
+		for(UINT i = 0; i < vcount; ++i)
+		{
+			XMFLOAT3 normal;
+			fin >> positions[i].x >> positions[i].y >> positions[i].z;
+			fin >> normal.x >> normal.y >> normal.z;
+		}
+
+		fin >> ignore >> ignore >> ignore;
+
+		indices.resize(3*tcount);
+		for(UINT i = 0; i < 3*tcount; ++i)
+			fin >> indices[i];
+
+		return !fin.fail();
+	}
+
+	struct Triangle
+	{
+		XMFLOAT3 V[3];
+		XMFLOAT3 BoundsMin;
+		XMFLOAT3 BoundsMax;
+	};
+
+	// The triangles of a mesh moved by transform, with their bounds.  The
+	// edges are moved rather than the corners, as MeshBVH does, so that both
+	// test the same triangles.
+	void TransformTriangles(const std::vector<XMFLOAT3>& positions, const std::vector<UINT>& indices,
+							CXMMATRIX transform, std::vector<Triangle>& triangles)
+	{
+		triangles.resize(indices.size() / 3);
+		for(size_t k = 0; k < triangles.size(); ++k)
+		{
+			const XMFLOAT3& p0 = positions[indices[3*k + 0]];
+			const XMFLOAT3& p1 = positions[indices[3*k + 1]];
+			const XMFLOAT3& p2 = positions[indices[3*k + 2]];
+			XMFLOAT3 e1(p1.x - p0.x, p1.y - p0.y, p1.z - p0.z);
+			XMFLOAT3 e2(p2.x - p0.x, p2.y - p0.y, p2.z - p0.z);
+
+			XMVECTOR v0 = XMVector3Transform(XMLoadFloat3(&p0), transform);
+			XMVECTOR v1 = v0 + XMVector3TransformNormal(XMLoadFloat3(&e1), transform);
+			XMVECTOR v2 = v0 + XMVector3TransformNormal(XMLoadFloat3(&e2), transform);
+
+			Triangle& tri = triangles[k];
+			XMStoreFloat3(&tri.V[0], v0);
+			XMStoreFloat3(&tri.V[1], v1);
+			XMStoreFloat3(&tri.V[2], v2);
+			XMStoreFloat3(&tri.BoundsMin, XMVectorMin(v0, XMVectorMin(v1, v2)));
+			XMStoreFloat3(&tri.BoundsMax, XMVectorMax(v0, XMVectorMax(v1, v2)));
+		}
+	}
+
+	bool Intersects(const Triangle& a, const Triangle& b)
+	{
+		return TriangleTests::Intersects(XMLoadFloat3(&a.V[0]), XMLoadFloat3(&a.V[1]), XMLoadFloat3(&a.V[2]),
+			XMLoadFloat3(&b.V[0]), XMLoadFloat3(&b.V[1]), XMLoadFloat3(&b.V[2]));
+	}
+
+	// Tests the pairs whose bounds overlap, grown a little for rounding.
+	void ReferencePairs(const std::vector<Triangle>& a, const std::vector<Triangle>& b,
+						std::vector<MeshBVH::TrianglePair>& pairs)
+	{
+		const float margin = 1e-4f;
+
+		for(UINT i = 0; i < (UINT)a.size(); ++i)
+		{
+			XMVECTOR aMin = XMLoadFloat3(&a[i].BoundsMin) - XMVectorReplicate(margin);
+			XMVECTOR aMax = XMLoadFloat3(&a[i].BoundsMax) + XMVectorReplicate(margin);
+
+			for(UINT j = 0; j < (UINT)b.size(); ++j)
+			{
+				if( !XMVector3LessOrEqual(aMin, XMLoadFloat3(&b[j].BoundsMax)) ||
+					!XMVector3LessOrEqual(XMLoadFloat3(&b[j].BoundsMin), aMax) )
+					continue;
+
+				if( Intersects(a[i], b[j]) )
+				{
+					MeshBVH::TrianglePair pair;
+					pair.Triangle = i;
+					pair.OtherTriangle = j;
+					pairs.push_back(pair);
+				}
+			}
+		}
+	}
+
+	bool PairLess(const MeshBVH::TrianglePair& x, const MeshBVH::TrianglePair& y)
+	{
+		return x.Triangle != y.Triangle ? x.Triangle < y.Triangle : x.OtherTriangle < y.OtherTriangle;
+	}
+
+	bool SamePairs(std::vector<MeshBVH::TrianglePair> x, std::vector<MeshBVH::TrianglePair> y)
+	{
+		if( x.size() != y.size() )
+			return false;
+
+		std::sort(x.begin(), x.end(), PairLess);
+		std::sort(y.begin(), y.end(), PairLess);
+		for(size_t k = 0; k < x.size(); ++k)
+		{
+			if( x[k].Triangle != y[k].Triangle || x[k].OtherTriangle != y[k].OtherTriangle )
+				return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	UINT placementCount = argc > 1 ? (UINT)std::max(1, atoi(argv[1])) : 50;
+	const char* modelName = argc > 3 ? argv[2] : "Models/car.txt";
+	const char* otherName = argc > 3 ? argv[3] : "Models/skull.txt";
+
+	std::vector<XMFLOAT3> positions, otherPositions;
+	std::vector<UINT> indices, otherIndices;
+	if( !LoadModel(modelName, positions, indices) || !LoadModel(otherName, otherPositions, otherIndices) )
+	{
+		printf("cannot read %s or %s\n", modelName, otherName);
+		return 1;
+	}
+
+	UINT triangleCount = (UINT)indices.size() / 3;
+	UINT otherTriangleCount = (UINT)otherIndices.size() / 3;
+
+	MeshBVH bvh, otherBvh;
+	bvh.Build(&positions[0], (UINT)positions.size(), sizeof(XMFLOAT3), &indices[0], triangleCount);
+	otherBvh.Build(&otherPositions[0], (UINT)otherPositions.size(), sizeof(XMFLOAT3), &otherIndices[0], otherTriangleCount);
+
+	XMFLOAT3 boundsMin, boundsMax, otherMin, otherMax;
+	bvh.GetBounds(boundsMin, boundsMax);
+	otherBvh.GetBounds(otherMin, otherMax);
+	XMVECTOR center = 0.5f*(XMLoadFloat3(&boundsMin) + XMLoadFloat3(&boundsMax));
+	XMVECTOR extents = 0.5f*(XMLoadFloat3(&boundsMax) - XMLoadFloat3(&boundsMin));
+	XMVECTOR otherCenter = 0.5f*(XMLoadFloat3(&otherMin) + XMLoadFloat3(&otherMax));
+
+	std::vector<Triangle> triangles;
+	TransformTriangles(positions, indices, XMMatrixIdentity(), triangles);
+
+	// The cost of one triangle test, from a sample of random pairs.
+	std::vector<Triangle> otherTriangles;
+	TransformTriangles(otherPositions, otherIndices, XMMatrixIdentity(), otherTriangles);
+
+	const UINT sampleCount = 1000000;
+	UINT random = 4242;
+	UINT sampleHits = 0;
+	double start = Now();
+	for(UINT k = 0; k < sampleCount; ++k)
+	{
+		const Triangle& a = triangles[(UINT)(RandF(random)*triangleCount) % triangleCount];
+		const Triangle& b = otherTriangles[(UINT)(RandF(random)*otherTriangleCount) % otherTriangleCount];
+		sampleHits += Intersects(a, b) ? 1 : 0;
+	}
+	double allPairsTime = (Now() - start) / sampleCount * triangleCount * otherTriangleCount;
+
+	double bvhTime = 0.0, anyTime = 0.0, referenceTime = 0.0;
+	UINT intersecting = 0;
+	size_t pairTotal = 0;
+	UINT mismatches = 0;
+
+	for(UINT p = 0; p < placementCount; ++p)
+	{
+		// The other model turned any way and scaled by 0.5 to 1.5 about its
+		// center, which lands within twice the extents of the first.
+		XMVECTOR q = XMQuaternionNormalize(XMVectorSet(RandF(random) - 0.5f, RandF(random) - 0.5f,
+			RandF(random) - 0.5f, RandF(random) - 0.5f));
+		float scale = 0.5f + RandF(random);
+		XMVECTOR offset = center + extents*XMVectorSet(4.0f*RandF(random) - 2.0f, 4.0f*RandF(random) - 2.0f,
+			4.0f*RandF(random) - 2.0f, 0.0f);
+
+		XMMATRIX otherToThis = XMMatrixTranslationFromVector(-otherCenter) * XMMatrixScaling(scale, scale, scale) *
+			XMMatrixRotationQuaternion(q) * XMMatrixTranslationFromVector(offset);
+
+		std::vector<MeshBVH::TrianglePair> pairs;
+		start = Now();
+		bool found = bvh.IntersectMesh(otherBvh, otherToThis, pairs);
+		bvhTime += Now() - start;
+
+		start = Now();
+		bool any = bvh.IntersectMeshAny(otherBvh, otherToThis);
+		anyTime += Now() - start;
+
+		std::vector<Triangle> moved;
+		TransformTriangles(otherPositions, otherIndices, otherToThis, moved);
+
+		std::vector<MeshBVH::TrianglePair> referencePairs;
+		start = Now();
+		ReferencePairs(triangles, moved, referencePairs);
+		referenceTime += Now() - start;
+
+		if( found != !pairs.empty() || any != found || !SamePairs(pairs, referencePairs) )
+			++mismatches;
+
+		intersecting += found ? 1 : 0;
+		pairTotal += pairs.size();
+	}
+
+	printf("%s (%u triangles) against %s (%u triangles), %u placements\n\n",
+		modelName, triangleCount, otherName, otherTriangleCount, placementCount);
+	printf("%12s %12s %12s %12s %12s %12s %12s %10s\n",
+		"bvh ms", "any ms", "n*m ms", "bounds ms", "speedup", "intersect", "mean pairs", "mismatch");
+	printf("%12.3f %12.3f %12.1f %12.1f %12.0f %11.0f%% %12.1f %10u\n",
+		bvhTime*1000.0/placementCount, anyTime*1000.0/placementCount, allPairsTime*1000.0,
+		referenceTime*1000.0/placementCount, allPairsTime*placementCount/bvhTime,
+		100.0*intersecting/placementCount, (double)pairTotal/placementCount, mismatches);
+
+	// Keep the sample from being optimized away.
+	if( sampleHits > sampleCount )
+		printf("?");
+
+	bool passed = mismatches == 0;
+	printf("\n%s\n", passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
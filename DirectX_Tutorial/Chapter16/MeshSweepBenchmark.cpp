@@ -0,0 +1,339 @@
+//***************************************************************************************
+// MeshSweepBenchmark.cpp
+//
+// Headless benchmark of MeshBVH::SweepSphere against moving a sphere in substeps and
+// testing each with MeshBVH::IntersectSphere, which is what a sweep replaces.  For
+// every model it moves spheres of a fiftieth of the model's size from outside it
+// towards random points of its bounds, most far enough to cross it, and reports
+//   -sweeps per second, and moves per second in 4 and in 16 substeps,
+//   -the share of sweeps that hit, and of those the share that 4 and 16 substeps
+//    miss: the spheres that would tunnel through the mesh.
+// It also sweeps a sphere through a wall of two triangles in one step, which 4
+// substeps step over.
+//
+// IntersectSphere is checked against a test of every triangle at random points,
+// and every sweep against IntersectSphere: at the time of a hit the sphere grown by
+// a thousandth must touch the mesh, and at 256 times before it (over the whole move
+// for a miss) the sphere shrunk by as much must not.  Returns 1 if any check fails.
+//
+// Build with:
+//   cl /EHsc /O2 MeshBVH.cpp MeshSweepBenchmark.cpp
+//
+// Usage: MeshSweepBenchmark [sweeps [model ...]]      (default 10000 Models/car.txt Models/skull.txt)
+//***************************************************************************************
+
+#include "MeshBVH.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+namespace
+{
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	float RandF(UINT& state)
+	{
+		state = state*1664525u + 1013904223u;
+		return (state >> 8) / 16777216.0f;
+	}
+
+	// Reads the "VertexCount/TriangleCount" text models in Models/.
+	bool LoadModel(const char* filename, std::vector<XMFLOAT3>& positions, std::vector<UINT>& indices)
+	{
+		std::ifstream fin(filename);
+		if( !fin )
+			return false;
+
+		UINT vcount = 0;
+		UINT tcount = 0;
+		std::string ignore;
+
+		fin >> ignore >> vcount;
+		fin >> ignore >> tcount;
+		fin >> ignore >> ignore >> ignore >> ignore;
+
+		positions.resize(vcount);
+		for(UINT i = 0; i < vcount; ++i)
+		{
+			XMFLOAT3 normal;
+			fin >> positions[i].x >> positions[i].y >> positions[i].z;
+			fin >> normal.x >> normal.y >> normal.z;
+		}
+
+		fin >> ignore >> ignore >> ignore;
+
+		indices.resize(3*tcount);
+		for(UINT i = 0; i < 3*tcount; ++i)
+			fin >> indices[i];
+
+		return !fin.fail();
+	}
+
+	float SegmentDistanceSq(FXMVECTOR p, FXMVECTOR a, FXMVECTOR b)
+	{
+		XMVECTOR d = b - a;
+		float s = XMVectorGetX(XMVector3Dot(p - a, d)) / std::max(XMVectorGetX(XMVector3Dot(d, d)), 1e-30f);
+		s = std::min(std::max(s, 0.0f), 1.0f);
+		return XMVectorGetX(XMVector3LengthSq(p - (a + s*d)));
+	}
+
+	// The distance to the plane if p is over the triangle, and to the nearest
+	// edge otherwise.
+	float TriangleDistanceSq(FXMVECTOR p, FXMVECTOR v0, FXMVECTOR v1, CXMVECTOR v2)
+	{
+		XMVECTOR n = XMVector3Cross(v1 - v0, v2 - v0);
+		float area = XMVectorGetX(XMVector3Length(n));
+		if( area > 0.0f )
+		{
+			n = n*(1.0f / area);
+			XMVECTOR q = p - XMVector3Dot(p - v0, n)*n;
+			bool inside =
+				XMVectorGetX(XMVector3Dot(XMVector3Cross(v1 - v0, q - v0), n)) >= 0.0f &&
+				XMVectorGetX(XMVector3Dot(XMVector3Cross(v2 - v1, q - v1), n)) >= 0.0f &&
+				XMVectorGetX(XMVector3Dot(XMVector3Cross(v0 - v2, q - v2), n)) >= 0.0f;
+			if( inside )
+				return XMVectorGetX(XMVector3LengthSq(p - q));
+		}
+
+		return std::min(SegmentDistanceSq(p, v0, v1), std::min(SegmentDistanceSq(p, v1, v2), SegmentDistanceSq(p, v2, v0)));
+	}
+
+	bool ReferenceIntersectSphere(const std::vector<XMFLOAT3>& positions, const std::vector<UINT>& indices,
+								  FXMVECTOR center, float radius)
+	{
+		for(size_t i = 0; i < indices.size(); i += 3)
+		{
+			XMVECTOR v0 = XMLoadFloat3(&positions[indices[i + 0]]);
+			XMVECTOR v1 = XMLoadFloat3(&positions[indices[i + 1]]);
+			XMVECTOR v2 = XMLoadFloat3(&positions[indices[i + 2]]);
+			if( TriangleDistanceSq(center, v0, v1, v2) <= radius*radius )
+				return true;
+		}
+		return false;
+	}
+
+	struct Move
+	{
+		XMFLOAT3 Center;
+		XMFLOAT3 Velocity;
+	};
+
+	// Moves from a sphere around the mesh towards random points of its bounds,
+	// stopping short of them or going past them by up to as far again.
+	void MakeMoves(const MeshBVH& bvh, UINT count, std::vector<Move>& moves)
+	{
+		XMFLOAT3 boundsMin, boundsMax;
+		bvh.GetBounds(boundsMin, boundsMax);
+
+		XMVECTOR vMin = XMLoadFloat3(&boundsMin);
+		XMVECTOR vMax = XMLoadFloat3(&boundsMax);
+		XMVECTOR center = 0.5f*(vMin + vMax);
+		float radius = 1.5f*XMVectorGetX(XMVector3Length(vMax - center));
+
+		UINT random = 1357;
+		moves.resize(count);
+		for(UINT k = 0; k < count; ++k)
+		{
+			XMVECTOR onSphere;
+			do
+			{
+				onSphere = XMVectorSet(2.0f*RandF(random) - 1.0f, 2.0f*RandF(random) - 1.0f, 2.0f*RandF(random) - 1.0f, 0.0f);
+			} while( XMVectorGetX(XMVector3LengthSq(onSphere)) > 1.0f || XMVectorGetX(XMVector3LengthSq(onSphere)) < 1e-4f );
+
+			XMVECTOR start = center + radius*XMVector3Normalize(onSphere);
+			XMVECTOR target = XMVectorLerpV(vMin, vMax, XMVectorSet(RandF(random), RandF(random), RandF(random), 0.0f));
+
+			XMStoreFloat3(&moves[k].Center, start);
+			XMStoreFloat3(&moves[k].Velocity, (0.5f + 1.5f*RandF(random))*(target - start));
+		}
+	}
+
+	// Whether some of n + 1 evenly spaced positions of the move touch the mesh.
+	bool Substep(const MeshBVH& bvh, const Move& move, float radius, UINT n)
+	{
+		XMVECTOR center = XMLoadFloat3(&move.Center);
+		XMVECTOR velocity = XMLoadFloat3(&move.Velocity);
+		for(UINT k = 0; k <= n; ++k)
+		{
+			if( bvh.IntersectSphere(center + ((float)k / n)*velocity, radius) )
+				return true;
+		}
+		return false;
+	}
+
+	const float Epsilon = 1e-3f;
+	const UINT CheckSamples = 256;
+
+	bool CheckSweep(const MeshBVH& bvh, const Move& move, float radius)
+	{
+		XMVECTOR center = XMLoadFloat3(&move.Center);
+		XMVECTOR velocity = XMLoadFloat3(&move.Velocity);
+
+		MeshBVH::SweepHit hit;
+		bool found = bvh.SweepSphere(center, radius, velocity, &hit);
+
+		// A sphere that starts in contact has nothing before it to check.
+		float end = found ? hit.Time : 1.0f;
+		for(UINT k = 0; k < CheckSamples && end > 0.0f; ++k)
+		{
+			if( bvh.IntersectSphere(center + (end*k / CheckSamples)*velocity, radius*(1.0f - Epsilon)) )
+				return false;
+		}
+
+		if( !found )
+			return !bvh.IntersectSphere(center + velocity, radius*(1.0f - Epsilon));
+
+		XMVECTOR at = center + hit.Time*velocity;
+		if( hit.Time < 0.0f || hit.Time > 1.0f || !bvh.IntersectSphere(at, radius*(1.0f + Epsilon)) )
+			return false;
+
+		// The point is on the sphere and the normal points from it to the center.
+		XMVECTOR toCenter = at - XMLoadFloat3(&hit.Point);
+		float distance = XMVectorGetX(XMVector3Length(toCenter));
+		float alignment = XMVectorGetX(XMVector3Dot(toCenter, XMLoadFloat3(&hit.Normal)));
+		return fabsf(distance - radius) <= Epsilon*radius && alignment >= distance*(1.0f - Epsilon);
+	}
+
+	// A square wall of two triangles across x = 0 and a sphere of radius 0.1
+	// moving from x = -1 to x = 1.4, which 4 substeps put at -0.4 and 0.2.  It
+	// must hit at (1 - 0.1)/2.4.
+	bool ThinWall(float& time, bool& substepHit)
+	{
+		XMFLOAT3 positions[4] =
+		{
+			XMFLOAT3(0.0f, -1.0f, -1.0f), XMFLOAT3(0.0f, 1.0f, -1.0f), XMFLOAT3(0.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, -1.0f, 1.0f)
+		};
+		UINT indices[6] = { 0, 1, 2, 0, 2, 3 };
+
+		MeshBVH wall;
+		wall.Build(positions, 4, sizeof(XMFLOAT3), indices, 2);
+
+		Move move;
+		move.Center = XMFLOAT3(-1.0f, 0.3f, 0.2f);
+		move.Velocity = XMFLOAT3(2.4f, 0.0f, 0.0f);
+
+		MeshBVH::SweepHit hit;
+		bool found = wall.SweepSphere(XMLoadFloat3(&move.Center), 0.1f, XMLoadFloat3(&move.Velocity), &hit);
+		time = found ? hit.Time : -1.0f;
+		substepHit = Substep(wall, move, 0.1f, 4);
+
+		return found && fabsf(hit.Time - 0.9f/2.4f) < 1e-5f && fabsf(hit.Normal.x + 1.0f) < 1e-5f;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	UINT sweepCount = argc > 1 ? (UINT)std::max(1, atoi(argv[1])) : 10000;
+
+	std::vector<const char*> models;
+	for(int i = 2; i < argc; ++i)
+		models.push_back(argv[i]);
+	if( models.empty() )
+	{
+		models.push_back("Models/car.txt");
+		models.push_back("Models/skull.txt");
+	}
+
+	bool passed = true;
+
+	float wallTime;
+	bool wallSubstepHit;
+	bool wallOk = ThinWall(wallTime, wallSubstepHit);
+	printf("thin wall: sweep hits at %.4f (expected %.4f), 4 substeps %s\n\n", wallTime, 0.9f/2.4f,
+		wallSubstepHit ? "hit" : "miss");
+	if( !wallOk )
+		passed = false;
+
+	printf("%u sweeps per model\n\n", sweepCount);
+	printf("%-20s %9s %12s %12s %12s %8s %8s %8s %10s\n",
+		"model", "triangles", "sweeps/s", "4 steps/s", "16 steps/s", "hits", "4 miss", "16 miss", "mismatch");
+
+	for(size_t m = 0; m < models.size(); ++m)
+	{
+		std::vector<XMFLOAT3> positions;
+		std::vector<UINT> indices;
+		if( !LoadModel(models[m], positions, indices) )
+		{
+			printf("%s not found\n", models[m]);
+			passed = false;
+			continue;
+		}
+
+		UINT triangleCount = (UINT)indices.size() / 3;
+
+		MeshBVH bvh;
+		bvh.Build(&positions[0], (UINT)positions.size(), sizeof(XMFLOAT3), &indices[0], triangleCount);
+
+		XMFLOAT3 boundsMin, boundsMax;
+		bvh.GetBounds(boundsMin, boundsMax);
+		XMVECTOR vMin = XMLoadFloat3(&boundsMin);
+		XMVECTOR vMax = XMLoadFloat3(&boundsMax);
+		float radius = 0.02f*XMVectorGetX(XMVector3Length(vMax - vMin));
+
+		std::vector<Move> moves;
+		MakeMoves(bvh, sweepCount, moves);
+
+		UINT hits = 0;
+		double start = Now();
+		for(UINT k = 0; k < sweepCount; ++k)
+		{
+			MeshBVH::SweepHit hit;
+			hits += bvh.SweepSphere(XMLoadFloat3(&moves[k].Center), radius, XMLoadFloat3(&moves[k].Velocity), &hit) ? 1 : 0;
+		}
+		double sweepTime = Now() - start;
+
+		UINT hits4 = 0;
+		start = Now();
+		for(UINT k = 0; k < sweepCount; ++k)
+			hits4 += Substep(bvh, moves[k], radius, 4) ? 1 : 0;
+		double time4 = Now() - start;
+
+		UINT hits16 = 0;
+		start = Now();
+		for(UINT k = 0; k < sweepCount; ++k)
+			hits16 += Substep(bvh, moves[k], radius, 16) ? 1 : 0;
+		double time16 = Now() - start;
+
+		// IntersectSphere against every triangle, at random points in and
+		// around the bounds.  Spheres that graze the mesh to within the
+		// tolerance may go either way.
+		UINT mismatches = 0;
+		UINT random = 97531;
+		for(UINT k = 0; k < 500; ++k)
+		{
+			XMVECTOR lerp = XMVectorSet(1.2f*RandF(random) - 0.1f, 1.2f*RandF(random) - 0.1f, 1.2f*RandF(random) - 0.1f, 0.0f);
+			XMVECTOR center = XMVectorLerpV(vMin, vMax, lerp);
+
+			bool touches = bvh.IntersectSphere(center, radius);
+			if( touches && !ReferenceIntersectSphere(positions, indices, center, radius*(1.0f + Epsilon)) )
+				++mismatches;
+			if( !touches && ReferenceIntersectSphere(positions, indices, center, radius*(1.0f - Epsilon)) )
+				++mismatches;
+		}
+
+		for(UINT k = 0; k < sweepCount; ++k)
+		{
+			if( !CheckSweep(bvh, moves[k], radius) )
+				++mismatches;
+		}
+
+		printf("%-20s %9u %12.0f %12.0f %12.0f %7.1f%% %7.1f%% %7.1f%% %10u\n",
+			models[m], triangleCount, sweepCount/sweepTime, sweepCount/time4, sweepCount/time16,
+			100.0*hits/sweepCount, hits ? 100.0*(hits - hits4)/hits : 0.0, hits ? 100.0*(hits - hits16)/hits : 0.0,
+			mismatches);
+
+		if( mismatches > 0 || hits4 > hits || hits16 > hits )
+			passed = false;
+	}
+
+	printf("\n%s\n", passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
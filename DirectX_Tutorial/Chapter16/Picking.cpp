@@ -7,20 +7,11 @@
 #include "MathHelper.h"
 #include "LightHelper.h"
 #include "RenderStates.h"
+#include "MeshBVH.h"
 #include <windowsx.h>
 
 using namespace DirectX;
 
-
-
-struct AxisAlignedBox
-{
-	XMFLOAT3 Center;
-	XMFLOAT3 Extents;	// Distance from the center to each side.
-};
-
-
-
 //--------------------------------------------------------------------------------------
 // Global Variables
 //--------------------------------------------------------------------------------------
@@ -34,7 +25,7 @@ ID3D11Buffer*					g_CarIndexBuffer;
 std::vector <Vertex::Basic32>	g_CarVertices;
 std::vector <UINT>				g_CarIndices;
 UINT							g_CarIndexCount;
-AxisAlignedBox					g_CarBox;
+MeshBVH							g_CarBVH;
 XMFLOAT4X4						g_CarWorld;
 Material						g_CarMaterial;
 
@@ -79,27 +70,13 @@ void BuildMeshGeometryBuffers(ID3D11Device* pd3dDevice)
 	fin >> ignore >> tcount;
 	fin >> ignore >> ignore >> ignore >> ignore;
 
-	XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-	XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
-
-	XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-	XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
-
 	g_CarVertices.resize(vcount);
 	for (UINT i = 0; i < vcount; i++)
 	{
 		fin >> g_CarVertices[i].Pos.x >> g_CarVertices[i].Pos.y >> g_CarVertices[i].Pos.z;
 		fin >> g_CarVertices[i].Normal.x >> g_CarVertices[i].Normal.y >> g_CarVertices[i].Normal.z;
-
-		XMVECTOR P = XMLoadFloat3(&g_CarVertices[i].Pos);
-
-		vMin = XMVectorMin(vMin, P);
-		vMax = XMVectorMax(vMax, P);
 	}
 
-	XMStoreFloat3(&g_CarBox.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&g_CarBox.Extents, 0.5f * (vMax - vMin));
-
 	fin >> ignore;
 	fin >> ignore;
 	fin >> ignore;
@@ -113,6 +90,8 @@ void BuildMeshGeometryBuffers(ID3D11Device* pd3dDevice)
 
 	fin.close();
 
+	g_CarBVH.Build(&g_CarVertices[0].Pos, vcount, sizeof(Vertex::Basic32), &g_CarIndices[0], tcount);
+
 	D3D11_BUFFER_DESC vbd = {};
 	vbd.ByteWidth = sizeof(Vertex::Basic32) * vcount;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
@@ -134,193 +113,6 @@ void BuildMeshGeometryBuffers(ID3D11Device* pd3dDevice)
 	hr = pd3dDevice->CreateBuffer(&ibd, &iInitData, &g_CarIndexBuffer);
 }
 
-static const XMVECTOR g_UnitVectorEpsilon =
-{
-	1.0e-4f, 1.0e-4f, 1.0e-4f, 1.0e-4f
-};
-static inline BOOL XMVector3AnyTrue(FXMVECTOR V)
-{
-	XMVECTOR C;
-
-	// Duplicate the fourth element from the first element.
-	C = XMVectorSwizzle(V, 0, 1, 2, 0);
-
-	return XMComparisonAnyTrue(XMVector4EqualIntR(C, XMVectorTrueInt()));
-}
-static inline BOOL XMVector3IsUnit(FXMVECTOR V)
-{
-	XMVECTOR Difference = XMVector3Length(V) - XMVectorSplatOne();
-
-	return XMVector4Less(XMVectorAbs(Difference), g_UnitVectorEpsilon);
-}
-bool IntersectRayAxisAlignedBox(FXMVECTOR Origin, FXMVECTOR Direction, const AxisAlignedBox* pVolume, FLOAT* pDist)
-{
-	assert(pVolume);
-	assert(pDist);
-	assert(XMVector3IsUnit(Direction));
-
-	static const XMVECTOR Epsilon =
-	{
-		1e-20f, 1e-20f, 1e-20f, 1e-20f
-	};
-
-	static const XMVECTOR FltMin =
-	{
-		-FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX
-	};
-
-	static const XMVECTOR FltMax =
-	{
-		FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX
-	};
-
-	XMVECTOR Center = XMLoadFloat3(&pVolume->Center);
-	XMVECTOR Extents = XMLoadFloat3(&pVolume->Extents);
-
-	// Adjust ray origin to be relative to center of the box.
-	XMVECTOR TOrigin = Center - Origin;
-
-	// Compute the dot product againt each axis of the box.
-	// Since the axii are (1,0,0), (0,1,0), (0,0,1) no computation is necessary.
-	XMVECTOR AxisDotOrigin = TOrigin;
-	XMVECTOR AxisDotDirection = Direction;
-
-	// if (fabs(AxisDotDirection) <= Epsilon) the ray is nearly parallel to the slab.
-	XMVECTOR IsParallel = XMVectorLessOrEqual(XMVectorAbs(AxisDotDirection), Epsilon);
-
-	// Test against all three axii simultaneously.
-	XMVECTOR InverseAxisDotDirection = XMVectorReciprocal(AxisDotDirection);
-	XMVECTOR t1 = (AxisDotOrigin - Extents) * InverseAxisDotDirection;
-	XMVECTOR t2 = (AxisDotOrigin + Extents) * InverseAxisDotDirection;
-
-	// Compute the max of min(t1,t2) and the min of max(t1,t2) ensuring we don't
-	// use the results from any directions parallel to the slab.
-	XMVECTOR t_min = XMVectorSelect(XMVectorMin(t1, t2), FltMin, IsParallel);
-	XMVECTOR t_max = XMVectorSelect(XMVectorMax(t1, t2), FltMax, IsParallel);
-
-	// t_min.x = maximum( t_min.x, t_min.y, t_min.z );
-	// t_max.x = minimum( t_max.x, t_max.y, t_max.z );
-	t_min = XMVectorMax(t_min, XMVectorSplatY(t_min));  // x = max(x,y)
-	t_min = XMVectorMax(t_min, XMVectorSplatZ(t_min));  // x = max(max(x,y),z)
-	t_max = XMVectorMin(t_max, XMVectorSplatY(t_max));  // x = min(x,y)
-	t_max = XMVectorMin(t_max, XMVectorSplatZ(t_max));  // x = min(min(x,y),z)
-
-	// if ( t_min > t_max ) return FALSE;
-	XMVECTOR NoIntersection = XMVectorGreater(XMVectorSplatX(t_min), XMVectorSplatX(t_max));
-
-	// if ( t_max < 0.0f ) return FALSE;
-	NoIntersection = XMVectorOrInt(NoIntersection, XMVectorLess(XMVectorSplatX(t_max), XMVectorZero()));
-
-	// if (IsParallel && (-Extents > AxisDotOrigin || Extents < AxisDotOrigin)) return FALSE;
-	XMVECTOR ParallelOverlap = XMVectorInBounds(AxisDotOrigin, Extents);
-	NoIntersection = XMVectorOrInt(NoIntersection, XMVectorAndCInt(IsParallel, ParallelOverlap));
-
-	if (!XMVector3AnyTrue(NoIntersection))
-	{
-		// Store the x-component to *pDist
-		XMStoreFloat(pDist, t_min);
-		return TRUE;
-	}
-
-	return FALSE;
-
-}
-bool IntersectRayTriangle(FXMVECTOR Origin, FXMVECTOR Direction, FXMVECTOR V0, CXMVECTOR V1, CXMVECTOR V2, FLOAT* pDist)
-{
-	assert(pDist);
-	assert(XMVector3IsUnit(Direction));
-
-	static const XMVECTOR Epsilon =
-	{
-		1e-20f, 1e-20f, 1e-20f, 1e-20f
-	};
-
-	XMVECTOR Zero = XMVectorZero();
-
-	XMVECTOR e1 = V1 - V0;
-	XMVECTOR e2 = V2 - V0;
-
-	// p = Direction ^ e2;
-	XMVECTOR p = XMVector3Cross(Direction, e2);
-
-	// det = e1 * p;
-	XMVECTOR det = XMVector3Dot(e1, p);
-
-	XMVECTOR u, v, t;
-
-	if (XMVector3GreaterOrEqual(det, Epsilon))
-	{
-		// Determinate is positive (front side of the triangle).
-		XMVECTOR s = Origin - V0;
-
-		// u = s * p;
-		u = XMVector3Dot(s, p);
-
-		XMVECTOR NoIntersection = XMVectorLess(u, Zero);
-		NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(u, det));
-
-		// q = s ^ e1;
-		XMVECTOR q = XMVector3Cross(s, e1);
-
-		// v = Direction * q;
-		v = XMVector3Dot(Direction, q);
-
-		NoIntersection = XMVectorOrInt(NoIntersection, XMVectorLess(v, Zero));
-		NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(u + v, det));
-
-		// t = e2 * q;
-		t = XMVector3Dot(e2, q);
-
-		NoIntersection = XMVectorOrInt(NoIntersection, XMVectorLess(t, Zero));
-
-		if (XMVector4EqualInt(NoIntersection, XMVectorTrueInt()))
-			return FALSE;
-	}
-	else if (XMVector3LessOrEqual(det, -Epsilon))
-	{
-		// Determinate is negative (back side of the triangle).
-		XMVECTOR s = Origin - V0;
-
-		// u = s * p;
-		u = XMVector3Dot(s, p);
-
-		XMVECTOR NoIntersection = XMVectorGreater(u, Zero);
-		NoIntersection = XMVectorOrInt(NoIntersection, XMVectorLess(u, det));
-
-		// q = s ^ e1;
-		XMVECTOR q = XMVector3Cross(s, e1);
-
-		// v = Direction * q;
-		v = XMVector3Dot(Direction, q);
-
-		NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(v, Zero));
-		NoIntersection = XMVectorOrInt(NoIntersection, XMVectorLess(u + v, det));
-
-		// t = e2 * q;
-		t = XMVector3Dot(e2, q);
-
-		NoIntersection = XMVectorOrInt(NoIntersection, XMVectorGreater(t, Zero));
-
-		if (XMVector4EqualInt(NoIntersection, XMVectorTrueInt()))
-			return FALSE;
-	}
-	else
-	{
-		// Parallel ray.
-		return FALSE;
-	}
-
-	XMVECTOR inv_det = XMVectorReciprocal(det);
-
-	t *= inv_det;
-
-	// u * inv_det and v * inv_det are the barycentric cooridinates of the intersection.
-
-	// Store the x-component to *pDist
-	XMStoreFloat(pDist, t);
-
-	return TRUE;
-}
 void Pick(int sx, int sy)
 {
 	XMMATRIX P = g_Camera.GetProjMatrix();
@@ -350,43 +142,15 @@ void Pick(int sx, int sy)
 	// Make the ray direction unit length for the intersection tests.
 	rayDir = XMVector3Normalize(rayDir);
 
-	// If we hit the bounding box of the Mesh, then we might have picked a Mesh triangle,
-	// so do the ray/triangle tests.
-	//
-	// If we did not hit the bounding box, then it is impossible that we hit 
-	// the Mesh, so do not waste effort doing ray/triangle tests.
+	// The BVH only tests the triangles whose bounding boxes the ray passes
+	// through, nearest first, instead of every triangle of the mesh.
 
 	// Assume we have not picked anything yet, so init to -1.
 	g_PickedTriangle = -1;
-	float tmin = 0.0f;
-	if (IntersectRayAxisAlignedBox(rayOrigin, rayDir, &g_CarBox, &tmin))
+	MeshBVH::Hit hit;
+	if (g_CarBVH.IntersectRay(rayOrigin, rayDir, &hit))
 	{
-		// Find the nearest ray/triangle intersection.
-		tmin = MathHelper::Infinity;
-		for (UINT i = 0; i < g_CarIndices.size() / 3; ++i)
-		{
-			// Indices for this triangle.
-			UINT i0 = g_CarIndices[i * 3 + 0];
-			UINT i1 = g_CarIndices[i * 3 + 1];
-			UINT i2 = g_CarIndices[i * 3 + 2];
-
-			// Vertices for this triangle.
-			XMVECTOR v0 = XMLoadFloat3(&g_CarVertices[i0].Pos);
-			XMVECTOR v1 = XMLoadFloat3(&g_CarVertices[i1].Pos);
-			XMVECTOR v2 = XMLoadFloat3(&g_CarVertices[i2].Pos);
-
-			// We have to iterate over all the triangles in order to find the nearest intersection.
-			float t = 0.0f;
-			if (IntersectRayTriangle(rayOrigin, rayDir, v0, v1, v2, &t))
-			{
-				if (t < tmin)
-				{
-					// This is the new nearest picked triangle.
-					tmin = t;
-					g_PickedTriangle = i;
-				}
-			}
-		}
+		g_PickedTriangle = hit.Triangle;
 	}
 }
 
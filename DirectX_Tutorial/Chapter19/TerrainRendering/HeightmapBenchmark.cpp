@@ -0,0 +1,154 @@
+//***************************************************************************************
+// HeightmapBenchmark.cpp
+//
+// Headless benchmark of HeightmapLoader::LoadRaw.  Loads a size x size RAW heightmap
+// and prints the load time and the peak working set of the process, so run it once
+// per configuration:
+//
+//   HeightmapBenchmark 4096 16           streamed (HeightmapLoader::LoadRaw)
+//   HeightmapBenchmark 4096 16 whole     whole file read first, then converted
+//   HeightmapBenchmark 16384 16
+//   HeightmapBenchmark 16384 16 whole
+//
+// The heightmap is generated as Heightmap<size>_<bits>.raw the first time it is
+// needed.  Build with:
+//   cl /EHsc /O2 HeightmapLoader.cpp HeightmapBenchmark.cpp psapi.lib
+//***************************************************************************************
+
+#include "HeightmapLoader.h"
+#include <psapi.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+	const UINT CellsPerPatch = 64;
+	const float HeightScale  = 500.0f;
+
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	double PeakWorkingSetMB()
+	{
+		PROCESS_MEMORY_COUNTERS counters;
+		GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+		return counters.PeakWorkingSetSize / (1024.0*1024.0);
+	}
+
+	// Rolling hills, written a row at a time.
+	bool WriteHeightmap(const std::wstring& filename, UINT size, UINT bitDepth)
+	{
+		std::ofstream fout(filename.c_str(), std::ios_base::binary);
+		if( !fout )
+			return false;
+
+		UINT bytesPerSample = bitDepth == 16 ? 2 : 1;
+		float maxSample     = bitDepth == 16 ? 65535.0f : 255.0f;
+
+		std::vector<unsigned char> row(size*bytesPerSample);
+		for(UINT i = 0; i < size; ++i)
+		{
+			for(UINT j = 0; j < size; ++j)
+			{
+				float h = 0.5f + 0.25f*(sinf(i*0.01f) + cosf(j*0.013f + i*0.002f));
+				UINT sample = (UINT)(h*maxSample);
+				if( bytesPerSample == 2 )
+				{
+					row[2*j]   = (unsigned char)(sample & 0xff);
+					row[2*j+1] = (unsigned char)(sample >> 8);
+				}
+				else
+				{
+					row[j] = (unsigned char)sample;
+				}
+			}
+			fout.write(reinterpret_cast<const char*>(&row[0]), row.size());
+		}
+
+		return true;
+	}
+
+	// The straightforward way: read the whole file, then convert it.
+	bool LoadWhole(const std::wstring& filename, UINT size, UINT bitDepth, std::vector<float>& heights,
+		std::vector<XMFLOAT2>& patchBoundsY, std::vector<PatchBoundsLevel>& levels)
+	{
+		UINT bytesPerSample = bitDepth == 16 ? 2 : 1;
+		float sampleScale   = HeightScale / (bitDepth == 16 ? 65535.0f : 255.0f);
+
+		std::vector<unsigned char> in((size_t)size*size*bytesPerSample);
+
+		std::ifstream fin(filename.c_str(), std::ios_base::binary);
+		if( !fin )
+			return false;
+		fin.read(reinterpret_cast<char*>(&in[0]), in.size());
+
+		heights.resize((size_t)size*size);
+		for(size_t k = 0; k < heights.size(); ++k)
+		{
+			UINT sample = bytesPerSample == 2 ? (in[2*k] | (in[2*k+1] << 8)) : in[k];
+			heights[k] = sample*sampleScale;
+		}
+
+		HeightmapLoader::BuildPatchBounds(heights, size, size, CellsPerPatch, patchBoundsY, levels);
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if( argc < 3 )
+	{
+		printf("usage: HeightmapBenchmark size 8|16 [whole]\n");
+		return 1;
+	}
+
+	UINT size     = (UINT)atoi(argv[1]);
+	UINT bitDepth = atoi(argv[2]) == 16 ? 16 : 8;
+	bool whole    = argc > 3 && strcmp(argv[3], "whole") == 0;
+
+	std::wostringstream name;
+	name << L"Heightmap" << size << L"_" << bitDepth << L".raw";
+	std::wstring filename = name.str();
+
+	if( !std::ifstream(filename.c_str()) )
+	{
+		printf("writing %ls\n", filename.c_str());
+		if( !WriteHeightmap(filename, size, bitDepth) )
+			return 1;
+	}
+
+	double baseMB = PeakWorkingSetMB();
+
+	std::vector<float> heights;
+	std::vector<XMFLOAT2> patchBoundsY;
+	std::vector<PatchBoundsLevel> levels;
+
+	double start = Now();
+	bool loaded = whole ?
+		LoadWhole(filename, size, bitDepth, heights, patchBoundsY, levels) :
+		HeightmapLoader::LoadRaw(filename, size, size, bitDepth, HeightScale, CellsPerPatch, heights, patchBoundsY, levels);
+	double time = Now() - start;
+
+	if( !loaded )
+	{
+		printf("could not read %ls\n", filename.c_str());
+		return 1;
+	}
+
+	const XMFLOAT2& top = patchBoundsY[levels.back().FirstPatch];
+
+	printf("%s %ux%u %u-bit: %.1f ms, peak working set %.1f MB (%.1f MB before loading), "
+		"heights %.1f MB, %u pyramid levels, height range [%.2f, %.2f]\n",
+		whole ? "whole" : "streamed", size, size, bitDepth, time*1000.0, PeakWorkingSetMB(), baseMB,
+		heights.size()*sizeof(float) / (1024.0*1024.0), (UINT)levels.size(), top.x, top.y);
+
+	return 0;
+}
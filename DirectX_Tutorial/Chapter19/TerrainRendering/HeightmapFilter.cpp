@@ -0,0 +1,137 @@
+#include "HeightmapFilter.h"
+#include "../../Common/JobSystem.h"
+#include <algorithm>
+
+namespace
+{
+	// Rows of the heightmap handed to one job.
+	const UINT RowsPerJob = 16;
+
+	XMVECTOR LoadFloats(const float* p)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+	}
+
+	void StoreFloats(float* p, FXMVECTOR v)
+	{
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p), v);
+	}
+}
+
+void HeightmapFilter::BoxBlur(std::vector<float>& heights, UINT width, UINT height, UINT radius,
+							  UINT iterations, std::vector<float>& scratch, JobSystem* jobSystem)
+{
+	if( radius == 0 || width == 0 || height == 0 )
+		return;
+
+	scratch.resize(heights.size());
+
+	float* h = &heights[0];
+	float* s = &scratch[0];
+
+	for(UINT k = 0; k < iterations; ++k)
+	{
+		auto blurRows = [=](UINT first, UINT last)
+		{
+			for(UINT i = first; i < last; ++i)
+				BlurRow(h + (size_t)i*width, s + (size_t)i*width, width, radius);
+		};
+
+		// Every row of scratch must be done before the columns are read.
+		auto blurColumns = [=](UINT first, UINT last)
+		{
+			for(UINT i = first; i < last; ++i)
+				BlurColumns(s, h, i, width, height, radius);
+		};
+
+		if( jobSystem )
+		{
+			jobSystem->ParallelFor(0, height, RowsPerJob, blurRows);
+			jobSystem->ParallelFor(0, height, RowsPerJob, blurColumns);
+		}
+		else
+		{
+			blurRows(0, height);
+			blurColumns(0, height);
+		}
+	}
+}
+
+void HeightmapFilter::BlurRow(const float* src, float* dest, UINT width, UINT radius)
+{
+	// Heights whose window lies inside the row; the ones nearer the ends
+	// average over fewer heights.
+	UINT interiorBegin = width > 2*radius ? radius : width;
+	UINT interiorEnd   = width > 2*radius ? width - radius : width;
+
+	auto blurEnd = [=](UINT j)
+	{
+		UINT lo = j > radius ? j - radius : 0;
+		UINT hi = std::min(j + radius, width - 1);
+
+		float sum = src[lo];
+		for(UINT x = lo+1; x <= hi; ++x)
+			sum += src[x];
+		dest[j] = sum / (hi - lo + 1);
+	};
+
+	for(UINT j = 0; j < interiorBegin; ++j)
+		blurEnd(j);
+	for(UINT j = interiorEnd; j < width; ++j)
+		blurEnd(j);
+
+	float invCount = 1.0f / (2*radius + 1);
+	XMVECTOR vInvCount = XMVectorReplicate(invCount);
+
+	UINT j = interiorBegin;
+	for(; j+4 <= interiorEnd; j += 4)
+	{
+		const float* window = src + j - radius;
+
+		XMVECTOR sum = LoadFloats(window);
+		for(UINT x = 1; x <= 2*radius; ++x)
+			sum += LoadFloats(window + x);
+		StoreFloats(dest + j, sum*vInvCount);
+	}
+
+	for(; j < interiorEnd; ++j)
+	{
+		const float* window = src + j - radius;
+
+		float sum = window[0];
+		for(UINT x = 1; x <= 2*radius; ++x)
+			sum += window[x];
+		dest[j] = sum*invCount;
+	}
+}
+
+void HeightmapFilter::BlurColumns(const float* src, float* dest, UINT i, UINT width, UINT height, UINT radius)
+{
+	// Every height in the row averages the same rows, so there is nothing to
+	// test per height.
+	UINT lo = i > radius ? i - radius : 0;
+	UINT hi = std::min(i + radius, height - 1);
+
+	float invCount = 1.0f / (hi - lo + 1);
+	XMVECTOR vInvCount = XMVectorReplicate(invCount);
+
+	const float* first = src + (size_t)lo*width;
+	float* row = dest + (size_t)i*width;
+
+	UINT j = 0;
+	for(; j+4 <= width; j += 4)
+	{
+		XMVECTOR sum = LoadFloats(first + j);
+		for(UINT k = 1; k <= hi - lo; ++k)
+			sum += LoadFloats(first + (size_t)k*width + j);
+		StoreFloats(row + j, sum*vInvCount);
+	}
+
+	for(; j < width; ++j)
+	{
+		float sum = first[j];
+		for(UINT k = 1; k <= hi - lo; ++k)
+			sum += first[(size_t)k*width + j];
+		row[j] = sum*invCount;
+	}
+}
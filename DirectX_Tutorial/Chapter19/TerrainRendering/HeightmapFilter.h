@@ -0,0 +1,29 @@
+#pragma once
+
+#include <Windows.h>
+#include <directxmath.h>
+#include <vector>
+
+using namespace DirectX;
+
+class JobSystem;
+
+class HeightmapFilter
+{
+public:
+	// Replaces every height with the average of the (2*radius+1)^2 heights
+	// around it, counting only the ones inside the map; radius 1 is the 3x3
+	// average Terrain::Smooth always did.  Each iteration blurs the result of
+	// the previous one, and three iterations come close to a Gaussian blur.
+	//
+	// The average is taken along the rows into scratch and then down the
+	// columns back into heights, so there is no copy at the end; scratch is
+	// resized to the map and can be kept between calls.  Rows are spread over
+	// the job system's threads when one is given.
+	static void BoxBlur(std::vector<float>& heights, UINT width, UINT height, UINT radius,
+		UINT iterations, std::vector<float>& scratch, JobSystem* jobSystem = 0);
+
+private:
+	static void BlurRow(const float* src, float* dest, UINT width, UINT radius);
+	static void BlurColumns(const float* src, float* dest, UINT i, UINT width, UINT height, UINT radius);
+};
@@ -0,0 +1,158 @@
+#include "HeightmapLoader.h"
+#include <algorithm>
+#include <cfloat>
+#include <fstream>
+
+bool HeightmapLoader::LoadRaw(const std::wstring& filename, UINT width, UINT height, UINT bitDepth,
+							  float heightScale, UINT cellsPerPatch, std::vector<float>& heights,
+							  std::vector<XMFLOAT2>& patchBoundsY, std::vector<PatchBoundsLevel>& levels)
+{
+	cellsPerPatch = std::max(cellsPerPatch, 1u);
+
+	UINT bytesPerSample = bitDepth == 16 ? 2 : 1;
+	float sampleScale   = heightScale / (bitDepth == 16 ? 65535.0f : 255.0f);
+
+	heights.resize((size_t)width*height);
+	BeginPatchBounds(width, height, cellsPerPatch, patchBoundsY, levels);
+
+	std::ifstream fin(filename.c_str(), std::ios_base::binary);
+	bool complete = fin.is_open();
+
+	// One band of rows of the file at a time.
+	UINT bandRows = cellsPerPatch;
+	std::vector<unsigned char> band((size_t)bandRows*width*bytesPerSample);
+
+	for(UINT firstRow = 0; firstRow < height; firstRow += bandRows)
+	{
+		UINT rowCount    = std::min(bandRows, height - firstRow);
+		size_t bandBytes = (size_t)rowCount*width*bytesPerSample;
+
+		size_t bytesRead = 0;
+		if( complete )
+		{
+			fin.read(reinterpret_cast<char*>(&band[0]), bandBytes);
+			bytesRead = (size_t)fin.gcount();
+			complete  = bytesRead == bandBytes;
+		}
+		std::fill(band.begin() + bytesRead, band.begin() + bandBytes, (unsigned char)0);
+
+		float* dest = &heights[(size_t)firstRow*width];
+		size_t sampleCount = (size_t)rowCount*width;
+		if( bytesPerSample == 2 )
+		{
+			for(size_t k = 0; k < sampleCount; ++k)
+				dest[k] = (band[2*k] | (band[2*k+1] << 8))*sampleScale;
+		}
+		else
+		{
+			for(size_t k = 0; k < sampleCount; ++k)
+				dest[k] = band[k]*sampleScale;
+		}
+
+		for(UINT r = 0; r < rowCount; ++r)
+			AddRowToPatchBounds(dest + (size_t)r*width, firstRow + r, width, cellsPerPatch, patchBoundsY, levels[0]);
+	}
+
+	BuildUpperLevels(patchBoundsY, levels);
+
+	return complete;
+}
+
+void HeightmapLoader::BuildPatchBounds(const std::vector<float>& heights, UINT width, UINT height,
+									   UINT cellsPerPatch, std::vector<XMFLOAT2>& patchBoundsY,
+									   std::vector<PatchBoundsLevel>& levels)
+{
+	cellsPerPatch = std::max(cellsPerPatch, 1u);
+
+	BeginPatchBounds(width, height, cellsPerPatch, patchBoundsY, levels);
+
+	for(UINT i = 0; i < height; ++i)
+		AddRowToPatchBounds(&heights[(size_t)i*width], i, width, cellsPerPatch, patchBoundsY, levels[0]);
+
+	BuildUpperLevels(patchBoundsY, levels);
+}
+
+void HeightmapLoader::BeginPatchBounds(UINT width, UINT height, UINT cellsPerPatch,
+									   std::vector<XMFLOAT2>& patchBoundsY, std::vector<PatchBoundsLevel>& levels)
+{
+	PatchBoundsLevel level0;
+	level0.FirstPatch   = 0;
+	level0.NumPatchRows = std::max(1u, (height - 1 + cellsPerPatch - 1) / cellsPerPatch);
+	level0.NumPatchCols = std::max(1u, (width - 1 + cellsPerPatch - 1) / cellsPerPatch);
+
+	levels.assign(1, level0);
+
+	// Room for the levels above, which add up to less than a third of level 0.
+	UINT level0Count = level0.NumPatchRows*level0.NumPatchCols;
+	patchBoundsY.clear();
+	patchBoundsY.reserve(level0Count + level0Count/2 + 32);
+	patchBoundsY.resize(level0Count, XMFLOAT2(+FLT_MAX, -FLT_MAX));
+}
+
+void HeightmapLoader::AddRowToPatchBounds(const float* row, UINT i, UINT width, UINT cellsPerPatch,
+										  std::vector<XMFLOAT2>& patchBoundsY, const PatchBoundsLevel& level0)
+{
+	// Patches share their edge vertices, so a row on a patch boundary is part
+	// of the patch rows above and below it.
+	UINT lowerPatchRow = std::min(i / cellsPerPatch, level0.NumPatchRows - 1);
+	UINT upperPatchRow = (i % cellsPerPatch == 0 && i > 0) ? i/cellsPerPatch - 1 : lowerPatchRow;
+
+	XMFLOAT2* lower = &patchBoundsY[level0.FirstPatch + lowerPatchRow*level0.NumPatchCols];
+	XMFLOAT2* upper = &patchBoundsY[level0.FirstPatch + upperPatchRow*level0.NumPatchCols];
+
+	for(UINT j = 0; j < level0.NumPatchCols; ++j)
+	{
+		UINT x0 = j*cellsPerPatch;
+		UINT x1 = (j == level0.NumPatchCols-1) ? width-1 : std::min(x0 + cellsPerPatch, width-1);
+
+		float minY = +FLT_MAX;
+		float maxY = -FLT_MAX;
+		for(UINT x = x0; x <= x1; ++x)
+		{
+			minY = std::min(minY, row[x]);
+			maxY = std::max(maxY, row[x]);
+		}
+
+		lower[j].x = std::min(lower[j].x, minY);
+		lower[j].y = std::max(lower[j].y, maxY);
+		upper[j].x = std::min(upper[j].x, minY);
+		upper[j].y = std::max(upper[j].y, maxY);
+	}
+}
+
+void HeightmapLoader::BuildUpperLevels(std::vector<XMFLOAT2>& patchBoundsY, std::vector<PatchBoundsLevel>& levels)
+{
+	while( levels.back().NumPatchRows > 1 || levels.back().NumPatchCols > 1 )
+	{
+		PatchBoundsLevel below = levels.back();
+
+		PatchBoundsLevel level;
+		level.FirstPatch   = (UINT)patchBoundsY.size();
+		level.NumPatchRows = (below.NumPatchRows + 1) / 2;
+		level.NumPatchCols = (below.NumPatchCols + 1) / 2;
+
+		for(UINT i = 0; i < level.NumPatchRows; ++i)
+		{
+			for(UINT j = 0; j < level.NumPatchCols; ++j)
+			{
+				XMFLOAT2 bounds(+FLT_MAX, -FLT_MAX);
+
+				UINT i1 = std::min(2*i + 1, below.NumPatchRows - 1);
+				UINT j1 = std::min(2*j + 1, below.NumPatchCols - 1);
+				for(UINT m = 2*i; m <= i1; ++m)
+				{
+					for(UINT n = 2*j; n <= j1; ++n)
+					{
+						const XMFLOAT2& b = patchBoundsY[below.FirstPatch + m*below.NumPatchCols + n];
+						bounds.x = std::min(bounds.x, b.x);
+						bounds.y = std::max(bounds.y, b.y);
+					}
+				}
+
+				patchBoundsY.push_back(bounds);
+			}
+		}
+
+		levels.push_back(level);
+	}
+}
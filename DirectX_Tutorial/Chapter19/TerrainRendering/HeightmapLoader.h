@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Windows.h>
+#include <directxmath.h>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+///<summary>
+/// One level of the patch bounds pyramid.  Level 0 has one patch per
+/// cellsPerPatch x cellsPerPatch cells of the heightmap (the last row and
+/// column of patches take whatever cells are left); every level above merges
+/// 2x2 patches of the level below it, up to a single patch for the whole map.
+/// Each patch holds the (min, max) height of the vertices it covers.
+///</summary>
+struct PatchBoundsLevel
+{
+	UINT FirstPatch; // Index of the level's first patch in the bounds array.
+	UINT NumPatchRows;
+	UINT NumPatchCols;
+};
+
+class HeightmapLoader
+{
+public:
+	// Reads a width x height RAW heightmap of 8 or 16 bit (little-endian)
+	// samples into heights, scaled to [0, heightScale].  The file is read a
+	// band of cellsPerPatch rows at a time and the patch bounds pyramid is
+	// built from each band as it arrives, so the file is never held in memory
+	// next to the heights.  Returns false if the file could not be opened or
+	// ended early; the missing samples are 0.
+	static bool LoadRaw(const std::wstring& filename, UINT width, UINT height, UINT bitDepth,
+		float heightScale, UINT cellsPerPatch, std::vector<float>& heights,
+		std::vector<XMFLOAT2>& patchBoundsY, std::vector<PatchBoundsLevel>& levels);
+
+	// Builds the patch bounds pyramid of heights already in memory.
+	static void BuildPatchBounds(const std::vector<float>& heights, UINT width, UINT height,
+		UINT cellsPerPatch, std::vector<XMFLOAT2>& patchBoundsY, std::vector<PatchBoundsLevel>& levels);
+
+private:
+	static void BeginPatchBounds(UINT width, UINT height, UINT cellsPerPatch,
+		std::vector<XMFLOAT2>& patchBoundsY, std::vector<PatchBoundsLevel>& levels);
+	static void AddRowToPatchBounds(const float* row, UINT i, UINT width, UINT cellsPerPatch,
+		std::vector<XMFLOAT2>& patchBoundsY, const PatchBoundsLevel& level0);
+	static void BuildUpperLevels(std::vector<XMFLOAT2>& patchBoundsY, std::vector<PatchBoundsLevel>& levels);
+};
@@ -0,0 +1,212 @@
+//***************************************************************************************
+// HeightmapQueryBenchmark.cpp
+//
+// Headless benchmark of the HeightmapSampler queries behind Terrain::GetHeight and
+// Terrain::GetHeights.  It generates a heightmap and a batch of random points (a
+// few outside the terrain, to exercise the clamping) and reports queries per second
+// for
+//   -GetHeight, one point at a time,
+//   -GetHeights, four points at a time,
+//   -GetHeights with normals,
+//   -GetHeights with normals, the batch split over every hardware thread.
+// Every result is checked against a plain double precision evaluation of the same
+// bilinear heights and interpolated slopes; the benchmark prints the largest errors
+// and returns 1 if any of them is out of tolerance.
+//
+// Build with:
+//   cl /EHsc /O2 HeightmapSampler.cpp ..\..\Common\JobSystem.cpp HeightmapQueryBenchmark.cpp
+//
+// Usage: HeightmapQueryBenchmark [size [points]]      (default 2049 1000000)
+//***************************************************************************************
+
+#include "HeightmapSampler.h"
+#include "../../Common/JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+	const float CellSpacing = 0.5f;
+
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	UINT Random(UINT& state)
+	{
+		state = state*1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	// Hills with a little noise, in [0, 500].
+	void MakeHeightmap(std::vector<float>& heights, UINT size)
+	{
+		heights.resize((size_t)size*size);
+
+		UINT random = 12345;
+		for(UINT i = 0; i < size; ++i)
+		{
+			for(UINT j = 0; j < size; ++j)
+			{
+				float noise = Random(random) / 16777216.0f;
+				heights[(size_t)i*size + j] = 200.0f + 150.0f*(sinf(i*0.01f) + cosf(j*0.013f)) + 50.0f*noise;
+			}
+		}
+	}
+
+	//
+	// The queries written out directly, in double precision.
+	//
+
+	struct Reference
+	{
+		const std::vector<float>& Heights;
+		int Size;
+
+		double At(int i, int j)const
+		{
+			i = std::min(std::max(i, 0), Size-1);
+			j = std::min(std::max(j, 0), Size-1);
+			return Heights[(size_t)i*Size + j];
+		}
+
+		double SlopeX(int i, int j)const
+		{
+			int left = std::max(j-1, 0), right = std::min(j+1, Size-1);
+			return (At(i, right) - At(i, left)) / (std::max(right-left, 1)*(double)CellSpacing);
+		}
+
+		double SlopeZ(int i, int j)const
+		{
+			int above = std::max(i-1, 0), below = std::min(i+1, Size-1);
+			return (At(above, j) - At(below, j)) / (std::max(below-above, 1)*(double)CellSpacing);
+		}
+
+		template<typename F>
+		double Bilinear(float x, float z, F f)const
+		{
+			// Points go to cell space in float, as the sampler does; the rounding
+			// there moves a point by a fraction of a millimetre, which on a noisy
+			// heightmap changes the answer more than the rest of the sum does.
+			float halfSize = 0.5f*(Size-1)*CellSpacing;
+			double c = std::min(std::max((double)((x + halfSize)/CellSpacing), 0.0), (double)(Size-1));
+			double d = std::min(std::max((double)((halfSize - z)/CellSpacing), 0.0), (double)(Size-1));
+
+			int j = std::min((int)c, std::max(Size-2, 0));
+			int i = std::min((int)d, std::max(Size-2, 0));
+			double s = c - j, t = d - i;
+
+			return (1-t)*((1-s)*f(i, j) + s*f(i, j+1)) + t*((1-s)*f(i+1, j) + s*f(i+1, j+1));
+		}
+
+		double Height(float x, float z)const
+		{
+			return Bilinear(x, z, [this](int i, int j) { return At(i, j); });
+		}
+
+		void Normal(float x, float z, double n[3])const
+		{
+			double dhdx = Bilinear(x, z, [this](int i, int j) { return SlopeX(i, j); });
+			double dhdz = Bilinear(x, z, [this](int i, int j) { return SlopeZ(i, j); });
+			double length = sqrt(dhdx*dhdx + 1.0 + dhdz*dhdz);
+			n[0] = -dhdx/length;
+			n[1] = 1.0/length;
+			n[2] = -dhdz/length;
+		}
+	};
+}
+
+int main(int argc, char* argv[])
+{
+	UINT size   = argc > 1 ? (UINT)std::max(2, atoi(argv[1])) : 2049;
+	UINT points = argc > 2 ? (UINT)std::max(1, atoi(argv[2])) : 1000000;
+
+	std::vector<float> heightmap;
+	MakeHeightmap(heightmap, size);
+
+	// Spread the points a little past the edges of the terrain.
+	float extent = 0.55f*(size-1)*CellSpacing;
+	std::vector<XMFLOAT2> xz(points);
+	UINT random = 6789;
+	for(UINT k = 0; k < points; ++k)
+	{
+		xz[k].x = (Random(random) / 16777216.0f * 2.0f - 1.0f)*extent;
+		xz[k].y = (Random(random) / 16777216.0f * 2.0f - 1.0f)*extent;
+	}
+
+	HeightmapSampler sampler(&heightmap[0], size, size, CellSpacing);
+	JobSystem jobSystem;
+
+	std::vector<float> scalarHeights(points), heights(points), heightsWithNormals(points), threadedHeights(points);
+	std::vector<XMFLOAT3> normals(points), threadedNormals(points);
+
+	double start = Now();
+	for(UINT k = 0; k < points; ++k)
+		scalarHeights[k] = sampler.GetHeight(xz[k].x, xz[k].y);
+	double scalarTime = Now() - start;
+
+	start = Now();
+	sampler.GetHeights(&xz[0], &heights[0], points);
+	double batchTime = Now() - start;
+
+	start = Now();
+	sampler.GetHeights(&xz[0], &heightsWithNormals[0], &normals[0], points);
+	double normalTime = Now() - start;
+
+	start = Now();
+	jobSystem.ParallelFor(0, points, 4096, [&](UINT first, UINT last)
+	{
+		sampler.GetHeights(&xz[first], &threadedHeights[first], &threadedNormals[first], last - first);
+	});
+	double threadedTime = Now() - start;
+
+	printf("%u x %u heightmap, %u points, %u threads\n\n", size, size, points, jobSystem.ThreadCount());
+	printf("%-28s %14s %8s\n", "", "Mqueries/s", "x scalar");
+	printf("%-28s %14.2f %8.2f\n", "GetHeight", points/scalarTime*1e-6, 1.0);
+	printf("%-28s %14.2f %8.2f\n", "GetHeights", points/batchTime*1e-6, scalarTime/batchTime);
+	printf("%-28s %14.2f %8.2f\n", "GetHeights + normals", points/normalTime*1e-6, scalarTime/normalTime);
+	printf("%-28s %14.2f %8.2f\n", "GetHeights + normals + jobs", points/threadedTime*1e-6, scalarTime/threadedTime);
+
+	//
+	// Check every result against the reference.
+	//
+
+	Reference reference = { heightmap, (int)size };
+
+	double maxHeightError = 0.0, maxNormalError = 0.0;
+	for(UINT k = 0; k < points; ++k)
+	{
+		double h = reference.Height(xz[k].x, xz[k].y);
+		double n[3];
+		reference.Normal(xz[k].x, xz[k].y, n);
+
+		maxHeightError = std::max(maxHeightError, fabs(scalarHeights[k] - h));
+		maxHeightError = std::max(maxHeightError, fabs(heights[k] - h));
+		maxHeightError = std::max(maxHeightError, fabs(heightsWithNormals[k] - h));
+		maxHeightError = std::max(maxHeightError, fabs(threadedHeights[k] - h));
+
+		const XMFLOAT3* results[2] = { &normals[k], &threadedNormals[k] };
+		for(int r = 0; r < 2; ++r)
+		{
+			maxNormalError = std::max(maxNormalError, fabs(results[r]->x - n[0]));
+			maxNormalError = std::max(maxNormalError, fabs(results[r]->y - n[1]));
+			maxNormalError = std::max(maxNormalError, fabs(results[r]->z - n[2]));
+		}
+	}
+
+	// Heights are in [0, 500]; float keeps about 7 significant digits.
+	const double HeightTolerance = 1e-3;
+	const double NormalTolerance = 1e-4;
+
+	bool passed = maxHeightError <= HeightTolerance && maxNormalError <= NormalTolerance;
+	printf("\nmax height error %g, max normal error %g: %s\n",
+		maxHeightError, maxNormalError, passed ? "ok" : "FAILED");
+
+	return passed ? 0 : 1;
+}
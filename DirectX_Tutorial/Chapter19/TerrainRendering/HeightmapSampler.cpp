@@ -0,0 +1,179 @@
+#include "HeightmapSampler.h"
+#include <algorithm>
+#include <cmath>
+
+HeightmapSampler::HeightmapSampler(const float* heights, UINT width, UINT height, float cellSpacing)
+	: mHeights(heights), mWidth(width), mHeight(height), mCellSpacing(cellSpacing)
+{
+}
+
+float HeightmapSampler::GetHeight(float x, float z)const
+{
+	// Transform from terrain local space to "cell" space.
+	float c = (x + 0.5f*(mWidth-1)*mCellSpacing) / mCellSpacing;
+	float d = (0.5f*(mHeight-1)*mCellSpacing - z) / mCellSpacing;
+
+	c = std::min(std::max(c, 0.0f), (float)(mWidth-1));
+	d = std::min(std::max(d, 0.0f), (float)(mHeight-1));
+
+	// Get the row and column we are in.  The last row and column of heights
+	// belong to the cells before them.
+	float col = std::min(floorf(c), (float)(mWidth > 1 ? mWidth-2 : 0));
+	float row = std::min(floorf(d), (float)(mHeight > 1 ? mHeight-2 : 0));
+
+	UINT j0 = (UINT)col;
+	UINT i0 = (UINT)row;
+	UINT j1 = std::min(j0+1, mWidth-1);
+	UINT i1 = std::min(i0+1, mHeight-1);
+
+	// Grab the heights of the cell we are in.
+	// A*--*B
+	//  |  |
+	// C*--*D
+	float A = At(i0, j0);
+	float B = At(i0, j1);
+	float C = At(i1, j0);
+	float D = At(i1, j1);
+
+	// Where we are relative to the cell.
+	float s = c - col;
+	float t = d - row;
+
+	float top    = A + s*(B - A);
+	float bottom = C + s*(D - C);
+	return top + t*(bottom - top);
+}
+
+void HeightmapSampler::GetHeights(const XMFLOAT2* xz, float* heights, size_t n)const
+{
+	GetHeights(xz, heights, 0, n);
+}
+
+void HeightmapSampler::GetHeights(const XMFLOAT2* xz, float* heights, XMFLOAT3* normals, size_t n)const
+{
+	size_t k = 0;
+	for(; k+4 <= n; k += 4)
+		GetHeights4(xz + k, heights + k, normals ? normals + k : 0);
+
+	if( k == n )
+		return;
+
+	// Pad the last few points to four with copies of the last one.
+	XMFLOAT2 lastXZ[4];
+	float lastHeights[4];
+	XMFLOAT3 lastNormals[4];
+	for(size_t m = 0; m < 4; ++m)
+		lastXZ[m] = xz[std::min(k+m, n-1)];
+
+	GetHeights4(lastXZ, lastHeights, normals ? lastNormals : 0);
+
+	for(size_t m = 0; k+m < n; ++m)
+	{
+		heights[k+m] = lastHeights[m];
+		if( normals )
+			normals[k+m] = lastNormals[m];
+	}
+}
+
+void HeightmapSampler::GetHeights4(const XMFLOAT2* xz, float* heights, XMFLOAT3* normals)const
+{
+	//
+	// Find the cells of the four points, as in GetHeight.
+	//
+
+	XMVECTOR x = XMVectorSet(xz[0].x, xz[1].x, xz[2].x, xz[3].x);
+	XMVECTOR z = XMVectorSet(xz[0].y, xz[1].y, xz[2].y, xz[3].y);
+
+	XMVECTOR spacing = XMVectorReplicate(mCellSpacing);
+	XMVECTOR c = (x + XMVectorReplicate(0.5f*(mWidth-1)*mCellSpacing)) / spacing;
+	XMVECTOR d = (XMVectorReplicate(0.5f*(mHeight-1)*mCellSpacing) - z) / spacing;
+
+	XMVECTOR zero = XMVectorZero();
+	c = XMVectorClamp(c, zero, XMVectorReplicate((float)(mWidth-1)));
+	d = XMVectorClamp(d, zero, XMVectorReplicate((float)(mHeight-1)));
+
+	XMVECTOR col = XMVectorMin(XMVectorFloor(c), XMVectorReplicate((float)(mWidth > 1 ? mWidth-2 : 0)));
+	XMVECTOR row = XMVectorMin(XMVectorFloor(d), XMVectorReplicate((float)(mHeight > 1 ? mHeight-2 : 0)));
+
+	XMVECTOR s = c - col;
+	XMVECTOR t = d - row;
+
+	XMFLOAT4 cols, rows;
+	XMStoreFloat4(&cols, col);
+	XMStoreFloat4(&rows, row);
+
+	UINT j0[4] = { (UINT)cols.x, (UINT)cols.y, (UINT)cols.z, (UINT)cols.w };
+	UINT i0[4] = { (UINT)rows.x, (UINT)rows.y, (UINT)rows.z, (UINT)rows.w };
+
+	//
+	// Gather the corner heights of the four cells and interpolate them.
+	//
+
+	XMFLOAT4 A, B, C, D;
+	float* corners[4] = { &A.x, &B.x, &C.x, &D.x };
+	for(UINT k = 0; k < 4; ++k)
+	{
+		UINT j1 = std::min(j0[k]+1, mWidth-1);
+		UINT i1 = std::min(i0[k]+1, mHeight-1);
+
+		corners[0][k] = At(i0[k], j0[k]);
+		corners[1][k] = At(i0[k], j1);
+		corners[2][k] = At(i1, j0[k]);
+		corners[3][k] = At(i1, j1);
+	}
+
+	XMVECTOR top    = XMVectorLerpV(XMLoadFloat4(&A), XMLoadFloat4(&B), s);
+	XMVECTOR bottom = XMVectorLerpV(XMLoadFloat4(&C), XMLoadFloat4(&D), s);
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(heights), XMVectorLerpV(top, bottom, t));
+
+	if( normals == 0 )
+		return;
+
+	//
+	// Slopes dh/dx and dh/dz at the corners by central differences (one-sided
+	// on the edges of the map), interpolated like the heights.  The normal of
+	// h(x, z) is then (-dh/dx, 1, -dh/dz), normalized.
+	//
+
+	XMFLOAT4 slopeX[4], slopeZ[4];
+	for(UINT k = 0; k < 4; ++k)
+	{
+		for(UINT corner = 0; corner < 4; ++corner)
+		{
+			UINT i = std::min(i0[k] + corner/2, mHeight-1);
+			UINT j = std::min(j0[k] + corner%2, mWidth-1);
+
+			UINT left   = j > 0 ? j-1 : 0;
+			UINT right  = std::min(j+1, mWidth-1);
+			UINT above  = i > 0 ? i-1 : 0;
+			UINT below  = std::min(i+1, mHeight-1);
+
+			// Rows run along -z.
+			(&slopeX[corner].x)[k] = (At(i, right) - At(i, left)) / (std::max(right - left, 1u)*mCellSpacing);
+			(&slopeZ[corner].x)[k] = (At(above, j) - At(below, j)) / (std::max(below - above, 1u)*mCellSpacing);
+		}
+	}
+
+	XMVECTOR topX    = XMVectorLerpV(XMLoadFloat4(&slopeX[0]), XMLoadFloat4(&slopeX[1]), s);
+	XMVECTOR bottomX = XMVectorLerpV(XMLoadFloat4(&slopeX[2]), XMLoadFloat4(&slopeX[3]), s);
+	XMVECTOR dhdx    = XMVectorLerpV(topX, bottomX, t);
+
+	XMVECTOR topZ    = XMVectorLerpV(XMLoadFloat4(&slopeZ[0]), XMLoadFloat4(&slopeZ[1]), s);
+	XMVECTOR bottomZ = XMVectorLerpV(XMLoadFloat4(&slopeZ[2]), XMLoadFloat4(&slopeZ[3]), s);
+	XMVECTOR dhdz    = XMVectorLerpV(topZ, bottomZ, t);
+
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR length = XMVectorSqrt(dhdx*dhdx + one + dhdz*dhdz);
+
+	// Transposing turns the component-per-register layout into one normal per
+	// register.
+	XMMATRIX n;
+	n.r[0] = -dhdx / length;
+	n.r[1] = one / length;
+	n.r[2] = -dhdz / length;
+	n.r[3] = zero;
+	n = XMMatrixTranspose(n);
+
+	for(UINT k = 0; k < 4; ++k)
+		XMStoreFloat3(&normals[k], n.r[k]);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Windows.h>
+#include <directxmath.h>
+
+using namespace DirectX;
+
+///<summary>
+/// Height and normal queries on a heightmap laid out the way Terrain lays it
+/// out: width x height heights, cellSpacing apart, centred on the origin of
+/// the terrain's local space with row 0 at +z.  Heights are interpolated
+/// bilinearly between the four heights around the point, as the GPU samples
+/// the heightmap; normals come from bilinearly interpolated finite difference
+/// slopes.  Points outside the terrain are clamped to its edge.
+///
+/// A sampler does not own the heights and never writes anything, so any
+/// number of threads can query the same heightmap at once.
+///</summary>
+class HeightmapSampler
+{
+public:
+	HeightmapSampler(const float* heights, UINT width, UINT height, float cellSpacing);
+
+	float GetHeight(float x, float z)const;
+
+	// Heights at the n points (x, z), four at a time.
+	void GetHeights(const XMFLOAT2* xz, float* heights, size_t n)const;
+
+	// Same as above, also writing the unit normal at each point.
+	void GetHeights(const XMFLOAT2* xz, float* heights, XMFLOAT3* normals, size_t n)const;
+
+private:
+	void GetHeights4(const XMFLOAT2* xz, float* heights, XMFLOAT3* normals)const;
+
+	float At(UINT i, UINT j)const { return mHeights[(size_t)i*mWidth + j]; }
+
+private:
+	const float* mHeights;
+	UINT mWidth;
+	UINT mHeight;
+	float mCellSpacing;
+};
@@ -11,7 +11,8 @@ Terrain::Terrain() :
 	mNumPatchVertices(0),
 	mNumPatchQuadFaces(0),
 	mNumPatchVertRows(0),
-	mNumPatchVertCols(0)
+	mNumPatchVertCols(0),
+	mJobSystem(0)
 {
 	XMStoreFloat4x4(&mWorld, XMMatrixIdentity());
 
@@ -29,57 +30,66 @@ Terrain::~Terrain()
 	SAFE_RELEASE(mHeightMapSRV);
 }
 
+void Terrain::LoadHeightmap()
+{
+	// Missing samples of a short or absent file read as 0.
+	HeightmapLoader::LoadRaw(mInfo.HeightMapFilename, mInfo.HeightmapWidth, mInfo.HeightmapHeight,
+		mInfo.HeightmapBitDepth, mInfo.HeightScale, CellsPerPatch, mHeightmap, mPatchBoundsY, mPatchBoundsLevels);
+
+	// One patch vertex at each corner of the level 0 patches.
+	mNumPatchVertRows = mPatchBoundsLevels[0].NumPatchRows + 1;
+	mNumPatchVertCols = mPatchBoundsLevels[0].NumPatchCols + 1;
+}
+
 
 
 
 
-bool Terrain::InBounds(int i, int j)
+float Terrain::GetWidth()const
+{
+	// Total terrain width.
+	return (mInfo.HeightmapWidth-1)*mInfo.CellSpacing;
+}
+
+float Terrain::GetDepth()const
+{
+	// Total terrain depth.
+	return (mInfo.HeightmapHeight-1)*mInfo.CellSpacing;
+}
+
+float Terrain::GetHeight(float x, float z)const
 {
-	return i >= 0 && i < (int)mInfo.HeightmapHeight 
-		&& j >= 0 && j < (int)mInfo.HeightmapWidth;
+	return HeightmapSampler(&mHeightmap[0], mInfo.HeightmapWidth, mInfo.HeightmapHeight,
+		mInfo.CellSpacing).GetHeight(x, z);
 }
 
-float Terrain::Average(UINT i, UINT j)
+void Terrain::GetHeights(const XMFLOAT2* xz, float* heights, size_t n)const
 {
-	// ------------
-	// | 1|  2 | 3|
-	// ----------
-	// | 4| ij | 6|
-	// ----------
-	// | 7|  8 | 9|
-	// ------------
-
-	float avg = 0.0f;
-	float num = 0.0f;
-
-	for (int m = i - 1; m <= i + 1; m++)
-	{
-		for (int n = j - 1; n <= j + 1; n++)
-		{
-			if (InBounds(m, n))
-			{
-				avg += mHeightmap[m * mInfo.HeightmapWidth + n];
-				num += 1.0f;
-			}
-		}
-	}
-
-	return avg / num;
+	HeightmapSampler(&mHeightmap[0], mInfo.HeightmapWidth, mInfo.HeightmapHeight,
+		mInfo.CellSpacing).GetHeights(xz, heights, n);
 }
 
-void Terrain::Smooth()
+void Terrain::GetHeights(const XMFLOAT2* xz, float* heights, XMFLOAT3* normals, size_t n)const
 {
-	std::vector<float> dest(mHeightmap.size());
+	HeightmapSampler(&mHeightmap[0], mInfo.HeightmapWidth, mInfo.HeightmapHeight,
+		mInfo.CellSpacing).GetHeights(xz, heights, normals, n);
+}
 
-	for (UINT i = 0; i < mInfo.HeightmapHeight; i++)
-	{
-		for (UINT j = 0; j < mInfo.HeightmapWidth; j++)
-		{
-			dest[i * mInfo.HeightmapWidth + j] = Average(i, j);
-		}
-	}
+void Terrain::SetJobSystem(JobSystem* jobSystem)
+{
+	mJobSystem = jobSystem;
+}
 
-	mHeightmap = dest;
+void Terrain::Smooth(UINT radius, UINT iterations)
+{
+	std::vector<float> scratch;
+	HeightmapFilter::BoxBlur(mHeightmap, mInfo.HeightmapWidth, mInfo.HeightmapHeight,
+		radius, iterations, scratch, mJobSystem);
+
+	// Smoothing carries heights across patch edges, so the bounds have to be
+	// built again.
+	HeightmapLoader::BuildPatchBounds(mHeightmap, mInfo.HeightmapWidth, mInfo.HeightmapHeight,
+		CellsPerPatch, mPatchBoundsY, mPatchBoundsLevels);
 }
 
 
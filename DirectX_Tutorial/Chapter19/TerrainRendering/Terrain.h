@@ -7,6 +7,9 @@
 #include <fstream>
 #include <sstream>
 #include "LightHelper.h"
+#include "HeightmapLoader.h"
+#include "HeightmapFilter.h"
+#include "HeightmapSampler.h"
 
 using namespace DirectX;
 
@@ -28,6 +31,9 @@ public:
 		UINT HeightmapWidth;
 		UINT HeightmapHeight;
 
+		// 8 or 16 bits per sample.
+		UINT HeightmapBitDepth;
+
 		// The cell spacing along the x- and z-axes
 		float CellSpacing;
 	};
@@ -40,17 +46,24 @@ public:
 	float GetDepth()const;
 	float GetHeight(float x, float z)const;
 
+	// Bilinear heights (and normals) at the n points (x, z) of the terrain's
+	// local space, four at a time.  Safe to call from several threads at once.
+	void GetHeights(const XMFLOAT2* xz, float* heights, size_t n)const;
+	void GetHeights(const XMFLOAT2* xz, float* heights, XMFLOAT3* normals, size_t n)const;
+
 	void SetWorld(CXMMATRIX M);
 	XMMATRIX GetWorld()const;
 
+	// Spread heightmap processing over the job system's threads.  Pass 0 to
+	// use the calling thread only.
+	void SetJobSystem(JobSystem* jobSystem);
+
 	void Init(ID3D11Device* device, ID3D11DeviceContext* dc, const InitInfo& initInfo);
 	void Draw(ID3D11DeviceContext* dc, CModelViewerCamera camera, DirectionalLight lights[3]);
 
 private:
 	void LoadHeightmap();
-	void Smooth();
-	bool InBounds(int i, int j);
-	float Average(UINT i, UINT j);
+	void Smooth(UINT radius = 1, UINT iterations = 1);
 	void BuildQuadPatchVB(ID3D11Device* device);
 	void BuildQuadPatchIB(ID3D11Device* device);
 	void BuildHeightmapSRV(ID3D11Device* pd3dDevice);
@@ -63,6 +76,7 @@ private:
 	
 	std::vector<float> mHeightmap;
 	std::vector<XMFLOAT2> mPatchBoundsY;
+	std::vector<PatchBoundsLevel> mPatchBoundsLevels;
 
 	InitInfo mInfo;
 
@@ -81,4 +95,6 @@ private:
 	ID3D11ShaderResourceView* mLayerMapArraySRV;
 	ID3D11ShaderResourceView* mBlendMapSRV;
 	ID3D11ShaderResourceView* mHeightMapSRV;
+
+	JobSystem* mJobSystem;
 };
\ No newline at end of file
@@ -0,0 +1,166 @@
+//***************************************************************************************
+// TerrainSmoothBenchmark.cpp
+//
+// Headless benchmark of HeightmapFilter::BoxBlur against the 3x3 average that
+// Terrain::Smooth used before it (InBounds/Average per height, then a copy of the
+// whole heightmap).  For every size it smooths the same generated heightmap with
+//   -the old per-height average,
+//   -BoxBlur with radius 1 on one thread,
+//   -BoxBlur with radius 1 on every hardware thread,
+// reports the largest difference between the old and new results, and then times
+// a wider blur (radius 2, three iterations) for reference.
+//
+// Build with:
+//   cl /EHsc /O2 HeightmapFilter.cpp ..\..\Common\JobSystem.cpp TerrainSmoothBenchmark.cpp
+//
+// Usage: TerrainSmoothBenchmark [size ...]      (default 1025 4097)
+//***************************************************************************************
+
+#include "HeightmapFilter.h"
+#include "../../Common/JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	//
+	// The filter Terrain::Smooth used to run.
+	//
+
+	struct ReferenceSmooth
+	{
+		std::vector<float>& Heightmap;
+		UINT Width;
+		UINT Height;
+
+		bool InBounds(int i, int j)
+		{
+			return i >= 0 && i < (int)Height
+				&& j >= 0 && j < (int)Width;
+		}
+
+		float Average(UINT i, UINT j)
+		{
+			float avg = 0.0f;
+			float num = 0.0f;
+
+			for (int m = i - 1; m <= (int)i + 1; m++)
+			{
+				for (int n = j - 1; n <= (int)j + 1; n++)
+				{
+					if (InBounds(m, n))
+					{
+						avg += Heightmap[m * Width + n];
+						num += 1.0f;
+					}
+				}
+			}
+
+			return avg / num;
+		}
+
+		void Smooth()
+		{
+			std::vector<float> dest(Heightmap.size());
+
+			for (UINT i = 0; i < Height; i++)
+			{
+				for (UINT j = 0; j < Width; j++)
+				{
+					dest[i * Width + j] = Average(i, j);
+				}
+			}
+
+			Heightmap = dest;
+		}
+	};
+
+	// Hills with a little noise, in [0, 500].
+	void MakeHeightmap(std::vector<float>& heights, UINT size)
+	{
+		heights.resize((size_t)size*size);
+
+		UINT random = 12345;
+		for(UINT i = 0; i < size; ++i)
+		{
+			for(UINT j = 0; j < size; ++j)
+			{
+				random = random*1664525u + 1013904223u;
+				float noise = (random >> 8) / 16777216.0f;
+				heights[(size_t)i*size + j] = 200.0f + 150.0f*(sinf(i*0.01f) + cosf(j*0.013f)) + 50.0f*noise;
+			}
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<UINT> sizes;
+	for(int i = 1; i < argc; ++i)
+		sizes.push_back((UINT)std::max(1, atoi(argv[i])));
+
+	if( sizes.empty() )
+	{
+		sizes.push_back(1025);
+		sizes.push_back(4097);
+	}
+
+	JobSystem jobSystem;
+
+	printf("ms per smooth, %u threads for the threaded column\n\n", jobSystem.ThreadCount());
+	printf("%6s %10s %10s %10s %8s %8s %12s %14s\n",
+		"size", "old 3x3", "box r1", "box+jobs", "x box", "x jobs", "max diff", "r2 x3 + jobs");
+
+	for(size_t s = 0; s < sizes.size(); ++s)
+	{
+		UINT size = sizes[s];
+
+		std::vector<float> source;
+		MakeHeightmap(source, size);
+
+		std::vector<float> reference = source;
+		ReferenceSmooth smooth = { reference, size, size };
+		double start = Now();
+		smooth.Smooth();
+		double referenceTime = Now() - start;
+
+		std::vector<float> scratch;
+
+		std::vector<float> serial = source;
+		start = Now();
+		HeightmapFilter::BoxBlur(serial, size, size, 1, 1, scratch);
+		double serialTime = Now() - start;
+
+		std::vector<float> threaded = source;
+		start = Now();
+		HeightmapFilter::BoxBlur(threaded, size, size, 1, 1, scratch, &jobSystem);
+		double threadedTime = Now() - start;
+
+		float maxDiff = 0.0f;
+		for(size_t k = 0; k < reference.size(); ++k)
+		{
+			maxDiff = std::max(maxDiff, std::fabs(serial[k] - reference[k]));
+			maxDiff = std::max(maxDiff, std::fabs(threaded[k] - reference[k]));
+		}
+
+		std::vector<float> wide = source;
+		start = Now();
+		HeightmapFilter::BoxBlur(wide, size, size, 2, 3, scratch, &jobSystem);
+		double wideTime = Now() - start;
+
+		printf("%6u %10.2f %10.2f %10.2f %8.2f %8.2f %12g %14.2f\n",
+			size, referenceTime*1000.0, serialTime*1000.0, threadedTime*1000.0,
+			referenceTime/serialTime, referenceTime/threadedTime, maxDiff, wideTime*1000.0);
+	}
+
+	return 0;
+}
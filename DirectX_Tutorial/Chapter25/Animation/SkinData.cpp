@@ -1,4 +1,5 @@
 #include "SkinData.h"
+#include <algorithm>
 
 
 
@@ -52,28 +53,28 @@ void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M) const
 	}
 	else
 	{
-		for(UINT i = 0; i < Keyframes.size() - 1; ++i)
-		{
-			float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i + 1].TimePos - Keyframes[i].TimePos);
+		// Find the keys that bound t; Keyframes are sorted by time.
+		auto next = std::upper_bound(Keyframes.begin(), Keyframes.end(), t,
+			[](float time, const Keyframe& key) { return time < key.TimePos; });
+		UINT i = (UINT)(next - Keyframes.begin()) - 1;
 
-			XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
-			XMVECTOR s1 = XMLoadFloat3(&Keyframes[i + 1].Scale);
+		float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i + 1].TimePos - Keyframes[i].TimePos);
 
-			XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
-			XMVECTOR p1 = XMLoadFloat3(&Keyframes[i + 1].Translation);
+		XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
+		XMVECTOR s1 = XMLoadFloat3(&Keyframes[i + 1].Scale);
 
-			XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
-			XMVECTOR q1 = XMLoadFloat4(&Keyframes[i + 1].RotationQuat);
+		XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
+		XMVECTOR p1 = XMLoadFloat3(&Keyframes[i + 1].Translation);
 
-			XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
-			XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
-			XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
+		XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
+		XMVECTOR q1 = XMLoadFloat4(&Keyframes[i + 1].RotationQuat);
 
-			XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-			XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+		XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
+		XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
+		XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
 
-			break;
-		}
+		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
 	}
 }
 
@@ -92,7 +93,7 @@ float AnimationClip::GetClipStartTime() const
 
 float AnimationClip::GetClipEndTime() const
 {
-	float t = MathHelper::Infinity;
+	float t = 0.0f;
 	for (BoneAnimation boneAnim : BoneAnimations)
 		t = MathHelper::Max(t, boneAnim.GetEndTime());
 
@@ -1,4 +1,5 @@
 #include "SkinnedModel.h"
+#include "../../Common/MeshOptimizer.h"
 
 void SkinnedModel::ExtractBoneOffsets(const aiScene* scene, std::vector<XMFLOAT4X4>& boneOffsets)
 {
@@ -207,6 +208,24 @@ SkinnedModel::SkinnedModel(ID3D11Device* pd3dDevice, const std::string& modelFil
 		UINT indexCount = indices.size();
 		IndexCount.push_back(indexCount);
 
+		// Assimp keeps the faces and vertices in the order of the file; put
+		// them in vertex cache order and number the vertices in the order they
+		// are used, where that measures better than the order of the file.
+		if (indexCount > 0)
+		{
+			UINT vertexCount = (UINT)Vertices.size();
+			std::vector<unsigned int> remap(vertexCount);
+			unsigned int kept = MeshOptimizer::Optimize(&indices[0], indexCount, vertexCount,
+				sizeof(Vertex::PosNormalTexTanSkinned), &remap[0]);
+
+			if (kept & MeshOptimizer::PassVertexFetch)
+			{
+				std::vector<Vertex::PosNormalTexTanSkinned> remapped(vertexCount);
+				MeshOptimizer::RemapVertices(&remapped[0], &Vertices[0], vertexCount, sizeof(Vertex::PosNormalTexTanSkinned), &remap[0]);
+				Vertices.swap(remapped);
+			}
+		}
+
 		D3D11_BUFFER_DESC vbd = {};
 		vbd.ByteWidth = sizeof(Vertex::PosNormalTexTanSkinned) * Vertices.size();
 		vbd.Usage = D3D11_USAGE_IMMUTABLE;
@@ -0,0 +1,265 @@
+//***************************************************************************************
+// BoundingVolumeBenchmark.cpp
+//
+// Headless benchmark of FitAxisAlignedBoxToPoints, FitSphereToPoints and
+// FitOrientedBoxToPoints against the ComputeBounding*FromPoints functions.  The
+// points are the vertices of skull.txt, read in place from the (pos, normal)
+// vertices through a stride, and the skull repeated with a small jitter to make
+// larger meshes.  Each mesh is fitted as it is, lined up with the axes, and
+// turned so that it is not.  For every mesh it reports
+//   -the time of the old functions, and of the new ones on one thread and on a
+//    JobSystem,
+//   -the radius of both spheres and the volume of both oriented boxes.
+//
+// The new box must equal the old one, the sphere and the oriented box must
+// hold every point, the sphere may be no larger than the old one, and the
+// results on the job system must equal those on one thread.  Returns 1 if any
+// of these fail.
+//
+// Build with:
+//   cl /EHsc /O2 xnacollision.cpp JobSystem.cpp BoundingVolumeBenchmark.cpp
+//
+// Usage: BoundingVolumeBenchmark [skull.txt [copies ...]]
+//        (default ../Chapter16/Models/skull.txt 1 8 32)
+//***************************************************************************************
+
+#include <Windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "xnacollision.h"
+#include "JobSystem.h"
+
+using namespace XNA;
+
+namespace
+{
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	float RandF(UINT& state)
+	{
+		state = state*1664525u + 1013904223u;
+		return (state >> 8) / 16777216.0f;
+	}
+
+	struct Vertex
+	{
+		XMFLOAT3 Pos;
+		XMFLOAT3 Normal;
+	};
+
+	bool LoadSkull(const char* filename, std::vector<Vertex>& vertices)
+	{
+		std::ifstream fin(filename);
+		if( !fin )
+			return false;
+
+		UINT vcount = 0;
+		std::string ignore;
+		fin >> ignore >> vcount;
+		fin >> ignore >> ignore;
+		fin >> ignore >> ignore >> ignore >> ignore;
+
+		vertices.resize(vcount);
+		for(UINT i = 0; i < vcount; ++i)
+		{
+			Vertex& v = vertices[i];
+			fin >> v.Pos.x >> v.Pos.y >> v.Pos.z >> v.Normal.x >> v.Normal.y >> v.Normal.z;
+		}
+		return vcount > 0 && !fin.fail();
+	}
+
+	bool SphereHolds(const Sphere& s, const std::vector<Vertex>& vertices)
+	{
+		XMVECTOR center = XMLoadFloat3(&s.Center);
+		float limit = s.Radius*(1.0f + 1e-5f) + 1e-5f;
+
+		for(size_t i = 0; i < vertices.size(); ++i)
+		{
+			if( XMVectorGetX(XMVector3Length(XMLoadFloat3(&vertices[i].Pos) - center)) > limit )
+				return false;
+		}
+		return true;
+	}
+
+	bool OrientedBoxHolds(const OrientedBox& box, const std::vector<Vertex>& vertices)
+	{
+		XMVECTOR center = XMLoadFloat3(&box.Center);
+		XMVECTOR q = XMLoadFloat4(&box.Orientation);
+		XMVECTOR limit = XMLoadFloat3(&box.Extents)*(1.0f + 1e-5f) + XMVectorReplicate(1e-5f);
+
+		for(size_t i = 0; i < vertices.size(); ++i)
+		{
+			XMVECTOR p = XMVector3InverseRotate(XMLoadFloat3(&vertices[i].Pos) - center, q);
+			if( !XMVector3LessOrEqual(XMVectorAbs(p), limit) )
+				return false;
+		}
+		return true;
+	}
+
+	float Volume(const AxisAlignedBox& box)
+	{
+		return 8.0f*box.Extents.x*box.Extents.y*box.Extents.z;
+	}
+
+	float Volume(const OrientedBox& box)
+	{
+		return 8.0f*box.Extents.x*box.Extents.y*box.Extents.z;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const char* filename = argc > 1 ? argv[1] : "../Chapter16/Models/skull.txt";
+
+	std::vector<UINT> copies;
+	for(int i = 2; i < argc; ++i)
+		copies.push_back((UINT)std::max(1, atoi(argv[i])));
+	if( copies.empty() )
+	{
+		copies.push_back(1);
+		copies.push_back(8);
+		copies.push_back(32);
+	}
+
+	std::vector<Vertex> skull;
+	if( !LoadSkull(filename, skull) )
+	{
+		printf("cannot read %s\n", filename);
+		return 1;
+	}
+
+	JobSystem jobSystem;
+
+	printf("%u threads\n\n", jobSystem.ThreadCount());
+	printf("%-9s %-6s %-7s %9s %9s %9s %8s %8s %12s %12s %7s\n", "points", "turned", "volume", "old ms", "new ms",
+		"new mt ms", "speedup", "mt/old", "old size", "new size", "ok");
+
+	bool passed = true;
+
+	for(size_t run = 0; run < 2*copies.size(); ++run)
+	{
+		size_t c = run / 2;
+		bool turned = (run & 1) != 0;
+
+		// The first copy is the skull itself; the others are jittered by about
+		// a thousandth of its size.
+		std::vector<Vertex> vertices(skull);
+		UINT random = 24680;
+		for(UINT k = 1; k < copies[c]; ++k)
+		{
+			for(size_t i = 0; i < skull.size(); ++i)
+			{
+				Vertex v = skull[i];
+				v.Pos.x += 0.01f*(RandF(random) - 0.5f);
+				v.Pos.y += 0.01f*(RandF(random) - 0.5f);
+				v.Pos.z += 0.01f*(RandF(random) - 0.5f);
+				vertices.push_back(v);
+			}
+		}
+
+		if( turned )
+		{
+			XMVECTOR q = XMQuaternionRotationAxis(XMVectorSet(1.0f, 2.0f, 3.0f, 0.0f), 0.6f);
+			for(size_t i = 0; i < vertices.size(); ++i)
+				XMStoreFloat3(&vertices[i].Pos, XMVector3Rotate(XMLoadFloat3(&vertices[i].Pos), q));
+		}
+
+		UINT count = (UINT)vertices.size();
+		const XMFLOAT3* points = &vertices[0].Pos;
+		UINT stride = sizeof(Vertex);
+
+		// About a tenth of a second of the old functions for every size.
+		UINT repeats = std::max(1u, 1000000u / count);
+
+		AxisAlignedBox oldBox, newBox, mtBox;
+		Sphere oldSphere, newSphere, mtSphere;
+		OrientedBox oldOriented, newOriented, mtOriented;
+		double times[3][3];
+
+		double start = Now();
+		for(UINT r = 0; r < repeats; ++r)
+			ComputeBoundingAxisAlignedBoxFromPoints(&oldBox, count, points, stride);
+		times[0][0] = Now() - start;
+
+		start = Now();
+		for(UINT r = 0; r < repeats; ++r)
+			FitAxisAlignedBoxToPoints(&newBox, count, points, stride);
+		times[0][1] = Now() - start;
+
+		start = Now();
+		for(UINT r = 0; r < repeats; ++r)
+			FitAxisAlignedBoxToPoints(&mtBox, count, points, stride, &jobSystem);
+		times[0][2] = Now() - start;
+
+		start = Now();
+		for(UINT r = 0; r < repeats; ++r)
+			ComputeBoundingSphereFromPoints(&oldSphere, count, points, stride);
+		times[1][0] = Now() - start;
+
+		start = Now();
+		for(UINT r = 0; r < repeats; ++r)
+			FitSphereToPoints(&newSphere, count, points, stride);
+		times[1][1] = Now() - start;
+
+		start = Now();
+		for(UINT r = 0; r < repeats; ++r)
+			FitSphereToPoints(&mtSphere, count, points, stride, &jobSystem);
+		times[1][2] = Now() - start;
+
+		start = Now();
+		for(UINT r = 0; r < repeats; ++r)
+			ComputeBoundingOrientedBoxFromPoints(&oldOriented, count, points, stride);
+		times[2][0] = Now() - start;
+
+		start = Now();
+		for(UINT r = 0; r < repeats; ++r)
+			FitOrientedBoxToPoints(&newOriented, count, points, stride);
+		times[2][1] = Now() - start;
+
+		start = Now();
+		for(UINT r = 0; r < repeats; ++r)
+			FitOrientedBoxToPoints(&mtOriented, count, points, stride, &jobSystem);
+		times[2][2] = Now() - start;
+
+		bool boxOk = memcmp(&oldBox, &newBox, sizeof(AxisAlignedBox)) == 0 &&
+			memcmp(&newBox, &mtBox, sizeof(AxisAlignedBox)) == 0;
+		bool sphereOk = SphereHolds(newSphere, vertices) && newSphere.Radius <= oldSphere.Radius*(1.0f + 1e-5f) &&
+			memcmp(&newSphere, &mtSphere, sizeof(Sphere)) == 0;
+		bool orientedOk = OrientedBoxHolds(newOriented, vertices) &&
+			memcmp(&newOriented, &mtOriented, sizeof(OrientedBox)) == 0;
+
+		const char* names[3] = { "aabb", "sphere", "obb" };
+		double sizes[3][2] =
+		{
+			{ Volume(oldBox), Volume(newBox) },
+			{ oldSphere.Radius, newSphere.Radius },
+			{ Volume(oldOriented), Volume(newOriented) }
+		};
+		bool ok[3] = { boxOk, sphereOk, orientedOk };
+
+		for(UINT v = 0; v < 3; ++v)
+		{
+			printf("%-9u %-6s %-7s %9.3f %9.3f %9.3f %8.2f %8.2f %12.4f %12.4f %7s\n", count, turned ? "yes" : "no", names[v],
+				times[v][0]*1000.0/repeats, times[v][1]*1000.0/repeats, times[v][2]*1000.0/repeats,
+				times[v][0]/times[v][1], times[v][0]/times[v][2], sizes[v][0], sizes[v][1], ok[v] ? "yes" : "NO");
+
+			if( !ok[v] )
+				passed = false;
+		}
+	}
+
+	printf("\nsize is the volume of a box and the radius of a sphere\n");
+	printf("\n%s\n", passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
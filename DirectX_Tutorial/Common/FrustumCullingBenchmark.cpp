@@ -0,0 +1,351 @@
+//***************************************************************************************
+// FrustumCullingBenchmark.cpp
+//
+// Headless benchmark of CullAxisAlignedBoxes and CullSpheres against the loop the
+// instancing demo used, which for every instance inverts its world matrix, moves
+// the camera frustum into the local space of the instance and calls
+// IntersectAxisAlignedBoxFrustum.  Skull sized instances are scattered through a
+// cube that grows with their number, and for each of a few camera poses the
+// scene is culled
+//   -with the old loop,
+//   -with IntersectAxisAlignedBox6Planes / IntersectSphere6Planes per volume,
+//   -with CullAxisAlignedBoxes / CullSpheres on one thread and on a JobSystem,
+// reporting millions of instances culled per second.
+//
+// The batch routines must return exactly the volumes the 6Planes routines keep,
+// and every instance the old loop keeps.  The plane test is conservative: a box
+// near a corner of the frustum can be outside it but not outside any one plane,
+// so the batch routines keep a few more instances than the old loop; those are
+// counted.  Returns 1 if any visible instance is culled.
+//
+// Build with:
+//   cl /EHsc /O2 xnacollision.cpp JobSystem.cpp FrustumCullingBenchmark.cpp
+//
+// Usage: FrustumCullingBenchmark [instances ...]      (default 1000 100000 1000000)
+//***************************************************************************************
+
+#include <Windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "xnacollision.h"
+#include "JobSystem.h"
+
+using namespace XNA;
+
+namespace
+{
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	float RandF(UINT& state)
+	{
+		state = state*1664525u + 1013904223u;
+		return (state >> 8) / 16777216.0f;
+	}
+
+	const UINT PoseCount = 8;
+
+	struct Scene
+	{
+		AxisAlignedBox LocalBox;
+		std::vector<XMFLOAT3> Positions;		// translation of each instance
+		std::vector<AxisAlignedBox> Boxes;		// world space bounds of each instance
+		std::vector<Sphere> Spheres;
+
+		Frustum ViewFrustum;					// in view space, as ComputeFrustumFromProjection makes it
+		XMFLOAT4 Rotation[PoseCount];			// camera poses: view space -> world
+		XMFLOAT3 Eye[PoseCount];
+		Frustum WorldFrustum[PoseCount];
+	};
+
+	void MakeScene(UINT count, Scene& scene)
+	{
+		// Roughly the bounds of skull.txt.
+		scene.LocalBox.Center = XMFLOAT3(0.0f, 0.8f, 0.6f);
+		scene.LocalBox.Extents = XMFLOAT3(3.2f, 3.9f, 3.6f);
+
+		float localRadius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&scene.LocalBox.Extents)));
+
+		// Ten units between instances, whatever their number.
+		float side = 10.0f*powf((float)count, 1.0f/3.0f);
+
+		UINT random = 97531;
+		scene.Positions.resize(count);
+		scene.Boxes.resize(count);
+		scene.Spheres.resize(count);
+		for(UINT i = 0; i < count; ++i)
+		{
+			XMFLOAT3& p = scene.Positions[i];
+			p = XMFLOAT3(side*(RandF(random) - 0.5f), side*(RandF(random) - 0.5f), side*(RandF(random) - 0.5f));
+
+			scene.Boxes[i] = scene.LocalBox;
+			scene.Boxes[i].Center.x += p.x;
+			scene.Boxes[i].Center.y += p.y;
+			scene.Boxes[i].Center.z += p.z;
+
+			scene.Spheres[i].Center = scene.Boxes[i].Center;
+			scene.Spheres[i].Radius = localRadius;
+		}
+
+		XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f*XM_PI, 800.0f/600.0f, 1.0f, 1000.0f);
+		ComputeFrustumFromProjection(&scene.ViewFrustum, &P);
+
+		// Cameras inside the cube looking every which way.
+		for(UINT k = 0; k < PoseCount; ++k)
+		{
+			XMVECTOR q = XMQuaternionRotationRollPitchYaw(RandF(random) - 0.5f, XM_2PI*RandF(random), 0.0f);
+			XMVECTOR eye = XMVectorSet(0.5f*side*(RandF(random) - 0.5f), 0.5f*side*(RandF(random) - 0.5f),
+				0.5f*side*(RandF(random) - 0.5f), 0.0f);
+
+			XMStoreFloat4(&scene.Rotation[k], q);
+			XMStoreFloat3(&scene.Eye[k], eye);
+			TransformFrustum(&scene.WorldFrustum[k], &scene.ViewFrustum, 1.0f, q, eye);
+		}
+	}
+
+	//
+	// The per instance test OnFrameMove ran, as it was in the instancing demo.
+	//
+
+	UINT OldCull(const Scene& scene, UINT pose, std::vector<UINT>& visible)
+	{
+		XMMATRIX invView = XMMatrixRotationQuaternion(XMLoadFloat4(&scene.Rotation[pose]));
+		invView.r[3] = XMVectorSetW(XMLoadFloat3(&scene.Eye[pose]), 1.0f);
+
+		UINT visibleCount = 0;
+		for(UINT i = 0; i < (UINT)scene.Positions.size(); ++i)
+		{
+			const XMFLOAT3& p = scene.Positions[i];
+			XMMATRIX W = XMMatrixTranslation(p.x, p.y, p.z);
+			XMVECTOR detW = XMMatrixDeterminant(W);
+			XMMATRIX invWorld = XMMatrixInverse(&detW, W);
+
+			// View space to the object's local space.
+			XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
+
+			XMVECTOR scale;
+			XMVECTOR rotQuat;
+			XMVECTOR translation;
+			XMMatrixDecompose(&scale, &rotQuat, &translation, toLocal);
+
+			Frustum localspaceFrustum;
+			TransformFrustum(&localspaceFrustum, &scene.ViewFrustum, XMVectorGetX(scale), rotQuat, translation);
+
+			if( IntersectAxisAlignedBoxFrustum(&scene.LocalBox, &localspaceFrustum) != 0 )
+				visible[visibleCount++] = i;
+		}
+		return visibleCount;
+	}
+
+	template<typename VolumeType, typename Test>
+	UINT SixPlanesCull(const std::vector<VolumeType>& volumes, const Frustum& frustum, std::vector<UINT>& visible, Test test)
+	{
+		XMVECTOR planes[6];
+		ComputePlanesFromFrustum(&frustum, &planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+
+		UINT visibleCount = 0;
+		for(UINT i = 0; i < (UINT)volumes.size(); ++i)
+		{
+			if( test(&volumes[i], planes[0], planes[1], planes[2], planes[3], planes[4], planes[5]) != 0 )
+				visible[visibleCount++] = i;
+		}
+		return visibleCount;
+	}
+
+	// Culls every pose `frames` times and returns the seconds per frame.  The
+	// visible lists of the last pass are kept.
+	template<typename F>
+	double TimeCull(UINT frames, std::vector<std::vector<UINT>>& visible, std::vector<UINT>& visibleCount, F cull)
+	{
+		double start = Now();
+		for(UINT f = 0; f < frames; ++f)
+		{
+			UINT pose = f % PoseCount;
+			visibleCount[pose] = cull(pose, visible[pose]);
+		}
+		return (Now() - start) / frames;
+	}
+
+	// The 6Planes routines and the batch routines compute the plane distances in
+	// a different order, so a volume that touches a plane to within rounding may
+	// be kept by one and not the other.  Those are not counted as mismatches.
+	bool NearPlane(const AxisAlignedBox& box, const Frustum& frustum)
+	{
+		XMVECTOR planes[6];
+		ComputePlanesFromFrustum(&frustum, &planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+		for(UINT k = 0; k < 6; ++k)
+		{
+			XMVECTOR c = XMVectorSetW(XMLoadFloat3(&box.Center), 1.0f);
+			float dist = XMVectorGetX(XMVector4Dot(c, planes[k]));
+			float radius = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&box.Extents), XMVectorAbs(planes[k])));
+			if( fabsf(dist - radius) <= 1e-5f*(fabsf(dist) + radius) )
+				return true;
+		}
+		return false;
+	}
+
+	bool NearPlane(const Sphere& sphere, const Frustum& frustum)
+	{
+		XMVECTOR planes[6];
+		ComputePlanesFromFrustum(&frustum, &planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+		for(UINT k = 0; k < 6; ++k)
+		{
+			XMVECTOR c = XMVectorSetW(XMLoadFloat3(&sphere.Center), 1.0f);
+			float dist = XMVectorGetX(XMVector4Dot(c, planes[k]));
+			if( fabsf(dist - sphere.Radius) <= 1e-5f*(fabsf(dist) + sphere.Radius) )
+				return true;
+		}
+		return false;
+	}
+
+	// Counts the volumes one visible list has and the other does not.
+	template<typename VolumeType>
+	UINT Compare(const std::vector<UINT>& a, UINT aCount, const std::vector<UINT>& b, UINT bCount,
+				 const std::vector<VolumeType>& volumes, const Frustum& frustum)
+	{
+		std::vector<char> inA(volumes.size(), 0), inB(volumes.size(), 0);
+		for(UINT k = 0; k < aCount; ++k)
+			inA[a[k]] = 1;
+		for(UINT k = 0; k < bCount; ++k)
+			inB[b[k]] = 1;
+
+		UINT mismatches = 0;
+		for(size_t i = 0; i < volumes.size(); ++i)
+		{
+			if( inA[i] != inB[i] && !NearPlane(volumes[i], frustum) )
+				++mismatches;
+		}
+
+		// The lists must also be in increasing order.
+		for(UINT k = 1; k < bCount; ++k)
+		{
+			if( b[k] <= b[k - 1] )
+				++mismatches;
+		}
+		return mismatches;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<UINT> counts;
+	for(int i = 1; i < argc; ++i)
+		counts.push_back((UINT)std::max(1, atoi(argv[i])));
+	if( counts.empty() )
+	{
+		counts.push_back(1000);
+		counts.push_back(100000);
+		counts.push_back(1000000);
+	}
+
+	JobSystem jobSystem;
+
+	printf("%u threads, %u camera poses\n\n", jobSystem.ThreadCount(), PoseCount);
+	printf("%-10s %9s %9s %9s %11s %11s %11s %11s %9s %8s\n", "instances", "visible", "extra", "old",
+		"6planes", "boxes", "boxes mt", "spheres", "speedup", "mismatch");
+	printf("%-10s %9s %9s %9s %11s %11s %11s %11s %9s %8s\n", "", "", "", "Minst/s",
+		"Minst/s", "Minst/s", "Minst/s", "Minst/s", "mt/old", "");
+
+	bool passed = true;
+
+	for(size_t c = 0; c < counts.size(); ++c)
+	{
+		UINT count = counts[c];
+
+		Scene scene;
+		MakeScene(count, scene);
+
+		// About a second of the old loop for every size.
+		UINT frames = std::max(PoseCount, 1000000u / count * PoseCount / 8);
+
+		std::vector<std::vector<UINT>> oldVisible(PoseCount, std::vector<UINT>(count));
+		std::vector<std::vector<UINT>> planesVisible = oldVisible, boxesVisible = oldVisible;
+		std::vector<std::vector<UINT>> boxesMtVisible = oldVisible, sphereVisible = oldVisible;
+		std::vector<std::vector<UINT>> spherePlanesVisible = oldVisible, sphereMtVisible = oldVisible;
+		std::vector<UINT> oldCount(PoseCount), planesCount(PoseCount), boxesCount(PoseCount);
+		std::vector<UINT> boxesMtCount(PoseCount), sphereCount(PoseCount);
+		std::vector<UINT> spherePlanesCount(PoseCount), sphereMtCount(PoseCount);
+
+		double oldTime = TimeCull(frames, oldVisible, oldCount, [&](UINT pose, std::vector<UINT>& visible)
+		{
+			return OldCull(scene, pose, visible);
+		});
+
+		double planesTime = TimeCull(frames, planesVisible, planesCount, [&](UINT pose, std::vector<UINT>& visible)
+		{
+			return SixPlanesCull(scene.Boxes, scene.WorldFrustum[pose], visible, IntersectAxisAlignedBox6Planes);
+		});
+
+		double boxesTime = TimeCull(frames, boxesVisible, boxesCount, [&](UINT pose, std::vector<UINT>& visible)
+		{
+			return CullAxisAlignedBoxes(&scene.WorldFrustum[pose], &scene.Boxes[0], count, &visible[0]);
+		});
+
+		double boxesMtTime = TimeCull(frames, boxesMtVisible, boxesMtCount, [&](UINT pose, std::vector<UINT>& visible)
+		{
+			return CullAxisAlignedBoxes(&scene.WorldFrustum[pose], &scene.Boxes[0], count, &visible[0], &jobSystem);
+		});
+
+		double sphereTime = TimeCull(frames, sphereVisible, sphereCount, [&](UINT pose, std::vector<UINT>& visible)
+		{
+			return CullSpheres(&scene.WorldFrustum[pose], &scene.Spheres[0], count, &visible[0]);
+		});
+
+		TimeCull(PoseCount, spherePlanesVisible, spherePlanesCount, [&](UINT pose, std::vector<UINT>& visible)
+		{
+			return SixPlanesCull(scene.Spheres, scene.WorldFrustum[pose], visible, IntersectSphere6Planes);
+		});
+
+		TimeCull(PoseCount, sphereMtVisible, sphereMtCount, [&](UINT pose, std::vector<UINT>& visible)
+		{
+			return CullSpheres(&scene.WorldFrustum[pose], &scene.Spheres[0], count, &visible[0], &jobSystem);
+		});
+
+		//
+		// Compare.
+		//
+
+		UINT mismatches = 0;
+		UINT visibleTotal = 0;
+		UINT extraTotal = 0;
+		for(UINT pose = 0; pose < PoseCount; ++pose)
+		{
+			const Frustum& frustum = scene.WorldFrustum[pose];
+
+			mismatches += Compare(planesVisible[pose], planesCount[pose], boxesVisible[pose], boxesCount[pose], scene.Boxes, frustum);
+			mismatches += Compare(planesVisible[pose], planesCount[pose], boxesMtVisible[pose], boxesMtCount[pose], scene.Boxes, frustum);
+			mismatches += Compare(spherePlanesVisible[pose], spherePlanesCount[pose], sphereVisible[pose], sphereCount[pose], scene.Spheres, frustum);
+			mismatches += Compare(spherePlanesVisible[pose], spherePlanesCount[pose], sphereMtVisible[pose], sphereMtCount[pose], scene.Spheres, frustum);
+
+			// Everything the old loop keeps must be kept.
+			std::vector<char> kept(count, 0);
+			for(UINT k = 0; k < boxesCount[pose]; ++k)
+				kept[boxesVisible[pose][k]] = 1;
+			for(UINT k = 0; k < oldCount[pose]; ++k)
+			{
+				if( !kept[oldVisible[pose][k]] && !NearPlane(scene.Boxes[oldVisible[pose][k]], frustum) )
+					++mismatches;
+			}
+
+			visibleTotal += oldCount[pose];
+			extraTotal += boxesCount[pose] > oldCount[pose] ? boxesCount[pose] - oldCount[pose] : 0;
+		}
+
+		printf("%-10u %9u %9u %9.2f %11.2f %11.2f %11.2f %11.2f %9.1f %8u\n", count,
+			visibleTotal / PoseCount, extraTotal / PoseCount, count/oldTime*1e-6, count/planesTime*1e-6,
+			count/boxesTime*1e-6, count/boxesMtTime*1e-6, count/sphereTime*1e-6, oldTime/boxesMtTime, mismatches);
+
+		if( mismatches > 0 )
+			passed = false;
+	}
+
+	printf("\n%s\n", passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
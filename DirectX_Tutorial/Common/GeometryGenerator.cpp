@@ -4,14 +4,324 @@
 
 #include "GeometryGenerator.h"
 #include "MathHelper.h"
+#include "JobSystem.h"
+
+namespace
+{
+	// Sizes meshData to hold a shape of the given size.  Vectors that are
+	// already large enough keep their memory.
+	void Resize(GeometryGenerator::MeshData& meshData, const GeometryGenerator::MeshSize& size)
+	{
+		meshData.Vertices.resize(size.VertexCount);
+		meshData.Indices.resize(size.IndexCount);
+	}
+
+	// The vertices of an icosahedron whose faces are each cut into n*n
+	// triangles, numbered without a lookup: the 12 corners first, then the n-1
+	// vertices inside each of the 30 edges, then the (n-1)(n-2)/2 inside each of
+	// the 20 faces.  Both faces of an edge compute the same number for a vertex
+	// on it, so each vertex is made once.
+	//
+	// A point of face f is given by grid coordinates (a, b), a + b <= n, and
+	// lies at c0 + a/n*(c1 - c0) + b/n*(c2 - c0) for the face corners c0, c1, c2.
+	struct GeosphereGrid
+	{
+		GeosphereGrid(const DWORD* faces, UINT n)
+			: Faces(faces), N(n), EdgeCount(0)
+		{
+			for(UINT f = 0; f < 20; ++f)
+			{
+				for(UINT e = 0; e < 3; ++e)
+				{
+					UINT from = faces[f*3 + e];
+					UINT to = faces[f*3 + (e+1)%3];
+					FaceEdge[f][e] = FindEdge(MathHelper::Min(from, to), MathHelper::Max(from, to));
+				}
+			}
+		}
+
+		// Adds the edge the first time a face names it.
+		UINT FindEdge(UINT lo, UINT hi)
+		{
+			for(UINT i = 0; i < EdgeCount; ++i)
+			{
+				if( Edges[i][0] == lo && Edges[i][1] == hi )
+					return i;
+			}
+
+			Edges[EdgeCount][0] = lo;
+			Edges[EdgeCount][1] = hi;
+			return EdgeCount++;
+		}
+
+		UINT VertexCount()const
+		{
+			return 12 + 30*(N-1) + 20*InteriorCount();
+		}
+
+		UINT InteriorCount()const
+		{
+			return (N-1)*(N-2)/2;
+		}
+
+		// The vertex t steps from corner 'from' along edge e of face f.
+		UINT EdgeVertex(UINT f, UINT e, UINT t)const
+		{
+			UINT edge = FaceEdge[f][e];
+			UINT from = Faces[f*3 + e];
+			UINT step = from == Edges[edge][0] ? t : N-t;
+			return 12 + edge*(N-1) + step-1;
+		}
+
+		UINT Index(UINT f, UINT a, UINT b)const
+		{
+			if( a == 0 && b == 0 ) return Faces[f*3 + 0];
+			if( a == N )           return Faces[f*3 + 1];
+			if( b == N )           return Faces[f*3 + 2];
+
+			if( b == 0 )     return EdgeVertex(f, 0, a);   // c0 to c1
+			if( a + b == N ) return EdgeVertex(f, 1, b);   // c1 to c2
+			if( a == 0 )     return EdgeVertex(f, 2, N-b); // c2 to c0
+
+			// Interior points row by row, b = 1..n-2, each row a = 1..n-1-b.
+			UINT row = (b-1)*(N-1) - (b-1)*b/2;
+			return 12 + 30*(N-1) + f*InteriorCount() + row + a-1;
+		}
+
+		const DWORD* Faces;
+		UINT N;
+		UINT EdgeCount;
+		UINT Edges[30][2];
+		UINT FaceEdge[20][3];
+	};
+
+	struct GridPoint
+	{
+		UINT A;
+		UINT B;
+	};
+
+	GridPoint Midpoint(const GridPoint& p, const GridPoint& q)
+	{
+		GridPoint m = { (p.A + q.A)/2, (p.B + q.B)/2 };
+		return m;
+	}
+
+	// Writes the triangles of (p0, p1, p2) on face f in the order that
+	// splitting it at its edge midpoints level times produces them.  Each
+	// group of four shares six vertices and neighbouring groups share edges,
+	// so the index stream stays local and suits the post-transform cache.
+	UINT* EmitGeosphereTriangles(const GeosphereGrid& grid, UINT f, const GridPoint& p0, const GridPoint& p1,
+								 const GridPoint& p2, UINT level, UINT* indices)
+	{
+		if( level == 0 )
+		{
+			indices[0] = grid.Index(f, p0.A, p0.B);
+			indices[1] = grid.Index(f, p1.A, p1.B);
+			indices[2] = grid.Index(f, p2.A, p2.B);
+			return indices + 3;
+		}
+
+		//       v1
+		//       *
+		//      / \
+		//     /   \
+		//  m0*-----*m1
+		//   / \   / \
+		//  /   \ /   \
+		// *-----*-----*
+		// v0    m2     v2
+
+		GridPoint m0 = Midpoint(p0, p1);
+		GridPoint m1 = Midpoint(p1, p2);
+		GridPoint m2 = Midpoint(p0, p2);
+
+		indices = EmitGeosphereTriangles(grid, f, p0, m0, m2, level-1, indices);
+		indices = EmitGeosphereTriangles(grid, f, m0, m1, m2, level-1, indices);
+		indices = EmitGeosphereTriangles(grid, f, m2, m1, p2, level-1, indices);
+		return EmitGeosphereTriangles(grid, f, m0, p1, m1, level-1, indices);
+	}
+
+	// Enough vertices per job to outweigh queueing it.
+	const UINT GridVerticesPerJob = 16384;
+
+	// The spacing of an m x n grid, as CreateGrid lays it out.
+	struct GridLayout
+	{
+		GridLayout(float width, float depth, UINT m, UINT n)
+			: M(m), N(n), HalfWidth(0.5f*width), HalfDepth(0.5f*depth),
+			  Dx(width/(n-1)), Dz(depth/(m-1)), Du(1.0f/(n-1)), Dv(1.0f/(m-1)){}
+
+		UINT M;
+		UINT N;
+		float HalfWidth;
+		float HalfDepth;
+		float Dx;
+		float Dz;
+		float Du;
+		float Dv;
+	};
+
+	// Writes rows [firstRow, lastRow) of a height field grid, and the two
+	// triangles of each quad below them.
+	void BuildHeightFieldRows(const GridLayout& grid, const GeometryGenerator::HeightField& heightField,
+							  UINT firstRow, UINT lastRow, GeometryGenerator::Vertex* vertices, UINT* indices)
+	{
+		const UINT n = grid.N;
+
+		XMVECTOR lanes     = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+		XMVECTOR left      = XMVectorReplicate(-grid.HalfWidth);
+		XMVECTOR dx        = XMVectorReplicate(grid.Dx);
+		XMVECTOR du        = XMVectorReplicate(grid.Du);
+		XMVECTOR one       = XMVectorReplicate(1.0f);
+		XMVECTOR zero      = XMVectorZero();
+
+		for(UINT i = firstRow; i < lastRow; ++i)
+		{
+			float z = grid.HalfDepth - i*grid.Dz;
+			XMVECTOR zs = XMVectorReplicate(z);
+			XMVECTOR vs = XMVectorReplicate(i*grid.Dv);
+
+			GeometryGenerator::Vertex* row = vertices + i*n;
+
+			// The last group may run past the row; only its first lanes are kept.
+			for(UINT j = 0; j < n; j += 4)
+			{
+				XMVECTOR column = XMVectorReplicate((float)j) + lanes;
+				XMVECTOR x = left + column*dx;
+
+				XMVECTOR height, slopeX, slopeZ;
+				heightField.Evaluate(x, zs, height, slopeX, slopeZ);
+
+				// n = (-df/dx, 1, -df/dz) and tangent = (1, df/dx, 0), normalized.
+				XMVECTOR nLength = XMVectorSqrt(slopeX*slopeX + one + slopeZ*slopeZ);
+				XMVECTOR tLength = XMVectorSqrt(one + slopeX*slopeX);
+
+				// Transposing turns the component-per-register layout into one
+				// vector per vertex.
+				XMMATRIX positions;
+				positions.r[0] = x;
+				positions.r[1] = height;
+				positions.r[2] = zs;
+				positions.r[3] = zero;
+				positions = XMMatrixTranspose(positions);
+
+				XMMATRIX normals;
+				normals.r[0] = -slopeX / nLength;
+				normals.r[1] = one / nLength;
+				normals.r[2] = -slopeZ / nLength;
+				normals.r[3] = zero;
+				normals = XMMatrixTranspose(normals);
+
+				XMMATRIX tangents;
+				tangents.r[0] = one / tLength;
+				tangents.r[1] = slopeX / tLength;
+				tangents.r[2] = zero;
+				tangents.r[3] = zero;
+				tangents = XMMatrixTranspose(tangents);
+
+				XMMATRIX texCoords;
+				texCoords.r[0] = column*du;
+				texCoords.r[1] = vs;
+				texCoords.r[2] = zero;
+				texCoords.r[3] = zero;
+				texCoords = XMMatrixTranspose(texCoords);
+
+				UINT count = MathHelper::Min(4u, n-j);
+				for(UINT k = 0; k < count; ++k)
+				{
+					GeometryGenerator::Vertex& v = row[j+k];
+					XMStoreFloat3(&v.Position, positions.r[k]);
+					XMStoreFloat3(&v.Normal, normals.r[k]);
+					XMStoreFloat3(&v.TangentU, tangents.r[k]);
+					XMStoreFloat2(&v.TexC, texCoords.r[k]);
+				}
+			}
+
+			if( i + 1 == grid.M )
+				continue;
+
+			UINT* quad = indices + i*(n-1)*6;
+			for(UINT j = 0; j < n-1; ++j)
+			{
+				quad[0] = i*n+j;
+				quad[1] = i*n+j+1;
+				quad[2] = (i+1)*n+j;
+
+				quad[3] = (i+1)*n+j;
+				quad[4] = i*n+j+1;
+				quad[5] = (i+1)*n+j+1;
+
+				quad += 6; // next quad
+			}
+		}
+	}
+
+	XMFLOAT3 Lerp(const XMFLOAT3& p, const XMFLOAT3& q, float t)
+	{
+		return XMFLOAT3(
+			p.x + t*(q.x - p.x),
+			p.y + t*(q.y - p.y),
+			p.z + t*(q.z - p.z));
+	}
+}
+
+// MathHelper::Min and std::min take it by reference, so it needs a definition.
+const UINT GeometryGenerator::MaxGeosphereSubdivisions;
+
+GeometryGenerator::MeshSize GeometryGenerator::GetBoxSize()const
+{
+	return MeshSize(24, 36);
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GetSphereSize(UINT sliceCount, UINT stackCount)const
+{
+	// Two poles and stackCount-1 rings; a triangle fan at each pole and two
+	// triangles per slice for the stacks in between.
+	UINT ringVertexCount = sliceCount+1;
+	return MeshSize(2 + (stackCount-1)*ringVertexCount, 6*sliceCount*(stackCount-1));
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GetGeosphereSize(UINT numSubdivisions)const
+{
+	numSubdivisions = MathHelper::Min(numSubdivisions, MaxGeosphereSubdivisions);
+
+	// Each subdivision turns a triangle into four.  The vertices are shared,
+	// so by Euler's formula there are half as many plus two.
+	UINT triangleCount = 20u << (2*numSubdivisions);
+	return MeshSize(triangleCount/2 + 2, 3*triangleCount);
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GetCylinderSize(UINT sliceCount, UINT stackCount)const
+{
+	// stackCount+1 rings, and a ring and center vertex for each cap.
+	UINT ringVertexCount = sliceCount+1;
+	return MeshSize((stackCount+1)*ringVertexCount + 2*(ringVertexCount+1), 6*sliceCount*stackCount + 6*sliceCount);
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GetGridSize(UINT m, UINT n)const
+{
+	return MeshSize(m*n, (m-1)*(n-1)*6);
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GetFullscreenQuadSize()const
+{
+	return MeshSize(4, 6);
+}
 
 void GeometryGenerator::CreateBox(float width, float height, float depth, MeshData& meshData)
+{
+	Resize(meshData, GetBoxSize());
+	CreateBox(width, height, depth, &meshData.Vertices[0], &meshData.Indices[0]);
+}
+
+void GeometryGenerator::CreateBox(float width, float height, float depth, Vertex* vertices, UINT* indices)
 {
 	//
 	// Create the vertices.
 	//
 
-	Vertex v[24];
+	Vertex* v = vertices;
 
 	float w2 = 0.5f*width;
 	float h2 = 0.5f*height;
@@ -52,14 +362,12 @@ void GeometryGenerator::CreateBox(float width, float height, float depth, MeshDa
 	v[21] = Vertex(+w2, +h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
 	v[22] = Vertex(+w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
 	v[23] = Vertex(+w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
-
-	meshData.Vertices.assign(&v[0], &v[24]);
  
 	//
 	// Create the indices.
 	//
 
-	UINT i[36];
+	UINT* i = indices;
 
 	// Fill in the front face index data
 	i[0] = 0; i[1] = 1; i[2] = 2;
@@ -84,14 +392,18 @@ void GeometryGenerator::CreateBox(float width, float height, float depth, MeshDa
 	// Fill in the right face index data
 	i[30] = 20; i[31] = 21; i[32] = 22;
 	i[33] = 20; i[34] = 22; i[35] = 23;
-
-	meshData.Indices.assign(&i[0], &i[36]);
 }
 
 void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCount, MeshData& meshData)
 {
-	meshData.Vertices.clear();
-	meshData.Indices.clear();
+	Resize(meshData, GetSphereSize(sliceCount, stackCount));
+	CreateSphere(radius, sliceCount, stackCount, &meshData.Vertices[0], &meshData.Indices[0]);
+}
+
+void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCount, Vertex* vertices, UINT* indices)
+{
+	UINT vertexCount = 0;
+	UINT k = 0;
 
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
@@ -103,7 +415,7 @@ void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCo
 	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
 	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 
-	meshData.Vertices.push_back( topVertex );
+	vertices[vertexCount++] = topVertex;
 
 	float phiStep   = XM_PI/stackCount;
 	float thetaStep = 2.0f*XM_PI/sliceCount;
@@ -139,11 +451,11 @@ void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCo
 			v.TexC.x = theta / XM_2PI;
 			v.TexC.y = phi / XM_PI;
 
-			meshData.Vertices.push_back( v );
+			vertices[vertexCount++] = v;
 		}
 	}
 
-	meshData.Vertices.push_back( bottomVertex );
+	vertices[vertexCount++] = bottomVertex;
 
 	//
 	// Compute indices for top stack.  The top stack was written first to the vertex buffer
@@ -152,9 +464,9 @@ void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCo
 
 	for(UINT i = 1; i <= sliceCount; ++i)
 	{
-		meshData.Indices.push_back(0);
-		meshData.Indices.push_back(i+1);
-		meshData.Indices.push_back(i);
+		indices[k++] = 0;
+		indices[k++] = i+1;
+		indices[k++] = i;
 	}
 	
 	//
@@ -169,13 +481,13 @@ void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCo
 	{
 		for(UINT j = 0; j < sliceCount; ++j)
 		{
-			meshData.Indices.push_back(baseIndex + i*ringVertexCount + j);
-			meshData.Indices.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices.push_back(baseIndex + (i+1)*ringVertexCount + j);
+			indices[k++] = baseIndex + i*ringVertexCount + j;
+			indices[k++] = baseIndex + i*ringVertexCount + j+1;
+			indices[k++] = baseIndex + (i+1)*ringVertexCount + j;
 
-			meshData.Indices.push_back(baseIndex + (i+1)*ringVertexCount + j);
-			meshData.Indices.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices.push_back(baseIndex + (i+1)*ringVertexCount + j+1);
+			indices[k++] = baseIndex + (i+1)*ringVertexCount + j;
+			indices[k++] = baseIndex + i*ringVertexCount + j+1;
+			indices[k++] = baseIndex + (i+1)*ringVertexCount + j+1;
 		}
 	}
 
@@ -185,102 +497,29 @@ void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCo
 	//
 
 	// South pole vertex was added last.
-	UINT southPoleIndex = (UINT)meshData.Vertices.size()-1;
+	UINT southPoleIndex = vertexCount-1;
 
 	// Offset the indices to the index of the first vertex in the last ring.
 	baseIndex = southPoleIndex - ringVertexCount;
 	
 	for(UINT i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices.push_back(southPoleIndex);
-		meshData.Indices.push_back(baseIndex+i);
-		meshData.Indices.push_back(baseIndex+i+1);
+		indices[k++] = southPoleIndex;
+		indices[k++] = baseIndex+i;
+		indices[k++] = baseIndex+i+1;
 	}
 }
  
-void GeometryGenerator::Subdivide(MeshData& meshData)
+void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
-
-	meshData.Vertices.resize(0);
-	meshData.Indices.resize(0);
-
-	//       v1
-	//       *
-	//      / \
-	//     /   \
-	//  m0*-----*m1
-	//   / \   / \
-	//  /   \ /   \
-	// *-----*-----*
-	// v0    m2     v2
-
-	UINT numTris = inputCopy.Indices.size()/3;
-	for(UINT i = 0; i < numTris; ++i)
-	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices[i*3+2] ];
-
-		//
-		// Generate the midpoints.
-		//
-
-		Vertex m0, m1, m2;
-
-		// For subdivision, we just care about the position component.  We derive the other
-		// vertex components in CreateGeosphere.
-
-		m0.Position = XMFLOAT3(
-			0.5f*(v0.Position.x + v1.Position.x),
-			0.5f*(v0.Position.y + v1.Position.y),
-			0.5f*(v0.Position.z + v1.Position.z));
-
-		m1.Position = XMFLOAT3(
-			0.5f*(v1.Position.x + v2.Position.x),
-			0.5f*(v1.Position.y + v2.Position.y),
-			0.5f*(v1.Position.z + v2.Position.z));
-
-		m2.Position = XMFLOAT3(
-			0.5f*(v0.Position.x + v2.Position.x),
-			0.5f*(v0.Position.y + v2.Position.y),
-			0.5f*(v0.Position.z + v2.Position.z));
-
-		//
-		// Add new geometry.
-		//
-
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices.push_back(i*6+0);
-		meshData.Indices.push_back(i*6+3);
-		meshData.Indices.push_back(i*6+5);
-
-		meshData.Indices.push_back(i*6+3);
-		meshData.Indices.push_back(i*6+4);
-		meshData.Indices.push_back(i*6+5);
-
-		meshData.Indices.push_back(i*6+5);
-		meshData.Indices.push_back(i*6+4);
-		meshData.Indices.push_back(i*6+2);
-
-		meshData.Indices.push_back(i*6+3);
-		meshData.Indices.push_back(i*6+1);
-		meshData.Indices.push_back(i*6+4);
-	}
+	Resize(meshData, GetGeosphereSize(numSubdivisions));
+	CreateGeosphere(radius, numSubdivisions, &meshData.Vertices[0], &meshData.Indices[0]);
 }
 
-void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData)
+void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, Vertex* vertices, UINT* indices)
 {
 	// Put a cap on the number of subdivisions.
-	numSubdivisions = MathHelper::Min(numSubdivisions, 5u);
+	numSubdivisions = MathHelper::Min(numSubdivisions, MaxGeosphereSubdivisions);
 
 	// Approximate a sphere by tessellating an icosahedron.
 
@@ -305,54 +544,90 @@ void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, Mesh
 		10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7 
 	};
 
-	meshData.Vertices.resize(12);
-	meshData.Indices.resize(60);
+	// Split every face into an gridSize*gridSize triangle grid, gridSize = 2^numSubdivisions, which
+	// is where repeatedly splitting it at its edge midpoints puts the vertices.
+	UINT gridSize = 1u << numSubdivisions;
+	GeosphereGrid grid(k, gridSize);
 
 	for(UINT i = 0; i < 12; ++i)
-		meshData.Vertices[i].Position = pos[i];
+		vertices[i].Position = pos[i];
+
+	UINT vertexCount = 12;
+	for(UINT e = 0; e < 30; ++e)
+	{
+		const XMFLOAT3& p0 = pos[grid.Edges[e][0]];
+		const XMFLOAT3& p1 = pos[grid.Edges[e][1]];
 
-	for(UINT i = 0; i < 60; ++i)
-		meshData.Indices[i] = k[i];
+		for(UINT t = 1; t < gridSize; ++t)
+			vertices[vertexCount++].Position = Lerp(p0, p1, (float)t/gridSize);
+	}
 
-	for(UINT i = 0; i < numSubdivisions; ++i)
-		Subdivide(meshData);
+	for(UINT f = 0; f < 20; ++f)
+	{
+		const XMFLOAT3& c0 = pos[k[f*3+0]];
+		const XMFLOAT3& c1 = pos[k[f*3+1]];
+		const XMFLOAT3& c2 = pos[k[f*3+2]];
+
+		for(UINT b = 1; b + 1 < gridSize; ++b)
+		{
+			XMFLOAT3 rowStart = Lerp(c0, c2, (float)b/gridSize);
+			XMFLOAT3 rowEnd = Lerp(c1, c2, (float)b/gridSize);
+
+			for(UINT a = 1; a + b < gridSize; ++a)
+				vertices[vertexCount++].Position = Lerp(rowStart, rowEnd, (float)a/(gridSize-b));
+		}
+	}
+
+	for(UINT f = 0; f < 20; ++f)
+	{
+		GridPoint p0 = { 0, 0 };
+		GridPoint p1 = { gridSize, 0 };
+		GridPoint p2 = { 0, gridSize };
+		indices = EmitGeosphereTriangles(grid, f, p0, p1, p2, numSubdivisions, indices);
+	}
 
 	// Project vertices onto sphere and scale.
-	for(UINT i = 0; i < meshData.Vertices.size(); ++i)
+	for(UINT i = 0; i < vertexCount; ++i)
 	{
 		// Project onto unit sphere.
-		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&meshData.Vertices[i].Position));
+		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&vertices[i].Position));
 
 		// Project onto sphere.
 		XMVECTOR p = radius*n;
 
-		XMStoreFloat3(&meshData.Vertices[i].Position, p);
-		XMStoreFloat3(&meshData.Vertices[i].Normal, n);
+		XMStoreFloat3(&vertices[i].Position, p);
+		XMStoreFloat3(&vertices[i].Normal, n);
 
 		// Derive texture coordinates from spherical coordinates.
 		float theta = MathHelper::AngleFromXY(
-			meshData.Vertices[i].Position.x, 
-			meshData.Vertices[i].Position.z);
+			vertices[i].Position.x, 
+			vertices[i].Position.z);
 
-		float phi = acosf(meshData.Vertices[i].Position.y / radius);
+		float phi = acosf(vertices[i].Position.y / radius);
 
-		meshData.Vertices[i].TexC.x = theta/XM_2PI;
-		meshData.Vertices[i].TexC.y = phi/XM_PI;
+		vertices[i].TexC.x = theta/XM_2PI;
+		vertices[i].TexC.y = phi/XM_PI;
 
 		// Partial derivative of P with respect to theta
-		meshData.Vertices[i].TangentU.x = -radius*sinf(phi)*sinf(theta);
-		meshData.Vertices[i].TangentU.y = 0.0f;
-		meshData.Vertices[i].TangentU.z = +radius*sinf(phi)*cosf(theta);
+		vertices[i].TangentU.x = -radius*sinf(phi)*sinf(theta);
+		vertices[i].TangentU.y = 0.0f;
+		vertices[i].TangentU.z = +radius*sinf(phi)*cosf(theta);
 
-		XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
-		XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
+		XMVECTOR T = XMLoadFloat3(&vertices[i].TangentU);
+		XMStoreFloat3(&vertices[i].TangentU, XMVector3Normalize(T));
 	}
 }
 
 void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData)
 {
-	meshData.Vertices.clear();
-	meshData.Indices.clear();
+	Resize(meshData, GetCylinderSize(sliceCount, stackCount));
+	CreateCylinder(bottomRadius, topRadius, height, sliceCount, stackCount, &meshData.Vertices[0], &meshData.Indices[0]);
+}
+
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, Vertex* vertices, UINT* indices)
+{
+	UINT vertexCount = 0;
+	UINT k = 0;
 
 	//
 	// Build Stacks.
@@ -415,7 +690,7 @@ void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, floa
 			XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
 			XMStoreFloat3(&vertex.Normal, N);
 
-			meshData.Vertices.push_back(vertex);
+			vertices[vertexCount++] = vertex;
 		}
 	}
 
@@ -428,25 +703,30 @@ void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, floa
 	{
 		for(UINT j = 0; j < sliceCount; ++j)
 		{
-			meshData.Indices.push_back(i*ringVertexCount + j);
-			meshData.Indices.push_back((i+1)*ringVertexCount + j);
-			meshData.Indices.push_back((i+1)*ringVertexCount + j+1);
+			indices[k++] = i*ringVertexCount + j;
+			indices[k++] = (i+1)*ringVertexCount + j;
+			indices[k++] = (i+1)*ringVertexCount + j+1;
 
-			meshData.Indices.push_back(i*ringVertexCount + j);
-			meshData.Indices.push_back((i+1)*ringVertexCount + j+1);
-			meshData.Indices.push_back(i*ringVertexCount + j+1);
+			indices[k++] = i*ringVertexCount + j;
+			indices[k++] = (i+1)*ringVertexCount + j+1;
+			indices[k++] = i*ringVertexCount + j+1;
 		}
 	}
 
-	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
+	// Each cap is a ring and a center vertex, fanned with sliceCount triangles.
+	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount,
+		vertices + vertexCount, indices + k, vertexCount);
+
+	vertexCount += ringVertexCount+1;
+	k += 3*sliceCount;
+
+	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount,
+		vertices + vertexCount, indices + k, vertexCount);
 }
 
 void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height, 
-											UINT sliceCount, UINT stackCount, MeshData& meshData)
+											UINT sliceCount, UINT stackCount, Vertex* vertices, UINT* indices, UINT baseIndex)
 {
-	UINT baseIndex = (UINT)meshData.Vertices.size();
-
 	float y = 0.5f*height;
 	float dTheta = 2.0f*XM_PI/sliceCount;
 
@@ -461,31 +741,30 @@ void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius,
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		vertices[i] = Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v);
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
+	vertices[sliceCount+1] = Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f);
 
 	// Index of center vertex.
-	UINT centerIndex = (UINT)meshData.Vertices.size()-1;
+	UINT centerIndex = baseIndex + sliceCount+1;
 
 	for(UINT i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices.push_back(centerIndex);
-		meshData.Indices.push_back(baseIndex + i+1);
-		meshData.Indices.push_back(baseIndex + i);
+		indices[i*3+0] = centerIndex;
+		indices[i*3+1] = baseIndex + i+1;
+		indices[i*3+2] = baseIndex + i;
 	}
 }
 
 void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, 
-											   UINT sliceCount, UINT stackCount, MeshData& meshData)
+											   UINT sliceCount, UINT stackCount, Vertex* vertices, UINT* indices, UINT baseIndex)
 {
 	// 
 	// Build bottom cap.
 	//
 
-	UINT baseIndex = (UINT)meshData.Vertices.size();
 	float y = -0.5f*height;
 
 	// vertices of ring
@@ -500,28 +779,31 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		vertices[i] = Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v);
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
+	vertices[sliceCount+1] = Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f);
 
 	// Cache the index of center vertex.
-	UINT centerIndex = (UINT)meshData.Vertices.size()-1;
+	UINT centerIndex = baseIndex + sliceCount+1;
 
 	for(UINT i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices.push_back(centerIndex);
-		meshData.Indices.push_back(baseIndex + i);
-		meshData.Indices.push_back(baseIndex + i+1);
+		indices[i*3+0] = centerIndex;
+		indices[i*3+1] = baseIndex + i;
+		indices[i*3+2] = baseIndex + i+1;
 	}
 }
 
 void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, MeshData& meshData)
 {
-	UINT vertexCount = m*n;
-	UINT faceCount   = (m-1)*(n-1)*2;
+	Resize(meshData, GetGridSize(m, n));
+	CreateGrid(width, depth, m, n, &meshData.Vertices[0], &meshData.Indices[0]);
+}
 
+void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, Vertex* vertices, UINT* indices)
+{
 	//
 	// Create the vertices.
 	//
@@ -535,7 +817,6 @@ void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, Mes
 	float du = 1.0f / (n-1);
 	float dv = 1.0f / (m-1);
 
-	meshData.Vertices.resize(vertexCount);
 	for(UINT i = 0; i < m; ++i)
 	{
 		float z = halfDepth - i*dz;
@@ -543,13 +824,13 @@ void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, Mes
 		{
 			float x = -halfWidth + j*dx;
 
-			meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+			vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
+			vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
+			vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
 
 			// Stretch texture over grid.
-			meshData.Vertices[i*n+j].TexC.x = j*du;
-			meshData.Vertices[i*n+j].TexC.y = i*dv;
+			vertices[i*n+j].TexC.x = j*du;
+			vertices[i*n+j].TexC.y = i*dv;
 		}
 	}
  
@@ -557,62 +838,90 @@ void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, Mes
 	// Create the indices.
 	//
 
-	meshData.Indices.resize(faceCount*3); // 3 indices per face
-
 	// Iterate over each quad and compute indices.
 	UINT k = 0;
 	for(UINT i = 0; i < m-1; ++i)
 	{
 		for(UINT j = 0; j < n-1; ++j)
 		{
-			meshData.Indices[k]   = i*n+j;
-			meshData.Indices[k+1] = i*n+j+1;
-			meshData.Indices[k+2] = (i+1)*n+j;
+			indices[k]   = i*n+j;
+			indices[k+1] = i*n+j+1;
+			indices[k+2] = (i+1)*n+j;
 
-			meshData.Indices[k+3] = (i+1)*n+j;
-			meshData.Indices[k+4] = i*n+j+1;
-			meshData.Indices[k+5] = (i+1)*n+j+1;
+			indices[k+3] = (i+1)*n+j;
+			indices[k+4] = i*n+j+1;
+			indices[k+5] = (i+1)*n+j+1;
 
 			k += 6; // next quad
 		}
 	}
 }
 
+void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, const HeightField& heightField,
+								   MeshData& meshData, JobSystem* jobSystem)
+{
+	Resize(meshData, GetGridSize(m, n));
+	CreateGrid(width, depth, m, n, heightField, &meshData.Vertices[0], &meshData.Indices[0], jobSystem);
+}
+
+void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, const HeightField& heightField,
+								   Vertex* vertices, UINT* indices, JobSystem* jobSystem)
+{
+	GridLayout grid(width, depth, m, n);
+
+	if( jobSystem == 0 )
+	{
+		BuildHeightFieldRows(grid, heightField, 0, m, vertices, indices);
+		return;
+	}
+
+	// Each block writes its own rows and the quads below them, so the blocks
+	// never touch the same memory.
+	UINT rowsPerJob = MathHelper::Max(1u, GridVerticesPerJob / n);
+	jobSystem->ParallelFor(0, m, rowsPerJob, [&](UINT first, UINT last)
+	{
+		BuildHeightFieldRows(grid, heightField, first, last, vertices, indices);
+	});
+}
+
 void GeometryGenerator::CreateFullscreenQuad(MeshData& meshData)
 {
-	meshData.Vertices.resize(4);
-	meshData.Indices.resize(6);
+	Resize(meshData, GetFullscreenQuadSize());
+	CreateFullscreenQuad(&meshData.Vertices[0], &meshData.Indices[0]);
+}
 
+void GeometryGenerator::CreateFullscreenQuad(Vertex* vertices, UINT* indices)
+{
 	// Position coordinates specified in NDC space.
-	meshData.Vertices[0] = Vertex(
+	vertices[0] = Vertex(
 		-1.0f, -1.0f, 0.0f, 
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
 		0.0f, 1.0f);
 
-	meshData.Vertices[1] = Vertex(
+	vertices[1] = Vertex(
 		-1.0f, +1.0f, 0.0f, 
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
 		0.0f, 0.0f);
 
-	meshData.Vertices[2] = Vertex(
+	vertices[2] = Vertex(
 		+1.0f, +1.0f, 0.0f, 
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
 		1.0f, 0.0f);
 
-	meshData.Vertices[3] = Vertex(
+	vertices[3] = Vertex(
 		+1.0f, -1.0f, 0.0f, 
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
 		1.0f, 1.0f);
 
-	meshData.Indices[0] = 0;
-	meshData.Indices[1] = 1;
-	meshData.Indices[2] = 2;
+	indices[0] = 0;
+	indices[1] = 1;
+	indices[2] = 2;
 
-	meshData.Indices[3] = 0;
-	meshData.Indices[4] = 2;
-	meshData.Indices[5] = 3;
+	indices[3] = 0;
+	indices[4] = 2;
+	indices[5] = 3;
 }
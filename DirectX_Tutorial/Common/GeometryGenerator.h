@@ -22,6 +22,8 @@
 
 using namespace DirectX;
 
+class JobSystem;
+
 class GeometryGenerator
 {
 public:
@@ -50,22 +52,72 @@ public:
 		std::vector<UINT> Indices;
 	};
 
+	///<summary>
+	/// The number of vertices and indices a shape is made of, so that the caller
+	/// can size its buffers before generating it.
+	///</summary>
+	struct MeshSize
+	{
+		MeshSize() : VertexCount(0), IndexCount(0){}
+		MeshSize(UINT vertexCount, UINT indexCount)
+			: VertexCount(vertexCount), IndexCount(indexCount){}
+
+		UINT VertexCount;
+		UINT IndexCount;
+	};
+
+	///<summary>
+	/// A height field y = f(x, z), evaluated four points at a time so that it
+	/// can use the vector sine and cosine of DirectXMath.  Evaluate returns the
+	/// heights and the slopes df/dx and df/dz at the points whose coordinates
+	/// are in the lanes of x and z.  It may be called from several threads at
+	/// once.
+	///</summary>
+	class HeightField
+	{
+	public:
+		virtual ~HeightField(){}
+		virtual void Evaluate(FXMVECTOR x, FXMVECTOR z, XMVECTOR& height, XMVECTOR& slopeX, XMVECTOR& slopeZ)const = 0;
+	};
+
+	// Deeper geospheres are clamped to this many subdivisions.
+	static const UINT MaxGeosphereSubdivisions = 8;
+
+	MeshSize GetBoxSize()const;
+	MeshSize GetSphereSize(UINT sliceCount, UINT stackCount)const;
+	MeshSize GetGeosphereSize(UINT numSubdivisions)const;
+	MeshSize GetCylinderSize(UINT sliceCount, UINT stackCount)const;
+	MeshSize GetGridSize(UINT m, UINT n)const;
+	MeshSize GetFullscreenQuadSize()const;
+
+	//
+	// Each shape can be written into a MeshData, which is resized to fit, or
+	// straight into caller memory such as a mapped vertex buffer.  The pointer
+	// versions write exactly the counts the matching Get*Size returns and
+	// allocate nothing.  Reusing a MeshData keeps its capacity, so generating
+	// a shape again allocates nothing either.
+	//
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions.
 	///</summary>
 	void CreateBox(float width, float height, float depth, MeshData& meshData);
+	void CreateBox(float width, float height, float depth, Vertex* vertices, UINT* indices);
 
 	///<summary>
 	/// Creates a sphere centered at the origin with the given radius.  The
 	/// slices and stacks parameters control the degree of tessellation.
 	///</summary>
 	void CreateSphere(float radius, UINT sliceCount, UINT stackCount, MeshData& meshData);
+	void CreateSphere(float radius, UINT sliceCount, UINT stackCount, Vertex* vertices, UINT* indices);
 
 	///<summary>
 	/// Creates a geosphere centered at the origin with the given radius.  The
-	/// depth controls the level of tessellation.
+	/// depth controls the level of tessellation, up to MaxGeosphereSubdivisions.
+	/// Triangles share the vertices along their edges.
 	///</summary>
 	void CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData);
+	void CreateGeosphere(float radius, UINT numSubdivisions, Vertex* vertices, UINT* indices);
 
 	///<summary>
 	/// Creates a cylinder parallel to the y-axis, and centered about the origin.  
@@ -73,23 +125,34 @@ public:
 	// cylinders.  The slices and stacks parameters control the degree of tessellation.
 	///</summary>
 	void CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
+	void CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, Vertex* vertices, UINT* indices);
 
 	///<summary>
 	/// Creates an mxn grid in the xz-plane with m rows and n columns, centered
 	/// at the origin with the specified width and depth.
 	///</summary>
 	void CreateGrid(float width, float depth, UINT m, UINT n, MeshData& meshData);
+	void CreateGrid(float width, float depth, UINT m, UINT n, Vertex* vertices, UINT* indices);
+
+	///<summary>
+	/// Creates the same grid raised to the height field.  Positions, normals,
+	/// tangents, texture coordinates and indices are written in one pass, four
+	/// vertices at a time, in blocks of rows that run on the job system if one
+	/// is given.
+	///</summary>
+	void CreateGrid(float width, float depth, UINT m, UINT n, const HeightField& heightField, MeshData& meshData, JobSystem* jobSystem = 0);
+	void CreateGrid(float width, float depth, UINT m, UINT n, const HeightField& heightField, Vertex* vertices, UINT* indices, JobSystem* jobSystem = 0);
 
 	///<summary>
 	/// Creates a quad covering the screen in NDC coordinates.  This is useful for
 	/// postprocessing effects.
 	///</summary>
 	void CreateFullscreenQuad(MeshData& meshData);
+	void CreateFullscreenQuad(Vertex* vertices, UINT* indices);
 
 private:
-	void Subdivide(MeshData& meshData);
-	void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
-	void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
+	void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, Vertex* vertices, UINT* indices, UINT baseIndex);
+	void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, Vertex* vertices, UINT* indices, UINT baseIndex);
 };
 
 #endif // GEOMETRYGENERATOR_H
\ No newline at end of file
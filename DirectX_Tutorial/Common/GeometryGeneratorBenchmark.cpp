@@ -0,0 +1,192 @@
+//***************************************************************************************
+// GeometryGeneratorBenchmark.cpp
+//
+// Headless benchmark of GeometryGenerator at high tessellation.  Every shape is
+// generated three ways:
+//   -into a new MeshData,
+//   -into a MeshData that already held it, as when a mesh is rebuilt,
+//   -into caller buffers sized with Get*Size, as when writing straight into a
+//    mapped vertex buffer.
+// For each it reports milliseconds per shape, and the number of heap
+// allocations and megabytes allocated, counted by replacing operator new.
+//
+// The caller buffers are filled with a byte pattern first, and must come out
+// equal to the MeshData, vertex for vertex and index for index, with as many
+// of each as Get*Size promises.  Every index must name a vertex.  Returns 1 if
+// any of these fail.
+//
+// Build with:
+//   cl /EHsc /O2 GeometryGenerator.cpp MathHelper.cpp JobSystem.cpp GeometryGeneratorBenchmark.cpp
+//
+// Usage: GeometryGeneratorBenchmark [gridSize [geosphereDepth]]      (default 2048 8)
+//***************************************************************************************
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+#include "GeometryGenerator.h"
+
+namespace
+{
+	size_t gAllocationCount = 0;
+	size_t gAllocatedBytes = 0;
+
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	enum Shape
+	{
+		Grid,
+		Sphere,
+		Cylinder,
+		Geosphere,
+		ShapeCount
+	};
+
+	struct Settings
+	{
+		UINT GridSize;
+		UINT GeosphereDepth;
+	};
+
+	GeometryGenerator::MeshSize GetSize(GeometryGenerator& geoGen, Shape shape, const Settings& s)
+	{
+		switch( shape )
+		{
+		case Grid:     return geoGen.GetGridSize(s.GridSize, s.GridSize);
+		case Sphere:   return geoGen.GetSphereSize(s.GridSize, s.GridSize/2);
+		case Cylinder: return geoGen.GetCylinderSize(s.GridSize, s.GridSize/2);
+		default:       return geoGen.GetGeosphereSize(s.GeosphereDepth);
+		}
+	}
+
+	void Create(GeometryGenerator& geoGen, Shape shape, const Settings& s, GeometryGenerator::MeshData& meshData)
+	{
+		switch( shape )
+		{
+		case Grid:     geoGen.CreateGrid(160.0f, 160.0f, s.GridSize, s.GridSize, meshData); break;
+		case Sphere:   geoGen.CreateSphere(1.0f, s.GridSize, s.GridSize/2, meshData); break;
+		case Cylinder: geoGen.CreateCylinder(1.0f, 0.5f, 3.0f, s.GridSize, s.GridSize/2, meshData); break;
+		default:       geoGen.CreateGeosphere(1.0f, s.GeosphereDepth, meshData); break;
+		}
+	}
+
+	void Create(GeometryGenerator& geoGen, Shape shape, const Settings& s,
+				GeometryGenerator::Vertex* vertices, UINT* indices)
+	{
+		switch( shape )
+		{
+		case Grid:     geoGen.CreateGrid(160.0f, 160.0f, s.GridSize, s.GridSize, vertices, indices); break;
+		case Sphere:   geoGen.CreateSphere(1.0f, s.GridSize, s.GridSize/2, vertices, indices); break;
+		case Cylinder: geoGen.CreateCylinder(1.0f, 0.5f, 3.0f, s.GridSize, s.GridSize/2, vertices, indices); break;
+		default:       geoGen.CreateGeosphere(1.0f, s.GeosphereDepth, vertices, indices); break;
+		}
+	}
+
+	struct Run
+	{
+		double Milliseconds;
+		size_t Allocations;
+		size_t Bytes;
+	};
+
+	// Starts counting; Stop fills in the run.
+	void Start(Run& run)
+	{
+		gAllocationCount = 0;
+		gAllocatedBytes = 0;
+		run.Milliseconds = Now();
+	}
+
+	void Stop(Run& run)
+	{
+		run.Milliseconds = (Now() - run.Milliseconds)*1000.0;
+		run.Allocations = gAllocationCount;
+		run.Bytes = gAllocatedBytes;
+	}
+}
+
+void* operator new(size_t size)
+{
+	++gAllocationCount;
+	gAllocatedBytes += size;
+
+	void* p = malloc(size ? size : 1);
+	if( !p )
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+int main(int argc, char* argv[])
+{
+	Settings settings;
+	settings.GridSize = argc > 1 ? (UINT)std::max(4, atoi(argv[1])) : 2048;
+	settings.GeosphereDepth = argc > 2 ? (UINT)std::max(0, atoi(argv[2])) : 8;
+
+	const char* names[ShapeCount] = { "grid", "sphere", "cylinder", "geosphere" };
+
+	printf("grid %ux%u, sphere and cylinder %u slices x %u stacks, geosphere depth %u\n\n",
+		settings.GridSize, settings.GridSize, settings.GridSize, settings.GridSize/2, settings.GeosphereDepth);
+	printf("%-10s %9s %9s | %9s %7s %8s | %9s %7s %8s | %9s %7s %8s\n", "shape", "vertices", "indices",
+		"new ms", "allocs", "MB", "reuse ms", "allocs", "MB", "buffer ms", "allocs", "MB");
+
+	GeometryGenerator geoGen;
+	bool passed = true;
+
+	for(UINT k = 0; k < ShapeCount; ++k)
+	{
+		Shape shape = (Shape)k;
+		GeometryGenerator::MeshSize size = GetSize(geoGen, shape, settings);
+
+		Run fresh, reuse, buffer;
+
+		GeometryGenerator::MeshData* meshData = new GeometryGenerator::MeshData();
+		Start(fresh);
+		Create(geoGen, shape, settings, *meshData);
+		Stop(fresh);
+
+		Start(reuse);
+		Create(geoGen, shape, settings, *meshData);
+		Stop(reuse);
+
+		std::vector<GeometryGenerator::Vertex> vertices(size.VertexCount);
+		std::vector<UINT> indices(size.IndexCount);
+		memset(&vertices[0], 0xCD, vertices.size()*sizeof(vertices[0]));
+		memset(&indices[0], 0xCD, indices.size()*sizeof(indices[0]));
+
+		Start(buffer);
+		Create(geoGen, shape, settings, &vertices[0], &indices[0]);
+		Stop(buffer);
+
+		bool same = meshData->Vertices.size() == size.VertexCount && meshData->Indices.size() == size.IndexCount &&
+			memcmp(&vertices[0], &meshData->Vertices[0], vertices.size()*sizeof(vertices[0])) == 0 &&
+			memcmp(&indices[0], &meshData->Indices[0], indices.size()*sizeof(indices[0])) == 0;
+		bool inRange = *std::max_element(indices.begin(), indices.end()) < size.VertexCount;
+		if( !same || !inRange )
+			passed = false;
+
+		delete meshData;
+
+		printf("%-10s %9u %9u | %9.1f %7u %8.1f | %9.1f %7u %8.1f | %9.1f %7u %8.1f%s\n", names[k],
+			size.VertexCount, size.IndexCount,
+			fresh.Milliseconds, (UINT)fresh.Allocations, fresh.Bytes/1048576.0,
+			reuse.Milliseconds, (UINT)reuse.Allocations, reuse.Bytes/1048576.0,
+			buffer.Milliseconds, (UINT)buffer.Allocations, buffer.Bytes/1048576.0,
+			!same ? "  differs" : (!inRange ? "  bad index" : ""));
+	}
+
+	printf("\n%s\n", passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
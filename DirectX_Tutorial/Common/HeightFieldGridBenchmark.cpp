@@ -0,0 +1,210 @@
+//***************************************************************************************
+// HeightFieldGridBenchmark.cpp
+//
+// Headless benchmark of GeometryGenerator::CreateGrid with a HeightField against
+// the two passes the hills demos make: CreateGrid builds a flat grid, then a
+// second loop raises every vertex with sinf and cosf and normalizes its normal
+// (Direct3D11_Bonus/Exc/Chapter07/HillAndWave/Light.cpp).  Both build the hills
+// of that demo over 300x300 units.  For each grid size it reports millions of
+// vertices per second
+//   -for the two passes,
+//   -for the height field grid on one thread and on a JobSystem.
+// The two passes only write positions and normals; the height field grid also
+// writes tangents.
+//
+// Every vertex of the height field grid is checked against the scalar
+// formulas: the height to within a hundred thousandth of the coordinates, the
+// normal and tangent to within 1e-4, and the x, z, texture coordinates and
+// indices exactly as the flat grid has them.  The grid built on the job system
+// must equal the one built on one thread.  Returns 1 if any check fails.
+//
+// Build with:
+//   cl /EHsc /O2 GeometryGenerator.cpp MathHelper.cpp JobSystem.cpp HeightFieldGridBenchmark.cpp
+//
+// Usage: HeightFieldGridBenchmark [size ...]      (default 256 1024 4096 8192)
+//        An 8192 x 8192 grid takes about 4.5 GB.
+//***************************************************************************************
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "GeometryGenerator.h"
+#include "JobSystem.h"
+
+namespace
+{
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	const float GridExtent = 300.0f;
+
+	float HillHeight(float x, float z)
+	{
+		return 0.3f*(z*sinf(0.1f*x) + x*cosf(0.1f*z));
+	}
+
+	XMFLOAT3 HillNormal(float x, float z)
+	{
+		// n = (-df/dx, 1, -df/dz)
+		XMFLOAT3 n(
+			-0.03f*z*cosf(0.1f*x) - 0.3f*cosf(0.1f*z),
+			1.0f,
+			-0.3f*sinf(0.1f*x) + 0.03f*x*sinf(0.1f*z));
+
+		XMStoreFloat3(&n, XMVector3Normalize(XMLoadFloat3(&n)));
+		return n;
+	}
+
+	XMFLOAT3 HillTangent(float x, float z)
+	{
+		XMFLOAT3 t(1.0f, 0.03f*z*cosf(0.1f*x) + 0.3f*cosf(0.1f*z), 0.0f);
+
+		XMStoreFloat3(&t, XMVector3Normalize(XMLoadFloat3(&t)));
+		return t;
+	}
+
+	class HillsHeightField : public GeometryGenerator::HeightField
+	{
+	public:
+		void Evaluate(FXMVECTOR x, FXMVECTOR z, XMVECTOR& height, XMVECTOR& slopeX, XMVECTOR& slopeZ)const
+		{
+			XMVECTOR sinX, cosX, sinZ, cosZ;
+			XMVectorSinCos(&sinX, &cosX, 0.1f*x);
+			XMVectorSinCos(&sinZ, &cosZ, 0.1f*z);
+
+			height = 0.3f*(z*sinX + x*cosZ);
+			slopeX = 0.03f*z*cosX + 0.3f*cosZ;
+			slopeZ = 0.3f*sinX - 0.03f*x*sinZ;
+		}
+	};
+
+	// The two passes of the hills demos.
+	void CreateHillsTwoPass(GeometryGenerator& geoGen, UINT size, GeometryGenerator::MeshData& grid)
+	{
+		geoGen.CreateGrid(GridExtent, GridExtent, size, size, grid);
+
+		for(size_t i = 0; i < grid.Vertices.size(); ++i)
+		{
+			XMFLOAT3& p = grid.Vertices[i].Position;
+			p.y = HillHeight(p.x, p.z);
+			grid.Vertices[i].Normal = HillNormal(p.x, p.z);
+		}
+	}
+
+	bool Near(const XMFLOAT3& a, const XMFLOAT3& b, float tolerance)
+	{
+		return fabsf(a.x - b.x) <= tolerance && fabsf(a.y - b.y) <= tolerance && fabsf(a.z - b.z) <= tolerance;
+	}
+
+	// Checks every vertex and index of a size x size hills grid.
+	bool Check(const GeometryGenerator::MeshData& hills, const GeometryGenerator::MeshData& flat)
+	{
+		for(size_t i = 0; i < hills.Vertices.size(); ++i)
+		{
+			const GeometryGenerator::Vertex& v = hills.Vertices[i];
+			const GeometryGenerator::Vertex& f = flat.Vertices[i];
+
+			float x = f.Position.x;
+			float z = f.Position.z;
+			if( v.Position.x != x || v.Position.z != z || v.TexC.x != f.TexC.x || v.TexC.y != f.TexC.y )
+				return false;
+
+			if( fabsf(v.Position.y - HillHeight(x, z)) > 1e-5f*(1.0f + fabsf(x) + fabsf(z)) ||
+				!Near(v.Normal, HillNormal(x, z), 1e-4f) || !Near(v.TangentU, HillTangent(x, z), 1e-4f) )
+				return false;
+		}
+
+		return hills.Indices == flat.Indices;
+	}
+
+	// FNV-1a over the bytes of a mesh, to compare two builds without keeping both.
+	unsigned long long Hash(const GeometryGenerator::MeshData& meshData)
+	{
+		unsigned long long hash = 14695981039346656037ull;
+		const unsigned char* bytes = (const unsigned char*)&meshData.Vertices[0];
+		size_t byteCount = meshData.Vertices.size()*sizeof(meshData.Vertices[0]);
+		for(size_t i = 0; i < byteCount; ++i)
+			hash = (hash ^ bytes[i])*1099511628211ull;
+
+		bytes = (const unsigned char*)&meshData.Indices[0];
+		byteCount = meshData.Indices.size()*sizeof(meshData.Indices[0]);
+		for(size_t i = 0; i < byteCount; ++i)
+			hash = (hash ^ bytes[i])*1099511628211ull;
+		return hash;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<UINT> sizes;
+	for(int i = 1; i < argc; ++i)
+		sizes.push_back((UINT)std::max(2, atoi(argv[i])));
+	if( sizes.empty() )
+	{
+		sizes.push_back(256);
+		sizes.push_back(1024);
+		sizes.push_back(4096);
+		sizes.push_back(8192);
+	}
+
+	JobSystem jobSystem;
+	GeometryGenerator geoGen;
+	HillsHeightField hills;
+
+	printf("%u threads\n\n", jobSystem.ThreadCount());
+	printf("%-7s %12s %14s %12s %14s %8s %10s %8s\n", "size", "vertices", "two pass Mv/s", "fused Mv/s",
+		"fused mt Mv/s", "speedup", "mt speedup", "failed");
+
+	bool passed = true;
+
+	for(size_t s = 0; s < sizes.size(); ++s)
+	{
+		UINT size = sizes[s];
+		UINT vertexCount = size*size;
+
+		// About a second of the two passes at the smaller sizes.
+		UINT repeats = std::max(1u, 4000000u / vertexCount);
+
+		GeometryGenerator::MeshData grid;
+		geoGen.CreateGrid(GridExtent, GridExtent, size, size, grid);
+
+		double start = Now();
+		for(UINT r = 0; r < repeats; ++r)
+			CreateHillsTwoPass(geoGen, size, grid);
+		double twoPassTime = (Now() - start) / repeats;
+
+		start = Now();
+		for(UINT r = 0; r < repeats; ++r)
+			geoGen.CreateGrid(GridExtent, GridExtent, size, size, hills, grid);
+		double fusedTime = (Now() - start) / repeats;
+		unsigned long long hash = Hash(grid);
+
+		start = Now();
+		for(UINT r = 0; r < repeats; ++r)
+			geoGen.CreateGrid(GridExtent, GridExtent, size, size, hills, grid, &jobSystem);
+		double mtTime = (Now() - start) / repeats;
+
+		bool valid = Hash(grid) == hash;
+		if( valid )
+		{
+			GeometryGenerator::MeshData flat;
+			geoGen.CreateGrid(GridExtent, GridExtent, size, size, flat);
+			valid = Check(grid, flat);
+		}
+		if( !valid )
+			passed = false;
+
+		printf("%-7u %12u %14.1f %12.1f %14.1f %8.2f %10.2f %8s\n", size, vertexCount,
+			vertexCount/twoPassTime*1e-6, vertexCount/fusedTime*1e-6, vertexCount/mtTime*1e-6,
+			twoPassTime/fusedTime, twoPassTime/mtTime, valid ? "" : "yes");
+	}
+
+	printf("\n%s\n", passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
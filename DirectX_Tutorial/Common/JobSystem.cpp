@@ -0,0 +1,227 @@
+//***************************************************************************************
+// JobSystem.cpp
+//***************************************************************************************
+
+#include "JobSystem.h"
+#include <algorithm>
+#include <deque>
+
+namespace
+{
+	thread_local unsigned int sThreadIndex = 0;
+}
+
+struct JobSystem::JobQueue
+{
+	std::mutex Mutex;
+	std::deque<Job> Jobs;
+};
+
+JobCounter::JobCounter()
+	: mValue(0)
+{
+}
+
+bool JobCounter::IsDone()const
+{
+	return mValue.load() == 0;
+}
+
+JobSystem::JobSystem(int workerCount)
+	: mQueuedJobs(0), mQuit(false)
+{
+	if( workerCount < 0 )
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? (int)hardwareThreads - 1 : 0;
+	}
+
+	for(int i = 0; i < workerCount + 1; ++i)
+		mQueues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+
+	for(int i = 0; i < workerCount; ++i)
+		mWorkers.push_back(std::thread(&JobSystem::WorkerMain, this, i + 1));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mQuit = true;
+	}
+	mWakeCondition.notify_all();
+
+	for(size_t i = 0; i < mWorkers.size(); ++i)
+		mWorkers[i].join();
+}
+
+unsigned int JobSystem::ThreadCount()const
+{
+	return (unsigned int)mQueues.size();
+}
+
+unsigned int JobSystem::ThreadIndex()
+{
+	return sThreadIndex;
+}
+
+void JobSystem::Run(const JobFunction& job, JobCounter* counter)
+{
+	if( counter )
+		++counter->mValue;
+
+	Job j = { job, counter };
+	Push(j);
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, const JobFunction& job, JobCounter* counter)
+{
+	if( counter )
+		++counter->mValue;
+
+	Job j = { job, counter };
+	{
+		std::lock_guard<std::mutex> lock(dependency.mMutex);
+		if( dependency.mValue.load() != 0 )
+		{
+			dependency.mContinuations.push_back(j);
+			return;
+		}
+	}
+
+	Push(j);
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	while( !counter.IsDone() )
+	{
+		if( !TryRunJob(ThreadIndex()) )
+			std::this_thread::yield();
+	}
+
+	// The job that released the counter may still hold its mutex; take it once
+	// so the caller can safely destroy the counter when we return.
+	std::lock_guard<std::mutex> lock(counter.mMutex);
+}
+
+void JobSystem::ParallelFor(unsigned int begin, unsigned int end, unsigned int grainSize, const JobRangeFunction& body)
+{
+	if( end <= begin )
+		return;
+
+	if( grainSize == 0 )
+		grainSize = std::max(1u, (end - begin) / (4*ThreadCount()));
+
+	// A single sub-range runs inline.
+	if( end - begin <= grainSize )
+	{
+		body(begin, end);
+		return;
+	}
+
+	JobCounter counter;
+	for(unsigned int first = begin; first < end; first += std::min(grainSize, end - first))
+	{
+		unsigned int last = first + std::min(grainSize, end - first);
+		Run([&body, first, last]() { body(first, last); }, &counter);
+	}
+
+	Wait(counter);
+}
+
+void JobSystem::Push(const Job& job)
+{
+	unsigned int threadIndex = ThreadIndex() < mQueues.size() ? ThreadIndex() : 0;
+
+	JobQueue& queue = *mQueues[threadIndex];
+	{
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		queue.Jobs.push_back(job);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		++mQueuedJobs;
+	}
+	mWakeCondition.notify_one();
+}
+
+bool JobSystem::TryRunJob(unsigned int threadIndex)
+{
+	unsigned int queueCount = (unsigned int)mQueues.size();
+	if( threadIndex >= queueCount )
+		threadIndex = 0;
+
+	Job job;
+	bool found = false;
+
+	// Newest job of our own queue first; it is most likely still in cache.
+	{
+		JobQueue& queue = *mQueues[threadIndex];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		if( !queue.Jobs.empty() )
+		{
+			job = queue.Jobs.back();
+			queue.Jobs.pop_back();
+			found = true;
+		}
+	}
+
+	// Otherwise steal the oldest job of another queue.
+	for(unsigned int i = 1; i < queueCount && !found; ++i)
+	{
+		JobQueue& queue = *mQueues[(threadIndex + i) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		if( !queue.Jobs.empty() )
+		{
+			job = queue.Jobs.front();
+			queue.Jobs.pop_front();
+			found = true;
+		}
+	}
+
+	if( !found )
+		return false;
+
+	--mQueuedJobs;
+
+	job.Function();
+	Finish(job.Counter);
+
+	return true;
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+	if( counter == 0 )
+		return;
+
+	std::vector<Job> ready;
+	{
+		std::lock_guard<std::mutex> lock(counter->mMutex);
+		if( --counter->mValue == 0 )
+			ready.swap(counter->mContinuations);
+	}
+
+	// The counter may be gone from here on; only touch the released jobs.
+	for(size_t i = 0; i < ready.size(); ++i)
+		Push(ready[i]);
+}
+
+void JobSystem::WorkerMain(unsigned int threadIndex)
+{
+	sThreadIndex = threadIndex;
+
+	for(;;)
+	{
+		if( TryRunJob(threadIndex) )
+			continue;
+
+		std::unique_lock<std::mutex> lock(mWakeMutex);
+		mWakeCondition.wait(lock, [this]() { return mQueuedJobs.load() > 0 || mQuit; });
+
+		if( mQuit && mQueuedJobs.load() == 0 )
+			return;
+	}
+}
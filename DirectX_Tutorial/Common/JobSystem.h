@@ -0,0 +1,113 @@
+//***************************************************************************************
+// JobSystem.h
+//
+// Work-stealing job system for spreading per-frame CPU work over all cores.
+//   -Every thread has its own job queue.  A thread takes the newest job of its own
+//    queue and, when that is empty, steals the oldest job of another queue.
+//   -A JobCounter counts the unfinished jobs added against it.  Wait() runs other
+//    jobs until the counter reaches zero, and RunAfter() holds a job back until it
+//    does, which is how dependencies between jobs are expressed.
+//   -ParallelFor() splits an index range into jobs and waits for them.
+//
+// Only the C++11 standard library is used, so this builds anywhere (no Windows or
+// DXUT headers); see JobSystemBenchmark.cpp.
+//***************************************************************************************
+
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void()> JobFunction;
+
+// Called with a half-open sub-range [first, last) of a ParallelFor range.
+typedef std::function<void(unsigned int first, unsigned int last)> JobRangeFunction;
+
+struct Job
+{
+	JobFunction Function;
+	class JobCounter* Counter;
+};
+
+class JobCounter
+{
+public:
+	JobCounter();
+
+	// True once every job added against this counter has finished.
+	bool IsDone()const;
+
+private:
+	JobCounter(const JobCounter& rhs);
+	JobCounter& operator=(const JobCounter& rhs);
+
+	friend class JobSystem;
+
+	std::atomic<int> mValue;
+
+	// Guards the hand-over of mContinuations when mValue reaches zero.
+	std::mutex mMutex;
+	std::vector<Job> mContinuations;
+};
+
+class JobSystem
+{
+public:
+	// Starts workerCount threads besides the thread that creates the JobSystem,
+	// which also runs jobs while it waits.  A negative count starts one worker
+	// per hardware thread, less the creating thread.
+	explicit JobSystem(int workerCount = -1);
+	~JobSystem();
+
+	// Worker threads plus the creating thread.
+	unsigned int ThreadCount()const;
+
+	// Index of the calling thread, in [0, ThreadCount()).  The creating thread
+	// (and any other thread not owned by a JobSystem) is 0.  Lets jobs pick
+	// per-thread scratch memory.
+	static unsigned int ThreadIndex();
+
+	// Queues a job.  If counter is given it is incremented now and decremented
+	// once the job has run.
+	void Run(const JobFunction& job, JobCounter* counter = 0);
+
+	// Same as Run, but the job is only queued once dependency reaches zero.
+	void RunAfter(JobCounter& dependency, const JobFunction& job, JobCounter* counter = 0);
+
+	// Runs queued jobs until counter reaches zero.
+	void Wait(JobCounter& counter);
+
+	// Calls body over [begin, end) in sub-ranges of grainSize indices, in
+	// parallel, and returns once all of them are done.  A grainSize of 0 splits
+	// the range into a few sub-ranges per thread.
+	void ParallelFor(unsigned int begin, unsigned int end, unsigned int grainSize, const JobRangeFunction& body);
+
+private:
+	JobSystem(const JobSystem& rhs);
+	JobSystem& operator=(const JobSystem& rhs);
+
+	struct JobQueue;
+
+	void Push(const Job& job);
+	bool TryRunJob(unsigned int threadIndex);
+	void Finish(JobCounter* counter);
+	void WorkerMain(unsigned int threadIndex);
+
+private:
+	std::vector<std::unique_ptr<JobQueue>> mQueues;
+	std::vector<std::thread> mWorkers;
+
+	// Jobs sitting in a queue; idle workers sleep while this is zero.
+	std::atomic<int> mQueuedJobs;
+	std::mutex mWakeMutex;
+	std::condition_variable mWakeCondition;
+	bool mQuit;
+};
+
+#endif // JOBSYSTEM_H
@@ -0,0 +1,186 @@
+//***************************************************************************************
+// JobSystemBenchmark.cpp
+//
+// Headless scaling benchmark for JobSystem.  Runs the kinds of per-frame work the
+// demos hand to the job system with 1..N threads and prints the speedup of each
+// thread count over the single-threaded run:
+//   -a wave grid update (the Waves::Update stencil),
+//   -per-instance work of a few microseconds each (animation, culling),
+//   -a chain of dependent stages (RunAfter).
+//
+// Needs no Windows or DXUT headers:
+//   g++ -std=c++11 -O2 -pthread JobSystem.cpp JobSystemBenchmark.cpp -o JobSystemBenchmark
+//   cl /EHsc /O2 JobSystem.cpp JobSystemBenchmark.cpp
+//
+// Usage: JobSystemBenchmark [maxThreads]
+//***************************************************************************************
+
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+	const int FrameCount = 60;
+
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	//
+	// Waves::Update stencil over an n*n grid.
+	//
+
+	struct WaveGrid
+	{
+		unsigned int N;
+		std::vector<float> Prev;
+		std::vector<float> Curr;
+
+		explicit WaveGrid(unsigned int n)
+			: N(n), Prev(n*n, 0.0f), Curr(n*n, 0.0f)
+		{
+			Curr[(n/2)*n + n/2] = 1.0f;
+		}
+
+		void Step(JobSystem& jobs)
+		{
+			const float k1 = 1.9f, k2 = -0.9f, k3 = 0.02f;
+			const unsigned int n = N;
+
+			jobs.ParallelFor(1, n - 1, 16, [&](unsigned int first, unsigned int last)
+			{
+				for(unsigned int i = first; i < last; ++i)
+				{
+					for(unsigned int j = 1; j < n - 1; ++j)
+					{
+						Prev[i*n+j] =
+							k1*Curr[i*n+j] +
+							k2*Prev[i*n+j] +
+							k3*(Curr[(i+1)*n+j] +
+							    Curr[(i-1)*n+j] +
+							    Curr[i*n+j+1] +
+							    Curr[i*n+j-1]);
+					}
+				}
+			});
+
+			Prev.swap(Curr);
+		}
+	};
+
+	double BenchmarkWaves(JobSystem& jobs)
+	{
+		WaveGrid grid(1024);
+
+		double start = Now();
+		for(int frame = 0; frame < FrameCount; ++frame)
+			grid.Step(jobs);
+		return Now() - start;
+	}
+
+	//
+	// Independent per-instance work, roughly the cost of posing one skinned
+	// character.
+	//
+
+	float InstanceWork(unsigned int instance)
+	{
+		float x = (float)instance;
+		for(int i = 0; i < 200; ++i)
+			x = std::sin(x)*0.5f + std::cos(x*1.1f);
+		return x;
+	}
+
+	double BenchmarkInstances(JobSystem& jobs)
+	{
+		const unsigned int instanceCount = 2048;
+		std::vector<float> results(instanceCount);
+
+		double start = Now();
+		for(int frame = 0; frame < FrameCount; ++frame)
+		{
+			jobs.ParallelFor(0, instanceCount, 8, [&](unsigned int first, unsigned int last)
+			{
+				for(unsigned int i = first; i < last; ++i)
+					results[i] = InstanceWork(i + frame);
+			});
+		}
+		return Now() - start;
+	}
+
+	//
+	// Three stages per frame, each a fan of jobs that may only start once the
+	// previous stage has finished.
+	//
+
+	double BenchmarkDependencies(JobSystem& jobs)
+	{
+		const unsigned int stageCount = 3;
+		const unsigned int jobsPerStage = 256;
+		std::vector<float> results(stageCount*jobsPerStage);
+
+		double start = Now();
+		for(int frame = 0; frame < FrameCount; ++frame)
+		{
+			JobCounter stages[stageCount];
+			for(unsigned int s = 0; s < stageCount; ++s)
+			{
+				for(unsigned int j = 0; j < jobsPerStage; ++j)
+				{
+					float* result = &results[s*jobsPerStage + j];
+					JobFunction job = [result, j]() { *result = InstanceWork(j); };
+
+					if( s == 0 )
+						jobs.Run(job, &stages[s]);
+					else
+						jobs.RunAfter(stages[s-1], job, &stages[s]);
+				}
+			}
+			jobs.Wait(stages[stageCount-1]);
+
+			// Earlier stages are done once the last one is, but their mutexes may
+			// still be held by the jobs that released them.
+			for(unsigned int s = 0; s < stageCount - 1; ++s)
+				jobs.Wait(stages[s]);
+		}
+		return Now() - start;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	if( argc > 1 )
+		maxThreads = std::max(1, atoi(argv[1]));
+
+	printf("%d frames per workload, hardware threads: %u\n\n", FrameCount, std::thread::hardware_concurrency());
+	printf("%8s %22s %22s %22s\n", "threads", "waves 1024^2 ms (x)", "instances ms (x)", "dependencies ms (x)");
+
+	double baseline[3] = { 0.0, 0.0, 0.0 };
+	for(unsigned int threads = 1; threads <= maxThreads; ++threads)
+	{
+		JobSystem jobs((int)threads - 1);
+
+		double times[3];
+		times[0] = BenchmarkWaves(jobs);
+		times[1] = BenchmarkInstances(jobs);
+		times[2] = BenchmarkDependencies(jobs);
+
+		if( threads == 1 )
+			std::copy(times, times + 3, baseline);
+
+		printf("%8u", threads);
+		for(int i = 0; i < 3; ++i)
+			printf(" %14.2f (%5.2f)", times[i]*1000.0, baseline[i]/times[i]);
+		printf("\n");
+	}
+
+	return 0;
+}
@@ -0,0 +1,725 @@
+//***************************************************************************************
+// MeshOptimizer.cpp
+//***************************************************************************************
+
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	// Entries of the LRU cache OptimizeVertexCache scores vertices against.  A
+	// little larger than the hardware caches, which keeps the order good for
+	// any of them.
+	const unsigned int ScoreCacheSize = 32;
+	const unsigned int MaxScoredValence = 32;
+
+	// Forsyth's scores: the three vertices of the last triangle score the same,
+	// so the next triangle may share any edge of it; after them the score falls
+	// off with the position in the cache.  Vertices with few triangles left get
+	// a boost so they are finished off rather than left behind as lone triangles.
+	struct ScoreTables
+	{
+		float Cache[ScoreCacheSize];
+		float Valence[MaxScoredValence];
+
+		ScoreTables()
+		{
+			for(unsigned int i = 0; i < ScoreCacheSize; ++i)
+			{
+				if( i < 3 )
+					Cache[i] = 0.75f;
+				else
+					Cache[i] = powf(1.0f - (float)(i - 3)/(ScoreCacheSize - 3), 1.5f);
+			}
+
+			Valence[0] = 0.0f;
+			for(unsigned int i = 1; i < MaxScoredValence; ++i)
+				Valence[i] = 2.0f/sqrtf((float)i);
+		}
+	};
+
+	const ScoreTables& GetScoreTables()
+	{
+		static const ScoreTables tables;
+		return tables;
+	}
+
+	// The cheaper way of fetching the vertices for a triangle order: as they
+	// are numbered, or renumbered by OptimizeVertexFetch if refetch is set.
+	struct FetchOrder
+	{
+		std::vector<unsigned int> Remap;
+		bool Renumbered;
+		float Overfetch;
+	};
+
+	void ChooseFetchOrder(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount,
+		unsigned int vertexSize, bool refetch, FetchOrder& order)
+	{
+		order.Remap.resize(vertexCount);
+		for(unsigned int v = 0; v < vertexCount; ++v)
+			order.Remap[v] = v;
+		order.Renumbered = false;
+		order.Overfetch = MeshOptimizer::AnalyzeVertexFetch(indices, indexCount, vertexCount, vertexSize).Overfetch;
+
+		if( !refetch )
+			return;
+
+		std::vector<unsigned int> remap(vertexCount), remapped(indexCount);
+		MeshOptimizer::OptimizeVertexFetch(&remap[0], indices, indexCount, vertexCount);
+		MeshOptimizer::RemapIndices(&remapped[0], indices, indexCount, &remap[0]);
+
+		float overfetch = MeshOptimizer::AnalyzeVertexFetch(&remapped[0], indexCount, vertexCount, vertexSize).Overfetch;
+		if( overfetch < order.Overfetch )
+		{
+			order.Remap.swap(remap);
+			order.Renumbered = true;
+			order.Overfetch = overfetch;
+		}
+	}
+
+	// OptimizeOverdraw's default threshold, which Optimize also allows ACMR to
+	// rise by.
+	const float OverdrawThreshold = 1.05f;
+
+	float VertexScore(int cachePosition, unsigned int liveTriangles)
+	{
+		// Nothing left to draw with this vertex.
+		if( liveTriangles == 0 )
+			return -1.0f;
+
+		const ScoreTables& tables = GetScoreTables();
+		float score = cachePosition < 0 ? 0.0f : tables.Cache[cachePosition];
+		return score + tables.Valence[std::min(liveTriangles, MaxScoredValence - 1)];
+	}
+
+	// A FIFO post-transform cache, where a vertex is cached if fewer than
+	// CacheSize misses came after its own.
+	class FifoCache
+	{
+	public:
+		FifoCache(unsigned int vertexCount, unsigned int cacheSize)
+			: mInsertedAt(vertexCount, 0), mMisses(0), mSize(cacheSize)
+		{
+			Flush();
+		}
+
+		// Returns true if the vertex had to be transformed.
+		bool Access(unsigned int vertex)
+		{
+			unsigned int& at = mInsertedAt[vertex];
+			if( mMisses - at < mSize )
+				return false;
+
+			at = ++mMisses;
+			return true;
+		}
+
+		unsigned int TriangleMisses(const unsigned int* triangle)
+		{
+			return (Access(triangle[0]) ? 1 : 0) + (Access(triangle[1]) ? 1 : 0) + (Access(triangle[2]) ? 1 : 0);
+		}
+
+		// Empties the cache, as if the cluster that follows were drawn first.
+		void Flush()
+		{
+			mMisses += mSize;
+		}
+
+	private:
+		std::vector<unsigned int> mInsertedAt;
+		unsigned int mMisses;
+		unsigned int mSize;
+	};
+
+	struct Float3
+	{
+		float X, Y, Z;
+	};
+
+	Float3 GetPosition(const float* positions, unsigned int vertexStride, unsigned int vertex)
+	{
+		const float* p = (const float*)((const char*)positions + (size_t)vertex*vertexStride);
+		Float3 result = { p[0], p[1], p[2] };
+		return result;
+	}
+
+	// Twice the area, in the direction of the front face.
+	Float3 TriangleNormal(const Float3& p0, const Float3& p1, const Float3& p2)
+	{
+		Float3 e1 = { p1.X - p0.X, p1.Y - p0.Y, p1.Z - p0.Z };
+		Float3 e2 = { p2.X - p0.X, p2.Y - p0.Y, p2.Z - p0.Z };
+		Float3 n = { e1.Y*e2.Z - e1.Z*e2.Y, e1.Z*e2.X - e1.X*e2.Z, e1.X*e2.Y - e1.Y*e2.X };
+		return n;
+	}
+
+	float Length(const Float3& v)
+	{
+		return sqrtf(v.X*v.X + v.Y*v.Y + v.Z*v.Z);
+	}
+
+	struct Cluster
+	{
+		unsigned int FirstTriangle;
+		unsigned int TriangleCount;
+		float SortKey;
+	};
+
+	const int OverdrawResolution = 256;
+
+	struct ScreenVertex
+	{
+		float X, Y, Depth;
+	};
+
+	float EdgeFunction(const ScreenVertex& a, const ScreenVertex& b, float x, float y)
+	{
+		return (b.X - a.X)*(y - a.Y) - (b.Y - a.Y)*(x - a.X);
+	}
+
+	// Rasterizes a triangle into the depth buffer with a less-than test and
+	// returns the pixels that passed it.  Pixel centers on an edge count as
+	// inside.
+	unsigned int RasterizeTriangle(ScreenVertex v0, ScreenVertex v1, ScreenVertex v2, float* depth)
+	{
+		float area = EdgeFunction(v0, v1, v2.X, v2.Y);
+		if( area == 0.0f )
+			return 0;
+		if( area < 0.0f )
+		{
+			std::swap(v1, v2);
+			area = -area;
+		}
+
+		int minX = std::max(0, (int)floorf(std::min(v0.X, std::min(v1.X, v2.X))));
+		int minY = std::max(0, (int)floorf(std::min(v0.Y, std::min(v1.Y, v2.Y))));
+		int maxX = std::min(OverdrawResolution - 1, (int)ceilf(std::max(v0.X, std::max(v1.X, v2.X))));
+		int maxY = std::min(OverdrawResolution - 1, (int)ceilf(std::max(v0.Y, std::max(v1.Y, v2.Y))));
+
+		unsigned int shaded = 0;
+		for(int y = minY; y <= maxY; ++y)
+		{
+			float centerY = y + 0.5f;
+			for(int x = minX; x <= maxX; ++x)
+			{
+				float centerX = x + 0.5f;
+				float w0 = EdgeFunction(v1, v2, centerX, centerY);
+				float w1 = EdgeFunction(v2, v0, centerX, centerY);
+				float w2 = EdgeFunction(v0, v1, centerX, centerY);
+				if( w0 < 0.0f || w1 < 0.0f || w2 < 0.0f )
+					continue;
+
+				float z = (w0*v0.Depth + w1*v1.Depth + w2*v2.Depth)/area;
+				float& pixel = depth[y*OverdrawResolution + x];
+				if( z < pixel )
+				{
+					pixel = z;
+					++shaded;
+				}
+			}
+		}
+		return shaded;
+	}
+}
+
+unsigned int MeshOptimizer::Optimize(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount,
+									 unsigned int vertexSize, unsigned int* remap, unsigned int passes,
+									 const float* positions, unsigned int vertexStride)
+{
+	bool refetch = (passes & PassVertexFetch) != 0 && remap != 0;
+	if( indexCount < 3 )
+	{
+		for(unsigned int v = 0; remap && v < vertexCount; ++v)
+			remap[v] = v;
+		return 0;
+	}
+
+	std::vector<unsigned int> current(indices, indices + indexCount), candidate(indexCount);
+	FetchOrder currentFetch, candidateFetch;
+
+	float acmr = AnalyzeVertexCache(&current[0], indexCount, vertexCount).Acmr;
+	ChooseFetchOrder(&current[0], indexCount, vertexCount, vertexSize, refetch, currentFetch);
+
+	unsigned int kept = 0;
+
+	if( passes & PassVertexCache )
+	{
+		OptimizeVertexCache(&candidate[0], &current[0], indexCount, vertexCount);
+		float candidateAcmr = AnalyzeVertexCache(&candidate[0], indexCount, vertexCount).Acmr;
+		ChooseFetchOrder(&candidate[0], indexCount, vertexCount, vertexSize, refetch, candidateFetch);
+
+		if( candidateAcmr < acmr && candidateFetch.Overfetch <= currentFetch.Overfetch )
+		{
+			current.swap(candidate);
+			std::swap(currentFetch, candidateFetch);
+			acmr = candidateAcmr;
+			kept |= PassVertexCache;
+		}
+	}
+
+	if( (passes & PassOverdraw) && positions != 0 )
+	{
+		OptimizeOverdraw(&candidate[0], &current[0], indexCount, positions, vertexCount, vertexStride,
+			OverdrawThreshold);
+		float candidateAcmr = AnalyzeVertexCache(&candidate[0], indexCount, vertexCount).Acmr;
+		ChooseFetchOrder(&candidate[0], indexCount, vertexCount, vertexSize, refetch, candidateFetch);
+
+		if( candidateAcmr <= acmr*OverdrawThreshold && candidateFetch.Overfetch <= currentFetch.Overfetch &&
+			AnalyzeOverdraw(&candidate[0], indexCount, positions, vertexStride).Overdraw <
+			AnalyzeOverdraw(&current[0], indexCount, positions, vertexStride).Overdraw )
+		{
+			current.swap(candidate);
+			std::swap(currentFetch, candidateFetch);
+			kept |= PassOverdraw;
+		}
+	}
+
+	if( currentFetch.Renumbered )
+		kept |= PassVertexFetch;
+
+	if( remap )
+		std::copy(currentFetch.Remap.begin(), currentFetch.Remap.end(), remap);
+	RemapIndices(indices, &current[0], indexCount, &currentFetch.Remap[0]);
+	return kept;
+}
+
+void MeshOptimizer::OptimizeVertexCache(unsigned int* destination, const unsigned int* indices,
+										unsigned int indexCount, unsigned int vertexCount)
+{
+	unsigned int triangleCount = indexCount/3;
+	if( triangleCount == 0 )
+		return;
+
+	std::vector<unsigned int> source;
+	if( destination == indices )
+	{
+		source.assign(indices, indices + indexCount);
+		indices = &source[0];
+	}
+
+	// The triangles of each vertex, with the ones not yet drawn first.
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for(unsigned int i = 0; i < 3*triangleCount; ++i)
+		++liveTriangles[indices[i]];
+
+	std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+	for(unsigned int v = 0; v < vertexCount; ++v)
+		firstTriangle[v+1] = firstTriangle[v] + liveTriangles[v];
+
+	std::vector<unsigned int> vertexTriangles(3*triangleCount);
+	std::vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+	for(unsigned int i = 0; i < 3*triangleCount; ++i)
+		vertexTriangles[filled[indices[i]]++] = i/3;
+
+	std::vector<float> vertexScores(vertexCount);
+	for(unsigned int v = 0; v < vertexCount; ++v)
+		vertexScores[v] = VertexScore(-1, liveTriangles[v]);
+
+	std::vector<bool> drawn(triangleCount, false);
+
+	// Three more entries, for the vertices of a triangle pushed in front of a
+	// full cache.
+	unsigned int cache[ScoreCacheSize + 3];
+	unsigned int newCache[ScoreCacheSize + 3];
+	unsigned int cacheCount = 0;
+
+	// Where to look for a triangle when none in the cache is left, in the
+	// order of the input.  The input order tends to keep neighbors together,
+	// which is worth more than finding the best scoring triangle anywhere.
+	unsigned int nextUndrawn = 0;
+	unsigned int best = triangleCount;
+
+	for(unsigned int t = 0; t < triangleCount; ++t)
+	{
+		if( best == triangleCount )
+		{
+			while( drawn[nextUndrawn] )
+				++nextUndrawn;
+			best = nextUndrawn;
+		}
+
+		const unsigned int* triangle = indices + 3*best;
+		destination[3*t + 0] = triangle[0];
+		destination[3*t + 1] = triangle[1];
+		destination[3*t + 2] = triangle[2];
+		drawn[best] = true;
+
+		unsigned int newCount = 0;
+		for(unsigned int k = 0; k < 3; ++k)
+		{
+			unsigned int v = triangle[k];
+
+			unsigned int* live = &vertexTriangles[firstTriangle[v]];
+			unsigned int* liveEnd = live + liveTriangles[v];
+			std::swap(*std::find(live, liveEnd, best), *(liveEnd - 1));
+			--liveTriangles[v];
+
+			// Degenerate triangles name a vertex twice.
+			if( std::find(newCache, newCache + newCount, v) == newCache + newCount )
+				newCache[newCount++] = v;
+		}
+
+		for(unsigned int i = 0; i < cacheCount; ++i)
+		{
+			unsigned int v = cache[i];
+			if( v != triangle[0] && v != triangle[1] && v != triangle[2] )
+				newCache[newCount++] = v;
+		}
+
+		for(unsigned int i = ScoreCacheSize; i < newCount; ++i)
+		{
+			unsigned int v = newCache[i];
+			vertexScores[v] = VertexScore(-1, liveTriangles[v]);
+		}
+
+		cacheCount = std::min(newCount, ScoreCacheSize);
+		for(unsigned int i = 0; i < cacheCount; ++i)
+		{
+			unsigned int v = newCache[i];
+			cache[i] = v;
+			vertexScores[v] = VertexScore((int)i, liveTriangles[v]);
+		}
+
+		// The best triangle left around the cached vertices is drawn next.
+		best = triangleCount;
+		float bestScore = -1.0f;
+		for(unsigned int i = 0; i < cacheCount; ++i)
+		{
+			unsigned int v = cache[i];
+			const unsigned int* live = &vertexTriangles[firstTriangle[v]];
+			for(unsigned int j = 0; j < liveTriangles[v]; ++j)
+			{
+				const unsigned int* candidate = indices + 3*live[j];
+				float score = vertexScores[candidate[0]] + vertexScores[candidate[1]] + vertexScores[candidate[2]];
+				if( score > bestScore )
+				{
+					bestScore = score;
+					best = live[j];
+				}
+			}
+		}
+	}
+}
+
+void MeshOptimizer::OptimizeOverdraw(unsigned int* destination, const unsigned int* indices,
+									 unsigned int indexCount, const float* positions, unsigned int vertexCount,
+									 unsigned int vertexStride, float threshold)
+{
+	unsigned int triangleCount = indexCount/3;
+	if( triangleCount == 0 )
+		return;
+
+	std::vector<unsigned int> source(indices, indices + 3*triangleCount);
+	indices = &source[0];
+
+	// Hard boundaries: triangles that miss the cache on all three vertices,
+	// where the cache order started over anyway.
+	std::vector<unsigned int> hardStarts(1, 0);
+	FifoCache cache(vertexCount, AnalyzeCacheSize);
+	for(unsigned int t = 0; t < triangleCount; ++t)
+	{
+		if( cache.TriangleMisses(indices + 3*t) == 3 && t > 0 )
+			hardStarts.push_back(t);
+	}
+	hardStarts.push_back(triangleCount);
+
+	// Soft boundaries: within each hard cluster, cut wherever the misses per
+	// triangle since the last cut, starting from an empty cache, are within
+	// threshold of those of the whole cluster.
+	std::vector<Cluster> clusters;
+	for(size_t h = 0; h + 1 < hardStarts.size(); ++h)
+	{
+		unsigned int first = hardStarts[h];
+		unsigned int end = hardStarts[h+1];
+
+		cache.Flush();
+		unsigned int clusterMisses = 0;
+		for(unsigned int t = first; t < end; ++t)
+			clusterMisses += cache.TriangleMisses(indices + 3*t);
+		float clusterAcmr = (float)clusterMisses/(end - first);
+
+		cache.Flush();
+		unsigned int start = first;
+		unsigned int misses = 0;
+		for(unsigned int t = first; t < end; ++t)
+		{
+			misses += cache.TriangleMisses(indices + 3*t);
+			if( t + 1 < end && misses <= threshold*clusterAcmr*(t + 1 - start) )
+			{
+				Cluster cluster = { start, t + 1 - start, 0.0f };
+				clusters.push_back(cluster);
+
+				cache.Flush();
+				start = t + 1;
+				misses = 0;
+			}
+		}
+
+		Cluster cluster = { start, end - start, 0.0f };
+		clusters.push_back(cluster);
+	}
+
+	// Sort key: how far the cluster's centroid lies out from the mesh centroid
+	// along the cluster's average normal.  Clusters on the outside facing out
+	// are drawn first; they are the likeliest to hide the rest.
+	Float3 meshCentroid = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+	std::vector<Float3> clusterCentroids(clusters.size());
+	std::vector<Float3> clusterNormals(clusters.size());
+
+	for(size_t c = 0; c < clusters.size(); ++c)
+	{
+		Float3 centroid = { 0.0f, 0.0f, 0.0f };
+		Float3 normal = { 0.0f, 0.0f, 0.0f };
+		float area = 0.0f;
+
+		for(unsigned int t = clusters[c].FirstTriangle; t < clusters[c].FirstTriangle + clusters[c].TriangleCount; ++t)
+		{
+			Float3 p0 = GetPosition(positions, vertexStride, indices[3*t + 0]);
+			Float3 p1 = GetPosition(positions, vertexStride, indices[3*t + 1]);
+			Float3 p2 = GetPosition(positions, vertexStride, indices[3*t + 2]);
+
+			Float3 n = TriangleNormal(p0, p1, p2);
+			float a = Length(n);
+
+			centroid.X += a*(p0.X + p1.X + p2.X);
+			centroid.Y += a*(p0.Y + p1.Y + p2.Y);
+			centroid.Z += a*(p0.Z + p1.Z + p2.Z);
+			normal.X += n.X;
+			normal.Y += n.Y;
+			normal.Z += n.Z;
+			area += a;
+		}
+
+		meshCentroid.X += centroid.X;
+		meshCentroid.Y += centroid.Y;
+		meshCentroid.Z += centroid.Z;
+		meshArea += area;
+
+		float scale = area > 0.0f ? 1.0f/(3.0f*area) : 0.0f;
+		Float3 clusterCentroid = { centroid.X*scale, centroid.Y*scale, centroid.Z*scale };
+		clusterCentroids[c] = clusterCentroid;
+		clusterNormals[c] = normal;
+	}
+
+	float meshScale = meshArea > 0.0f ? 1.0f/(3.0f*meshArea) : 0.0f;
+	meshCentroid.X *= meshScale;
+	meshCentroid.Y *= meshScale;
+	meshCentroid.Z *= meshScale;
+
+	for(size_t c = 0; c < clusters.size(); ++c)
+	{
+		const Float3& n = clusterNormals[c];
+		float length = Length(n);
+		if( length > 0.0f )
+		{
+			Float3 d = { clusterCentroids[c].X - meshCentroid.X, clusterCentroids[c].Y - meshCentroid.Y,
+				clusterCentroids[c].Z - meshCentroid.Z };
+			clusters[c].SortKey = (d.X*n.X + d.Y*n.Y + d.Z*n.Z)/length;
+		}
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b)
+	{
+		return a.SortKey > b.SortKey;
+	});
+
+	unsigned int written = 0;
+	for(size_t c = 0; c < clusters.size(); ++c)
+	{
+		const unsigned int* triangles = indices + 3*clusters[c].FirstTriangle;
+		std::copy(triangles, triangles + 3*clusters[c].TriangleCount, destination + written);
+		written += 3*clusters[c].TriangleCount;
+	}
+}
+
+unsigned int MeshOptimizer::OptimizeVertexFetch(unsigned int* remap, const unsigned int* indices,
+												unsigned int indexCount, unsigned int vertexCount)
+{
+	const unsigned int Unused = 0xffffffff;
+	std::fill(remap, remap + vertexCount, Unused);
+
+	unsigned int next = 0;
+	for(unsigned int i = 0; i < indexCount; ++i)
+	{
+		if( remap[indices[i]] == Unused )
+			remap[indices[i]] = next++;
+	}
+
+	unsigned int usedCount = next;
+	for(unsigned int v = 0; v < vertexCount; ++v)
+	{
+		if( remap[v] == Unused )
+			remap[v] = next++;
+	}
+	return usedCount;
+}
+
+void MeshOptimizer::RemapIndices(unsigned int* destination, const unsigned int* indices,
+								 unsigned int indexCount, const unsigned int* remap)
+{
+	for(unsigned int i = 0; i < indexCount; ++i)
+		destination[i] = remap[indices[i]];
+}
+
+void MeshOptimizer::RemapVertices(void* destination, const void* vertices, unsigned int vertexCount,
+								  unsigned int vertexSize, const unsigned int* remap)
+{
+	for(unsigned int v = 0; v < vertexCount; ++v)
+	{
+		memcpy((char*)destination + (size_t)remap[v]*vertexSize,
+			(const char*)vertices + (size_t)v*vertexSize, vertexSize);
+	}
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const unsigned int* indices, unsigned int indexCount,
+												   unsigned int vertexCount, unsigned int cacheSize)
+{
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> used(vertexCount, false);
+
+	unsigned int transformed = 0;
+	unsigned int usedCount = 0;
+	for(unsigned int i = 0; i < indexCount; ++i)
+	{
+		if( cache.Access(indices[i]) )
+			++transformed;
+
+		if( !used[indices[i]] )
+		{
+			used[indices[i]] = true;
+			++usedCount;
+		}
+	}
+
+	VertexCacheStats stats;
+	stats.VerticesTransformed = transformed;
+	stats.Acmr = indexCount >= 3 ? (float)transformed/(indexCount/3) : 0.0f;
+	stats.Atvr = usedCount > 0 ? (float)transformed/usedCount : 0.0f;
+	return stats;
+}
+
+VertexFetchStats MeshOptimizer::AnalyzeVertexFetch(const unsigned int* indices, unsigned int indexCount,
+												   unsigned int vertexCount, unsigned int vertexSize)
+{
+	const unsigned int LineSize = 64;
+	const unsigned int LineCount = 16384/LineSize;
+
+	FifoCache cache(vertexCount, AnalyzeCacheSize);
+	std::vector<bool> used(vertexCount, false);
+
+	// Line number plus one in each slot, 0 for none.
+	std::vector<size_t> lines(LineCount, 0);
+
+	unsigned int bytesFetched = 0;
+	unsigned int usedCount = 0;
+	for(unsigned int i = 0; i < indexCount; ++i)
+	{
+		unsigned int v = indices[i];
+		if( !used[v] )
+		{
+			used[v] = true;
+			++usedCount;
+		}
+
+		if( !cache.Access(v) )
+			continue;
+
+		size_t firstLine = (size_t)v*vertexSize/LineSize;
+		size_t lastLine = ((size_t)v*vertexSize + vertexSize - 1)/LineSize;
+		for(size_t line = firstLine; line <= lastLine; ++line)
+		{
+			size_t& slot = lines[line % LineCount];
+			if( slot != line + 1 )
+			{
+				slot = line + 1;
+				bytesFetched += LineSize;
+			}
+		}
+	}
+
+	VertexFetchStats stats;
+	stats.BytesFetched = bytesFetched;
+	stats.Overfetch = usedCount > 0 ? (float)bytesFetched/((float)usedCount*vertexSize) : 0.0f;
+	return stats;
+}
+
+OverdrawStats MeshOptimizer::AnalyzeOverdraw(const unsigned int* indices, unsigned int indexCount,
+											 const float* positions, unsigned int vertexStride)
+{
+	OverdrawStats stats;
+	stats.PixelsCovered = 0;
+	stats.PixelsShaded = 0;
+	stats.Overdraw = 0.0f;
+
+	if( indexCount < 3 )
+		return stats;
+
+	// Fit the bounds of the used vertices into the view, the same for every
+	// axis so the views keep their proportions.
+	float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for(unsigned int i = 0; i < indexCount; ++i)
+	{
+		Float3 p = GetPosition(positions, vertexStride, indices[i]);
+		const float coords[3] = { p.X, p.Y, p.Z };
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			boundsMin[axis] = std::min(boundsMin[axis], coords[axis]);
+			boundsMax[axis] = std::max(boundsMax[axis], coords[axis]);
+		}
+	}
+
+	float extent = std::max(boundsMax[0] - boundsMin[0], std::max(boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2]));
+	float scale = extent > 0.0f ? OverdrawResolution/extent : 0.0f;
+
+	std::vector<float> depth(OverdrawResolution*OverdrawResolution);
+
+	for(int view = 0; view < 6; ++view)
+	{
+		// Looking along +axis or -axis, with the other two axes across the screen.
+		int axis = view/2;
+		float sign = view % 2 == 0 ? 1.0f : -1.0f;
+		int across = (axis + 1) % 3;
+		int up = (axis + 2) % 3;
+
+		std::fill(depth.begin(), depth.end(), FLT_MAX);
+
+		for(unsigned int t = 0; t + 2 < indexCount; t += 3)
+		{
+			Float3 p[3];
+			for(int k = 0; k < 3; ++k)
+				p[k] = GetPosition(positions, vertexStride, indices[t + k]);
+
+			// Front faces have their normal toward the viewer.
+			Float3 n = TriangleNormal(p[0], p[1], p[2]);
+			const float normal[3] = { n.X, n.Y, n.Z };
+			if( normal[axis]*sign >= 0.0f )
+				continue;
+
+			ScreenVertex screen[3];
+			for(int k = 0; k < 3; ++k)
+			{
+				const float coords[3] = { p[k].X, p[k].Y, p[k].Z };
+				screen[k].X = (coords[across] - boundsMin[across])*scale;
+				screen[k].Y = (coords[up] - boundsMin[up])*scale;
+				screen[k].Depth = sign*coords[axis];
+			}
+
+			stats.PixelsShaded += RasterizeTriangle(screen[0], screen[1], screen[2], &depth[0]);
+		}
+
+		for(size_t i = 0; i < depth.size(); ++i)
+		{
+			if( depth[i] != FLT_MAX )
+				++stats.PixelsCovered;
+		}
+	}
+
+	stats.Overdraw = stats.PixelsCovered > 0 ? (float)stats.PixelsShaded/stats.PixelsCovered : 0.0f;
+	return stats;
+}
@@ -0,0 +1,130 @@
+//***************************************************************************************
+// MeshOptimizer.h
+//
+// Reorders the triangles and vertices of indexed triangle lists so the GPU does
+// less work drawing them.  Models come out of their loaders in whatever order
+// they were exported in; run the three passes in this order:
+//   -OptimizeVertexCache() orders triangles so vertices are reused while they are
+//    still in the post-transform cache (Tom Forsyth's linear-speed vertex cache
+//    optimization).
+//   -OptimizeOverdraw() cuts that order into clusters where the cache starts
+//    afresh anyway, and draws the clusters that face out from the middle of the
+//    mesh first, so that they hide the ones behind them.
+//   -OptimizeVertexFetch() numbers vertices in the order the triangles first use
+//    them, so the vertex buffer is read front to back.
+// The Analyze functions measure what each pass is after: vertex shader runs per
+// triangle and per vertex (ACMR and ATVR) through a FIFO cache, bytes fetched
+// from the vertex buffer, and pixels shaded per pixel covered.  A pass can make
+// a mesh that was exported in a good order worse, so Optimize() runs the passes
+// and keeps each only where those measures say it helps.
+//
+// Only the C++ standard library is used, so this builds anywhere (no Windows or
+// DXUT headers); see MeshOptimizerTool.cpp.
+//***************************************************************************************
+
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+struct VertexCacheStats
+{
+	unsigned int VerticesTransformed;
+
+	// Vertex shader runs per triangle (0.5 is the best a closed mesh can do,
+	// 3 the worst) and per vertex used (1 is the best).
+	float Acmr;
+	float Atvr;
+};
+
+struct VertexFetchStats
+{
+	unsigned int BytesFetched;
+
+	// Bytes fetched over the bytes of the vertices used; 1 when every cache
+	// line is read once.
+	float Overfetch;
+};
+
+struct OverdrawStats
+{
+	unsigned int PixelsCovered;
+	unsigned int PixelsShaded;
+
+	// Pixels shaded per pixel covered, with an early depth test.
+	float Overdraw;
+};
+
+class MeshOptimizer
+{
+public:
+	// Entries of the FIFO cache the Analyze functions simulate, as on most
+	// hardware of the D3D11 era.
+	static const unsigned int AnalyzeCacheSize = 16;
+
+	enum Pass
+	{
+		PassVertexCache = 1,
+		PassOverdraw    = 2,
+		PassVertexFetch = 4
+	};
+
+	// Runs the given passes over indices, in place, measuring ACMR and
+	// overfetch after each:
+	//   -the vertex cache order is kept if it lowers ACMR and, once the
+	//    vertices are renumbered or not (whichever fetches less), overfetch
+	//    does not rise;
+	//   -the overdraw clustering trades some vertex cache misses for less
+	//    overdraw, so it is only run when asked for, needs positions (read as
+	//    for OptimizeOverdraw), and is kept if it lowers overdraw, leaves ACMR
+	//    within its threshold of what it was and overfetch no higher;
+	//   -the vertex fetch order is kept if it lowers overfetch.
+	// remap[old vertex] receives the new index of each vertex, in the order
+	// the indices are rewritten in; it is the identity unless PassVertexFetch
+	// was kept.  remap may be null if PassVertexFetch is not asked for.
+	// vertexSize is the size of the vertex the GPU fetches.  Returns the
+	// passes kept.
+	static unsigned int Optimize(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount,
+		unsigned int vertexSize, unsigned int* remap, unsigned int passes = PassVertexCache | PassVertexFetch,
+		const float* positions = 0, unsigned int vertexStride = 0);
+
+	// Writes the triangles of indices to destination in vertex cache order.
+	// Triangles keep their winding.  destination may be indices.
+	static void OptimizeVertexCache(unsigned int* destination, const unsigned int* indices,
+		unsigned int indexCount, unsigned int vertexCount);
+
+	// Reorders the clusters of a list already in vertex cache order to draw
+	// those facing out first.  A cluster is also cut wherever its cache misses
+	// per triangle so far are within threshold times those of the whole
+	// cluster, so a larger threshold trades vertex cache misses for smaller
+	// clusters to sort.  The position of vertex i is read from
+	// (const char*)positions + i*vertexStride.  destination may be indices.
+	static void OptimizeOverdraw(unsigned int* destination, const unsigned int* indices,
+		unsigned int indexCount, const float* positions, unsigned int vertexCount,
+		unsigned int vertexStride, float threshold = 1.05f);
+
+	// Fills remap[old vertex] with its new index, in the order the indices first
+	// use them.  Unused vertices go after the used ones, in their old order, so
+	// none is lost.  Returns the number of vertices used.
+	static unsigned int OptimizeVertexFetch(unsigned int* remap, const unsigned int* indices,
+		unsigned int indexCount, unsigned int vertexCount);
+
+	// Apply a remap.  destination may be indices, but not vertices.
+	static void RemapIndices(unsigned int* destination, const unsigned int* indices,
+		unsigned int indexCount, const unsigned int* remap);
+	static void RemapVertices(void* destination, const void* vertices, unsigned int vertexCount,
+		unsigned int vertexSize, const unsigned int* remap);
+
+	static VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, unsigned int indexCount,
+		unsigned int vertexCount, unsigned int cacheSize = AnalyzeCacheSize);
+
+	// Vertices missing the vertex cache are read in 64 byte lines through a
+	// 16 KB direct mapped cache.
+	static VertexFetchStats AnalyzeVertexFetch(const unsigned int* indices, unsigned int indexCount,
+		unsigned int vertexCount, unsigned int vertexSize);
+
+	// Draws the mesh from the six axis directions at 256x256 with back faces
+	// culled (clockwise is front, as in Direct3D) and sums the pixels.
+	static OverdrawStats AnalyzeOverdraw(const unsigned int* indices, unsigned int indexCount,
+		const float* positions, unsigned int vertexStride);
+};
+
+#endif // MESHOPTIMIZER_H
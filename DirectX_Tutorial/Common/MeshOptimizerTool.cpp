@@ -0,0 +1,508 @@
+//***************************************************************************************
+// MeshOptimizerTool.cpp
+//
+// Offline tool that runs the MeshOptimizer passes over the models of the demos:
+// the "VertexCount/TriangleCount" text models (skull.txt, car.txt) and the .m3d
+// models.  The triangles of each .m3d subset are reordered among themselves and
+// its vertices stay in its vertex range, so the subset table holds.  For each
+// model it reports, before and after,
+//   -vertex shader runs per triangle and per vertex used (ACMR and ATVR)
+//    through a 16 entry FIFO cache,
+//   -bytes read from the vertex buffer over the bytes of the vertices, for the
+//    vertex the demos build from the model (Vertex::Basic32 for text models,
+//    the 64 byte skinned vertex for .m3d),
+//   -pixels shaded per pixel covered, drawn from the six axis directions,
+// the passes MeshOptimizer::Optimize kept for any subset (c for the vertex
+// cache, o for overdraw and f for vertex fetch order), and the milliseconds
+// the passes took.  Overdraw clustering only runs with -overdraw.
+//
+// Vertices are renumbered within the vertex range of each subset, unless a
+// subset uses vertices outside its own range; then they are renumbered over
+// the whole model, after the triangles of every subset are in place.
+//
+// The optimized model must hold the same triangles, with the same winding and
+// the same vertex text, as the original.  Returns 1 if any model fails that or
+// cannot be read.  With -w the models are written back in place, vertex and
+// triangle lines moved and nothing else touched; the loaders need no change.
+//
+// Build with:
+//   cl /EHsc /O2 /std:c++17 MeshOptimizer.cpp MeshOptimizerTool.cpp
+//
+// Usage: MeshOptimizerTool [-w] [-overdraw] [path ...]      (default ..)
+//        A directory is searched for .txt and .m3d files in Models directories.
+//***************************************************************************************
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "MeshOptimizer.h"
+
+namespace
+{
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	struct Subset
+	{
+		unsigned int VertexStart;
+		unsigned int VertexCount;
+		unsigned int FaceStart;
+		unsigned int FaceCount;
+	};
+
+	// A model as the lines of its file, with where its vertices and triangles
+	// are and what they hold.
+	struct Model
+	{
+		std::vector<std::string> Lines;
+
+		// Vertex v is LinesPerVertex lines from FirstVertexLine + v*VertexLineStride.
+		size_t FirstVertexLine;
+		unsigned int LinesPerVertex;
+		unsigned int VertexLineStride;
+
+		// Triangle t is the line FirstTriangleLine + t, as Indent "i0 i1 i2".
+		size_t FirstTriangleLine;
+		std::string Indent;
+
+		std::vector<float> Positions;
+		std::vector<unsigned int> Indices;
+		std::vector<Subset> Subsets;
+
+		unsigned int VertexSize;
+	};
+
+	bool ReadLines(const std::filesystem::path& path, std::vector<std::string>& lines)
+	{
+		std::ifstream fin(path, std::ios::binary);
+		if( !fin )
+			return false;
+
+		std::stringstream buffer;
+		buffer << fin.rdbuf();
+		std::string text = buffer.str();
+
+		// Split on '\n' only, so that joining with '\n' gives the file back.
+		lines.clear();
+		size_t start = 0;
+		for(;;)
+		{
+			size_t end = text.find('\n', start);
+			if( end == std::string::npos )
+			{
+				lines.push_back(text.substr(start));
+				return true;
+			}
+			lines.push_back(text.substr(start, end - start));
+			start = end + 1;
+		}
+	}
+
+	bool StartsWith(const std::string& line, const char* prefix)
+	{
+		return line.compare(0, strlen(prefix), prefix) == 0;
+	}
+
+	// The number after the label of a "Label: n" line.
+	bool ReadCount(const std::string& line, const char* label, unsigned int& count)
+	{
+		if( !StartsWith(line, label) )
+			return false;
+
+		std::istringstream in(line.substr(strlen(label)));
+		return !!(in >> count);
+	}
+
+	size_t FindLine(const std::vector<std::string>& lines, const char* prefix)
+	{
+		for(size_t i = 0; i < lines.size(); ++i)
+		{
+			if( StartsWith(lines[i], prefix) )
+				return i;
+		}
+		return lines.size();
+	}
+
+	bool FindCount(const std::vector<std::string>& lines, const char* label, unsigned int& count)
+	{
+		size_t line = FindLine(lines, label);
+		return line < lines.size() && ReadCount(lines[line], label, count);
+	}
+
+	bool ReadTriangles(Model& model, unsigned int triangleCount)
+	{
+		if( model.FirstTriangleLine + triangleCount > model.Lines.size() )
+			return false;
+
+		model.Indices.resize(3*triangleCount);
+		for(unsigned int t = 0; t < triangleCount; ++t)
+		{
+			std::istringstream in(model.Lines[model.FirstTriangleLine + t]);
+			if( !(in >> model.Indices[3*t] >> model.Indices[3*t + 1] >> model.Indices[3*t + 2]) )
+				return false;
+		}
+
+		const std::string& first = model.Lines[model.FirstTriangleLine];
+		model.Indent = first.substr(0, first.find_first_not_of(" \t"));
+
+		unsigned int vertexCount = (unsigned int)model.Positions.size()/3;
+		return std::all_of(model.Indices.begin(), model.Indices.end(), [=](unsigned int i) { return i < vertexCount; });
+	}
+
+	// VertexCount: n / TriangleCount: m / VertexList (pos, normal) / { ... } /
+	// TriangleList / { ... }
+	bool LoadTextModel(Model& model)
+	{
+		const std::vector<std::string>& lines = model.Lines;
+
+		unsigned int vertexCount = 0;
+		unsigned int triangleCount = 0;
+		if( lines.size() < 4 || !ReadCount(lines[0], "VertexCount:", vertexCount) ||
+			!ReadCount(lines[1], "TriangleCount:", triangleCount) || !StartsWith(lines[2], "VertexList") )
+			return false;
+
+		model.FirstVertexLine = 4;
+		model.LinesPerVertex = 1;
+		model.VertexLineStride = 1;
+		model.VertexSize = 32;
+
+		if( model.FirstVertexLine + vertexCount + 3 > lines.size() ||
+			!StartsWith(lines[model.FirstVertexLine + vertexCount + 1], "TriangleList") )
+			return false;
+
+		model.Positions.resize(3*vertexCount);
+		for(unsigned int v = 0; v < vertexCount; ++v)
+		{
+			std::istringstream in(lines[model.FirstVertexLine + v]);
+			if( !(in >> model.Positions[3*v] >> model.Positions[3*v + 1] >> model.Positions[3*v + 2]) )
+				return false;
+		}
+
+		Subset all = { 0, vertexCount, 0, triangleCount };
+		model.Subsets.push_back(all);
+
+		model.FirstTriangleLine = model.FirstVertexLine + vertexCount + 3;
+		return ReadTriangles(model, triangleCount);
+	}
+
+	// The text .m3d format M3DLoader reads: header counts, materials, subset
+	// table, vertices as blocks of "Label: values" lines with a blank line
+	// after each, then one triangle per line.
+	bool LoadM3dModel(Model& model)
+	{
+		const std::vector<std::string>& lines = model.Lines;
+
+		unsigned int subsetCount = 0;
+		unsigned int vertexCount = 0;
+		unsigned int triangleCount = 0;
+		if( !FindCount(lines, "#Materials", subsetCount) || !FindCount(lines, "#Vertices", vertexCount) ||
+			!FindCount(lines, "#Triangles", triangleCount) )
+			return false;
+
+		size_t subsetLine = FindLine(lines, "***************SubsetTable") + 1;
+		if( subsetLine + subsetCount > lines.size() )
+			return false;
+
+		for(unsigned int i = 0; i < subsetCount; ++i)
+		{
+			std::istringstream in(lines[subsetLine + i]);
+			std::string ignore;
+			unsigned int id = 0;
+			Subset subset;
+			if( !(in >> ignore >> id >> ignore >> subset.VertexStart >> ignore >> subset.VertexCount >>
+				ignore >> subset.FaceStart >> ignore >> subset.FaceCount) )
+				return false;
+			model.Subsets.push_back(subset);
+		}
+
+		model.FirstVertexLine = FindLine(lines, "***************Vertices") + 1;
+		model.LinesPerVertex = 0;
+		while( model.FirstVertexLine + model.LinesPerVertex < lines.size() &&
+			!lines[model.FirstVertexLine + model.LinesPerVertex].empty() )
+			++model.LinesPerVertex;
+		model.VertexLineStride = model.LinesPerVertex + 1;
+		model.VertexSize = 64;
+
+		if( model.LinesPerVertex == 0 || model.FirstVertexLine + (size_t)vertexCount*model.VertexLineStride > lines.size() )
+			return false;
+
+		model.Positions.resize(3*vertexCount);
+		for(unsigned int v = 0; v < vertexCount; ++v)
+		{
+			std::istringstream in(lines[model.FirstVertexLine + (size_t)v*model.VertexLineStride]);
+			std::string label;
+			if( !(in >> label >> model.Positions[3*v] >> model.Positions[3*v + 1] >> model.Positions[3*v + 2]) ||
+				label != "Position:" )
+				return false;
+		}
+
+		model.FirstTriangleLine = FindLine(lines, "***************Triangles") + 1;
+		return ReadTriangles(model, triangleCount);
+	}
+
+	struct Stats
+	{
+		VertexCacheStats Cache;
+		VertexFetchStats Fetch;
+		OverdrawStats Overdraw;
+	};
+
+	Stats Analyze(const Model& model, const std::vector<unsigned int>& indices, const std::vector<float>& positions)
+	{
+		unsigned int vertexCount = (unsigned int)positions.size()/3;
+
+		Stats stats;
+		stats.Cache = MeshOptimizer::AnalyzeVertexCache(&indices[0], (unsigned int)indices.size(), vertexCount);
+		stats.Fetch = MeshOptimizer::AnalyzeVertexFetch(&indices[0], (unsigned int)indices.size(), vertexCount,
+			model.VertexSize);
+		stats.Overdraw = MeshOptimizer::AnalyzeOverdraw(&indices[0], (unsigned int)indices.size(), &positions[0],
+			3*sizeof(float));
+		return stats;
+	}
+
+	// Runs the passes over every subset.  Fills remap[old vertex] with its new
+	// index and writes the new indices, in the new numbering.  Returns the
+	// passes kept for any subset.
+	unsigned int Optimize(const Model& model, unsigned int passes, std::vector<unsigned int>& indices,
+						  std::vector<unsigned int>& remap, bool& sharedVertices)
+	{
+		unsigned int vertexCount = (unsigned int)model.Positions.size()/3;
+		indices = model.Indices;
+
+		sharedVertices = false;
+		for(size_t s = 0; s < model.Subsets.size(); ++s)
+		{
+			const Subset& subset = model.Subsets[s];
+			for(unsigned int i = 3*subset.FaceStart; i < 3*(subset.FaceStart + subset.FaceCount); ++i)
+			{
+				if( indices[i] < subset.VertexStart || indices[i] >= subset.VertexStart + subset.VertexCount )
+					sharedVertices = true;
+			}
+		}
+
+		remap.resize(vertexCount);
+		for(unsigned int v = 0; v < vertexCount; ++v)
+			remap[v] = v;
+
+		unsigned int kept = 0;
+		for(size_t s = 0; s < model.Subsets.size(); ++s)
+		{
+			const Subset& subset = model.Subsets[s];
+			unsigned int* faces = &indices[3*subset.FaceStart];
+			unsigned int indexCount = 3*subset.FaceCount;
+			if( indexCount == 0 )
+				continue;
+
+			if( sharedVertices )
+			{
+				kept |= MeshOptimizer::Optimize(faces, indexCount, vertexCount, model.VertexSize, 0,
+					passes & ~MeshOptimizer::PassVertexFetch, &model.Positions[0], 3*sizeof(float));
+				continue;
+			}
+
+			// The subset's vertex range on its own.
+			for(unsigned int i = 0; i < indexCount; ++i)
+				faces[i] -= subset.VertexStart;
+
+			std::vector<unsigned int> localRemap(subset.VertexCount);
+			kept |= MeshOptimizer::Optimize(faces, indexCount, subset.VertexCount, model.VertexSize, &localRemap[0],
+				passes, &model.Positions[3*subset.VertexStart], 3*sizeof(float));
+
+			for(unsigned int i = 0; i < indexCount; ++i)
+				faces[i] += subset.VertexStart;
+			for(unsigned int v = 0; v < subset.VertexCount; ++v)
+				remap[subset.VertexStart + v] = subset.VertexStart + localRemap[v];
+		}
+
+		if( sharedVertices )
+		{
+			kept |= MeshOptimizer::Optimize(&indices[0], (unsigned int)indices.size(), vertexCount, model.VertexSize,
+				&remap[0], passes & MeshOptimizer::PassVertexFetch);
+		}
+		return kept;
+	}
+
+	typedef std::vector<std::vector<unsigned long long>> TriangleList;
+
+	// The triangles of each subset by their original vertex indices, 21 bits
+	// each, sorted.
+	TriangleList SortedTriangles(const Model& model, const std::vector<unsigned int>& indices,
+								 const std::vector<unsigned int>& toOriginal)
+	{
+		TriangleList subsets;
+		for(size_t s = 0; s < model.Subsets.size(); ++s)
+		{
+			const Subset& subset = model.Subsets[s];
+			subsets.push_back(std::vector<unsigned long long>());
+			std::vector<unsigned long long>& triangles = subsets.back();
+			for(unsigned int t = subset.FaceStart; t < subset.FaceStart + subset.FaceCount; ++t)
+			{
+				unsigned long long a = toOriginal[indices[3*t]];
+				unsigned long long b = toOriginal[indices[3*t + 1]];
+				unsigned long long c = toOriginal[indices[3*t + 2]];
+				triangles.push_back(a << 42 | b << 21 | c);
+			}
+			std::sort(triangles.begin(), triangles.end());
+		}
+		return subsets;
+	}
+
+	bool Write(const std::filesystem::path& path, const Model& model, const std::vector<unsigned int>& indices,
+			   const std::vector<unsigned int>& remap)
+	{
+		std::vector<std::string> lines = model.Lines;
+		unsigned int vertexCount = (unsigned int)remap.size();
+
+		for(unsigned int v = 0; v < vertexCount; ++v)
+		{
+			for(unsigned int k = 0; k < model.LinesPerVertex; ++k)
+			{
+				lines[model.FirstVertexLine + (size_t)remap[v]*model.VertexLineStride + k] =
+					model.Lines[model.FirstVertexLine + (size_t)v*model.VertexLineStride + k];
+			}
+		}
+
+		for(size_t t = 0; t < indices.size()/3; ++t)
+		{
+			// Keep a '\r' the line ended with.
+			std::string& line = lines[model.FirstTriangleLine + t];
+			bool carriageReturn = !line.empty() && line[line.size() - 1] == '\r';
+
+			line = model.Indent + std::to_string(indices[3*t]) + " " + std::to_string(indices[3*t + 1]) + " " +
+				std::to_string(indices[3*t + 2]) + (carriageReturn ? "\r" : "");
+		}
+
+		std::ofstream fout(path, std::ios::binary);
+		for(size_t i = 0; i < lines.size(); ++i)
+		{
+			if( i > 0 )
+				fout << '\n';
+			fout << lines[i];
+		}
+		return !fout.fail();
+	}
+
+	void FindModels(const std::filesystem::path& path, std::vector<std::filesystem::path>& models)
+	{
+		if( !std::filesystem::is_directory(path) )
+		{
+			models.push_back(path);
+			return;
+		}
+
+		std::vector<std::filesystem::path> found;
+		for(auto& entry : std::filesystem::recursive_directory_iterator(path))
+		{
+			const std::filesystem::path& file = entry.path();
+			if( entry.is_regular_file() && file.parent_path().filename() == "Models" &&
+				(file.extension() == ".txt" || file.extension() == ".m3d") )
+				found.push_back(file);
+		}
+		std::sort(found.begin(), found.end());
+		models.insert(models.end(), found.begin(), found.end());
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	bool write = false;
+	unsigned int passes = MeshOptimizer::PassVertexCache | MeshOptimizer::PassVertexFetch;
+	bool pathGiven = false;
+	std::vector<std::filesystem::path> models;
+	for(int i = 1; i < argc; ++i)
+	{
+		if( strcmp(argv[i], "-w") == 0 )
+			write = true;
+		else if( strcmp(argv[i], "-overdraw") == 0 )
+			passes |= MeshOptimizer::PassOverdraw;
+		else
+		{
+			FindModels(argv[i], models);
+			pathGiven = true;
+		}
+	}
+	if( !pathGiven )
+		FindModels("..", models);
+
+	printf("%-56s %8s %8s | %13s %13s %13s %13s %6s %8s\n", "model", "vertices", "tris",
+		"acmr", "atvr", "overfetch", "overdraw", "passes", "ms");
+
+	bool passed = true;
+
+	for(size_t m = 0; m < models.size(); ++m)
+	{
+		const std::filesystem::path& path = models[m];
+		std::string name = path.generic_string();
+		if( name.size() > 56 )
+			name = "..." + name.substr(name.size() - 53);
+
+		Model model;
+		bool loaded = ReadLines(path, model.Lines) &&
+			(path.extension() == ".m3d" ? LoadM3dModel(model) : LoadTextModel(model));
+		if( !loaded || model.Indices.empty() )
+		{
+			printf("%-56s cannot read\n", name.c_str());
+			passed = false;
+			continue;
+		}
+
+		unsigned int vertexCount = (unsigned int)model.Positions.size()/3;
+		Stats before = Analyze(model, model.Indices, model.Positions);
+
+		std::vector<unsigned int> indices, remap;
+		bool sharedVertices = false;
+		double start = Now();
+		unsigned int kept = Optimize(model, passes, indices, remap, sharedVertices);
+		double time = Now() - start;
+
+		char keptPasses[4] = "-";
+		char* pass = keptPasses;
+		if( kept & MeshOptimizer::PassVertexCache )
+			*pass++ = 'c';
+		if( kept & MeshOptimizer::PassOverdraw )
+			*pass++ = 'o';
+		if( kept & MeshOptimizer::PassVertexFetch )
+			*pass++ = 'f';
+		if( pass != keptPasses )
+			*pass = '\0';
+
+		std::vector<float> positions(model.Positions.size());
+		MeshOptimizer::RemapVertices(&positions[0], &model.Positions[0], vertexCount, 3*sizeof(float), &remap[0]);
+		Stats after = Analyze(model, indices, positions);
+
+		std::vector<unsigned int> toOriginal(vertexCount), identity(vertexCount);
+		for(unsigned int v = 0; v < vertexCount; ++v)
+		{
+			toOriginal[remap[v]] = v;
+			identity[v] = v;
+		}
+
+		bool same = SortedTriangles(model, indices, toOriginal) == SortedTriangles(model, model.Indices, identity);
+		if( !same )
+			passed = false;
+
+		printf("%-56s %8u %8u | %6.3f %6.3f %6.3f %6.3f %6.3f %6.3f %6.3f %6.3f %6s %8.1f%s%s\n", name.c_str(),
+			vertexCount, (unsigned int)model.Indices.size()/3,
+			before.Cache.Acmr, after.Cache.Acmr, before.Cache.Atvr, after.Cache.Atvr,
+			before.Fetch.Overfetch, after.Fetch.Overfetch, before.Overdraw.Overdraw, after.Overdraw.Overdraw,
+			keptPasses, time*1000.0, sharedVertices ? "  shared vertices" : "", same ? "" : "  differs");
+
+		if( write && same && !Write(path, model, indices, remap) )
+		{
+			printf("%-56s cannot write\n", name.c_str());
+			passed = false;
+		}
+	}
+
+	printf("\n%s\n", passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,736 @@
+//***************************************************************************************
+// MeshSimplifier.cpp
+//***************************************************************************************
+
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const unsigned int NoVertex = 0xffffffff;
+
+	struct Collapse
+	{
+		unsigned int From;
+		unsigned int To;
+		float Error;
+
+		bool operator<(const Collapse& rhs)const
+		{
+			if( Error != rhs.Error )
+				return Error < rhs.Error;
+			return From != rhs.From ? From < rhs.From : To < rhs.To;
+		}
+	};
+
+	void Subtract(const float* a, const float* b, float* result)
+	{
+		result[0] = a[0] - b[0];
+		result[1] = a[1] - b[1];
+		result[2] = a[2] - b[2];
+	}
+
+	void Cross(const float* a, const float* b, float* result)
+	{
+		result[0] = a[1]*b[2] - a[2]*b[1];
+		result[1] = a[2]*b[0] - a[0]*b[2];
+		result[2] = a[0]*b[1] - a[1]*b[0];
+	}
+
+	float Dot(const float* a, const float* b)
+	{
+		return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+	}
+
+	void TriangleNormal(const float* p0, const float* p1, const float* p2, float* normal)
+	{
+		float e0[3], e1[3];
+		Subtract(p1, p0, e0);
+		Subtract(p2, p0, e1);
+		Cross(e0, e1, normal);
+	}
+
+	float Distance(const float* a, const float* b)
+	{
+		float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+		return sqrtf(dx*dx + dy*dy + dz*dz);
+	}
+
+	// The distance from p to the triangle abc (Ericson, Real-Time Collision
+	// Detection, 5.1.5).
+	float DistanceToTriangle(const float* p, const float* a, const float* b, const float* c)
+	{
+		float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float ap[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+
+		float d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+		if( d1 <= 0.0f && d2 <= 0.0f )
+			return Distance(p, a);
+
+		float bp[3] = { p[0] - b[0], p[1] - b[1], p[2] - b[2] };
+		float d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+		if( d3 >= 0.0f && d4 <= d3 )
+			return Distance(p, b);
+
+		float cp[3] = { p[0] - c[0], p[1] - c[1], p[2] - c[2] };
+		float d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+		if( d6 >= 0.0f && d5 <= d6 )
+			return Distance(p, c);
+
+		float v, w;
+		float vc = d1*d4 - d3*d2;
+		float vb = d5*d2 - d1*d6;
+		float va = d3*d6 - d5*d4;
+		if( vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f )
+		{
+			v = d1/(d1 - d3);
+			w = 0.0f;
+		}
+		else if( vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f )
+		{
+			v = 0.0f;
+			w = d2/(d2 - d6);
+		}
+		else if( va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f )
+		{
+			w = (d4 - d3)/((d4 - d3) + (d5 - d6));
+			v = 1.0f - w;
+		}
+		else
+		{
+			float denom = 1.0f/(va + vb + vc);
+			v = vb*denom;
+			w = vc*denom;
+		}
+
+		float q[3];
+		for(unsigned int k = 0; k < 3; ++k)
+			q[k] = a[k] + ab[k]*v + ac[k]*w;
+		return Distance(p, q);
+	}
+}
+
+MeshSimplifier::MeshSimplifier(const float* positions, unsigned int vertexCount, unsigned int vertexStride,
+	const unsigned int* indices, unsigned int indexCount, const unsigned int* triangleSubsets)
+	: mError(0.0f)
+{
+	unsigned int triangleCount = indexCount/3;
+
+	mPositions.resize(3*vertexCount);
+	for(unsigned int i = 0; i < vertexCount; ++i)
+		memcpy(&mPositions[3*i], (const char*)positions + (size_t)i*vertexStride, 3*sizeof(float));
+
+	mIndices.assign(indices, indices + 3*triangleCount);
+	mTriangleSources.resize(triangleCount);
+	for(unsigned int t = 0; t < triangleCount; ++t)
+		mTriangleSources[t] = t;
+
+	//
+	// Group the vertices by position.
+	//
+
+	mGroupVertices.resize(vertexCount);
+	for(unsigned int i = 0; i < vertexCount; ++i)
+		mGroupVertices[i] = i;
+
+	const float* p = vertexCount > 0 ? &mPositions[0] : 0;
+	std::sort(mGroupVertices.begin(), mGroupVertices.end(), [p](unsigned int a, unsigned int b)
+	{
+		const float* pa = p + 3*a;
+		const float* pb = p + 3*b;
+		if( pa[0] != pb[0] ) return pa[0] < pb[0];
+		if( pa[1] != pb[1] ) return pa[1] < pb[1];
+		if( pa[2] != pb[2] ) return pa[2] < pb[2];
+		return a < b;
+	});
+
+	mGroups.resize(vertexCount);
+	mGroupStart.clear();
+	for(unsigned int k = 0; k < vertexCount; ++k)
+	{
+		unsigned int v = mGroupVertices[k];
+		if( k == 0 || memcmp(p + 3*v, p + 3*mGroupVertices[k-1], 3*sizeof(float)) != 0 )
+			mGroupStart.push_back(k);
+		mGroups[v] = (unsigned int)mGroupStart.size() - 1;
+	}
+	unsigned int groupCount = (unsigned int)mGroupStart.size();
+	mGroupStart.push_back(vertexCount);
+
+	// Each vertex drawn by the full mesh is measured against the triangles
+	// around the group it has been collapsed into; at first it is on them.
+	mVertexGroups.assign(vertexCount, NoVertex);
+	for(unsigned int i = 0; i < mIndices.size(); ++i)
+		mVertexGroups[mIndices[i]] = mGroups[mIndices[i]];
+	mDistances.assign(vertexCount, 0.0f);
+
+	//
+	// Find the open edges: those not shared by exactly two triangles, or shared
+	// by triangles of different subsets.
+	//
+
+	std::vector<unsigned long long> edges;
+	edges.reserve(mIndices.size());
+	for(unsigned int i = 0; i < mIndices.size(); ++i)
+	{
+		unsigned long long a = mIndices[i];
+		unsigned long long b = mIndices[i - i%3 + (i+1)%3];
+		if( a != b )
+			edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+	}
+	std::sort(edges.begin(), edges.end());
+
+	std::vector<unsigned long long> openEdges;
+	for(size_t i = 0; i < edges.size(); )
+	{
+		size_t j = i + 1;
+		while( j < edges.size() && edges[j] == edges[i] )
+			++j;
+		if( j - i != 2 )
+			openEdges.push_back(edges[i]);
+		i = j;
+	}
+
+	if( triangleSubsets )
+	{
+		// An edge is between subsets if its two triangles are in different ones.
+		std::vector<std::pair<unsigned long long, unsigned int> > edgeSubsets;
+		edgeSubsets.reserve(mIndices.size());
+		for(unsigned int i = 0; i < mIndices.size(); ++i)
+		{
+			unsigned long long a = mIndices[i];
+			unsigned long long b = mIndices[i - i%3 + (i+1)%3];
+			if( a != b )
+				edgeSubsets.push_back(std::make_pair(std::min(a, b) << 32 | std::max(a, b), triangleSubsets[i/3]));
+		}
+		std::sort(edgeSubsets.begin(), edgeSubsets.end());
+
+		for(size_t i = 1; i < edgeSubsets.size(); ++i)
+		{
+			if( edgeSubsets[i].first == edgeSubsets[i-1].first && edgeSubsets[i].second != edgeSubsets[i-1].second )
+				openEdges.push_back(edgeSubsets[i].first);
+		}
+		std::sort(openEdges.begin(), openEdges.end());
+		openEdges.erase(std::unique(openEdges.begin(), openEdges.end()), openEdges.end());
+	}
+
+	std::vector<unsigned int> openEdgeCounts(vertexCount, 0);
+	mOpenNeighbors.assign(2*vertexCount, NoVertex);
+	for(size_t i = 0; i < openEdges.size(); ++i)
+	{
+		unsigned int a = (unsigned int)(openEdges[i] >> 32);
+		unsigned int b = (unsigned int)openEdges[i];
+		if( openEdgeCounts[a] < 2 )
+			mOpenNeighbors[2*a + openEdgeCounts[a]] = b;
+		if( openEdgeCounts[b] < 2 )
+			mOpenNeighbors[2*b + openEdgeCounts[b]] = a;
+		++openEdgeCounts[a];
+		++openEdgeCounts[b];
+	}
+
+	//
+	// A group lies on a border, seam or subset boundary if its vertices have
+	// open edges.  It can slide along it if each has exactly two, and they all
+	// lead to the same two groups, one on each side, or if it is the one vertex
+	// at the tip of a seam, where both lead to the same group.
+	//
+
+	mKinds.resize(vertexCount);
+	std::vector<unsigned int> neighborGroups;
+	for(unsigned int g = 0; g < groupCount; ++g)
+	{
+		bool open = false;
+		bool closed = false;
+		bool locked = false;
+		neighborGroups.clear();
+
+		for(unsigned int k = mGroupStart[g]; k < mGroupStart[g+1]; ++k)
+		{
+			unsigned int v = mGroupVertices[k];
+			if( openEdgeCounts[v] == 0 )
+			{
+				closed = true;
+			}
+			else if( openEdgeCounts[v] == 2 )
+			{
+				open = true;
+				neighborGroups.push_back(mGroups[mOpenNeighbors[2*v]]);
+				neighborGroups.push_back(mGroups[mOpenNeighbors[2*v + 1]]);
+			}
+			else
+			{
+				locked = true;
+			}
+		}
+
+		std::sort(neighborGroups.begin(), neighborGroups.end());
+		neighborGroups.erase(std::unique(neighborGroups.begin(), neighborGroups.end()), neighborGroups.end());
+		bool tip = neighborGroups.size() == 1 && mGroupStart[g+1] - mGroupStart[g] == 1;
+		if( open && (closed || (neighborGroups.size() != 2 && !tip) ||
+			std::find(neighborGroups.begin(), neighborGroups.end(), g) != neighborGroups.end()) )
+			locked = true;
+
+		unsigned char kind = locked ? Locked : (open ? Border : Interior);
+		for(unsigned int k = mGroupStart[g]; k < mGroupStart[g+1]; ++k)
+			mKinds[mGroupVertices[k]] = kind;
+	}
+
+	//
+	// Sum the planes of the triangles around each group, weighted by area, and
+	// along open edges a plane at right angles to the triangle, so a collapse
+	// that moves the edge costs too.
+	//
+
+	Quadric zero = {};
+	mQuadrics.assign(groupCount, zero);
+	for(unsigned int t = 0; t < triangleCount; ++t)
+	{
+		const float* p0 = GetPosition(mIndices[3*t]);
+		const float* p1 = GetPosition(mIndices[3*t + 1]);
+		const float* p2 = GetPosition(mIndices[3*t + 2]);
+
+		float normal[3];
+		TriangleNormal(p0, p1, p2, normal);
+		float length = sqrtf(Dot(normal, normal));
+		if( length == 0.0f )
+			continue;
+
+		float unitNormal[3] = { normal[0]/length, normal[1]/length, normal[2]/length };
+		for(unsigned int k = 0; k < 3; ++k)
+			AddPlane(mQuadrics[mGroups[mIndices[3*t + k]]], p0, unitNormal, 0.5*length);
+
+		for(unsigned int k = 0; k < 3; ++k)
+		{
+			unsigned long long a = mIndices[3*t + k];
+			unsigned long long b = mIndices[3*t + (k+1)%3];
+			if( a == b || !std::binary_search(openEdges.begin(), openEdges.end(), std::min(a, b) << 32 | std::max(a, b)) )
+				continue;
+
+			const float* pa = GetPosition((unsigned int)a);
+			float edge[3], side[3];
+			Subtract(GetPosition((unsigned int)b), pa, edge);
+			Cross(edge, unitNormal, side);
+			float sideLength = sqrtf(Dot(side, side));
+			if( sideLength == 0.0f )
+				continue;
+
+			float unitSide[3] = { side[0]/sideLength, side[1]/sideLength, side[2]/sideLength };
+			double weight = Dot(edge, edge);
+			AddPlane(mQuadrics[mGroups[a]], pa, unitSide, weight);
+			AddPlane(mQuadrics[mGroups[b]], pa, unitSide, weight);
+		}
+	}
+}
+
+unsigned int MeshSimplifier::Simplify(unsigned int targetIndexCount, float maxError)
+{
+	unsigned int vertexCount = (unsigned int)mGroups.size();
+	unsigned int groupCount = (unsigned int)mQuadrics.size();
+
+	std::vector<unsigned int> triangleStart(vertexCount + 1);
+	std::vector<unsigned int> vertexTriangles;
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<unsigned char> touched(groupCount);
+	std::vector<unsigned char> changed(groupCount);
+	std::vector<unsigned int> groupTargets(groupCount);
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> targets;
+
+	// Each pass collapses edges that do not touch each other, cheapest first,
+	// then rebuilds the triangles.
+	while( mIndices.size() > targetIndexCount )
+	{
+		unsigned int triangleCount = (unsigned int)mIndices.size()/3;
+
+		// The triangles around each vertex.
+		std::fill(triangleStart.begin(), triangleStart.end(), 0);
+		for(size_t i = 0; i < mIndices.size(); ++i)
+			++triangleStart[mIndices[i] + 1];
+		for(unsigned int v = 0; v < vertexCount; ++v)
+			triangleStart[v+1] += triangleStart[v];
+
+		vertexTriangles.resize(mIndices.size());
+		for(size_t i = 0; i < mIndices.size(); ++i)
+			vertexTriangles[triangleStart[mIndices[i]]++] = (unsigned int)(i/3);
+		for(unsigned int v = vertexCount; v > 0; --v)
+			triangleStart[v] = triangleStart[v-1];
+		triangleStart[0] = 0;
+
+		// Both directions of every edge a vertex is allowed to collapse along.
+		collapses.clear();
+		for(size_t i = 0; i < mIndices.size(); ++i)
+		{
+			unsigned int a = mIndices[i];
+			unsigned int b = mIndices[i - i%3 + (i+1)%3];
+			if( mGroups[a] == mGroups[b] )
+				continue;
+
+			for(unsigned int direction = 0; direction < 2; ++direction)
+			{
+				unsigned int from = direction == 0 ? a : b;
+				unsigned int to = direction == 0 ? b : a;
+
+				if( mKinds[from] == Locked ||
+					(mKinds[from] == Border && mOpenNeighbors[2*from] != to && mOpenNeighbors[2*from + 1] != to) )
+					continue;
+
+				Collapse collapse = { from, to, CollapseError(from, to) };
+				collapses.push_back(collapse);
+			}
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		// Most collapses take two triangles away.
+		unsigned int triangleGoal = triangleCount - targetIndexCount/3;
+		unsigned int collapseGoal = std::max(1u, triangleGoal/2);
+		unsigned int collapseCount = 0;
+
+		std::fill(touched.begin(), touched.end(), 0);
+		for(unsigned int v = 0; v < vertexCount; ++v)
+			remap[v] = v;
+		for(unsigned int g = 0; g < groupCount; ++g)
+			groupTargets[g] = g;
+
+		for(size_t c = 0; c < collapses.size() && collapseCount < collapseGoal; ++c)
+		{
+			const Collapse& collapse = collapses[c];
+			if( collapse.Error > maxError )
+				break;
+
+			unsigned int fromGroup = mGroups[collapse.From];
+			unsigned int toGroup = mGroups[collapse.To];
+			if( touched[fromGroup] || touched[toGroup] ||
+				!CanCollapse(collapse.From, collapse.To, triangleStart, vertexTriangles, targets) )
+				continue;
+
+			// The triangles around the group change, so nothing else in this
+			// pass may collapse onto or out of them.
+			for(unsigned int k = mGroupStart[fromGroup]; k < mGroupStart[fromGroup+1]; ++k)
+			{
+				unsigned int u = mGroupVertices[k];
+				if( targets[k - mGroupStart[fromGroup]] != NoVertex )
+					remap[u] = targets[k - mGroupStart[fromGroup]];
+
+				for(unsigned int i = triangleStart[u]; i < triangleStart[u+1]; ++i)
+				{
+					const unsigned int* triangle = &mIndices[3*vertexTriangles[i]];
+					touched[mGroups[triangle[0]]] = 1;
+					touched[mGroups[triangle[1]]] = 1;
+					touched[mGroups[triangle[2]]] = 1;
+				}
+			}
+			touched[toGroup] = 1;
+			groupTargets[fromGroup] = toGroup;
+
+			Quadric& q = mQuadrics[toGroup];
+			const Quadric& r = mQuadrics[fromGroup];
+			q.A00 += r.A00; q.A01 += r.A01; q.A02 += r.A02;
+			q.A11 += r.A11; q.A12 += r.A12; q.A22 += r.A22;
+			q.B0 += r.B0; q.B1 += r.B1; q.B2 += r.B2;
+			q.C += r.C;
+			q.Weight += r.Weight;
+
+			++collapseCount;
+		}
+
+		if( collapseCount == 0 )
+			break;
+
+		// The groups whose triangles, or those of a group next to them, changed.
+		changed = touched;
+		for(unsigned int t = 0; t < triangleCount; ++t)
+		{
+			const unsigned int* triangle = &mIndices[3*t];
+			if( touched[mGroups[triangle[0]]] || touched[mGroups[triangle[1]]] || touched[mGroups[triangle[2]]] )
+				changed[mGroups[triangle[0]]] = changed[mGroups[triangle[1]]] = changed[mGroups[triangle[2]]] = 1;
+		}
+
+		// Drop the triangles that lost a side, keeping the order of the rest.
+		// Collapsing the tip of a seam leaves triangles with two vertices at
+		// the same position; those go too.
+		unsigned int written = 0;
+		for(unsigned int t = 0; t < triangleCount; ++t)
+		{
+			unsigned int i0 = remap[mIndices[3*t]];
+			unsigned int i1 = remap[mIndices[3*t + 1]];
+			unsigned int i2 = remap[mIndices[3*t + 2]];
+			if( mGroups[i0] == mGroups[i1] || mGroups[i1] == mGroups[i2] || mGroups[i2] == mGroups[i0] )
+				continue;
+
+			mIndices[3*written] = i0;
+			mIndices[3*written + 1] = i1;
+			mIndices[3*written + 2] = i2;
+			mTriangleSources[written] = mTriangleSources[t];
+			++written;
+		}
+		mIndices.resize(3*written);
+		mTriangleSources.resize(written);
+
+		for(unsigned int v = 0; v < vertexCount; ++v)
+		{
+			if( mVertexGroups[v] != NoVertex )
+				mVertexGroups[v] = groupTargets[mVertexGroups[v]];
+		}
+		UpdateDistances(changed);
+	}
+
+	// Keep the error growing down a chain of levels.
+	if( vertexCount > 0 )
+		mError = std::max(mError, *std::max_element(mDistances.begin(), mDistances.end()));
+
+	return (unsigned int)mIndices.size();
+}
+
+const std::vector<unsigned int>& MeshSimplifier::GetIndices()const
+{
+	return mIndices;
+}
+
+const std::vector<unsigned int>& MeshSimplifier::GetTriangleSources()const
+{
+	return mTriangleSources;
+}
+
+float MeshSimplifier::GetError()const
+{
+	return mError;
+}
+
+unsigned int MeshSimplifier::GetLockedVertexCount()const
+{
+	return (unsigned int)std::count(mKinds.begin(), mKinds.end(), (unsigned char)Locked);
+}
+
+void MeshSimplifier::BuildLodChain(const float* positions, unsigned int vertexCount, unsigned int vertexStride,
+	const unsigned int* indices, unsigned int indexCount, unsigned int lodCount, float reduction,
+	std::vector<unsigned int>& lodIndices, std::vector<MeshLod>& lods)
+{
+	if( lodCount == 0 )
+		return;
+
+	MeshLod lod = { (unsigned int)lodIndices.size(), indexCount, 0.0f };
+	lodIndices.insert(lodIndices.end(), indices, indices + indexCount);
+	lods.push_back(lod);
+
+	MeshSimplifier simplifier(positions, vertexCount, vertexStride, indices, indexCount);
+	float targetTriangles = (float)(indexCount/3);
+	for(unsigned int level = 1; level < lodCount; ++level)
+	{
+		targetTriangles *= reduction;
+		simplifier.Simplify(3*(unsigned int)targetTriangles);
+
+		const std::vector<unsigned int>& levelIndices = simplifier.GetIndices();
+		lod.IndexStart = (unsigned int)lodIndices.size();
+		lod.IndexCount = (unsigned int)levelIndices.size();
+		lod.Error = simplifier.GetError();
+		lodIndices.insert(lodIndices.end(), levelIndices.begin(), levelIndices.end());
+		lods.push_back(lod);
+	}
+}
+
+float MeshSimplifier::PixelsPerUnit(float distance, float fovY, float viewportHeight)
+{
+	return viewportHeight / (2.0f*tanf(0.5f*fovY)*distance);
+}
+
+unsigned int MeshSimplifier::SelectLod(const MeshLod* lods, unsigned int lodCount, float pixelsPerUnit,
+	float maxPixelError)
+{
+	// Errors only grow down the chain.
+	unsigned int lod = 0;
+	while( lod + 1 < lodCount && lods[lod + 1].Error*pixelsPerUnit <= maxPixelError )
+		++lod;
+	return lod;
+}
+
+const float* MeshSimplifier::GetPosition(unsigned int vertex)const
+{
+	return &mPositions[3*vertex];
+}
+
+void MeshSimplifier::UpdateDistances(const std::vector<unsigned char>& changed)
+{
+	unsigned int vertexCount = (unsigned int)mGroups.size();
+	unsigned int groupCount = (unsigned int)mQuadrics.size();
+	unsigned int triangleCount = (unsigned int)mIndices.size()/3;
+
+	// The triangles around each group.  The three vertices of a triangle are
+	// in three groups.
+	std::vector<unsigned int> triangleStart(groupCount + 1, 0);
+	for(size_t i = 0; i < mIndices.size(); ++i)
+		++triangleStart[mGroups[mIndices[i]] + 1];
+	for(unsigned int g = 0; g < groupCount; ++g)
+		triangleStart[g+1] += triangleStart[g];
+
+	std::vector<unsigned int> groupTriangles(mIndices.size());
+	std::vector<unsigned int> next(triangleStart.begin(), triangleStart.end() - 1);
+	for(size_t i = 0; i < mIndices.size(); ++i)
+		groupTriangles[next[mGroups[mIndices[i]]]++] = (unsigned int)(i/3);
+
+	// The vertices of the full mesh collapsed into each group.
+	std::vector<unsigned int> vertexStart(groupCount + 1, 0);
+	for(unsigned int v = 0; v < vertexCount; ++v)
+	{
+		if( mVertexGroups[v] != NoVertex )
+			++vertexStart[mVertexGroups[v] + 1];
+	}
+	for(unsigned int g = 0; g < groupCount; ++g)
+		vertexStart[g+1] += vertexStart[g];
+
+	std::vector<unsigned int> groupVertices(vertexStart[groupCount]);
+	next.assign(vertexStart.begin(), vertexStart.end() - 1);
+	for(unsigned int v = 0; v < vertexCount; ++v)
+	{
+		if( mVertexGroups[v] != NoVertex )
+			groupVertices[next[mVertexGroups[v]]++] = v;
+	}
+
+	// A vertex is measured against the triangles around its group and around
+	// the groups next to it: the nearest of those bounds its distance to the
+	// level.  If there are none, every triangle left is searched.
+	std::vector<unsigned int> stamps(triangleCount, NoVertex);
+	std::vector<unsigned int> ring;
+	for(unsigned int g = 0; g < groupCount; ++g)
+	{
+		if( !changed[g] || vertexStart[g] == vertexStart[g+1] )
+			continue;
+
+		ring.clear();
+		for(unsigned int i = triangleStart[g]; i < triangleStart[g+1]; ++i)
+		{
+			const unsigned int* triangle = &mIndices[3*groupTriangles[i]];
+			for(unsigned int k = 0; k < 3; ++k)
+			{
+				unsigned int h = mGroups[triangle[k]];
+				for(unsigned int j = triangleStart[h]; j < triangleStart[h+1]; ++j)
+				{
+					if( stamps[groupTriangles[j]] != g )
+					{
+						stamps[groupTriangles[j]] = g;
+						ring.push_back(groupTriangles[j]);
+					}
+				}
+			}
+		}
+		if( ring.empty() )
+		{
+			for(unsigned int t = 0; t < triangleCount; ++t)
+				ring.push_back(t);
+		}
+
+		for(unsigned int k = vertexStart[g]; k < vertexStart[g+1]; ++k)
+		{
+			unsigned int v = groupVertices[k];
+			const float* p = GetPosition(v);
+			float distance = ring.empty() ? mDistances[v] : 3.402823466e+38f;
+			for(size_t i = 0; i < ring.size(); ++i)
+			{
+				const unsigned int* triangle = &mIndices[3*ring[i]];
+				distance = std::min(distance, DistanceToTriangle(p, GetPosition(triangle[0]),
+					GetPosition(triangle[1]), GetPosition(triangle[2])));
+			}
+			mDistances[v] = distance;
+		}
+	}
+}
+
+void MeshSimplifier::AddPlane(Quadric& quadric, const float* p0, const float* normal, double weight)const
+{
+	// The squared distance to the plane n.p + d = 0 is p^T(nn^T)p + 2dn.p + d^2.
+	double a = normal[0], b = normal[1], c = normal[2];
+	double d = -(a*p0[0] + b*p0[1] + c*p0[2]);
+
+	quadric.A00 += weight*a*a; quadric.A01 += weight*a*b; quadric.A02 += weight*a*c;
+	quadric.A11 += weight*b*b; quadric.A12 += weight*b*c; quadric.A22 += weight*c*c;
+	quadric.B0 += weight*a*d; quadric.B1 += weight*b*d; quadric.B2 += weight*c*d;
+	quadric.C += weight*d*d;
+	quadric.Weight += weight;
+}
+
+float MeshSimplifier::CollapseError(unsigned int from, unsigned int to)const
+{
+	const Quadric& q = mQuadrics[mGroups[from]];
+	const Quadric& r = mQuadrics[mGroups[to]];
+	const float* p = GetPosition(to);
+	double x = p[0], y = p[1], z = p[2];
+
+	double error =
+		(q.A00 + r.A00)*x*x + (q.A11 + r.A11)*y*y + (q.A22 + r.A22)*z*z +
+		2.0*((q.A01 + r.A01)*x*y + (q.A02 + r.A02)*x*z + (q.A12 + r.A12)*y*z) +
+		2.0*((q.B0 + r.B0)*x + (q.B1 + r.B1)*y + (q.B2 + r.B2)*z) + q.C + r.C;
+
+	double weight = q.Weight + r.Weight;
+	return weight > 0.0 ? (float)sqrt(std::max(error, 0.0)/weight) : 0.0f;
+}
+
+bool MeshSimplifier::CanCollapse(unsigned int from, unsigned int to, const std::vector<unsigned int>& triangleStart,
+	const std::vector<unsigned int>& vertexTriangles, std::vector<unsigned int>& targets)const
+{
+	unsigned int fromGroup = mGroups[from];
+	unsigned int toGroup = mGroups[to];
+	const float* target = GetPosition(to);
+
+	// Every vertex at the position of from must have an edge to a vertex at the
+	// position of to to collapse along, or the seam would open.
+	targets.assign(mGroupStart[fromGroup+1] - mGroupStart[fromGroup], NoVertex);
+	for(unsigned int k = mGroupStart[fromGroup]; k < mGroupStart[fromGroup+1]; ++k)
+	{
+		unsigned int u = mGroupVertices[k];
+		if( triangleStart[u] == triangleStart[u+1] )
+			continue;
+
+		unsigned int v = NoVertex;
+		if( u == from )
+		{
+			v = to;
+		}
+		else if( mKinds[u] == Border )
+		{
+			if( mGroups[mOpenNeighbors[2*u]] == toGroup )
+				v = mOpenNeighbors[2*u];
+			else if( mGroups[mOpenNeighbors[2*u + 1]] == toGroup )
+				v = mOpenNeighbors[2*u + 1];
+		}
+		else
+		{
+			for(unsigned int i = triangleStart[u]; i < triangleStart[u+1] && v == NoVertex; ++i)
+			{
+				const unsigned int* triangle = &mIndices[3*vertexTriangles[i]];
+				for(unsigned int j = 0; j < 3; ++j)
+				{
+					if( mGroups[triangle[j]] == toGroup )
+						v = triangle[j];
+				}
+			}
+		}
+		if( v == NoVertex )
+			return false;
+
+		// No triangle that stays may turn over.
+		for(unsigned int i = triangleStart[u]; i < triangleStart[u+1]; ++i)
+		{
+			const unsigned int* triangle = &mIndices[3*vertexTriangles[i]];
+			if( mGroups[triangle[0]] == toGroup || mGroups[triangle[1]] == toGroup || mGroups[triangle[2]] == toGroup )
+				continue;
+
+			const float* p[3];
+			const float* q[3];
+			for(unsigned int j = 0; j < 3; ++j)
+			{
+				p[j] = GetPosition(triangle[j]);
+				q[j] = triangle[j] == u ? target : p[j];
+			}
+
+			float before[3], after[3];
+			TriangleNormal(p[0], p[1], p[2], before);
+			TriangleNormal(q[0], q[1], q[2], after);
+			if( Dot(before, after) <= 0.0f && Dot(before, before) > 0.0f )
+				return false;
+		}
+
+		targets[k - mGroupStart[fromGroup]] = v;
+	}
+	return true;
+}
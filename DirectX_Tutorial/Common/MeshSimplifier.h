@@ -0,0 +1,137 @@
+//***************************************************************************************
+// MeshSimplifier.h
+//
+// Builds coarser versions of an indexed triangle list for drawing far away
+// objects (levels of detail), by collapsing edges in the order of the quadric
+// error metric (Garland and Heckbert).
+//   -An edge collapses one of its vertices onto the other, so the vertices and
+//    their attributes are never changed: all the levels draw from the vertex
+//    buffer of the full mesh and only the indices differ.
+//   -Vertices at the same position are collapsed together, so that seams
+//    (where a model splits vertices to give one position two normals or
+//    texture coordinates) stay closed.
+//   -Vertices on an open edge, a seam or the edge between two subsets only
+//    slide along it, and vertices where several of those meet never move, so
+//    borders and subset boundaries keep their shape.
+//   -Triangles keep their order, so the triangles of each subset stay together.
+//
+// Edges collapse cheapest first, by the root mean square distance from the
+// collapsed vertex to the planes of the triangles it and those collapsed onto
+// it had in the full mesh.  That only estimates how far a level strays, so the
+// error of a level is measured instead: the largest distance, in the units of
+// the positions, from a vertex of the full mesh to the triangles of the level.
+// Each vertex is measured against the triangles around the vertex it was
+// collapsed into and around those next to it, which bounds its distance to the
+// whole level from above, so SelectLod() can turn the error into pixels and
+// pick a level per object that strays at most that far.
+//
+// Only the C++ standard library is used, so this builds anywhere (no Windows or
+// DXUT headers); see MeshSimplifierBenchmark.cpp.
+//***************************************************************************************
+
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <vector>
+
+// A level of detail in an index buffer holding all the levels of a mesh.
+struct MeshLod
+{
+	unsigned int IndexStart;
+	unsigned int IndexCount;
+
+	// Largest distance from a vertex of the full mesh to the level, in the
+	// units of the positions; 0 for the full mesh.
+	float Error;
+};
+
+class MeshSimplifier
+{
+public:
+	// The position of vertex i is read from (const char*)positions + i*vertexStride.
+	// If triangleSubsets is given, the edges between triangles of different
+	// subsets are kept like open edges.
+	MeshSimplifier(const float* positions, unsigned int vertexCount, unsigned int vertexStride,
+		const unsigned int* indices, unsigned int indexCount, const unsigned int* triangleSubsets = 0);
+
+	// Collapses edges until at most targetIndexCount indices are left, or no
+	// edge left collapses at a quadric error of at most maxError.  It may be
+	// called again with a smaller target to carry on from where it stopped.
+	// Returns the number of indices left.
+	unsigned int Simplify(unsigned int targetIndexCount, float maxError = 3.402823466e+38f);
+
+	const std::vector<unsigned int>& GetIndices()const;
+
+	// The triangle of the input each triangle left came from.
+	const std::vector<unsigned int>& GetTriangleSources()const;
+
+	// The largest distance from a vertex of the full mesh to the triangles
+	// left, or to those of an earlier call if that was larger.
+	float GetError()const;
+
+	// Vertices that may never move.
+	unsigned int GetLockedVertexCount()const;
+
+	// Appends lodCount levels to lodIndices and lods: the mesh itself, then
+	// each level with about reduction times the triangles of the one before.
+	// A level that cannot be simplified further repeats the one before it.
+	static void BuildLodChain(const float* positions, unsigned int vertexCount, unsigned int vertexStride,
+		const unsigned int* indices, unsigned int indexCount, unsigned int lodCount, float reduction,
+		std::vector<unsigned int>& lodIndices, std::vector<MeshLod>& lods);
+
+	// Pixels a length of one unit covers at the given distance from the eye,
+	// for a vertical field of view of fovY over viewportHeight pixels.
+	static float PixelsPerUnit(float distance, float fovY, float viewportHeight);
+
+	// The coarsest level whose error covers at most maxPixelError pixels.
+	static unsigned int SelectLod(const MeshLod* lods, unsigned int lodCount, float pixelsPerUnit,
+		float maxPixelError = 1.0f);
+
+private:
+	struct Quadric
+	{
+		double A00, A01, A02, A11, A12, A22;
+		double B0, B1, B2;
+		double C;
+		double Weight;
+	};
+
+	enum VertexKind
+	{
+		Interior,	// No open edges; moves anywhere.
+		Border,		// On exactly two open edges; moves along them.
+		Locked
+	};
+
+	const float* GetPosition(unsigned int vertex)const;
+	void AddPlane(Quadric& quadric, const float* p0, const float* normal, double weight)const;
+	float CollapseError(unsigned int from, unsigned int to)const;
+	bool CanCollapse(unsigned int from, unsigned int to, const std::vector<unsigned int>& triangleStart,
+		const std::vector<unsigned int>& vertexTriangles, std::vector<unsigned int>& targets)const;
+	void UpdateDistances(const std::vector<unsigned char>& changed);
+
+	std::vector<float> mPositions;
+
+	// Vertices at the same position form a group; mGroupVertices lists them
+	// from mGroupStart[g] to mGroupStart[g+1].
+	std::vector<unsigned int> mGroups;
+	std::vector<unsigned int> mGroupStart;
+	std::vector<unsigned int> mGroupVertices;
+	std::vector<Quadric> mQuadrics;
+
+	std::vector<unsigned char> mKinds;
+
+	// The two vertices a Border vertex shares open edges with.
+	std::vector<unsigned int> mOpenNeighbors;
+
+	std::vector<unsigned int> mIndices;
+	std::vector<unsigned int> mTriangleSources;
+
+	// The group each vertex of the full mesh has been collapsed into (0xffffffff
+	// for those it does not draw), and its distance to the triangles around it.
+	std::vector<unsigned int> mVertexGroups;
+	std::vector<float> mDistances;
+	float mError;
+};
+
+#endif // MESHSIMPLIFIER_H
@@ -0,0 +1,454 @@
+//***************************************************************************************
+// MeshSimplifierBenchmark.cpp
+//
+// Headless benchmark of MeshSimplifier on the models of the demos: skull.txt
+// and car.txt as the Vertex::Basic32 vertices the demos build from them, and
+// soldier.m3d as the 64 byte Vertex::PosNormalTexTan vertices of its loader,
+// with its subsets kept apart.  Each model is simplified into a chain of levels
+// of detail, each with half the triangles of the one before.  For every level
+// it reports
+//   -its triangles, and how many of the full mesh's that is,
+//   -the error the simplifier gives it, and the largest distance from the
+//    vertices of the full mesh to it (from a sample of them on the larger
+//    levels), both in hundredths of the model's radius,
+//   -the milliseconds from the full mesh to it.
+//
+// Every level must draw only vertices of the full mesh, with no triangle that
+// lost a side, its triangles in the order and in the subsets of those they
+// came from and drawing only vertices of that subset, no more open edges
+// between positions than the full mesh has (a seam that opened would add
+// them), and an error no smaller than the level before nor than the largest
+// distance measured, since SelectLod takes it as a bound.  Returns 1 if any
+// level fails that or a model cannot be read.
+//
+// Build with:
+//   cl /EHsc /O2 MeshSimplifier.cpp MeshSimplifierBenchmark.cpp
+//
+// Usage: MeshSimplifierBenchmark [model ...]
+//        (default ../Chapter16/Models/skull.txt ../Chapter16/Models/car.txt
+//         "../Final Chapter/Models/soldier.m3d")
+//***************************************************************************************
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "MeshSimplifier.h"
+
+namespace
+{
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	// The layouts of Vertex::Basic32 and Vertex::PosNormalTexTan.
+	struct Basic32
+	{
+		float Pos[3];
+		float Normal[3];
+		float Tex[2];
+	};
+
+	struct PosNormalTexTan
+	{
+		float Pos[3];
+		float Normal[3];
+		float Tex[2];
+		float TangentU[4];
+		float Weights[3];
+		unsigned char BoneIndices[4];
+	};
+
+	struct Subset
+	{
+		unsigned int VertexStart;
+		unsigned int VertexCount;
+	};
+
+	struct Model
+	{
+		std::vector<Basic32> Basic;
+		std::vector<PosNormalTexTan> Skinned;
+
+		const float* Positions;
+		unsigned int VertexCount;
+		unsigned int VertexStride;
+
+		std::vector<unsigned int> Indices;
+		std::vector<unsigned int> TriangleSubsets;
+		std::vector<Subset> Subsets;
+	};
+
+	// VertexCount: n / TriangleCount: m / VertexList (pos, normal) / { ... } /
+	// TriangleList / { ... }
+	bool LoadTextModel(const char* filename, Model& model)
+	{
+		std::ifstream fin(filename);
+		if( !fin )
+			return false;
+
+		unsigned int vertexCount = 0;
+		unsigned int triangleCount = 0;
+		std::string ignore;
+		fin >> ignore >> vertexCount;
+		fin >> ignore >> triangleCount;
+		fin >> ignore >> ignore >> ignore >> ignore;
+
+		model.Basic.resize(vertexCount);
+		for(unsigned int i = 0; i < vertexCount; ++i)
+		{
+			Basic32& v = model.Basic[i];
+			fin >> v.Pos[0] >> v.Pos[1] >> v.Pos[2] >> v.Normal[0] >> v.Normal[1] >> v.Normal[2];
+			v.Tex[0] = v.Tex[1] = 0.0f;
+		}
+
+		fin >> ignore >> ignore >> ignore;
+
+		model.Indices.resize(3*triangleCount);
+		for(unsigned int i = 0; i < 3*triangleCount; ++i)
+			fin >> model.Indices[i];
+
+		model.Positions = vertexCount > 0 ? model.Basic[0].Pos : 0;
+		model.VertexCount = vertexCount;
+		model.VertexStride = sizeof(Basic32);
+
+		Subset all = { 0, vertexCount };
+		model.Subsets.push_back(all);
+		model.TriangleSubsets.assign(triangleCount, 0);
+		return vertexCount > 0 && triangleCount > 0 && !fin.fail();
+	}
+
+	// Skips to the line after the one starting with header.
+	bool SkipTo(std::ifstream& fin, const char* header)
+	{
+		std::string line;
+		while( std::getline(fin, line) )
+		{
+			if( line.compare(0, strlen(header), header) == 0 )
+				return true;
+		}
+		return false;
+	}
+
+	// The text .m3d format M3DLoader reads, without materials and animation.
+	bool LoadM3dModel(const char* filename, Model& model)
+	{
+		std::ifstream fin(filename);
+		if( !fin )
+			return false;
+
+		unsigned int subsetCount = 0;
+		unsigned int vertexCount = 0;
+		unsigned int triangleCount = 0;
+		std::string ignore;
+		fin >> ignore;
+		fin >> ignore >> subsetCount;
+		fin >> ignore >> vertexCount;
+		fin >> ignore >> triangleCount;
+
+		if( !SkipTo(fin, "***************SubsetTable") )
+			return false;
+
+		model.TriangleSubsets.resize(triangleCount);
+		for(unsigned int s = 0; s < subsetCount; ++s)
+		{
+			Subset subset;
+			unsigned int faceStart = 0;
+			unsigned int faceCount = 0;
+			fin >> ignore >> ignore >> ignore >> subset.VertexStart >> ignore >> subset.VertexCount >>
+				ignore >> faceStart >> ignore >> faceCount;
+			if( fin.fail() || faceStart + faceCount > triangleCount )
+				return false;
+
+			model.Subsets.push_back(subset);
+			std::fill(model.TriangleSubsets.begin() + faceStart, model.TriangleSubsets.begin() + faceStart + faceCount, s);
+		}
+
+		if( !SkipTo(fin, "***************Vertices") )
+			return false;
+
+		model.Skinned.resize(vertexCount);
+		for(unsigned int i = 0; i < vertexCount; ++i)
+		{
+			PosNormalTexTan& v = model.Skinned[i];
+			float weight = 0.0f;
+			unsigned int bones[4];
+			fin >> ignore >> v.Pos[0] >> v.Pos[1] >> v.Pos[2];
+			fin >> ignore >> v.TangentU[0] >> v.TangentU[1] >> v.TangentU[2] >> v.TangentU[3];
+			fin >> ignore >> v.Normal[0] >> v.Normal[1] >> v.Normal[2];
+			fin >> ignore >> v.Tex[0] >> v.Tex[1];
+			fin >> ignore >> v.Weights[0] >> v.Weights[1] >> v.Weights[2] >> weight;
+			fin >> ignore >> bones[0] >> bones[1] >> bones[2] >> bones[3];
+			for(unsigned int b = 0; b < 4; ++b)
+				v.BoneIndices[b] = (unsigned char)bones[b];
+		}
+
+		if( !SkipTo(fin, "***************Triangles") )
+			return false;
+
+		model.Indices.resize(3*triangleCount);
+		for(unsigned int i = 0; i < 3*triangleCount; ++i)
+			fin >> model.Indices[i];
+
+		model.Positions = vertexCount > 0 ? model.Skinned[0].Pos : 0;
+		model.VertexCount = vertexCount;
+		model.VertexStride = sizeof(PosNormalTexTan);
+		return vertexCount > 0 && triangleCount > 0 && subsetCount > 0 && !fin.fail();
+	}
+
+	const float* GetPosition(const Model& model, unsigned int vertex)
+	{
+		return (const float*)((const char*)model.Positions + (size_t)vertex*model.VertexStride);
+	}
+
+	float Distance(const float* a, const float* b)
+	{
+		float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+		return sqrtf(dx*dx + dy*dy + dz*dz);
+	}
+
+	float Dot(const float* a, const float* b)
+	{
+		return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+	}
+
+	// The distance from p to the triangle abc (Ericson, Real-Time Collision
+	// Detection, 5.1.5).
+	float DistanceToTriangle(const float* p, const float* a, const float* b, const float* c)
+	{
+		float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float ap[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+
+		float d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+		if( d1 <= 0.0f && d2 <= 0.0f )
+			return Distance(p, a);
+
+		float bp[3] = { p[0] - b[0], p[1] - b[1], p[2] - b[2] };
+		float d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+		if( d3 >= 0.0f && d4 <= d3 )
+			return Distance(p, b);
+
+		float cp[3] = { p[0] - c[0], p[1] - c[1], p[2] - c[2] };
+		float d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+		if( d6 >= 0.0f && d5 <= d6 )
+			return Distance(p, c);
+
+		float v, w;
+		float vc = d1*d4 - d3*d2;
+		float vb = d5*d2 - d1*d6;
+		float va = d3*d6 - d5*d4;
+		if( vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f )
+		{
+			v = d1/(d1 - d3);
+			w = 0.0f;
+		}
+		else if( vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f )
+		{
+			v = 0.0f;
+			w = d2/(d2 - d6);
+		}
+		else if( va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f )
+		{
+			w = (d4 - d3)/((d4 - d3) + (d5 - d6));
+			v = 1.0f - w;
+		}
+		else
+		{
+			float denom = 1.0f/(va + vb + vc);
+			v = vb*denom;
+			w = vc*denom;
+		}
+
+		float q[3];
+		for(unsigned int k = 0; k < 3; ++k)
+			q[k] = a[k] + ab[k]*v + ac[k]*w;
+		return Distance(p, q);
+	}
+
+	// The largest distance from a sample of the model's vertices to the
+	// triangles of a level, keeping the work to about 2e7 point to triangle
+	// tests.
+	float MaxDistance(const Model& model, const std::vector<unsigned int>& indices)
+	{
+		unsigned int triangleCount = (unsigned int)indices.size()/3;
+		unsigned int step = std::max(1u, (unsigned int)((double)model.VertexCount*triangleCount / 2e7));
+
+		float maxDistance = 0.0f;
+		for(unsigned int i = 0; i < model.VertexCount; i += step)
+		{
+			const float* p = GetPosition(model, i);
+			float distance = 3.402823466e+38f;
+			for(unsigned int t = 0; t < triangleCount && distance > maxDistance; ++t)
+			{
+				distance = std::min(distance, DistanceToTriangle(p, GetPosition(model, indices[3*t]),
+					GetPosition(model, indices[3*t + 1]), GetPosition(model, indices[3*t + 2])));
+			}
+			maxDistance = std::max(maxDistance, distance);
+		}
+		return maxDistance;
+	}
+
+	float Radius(const Model& model)
+	{
+		float minimum[3] = { 3.402823466e+38f, 3.402823466e+38f, 3.402823466e+38f };
+		float maximum[3] = { -3.402823466e+38f, -3.402823466e+38f, -3.402823466e+38f };
+		for(unsigned int i = 0; i < model.VertexCount; ++i)
+		{
+			const float* p = GetPosition(model, i);
+			for(unsigned int k = 0; k < 3; ++k)
+			{
+				minimum[k] = std::min(minimum[k], p[k]);
+				maximum[k] = std::max(maximum[k], p[k]);
+			}
+		}
+		return 0.5f*Distance(minimum, maximum);
+	}
+
+	// Edges between distinct positions used by one triangle only.
+	unsigned int CountOpenEdges(const Model& model, const std::vector<unsigned int>& indices)
+	{
+		// Number the positions.
+		std::vector<unsigned int> order(model.VertexCount);
+		for(unsigned int i = 0; i < model.VertexCount; ++i)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b)
+		{
+			return memcmp(GetPosition(model, a), GetPosition(model, b), 3*sizeof(float)) < 0;
+		});
+
+		std::vector<unsigned int> positionIds(model.VertexCount);
+		unsigned int id = 0;
+		for(unsigned int k = 0; k < model.VertexCount; ++k)
+		{
+			if( k > 0 && memcmp(GetPosition(model, order[k]), GetPosition(model, order[k-1]), 3*sizeof(float)) != 0 )
+				++id;
+			positionIds[order[k]] = id;
+		}
+
+		std::vector<unsigned long long> edges;
+		for(size_t i = 0; i < indices.size(); ++i)
+		{
+			unsigned long long a = positionIds[indices[i]];
+			unsigned long long b = positionIds[indices[i - i%3 + (i+1)%3]];
+			if( a != b )
+				edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+		}
+		std::sort(edges.begin(), edges.end());
+
+		unsigned int openEdges = 0;
+		for(size_t i = 0; i < edges.size(); )
+		{
+			size_t j = i + 1;
+			while( j < edges.size() && edges[j] == edges[i] )
+				++j;
+			if( j - i == 1 )
+				++openEdges;
+			i = j;
+		}
+		return openEdges;
+	}
+
+	bool CheckLevel(const Model& model, const std::vector<unsigned int>& indices,
+		const std::vector<unsigned int>& sources, unsigned int fullOpenEdges)
+	{
+		for(size_t t = 0; t < sources.size(); ++t)
+		{
+			if( t > 0 && sources[t] <= sources[t-1] )
+				return false;
+
+			const Subset& subset = model.Subsets[model.TriangleSubsets[sources[t]]];
+			const unsigned int* triangle = &indices[3*t];
+			for(unsigned int k = 0; k < 3; ++k)
+			{
+				if( triangle[k] < subset.VertexStart || triangle[k] >= subset.VertexStart + subset.VertexCount )
+					return false;
+			}
+			if( triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0] )
+				return false;
+		}
+		return indices.size() == 3*sources.size() && CountOpenEdges(model, indices) <= fullOpenEdges;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<const char*> filenames;
+	for(int i = 1; i < argc; ++i)
+		filenames.push_back(argv[i]);
+	if( filenames.empty() )
+	{
+		filenames.push_back("../Chapter16/Models/skull.txt");
+		filenames.push_back("../Chapter16/Models/car.txt");
+		filenames.push_back("../Final Chapter/Models/soldier.m3d");
+	}
+
+	const unsigned int lodCount = 7;
+	bool passed = true;
+
+	for(size_t f = 0; f < filenames.size(); ++f)
+	{
+		const char* filename = filenames[f];
+		size_t length = strlen(filename);
+		bool m3d = length > 4 && strcmp(filename + length - 4, ".m3d") == 0;
+
+		Model model;
+		if( !(m3d ? LoadM3dModel(filename, model) : LoadTextModel(filename, model)) ||
+			*std::max_element(model.Indices.begin(), model.Indices.end()) >= model.VertexCount )
+		{
+			printf("cannot read %s\n\n", filename);
+			passed = false;
+			continue;
+		}
+
+		unsigned int triangleCount = (unsigned int)model.Indices.size()/3;
+		float radius = Radius(model);
+		unsigned int fullOpenEdges = CountOpenEdges(model, model.Indices);
+
+		double start = Now();
+		MeshSimplifier simplifier(model.Positions, model.VertexCount, model.VertexStride, &model.Indices[0],
+			(unsigned int)model.Indices.size(), &model.TriangleSubsets[0]);
+		double setupTime = Now() - start;
+
+		printf("%s: %u vertices (%u locked), %u triangles, %u subsets, %u byte vertices, %u open edges\n",
+			filename, model.VertexCount, simplifier.GetLockedVertexCount(), triangleCount,
+			(unsigned int)model.Subsets.size(), model.VertexStride, fullOpenEdges);
+		printf("%-6s %10s %8s %10s %10s %10s %8s\n", "level", "triangles", "%", "error %", "max dist %", "ms", "failed");
+		printf("%-6u %10u %8.1f %10.3f %10.3f %10.2f %8s\n", 0u, triangleCount, 100.0, 0.0, 0.0, 0.0, "");
+
+		double time = setupTime;
+		float previousError = 0.0f;
+		float targetTriangles = (float)triangleCount;
+		for(unsigned int level = 1; level < lodCount; ++level)
+		{
+			targetTriangles *= 0.5f;
+
+			start = Now();
+			simplifier.Simplify(3*(unsigned int)targetTriangles);
+			time += Now() - start;
+
+			const std::vector<unsigned int>& indices = simplifier.GetIndices();
+			float maxDistance = MaxDistance(model, indices);
+			bool valid = CheckLevel(model, indices, simplifier.GetTriangleSources(), fullOpenEdges) &&
+				simplifier.GetError() >= previousError && simplifier.GetError() >= maxDistance;
+			if( !valid )
+				passed = false;
+			previousError = simplifier.GetError();
+
+			unsigned int levelTriangles = (unsigned int)indices.size()/3;
+			printf("%-6u %10u %8.1f %10.3f %10.3f %10.2f %8s\n", level, levelTriangles,
+				100.0*levelTriangles/triangleCount, 100.0*simplifier.GetError()/radius,
+				100.0*maxDistance/radius, time*1000.0, valid ? "" : "yes");
+		}
+		printf("\n");
+	}
+
+	printf("%s\n", passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+//***************************************************************************************
+// RayPacketBenchmark.cpp
+//
+// Headless benchmark of the packet ray/triangle tests in xnacollision against
+// IntersectRayTriangle.  It fires a batch of rays at a cloud of random triangles
+// and tests every ray against every triangle three ways:
+//   -IntersectRayTriangle, one pair at a time,
+//   -IntersectRayTrianglePacket, one ray against four triangles,
+//   -IntersectRayPacketTriangle, four rays against one triangle,
+// reporting rays and ray/triangle tests per second.  Every hit and distance the
+// packet tests return must be bit for bit the one IntersectRayTriangle returns;
+// the benchmark returns 1 if any differs.
+//
+// Build with:
+//   cl /EHsc /O2 xnacollision.cpp RayPacketBenchmark.cpp
+//
+// Usage: RayPacketBenchmark [rays [triangles]]      (default 4096 1024)
+//***************************************************************************************
+
+#include <Windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "xnacollision.h"
+
+using namespace XNA;
+
+namespace
+{
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	float RandF(UINT& state)
+	{
+		state = state*1664525u + 1013904223u;
+		return (state >> 8) / 16777216.0f;
+	}
+
+	struct Result
+	{
+		UINT Hits;
+		std::vector<float> Dist;	// rays x triangles, 0 where there is no hit
+	};
+
+	bool SameFloat(float a, float b)
+	{
+		return memcmp(&a, &b, sizeof(float)) == 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	UINT rayCount = argc > 1 ? (UINT)std::max(4, atoi(argv[1])) & ~3u : 4096;
+	UINT triangleCount = argc > 2 ? (UINT)std::max(4, atoi(argv[2])) & ~3u : 1024;
+
+	//
+	// Small triangles scattered through a unit cube, and rays from outside it
+	// through random points inside it.
+	//
+
+	UINT random = 1357;
+
+	std::vector<XMFLOAT3> points(3*triangleCount);
+	std::vector<UINT> indices(3*triangleCount);
+	for(UINT i = 0; i < triangleCount; ++i)
+	{
+		XMFLOAT3 center(RandF(random), RandF(random), RandF(random));
+		for(UINT k = 0; k < 3; ++k)
+		{
+			points[3*i + k] = XMFLOAT3(center.x + 0.2f*(RandF(random) - 0.5f),
+				center.y + 0.2f*(RandF(random) - 0.5f), center.z + 0.2f*(RandF(random) - 0.5f));
+			indices[3*i + k] = 3*i + k;
+		}
+	}
+
+	std::vector<XMFLOAT3> origins(rayCount), directions(rayCount);
+	for(UINT r = 0; r < rayCount; ++r)
+	{
+		XMVECTOR origin = XMVectorSet(4.0f*RandF(random) - 1.5f, 4.0f*RandF(random) - 1.5f, -2.0f, 0.0f);
+		XMVECTOR target = XMVectorSet(RandF(random), RandF(random), RandF(random), 0.0f);
+		XMStoreFloat3(&origins[r], origin);
+		XMStoreFloat3(&directions[r], XMVector3Normalize(target - origin));
+	}
+
+	std::vector<TrianglePacket> trianglePackets(triangleCount/4);
+	for(UINT i = 0; i < triangleCount/4; ++i)
+		ComputeTrianglePacket(&trianglePackets[i], 4, &points[0], sizeof(XMFLOAT3), &indices[12*i]);
+
+	std::vector<RayPacket> rayPackets(rayCount/4);
+	for(UINT r = 0; r < rayCount/4; ++r)
+		ComputeRayPacket(&rayPackets[r], 4, &origins[4*r], &directions[4*r]);
+
+	Result scalar, triangles4, rays4;
+	scalar.Dist.assign((size_t)rayCount*triangleCount, 0.0f);
+	triangles4.Dist = rays4.Dist = scalar.Dist;
+	scalar.Hits = triangles4.Hits = rays4.Hits = 0;
+
+	//
+	// One pair at a time.
+	//
+
+	double start = Now();
+	for(UINT r = 0; r < rayCount; ++r)
+	{
+		XMVECTOR origin = XMLoadFloat3(&origins[r]);
+		XMVECTOR direction = XMLoadFloat3(&directions[r]);
+		float* dist = &scalar.Dist[(size_t)r*triangleCount];
+
+		for(UINT i = 0; i < triangleCount; ++i)
+		{
+			XMVECTOR v0 = XMLoadFloat3(&points[3*i + 0]);
+			XMVECTOR v1 = XMLoadFloat3(&points[3*i + 1]);
+			XMVECTOR v2 = XMLoadFloat3(&points[3*i + 2]);
+
+			if( IntersectRayTriangle(origin, direction, v0, v1, v2, &dist[i]) )
+				++scalar.Hits;
+		}
+	}
+	double scalarTime = Now() - start;
+
+	//
+	// One ray against four triangles.
+	//
+
+	start = Now();
+	for(UINT r = 0; r < rayCount; ++r)
+	{
+		XMVECTOR origin = XMLoadFloat3(&origins[r]);
+		XMVECTOR direction = XMLoadFloat3(&directions[r]);
+		float* dist = &triangles4.Dist[(size_t)r*triangleCount];
+
+		for(UINT i = 0; i < triangleCount/4; ++i)
+		{
+			XMVECTOR packetDist;
+			UINT hits = IntersectRayTrianglePacket(origin, direction, &trianglePackets[i], &packetDist);
+			if( hits == 0 )
+				continue;
+
+			XMVECTORF32 d;
+			d.v = packetDist;
+			for(UINT k = 0; k < 4; ++k)
+			{
+				if( hits & (1 << k) )
+				{
+					dist[4*i + k] = d.f[k];
+					++triangles4.Hits;
+				}
+			}
+		}
+	}
+	double triangles4Time = Now() - start;
+
+	//
+	// Four rays against one triangle.
+	//
+
+	start = Now();
+	for(UINT r = 0; r < rayCount/4; ++r)
+	{
+		for(UINT i = 0; i < triangleCount; ++i)
+		{
+			XMVECTOR v0 = XMLoadFloat3(&points[3*i + 0]);
+			XMVECTOR v1 = XMLoadFloat3(&points[3*i + 1]);
+			XMVECTOR v2 = XMLoadFloat3(&points[3*i + 2]);
+
+			XMVECTOR packetDist;
+			UINT hits = IntersectRayPacketTriangle(&rayPackets[r], v0, v1, v2, &packetDist);
+			if( hits == 0 )
+				continue;
+
+			XMVECTORF32 d;
+			d.v = packetDist;
+			for(UINT k = 0; k < 4; ++k)
+			{
+				if( hits & (1 << k) )
+				{
+					rays4.Dist[(size_t)(4*r + k)*triangleCount + i] = d.f[k];
+					++rays4.Hits;
+				}
+			}
+		}
+	}
+	double rays4Time = Now() - start;
+
+	//
+	// Compare with the scalar test.
+	//
+
+	UINT mismatches = 0;
+	for(size_t k = 0; k < scalar.Dist.size(); ++k)
+	{
+		if( !SameFloat(scalar.Dist[k], triangles4.Dist[k]) || !SameFloat(scalar.Dist[k], rays4.Dist[k]) )
+			++mismatches;
+	}
+	if( scalar.Hits != triangles4.Hits || scalar.Hits != rays4.Hits )
+		++mismatches;
+
+	double tests = (double)rayCount*triangleCount;
+
+	printf("%u rays x %u triangles, %u hits\n\n", rayCount, triangleCount, scalar.Hits);
+	printf("%-28s %12s %14s %8s\n", "", "Mrays/s", "Mtests/s", "x scalar");
+	printf("%-28s %12.3f %14.2f %8.2f\n", "IntersectRayTriangle",
+		rayCount/scalarTime*1e-6, tests/scalarTime*1e-6, 1.0);
+	printf("%-28s %12.3f %14.2f %8.2f\n", "IntersectRayTrianglePacket",
+		rayCount/triangles4Time*1e-6, tests/triangles4Time*1e-6, scalarTime/triangles4Time);
+	printf("%-28s %12.3f %14.2f %8.2f\n", "IntersectRayPacketTriangle",
+		rayCount/rays4Time*1e-6, tests/rays4Time*1e-6, scalarTime/rays4Time);
+
+	printf("\n%u mismatches: %s\n", mismatches, mismatches == 0 ? "ok" : "FAILED");
+	return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,706 @@
+//***************************************************************************************
+// SweepAndPrune.cpp
+//***************************************************************************************
+
+#include "SweepAndPrune.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace XNA;
+
+namespace
+{
+	// Order of the sorted lists: by value, and a minimum before a maximum of the
+	// same value, so that boxes that just touch overlap.
+	struct EndpointLess
+	{
+		template<typename T>
+		bool operator()(const T& a, const T& b)const
+		{
+			return a.Value < b.Value || (a.Value == b.Value && (a.Data & 1) < (b.Data & 1));
+		}
+	};
+
+	// Cell coordinates are kept within 21 bits each.
+	const int CellBias = 1 << 20;
+
+	// About what sorting n endpoints from scratch costs per endpoint, counted
+	// in swaps of an insertion sort.
+	UINT RebuildSwapsPerEndpoint(UINT n)
+	{
+		UINT log2n = 0;
+		while( n >> log2n )
+			++log2n;
+		return log2n;
+	}
+
+	int CellCoord(float v, float cellSize)
+	{
+		if( cellSize <= 0.0f )
+			return 0;
+
+		float c = floorf(v / cellSize);
+		return (int)std::max(-(float)CellBias, std::min(c, (float)(CellBias - 1)));
+	}
+}
+
+SweepAndPrune::SweepAndPrune(float cellSize)
+	: mCellSize(cellSize), mProxyCount(0), mPairCount(0), mTouchingCount(0)
+{
+	mStats = Stats();
+}
+
+UINT SweepAndPrune::AddProxy(const CollisionShape& shape)
+{
+	UINT proxy;
+	if( !mFreeProxies.empty() )
+	{
+		proxy = mFreeProxies.back();
+		mFreeProxies.pop_back();
+	}
+	else
+	{
+		proxy = (UINT)mProxies.size();
+		mProxies.push_back(Proxy());
+	}
+
+	Proxy& p = mProxies[proxy];
+	p.Shape = shape;
+	p.FirstHandle = InvalidIndex;
+	p.Alive = true;
+	p.Moved = true;
+	mMovedProxies.push_back(proxy);
+
+	SetBounds(proxy);
+
+	int cellMin[3], cellMax[3];
+	for(UINT axis = 0; axis < 3; ++axis)
+	{
+		cellMin[axis] = p.CellMin[axis];
+		cellMax[axis] = p.CellMax[axis];
+	}
+
+	for(int z = cellMin[2]; z <= cellMax[2]; ++z)
+	{
+		for(int y = cellMin[1]; y <= cellMax[1]; ++y)
+		{
+			for(int x = cellMin[0]; x <= cellMax[0]; ++x)
+				AddHandle(proxy, FindCell(x, y, z));
+		}
+	}
+
+	++mProxyCount;
+	return proxy;
+}
+
+void SweepAndPrune::MoveProxy(UINT proxy, const CollisionShape& shape)
+{
+	int oldMin[3], oldMax[3];
+	for(UINT axis = 0; axis < 3; ++axis)
+	{
+		oldMin[axis] = mProxies[proxy].CellMin[axis];
+		oldMax[axis] = mProxies[proxy].CellMax[axis];
+	}
+
+	mProxies[proxy].Shape = shape;
+	SetBounds(proxy);
+
+	Proxy& p = mProxies[proxy];
+	if( !p.Moved )
+	{
+		p.Moved = true;
+		mMovedProxies.push_back(proxy);
+	}
+
+	// Handles in cells the box still reaches take its new endpoints; the others
+	// are dropped.
+	UINT* pLink = &p.FirstHandle;
+	while( *pLink != InvalidIndex )
+	{
+		UINT h = *pLink;
+		Handle& handle = mHandles[h];
+		Cell& cell = mCells[handle.Cell];
+
+		bool inside = true;
+		for(UINT axis = 0; axis < 3; ++axis)
+			inside = inside && cell.Coord[axis] >= p.CellMin[axis] && cell.Coord[axis] <= p.CellMax[axis];
+
+		if( inside )
+		{
+			for(UINT axis = 0; axis < 3; ++axis)
+			{
+				cell.Endpoints[axis][handle.MinIndex[axis]].Value = p.Min[axis];
+				cell.Endpoints[axis][handle.MaxIndex[axis]].Value = p.Max[axis];
+			}
+			MarkDirty(handle.Cell);
+			pLink = &handle.Next;
+		}
+		else
+		{
+			*pLink = handle.Next;
+			KillHandle(h);
+		}
+	}
+
+	// Cells the box has just reached.
+	int cellMin[3], cellMax[3];
+	for(UINT axis = 0; axis < 3; ++axis)
+	{
+		cellMin[axis] = p.CellMin[axis];
+		cellMax[axis] = p.CellMax[axis];
+	}
+
+	for(int z = cellMin[2]; z <= cellMax[2]; ++z)
+	{
+		for(int y = cellMin[1]; y <= cellMax[1]; ++y)
+		{
+			for(int x = cellMin[0]; x <= cellMax[0]; ++x)
+			{
+				if( x < oldMin[0] || x > oldMax[0] || y < oldMin[1] || y > oldMax[1] || z < oldMin[2] || z > oldMax[2] )
+					AddHandle(proxy, FindCell(x, y, z));
+			}
+		}
+	}
+}
+
+void SweepAndPrune::RemoveProxy(UINT proxy)
+{
+	Proxy& p = mProxies[proxy];
+
+	UINT h = p.FirstHandle;
+	while( h != InvalidIndex )
+	{
+		UINT next = mHandles[h].Next;
+		KillHandle(h);
+		h = next;
+	}
+
+	p.FirstHandle = InvalidIndex;
+	p.Alive = false;
+
+	mRemovedProxies.push_back(proxy);
+	--mProxyCount;
+}
+
+void SweepAndPrune::SetBounds(UINT proxy)
+{
+	Proxy& p = mProxies[proxy];
+
+	XMFLOAT3 vMin, vMax;
+	ComputeBounds(p.Shape, &vMin, &vMax);
+
+	p.Min[0] = vMin.x; p.Min[1] = vMin.y; p.Min[2] = vMin.z;
+	p.Max[0] = vMax.x; p.Max[1] = vMax.y; p.Max[2] = vMax.z;
+
+	for(UINT axis = 0; axis < 3; ++axis)
+	{
+		p.CellMin[axis] = CellCoord(p.Min[axis], mCellSize);
+		p.CellMax[axis] = CellCoord(p.Max[axis], mCellSize);
+	}
+}
+
+UINT SweepAndPrune::FindCell(int x, int y, int z)
+{
+	UINT64 key = ((UINT64)(x + CellBias) << 42) | ((UINT64)(y + CellBias) << 21) | (UINT64)(z + CellBias);
+
+	std::unordered_map<UINT64, UINT>::const_iterator it = mCellIndex.find(key);
+	if( it != mCellIndex.end() )
+		return it->second;
+
+	UINT cell = (UINT)mCells.size();
+	mCells.push_back(Cell());
+
+	Cell& c = mCells[cell];
+	c.Coord[0] = x;
+	c.Coord[1] = y;
+	c.Coord[2] = z;
+	c.HandleCount = 0;
+	c.AddedCount = 0;
+	c.DeadCount = 0;
+	c.Disorder = 0;
+	c.Dirty = false;
+
+	mCellIndex[key] = cell;
+	return cell;
+}
+
+void SweepAndPrune::AddHandle(UINT proxy, UINT cell)
+{
+	UINT h;
+	if( !mFreeHandles.empty() )
+	{
+		h = mFreeHandles.back();
+		mFreeHandles.pop_back();
+	}
+	else
+	{
+		h = (UINT)mHandles.size();
+		mHandles.push_back(Handle());
+	}
+
+	Proxy& p = mProxies[proxy];
+	Handle& handle = mHandles[h];
+	handle.Proxy = proxy;
+	handle.Cell = cell;
+	handle.Next = p.FirstHandle;
+	p.FirstHandle = h;
+
+	// Appended past the end of the lists, as if the box had come in from
+	// infinity; the next sort brings the endpoints into place and finds the
+	// pairs.
+	Cell& c = mCells[cell];
+	for(UINT axis = 0; axis < 3; ++axis)
+	{
+		Endpoint e;
+		e.Value = p.Min[axis];
+		e.Data = h << 1;
+		handle.MinIndex[axis] = (UINT)c.Endpoints[axis].size();
+		c.Endpoints[axis].push_back(e);
+
+		e.Value = p.Max[axis];
+		e.Data = (h << 1) | 1;
+		handle.MaxIndex[axis] = (UINT)c.Endpoints[axis].size();
+		c.Endpoints[axis].push_back(e);
+	}
+
+	++c.HandleCount;
+	++c.AddedCount;
+	MarkDirty(cell);
+}
+
+void SweepAndPrune::KillHandle(UINT h)
+{
+	// Sent to infinity, which leaves the endpoints at the end of the lists
+	// after the next sort, to be dropped there.
+	const Handle& handle = mHandles[h];
+	Cell& c = mCells[handle.Cell];
+	for(UINT axis = 0; axis < 3; ++axis)
+	{
+		c.Endpoints[axis][handle.MinIndex[axis]].Value = FLT_MAX;
+		c.Endpoints[axis][handle.MaxIndex[axis]].Value = FLT_MAX;
+	}
+
+	--c.HandleCount;
+	++c.DeadCount;
+	MarkDirty(handle.Cell);
+
+	mDeadHandles.push_back(h);
+}
+
+void SweepAndPrune::MarkDirty(UINT cell)
+{
+	if( !mCells[cell].Dirty )
+	{
+		mCells[cell].Dirty = true;
+		mDirtyCells.push_back(cell);
+	}
+}
+
+void SweepAndPrune::Update(JobSystem* jobSystem)
+{
+	mStats = Stats();
+	mBeginEvents.clear();
+	mEndEvents.clear();
+
+	//
+	// Broad phase: sort the lists of the cells that changed, finding the pairs
+	// that started to overlap.
+	//
+
+	for(size_t i = 0; i < mDirtyCells.size(); ++i)
+	{
+		Cell& cell = mCells[mDirtyCells[i]];
+
+		// Insertion sort costs as much as the endpoints are out of order.  The
+		// endpoints of a new box come in from the end of the lists, passing
+		// about half of each, and the boxes move about as much from one frame
+		// to the next, so the disorder of the last update of the cell predicts
+		// that of this one.  Rebuild the cell once that costs more than sorting
+		// from scratch.
+		UINT64 endpointCount = 2*(cell.HandleCount + cell.DeadCount);
+		UINT64 insertionCost = cell.Disorder + 3*cell.AddedCount*endpointCount;
+		UINT64 sortCost = 3*endpointCount*RebuildSwapsPerEndpoint((UINT)endpointCount);
+		if( insertionCost > sortCost )
+			RebuildCell(mDirtyCells[i]);
+		else
+			SortCell(mDirtyCells[i]);
+
+		cell.AddedCount = 0;
+		cell.DeadCount = 0;
+		cell.Dirty = false;
+	}
+	mDirtyCells.clear();
+
+	mFreeHandles.insert(mFreeHandles.end(), mDeadHandles.begin(), mDeadHandles.end());
+	mDeadHandles.clear();
+
+	mFreeProxies.insert(mFreeProxies.end(), mRemovedProxies.begin(), mRemovedProxies.end());
+	mRemovedProxies.clear();
+
+	//
+	// Pairs where a proxy moved or was removed: drop those that no longer
+	// overlap and test the shapes of the others.
+	//
+
+	mNarrowPairs.clear();
+	for(UINT i = 0; i < (UINT)mPairs.size(); ++i)
+	{
+		const Pair& pair = mPairs[i];
+		if( !pair.Alive )
+			continue;
+
+		const Proxy& a = mProxies[pair.ProxyA];
+		const Proxy& b = mProxies[pair.ProxyB];
+		if( !pair.Fresh && !a.Moved && !b.Moved && a.Alive && b.Alive )
+			continue;
+
+		if( Overlaps(pair.ProxyA, pair.ProxyB) )
+			mNarrowPairs.push_back(i);
+		else
+			FreePair(i);
+	}
+	mNarrowResults.resize(mNarrowPairs.size());
+
+	auto narrowPhase = [this](UINT first, UINT last)
+	{
+		for(UINT i = first; i < last; ++i)
+		{
+			const Pair& pair = mPairs[mNarrowPairs[i]];
+			mNarrowResults[i] = Intersect(mProxies[pair.ProxyA].Shape, mProxies[pair.ProxyB].Shape) ? 1 : 0;
+		}
+	};
+
+	if( jobSystem )
+		jobSystem->ParallelFor(0, (UINT)mNarrowPairs.size(), 256, narrowPhase);
+	else
+		narrowPhase(0, (UINT)mNarrowPairs.size());
+
+	for(size_t i = 0; i < mNarrowPairs.size(); ++i)
+	{
+		Pair& pair = mPairs[mNarrowPairs[i]];
+		bool touching = mNarrowResults[i] != 0;
+		pair.Fresh = false;
+
+		if( touching != pair.Touching )
+		{
+			PairEvent e = { mNarrowPairs[i], pair.ProxyA, pair.ProxyB };
+			if( touching )
+			{
+				mBeginEvents.push_back(e);
+				++mTouchingCount;
+			}
+			else
+			{
+				mEndEvents.push_back(e);
+				--mTouchingCount;
+			}
+			pair.Touching = touching;
+		}
+	}
+	mStats.NarrowTests = (UINT)mNarrowPairs.size();
+
+	for(size_t i = 0; i < mMovedProxies.size(); ++i)
+		mProxies[mMovedProxies[i]].Moved = false;
+	mMovedProxies.clear();
+}
+
+void SweepAndPrune::SortCell(UINT cell)
+{
+	Cell& c = mCells[cell];
+	EndpointLess less;
+	UINT swaps = 0;
+
+	for(UINT axis = 0; axis < 3; ++axis)
+	{
+		std::vector<Endpoint>& list = c.Endpoints[axis];
+
+		for(UINT i = 1; i < (UINT)list.size(); ++i)
+		{
+			Endpoint e = list[i];
+			if( !less(e, list[i - 1]) )
+				continue;
+
+			Handle& handle = mHandles[e.Data >> 1];
+			bool isMax = (e.Data & 1) != 0;
+
+			UINT j = i;
+			do
+			{
+				const Endpoint& prev = list[j - 1];
+				Handle& other = mHandles[prev.Data >> 1];
+
+				// A minimum passing a maximum may start an overlap.  Pairs that
+				// stop overlapping are found by Update, which checks the pairs
+				// of every proxy that moved.
+				if( !isMax && (prev.Data & 1) && Overlaps(handle.Proxy, other.Proxy) )
+					AddPair(handle.Proxy, other.Proxy);
+
+				list[j] = prev;
+				if( prev.Data & 1 )
+					other.MaxIndex[axis] = j;
+				else
+					other.MinIndex[axis] = j;
+
+				--j;
+				++swaps;
+			} while( j > 0 && less(e, list[j - 1]) );
+
+			list[j] = e;
+			if( isMax )
+				handle.MaxIndex[axis] = j;
+			else
+				handle.MinIndex[axis] = j;
+		}
+
+		// The endpoints of dropped handles are now at the end.
+		list.resize(list.size() - 2*c.DeadCount);
+	}
+
+	c.Disorder = swaps;
+	mStats.Swaps += swaps;
+	++mStats.CellsSorted;
+}
+
+void SweepAndPrune::RebuildCell(UINT cell)
+{
+	Cell& c = mCells[cell];
+	EndpointLess less;
+
+	//
+	// Sort the lists from scratch and drop the endpoints of dead handles, which
+	// sort to the end.
+	//
+
+	// The endpoints still hold the indices they had before the sort.  Summed
+	// over the endpoints of the boxes that were already in the cell, how far
+	// they moved is between the number of swaps an insertion sort would have
+	// made for them and twice that (Diaconis and Graham); the larger bound
+	// keeps a cell that was worth rebuilding from going back to insertion sort
+	// too early.  New boxes are appended, after the others.
+	UINT firstAdded = 2*(c.HandleCount + c.DeadCount - c.AddedCount);
+	UINT64 displacement = 0;
+
+	UINT sweepAxis = 0;
+	float bestVariance = -1.0f;
+	for(UINT axis = 0; axis < 3; ++axis)
+	{
+		std::vector<Endpoint>& list = c.Endpoints[axis];
+		std::sort(list.begin(), list.end(), less);
+		list.resize(list.size() - 2*c.DeadCount);
+
+		double sum = 0.0, sumSquares = 0.0;
+		for(UINT i = 0; i < (UINT)list.size(); ++i)
+		{
+			Handle& handle = mHandles[list[i].Data >> 1];
+			UINT& index = (list[i].Data & 1) ? handle.MaxIndex[axis] : handle.MinIndex[axis];
+			if( index < firstAdded )
+				displacement += index > i ? index - i : i - index;
+			index = i;
+
+			double v = list[i].Value;
+			sum += v;
+			sumSquares += v*v;
+		}
+
+		double n = std::max<double>(1.0, (double)list.size());
+		float variance = (float)(sumSquares/n - (sum/n)*(sum/n));
+		if( variance > bestVariance )
+		{
+			bestVariance = variance;
+			sweepAxis = axis;
+		}
+	}
+
+	//
+	// Sweep along the axis the boxes are most spread out on: every box overlaps
+	// there with the boxes whose minimum lies between its own endpoints.  The
+	// boxes are copied out in the order of their minimums first, so that the
+	// sweep reads them one after the other.
+	//
+
+	const std::vector<Endpoint>& list = c.Endpoints[sweepAxis];
+	mSweepBoxes.clear();
+	for(UINT i = 0; i < (UINT)list.size(); ++i)
+	{
+		if( list[i].Data & 1 )
+			continue;
+
+		SweepBox box;
+		box.Proxy = mHandles[list[i].Data >> 1].Proxy;
+
+		const Proxy& p = mProxies[box.Proxy];
+		for(UINT axis = 0; axis < 3; ++axis)
+		{
+			UINT k = (sweepAxis + axis) % 3;
+			box.Min[axis] = p.Min[k];
+			box.Max[axis] = p.Max[k];
+		}
+		mSweepBoxes.push_back(box);
+	}
+
+	for(size_t i = 0; i < mSweepBoxes.size(); ++i)
+	{
+		const SweepBox& a = mSweepBoxes[i];
+		for(size_t j = i + 1; j < mSweepBoxes.size() && mSweepBoxes[j].Min[0] <= a.Max[0]; ++j)
+		{
+			const SweepBox& b = mSweepBoxes[j];
+			if( a.Min[1] <= b.Max[1] && b.Min[1] <= a.Max[1] && a.Min[2] <= b.Max[2] && b.Min[2] <= a.Max[2] )
+				AddPair(a.Proxy, b.Proxy);
+		}
+	}
+
+	c.Disorder = (UINT)std::min<UINT64>(displacement, 0xffffffff);
+	++mStats.CellsRebuilt;
+}
+
+bool SweepAndPrune::Overlaps(UINT a, UINT b)const
+{
+	const Proxy& pa = mProxies[a];
+	const Proxy& pb = mProxies[b];
+
+	return a != b && pa.Alive && pb.Alive &&
+		pa.Min[0] <= pb.Max[0] && pb.Min[0] <= pa.Max[0] &&
+		pa.Min[1] <= pb.Max[1] && pb.Min[1] <= pa.Max[1] &&
+		pa.Min[2] <= pb.Max[2] && pb.Min[2] <= pa.Max[2];
+}
+
+UINT64 SweepAndPrune::PairKey(UINT a, UINT b)
+{
+	return a < b ? ((UINT64)a << 32) | b : ((UINT64)b << 32) | a;
+}
+
+void SweepAndPrune::AddPair(UINT a, UINT b)
+{
+	UINT64 key = PairKey(a, b);
+	if( mPairIndex.find(key) != mPairIndex.end() )
+		return;
+
+	UINT pair;
+	if( !mFreePairs.empty() )
+	{
+		pair = mFreePairs.back();
+		mFreePairs.pop_back();
+	}
+	else
+	{
+		pair = (UINT)mPairs.size();
+		mPairs.push_back(Pair());
+	}
+
+	Pair& p = mPairs[pair];
+	p.ProxyA = std::min(a, b);
+	p.ProxyB = std::max(a, b);
+	p.Alive = true;
+	p.Touching = false;
+	p.Fresh = true;
+
+	mPairIndex[key] = pair;
+	++mPairCount;
+	++mStats.PairsAdded;
+}
+
+void SweepAndPrune::FreePair(UINT pair)
+{
+	Pair& p = mPairs[pair];
+
+	if( p.Touching )
+	{
+		PairEvent e = { pair, p.ProxyA, p.ProxyB };
+		mEndEvents.push_back(e);
+		--mTouchingCount;
+	}
+
+	mPairIndex.erase(PairKey(p.ProxyA, p.ProxyB));
+	p.Alive = false;
+	p.Touching = false;
+	mFreePairs.push_back(pair);
+
+	--mPairCount;
+	++mStats.PairsRemoved;
+}
+
+void SweepAndPrune::ComputeBounds(const CollisionShape& shape, XMFLOAT3* pMin, XMFLOAT3* pMax)
+{
+	XMVECTOR Center = XMLoadFloat3(&shape.Center);
+	XMVECTOR Extents;
+
+	switch( shape.Type )
+	{
+	case CollisionSphere:
+		Extents = XMVectorReplicate(shape.Extents.x);
+		break;
+
+	case CollisionAxisAlignedBox:
+		Extents = XMLoadFloat3(&shape.Extents);
+		break;
+
+	default:
+	{
+		// The box's axes are the rows of its rotation; it reaches as far along a
+		// world axis as the sum of its extents along it.
+		XMMATRIX R = XMMatrixRotationQuaternion(XMLoadFloat4(&shape.Orientation));
+		Extents = XMVectorAbs(R.r[0])*shape.Extents.x + XMVectorAbs(R.r[1])*shape.Extents.y +
+			XMVectorAbs(R.r[2])*shape.Extents.z;
+		break;
+	}
+	}
+
+	XMStoreFloat3(pMin, Center - Extents);
+	XMStoreFloat3(pMax, Center + Extents);
+}
+
+BOOL SweepAndPrune::Intersect(const CollisionShape& a, const CollisionShape& b)
+{
+	if( a.Type > b.Type )
+		return Intersect(b, a);
+
+	Sphere sphereA, sphereB;
+	AxisAlignedBox boxA, boxB;
+	OrientedBox orientedA, orientedB;
+
+	switch( a.Type )
+	{
+	case CollisionSphere:
+		sphereA.Center = a.Center;
+		sphereA.Radius = a.Extents.x;
+		break;
+
+	case CollisionAxisAlignedBox:
+		boxA.Center = a.Center;
+		boxA.Extents = a.Extents;
+		break;
+
+	default:
+		orientedA.Center = a.Center;
+		orientedA.Extents = a.Extents;
+		orientedA.Orientation = a.Orientation;
+		break;
+	}
+
+	switch( b.Type )
+	{
+	case CollisionSphere:
+		sphereB.Center = b.Center;
+		sphereB.Radius = b.Extents.x;
+		return IntersectSphereSphere(&sphereA, &sphereB);
+
+	case CollisionAxisAlignedBox:
+		boxB.Center = b.Center;
+		boxB.Extents = b.Extents;
+		if( a.Type == CollisionSphere )
+			return IntersectSphereAxisAlignedBox(&sphereA, &boxB);
+		return IntersectAxisAlignedBoxAxisAlignedBox(&boxA, &boxB);
+
+	default:
+		orientedB.Center = b.Center;
+		orientedB.Extents = b.Extents;
+		orientedB.Orientation = b.Orientation;
+		if( a.Type == CollisionSphere )
+			return IntersectSphereOrientedBox(&sphereA, &orientedB);
+		if( a.Type == CollisionAxisAlignedBox )
+			return IntersectAxisAlignedBoxOrientedBox(&boxA, &orientedB);
+		return IntersectOrientedBoxOrientedBox(&orientedA, &orientedB);
+	}
+}
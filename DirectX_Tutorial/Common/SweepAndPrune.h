@@ -0,0 +1,255 @@
+//***************************************************************************************
+// SweepAndPrune.h
+//
+// Incremental sweep and prune broad phase over the bounding volumes of
+// xnacollision.
+//   -Every proxy is a sphere, an axis-aligned box or an oriented box.  Its world
+//    space bounding box is kept as two endpoints in a sorted list for each axis.
+//   -Update() re-sorts the lists with insertion sort.  Bodies move little from
+//    one frame to the next, so the lists are nearly sorted and this costs close
+//    to linear time.  Two boxes can only start overlapping when an endpoint of
+//    one passes an endpoint of the other on some axis, so the swaps of the sort
+//    are where new pairs are found.  Lists that were too far out of order at
+//    the last Update, or that take many new boxes, are sorted from scratch and
+//    swept instead.
+//   -Projected on one axis, the boxes of a crowded scene overlap a lot and every
+//    move makes many swaps.  Given a cell size, space is cut into a grid of cubic
+//    cells that each keep their own lists of the boxes that reach into them, so
+//    that the lists are short and sparse (a hybrid of the grid and sweep and
+//    prune).  Without one, there is a single set of lists.
+//   -Overlapping pairs are kept across frames under an id that stays the same
+//    for as long as they overlap.  Pairs where either proxy moved are dropped
+//    once their boxes part, or else go through the xnacollision test for their
+//    two shapes; pairs that started or stopped touching are reported as begin
+//    and end events.
+//***************************************************************************************
+
+#ifndef SWEEPANDPRUNE_H
+#define SWEEPANDPRUNE_H
+
+#include <Windows.h>
+#include <unordered_map>
+#include <vector>
+#include "xnacollision.h"
+
+class JobSystem;
+
+enum CollisionShapeType
+{
+	CollisionSphere,
+	CollisionAxisAlignedBox,
+	CollisionOrientedBox
+};
+
+// One of the bounding volumes of xnacollision, by its type.
+struct CollisionShape
+{
+	CollisionShapeType Type;
+	XMFLOAT3 Center;
+	XMFLOAT3 Extents;           // Extents.x is the radius of a sphere.
+	XMFLOAT4 Orientation;       // Rotation (box -> world) of an oriented box.
+};
+
+class SweepAndPrune
+{
+public:
+	// A pair of proxies, ProxyA < ProxyB, and the id of their pair.
+	struct PairEvent
+	{
+		UINT Pair;
+		UINT ProxyA;
+		UINT ProxyB;
+	};
+
+	// Counts for the last call to Update.
+	struct Stats
+	{
+		// Endpoints that passed each other in the insertion sorted lists.
+		UINT Swaps;
+
+		// Cells whose lists were insertion sorted, and cells sorted and swept
+		// from scratch because many boxes had entered them.
+		UINT CellsSorted;
+		UINT CellsRebuilt;
+
+		UINT PairsAdded;
+		UINT PairsRemoved;
+
+		// Pairs whose shapes were tested.
+		UINT NarrowTests;
+	};
+
+public:
+	// A cell size of zero keeps every proxy in one set of lists.  Otherwise pick
+	// a few times the size of a typical body: a proxy is kept in every cell its
+	// box reaches into.  One set of lists suits scenes whose boxes, projected
+	// on an axis, overlap few others; in crowded scenes the lists of a grid are
+	// much faster (see SweepAndPruneBenchmark.cpp).
+	explicit SweepAndPrune(float cellSize = 0.0f);
+
+	// Proxies take effect on the next Update.  Ids of removed proxies are reused
+	// after the Update that removes them.  Shapes must be finite.
+	UINT AddProxy(const CollisionShape& shape);
+	void MoveProxy(UINT proxy, const CollisionShape& shape);
+	void RemoveProxy(UINT proxy);
+
+	const CollisionShape& GetShape(UINT proxy)const { return mProxies[proxy].Shape; }
+
+	// Brings the pairs up to date with the proxies and fills the event lists.
+	// The id of a pair that ended is not reused before the next Update.  The
+	// narrow phase runs on the job system when one is given.
+	void Update(JobSystem* jobSystem = NULL);
+
+	const std::vector<PairEvent>& GetBeginEvents()const { return mBeginEvents; }
+	const std::vector<PairEvent>& GetEndEvents()const { return mEndEvents; }
+
+	// Whether the shapes of a pair touched at the last Update.
+	bool IsTouching(UINT pair)const { return mPairs[pair].Touching; }
+
+	UINT GetProxyCount()const { return mProxyCount; }
+	UINT GetPairCount()const { return mPairCount; }
+	UINT GetTouchingCount()const { return mTouchingCount; }
+	UINT GetCellCount()const { return (UINT)mCells.size(); }
+
+	const Stats& GetStats()const { return mStats; }
+
+	// The world space box a shape is kept under, and the narrow phase test.
+	static void ComputeBounds(const CollisionShape& shape, XMFLOAT3* pMin, XMFLOAT3* pMax);
+	static BOOL Intersect(const CollisionShape& a, const CollisionShape& b);
+
+private:
+	struct Endpoint
+	{
+		float Value;
+
+		// Handle << 1, plus 1 for a maximum.
+		UINT Data;
+	};
+
+	// A proxy in one cell.
+	struct Handle
+	{
+		UINT Proxy;
+		UINT Cell;
+
+		// Next handle of the proxy.
+		UINT Next;
+
+		// Where the endpoints of the handle are in each list of the cell.
+		UINT MinIndex[3];
+		UINT MaxIndex[3];
+	};
+
+	struct Cell
+	{
+		int Coord[3];
+		std::vector<Endpoint> Endpoints[3];
+
+		// Live handles, and of those the ones added since the last Update.
+		UINT HandleCount;
+		UINT AddedCount;
+
+		// Handles sent to the end of the lists, to be dropped by the next Update.
+		UINT DeadCount;
+
+		// Swaps the last insertion sort of the lists made or, after a rebuild,
+		// about as many as it would have made.
+		UINT Disorder;
+
+		bool Dirty;
+	};
+
+	struct Proxy
+	{
+		CollisionShape Shape;
+		float Min[3];
+		float Max[3];
+
+		// The cells the box reaches into.
+		int CellMin[3];
+		int CellMax[3];
+
+		UINT FirstHandle;
+
+		bool Alive;
+		bool Moved;
+	};
+
+	// A box copied out for the sweep of RebuildCell, its axes starting with
+	// the one swept along.
+	struct SweepBox
+	{
+		float Min[3];
+		float Max[3];
+		UINT Proxy;
+	};
+
+	struct Pair
+	{
+		UINT ProxyA;
+		UINT ProxyB;
+		bool Alive;
+		bool Touching;
+
+		// Not yet through the narrow phase.
+		bool Fresh;
+	};
+
+	static const UINT InvalidIndex = 0xffffffff;
+
+	static UINT64 PairKey(UINT a, UINT b);
+
+	void SetBounds(UINT proxy);
+	UINT FindCell(int x, int y, int z);
+	void AddHandle(UINT proxy, UINT cell);
+	void KillHandle(UINT handle);
+	void MarkDirty(UINT cell);
+
+	void SortCell(UINT cell);
+	void RebuildCell(UINT cell);
+
+	bool Overlaps(UINT a, UINT b)const;
+	void AddPair(UINT a, UINT b);
+	void FreePair(UINT pair);
+
+private:
+	float mCellSize;
+
+	std::vector<Proxy> mProxies;
+	std::vector<UINT> mFreeProxies;
+
+	// Proxies removed and moved since the last Update.  The ids of removed
+	// proxies are freed by it.
+	std::vector<UINT> mRemovedProxies;
+	std::vector<UINT> mMovedProxies;
+
+	std::vector<Handle> mHandles;
+	std::vector<UINT> mFreeHandles;
+
+	// Handles whose endpoints are still in the lists, freed by the next Update.
+	std::vector<UINT> mDeadHandles;
+
+	std::vector<Cell> mCells;
+	std::unordered_map<UINT64, UINT> mCellIndex;
+	std::vector<UINT> mDirtyCells;
+	std::vector<SweepBox> mSweepBoxes;
+
+	std::vector<Pair> mPairs;
+	std::vector<UINT> mFreePairs;
+	std::unordered_map<UINT64, UINT> mPairIndex;
+
+	// Pairs to test in the narrow phase, and what the tests found.
+	std::vector<UINT> mNarrowPairs;
+	std::vector<BYTE> mNarrowResults;
+
+	std::vector<PairEvent> mBeginEvents;
+	std::vector<PairEvent> mEndEvents;
+
+	UINT mProxyCount;
+	UINT mPairCount;
+	UINT mTouchingCount;
+
+	Stats mStats;
+};
+
+#endif // SWEEPANDPRUNE_H
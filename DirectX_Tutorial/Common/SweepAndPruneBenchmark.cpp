@@ -0,0 +1,372 @@
+//***************************************************************************************
+// SweepAndPruneBenchmark.cpp
+//
+// Headless benchmark of the SweepAndPrune broad phase.  A mix of spheres,
+// axis-aligned boxes and spinning oriented boxes drifts about a cube, bouncing
+// off its walls, and every tenth frame a hundredth of them are removed and as
+// many new ones added.  It reports, averaged over the frames,
+//   -the pairs whose bounds overlap, the pairs that touch, and the begin and
+//    end events,
+//   -the endpoint swaps and time of SweepAndPrune::Update with a single set of
+//    lists (for the smaller scenes) and with a grid of cells,
+//   -the time of sorting and sweeping every box from scratch and testing every
+//    pair found, as a broad phase without memory of the last frame would,
+//   -for the smaller scenes, the time of testing every pair of bodies, once.
+// The touching pairs obtained by applying the begin and end events must be
+// exactly the ones the sweep from scratch finds, every frame, and an end event
+// must name the pair id and proxies its begin event did.  Returns 1 otherwise.
+//
+// Build with:
+//   cl /EHsc /O2 xnacollision.cpp JobSystem.cpp SweepAndPrune.cpp SweepAndPruneBenchmark.cpp
+//
+// Usage: SweepAndPruneBenchmark [bodies ...]      (default 10000 30000 100000)
+//***************************************************************************************
+
+#include <Windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+#include "JobSystem.h"
+#include "SweepAndPrune.h"
+
+using namespace XNA;
+
+namespace
+{
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	float RandF(UINT& state)
+	{
+		state = state*1664525u + 1013904223u;
+		return (state >> 8) / 16777216.0f;
+	}
+
+	const UINT FrameCount = 60;
+
+	// Largest scenes the single set of lists and the all pairs test are timed on.
+	const UINT SingleListLimit = 30000;
+	const UINT AllPairsLimit = 20000;
+
+	// A few times the size of a body.
+	const float CellSize = 8.0f;
+
+	struct Body
+	{
+		CollisionShape Shape;
+		XMFLOAT3 Velocity;
+		XMFLOAT4 Spin;          // rotation per frame, for oriented boxes
+		UINT Proxy[2];          // in the single list and grid broad phases
+	};
+
+	Body MakeBody(UINT& random, float side)
+	{
+		Body b;
+		b.Shape.Type = (CollisionShapeType)((UINT)(3.0f*RandF(random)) % 3);
+
+		b.Shape.Center = XMFLOAT3(side*(RandF(random) - 0.5f), side*(RandF(random) - 0.5f), side*(RandF(random) - 0.5f));
+		b.Shape.Extents = XMFLOAT3(0.5f + RandF(random), 0.5f + RandF(random), 0.5f + RandF(random));
+		XMStoreFloat4(&b.Shape.Orientation, XMQuaternionRotationAxis(
+			XMVectorSet(RandF(random) - 0.5f, RandF(random) - 0.5f, RandF(random) - 0.5f, 0.0f), XM_2PI*RandF(random)));
+
+		b.Velocity = XMFLOAT3(0.4f*(RandF(random) - 0.5f), 0.4f*(RandF(random) - 0.5f), 0.4f*(RandF(random) - 0.5f));
+		XMStoreFloat4(&b.Spin, XMQuaternionRotationAxis(
+			XMVectorSet(RandF(random) - 0.5f, RandF(random) - 0.5f, RandF(random) - 0.5f, 0.0f), 0.05f*RandF(random)));
+		b.Proxy[0] = b.Proxy[1] = 0;
+		return b;
+	}
+
+	void MoveBody(Body& b, float side)
+	{
+		float* position = &b.Shape.Center.x;
+		float* velocity = &b.Velocity.x;
+		for(UINT axis = 0; axis < 3; ++axis)
+		{
+			position[axis] += velocity[axis];
+			if( fabsf(position[axis]) > 0.5f*side )
+				velocity[axis] = -velocity[axis];
+		}
+
+		if( b.Shape.Type == CollisionOrientedBox )
+		{
+			XMVECTOR q = XMQuaternionMultiply(XMLoadFloat4(&b.Shape.Orientation), XMLoadFloat4(&b.Spin));
+			XMStoreFloat4(&b.Shape.Orientation, XMQuaternionNormalize(q));
+		}
+	}
+
+	struct SweepBox
+	{
+		XMFLOAT3 Min;
+		XMFLOAT3 Max;
+		UINT Body;
+	};
+
+	// The broad phase from scratch: sort the boxes on x and sweep, testing the
+	// shapes of every pair whose boxes overlap.  Returns the touching pairs of
+	// bodies.
+	void SweepFromScratch(const std::vector<Body>& bodies, std::vector<SweepBox>& boxes,
+		std::vector<std::pair<UINT, UINT>>& touching)
+	{
+		boxes.resize(bodies.size());
+		for(UINT i = 0; i < (UINT)bodies.size(); ++i)
+		{
+			SweepAndPrune::ComputeBounds(bodies[i].Shape, &boxes[i].Min, &boxes[i].Max);
+			boxes[i].Body = i;
+		}
+
+		std::sort(boxes.begin(), boxes.end(), [](const SweepBox& a, const SweepBox& b) { return a.Min.x < b.Min.x; });
+
+		touching.clear();
+		for(size_t i = 0; i < boxes.size(); ++i)
+		{
+			const SweepBox& a = boxes[i];
+			for(size_t j = i + 1; j < boxes.size() && boxes[j].Min.x <= a.Max.x; ++j)
+			{
+				const SweepBox& b = boxes[j];
+				if( a.Min.y <= b.Max.y && b.Min.y <= a.Max.y && a.Min.z <= b.Max.z && b.Min.z <= a.Max.z &&
+					SweepAndPrune::Intersect(bodies[a.Body].Shape, bodies[b.Body].Shape) )
+				{
+					touching.push_back(std::make_pair(a.Body, b.Body));
+				}
+			}
+		}
+	}
+
+	UINT AllPairs(const std::vector<Body>& bodies)
+	{
+		UINT touching = 0;
+		for(size_t i = 0; i < bodies.size(); ++i)
+		{
+			for(size_t j = i + 1; j < bodies.size(); ++j)
+			{
+				if( SweepAndPrune::Intersect(bodies[i].Shape, bodies[j].Shape) )
+					++touching;
+			}
+		}
+		return touching;
+	}
+
+	UINT64 Key(UINT a, UINT b)
+	{
+		return ((UINT64)std::min(a, b) << 32) | std::max(a, b);
+	}
+
+	// A broad phase under test, with the touching pairs its events tell of.
+	struct Tracker
+	{
+		SweepAndPrune* Sap;
+		std::unordered_map<UINT, std::pair<UINT, UINT>> Touching;
+
+		double Time;
+		double Swaps;
+	};
+
+	// Applies the events of the last Update and compares the touching pairs
+	// with those found from scratch.  Returns the number of errors.
+	UINT Check(Tracker& tracker, UINT index, const std::vector<Body>& bodies,
+		const std::vector<std::pair<UINT, UINT>>& touching)
+	{
+		UINT errors = 0;
+		const SweepAndPrune& sap = *tracker.Sap;
+
+		const std::vector<SweepAndPrune::PairEvent>& ends = sap.GetEndEvents();
+		for(size_t i = 0; i < ends.size(); ++i)
+		{
+			std::unordered_map<UINT, std::pair<UINT, UINT>>::iterator it = tracker.Touching.find(ends[i].Pair);
+			if( it == tracker.Touching.end() || it->second != std::make_pair(ends[i].ProxyA, ends[i].ProxyB) )
+				++errors;
+			else
+				tracker.Touching.erase(it);
+		}
+
+		const std::vector<SweepAndPrune::PairEvent>& begins = sap.GetBeginEvents();
+		for(size_t i = 0; i < begins.size(); ++i)
+		{
+			std::pair<UINT, UINT> proxies(begins[i].ProxyA, begins[i].ProxyB);
+			if( begins[i].ProxyA >= begins[i].ProxyB || !sap.IsTouching(begins[i].Pair) ||
+				!tracker.Touching.insert(std::make_pair(begins[i].Pair, proxies)).second )
+			{
+				++errors;
+			}
+		}
+
+		std::vector<UINT64> expected, actual;
+		for(size_t i = 0; i < touching.size(); ++i)
+			expected.push_back(Key(bodies[touching[i].first].Proxy[index], bodies[touching[i].second].Proxy[index]));
+
+		std::unordered_map<UINT, std::pair<UINT, UINT>>::const_iterator it;
+		for(it = tracker.Touching.begin(); it != tracker.Touching.end(); ++it)
+			actual.push_back(Key(it->second.first, it->second.second));
+
+		std::sort(expected.begin(), expected.end());
+		std::sort(actual.begin(), actual.end());
+
+		if( actual != expected || sap.GetTouchingCount() != (UINT)expected.size() ||
+			sap.GetProxyCount() != (UINT)bodies.size() )
+		{
+			++errors;
+		}
+		return errors;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<UINT> counts;
+	for(int i = 1; i < argc; ++i)
+		counts.push_back((UINT)std::max(2, atoi(argv[i])));
+	if( counts.empty() )
+	{
+		counts.push_back(10000);
+		counts.push_back(30000);
+		counts.push_back(100000);
+	}
+
+	JobSystem jobSystem;
+
+	printf("%-8s %7s %8s %8s %7s %11s %9s %11s %9s %9s %8s %9s %8s\n", "bodies", "cells", "pairs", "touching",
+		"events", "list swaps", "list ms", "grid swaps", "grid ms", "sweep ms", "speedup", "all ms", "mismatch");
+
+	bool passed = true;
+
+	for(size_t c = 0; c < counts.size(); ++c)
+	{
+		UINT count = counts[c];
+
+		// About four bodies per thousand cubic units, a few contacts each.
+		float side = powf(250.0f*count, 1.0f/3.0f);
+
+		UINT random = 24680;
+		std::vector<Body> bodies(count);
+		for(UINT i = 0; i < count; ++i)
+			bodies[i] = MakeBody(random, side);
+
+		// The single set of lists, where it finishes in reasonable time, and the grid.
+		SweepAndPrune singleList;
+		SweepAndPrune grid(CellSize);
+		UINT trackerCount = count <= SingleListLimit ? 2 : 1;
+
+		Tracker trackers[2];
+		trackers[0].Sap = &grid;
+		trackers[1].Sap = &singleList;
+		for(UINT k = 0; k < 2; ++k)
+		{
+			trackers[k].Time = 0.0;
+			trackers[k].Swaps = 0.0;
+		}
+
+		for(UINT i = 0; i < count; ++i)
+		{
+			for(UINT k = 0; k < trackerCount; ++k)
+				bodies[i].Proxy[k] = trackers[k].Sap->AddProxy(bodies[i].Shape);
+		}
+
+		std::vector<SweepBox> sweepBoxes;
+		std::vector<std::pair<UINT, UINT>> touchingPairs;
+
+		double sweepTime = 0.0;
+		double pairs = 0.0, touching = 0.0, events = 0.0;
+		UINT mismatches = 0;
+
+		// Frame 0 adds every body; the rest are timed.
+		for(UINT f = 0; f <= FrameCount; ++f)
+		{
+			if( f > 0 )
+			{
+				for(UINT i = 0; i < count; ++i)
+				{
+					MoveBody(bodies[i], side);
+					for(UINT k = 0; k < trackerCount; ++k)
+						trackers[k].Sap->MoveProxy(bodies[i].Proxy[k], bodies[i].Shape);
+				}
+
+				// Every tenth frame replace a hundredth of the bodies.
+				if( f % 10 == 0 )
+				{
+					for(UINT n = 0; n < count / 100; ++n)
+					{
+						UINT i = (UINT)(RandF(random)*count) % count;
+						Body body = MakeBody(random, side);
+
+						for(UINT k = 0; k < trackerCount; ++k)
+						{
+							trackers[k].Sap->RemoveProxy(bodies[i].Proxy[k]);
+							body.Proxy[k] = trackers[k].Sap->AddProxy(body.Shape);
+
+							// A new proxy never reuses the id of one removed before
+							// the same Update.
+							if( body.Proxy[k] == bodies[i].Proxy[k] )
+								++mismatches;
+						}
+						bodies[i] = body;
+					}
+				}
+			}
+
+			for(UINT k = 0; k < trackerCount; ++k)
+			{
+				double start = Now();
+				trackers[k].Sap->Update(&jobSystem);
+				double updateTime = Now() - start;
+
+				if( f > 0 )
+				{
+					trackers[k].Time += updateTime;
+					trackers[k].Swaps += trackers[k].Sap->GetStats().Swaps;
+				}
+			}
+
+			double start = Now();
+			SweepFromScratch(bodies, sweepBoxes, touchingPairs);
+			double fromScratchTime = Now() - start;
+
+			if( f > 0 )
+			{
+				sweepTime += fromScratchTime;
+				pairs += grid.GetPairCount();
+				touching += grid.GetTouchingCount();
+				events += grid.GetBeginEvents().size() + grid.GetEndEvents().size();
+			}
+
+			for(UINT k = 0; k < trackerCount; ++k)
+				mismatches += Check(trackers[k], k, bodies, touchingPairs);
+		}
+
+		// Testing every pair, where it can finish.
+		char allPairs[32] = "-";
+		if( count <= AllPairsLimit )
+		{
+			double start = Now();
+			UINT allTouching = AllPairs(bodies);
+			snprintf(allPairs, sizeof(allPairs), "%.1f", (Now() - start)*1000.0);
+
+			if( allTouching != grid.GetTouchingCount() )
+				++mismatches;
+		}
+
+		char listSwaps[32] = "-", listTime[32] = "-";
+		if( trackerCount > 1 )
+		{
+			snprintf(listSwaps, sizeof(listSwaps), "%.0f", trackers[1].Swaps/FrameCount);
+			snprintf(listTime, sizeof(listTime), "%.3f", trackers[1].Time*1000.0/FrameCount);
+		}
+
+		printf("%-8u %7u %8.0f %8.0f %7.0f %11s %9s %11.0f %9.3f %9.3f %8.1f %9s %8u\n", count, grid.GetCellCount(),
+			pairs/FrameCount, touching/FrameCount, events/FrameCount, listSwaps, listTime, trackers[0].Swaps/FrameCount,
+			trackers[0].Time*1000.0/FrameCount, sweepTime*1000.0/FrameCount, sweepTime/trackers[0].Time, allPairs,
+			mismatches);
+
+		if( mismatches > 0 )
+			passed = false;
+	}
+
+	printf("\n%s\n", passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,273 @@
+//***************************************************************************************
+// SweepBenchmark.cpp
+//
+// Headless benchmark of the swept intersection routines of xnacollision:
+// IntersectSweptSphereTriangle, IntersectSweptSphereAxisAlignedBox and
+// IntersectSweptOrientedBoxOrientedBox.  Random movers are aimed near random
+// targets, fast enough that most cross several times their own size in one
+// step.  For every routine it reports
+//   -sweeps per second, and tests per second of the static routine at 4 and 16
+//    substeps, which is what a sweep replaces,
+//   -the share of sweeps that hit, and of those the share that 4 and 16
+//    substeps miss: the movers that would tunnel.
+//
+// Every sweep is checked against the static routine: at the time of a hit the
+// mover grown by a thousandth must intersect, and at 1024 times before it
+// (over the whole step for a miss) the mover shrunk by as much must not.  The
+// normal must be of unit length and face against the closing velocity.
+// Returns 1 if any sweep fails.
+//
+// Build with:
+//   cl /EHsc /O2 xnacollision.cpp JobSystem.cpp SweepBenchmark.cpp
+//
+// Usage: SweepBenchmark [sweeps]      (default 100000)
+//***************************************************************************************
+
+#include <Windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "xnacollision.h"
+
+using namespace XNA;
+
+namespace
+{
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	float RandF(UINT& state)
+	{
+		state = state*1664525u + 1013904223u;
+		return (state >> 8) / 16777216.0f;
+	}
+
+	float RandF(UINT& state, float lo, float hi)
+	{
+		return lo + (hi - lo)*RandF(state);
+	}
+
+	XMVECTOR RandVector(UINT& state, float lo, float hi)
+	{
+		return XMVectorSet(RandF(state, lo, hi), RandF(state, lo, hi), RandF(state, lo, hi), 0.0f);
+	}
+
+	XMVECTOR RandOrientation(UINT& state)
+	{
+		return XMQuaternionNormalize(XMVectorSet(RandF(state, -1.0f, 1.0f), RandF(state, -1.0f, 1.0f),
+			RandF(state, -1.0f, 1.0f), RandF(state, -1.0f, 1.0f)));
+	}
+
+	const float Epsilon = 1e-3f;
+	const UINT CheckSamples = 1024;
+
+	// One mover and its target.  Sweep is the swept routine; Touches is the
+	// static routine at time t with the mover grown by grow.
+	struct Case
+	{
+		Sphere MovingSphere;
+		OrientedBox MovingBox;
+		XMFLOAT3 Velocity;
+
+		XMFLOAT3 Triangle[3];
+		AxisAlignedBox TargetBox;
+		OrientedBox TargetOrientedBox;
+		XMFLOAT3 TargetVelocity;
+	};
+
+	enum Kind
+	{
+		SphereTriangle,
+		SphereBox,
+		BoxBox
+	};
+
+	// A start point out to eight units from the origin, moving towards a
+	// point near the target and past it by up to twice as far.
+	void MakeCase(Kind kind, UINT& random, Case& c)
+	{
+		XMVECTOR start = RandVector(random, -8.0f, 8.0f);
+		XMVECTOR aim = RandVector(random, -2.5f, 2.5f);
+		XMStoreFloat3(&c.Velocity, (aim - start)*RandF(random, 0.5f, 2.0f));
+
+		XMStoreFloat3(&c.MovingSphere.Center, start);
+		c.MovingSphere.Radius = RandF(random, 0.05f, 1.0f);
+
+		XMStoreFloat3(&c.MovingBox.Center, start);
+		XMStoreFloat3(&c.MovingBox.Extents, RandVector(random, 0.05f, 1.0f));
+		XMStoreFloat4(&c.MovingBox.Orientation, RandOrientation(random));
+
+		for(;;)
+		{
+			for(UINT k = 0; k < 3; ++k)
+				XMStoreFloat3(&c.Triangle[k], RandVector(random, -2.0f, 2.0f));
+
+			XMVECTOR n = XMVector3Cross(XMLoadFloat3(&c.Triangle[1]) - XMLoadFloat3(&c.Triangle[0]),
+				XMLoadFloat3(&c.Triangle[2]) - XMLoadFloat3(&c.Triangle[0]));
+			if( XMVectorGetX(XMVector3Length(n)) > 0.1f )
+				break;
+		}
+
+		XMStoreFloat3(&c.TargetBox.Center, RandVector(random, -0.5f, 0.5f));
+		XMStoreFloat3(&c.TargetBox.Extents, RandVector(random, 0.1f, 2.0f));
+
+		c.TargetOrientedBox.Center = c.TargetBox.Center;
+		c.TargetOrientedBox.Extents = c.TargetBox.Extents;
+		XMStoreFloat4(&c.TargetOrientedBox.Orientation, RandOrientation(random));
+		XMStoreFloat3(&c.TargetVelocity, kind == BoxBox ? RandVector(random, -2.0f, 2.0f) : XMVectorZero());
+	}
+
+	BOOL Sweep(Kind kind, const Case& c, FLOAT* t, XMVECTOR* normal)
+	{
+		XMVECTOR v = XMLoadFloat3(&c.Velocity);
+		switch( kind )
+		{
+		case SphereTriangle:
+			return IntersectSweptSphereTriangle(&c.MovingSphere, v, XMLoadFloat3(&c.Triangle[0]),
+				XMLoadFloat3(&c.Triangle[1]), XMLoadFloat3(&c.Triangle[2]), t, normal);
+		case SphereBox:
+			return IntersectSweptSphereAxisAlignedBox(&c.MovingSphere, v, &c.TargetBox, t, normal);
+		default:
+			return IntersectSweptOrientedBoxOrientedBox(&c.MovingBox, v, &c.TargetOrientedBox,
+				XMLoadFloat3(&c.TargetVelocity), t, normal);
+		}
+	}
+
+	BOOL Touches(Kind kind, const Case& c, float t, float grow)
+	{
+		XMVECTOR move = t*XMLoadFloat3(&c.Velocity);
+
+		if( kind == BoxBox )
+		{
+			OrientedBox a = c.MovingBox;
+			OrientedBox b = c.TargetOrientedBox;
+			XMStoreFloat3(&a.Center, XMLoadFloat3(&a.Center) + move);
+			XMStoreFloat3(&a.Extents, XMLoadFloat3(&a.Extents) + XMVectorReplicate(grow));
+			XMStoreFloat3(&b.Center, XMLoadFloat3(&b.Center) + t*XMLoadFloat3(&c.TargetVelocity));
+			return IntersectOrientedBoxOrientedBox(&a, &b);
+		}
+
+		Sphere s = c.MovingSphere;
+		XMStoreFloat3(&s.Center, XMLoadFloat3(&s.Center) + move);
+		s.Radius += grow;
+
+		if( kind == SphereTriangle )
+		{
+			return IntersectTriangleSphere(XMLoadFloat3(&c.Triangle[0]), XMLoadFloat3(&c.Triangle[1]),
+				XMLoadFloat3(&c.Triangle[2]), &s);
+		}
+		return IntersectSphereAxisAlignedBox(&s, &c.TargetBox);
+	}
+
+	// Whether some of n + 1 evenly spaced steps from time 0 to 1 intersect.
+	BOOL Substep(Kind kind, const Case& c, UINT n)
+	{
+		for(UINT k = 0; k <= n; ++k)
+		{
+			if( Touches(kind, c, (float)k / n, 0.0f) )
+				return TRUE;
+		}
+		return FALSE;
+	}
+
+	bool Check(Kind kind, const Case& c)
+	{
+		FLOAT t;
+		XMVECTOR normal;
+		BOOL hit = Sweep(kind, c, &t, &normal);
+
+		// A sweep that starts in contact has nothing before it to check.
+		float end = hit ? t : 1.0f;
+		for(UINT k = 0; k < CheckSamples && end > 0.0f; ++k)
+		{
+			if( Touches(kind, c, end*k / CheckSamples, -Epsilon) )
+				return false;
+		}
+
+		if( !hit )
+			return !Touches(kind, c, 1.0f, -Epsilon);
+
+		if( t < 0.0f || t > 1.0f || !Touches(kind, c, t, Epsilon) )
+			return false;
+
+		// The normal points from the target to the mover, so a mover that
+		// arrives after the start moves against it.
+		XMVECTOR closing = XMLoadFloat3(&c.Velocity) - XMLoadFloat3(&c.TargetVelocity);
+		if( t > 0.0f && XMVectorGetX(XMVector3Dot(normal, closing)) > 1e-4f )
+			return false;
+
+		float length = XMVectorGetX(XMVector3Length(normal));
+		return fabsf(length - 1.0f) < 1e-3f;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	UINT sweepCount = argc > 1 ? (UINT)std::max(1, atoi(argv[1])) : 100000;
+
+	const char* names[3] = { "sphere/triangle", "sphere/aabb", "obb/obb" };
+
+	printf("%u sweeps per routine\n\n", sweepCount);
+	printf("%-16s %12s %12s %12s %8s %10s %10s %8s\n", "routine", "sweeps/s", "4 steps/s", "16 steps/s",
+		"hits", "4 miss", "16 miss", "failed");
+
+	bool passed = true;
+
+	for(UINT k = 0; k < 3; ++k)
+	{
+		Kind kind = (Kind)k;
+
+		std::vector<Case> cases(sweepCount);
+		UINT random = 13579 + k;
+		for(UINT i = 0; i < sweepCount; ++i)
+			MakeCase(kind, random, cases[i]);
+
+		UINT hits = 0;
+		double start = Now();
+		for(UINT i = 0; i < sweepCount; ++i)
+		{
+			FLOAT t;
+			XMVECTOR normal;
+			hits += Sweep(kind, cases[i], &t, &normal) ? 1 : 0;
+		}
+		double sweepTime = Now() - start;
+
+		UINT hits4 = 0;
+		start = Now();
+		for(UINT i = 0; i < sweepCount; ++i)
+			hits4 += Substep(kind, cases[i], 4) ? 1 : 0;
+		double time4 = Now() - start;
+
+		UINT hits16 = 0;
+		start = Now();
+		for(UINT i = 0; i < sweepCount; ++i)
+			hits16 += Substep(kind, cases[i], 16) ? 1 : 0;
+		double time16 = Now() - start;
+
+		// Substeps only find contacts the sweep finds too, so the difference
+		// is what they let through.  The checks are slow; run them on a part.
+		UINT failed = 0;
+		UINT checked = std::min(sweepCount, 20000u);
+		for(UINT i = 0; i < checked; ++i)
+		{
+			if( !Check(kind, cases[i]) )
+				++failed;
+		}
+
+		printf("%-16s %12.0f %12.0f %12.0f %7.1f%% %9.1f%% %9.1f%% %8u\n", names[k], sweepCount/sweepTime,
+			sweepCount/time4, sweepCount/time16, 100.0*hits/sweepCount, hits ? 100.0*(hits - hits4)/hits : 0.0,
+			hits ? 100.0*(hits - hits16)/hits : 0.0, failed);
+
+		if( failed > 0 || hits4 > hits || hits16 > hits )
+			passed = false;
+	}
+
+	printf("\n%s\n", passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
@@ -3,14 +3,34 @@
 //***************************************************************************************
 
 #include "Waves.h"
+#include "JobSystem.h"
 #include <algorithm>
 #include <vector>
 #include <cassert>
+#include <cmath>
+
+namespace
+{
+	// Rows of the grid handed to one job by Update().
+	const UINT RowsPerJob = 16;
+
+	XMVECTOR LoadFloats(const float* p)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+	}
+
+	void StoreFloats(float* p, FXMVECTOR v)
+	{
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p), v);
+	}
+}
 
 Waves::Waves()
 : mNumRows(0), mNumCols(0), mVertexCount(0), mTriangleCount(0), 
   mK1(0.0f), mK2(0.0f), mK3(0.0f), mTimeStep(0.0f), mSpatialStep(0.0f),
-  mPrevSolution(0), mCurrSolution(0), mNormals(0), mTangentX(0)
+  mTimeAccumulator(0.0f), mMaxSubsteps(4), mSolver(Solver_Simd),
+  mPrevSolution(0), mCurrSolution(0), mRowPitch(0), mPrevHeights(0), mCurrHeights(0),
+  mNormals(0), mTangentX(0), mJobSystem(0)
 {
 }
 
@@ -18,6 +38,8 @@ Waves::~Waves()
 {
 	delete[] mPrevSolution;
 	delete[] mCurrSolution;
+	delete[] mPrevHeights;
+	delete[] mCurrHeights;
 	delete[] mNormals;
 	delete[] mTangentX;
 }
@@ -52,7 +74,61 @@ float Waves::Depth()const
 	return mNumRows*mSpatialStep;
 }
 
-void Waves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping)
+XMFLOAT3 Waves::operator[](int i)const
+{
+	if( mSolver == Solver_Scalar )
+		return mCurrSolution[i];
+
+	// Only the heights are stored; x and z follow from the grid point.
+	UINT row = i / mNumCols;
+	UINT col = i % mNumCols;
+
+	float halfWidth = (mNumCols-1)*mSpatialStep*0.5f;
+	float halfDepth = (mNumRows-1)*mSpatialStep*0.5f;
+
+	return XMFLOAT3(-halfWidth + col*mSpatialStep, mCurrHeights[row*mRowPitch+col], halfDepth - row*mSpatialStep);
+}
+
+XMFLOAT3 Waves::Interpolated(int i)const
+{
+	float s = InterpolationFactor();
+
+	if( mSolver == Solver_Scalar )
+	{
+		XMVECTOR prev = XMLoadFloat3(&mPrevSolution[i]);
+		XMVECTOR curr = XMLoadFloat3(&mCurrSolution[i]);
+
+		XMFLOAT3 p;
+		XMStoreFloat3(&p, XMVectorLerp(prev, curr, s));
+		return p;
+	}
+
+	UINT k = (i / mNumCols)*mRowPitch + i % mNumCols;
+
+	XMFLOAT3 p = (*this)[i];
+	p.y = mPrevHeights[k] + s*(mCurrHeights[k] - mPrevHeights[k]);
+	return p;
+}
+
+float Waves::InterpolationFactor()const
+{
+	return mTimeStep > 0.0f ? mTimeAccumulator / mTimeStep : 0.0f;
+}
+
+float Waves::Height(int i)const
+{
+	if( mSolver == Solver_Scalar )
+		return mCurrSolution[i].y;
+
+	return mCurrHeights[(i / mNumCols)*mRowPitch + i % mNumCols];
+}
+
+void Waves::SetJobSystem(JobSystem* jobSystem)
+{
+	mJobSystem = jobSystem;
+}
+
+void Waves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping, Solver solver)
 {
 	mNumRows  = m;
 	mNumCols  = n;
@@ -62,6 +138,9 @@ void Waves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping)
 
 	mTimeStep    = dt;
 	mSpatialStep = dx;
+	mSolver      = solver;
+
+	mTimeAccumulator = 0.0f;
 
 	float d = damping*dt+2.0f;
 	float e = (speed*speed)*(dt*dt)/(dx*dx);
@@ -72,13 +151,30 @@ void Waves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping)
 	// In case Init() called again.
 	delete[] mPrevSolution;
 	delete[] mCurrSolution;
+	delete[] mPrevHeights;
+	delete[] mCurrHeights;
 	delete[] mNormals;
 	delete[] mTangentX;
 
-	mPrevSolution = new XMFLOAT3[m*n];
-	mCurrSolution = new XMFLOAT3[m*n];
-	mNormals      = new XMFLOAT3[m*n];
-	mTangentX     = new XMFLOAT3[m*n];
+	mPrevSolution = 0;
+	mCurrSolution = 0;
+	mPrevHeights  = 0;
+	mCurrHeights  = 0;
+
+	if( mSolver == Solver_Scalar )
+	{
+		mPrevSolution = new XMFLOAT3[m*n];
+		mCurrSolution = new XMFLOAT3[m*n];
+	}
+	else
+	{
+		mRowPitch    = (n + 3) & ~3u;
+		mPrevHeights = new float[m*mRowPitch]();
+		mCurrHeights = new float[m*mRowPitch]();
+	}
+
+	mNormals  = new XMFLOAT3[m*n];
+	mTangentX = new XMFLOAT3[m*n];
 
 	// Generate grid vertices in system memory.
 
@@ -91,79 +187,291 @@ void Waves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping)
 		{
 			float x = -halfWidth + j*dx;
 
-			mPrevSolution[i*n+j] = XMFLOAT3(x, 0.0f, z);
-			mCurrSolution[i*n+j] = XMFLOAT3(x, 0.0f, z);
+			if( mSolver == Solver_Scalar )
+			{
+				mPrevSolution[i*n+j] = XMFLOAT3(x, 0.0f, z);
+				mCurrSolution[i*n+j] = XMFLOAT3(x, 0.0f, z);
+			}
 			mNormals[i*n+j]      = XMFLOAT3(0.0f, 1.0f, 0.0f);
 			mTangentX[i*n+j]     = XMFLOAT3(1.0f, 0.0f, 0.0f);
 		}
 	}
 }
 
-void Waves::Update(float dt)
+UINT Waves::Update(float dt)
 {
-	static float t = 0;
-
 	// Accumulate time.
-	t += dt;
+	mTimeAccumulator += dt;
 
 	// Only update the simulation at the specified time step.
-	if( t >= mTimeStep )
+	UINT stepCount = 0;
+	while( mTimeAccumulator >= mTimeStep && stepCount < mMaxSubsteps )
+	{
+		Step();
+
+		mTimeAccumulator -= mTimeStep;
+		++stepCount;
+	}
+
+	// Drop whatever the substep limit left over; the simulation slows down
+	// instead of falling further behind every frame.
+	if( mTimeAccumulator >= mTimeStep )
+		mTimeAccumulator = std::fmod(mTimeAccumulator, mTimeStep);
+
+	return stepCount;
+}
+
+void Waves::SetMaxSubsteps(UINT maxSubsteps)
+{
+	mMaxSubsteps = maxSubsteps;
+}
+
+void Waves::Step()
+{
+	if( mSolver == Solver_Scalar )
+		UpdateScalar();
+	else
+		UpdateSimd();
+}
+
+void Waves::UpdateScalar()
+{
+	// Only update interior points; we use zero boundary conditions.
+	// Rows only read the current solution, so any set of rows can be
+	// updated independently of the others.
+	if( mJobSystem )
+	{
+		mJobSystem->ParallelFor(1, mNumRows-1, RowsPerJob,
+			[this](UINT first, UINT last) { UpdateSolutionRows(first, last); });
+	}
+	else
+	{
+		UpdateSolutionRows(1, mNumRows-1);
+	}
+
+	// We just overwrote the previous buffer with the new data, so
+	// this data needs to become the current solution and the old
+	// current solution becomes the new previous solution.
+	std::swap(mPrevSolution, mCurrSolution);
+
+	//
+	// Compute normals using finite difference scheme.
+	//
+	if( mJobSystem )
+	{
+		mJobSystem->ParallelFor(1, mNumRows-1, RowsPerJob,
+			[this](UINT first, UINT last) { UpdateNormalRows(first, last); });
+	}
+	else
+	{
+		UpdateNormalRows(1, mNumRows-1);
+	}
+}
+
+void Waves::UpdateSolutionRows(UINT firstRow, UINT lastRow)
+{
+	for(UINT i = firstRow; i < lastRow; ++i)
 	{
-		// Only update interior points; we use zero boundary conditions.
-		for(UINT i = 1; i < mNumRows-1; ++i)
+		for(UINT j = 1; j < mNumCols-1; ++j)
 		{
-			for(UINT j = 1; j < mNumCols-1; ++j)
-			{
-				// After this update we will be discarding the old previous
-				// buffer, so overwrite that buffer with the new update.
-				// Note how we can do this inplace (read/write to same element) 
-				// because we won't need prev_ij again and the assignment happens last.
-
-				// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-				// Moreover, our +z axis goes "down"; this is just to 
-				// keep consistent with our row indices going down.
-
-				mPrevSolution[i*mNumCols+j].y = 
-					mK1*mPrevSolution[i*mNumCols+j].y +
-					mK2*mCurrSolution[i*mNumCols+j].y +
-					mK3*(mCurrSolution[(i+1)*mNumCols+j].y + 
-					     mCurrSolution[(i-1)*mNumCols+j].y + 
-					     mCurrSolution[i*mNumCols+j+1].y + 
-						 mCurrSolution[i*mNumCols+j-1].y);
-			}
+			// After this update we will be discarding the old previous
+			// buffer, so overwrite that buffer with the new update.
+			// Note how we can do this inplace (read/write to same element) 
+			// because we won't need prev_ij again and the assignment happens last.
+
+			// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+			// Moreover, our +z axis goes "down"; this is just to 
+			// keep consistent with our row indices going down.
+
+			mPrevSolution[i*mNumCols+j].y = 
+				mK1*mPrevSolution[i*mNumCols+j].y +
+				mK2*mCurrSolution[i*mNumCols+j].y +
+				mK3*(mCurrSolution[(i+1)*mNumCols+j].y + 
+				     mCurrSolution[(i-1)*mNumCols+j].y + 
+				     mCurrSolution[i*mNumCols+j+1].y + 
+					 mCurrSolution[i*mNumCols+j-1].y);
+		}
+	}
+}
+
+void Waves::UpdateNormalRows(UINT firstRow, UINT lastRow)
+{
+	for(UINT i = firstRow; i < lastRow; ++i)
+	{
+		for(UINT j = 1; j < mNumCols-1; ++j)
+		{
+			float l = mCurrSolution[i*mNumCols+j-1].y;
+			float r = mCurrSolution[i*mNumCols+j+1].y;
+			float t = mCurrSolution[(i-1)*mNumCols+j].y;
+			float b = mCurrSolution[(i+1)*mNumCols+j].y;
+			mNormals[i*mNumCols+j].x = -r+l;
+			mNormals[i*mNumCols+j].y = 2.0f*mSpatialStep;
+			mNormals[i*mNumCols+j].z = b-t;
+
+			XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i*mNumCols+j]));
+			XMStoreFloat3(&mNormals[i*mNumCols+j], n);
+
+			mTangentX[i*mNumCols+j] = XMFLOAT3(2.0f*mSpatialStep, r-l, 0.0f);
+			XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i*mNumCols+j]));
+			XMStoreFloat3(&mTangentX[i*mNumCols+j], T);
 		}
+	}
+}
+
+void Waves::UpdateSimd()
+{
+	if( mNumRows < 3 )
+		return;
 
-		// We just overwrote the previous buffer with the new data, so
-		// this data needs to become the current solution and the old
-		// current solution becomes the new previous solution.
-		std::swap(mPrevSolution, mCurrSolution);
+	//
+	// The interior rows are split into bands of RowsPerJob rows.  A band
+	// updates its heights row by row and computes the normals of a row as soon
+	// as the rows on both sides of it are done, while they are still in cache.
+	// That leaves the first and last row of each band, whose neighbours belong
+	// to other bands; they are done once all bands have finished.
+	//
 
-		t = 0.0f; // reset time
+	UINT bandCount = (mNumRows-2 + RowsPerJob-1) / RowsPerJob;
 
-		//
-		// Compute normals using finite difference scheme.
-		//
-		for(UINT i = 1; i < mNumRows-1; ++i)
+	if( mJobSystem )
+	{
+		mJobSystem->ParallelFor(0, bandCount, 1, [this](UINT first, UINT last)
 		{
-			for(UINT j = 1; j < mNumCols-1; ++j)
-			{
-				float l = mCurrSolution[i*mNumCols+j-1].y;
-				float r = mCurrSolution[i*mNumCols+j+1].y;
-				float t = mCurrSolution[(i-1)*mNumCols+j].y;
-				float b = mCurrSolution[(i+1)*mNumCols+j].y;
-				mNormals[i*mNumCols+j].x = -r+l;
-				mNormals[i*mNumCols+j].y = 2.0f*mSpatialStep;
-				mNormals[i*mNumCols+j].z = b-t;
-
-				XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i*mNumCols+j]));
-				XMStoreFloat3(&mNormals[i*mNumCols+j], n);
-
-				mTangentX[i*mNumCols+j] = XMFLOAT3(2.0f*mSpatialStep, r-l, 0.0f);
-				XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i*mNumCols+j]));
-				XMStoreFloat3(&mTangentX[i*mNumCols+j], T);
-			}
+			for(UINT band = first; band < last; ++band)
+				UpdateHeightBand(band);
+		});
+	}
+	else
+	{
+		for(UINT band = 0; band < bandCount; ++band)
+			UpdateHeightBand(band);
+	}
+
+	// The new solution was written over the previous one; make it current.
+	std::swap(mPrevHeights, mCurrHeights);
+
+	auto updateBandEdges = [this](UINT firstBand, UINT lastBand)
+	{
+		for(UINT band = firstBand; band < lastBand; ++band)
+		{
+			UINT firstRow = 1 + band*RowsPerJob;
+			UINT lastRow  = std::min(firstRow + RowsPerJob, mNumRows-1);
+
+			UpdateNormalRow(mCurrHeights, firstRow);
+			if( lastRow-1 != firstRow )
+				UpdateNormalRow(mCurrHeights, lastRow-1);
+		}
+	};
+
+	if( mJobSystem )
+		mJobSystem->ParallelFor(0, bandCount, 0, updateBandEdges);
+	else
+		updateBandEdges(0, bandCount);
+}
+
+void Waves::UpdateHeightBand(UINT band)
+{
+	UINT firstRow = 1 + band*RowsPerJob;
+	UINT lastRow  = std::min(firstRow + RowsPerJob, mNumRows-1);
+
+	for(UINT i = firstRow; i < lastRow; ++i)
+	{
+		UpdateHeightRow(i);
+
+		// Row i-1 now has new heights on both sides.
+		if( i >= firstRow+2 )
+			UpdateNormalRow(mPrevHeights, i-1);
+	}
+}
+
+void Waves::UpdateHeightRow(UINT i)
+{
+	// Same stencil as UpdateSolutionRows, four grid points at a time; the new
+	// heights again overwrite the previous solution.
+	float* prev       = mPrevHeights + i*mRowPitch;
+	const float* curr = mCurrHeights + i*mRowPitch;
+	const float* up   = curr - mRowPitch;
+	const float* down = curr + mRowPitch;
+
+	XMVECTOR k1 = XMVectorReplicate(mK1);
+	XMVECTOR k2 = XMVectorReplicate(mK2);
+	XMVECTOR k3 = XMVectorReplicate(mK3);
+
+	UINT j = 1;
+	for(; j+4 <= mNumCols-1; j += 4)
+	{
+		XMVECTOR neighbours = LoadFloats(down+j) + LoadFloats(up+j) + LoadFloats(curr+j+1) + LoadFloats(curr+j-1);
+		StoreFloats(prev+j, k1*LoadFloats(prev+j) + k2*LoadFloats(curr+j) + k3*neighbours);
+	}
+
+	for(; j < mNumCols-1; ++j)
+		prev[j] = mK1*prev[j] + mK2*curr[j] + mK3*(down[j] + up[j] + curr[j+1] + curr[j-1]);
+}
+
+void Waves::UpdateNormalRow(const float* heights, UINT i)
+{
+	const float* row  = heights + i*mRowPitch;
+	const float* up   = row - mRowPitch;
+	const float* down = row + mRowPitch;
+
+	XMFLOAT3* normals  = mNormals + i*mNumCols;
+	XMFLOAT3* tangents = mTangentX + i*mNumCols;
+
+	XMVECTOR twoDx = XMVectorReplicate(2.0f*mSpatialStep);
+	XMVECTOR zero  = XMVectorZero();
+
+	UINT j = 1;
+	for(; j+4 <= mNumCols-1; j += 4)
+	{
+		XMVECTOR l = LoadFloats(row+j-1);
+		XMVECTOR r = LoadFloats(row+j+1);
+		XMVECTOR t = LoadFloats(up+j);
+		XMVECTOR b = LoadFloats(down+j);
+
+		// n = (l-r, 2dx, b-t) and tangent = (2dx, r-l, 0), normalized.
+		XMVECTOR nx = l - r;
+		XMVECTOR nz = b - t;
+		XMVECTOR nLength = XMVectorSqrt(nx*nx + twoDx*twoDx + nz*nz);
+
+		XMVECTOR ty = r - l;
+		XMVECTOR tLength = XMVectorSqrt(twoDx*twoDx + ty*ty);
+
+		// Transposing turns the component-per-register layout into one vector
+		// per grid point.
+		XMMATRIX n;
+		n.r[0] = nx / nLength;
+		n.r[1] = twoDx / nLength;
+		n.r[2] = nz / nLength;
+		n.r[3] = zero;
+		n = XMMatrixTranspose(n);
+
+		XMMATRIX T;
+		T.r[0] = twoDx / tLength;
+		T.r[1] = ty / tLength;
+		T.r[2] = zero;
+		T.r[3] = zero;
+		T = XMMatrixTranspose(T);
+
+		for(UINT k = 0; k < 4; ++k)
+		{
+			XMStoreFloat3(&normals[j+k], n.r[k]);
+			XMStoreFloat3(&tangents[j+k], T.r[k]);
 		}
 	}
+
+	for(; j < mNumCols-1; ++j)
+	{
+		float l = row[j-1];
+		float r = row[j+1];
+		float t = up[j];
+		float b = down[j];
+
+		XMVECTOR n = XMVector3Normalize(XMVectorSet(-r+l, 2.0f*mSpatialStep, b-t, 0.0f));
+		XMStoreFloat3(&normals[j], n);
+
+		XMVECTOR T = XMVector3Normalize(XMVectorSet(2.0f*mSpatialStep, r-l, 0.0f, 0.0f));
+		XMStoreFloat3(&tangents[j], T);
+	}
 }
 
 void Waves::Disturb(UINT i, UINT j, float magnitude)
@@ -174,6 +482,17 @@ void Waves::Disturb(UINT i, UINT j, float magnitude)
 
 	float halfMag = 0.5f*magnitude;
 
+	if( mSolver == Solver_Simd )
+	{
+		float* h = mCurrHeights;
+		h[i*mRowPitch+j]     += magnitude;
+		h[i*mRowPitch+j+1]   += halfMag;
+		h[i*mRowPitch+j-1]   += halfMag;
+		h[(i+1)*mRowPitch+j] += halfMag;
+		h[(i-1)*mRowPitch+j] += halfMag;
+		return;
+	}
+
 	// Disturb the ijth vertex height and its neighbors.
 	mCurrSolution[i*mNumCols+j].y     += magnitude;
 	mCurrSolution[i*mNumCols+j+1].y   += halfMag;
@@ -181,4 +500,10 @@ void Waves::Disturb(UINT i, UINT j, float magnitude)
 	mCurrSolution[(i+1)*mNumCols+j].y += halfMag;
 	mCurrSolution[(i-1)*mNumCols+j].y += halfMag;
 }
+
+void Waves::Disturb(const Impulse* impulses, UINT count)
+{
+	for(UINT k = 0; k < count; ++k)
+		Disturb(impulses[k].Row, impulses[k].Column, impulses[k].Magnitude);
+}
 	
@@ -14,9 +14,30 @@
 
 using namespace DirectX;
 
+class JobSystem;
+
 class Waves
 {
 public:
+	enum Solver
+	{
+		// Heights live in the y of XMFLOAT3 grids; one grid point at a time,
+		// with the normals in a second pass.
+		Solver_Scalar,
+
+		// Heights live in padded float grids; four grid points per SIMD
+		// operation, with the normals computed in the same sweep.
+		Solver_Simd
+	};
+
+	// A drop of the given magnitude on grid point (Row, Column).
+	struct Impulse
+	{
+		UINT Row;
+		UINT Column;
+		float Magnitude;
+	};
+
 	Waves();
 	~Waves();
 
@@ -28,7 +49,19 @@ public:
 	float Depth()const;
 
 	// Returns the solution at the ith grid point.
-	const XMFLOAT3& operator[](int i)const { return mCurrSolution[i]; }
+	XMFLOAT3 operator[](int i)const;
+
+	// Returns the height of the solution at the ith grid point.
+	float Height(int i)const;
+
+	// Returns the solution at the ith grid point blended with the solution of the
+	// step before it by InterpolationFactor(), so the surface moves smoothly when
+	// frames do not line up with simulation steps.
+	XMFLOAT3 Interpolated(int i)const;
+
+	// How far the time accumulated since the last step is towards the next
+	// step, in [0, 1).
+	float InterpolationFactor()const;
 
 	// Returns the solution normal at the ith grid point.
 	const XMFLOAT3& Normal(int i)const { return mNormals[i]; }
@@ -36,9 +69,35 @@ public:
 	// Returns the unit tangent vector at the ith grid point in the local x-axis direction.
 	const XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
 
-	void Init(UINT m, UINT n, float dx, float dt, float speed, float damping);
-	void Update(float dt);
+	void Init(UINT m, UINT n, float dx, float dt, float speed, float damping, Solver solver = Solver_Simd);
+
+	// Adds dt to the time accumulated by this Waves and runs as many fixed
+	// steps as fit in it, but no more than the substep limit; time beyond the
+	// limit is dropped so a slow frame does not make the next one slower.
+	// Returns the number of steps run.
+	UINT Update(float dt);
+
+	// Most steps a single Update() runs.  Default 4.
+	void SetMaxSubsteps(UINT maxSubsteps);
+
 	void Disturb(UINT i, UINT j, float magnitude);
+	void Disturb(const Impulse* impulses, UINT count);
+
+	// Spread Update() over the job system's threads.  Pass 0 to update on the
+	// calling thread only.
+	void SetJobSystem(JobSystem* jobSystem);
+
+private:
+	void Step();
+
+	void UpdateScalar();
+	void UpdateSolutionRows(UINT firstRow, UINT lastRow);
+	void UpdateNormalRows(UINT firstRow, UINT lastRow);
+
+	void UpdateSimd();
+	void UpdateHeightBand(UINT band);
+	void UpdateHeightRow(UINT i);
+	void UpdateNormalRow(const float* heights, UINT i);
 
 private:
 	UINT mNumRows;
@@ -55,10 +114,25 @@ private:
 	float mTimeStep;
 	float mSpatialStep;
 
+	// Time not yet simulated, less than mTimeStep between calls to Update().
+	float mTimeAccumulator;
+	UINT mMaxSubsteps;
+
+	Solver mSolver;
+
+	// Solver_Scalar
 	XMFLOAT3* mPrevSolution;
 	XMFLOAT3* mCurrSolution;
+
+	// Solver_Simd.  Rows are mRowPitch floats apart, a multiple of four.
+	UINT mRowPitch;
+	float* mPrevHeights;
+	float* mCurrHeights;
+
 	XMFLOAT3* mNormals;
 	XMFLOAT3* mTangentX;
+
+	JobSystem* mJobSystem;
 };
 
-#endif // WAVES_H
\ No newline at end of file
+#endif // WAVES_H
@@ -0,0 +1,209 @@
+//***************************************************************************************
+// WavesBenchmark.cpp
+//
+// Headless benchmark of Waves::Update over a range of grid sizes.  For every size it
+// times one simulation step with
+//   -Solver_Scalar on one thread (the original implementation),
+//   -Solver_Simd on one thread,
+//   -Solver_Simd on every hardware thread (JobSystem),
+// and reports the largest height and normal difference between the two solvers,
+// so a change to either one that alters the results shows up here.
+//
+// It then runs several water bodies with different time steps through a fixed,
+// uneven sequence of frame times with drops every frame, once on one thread and
+// once on every thread, and reports the cost per frame, the steps taken and a
+// checksum of the final heights, which must be the same for both runs.
+//
+// Needs DirectXMath but no DXUT:
+//   cl /EHsc /O2 /arch:AVX2 Waves.cpp JobSystem.cpp WavesBenchmark.cpp
+//
+// Usage: WavesBenchmark [gridSize ...]      (default 200 512 1024 2048 4096)
+//***************************************************************************************
+
+#include "Waves.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+	const float TimeStep = 0.03f;
+
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	void InitWaves(Waves& waves, UINT size, Waves::Solver solver)
+	{
+		waves.Init(size, size, 1.0f, TimeStep, 3.25f, 0.4f, solver);
+
+		// A few drops, away from the boundaries.
+		Waves::Impulse drops[8];
+		for(UINT k = 0; k < 8; ++k)
+		{
+			drops[k].Row       = (k+1)*(size-4)/9 + 2;
+			drops[k].Column    = (8-k)*(size-4)/9 + 2;
+			drops[k].Magnitude = 1.0f;
+		}
+		waves.Disturb(drops, 8);
+	}
+
+	// Milliseconds per step, averaged over stepCount steps.
+	double TimeSteps(Waves& waves, UINT stepCount)
+	{
+		// Warm up, and touch every page once.
+		waves.Update(TimeStep);
+
+		double start = Now();
+		for(UINT i = 0; i < stepCount; ++i)
+			waves.Update(TimeStep);
+		return (Now() - start)*1000.0 / stepCount;
+	}
+
+	// Small linear congruential generator, so every run sees the same numbers.
+	UINT NextRandom(UINT& state)
+	{
+		state = state*1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	// Milliseconds per frame.
+	double RunWaterBodies(JobSystem* jobSystem, UINT& stepCount, double& checksum)
+	{
+		const UINT bodyCount  = 4;
+		const UINT frameCount = 600;
+		const UINT size       = 256;
+		const float timeSteps[bodyCount] = { 0.02f, 0.025f, 0.03f, 0.04f };
+
+		Waves bodies[bodyCount];
+		for(UINT b = 0; b < bodyCount; ++b)
+		{
+			bodies[b].Init(size, size, 1.0f, timeSteps[b], 3.25f, 0.4f);
+			bodies[b].SetJobSystem(jobSystem);
+		}
+
+		UINT random = 12345;
+		stepCount = 0;
+
+		double start = Now();
+		for(UINT frame = 0; frame < frameCount; ++frame)
+		{
+			// Frames of 8 to 40 ms, with a 150 ms hitch now and then that the
+			// substep limit has to absorb.
+			float dt = 0.008f + 0.032f*(NextRandom(random) % 1000)/1000.0f;
+			if( frame % 97 == 96 )
+				dt = 0.15f;
+
+			for(UINT b = 0; b < bodyCount; ++b)
+			{
+				Waves::Impulse drops[4];
+				for(UINT k = 0; k < 4; ++k)
+				{
+					drops[k].Row       = 2 + NextRandom(random) % (size-4);
+					drops[k].Column    = 2 + NextRandom(random) % (size-4);
+					drops[k].Magnitude = 0.1f + 0.4f*(NextRandom(random) % 1000)/1000.0f;
+				}
+				bodies[b].Disturb(drops, 4);
+
+				stepCount += bodies[b].Update(dt);
+			}
+		}
+		double time = Now() - start;
+
+		checksum = 0.0;
+		for(UINT b = 0; b < bodyCount; ++b)
+		{
+			for(UINT i = 0; i < bodies[b].VertexCount(); ++i)
+				checksum += bodies[b].Interpolated(i).y;
+		}
+
+		return time*1000.0 / frameCount;
+	}
+
+	void Compare(const Waves& a, const Waves& b, float& maxHeightError, float& maxNormalError)
+	{
+		maxHeightError = 0.0f;
+		maxNormalError = 0.0f;
+		for(UINT i = 0; i < a.VertexCount(); ++i)
+		{
+			maxHeightError = std::max(maxHeightError, std::fabs(a.Height(i) - b.Height(i)));
+
+			XMVECTOR d = XMLoadFloat3(&a.Normal(i)) - XMLoadFloat3(&b.Normal(i));
+			maxNormalError = std::max(maxNormalError, XMVectorGetX(XMVector3Length(d)));
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<UINT> sizes;
+	for(int i = 1; i < argc; ++i)
+		sizes.push_back((UINT)std::max(8, atoi(argv[i])));
+
+	if( sizes.empty() )
+	{
+		UINT defaultSizes[] = { 200, 512, 1024, 2048, 4096 };
+		sizes.assign(defaultSizes, defaultSizes + sizeof(defaultSizes)/sizeof(defaultSizes[0]));
+	}
+
+	JobSystem jobSystem;
+
+	printf("ms per Waves::Update step, %u threads for the threaded column\n\n", jobSystem.ThreadCount());
+	printf("%6s %10s %10s %10s %8s %8s %12s %12s\n",
+		"grid", "scalar", "simd", "simd+jobs", "x simd", "x jobs", "height err", "normal err");
+
+	for(size_t s = 0; s < sizes.size(); ++s)
+	{
+		UINT size = sizes[s];
+
+		// Roughly the same amount of work for every size.
+		UINT stepCount = std::min(1000u, std::max(4u, (UINT)(100000000.0 / ((double)size*size))));
+
+		Waves scalar;
+		InitWaves(scalar, size, Waves::Solver_Scalar);
+		double scalarTime = TimeSteps(scalar, stepCount);
+
+		Waves simd;
+		InitWaves(simd, size, Waves::Solver_Simd);
+		double simdTime = TimeSteps(simd, stepCount);
+
+		Waves threaded;
+		InitWaves(threaded, size, Waves::Solver_Simd);
+		threaded.SetJobSystem(&jobSystem);
+		double threadedTime = TimeSteps(threaded, stepCount);
+
+		float heightError, normalError, threadedHeightError, threadedNormalError;
+		Compare(scalar, simd, heightError, normalError);
+		Compare(scalar, threaded, threadedHeightError, threadedNormalError);
+		heightError = std::max(heightError, threadedHeightError);
+		normalError = std::max(normalError, threadedNormalError);
+
+		printf("%6u %10.3f %10.3f %10.3f %8.2f %8.2f %12g %12g\n",
+			size, scalarTime, simdTime, threadedTime,
+			scalarTime/simdTime, scalarTime/threadedTime, heightError, normalError);
+	}
+
+	UINT serialSteps, threadedSteps;
+	double serialChecksum, threadedChecksum;
+	double serialTime   = RunWaterBodies(0, serialSteps, serialChecksum);
+	double threadedTime = RunWaterBodies(&jobSystem, threadedSteps, threadedChecksum);
+
+	printf("\nwater bodies (4 x 256^2, 600 frames)\n");
+	printf("%10s %12s %8s %16s\n", "threads", "ms / frame", "steps", "checksum");
+	printf("%10u %12.3f %8u %16.6f\n", 1u, serialTime, serialSteps, serialChecksum);
+	printf("%10u %12.3f %8u %16.6f\n", jobSystem.ThreadCount(), threadedTime, threadedSteps, threadedChecksum);
+
+	if( serialSteps != threadedSteps || serialChecksum != threadedChecksum )
+	{
+		printf("threaded run differs from the serial run\n");
+		return 1;
+	}
+
+	return 0;
+}
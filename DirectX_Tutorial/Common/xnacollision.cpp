@@ -9,8 +9,13 @@
 
 //#include "DXUT.h"
 #include <Windows.h>
+#include <algorithm>
 #include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
 #include "xnacollision.h"
+#include "JobSystem.h"
 
 namespace XNA
 {
@@ -548,6 +553,48 @@ static inline BOOL CalculateEigenVectorsFromCovarianceMatrix( FLOAT Cxx, FLOAT C
 
 
 
+//-----------------------------------------------------------------------------
+// Build the orientation of a box whose axes are three orthonormal eigenvectors.
+//-----------------------------------------------------------------------------
+static inline XMVECTOR OrientationFromEigenVectors( FXMVECTOR v1, FXMVECTOR v2, FXMVECTOR v3 )
+{
+    // Put them in a matrix.
+    XMMATRIX R;
+
+    R.r[0] = XMVectorSetW( v1, 0.f );
+    R.r[1] = XMVectorSetW( v2, 0.f );
+    R.r[2] = XMVectorSetW( v3, 0.f );
+    R.r[3] = XMVectorSetBinaryConstant( 0, 0, 0, 1 );
+
+    // Multiply by -1 to convert the matrix into a right handed coordinate 
+    // system (Det ~= 1) in case the eigenvectors form a left handed 
+    // coordinate system (Det ~= -1) because XMQuaternionRotationMatrix only 
+    // works on right handed matrices.
+    XMVECTOR Det = XMMatrixDeterminant( R );
+
+    if( XMVector4Less( Det, XMVectorZero() ) )
+    {
+        const XMVECTORF32 VectorNegativeOne =
+        {
+            -1.0f, -1.0f, -1.0f, -1.0f
+        };
+
+        R.r[0] *= VectorNegativeOne;
+        R.r[1] *= VectorNegativeOne;
+        R.r[2] *= VectorNegativeOne;
+    }
+
+    // Get the rotation quaternion from the matrix.
+    XMVECTOR Orientation = XMQuaternionRotationMatrix( R );
+
+    // Make sure it is normal (in case the vectors are slightly non-orthogonal).
+    Orientation = XMQuaternionNormalize( Orientation );
+
+    return Orientation;
+}
+
+
+
 //-----------------------------------------------------------------------------
 // Find the approximate minimum oriented bounding box containing a set of 
 // points.  Exact computation of minimum oriented bounding box is possible but 
@@ -613,40 +660,11 @@ VOID ComputeBoundingOrientedBoxFromPoints( OrientedBox* pOut, UINT Count, const
                                                XMVectorGetZ( XY_XZ_YZ ),
                                                &v1, &v2, &v3 );
 
-    // Put them in a matrix.
-    XMMATRIX R;
-
-    R.r[0] = XMVectorSetW( v1, 0.f );
-    R.r[1] = XMVectorSetW( v2, 0.f );
-    R.r[2] = XMVectorSetW( v3, 0.f );
-    R.r[3] = XMVectorSetBinaryConstant( 0, 0, 0, 1 );
-
-    // Multiply by -1 to convert the matrix into a right handed coordinate 
-    // system (Det ~= 1) in case the eigenvectors form a left handed 
-    // coordinate system (Det ~= -1) because XMQuaternionRotationMatrix only 
-    // works on right handed matrices.
-    XMVECTOR Det = XMMatrixDeterminant( R );
-
-    if( XMVector4Less( Det, XMVectorZero() ) )
-    {
-        const XMVECTORF32 VectorNegativeOne =
-        {
-            -1.0f, -1.0f, -1.0f, -1.0f
-        };
-
-        R.r[0] *= VectorNegativeOne;
-        R.r[1] *= VectorNegativeOne;
-        R.r[2] *= VectorNegativeOne;
-    }
-
-    // Get the rotation quaternion from the matrix.
-    XMVECTOR Orientation = XMQuaternionRotationMatrix( R );
-
-    // Make sure it is normal (in case the vectors are slightly non-orthogonal).
-    Orientation = XMQuaternionNormalize( Orientation );
+    // Get the orientation of the box from them.
+    XMVECTOR Orientation = OrientationFromEigenVectors( v1, v2, v3 );
 
-    // Rebuild the rotation matrix from the quaternion.
-    R = XMMatrixRotationQuaternion( Orientation );
+    // Build the rotation matrix from the quaternion.
+    XMMATRIX R = XMMatrixRotationQuaternion( Orientation );
 
     // Build the rotation into the rotated space.
     XMMATRIX InverseR = XMMatrixTranspose( R );
@@ -680,1688 +698,3332 @@ VOID ComputeBoundingOrientedBoxFromPoints( OrientedBox* pOut, UINT Count, const
 
 
 //-----------------------------------------------------------------------------
-// Build a frustum from a persepective projection matrix.  The matrix may only
-// contain a projection; any rotation, translation or scale will cause the
-// constructed frustum to be incorrect.
+// Bounding volume fitting for large point sets.  The points are split into
+// chunks, which run on the threads of a job system when one is given, and
+// each chunk is read four points at a time, transposed so that a vector holds
+// one coordinate of all four.  Chunk results are merged in order, so the
+// volumes do not depend on the number of threads.
 //-----------------------------------------------------------------------------
-VOID ComputeFrustumFromProjection( Frustum* pOut, XMMATRIX* pProjection )
+static const UINT FitChunkSize = 4096;
+
+static inline const XMFLOAT3* FitPoint( const XMFLOAT3* pPoints, UINT Stride, UINT i )
 {
-    XMASSERT( pOut );
-    XMASSERT( pProjection );
+    return ( const XMFLOAT3* )( ( const BYTE* )pPoints + ( size_t )i * Stride );
+}
 
-    // Corners of the projection frustum in homogenous space.
-    static XMVECTOR HomogenousPoints[6] =
-    {
-        {  1.0f,  0.0f, 1.0f, 1.0f },   // right (at far plane)
-        { -1.0f,  0.0f, 1.0f, 1.0f },   // left
-        {  0.0f,  1.0f, 1.0f, 1.0f },   // top
-        {  0.0f, -1.0f, 1.0f, 1.0f },   // bottom
 
-        { 0.0f, 0.0f, 0.0f, 1.0f },     // near
-        { 0.0f, 0.0f, 1.0f, 1.0f }      // far
-    };
 
-    XMVECTOR Determinant;
-    XMMATRIX matInverse = XMMatrixInverse( &Determinant, *pProjection );
+//-----------------------------------------------------------------------------
+// Load the points i to i + 3.  Lanes at or past Last get the point Pad.
+//-----------------------------------------------------------------------------
+static inline VOID LoadPoints4( XMVECTOR* pX, XMVECTOR* pY, XMVECTOR* pZ, const XMFLOAT3* pPoints, UINT Stride,
+                                UINT i, UINT Last, UINT Pad )
+{
+    XMMATRIX P( XMLoadFloat3( FitPoint( pPoints, Stride, i ) ),
+                XMLoadFloat3( FitPoint( pPoints, Stride, ( i + 1 < Last ) ? i + 1 : Pad ) ),
+                XMLoadFloat3( FitPoint( pPoints, Stride, ( i + 2 < Last ) ? i + 2 : Pad ) ),
+                XMLoadFloat3( FitPoint( pPoints, Stride, ( i + 3 < Last ) ? i + 3 : Pad ) ) );
 
-    // Compute the frustum corners in world space.
-    XMVECTOR Points[6];
+    P = XMMatrixTranspose( P );
 
-    for( INT i = 0; i < 6; i++ )
-    {
-        // Transform point.
-        Points[i] = XMVector4Transform( HomogenousPoints[i], matInverse );
-    }
+    *pX = P.r[0];
+    *pY = P.r[1];
+    *pZ = P.r[2];
+}
 
-    pOut->Origin = XMFLOAT3( 0.0f, 0.0f, 0.0f );
-    pOut->Orientation = XMFLOAT4( 0.0f, 0.0f, 0.0f, 1.0f );
 
-    // Compute the slopes.
-    Points[0] = Points[0] * XMVectorReciprocal( XMVectorSplatZ( Points[0] ) );
-    Points[1] = Points[1] * XMVectorReciprocal( XMVectorSplatZ( Points[1] ) );
-    Points[2] = Points[2] * XMVectorReciprocal( XMVectorSplatZ( Points[2] ) );
-    Points[3] = Points[3] * XMVectorReciprocal( XMVectorSplatZ( Points[3] ) );
 
-    pOut->RightSlope = XMVectorGetX( Points[0] );
-    pOut->LeftSlope = XMVectorGetX( Points[1] );
-    pOut->TopSlope = XMVectorGetY( Points[2] );
-    pOut->BottomSlope = XMVectorGetY( Points[3] );
+//-----------------------------------------------------------------------------
+// Call Function( First, Last, Chunk ) for every chunk of Count points.
+//-----------------------------------------------------------------------------
+template<typename ChunkFunction>
+static VOID ForEachFitChunk( UINT Count, JobSystem* pJobSystem, const ChunkFunction& Function )
+{
+    UINT ChunkCount = ( Count + FitChunkSize - 1 ) / FitChunkSize;
 
-    // Compute near and far.
-    Points[4] = Points[4] * XMVectorReciprocal( XMVectorSplatW( Points[4] ) );
-    Points[5] = Points[5] * XMVectorReciprocal( XMVectorSplatW( Points[5] ) );
+    auto RunChunks = [&]( UINT FirstChunk, UINT LastChunk )
+    {
+        for( UINT c = FirstChunk; c < LastChunk; c++ )
+        {
+            UINT First = c * FitChunkSize;
+            UINT Last = ( Count - First > FitChunkSize ) ? First + FitChunkSize : Count;
 
-    pOut->Near = XMVectorGetZ( Points[4] );
-    pOut->Far = XMVectorGetZ( Points[5] );
+            Function( First, Last, c );
+        }
+    };
 
-    return;
+    if( pJobSystem == NULL || ChunkCount == 1 )
+        RunChunks( 0, ChunkCount );
+    else
+        pJobSystem->ParallelFor( 0, ChunkCount, 1, RunChunks );
 }
 
 
 
 //-----------------------------------------------------------------------------
-// Build the 6 frustum planes from a frustum.
+// Find the lane with the smallest (or largest) value, taking the smallest
+// index on a tie.
 //-----------------------------------------------------------------------------
-VOID ComputePlanesFromFrustum( const Frustum* pVolume, XMVECTOR* pPlane0, XMVECTOR* pPlane1, XMVECTOR* pPlane2,
-                               XMVECTOR* pPlane3, XMVECTOR* pPlane4, XMVECTOR* pPlane5 )
+static inline VOID SelectLane( FLOAT* pValue, FLOAT* pIndex, FXMVECTOR Value, FXMVECTOR Index, BOOL Largest )
 {
-    XMASSERT( pVolume );
-    XMASSERT( pPlane0 );
-    XMASSERT( pPlane1 );
-    XMASSERT( pPlane2 );
-    XMASSERT( pPlane3 );
-    XMASSERT( pPlane4 );
-    XMASSERT( pPlane5 );
+    XMFLOAT4 V, I;
+    XMStoreFloat4( &V, Value );
+    XMStoreFloat4( &I, Index );
 
-    // Load origin and orientation of the frustum.
-    XMVECTOR Origin = XMLoadFloat3( &pVolume->Origin );
-    XMVECTOR Orientation = XMLoadFloat4( &pVolume->Orientation );
+    const FLOAT* v = &V.x;
+    const FLOAT* idx = &I.x;
 
-    // Build the frustum planes.
-    XMVECTOR Plane0 = XMVectorSet( 0.0f, 0.0f, -1.0f, pVolume->Near );
-    XMVECTOR Plane1 = XMVectorSet( 0.0f, 0.0f, 1.0f, -pVolume->Far );
-    XMVECTOR Plane2 = XMVectorSet( 1.0f, 0.0f, -pVolume->RightSlope, 0.0f );
-    XMVECTOR Plane3 = XMVectorSet( -1.0f, 0.0f, pVolume->LeftSlope, 0.0f );
-    XMVECTOR Plane4 = XMVectorSet( 0.0f, 1.0f, -pVolume->TopSlope, 0.0f );
-    XMVECTOR Plane5 = XMVectorSet( 0.0f, -1.0f, pVolume->BottomSlope, 0.0f );
+    UINT Best = 0;
+    for( UINT k = 1; k < 4; k++ )
+    {
+        BOOL Better = Largest ? ( v[k] > v[Best] ) : ( v[k] < v[Best] );
 
-    Plane0 = TransformPlane( Plane0, Orientation, Origin );
-    Plane1 = TransformPlane( Plane1, Orientation, Origin );
-    Plane2 = TransformPlane( Plane2, Orientation, Origin );
-    Plane3 = TransformPlane( Plane3, Orientation, Origin );
-    Plane4 = TransformPlane( Plane4, Orientation, Origin );
-    Plane5 = TransformPlane( Plane5, Orientation, Origin );
+        if( Better || ( v[k] == v[Best] && idx[k] < idx[Best] ) )
+            Best = k;
+    }
 
-    *pPlane0 = XMPlaneNormalize( Plane0 );
-    *pPlane1 = XMPlaneNormalize( Plane1 );
-    *pPlane2 = XMPlaneNormalize( Plane2 );
-    *pPlane3 = XMPlaneNormalize( Plane3 );
-    *pPlane4 = XMPlaneNormalize( Plane4 );
-    *pPlane5 = XMPlaneNormalize( Plane5 );
+    *pValue = v[Best];
+    *pIndex = idx[Best];
 }
 
+static inline FLOAT MinLane( FXMVECTOR V )
+{
+    return XMVectorGetX( XMVectorMin( XMVectorMin( XMVectorSplatX( V ), XMVectorSplatY( V ) ),
+                                      XMVectorMin( XMVectorSplatZ( V ), XMVectorSplatW( V ) ) ) );
+}
 
+static inline FLOAT MaxLane( FXMVECTOR V )
+{
+    return XMVectorGetX( XMVectorMax( XMVectorMax( XMVectorSplatX( V ), XMVectorSplatY( V ) ),
+                                      XMVectorMax( XMVectorSplatZ( V ), XMVectorSplatW( V ) ) ) );
+}
 
-//-----------------------------------------------------------------------------
-// Transform a sphere by an angle preserving transform.
-//-----------------------------------------------------------------------------
-VOID TransformSphere( Sphere* pOut, const Sphere* pIn, FLOAT Scale, FXMVECTOR Rotation, FXMVECTOR Translation )
+static inline double SumLanes( FXMVECTOR V )
 {
-    XMASSERT( pOut );
-    XMASSERT( pIn );
-    XMASSERT( XMQuaternionIsUnit( Rotation ) );
+    XMFLOAT4 S;
+    XMStoreFloat4( &S, V );
 
-    // Load the center of the sphere.
-    XMVECTOR Center = XMLoadFloat3( &pIn->Center );
+    return ( double )S.x + ( double )S.y + ( double )S.z + ( double )S.w;
+}
 
-    // Transform the center of the sphere.
-    Center = XMVector3Rotate( Center * XMVectorReplicate( Scale ), Rotation ) + Translation;
 
-    // Store the center sphere.
-    XMStoreFloat3( &pOut->Center, Center );
 
-    // Scale the radius of the pshere.
-    pOut->Radius = pIn->Radius * Scale;
+//-----------------------------------------------------------------------------
+// The bounds and second moments of a set of points.
+//-----------------------------------------------------------------------------
+struct FitMoments
+{
+    XMFLOAT3 Min;
+    XMFLOAT3 Max;
 
-    return;
-}
+    double Count;
+    double Mean[3];
+
+    // Sums of products of the offsets from the mean: xx, yy, zz, xy, xz, yz.
+    double Comoment[6];
+};
 
 
 
 //-----------------------------------------------------------------------------
-// Transform an axis aligned box by an angle preserving transform.
+// Gather the moments of the points [First, Last) in one pass.  The sums are
+// taken relative to the first point, which keeps them small enough for float
+// lanes over one chunk; padding lanes repeat that point and so add nothing.
 //-----------------------------------------------------------------------------
-VOID TransformAxisAlignedBox( AxisAlignedBox* pOut, const AxisAlignedBox* pIn, FLOAT Scale, FXMVECTOR Rotation,
-                              FXMVECTOR Translation )
+static VOID ComputeFitMoments( FitMoments* pOut, const XMFLOAT3* pPoints, UINT Stride, UINT First, UINT Last )
 {
-    XMASSERT( pOut );
-    XMASSERT( pIn );
-    XMASSERT( XMQuaternionIsUnit( Rotation ) );
-
-    static XMVECTOR Offset[8] =
-    {
-        { -1.0f, -1.0f, -1.0f, 0.0f },
-        { -1.0f, -1.0f,  1.0f, 0.0f },
-        { -1.0f,  1.0f, -1.0f, 0.0f },
-        { -1.0f,  1.0f,  1.0f, 0.0f },
-        {  1.0f, -1.0f, -1.0f, 0.0f },
-        {  1.0f, -1.0f,  1.0f, 0.0f },
-        {  1.0f,  1.0f, -1.0f, 0.0f },
-        {  1.0f,  1.0f,  1.0f, 0.0f }
-    };
-
-    // Load center and extents.
-    XMVECTOR Center = XMLoadFloat3( &pIn->Center );
-    XMVECTOR Extents = XMLoadFloat3( &pIn->Extents );
+    XMVECTOR Origin = XMLoadFloat3( FitPoint( pPoints, Stride, First ) );
 
-    XMVECTOR VectorScale = XMVectorReplicate( Scale );
+    XMVECTOR Ox = XMVectorSplatX( Origin );
+    XMVECTOR Oy = XMVectorSplatY( Origin );
+    XMVECTOR Oz = XMVectorSplatZ( Origin );
 
-    // Compute and transform the corners and find new min/max bounds.
-    XMVECTOR Corner = Center + Extents * Offset[0];
-    Corner = XMVector3Rotate( Corner * VectorScale, Rotation ) + Translation;
+    XMVECTOR MinX = Ox, MaxX = Ox;
+    XMVECTOR MinY = Oy, MaxY = Oy;
+    XMVECTOR MinZ = Oz, MaxZ = Oz;
 
-    XMVECTOR Min, Max;
-    Min = Max = Corner;
+    XMVECTOR Sx = XMVectorZero(), Sy = XMVectorZero(), Sz = XMVectorZero();
+    XMVECTOR Sxx = XMVectorZero(), Syy = XMVectorZero(), Szz = XMVectorZero();
+    XMVECTOR Sxy = XMVectorZero(), Sxz = XMVectorZero(), Syz = XMVectorZero();
 
-    for( INT i = 1; i < 8; i++ )
+    for( UINT i = First; i < Last; i += 4 )
     {
-        Corner = Center + Extents * Offset[i];
-        Corner = XMVector3Rotate( Corner * VectorScale, Rotation ) + Translation;
-
-        Min = XMVectorMin( Min, Corner );
-        Max = XMVectorMax( Max, Corner );
+        XMVECTOR X, Y, Z;
+        LoadPoints4( &X, &Y, &Z, pPoints, Stride, i, Last, First );
+
+        MinX = XMVectorMin( MinX, X );
+        MaxX = XMVectorMax( MaxX, X );
+        MinY = XMVectorMin( MinY, Y );
+        MaxY = XMVectorMax( MaxY, Y );
+        MinZ = XMVectorMin( MinZ, Z );
+        MaxZ = XMVectorMax( MaxZ, Z );
+
+        X -= Ox;
+        Y -= Oy;
+        Z -= Oz;
+
+        Sx += X;
+        Sy += Y;
+        Sz += Z;
+
+        Sxx += X * X;
+        Syy += Y * Y;
+        Szz += Z * Z;
+
+        Sxy += X * Y;
+        Sxz += X * Z;
+        Syz += Y * Z;
     }
 
-    // Store center and extents.
-    XMStoreFloat3( &pOut->Center, ( Min + Max ) * 0.5f );
-    XMStoreFloat3( &pOut->Extents, ( Max - Min ) * 0.5f );
+    pOut->Min = XMFLOAT3( MinLane( MinX ), MinLane( MinY ), MinLane( MinZ ) );
+    pOut->Max = XMFLOAT3( MaxLane( MaxX ), MaxLane( MaxY ), MaxLane( MaxZ ) );
 
-    return;
+    double n = ( double )( Last - First );
+    double Sum[3] = { SumLanes( Sx ), SumLanes( Sy ), SumLanes( Sz ) };
+
+    pOut->Count = n;
+    pOut->Mean[0] = XMVectorGetX( Origin ) + Sum[0] / n;
+    pOut->Mean[1] = XMVectorGetY( Origin ) + Sum[1] / n;
+    pOut->Mean[2] = XMVectorGetZ( Origin ) + Sum[2] / n;
+
+    pOut->Comoment[0] = SumLanes( Sxx ) - Sum[0] * Sum[0] / n;
+    pOut->Comoment[1] = SumLanes( Syy ) - Sum[1] * Sum[1] / n;
+    pOut->Comoment[2] = SumLanes( Szz ) - Sum[2] * Sum[2] / n;
+    pOut->Comoment[3] = SumLanes( Sxy ) - Sum[0] * Sum[1] / n;
+    pOut->Comoment[4] = SumLanes( Sxz ) - Sum[0] * Sum[2] / n;
+    pOut->Comoment[5] = SumLanes( Syz ) - Sum[1] * Sum[2] / n;
 }
 
 
 
 //-----------------------------------------------------------------------------
-// Transform an oriented box by an angle preserving transform.
+// Merge the moments of the points that follow A into A, combining the
+// comoments about the two means as in Chan, Golub and LeVeque, "Updating
+// Formulae and a Pairwise Algorithm for Computing Sample Variances".
 //-----------------------------------------------------------------------------
-VOID TransformOrientedBox( OrientedBox* pOut, const OrientedBox* pIn, FLOAT Scale, FXMVECTOR Rotation,
-                           FXMVECTOR Translation )
+static VOID MergeFitMoments( FitMoments* pA, const FitMoments* pB )
 {
-    XMASSERT( pOut );
-    XMASSERT( pIn );
-    XMASSERT( XMQuaternionIsUnit( Rotation ) );
-
-    // Load the box.
-    XMVECTOR Center = XMLoadFloat3( &pIn->Center );
-    XMVECTOR Extents = XMLoadFloat3( &pIn->Extents );
-    XMVECTOR Orientation = XMLoadFloat4( &pIn->Orientation );
-
-    XMASSERT( XMQuaternionIsUnit( Orientation ) );
-
-    // Composite the box rotation and the transform rotation.
-    Orientation = XMQuaternionMultiply( Orientation, Rotation );
+    XMStoreFloat3( &pA->Min, XMVectorMin( XMLoadFloat3( &pA->Min ), XMLoadFloat3( &pB->Min ) ) );
+    XMStoreFloat3( &pA->Max, XMVectorMax( XMLoadFloat3( &pA->Max ), XMLoadFloat3( &pB->Max ) ) );
 
-    // Transform the center.
-    XMVECTOR VectorScale = XMVectorReplicate( Scale );
-    Center = XMVector3Rotate( Center * VectorScale, Rotation ) + Translation;
+    double n = pA->Count + pB->Count;
+    double Weight = pA->Count * pB->Count / n;
 
-    // Scale the box extents.
-    Extents = Extents * VectorScale;
+    double Delta[3];
+    for( UINT k = 0; k < 3; k++ )
+    {
+        Delta[k] = pB->Mean[k] - pA->Mean[k];
+        pA->Mean[k] += Delta[k] * pB->Count / n;
+    }
 
-    // Store the box.
-    XMStoreFloat3( &pOut->Center, Center );
-    XMStoreFloat3( &pOut->Extents, Extents );
-    XMStoreFloat4( &pOut->Orientation, Orientation );
+    pA->Comoment[0] += pB->Comoment[0] + Delta[0] * Delta[0] * Weight;
+    pA->Comoment[1] += pB->Comoment[1] + Delta[1] * Delta[1] * Weight;
+    pA->Comoment[2] += pB->Comoment[2] + Delta[2] * Delta[2] * Weight;
+    pA->Comoment[3] += pB->Comoment[3] + Delta[0] * Delta[1] * Weight;
+    pA->Comoment[4] += pB->Comoment[4] + Delta[0] * Delta[2] * Weight;
+    pA->Comoment[5] += pB->Comoment[5] + Delta[1] * Delta[2] * Weight;
 
-    return;
+    pA->Count = n;
 }
 
 
 
 //-----------------------------------------------------------------------------
-// Transform a frustum by an angle preserving transform.
+static VOID ComputeFitMoments( FitMoments* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride,
+                               JobSystem* pJobSystem )
+{
+    std::vector<FitMoments> Chunks( ( Count + FitChunkSize - 1 ) / FitChunkSize );
+
+    ForEachFitChunk( Count, pJobSystem, [&]( UINT First, UINT Last, UINT c )
+    {
+        ComputeFitMoments( &Chunks[c], pPoints, Stride, First, Last );
+    } );
+
+    *pOut = Chunks[0];
+    for( size_t c = 1; c < Chunks.size(); c++ )
+        MergeFitMoments( pOut, &Chunks[c] );
+}
+
+
+
 //-----------------------------------------------------------------------------
-VOID TransformFrustum( Frustum* pOut, const Frustum* pIn, FLOAT Scale, FXMVECTOR Rotation, FXMVECTOR Translation )
+// Find the first of the points [First, Last) farthest from Center.
+//-----------------------------------------------------------------------------
+static VOID FindFarthestPoint( FLOAT* pDistSq, UINT* pIndex, FXMVECTOR Center, const XMFLOAT3* pPoints,
+                               UINT Stride, UINT First, UINT Last )
 {
-    XMASSERT( pOut );
-    XMASSERT( pIn );
-    XMASSERT( XMQuaternionIsUnit( Rotation ) );
+    static CONST XMVECTORF32 LaneIndex =
+    {
+        0.0f, 1.0f, 2.0f, 3.0f
+    };
 
-    // Load the frustum.
-    XMVECTOR Origin = XMLoadFloat3( &pIn->Origin );
-    XMVECTOR Orientation = XMLoadFloat4( &pIn->Orientation );
+    XMVECTOR Cx = XMVectorSplatX( Center );
+    XMVECTOR Cy = XMVectorSplatY( Center );
+    XMVECTOR Cz = XMVectorSplatZ( Center );
 
-    XMASSERT( XMQuaternionIsUnit( Orientation ) );
+    XMVECTOR MaxDistSq = XMVectorReplicate( -1.0f );
+    XMVECTOR MaxIndex = XMVectorZero();
 
-    // Composite the frustum rotation and the transform rotation.
-    Orientation = XMQuaternionMultiply( Orientation, Rotation );
+    XMVECTOR Index = LaneIndex;
+    XMVECTOR Four = XMVectorReplicate( 4.0f );
 
-    // Transform the origin.
-    Origin = XMVector3Rotate( Origin * XMVectorReplicate( Scale ), Rotation ) + Translation;
+    for( UINT i = First; i < Last; i += 4 )
+    {
+        XMVECTOR X, Y, Z;
+        LoadPoints4( &X, &Y, &Z, pPoints, Stride, i, Last, First );
 
-    // Store the frustum.
-    XMStoreFloat3( &pOut->Origin, Origin );
-    XMStoreFloat4( &pOut->Orientation, Orientation );
+        X -= Cx;
+        Y -= Cy;
+        Z -= Cz;
 
-    // Scale the near and far distances (the slopes remain the same).
-    pOut->Near = pIn->Near * Scale;
-    pOut->Far = pIn->Far * Scale;
+        XMVECTOR DistSq = X * X + Y * Y + Z * Z;
 
-    // Copy the slopes.
-    pOut->RightSlope = pIn->RightSlope;
-    pOut->LeftSlope = pIn->LeftSlope;
-    pOut->TopSlope = pIn->TopSlope;
-    pOut->BottomSlope = pIn->BottomSlope;
+        XMVECTOR Control = XMVectorGreater( DistSq, MaxDistSq );
+        MaxDistSq = XMVectorSelect( MaxDistSq, DistSq, Control );
+        MaxIndex = XMVectorSelect( MaxIndex, Index, Control );
 
-    return;
+        Index += Four;
+    }
+
+    FLOAT Local;
+    SelectLane( pDistSq, &Local, MaxDistSq, MaxIndex, TRUE );
+
+    *pIndex = First + ( UINT )Local;
 }
 
 
 
 //-----------------------------------------------------------------------------
-// Point in sphere test.
+// The first points of [First, Last) with the smallest and the largest
+// projection on each of seven directions: the axes and the diagonals of a
+// cube.  Minima go to the even entries of pValue and pIndex, maxima to the odd
+// ones.
 //-----------------------------------------------------------------------------
-BOOL IntersectPointSphere( FXMVECTOR Point, const Sphere* pVolume )
+static const UINT FitDirectionCount = 7;
+
+static VOID FindExtremePoints( FLOAT* pValue, UINT* pIndex, const XMFLOAT3* pPoints, UINT Stride, UINT First,
+                               UINT Last )
 {
-    XMASSERT( pVolume );
+    static CONST XMVECTORF32 LaneIndex =
+    {
+        0.0f, 1.0f, 2.0f, 3.0f
+    };
 
-    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
-    XMVECTOR Radius = XMVectorReplicatePtr( &pVolume->Radius );
+    XMVECTOR Min[FitDirectionCount], Max[FitDirectionCount];
+    XMVECTOR MinIndex[FitDirectionCount], MaxIndex[FitDirectionCount];
 
-    XMVECTOR DistanceSquared = XMVector3LengthSq( Point - Center );
-    XMVECTOR RadiusSquared = Radius * Radius;
+    for( UINT j = 0; j < FitDirectionCount; j++ )
+    {
+        Min[j] = XMVectorReplicate( FLT_MAX );
+        Max[j] = XMVectorReplicate( -FLT_MAX );
+        MinIndex[j] = XMVectorZero();
+        MaxIndex[j] = XMVectorZero();
+    }
 
-    return XMVector4LessOrEqual( DistanceSquared, RadiusSquared );
-}
+    XMVECTOR Index = LaneIndex;
+    XMVECTOR Four = XMVectorReplicate( 4.0f );
 
+    for( UINT i = First; i < Last; i += 4 )
+    {
+        XMVECTOR X, Y, Z;
+        LoadPoints4( &X, &Y, &Z, pPoints, Stride, i, Last, First );
 
+        XMVECTOR D[FitDirectionCount];
 
-//-----------------------------------------------------------------------------
-// Point in axis aligned box test.
-//-----------------------------------------------------------------------------
-BOOL IntersectPointAxisAlignedBox( FXMVECTOR Point, const AxisAlignedBox* pVolume )
-{
-    XMASSERT( pVolume );
+        D[0] = X;
+        D[1] = Y;
+        D[2] = Z;
+        D[3] = X + Y + Z;
+        D[4] = X + Y - Z;
+        D[5] = X - Y + Z;
+        D[6] = X - Y - Z;
 
-    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
-    XMVECTOR Extents = XMLoadFloat3( &pVolume->Extents );
+        for( UINT j = 0; j < FitDirectionCount; j++ )
+        {
+            XMVECTOR Control = XMVectorLess( D[j], Min[j] );
+            Min[j] = XMVectorSelect( Min[j], D[j], Control );
+            MinIndex[j] = XMVectorSelect( MinIndex[j], Index, Control );
 
-    return XMVector3InBounds( Point - Center, Extents );
+            Control = XMVectorGreater( D[j], Max[j] );
+            Max[j] = XMVectorSelect( Max[j], D[j], Control );
+            MaxIndex[j] = XMVectorSelect( MaxIndex[j], Index, Control );
+        }
+
+        Index += Four;
+    }
+
+    for( UINT j = 0; j < FitDirectionCount; j++ )
+    {
+        FLOAT Local;
+
+        SelectLane( &pValue[2 * j], &Local, Min[j], MinIndex[j], FALSE );
+        pIndex[2 * j] = First + ( UINT )Local;
+
+        SelectLane( &pValue[2 * j + 1], &Local, Max[j], MaxIndex[j], TRUE );
+        pIndex[2 * j + 1] = First + ( UINT )Local;
+    }
 }
 
 
 
 //-----------------------------------------------------------------------------
-// Point in oriented box test.
+// Smallest enclosing ball of a few points, in double precision.
 //-----------------------------------------------------------------------------
-BOOL IntersectPointOrientedBox( FXMVECTOR Point, const OrientedBox* pVolume )
+struct FitBall
 {
-    XMASSERT( pVolume );
-
-    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
-    XMVECTOR Extents = XMLoadFloat3( &pVolume->Extents );
-    XMVECTOR Orientation = XMLoadFloat4( &pVolume->Orientation );
+    double Center[3];
+    double RadiusSq;
+};
 
-    XMASSERT( XMQuaternionIsUnit( Orientation ) );
+static inline double DistanceSq( const double* a, const double* b )
+{
+    double dx = a[0] - b[0];
+    double dy = a[1] - b[1];
+    double dz = a[2] - b[2];
 
-    // Transform the point to be local to the box.
-    XMVECTOR TPoint = XMVector3InverseRotate( Point - Center, Orientation );
+    return dx * dx + dy * dy + dz * dz;
+}
 
-    return XMVector3InBounds( TPoint, Extents );
+static inline BOOL FitBallContains( const FitBall* pBall, const double* p )
+{
+    return DistanceSq( p, pBall->Center ) <= pBall->RadiusSq * ( 1.0 + 1.0e-9 );
 }
 
 
 
 //-----------------------------------------------------------------------------
-// Point in frustum test.
+// The smallest ball with one to four points on its surface, centered in their
+// affine hull.  For points that are nearly dependent the ball through the two
+// farthest apart is used instead; it still holds all of them.
 //-----------------------------------------------------------------------------
-BOOL IntersectPointFrustum( FXMVECTOR Point, const Frustum* pVolume )
+static VOID ComputeCircumscribedBall( FitBall* pOut, double ( *pSupport )[3], UINT SupportCount )
 {
-    static const XMVECTORU32 SelectW = {XM_SELECT_0, XM_SELECT_0, XM_SELECT_0, XM_SELECT_1};
-    static const XMVECTORU32 SelectZ = {XM_SELECT_0, XM_SELECT_0, XM_SELECT_1, XM_SELECT_0};
+    if( SupportCount == 0 )
+    {
+        pOut->Center[0] = pOut->Center[1] = pOut->Center[2] = 0.0;
+        pOut->RadiusSq = -1.0;
+        return;
+    }
 
-    static const XMVECTOR BasePlanes[6] = 
+    const double* p0 = pSupport[0];
+
+    // The center is p0 + Sum( Lambda[j] * A[j] ), at the same distance from
+    // every point: 2 A[i].A[j] Lambda[j] = A[i].A[i].
+    UINT m = SupportCount - 1;
+    double A[3][3], M[3][4];
+
+    for( UINT i = 0; i < m; i++ )
     {
-        {  0.0f,  0.0f, -1.0f, 0.0f },
-        {  0.0f,  0.0f,  1.0f, 0.0f },
-        {  1.0f,  0.0f,  0.0f, 0.0f },
-        { -1.0f,  0.0f,  0.0f, 0.0f },
-        {  0.0f,  1.0f,  0.0f, 0.0f },
-        {  0.0f, -1.0f,  0.0f, 0.0f },
-    };
+        for( UINT k = 0; k < 3; k++ )
+            A[i][k] = pSupport[i + 1][k] - p0[k];
+    }
 
-    XMASSERT( pVolume );
+    double Scale = 0.0;
+    for( UINT i = 0; i < m; i++ )
+    {
+        for( UINT j = 0; j < m; j++ )
+            M[i][j] = 2.0 * ( A[i][0] * A[j][0] + A[i][1] * A[j][1] + A[i][2] * A[j][2] );
 
-    // Build frustum planes.
-    XMVECTOR Planes[6];
-    Planes[0] = XMVectorSelect( BasePlanes[0], XMVectorSplatX(  XMLoadFloat( &pVolume->Near ) ),
-                                SelectW );
-    Planes[1] = XMVectorSelect( BasePlanes[1], XMVectorSplatX( -XMLoadFloat( &pVolume->Far ) ),
-                                SelectW );
-    Planes[2] = XMVectorSelect( BasePlanes[2], XMVectorSplatX( -XMLoadFloat( &pVolume->RightSlope ) ),
-                                SelectZ );
-    Planes[3] = XMVectorSelect( BasePlanes[3], XMVectorSplatX(  XMLoadFloat( &pVolume->LeftSlope ) ),
-                                SelectZ );
-    Planes[4] = XMVectorSelect( BasePlanes[4], XMVectorSplatX( -XMLoadFloat( &pVolume->TopSlope ) ),
-                                SelectZ );
-    Planes[5] = XMVectorSelect( BasePlanes[5], XMVectorSplatX(  XMLoadFloat( &pVolume->BottomSlope ) ),
-                                SelectZ );
+        M[i][m] = 0.5 * M[i][i];
+        Scale = ( M[i][i] > Scale ) ? M[i][i] : Scale;
+    }
 
-    // Load origin and orientation.
-    XMVECTOR Origin = XMLoadFloat3( &pVolume->Origin );
-    XMVECTOR Orientation = XMLoadFloat4( &pVolume->Orientation );
+    // Gaussian elimination with partial pivoting.
+    BOOL Degenerate = FALSE;
 
-    XMASSERT( XMQuaternionIsUnit( Orientation ) );
+    for( UINT c = 0; c < m && !Degenerate; c++ )
+    {
+        UINT Pivot = c;
+        for( UINT r = c + 1; r < m; r++ )
+        {
+            if( fabs( M[r][c] ) > fabs( M[Pivot][c] ) )
+                Pivot = r;
+        }
 
-    // Transform point into local space of frustum.
-    XMVECTOR TPoint = XMVector3InverseRotate( Point - Origin, Orientation );
+        if( fabs( M[Pivot][c] ) <= 1.0e-12 * Scale )
+        {
+            Degenerate = TRUE;
+            break;
+        }
 
-    // Set w to one.
-    TPoint = XMVectorInsert( TPoint, XMVectorSplatOne(), 0, 0, 0, 0, 1);
+        for( UINT k = 0; k <= m; k++ )
+        {
+            double t = M[c][k];
+            M[c][k] = M[Pivot][k];
+            M[Pivot][k] = t;
+        }
 
-    XMVECTOR Zero = XMVectorZero();
-    XMVECTOR Outside = Zero;
+        for( UINT r = c + 1; r < m; r++ )
+        {
+            double f = M[r][c] / M[c][c];
+            for( UINT k = c; k <= m; k++ )
+                M[r][k] -= f * M[c][k];
+        }
+    }
 
-    // Test point against each plane of the frustum.
-    for( INT i = 0; i < 6; i++ )
+    if( !Degenerate )
     {
-        XMVECTOR Dot = XMVector4Dot( TPoint, Planes[i] );
-        Outside = XMVectorOrInt( Outside, XMVectorGreater( Dot, Zero ) );
+        double Lambda[3];
+        for( INT r = ( INT )m - 1; r >= 0; r-- )
+        {
+            double t = M[r][m];
+            for( UINT k = r + 1; k < m; k++ )
+                t -= M[r][k] * Lambda[k];
+            Lambda[r] = t / M[r][r];
+        }
+
+        for( UINT k = 0; k < 3; k++ )
+        {
+            pOut->Center[k] = p0[k];
+            for( UINT j = 0; j < m; j++ )
+                pOut->Center[k] += Lambda[j] * A[j][k];
+        }
     }
+    else
+    {
+        UINT a = 0, b = 0;
+        double FarthestSq = -1.0;
 
-    return XMVector4NotEqualInt( Outside, XMVectorTrueInt() );
+        for( UINT i = 0; i < SupportCount; i++ )
+        {
+            for( UINT j = i + 1; j < SupportCount; j++ )
+            {
+                double d = DistanceSq( pSupport[i], pSupport[j] );
+                if( d > FarthestSq )
+                {
+                    FarthestSq = d;
+                    a = i;
+                    b = j;
+                }
+            }
+        }
+
+        for( UINT k = 0; k < 3; k++ )
+            pOut->Center[k] = 0.5 * ( pSupport[a][k] + pSupport[b][k] );
+    }
+
+    pOut->RadiusSq = 0.0;
+    for( UINT i = 0; i < SupportCount; i++ )
+    {
+        double d = DistanceSq( pSupport[i], pOut->Center );
+        pOut->RadiusSq = ( d > pOut->RadiusSq ) ? d : pOut->RadiusSq;
+    }
 }
 
 
 
 //-----------------------------------------------------------------------------
-// Compute the intersection of a ray (Origin, Direction) with a triangle 
-// (V0, V1, V2).  Return TRUE if there is an intersection and also set *pDist 
-// to the distance along the ray to the intersection.
-// 
-// The algorithm is based on Moller, Tomas and Trumbore, "Fast, Minimum Storage 
-// Ray-Triangle Intersection", Journal of Graphics Tools, vol. 2, no. 1, 
-// pp 21-28, 1997.
+// Welzl's smallest enclosing ball of the first End points with the support
+// points on its surface, using the move-to-front heuristic of Gaertner, "Fast
+// and Robust Smallest Enclosing Balls".
 //-----------------------------------------------------------------------------
-BOOL IntersectRayTriangle( FXMVECTOR Origin, FXMVECTOR Direction, FXMVECTOR V0, CXMVECTOR V1, CXMVECTOR V2,
-                           FLOAT* pDist )
+static VOID ComputeMinimumBall( FitBall* pOut, double ( *pPoints )[3], UINT End, double ( *pSupport )[3],
+                                UINT SupportCount )
 {
-    XMASSERT( pDist );
-    XMASSERT( XMVector3IsUnit( Direction ) );
+    ComputeCircumscribedBall( pOut, pSupport, SupportCount );
 
-    static const XMVECTOR Epsilon =
+    if( SupportCount == 4 )
+        return;
+
+    for( UINT i = 0; i < End; i++ )
     {
-        1e-20f, 1e-20f, 1e-20f, 1e-20f
-    };
+        if( FitBallContains( pOut, pPoints[i] ) )
+            continue;
 
-    XMVECTOR Zero = XMVectorZero();
+        double p[3] = { pPoints[i][0], pPoints[i][1], pPoints[i][2] };
 
-    XMVECTOR e1 = V1 - V0;
-    XMVECTOR e2 = V2 - V0;
+        pSupport[SupportCount][0] = p[0];
+        pSupport[SupportCount][1] = p[1];
+        pSupport[SupportCount][2] = p[2];
 
-    // p = Direction ^ e2;
-    XMVECTOR p = XMVector3Cross( Direction, e2 );
+        ComputeMinimumBall( pOut, pPoints, i, pSupport, SupportCount + 1 );
 
-    // det = e1 * p;
-    XMVECTOR det = XMVector3Dot( e1, p );
+        memmove( pPoints + 1, pPoints, i * sizeof( pPoints[0] ) );
+        pPoints[0][0] = p[0];
+        pPoints[0][1] = p[1];
+        pPoints[0][2] = p[2];
+    }
+}
 
-    XMVECTOR u, v, t;
 
-    if( XMVector3GreaterOrEqual( det, Epsilon ) )
+
+//-----------------------------------------------------------------------------
+// Find the minimum axis aligned bounding box containing a set of points, as
+// ComputeBoundingAxisAlignedBoxFromPoints does, in parallel chunks.
+//-----------------------------------------------------------------------------
+VOID FitAxisAlignedBoxToPoints( AxisAlignedBox* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride,
+                                JobSystem* pJobSystem )
+{
+    XMASSERT( pOut );
+    XMASSERT( Count > 0 );
+    XMASSERT( pPoints );
+
+    std::vector<XMFLOAT3> ChunkMin( ( Count + FitChunkSize - 1 ) / FitChunkSize );
+    std::vector<XMFLOAT3> ChunkMax( ChunkMin.size() );
+
+    ForEachFitChunk( Count, pJobSystem, [&]( UINT First, UINT Last, UINT c )
     {
-        // Determinate is positive (front side of the triangle).
-        XMVECTOR s = Origin - V0;
+        // Two pairs of bounds, to keep the min and max of one point from
+        // waiting on those of the point before it.
+        XMVECTOR vMin0, vMax0, vMin1, vMax1;
 
-        // u = s * p;
-        u = XMVector3Dot( s, p );
+        vMin0 = vMax0 = vMin1 = vMax1 = XMLoadFloat3( FitPoint( pPoints, Stride, First ) );
 
-        XMVECTOR NoIntersection = XMVectorLess( u, Zero );
-        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( u, det ) );
+        UINT i = First + 1;
+        for( ; i + 2 <= Last; i += 2 )
+        {
+            XMVECTOR Point0 = XMLoadFloat3( FitPoint( pPoints, Stride, i ) );
+            XMVECTOR Point1 = XMLoadFloat3( FitPoint( pPoints, Stride, i + 1 ) );
 
-        // q = s ^ e1;
-        XMVECTOR q = XMVector3Cross( s, e1 );
+            vMin0 = XMVectorMin( vMin0, Point0 );
+            vMax0 = XMVectorMax( vMax0, Point0 );
+            vMin1 = XMVectorMin( vMin1, Point1 );
+            vMax1 = XMVectorMax( vMax1, Point1 );
+        }
 
-        // v = Direction * q;
-        v = XMVector3Dot( Direction, q );
+        if( i < Last )
+        {
+            XMVECTOR Point = XMLoadFloat3( FitPoint( pPoints, Stride, i ) );
 
-        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( v, Zero ) );
-        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( u + v, det ) );
+            vMin0 = XMVectorMin( vMin0, Point );
+            vMax0 = XMVectorMax( vMax0, Point );
+        }
 
-        // t = e2 * q;
-        t = XMVector3Dot( e2, q );
+        XMStoreFloat3( &ChunkMin[c], XMVectorMin( vMin0, vMin1 ) );
+        XMStoreFloat3( &ChunkMax[c], XMVectorMax( vMax0, vMax1 ) );
+    } );
 
-        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( t, Zero ) );
+    XMVECTOR vMin = XMLoadFloat3( &ChunkMin[0] );
+    XMVECTOR vMax = XMLoadFloat3( &ChunkMax[0] );
 
-        if( XMVector4EqualInt( NoIntersection, XMVectorTrueInt() ) )
-            return FALSE;
-    }
-    else if( XMVector3LessOrEqual( det, -Epsilon ) )
+    for( size_t c = 1; c < ChunkMin.size(); c++ )
     {
-        // Determinate is negative (back side of the triangle).
-        XMVECTOR s = Origin - V0;
+        vMin = XMVectorMin( vMin, XMLoadFloat3( &ChunkMin[c] ) );
+        vMax = XMVectorMax( vMax, XMLoadFloat3( &ChunkMax[c] ) );
+    }
 
-        // u = s * p;
-        u = XMVector3Dot( s, p );
+    // Store center and extents.
+    XMStoreFloat3( &pOut->Center, ( vMin + vMax ) * 0.5f );
+    XMStoreFloat3( &pOut->Extents, ( vMax - vMin ) * 0.5f );
 
-        XMVECTOR NoIntersection = XMVectorGreater( u, Zero );
-        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( u, det ) );
+    return;
+}
 
-        // q = s ^ e1;
-        XMVECTOR q = XMVector3Cross( s, e1 );
 
-        // v = Direction * q;
-        v = XMVector3Dot( Direction, q );
 
-        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( v, Zero ) );
-        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( u + v, det ) );
+//-----------------------------------------------------------------------------
+// Find a bounding sphere for a set of points that is within a small fraction
+// of the smallest one.  Where Ritter's algorithm starts from the extreme
+// points along x, y and z and grows the sphere to take in the rest, this
+// starts from the smallest sphere around the extreme points along seven
+// directions and refines it through a core set: the points farthest from its
+// center are added to the set and the smallest sphere around the set found
+// again, until no point is more than FitSphereTolerance outside it.  The
+// smallest sphere around a few points is cheap to find exactly, and every pass
+// over the points is one parallel search for the farthest ones.  The radius
+// returned is the distance to the farthest point, so the sphere always holds
+// every point.
+//-----------------------------------------------------------------------------
+VOID FitSphereToPoints( Sphere* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride, JobSystem* pJobSystem )
+{
+    XMASSERT( pOut );
+    XMASSERT( Count > 0 );
+    XMASSERT( pPoints );
 
-        // t = e2 * q;
-        t = XMVector3Dot( e2, q );
+    // Rarely reached; the core set of most point sets stays far smaller.
+    static const UINT MaxCoreSet = 256;
+    static const UINT MaxPointsPerPass = 16;
+    static const FLOAT FitSphereTolerance = 1.0e-4f;
 
-        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( t, Zero ) );
+    // Start with the extreme points along seven directions.
+    UINT ChunkCount = ( Count + FitChunkSize - 1 ) / FitChunkSize;
 
-        if ( XMVector4EqualInt( NoIntersection, XMVectorTrueInt() ) )
-            return FALSE;
-    }
-    else
+    std::vector<FLOAT> ChunkValues( ChunkCount * 2 * FitDirectionCount );
+    std::vector<UINT> ChunkIndices( ChunkValues.size() );
+
+    ForEachFitChunk( Count, pJobSystem, [&]( UINT First, UINT Last, UINT c )
     {
-        // Parallel ray.
-        return FALSE;
-    }
+        FindExtremePoints( &ChunkValues[c * 2 * FitDirectionCount], &ChunkIndices[c * 2 * FitDirectionCount],
+                           pPoints, Stride, First, Last );
+    } );
 
-    XMVECTOR inv_det = XMVectorReciprocal( det );
-
-    t *= inv_det;
-
-    // u * inv_det and v * inv_det are the barycentric cooridinates of the intersection.
+    double CoreSet[MaxCoreSet][3];
+    UINT CoreCount = 0;
 
-    // Store the x-component to *pDist
-    XMStoreFloat( pDist, t );
+    for( UINT k = 0; k < 2 * FitDirectionCount; k++ )
+    {
+        UINT Best = k;
+        for( UINT c = 1; c < ChunkCount; c++ )
+        {
+            UINT Other = c * 2 * FitDirectionCount + k;
+            BOOL Better = ( k & 1 ) ? ( ChunkValues[Other] > ChunkValues[Best] )
+                                    : ( ChunkValues[Other] < ChunkValues[Best] );
+            if( Better )
+                Best = Other;
+        }
 
-    return TRUE;
-}
+        const XMFLOAT3* p = FitPoint( pPoints, Stride, ChunkIndices[Best] );
 
+        CoreSet[CoreCount][0] = p->x;
+        CoreSet[CoreCount][1] = p->y;
+        CoreSet[CoreCount][2] = p->z;
+        CoreCount++;
+    }
 
+    std::vector<FLOAT> ChunkDistSq( ChunkCount );
+    std::vector<UINT> ChunkFarthest( ChunkDistSq.size() );
+    std::vector<UINT> Outside;
 
-//-----------------------------------------------------------------------------
-// Compute the intersection of a ray (Origin, Direction) with a sphere.
-//-----------------------------------------------------------------------------
-BOOL IntersectRaySphere( FXMVECTOR Origin, FXMVECTOR Direction, const Sphere* pVolume, FLOAT* pDist )
-{
-    XMASSERT( pVolume );
-    XMASSERT( pDist );
-    XMASSERT( XMVector3IsUnit( Direction ) );
+    XMVECTOR BestCenter = XMVectorZero();
+    FLOAT BestRadiusSq = FLT_MAX;
 
-    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
-    XMVECTOR Radius = XMVectorReplicatePtr( &pVolume->Radius );
+    for( ;; )
+    {
+        FitBall Ball;
+        double Support[4][3];
+        ComputeMinimumBall( &Ball, CoreSet, CoreCount, Support, 0 );
 
-    // l is the vector from the ray origin to the center of the sphere.
-    XMVECTOR l = Center - Origin;
+        XMVECTOR Center = XMVectorSet( ( FLOAT )Ball.Center[0], ( FLOAT )Ball.Center[1], ( FLOAT )Ball.Center[2], 0.0f );
 
-    // s is the projection of the l onto the ray direction.
-    XMVECTOR s = XMVector3Dot( l, Direction );
+        ForEachFitChunk( Count, pJobSystem, [&]( UINT First, UINT Last, UINT c )
+        {
+            FindFarthestPoint( &ChunkDistSq[c], &ChunkFarthest[c], Center, pPoints, Stride, First, Last );
+        } );
 
-    XMVECTOR l2 = XMVector3Dot( l, l );
+        FLOAT DistSq = ChunkDistSq[0];
+        for( size_t c = 1; c < ChunkDistSq.size(); c++ )
+            DistSq = ( ChunkDistSq[c] > DistSq ) ? ChunkDistSq[c] : DistSq;
 
-    XMVECTOR r2 = Radius * Radius;
+        if( DistSq < BestRadiusSq )
+        {
+            BestCenter = Center;
+            BestRadiusSq = DistSq;
+        }
 
-    // m2 is squared distance from the center of the sphere to the projection.
-    XMVECTOR m2 = l2 - s * s;
+        // No sphere around all the points is smaller than the one around the
+        // core set, so once the farthest point is about on it we are done.
+        FLOAT Limit = ( 1.0f + FitSphereTolerance ) * ( 1.0f + FitSphereTolerance ) * ( FLOAT )Ball.RadiusSq;
 
-    XMVECTOR NoIntersection;
+        if( DistSq <= Limit || CoreCount == MaxCoreSet )
+            break;
 
-    // If the ray origin is outside the sphere and the center of the sphere is 
-    // behind the ray origin there is no intersection.
-    NoIntersection = XMVectorAndInt( XMVectorLess( s, XMVectorZero() ), XMVectorGreater( l2, r2 ) );
+        // Add the farthest points of the chunks farthest outside, rather than
+        // only the farthest of all, which saves passes over the points.
+        Outside.clear();
+        for( UINT c = 0; c < ( UINT )ChunkDistSq.size(); c++ )
+        {
+            if( ChunkDistSq[c] > Limit )
+                Outside.push_back( c );
+        }
 
-    // If the squared distance from the center of the sphere to the projection
-    // is greater than the radius squared the ray will miss the sphere.
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( m2, r2 ) );
+        UINT AddCount = ( UINT )Outside.size();
+        AddCount = ( AddCount < MaxPointsPerPass ) ? AddCount : MaxPointsPerPass;
+        AddCount = ( AddCount < MaxCoreSet - CoreCount ) ? AddCount : MaxCoreSet - CoreCount;
 
-    // The ray hits the sphere, compute the nearest intersection point.
-    XMVECTOR q = XMVectorSqrt( r2 - m2 );
-    XMVECTOR t1 = s - q;
-    XMVECTOR t2 = s + q;
+        std::partial_sort( Outside.begin(), Outside.begin() + AddCount, Outside.end(), [&]( UINT a, UINT b )
+        {
+            return ChunkDistSq[a] > ChunkDistSq[b];
+        } );
 
-    XMVECTOR OriginInside = XMVectorLessOrEqual( l2, r2 );
-    XMVECTOR t = XMVectorSelect( t1, t2, OriginInside );
+        for( UINT k = 0; k < AddCount; k++ )
+        {
+            const XMFLOAT3* p = FitPoint( pPoints, Stride, ChunkFarthest[Outside[k]] );
 
-    if( XMVector4NotEqualInt( NoIntersection, XMVectorTrueInt() ) )
-    {
-        // Store the x-component to *pDist.
-        XMStoreFloat( pDist, t );
-        return TRUE;
+            CoreSet[CoreCount][0] = p->x;
+            CoreSet[CoreCount][1] = p->y;
+            CoreSet[CoreCount][2] = p->z;
+            CoreCount++;
+        }
     }
 
-    return FALSE;
+    XMStoreFloat3( &pOut->Center, BestCenter );
+    pOut->Radius = sqrtf( BestRadiusSq );
+
+    return;
 }
 
 
 
 //-----------------------------------------------------------------------------
-// Compute the intersection of a ray (Origin, Direction) with an axis aligned 
-// box using the slabs method.
+// Find the oriented bounding box of ComputeBoundingOrientedBoxFromPoints: the
+// eigenvectors of the covariance of the points are the axes of the box.  The
+// covariance comes out of the same parallel pass as the extents along x, y and
+// z, and a second pass finds the extents along the axes.  When the axis
+// aligned box is the smaller of the two, as it is for shapes that line up with
+// the axes but whose points do not spread evenly, that box is returned instead.
 //-----------------------------------------------------------------------------
-BOOL IntersectRayAxisAlignedBox( FXMVECTOR Origin, FXMVECTOR Direction, const AxisAlignedBox* pVolume, FLOAT* pDist )
+VOID FitOrientedBoxToPoints( OrientedBox* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride,
+                             JobSystem* pJobSystem )
 {
-    XMASSERT( pVolume );
-    XMASSERT( pDist );
-    XMASSERT( XMVector3IsUnit( Direction ) );
+    XMASSERT( pOut );
+    XMASSERT( Count > 0 );
+    XMASSERT( pPoints );
 
-    static const XMVECTOR Epsilon =
-    {
-        1e-20f, 1e-20f, 1e-20f, 1e-20f
-    };
-    static const XMVECTOR FltMin =
-    {
-        -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX
-    };
-    static const XMVECTOR FltMax =
+    FitMoments Moments;
+    ComputeFitMoments( &Moments, Count, pPoints, Stride, pJobSystem );
+
+    // Compute the eigenvectors of the covariance matrix.
+    FLOAT C[6];
+    for( UINT k = 0; k < 6; k++ )
+        C[k] = ( FLOAT )( Moments.Comoment[k] / Moments.Count );
+
+    XMVECTOR v1, v2, v3;
+    CalculateEigenVectorsFromCovarianceMatrix( C[0], C[1], C[2], C[3], C[4], C[5], &v1, &v2, &v3 );
+
+    XMVECTOR Orientation = OrientationFromEigenVectors( v1, v2, v3 );
+    XMMATRIX R = XMMatrixRotationQuaternion( Orientation );
+
+    // The coordinates of a point along the axes of the box are its dot
+    // products with the rows of R.
+    std::vector<XMFLOAT3> ChunkMin( ( Count + FitChunkSize - 1 ) / FitChunkSize );
+    std::vector<XMFLOAT3> ChunkMax( ChunkMin.size() );
+
+    ForEachFitChunk( Count, pJobSystem, [&]( UINT First, UINT Last, UINT c )
     {
-        FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX
-    };
+        XMVECTOR Ax[3], Ay[3], Az[3], Min[3], Max[3];
 
-    // Load the box.
-    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
-    XMVECTOR Extents = XMLoadFloat3( &pVolume->Extents );
+        for( UINT j = 0; j < 3; j++ )
+        {
+            Ax[j] = XMVectorSplatX( R.r[j] );
+            Ay[j] = XMVectorSplatY( R.r[j] );
+            Az[j] = XMVectorSplatZ( R.r[j] );
+            Min[j] = XMVectorReplicate( FLT_MAX );
+            Max[j] = XMVectorReplicate( -FLT_MAX );
+        }
 
-    // Adjust ray origin to be relative to center of the box.
-    XMVECTOR TOrigin = Center - Origin;
+        for( UINT i = First; i < Last; i += 4 )
+        {
+            XMVECTOR X, Y, Z;
+            LoadPoints4( &X, &Y, &Z, pPoints, Stride, i, Last, First );
 
-    // Compute the dot product againt each axis of the box.
-    // Since the axii are (1,0,0), (0,1,0), (0,0,1) no computation is necessary.
-    XMVECTOR AxisDotOrigin = TOrigin;
-    XMVECTOR AxisDotDirection = Direction;
+            for( UINT j = 0; j < 3; j++ )
+            {
+                XMVECTOR D = X * Ax[j] + Y * Ay[j] + Z * Az[j];
 
-    // if (fabs(AxisDotDirection) <= Epsilon) the ray is nearly parallel to the slab.
-    XMVECTOR IsParallel = XMVectorLessOrEqual( XMVectorAbs( AxisDotDirection ), Epsilon );
+                Min[j] = XMVectorMin( Min[j], D );
+                Max[j] = XMVectorMax( Max[j], D );
+            }
+        }
 
-    // Test against all three axii simultaneously.
-    XMVECTOR InverseAxisDotDirection = XMVectorReciprocal( AxisDotDirection );
-    XMVECTOR t1 = ( AxisDotOrigin - Extents ) * InverseAxisDotDirection;
-    XMVECTOR t2 = ( AxisDotOrigin + Extents ) * InverseAxisDotDirection;
+        FLOAT* pMin = &ChunkMin[c].x;
+        FLOAT* pMax = &ChunkMax[c].x;
 
-    // Compute the max of min(t1,t2) and the min of max(t1,t2) ensuring we don't
-    // use the results from any directions parallel to the slab.
-    XMVECTOR t_min = XMVectorSelect( XMVectorMin( t1, t2 ), FltMin, IsParallel );
-    XMVECTOR t_max = XMVectorSelect( XMVectorMax( t1, t2 ), FltMax, IsParallel );
+        for( UINT j = 0; j < 3; j++ )
+        {
+            pMin[j] = MinLane( Min[j] );
+            pMax[j] = MaxLane( Max[j] );
+        }
+    } );
 
-    // t_min.x = maximum( t_min.x, t_min.y, t_min.z );
-    // t_max.x = minimum( t_max.x, t_max.y, t_max.z );
-    t_min = XMVectorMax( t_min, XMVectorSplatY( t_min ) );  // x = max(x,y)
-    t_min = XMVectorMax( t_min, XMVectorSplatZ( t_min ) );  // x = max(max(x,y),z)
-    t_max = XMVectorMin( t_max, XMVectorSplatY( t_max ) );  // x = min(x,y)
-    t_max = XMVectorMin( t_max, XMVectorSplatZ( t_max ) );  // x = min(min(x,y),z)
+    XMVECTOR vMin = XMLoadFloat3( &ChunkMin[0] );
+    XMVECTOR vMax = XMLoadFloat3( &ChunkMax[0] );
 
-    // if ( t_min > t_max ) return FALSE;
-    XMVECTOR NoIntersection = XMVectorGreater( XMVectorSplatX( t_min ), XMVectorSplatX( t_max ) );
+    for( size_t c = 1; c < ChunkMin.size(); c++ )
+    {
+        vMin = XMVectorMin( vMin, XMLoadFloat3( &ChunkMin[c] ) );
+        vMax = XMVectorMax( vMax, XMLoadFloat3( &ChunkMax[c] ) );
+    }
 
-    // if ( t_max < 0.0f ) return FALSE;
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( XMVectorSplatX( t_max ), XMVectorZero() ) );
+    XMVECTOR Extents = ( vMax - vMin ) * 0.5f;
 
-    // if (IsParallel && (-Extents > AxisDotOrigin || Extents < AxisDotOrigin)) return FALSE;
-    XMVECTOR ParallelOverlap = XMVectorInBounds( AxisDotOrigin, Extents );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorAndCInt( IsParallel, ParallelOverlap ) );
+    // Compare with the axis aligned box, which the moments already hold.
+    XMVECTOR AlignedMin = XMLoadFloat3( &Moments.Min );
+    XMVECTOR AlignedMax = XMLoadFloat3( &Moments.Max );
+    XMVECTOR AlignedExtents = ( AlignedMax - AlignedMin ) * 0.5f;
 
-    if( !XMVector3AnyTrue( NoIntersection ) )
+    FLOAT Volume = XMVectorGetX( Extents ) * XMVectorGetY( Extents ) * XMVectorGetZ( Extents );
+    FLOAT AlignedVolume = XMVectorGetX( AlignedExtents ) * XMVectorGetY( AlignedExtents ) *
+                          XMVectorGetZ( AlignedExtents );
+
+    if( AlignedVolume <= Volume )
     {
-        // Store the x-component to *pDist
-        XMStoreFloat( pDist, t_min );
-        return TRUE;
+        XMStoreFloat3( &pOut->Center, ( AlignedMin + AlignedMax ) * 0.5f );
+        XMStoreFloat3( &pOut->Extents, AlignedExtents );
+        pOut->Orientation = XMFLOAT4( 0.0f, 0.0f, 0.0f, 1.0f );
+        return;
     }
 
-    return FALSE;
+    // Rotate the center into world space.
+    XMVECTOR Center = XMVector3TransformNormal( ( vMin + vMax ) * 0.5f, R );
+
+    // Store center, extents, and orientation.
+    XMStoreFloat3( &pOut->Center, Center );
+    XMStoreFloat3( &pOut->Extents, Extents );
+    XMStoreFloat4( &pOut->Orientation, Orientation );
+
+    return;
 }
 
 
 
 //-----------------------------------------------------------------------------
-// Compute the intersection of a ray (Origin, Direction) with an oriented box
-// using the slabs method.
+// Build a frustum from a persepective projection matrix.  The matrix may only
+// contain a projection; any rotation, translation or scale will cause the
+// constructed frustum to be incorrect.
 //-----------------------------------------------------------------------------
-BOOL IntersectRayOrientedBox( FXMVECTOR Origin, FXMVECTOR Direction, const OrientedBox* pVolume, FLOAT* pDist )
+VOID ComputeFrustumFromProjection( Frustum* pOut, XMMATRIX* pProjection )
 {
-    XMASSERT( pVolume );
-    XMASSERT( pDist );
-    XMASSERT( XMVector3IsUnit( Direction ) );
+    XMASSERT( pOut );
+    XMASSERT( pProjection );
 
-    static const XMVECTOR Epsilon =
-    {
-        1e-20f, 1e-20f, 1e-20f, 1e-20f
-    };
-    static const XMVECTOR FltMin =
-    {
-        -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX
-    };
-    static const XMVECTOR FltMax =
-    {
-        FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX
-    };
-    static const XMVECTORI32 SelectY =
-    {
-        XM_SELECT_0, XM_SELECT_1, XM_SELECT_0, XM_SELECT_0
-    };
-    static const XMVECTORI32 SelectZ =
+    // Corners of the projection frustum in homogenous space.
+    static XMVECTOR HomogenousPoints[6] =
     {
-        XM_SELECT_0, XM_SELECT_0, XM_SELECT_1, XM_SELECT_0
-    };
-
-    // Load the box.
-    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
-    XMVECTOR Extents = XMLoadFloat3( &pVolume->Extents );
-    XMVECTOR Orientation = XMLoadFloat4( &pVolume->Orientation );
+        {  1.0f,  0.0f, 1.0f, 1.0f },   // right (at far plane)
+        { -1.0f,  0.0f, 1.0f, 1.0f },   // left
+        {  0.0f,  1.0f, 1.0f, 1.0f },   // top
+        {  0.0f, -1.0f, 1.0f, 1.0f },   // bottom
 
-    XMASSERT( XMQuaternionIsUnit( Orientation ) );
+        { 0.0f, 0.0f, 0.0f, 1.0f },     // near
+        { 0.0f, 0.0f, 1.0f, 1.0f }      // far
+    };
 
-    // Get the boxes normalized side directions.
-    XMMATRIX R = XMMatrixRotationQuaternion( Orientation );
+    XMVECTOR Determinant;
+    XMMATRIX matInverse = XMMatrixInverse( &Determinant, *pProjection );
 
-    // Adjust ray origin to be relative to center of the box.
-    XMVECTOR TOrigin = Center - Origin;
+    // Compute the frustum corners in world space.
+    XMVECTOR Points[6];
 
-    // Compute the dot product againt each axis of the box.
-    XMVECTOR AxisDotOrigin = XMVector3Dot( R.r[0], TOrigin );
-    AxisDotOrigin = XMVectorSelect( AxisDotOrigin, XMVector3Dot( R.r[1], TOrigin ), SelectY );
-    AxisDotOrigin = XMVectorSelect( AxisDotOrigin, XMVector3Dot( R.r[2], TOrigin ), SelectZ );
+    for( INT i = 0; i < 6; i++ )
+    {
+        // Transform point.
+        Points[i] = XMVector4Transform( HomogenousPoints[i], matInverse );
+    }
 
-    XMVECTOR AxisDotDirection = XMVector3Dot( R.r[0], Direction );
-    AxisDotDirection = XMVectorSelect( AxisDotDirection, XMVector3Dot( R.r[1], Direction ), SelectY );
-    AxisDotDirection = XMVectorSelect( AxisDotDirection, XMVector3Dot( R.r[2], Direction ), SelectZ );
+    pOut->Origin = XMFLOAT3( 0.0f, 0.0f, 0.0f );
+    pOut->Orientation = XMFLOAT4( 0.0f, 0.0f, 0.0f, 1.0f );
 
-    // if (fabs(AxisDotDirection) <= Epsilon) the ray is nearly parallel to the slab.
-    XMVECTOR IsParallel = XMVectorLessOrEqual( XMVectorAbs( AxisDotDirection ), Epsilon );
+    // Compute the slopes.
+    Points[0] = Points[0] * XMVectorReciprocal( XMVectorSplatZ( Points[0] ) );
+    Points[1] = Points[1] * XMVectorReciprocal( XMVectorSplatZ( Points[1] ) );
+    Points[2] = Points[2] * XMVectorReciprocal( XMVectorSplatZ( Points[2] ) );
+    Points[3] = Points[3] * XMVectorReciprocal( XMVectorSplatZ( Points[3] ) );
 
-    // Test against all three axes simultaneously.
-    XMVECTOR InverseAxisDotDirection = XMVectorReciprocal( AxisDotDirection );
-    XMVECTOR t1 = ( AxisDotOrigin - Extents ) * InverseAxisDotDirection;
-    XMVECTOR t2 = ( AxisDotOrigin + Extents ) * InverseAxisDotDirection;
+    pOut->RightSlope = XMVectorGetX( Points[0] );
+    pOut->LeftSlope = XMVectorGetX( Points[1] );
+    pOut->TopSlope = XMVectorGetY( Points[2] );
+    pOut->BottomSlope = XMVectorGetY( Points[3] );
 
-    // Compute the max of min(t1,t2) and the min of max(t1,t2) ensuring we don't
-    // use the results from any directions parallel to the slab.
-    XMVECTOR t_min = XMVectorSelect( XMVectorMin( t1, t2 ), FltMin, IsParallel );
-    XMVECTOR t_max = XMVectorSelect( XMVectorMax( t1, t2 ), FltMax, IsParallel );
+    // Compute near and far.
+    Points[4] = Points[4] * XMVectorReciprocal( XMVectorSplatW( Points[4] ) );
+    Points[5] = Points[5] * XMVectorReciprocal( XMVectorSplatW( Points[5] ) );
 
-    // t_min.x = maximum( t_min.x, t_min.y, t_min.z );
-    // t_max.x = minimum( t_max.x, t_max.y, t_max.z );
-    t_min = XMVectorMax( t_min, XMVectorSplatY( t_min ) );  // x = max(x,y)
-    t_min = XMVectorMax( t_min, XMVectorSplatZ( t_min ) );  // x = max(max(x,y),z)
-    t_max = XMVectorMin( t_max, XMVectorSplatY( t_max ) );  // x = min(x,y)
-    t_max = XMVectorMin( t_max, XMVectorSplatZ( t_max ) );  // x = min(min(x,y),z)
+    pOut->Near = XMVectorGetZ( Points[4] );
+    pOut->Far = XMVectorGetZ( Points[5] );
 
-    // if ( t_min > t_max ) return FALSE;
-    XMVECTOR NoIntersection = XMVectorGreater( XMVectorSplatX( t_min ), XMVectorSplatX( t_max ) );
+    return;
+}
 
-    // if ( t_max < 0.0f ) return FALSE;
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( XMVectorSplatX( t_max ), XMVectorZero() ) );
 
-    // if (IsParallel && (-Extents > AxisDotOrigin || Extents < AxisDotOrigin)) return FALSE;
-    XMVECTOR ParallelOverlap = XMVectorInBounds( AxisDotOrigin, Extents );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorAndCInt( IsParallel, ParallelOverlap ) );
 
-    if( !XMVector3AnyTrue( NoIntersection ) )
-    {
-        // Store the x-component to *pDist
-        XMStoreFloat( pDist, t_min );
-        return TRUE;
-    }
+//-----------------------------------------------------------------------------
+// Build the 6 frustum planes from a frustum.
+//-----------------------------------------------------------------------------
+VOID ComputePlanesFromFrustum( const Frustum* pVolume, XMVECTOR* pPlane0, XMVECTOR* pPlane1, XMVECTOR* pPlane2,
+                               XMVECTOR* pPlane3, XMVECTOR* pPlane4, XMVECTOR* pPlane5 )
+{
+    XMASSERT( pVolume );
+    XMASSERT( pPlane0 );
+    XMASSERT( pPlane1 );
+    XMASSERT( pPlane2 );
+    XMASSERT( pPlane3 );
+    XMASSERT( pPlane4 );
+    XMASSERT( pPlane5 );
 
-    return FALSE;
+    // Load origin and orientation of the frustum.
+    XMVECTOR Origin = XMLoadFloat3( &pVolume->Origin );
+    XMVECTOR Orientation = XMLoadFloat4( &pVolume->Orientation );
+
+    // Build the frustum planes.
+    XMVECTOR Plane0 = XMVectorSet( 0.0f, 0.0f, -1.0f, pVolume->Near );
+    XMVECTOR Plane1 = XMVectorSet( 0.0f, 0.0f, 1.0f, -pVolume->Far );
+    XMVECTOR Plane2 = XMVectorSet( 1.0f, 0.0f, -pVolume->RightSlope, 0.0f );
+    XMVECTOR Plane3 = XMVectorSet( -1.0f, 0.0f, pVolume->LeftSlope, 0.0f );
+    XMVECTOR Plane4 = XMVectorSet( 0.0f, 1.0f, -pVolume->TopSlope, 0.0f );
+    XMVECTOR Plane5 = XMVectorSet( 0.0f, -1.0f, pVolume->BottomSlope, 0.0f );
+
+    Plane0 = TransformPlane( Plane0, Orientation, Origin );
+    Plane1 = TransformPlane( Plane1, Orientation, Origin );
+    Plane2 = TransformPlane( Plane2, Orientation, Origin );
+    Plane3 = TransformPlane( Plane3, Orientation, Origin );
+    Plane4 = TransformPlane( Plane4, Orientation, Origin );
+    Plane5 = TransformPlane( Plane5, Orientation, Origin );
+
+    *pPlane0 = XMPlaneNormalize( Plane0 );
+    *pPlane1 = XMPlaneNormalize( Plane1 );
+    *pPlane2 = XMPlaneNormalize( Plane2 );
+    *pPlane3 = XMPlaneNormalize( Plane3 );
+    *pPlane4 = XMPlaneNormalize( Plane4 );
+    *pPlane5 = XMPlaneNormalize( Plane5 );
 }
 
 
 
 //-----------------------------------------------------------------------------
-// Test if two triangles intersect.
-//
-// The final test of algorithm is based on Shen, Heng, and Tang, "A Fast 
-// Triangle-Triangle Overlap Test Using Signed Distances", Journal of Graphics 
-// Tools, vol. 8, no. 1, pp 17-23, 2003 and Guigue and Devillers, "Fast and 
-// Robust Triangle-Triangle Overlap Test Using Orientation Predicates", Journal 
-// of Graphics Tools, vol. 8, no. 1, pp 25-32, 2003.
-//
-// The final test could be considered an edge-edge separating plane test with
-// the 9 possible cases narrowed down to the only two pairs of edges that can 
-// actaully result in a seperation.
+// Build a packet of up to four triangles from indices into an array of
+// points.  Unused lanes are degenerate triangles at the origin, which rays
+// never intersect.
 //-----------------------------------------------------------------------------
-BOOL IntersectTriangleTriangle( FXMVECTOR A0, FXMVECTOR A1, FXMVECTOR A2, CXMVECTOR B0, CXMVECTOR B1, CXMVECTOR B2 )
+VOID ComputeTrianglePacket( TrianglePacket* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride,
+                            const UINT* pIndices )
 {
-    static const XMVECTOR Epsilon =
-    {
-        1e-20f, 1e-20f, 1e-20f, 1e-20f
-    };
-    static const XMVECTORI32 SelectY =
-    {
-        XM_SELECT_0, XM_SELECT_1, XM_SELECT_0, XM_SELECT_0
-    };
-    static const XMVECTORI32 SelectZ =
-    {
-        XM_SELECT_0, XM_SELECT_0, XM_SELECT_1, XM_SELECT_0
-    };
-    static const XMVECTORI32 Select0111 =
-    {
-        XM_SELECT_0, XM_SELECT_1, XM_SELECT_1, XM_SELECT_1
-    };
-    static const XMVECTORI32 Select1011 =
-    {
-        XM_SELECT_1, XM_SELECT_0, XM_SELECT_1, XM_SELECT_1
-    };
-    static const XMVECTORI32 Select1101 =
+    XMASSERT( pOut );
+    XMASSERT( Count <= 4 );
+    XMASSERT( Count == 0 || ( pPoints && pIndices ) );
+
+    XMVECTORF32 V0[3], E1[3], E2[3];
+
+    for( UINT i = 0; i < 4; i++ )
     {
-        XM_SELECT_1, XM_SELECT_1, XM_SELECT_0, XM_SELECT_1
-    };
+        XMVECTOR v0 = XMVectorZero();
+        XMVECTOR e1 = XMVectorZero();
+        XMVECTOR e2 = XMVectorZero();
 
-    XMVECTOR Zero = XMVectorZero();
+        if( i < Count )
+        {
+            v0 = XMLoadFloat3( ( XMFLOAT3* )( ( BYTE* )pPoints + pIndices[i * 3 + 0] * Stride ) );
+            e1 = XMLoadFloat3( ( XMFLOAT3* )( ( BYTE* )pPoints + pIndices[i * 3 + 1] * Stride ) ) - v0;
+            e2 = XMLoadFloat3( ( XMFLOAT3* )( ( BYTE* )pPoints + pIndices[i * 3 + 2] * Stride ) ) - v0;
+        }
 
-    // Compute the normal of triangle A.
-    XMVECTOR N1 = XMVector3Cross( A1 - A0, A2 - A0 );
+        V0[0].f[i] = XMVectorGetX( v0 ); V0[1].f[i] = XMVectorGetY( v0 ); V0[2].f[i] = XMVectorGetZ( v0 );
+        E1[0].f[i] = XMVectorGetX( e1 ); E1[1].f[i] = XMVectorGetY( e1 ); E1[2].f[i] = XMVectorGetZ( e1 );
+        E2[0].f[i] = XMVectorGetX( e2 ); E2[1].f[i] = XMVectorGetY( e2 ); E2[2].f[i] = XMVectorGetZ( e2 );
+    }
 
-    // Assert that the triangle is not degenerate.
-    XMASSERT( !XMVector3Equal( N1, Zero ) );
+    for( UINT c = 0; c < 3; c++ )
+    {
+        pOut->V0[c] = V0[c].v;
+        pOut->E1[c] = E1[c].v;
+        pOut->E2[c] = E2[c].v;
+    }
 
-    // Test points of B against the plane of A.
-    XMVECTOR BDist = XMVector3Dot( N1, B0 - A0 );
-    BDist = XMVectorSelect( BDist, XMVector3Dot( N1, B1 - A0 ), SelectY );
-    BDist = XMVectorSelect( BDist, XMVector3Dot( N1, B2 - A0 ), SelectZ );
+    return;
+}
 
-    // Ensure robustness with co-planar triangles by zeroing small distances.
-    UINT BDistIsZeroCR;
-    XMVECTOR BDistIsZero = XMVectorGreaterR( &BDistIsZeroCR, Epsilon, XMVectorAbs( BDist ) );
-    BDist = XMVectorSelect( BDist, Zero, BDistIsZero );
 
-    UINT BDistIsLessCR;
-    XMVECTOR BDistIsLess = XMVectorGreaterR( &BDistIsLessCR, Zero, BDist );
 
-    UINT BDistIsGreaterCR;
-    XMVECTOR BDistIsGreater = XMVectorGreaterR( &BDistIsGreaterCR, BDist, Zero );
+//-----------------------------------------------------------------------------
+// Build a packet of up to four rays.  Unused lanes have no direction, so they
+// never intersect anything.
+//-----------------------------------------------------------------------------
+VOID ComputeRayPacket( RayPacket* pOut, UINT Count, const XMFLOAT3* pOrigins, const XMFLOAT3* pDirections )
+{
+    XMASSERT( pOut );
+    XMASSERT( Count <= 4 );
+    XMASSERT( Count == 0 || ( pOrigins && pDirections ) );
 
-    // If all the points are on the same side we don't intersect.
-    if( XMComparisonAllTrue( BDistIsLessCR ) || XMComparisonAllTrue( BDistIsGreaterCR ) )
-        return FALSE;
+    XMVECTORF32 Origin[3], Direction[3];
 
-    // Compute the normal of triangle B.
-    XMVECTOR N2 = XMVector3Cross( B1 - B0, B2 - B0 );
+    for( UINT i = 0; i < 4; i++ )
+    {
+        XMFLOAT3 o( 0.0f, 0.0f, 0.0f );
+        XMFLOAT3 d( 0.0f, 0.0f, 0.0f );
 
-    // Assert that the triangle is not degenerate.
-    XMASSERT( !XMVector3Equal( N2, Zero ) );
+        if( i < Count )
+        {
+            o = pOrigins[i];
+            d = pDirections[i];
+            XMASSERT( XMVector3IsUnit( XMLoadFloat3( &d ) ) );
+        }
 
-    // Test points of A against the plane of B.
-    XMVECTOR ADist = XMVector3Dot( N2, A0 - B0 );
-    ADist = XMVectorSelect( ADist, XMVector3Dot( N2, A1 - B0 ), SelectY );
-    ADist = XMVectorSelect( ADist, XMVector3Dot( N2, A2 - B0 ), SelectZ );
+        Origin[0].f[i] = o.x; Origin[1].f[i] = o.y; Origin[2].f[i] = o.z;
+        Direction[0].f[i] = d.x; Direction[1].f[i] = d.y; Direction[2].f[i] = d.z;
+    }
 
-    // Ensure robustness with co-planar triangles by zeroing small distances.
-    UINT ADistIsZeroCR;
-    XMVECTOR ADistIsZero = XMVectorGreaterR( &ADistIsZeroCR, Epsilon, XMVectorAbs( BDist ) );
-    ADist = XMVectorSelect( ADist, Zero, ADistIsZero );
+    for( UINT c = 0; c < 3; c++ )
+    {
+        pOut->Origin[c] = Origin[c].v;
+        pOut->Direction[c] = Direction[c].v;
+    }
 
-    UINT ADistIsLessCR;
-    XMVECTOR ADistIsLess = XMVectorGreaterR( &ADistIsLessCR, Zero, ADist );
+    return;
+}
 
-    UINT ADistIsGreaterCR;
-    XMVECTOR ADistIsGreater = XMVectorGreaterR( &ADistIsGreaterCR, ADist, Zero );
 
-    // If all the points are on the same side we don't intersect.
-    if( XMComparisonAllTrue( ADistIsLessCR ) || XMComparisonAllTrue( ADistIsGreaterCR ) )
-        return FALSE;
 
-    // Special case for co-planar triangles.
-    if( XMComparisonAllTrue( ADistIsZeroCR ) || XMComparisonAllTrue( BDistIsZeroCR ) )
+//-----------------------------------------------------------------------------
+// Expand the orientations of Count boxes for IntersectOrientedBoxPairs.
+//-----------------------------------------------------------------------------
+VOID ComputeOrientedBoxAxes( OrientedBoxAxes* pOut, const OrientedBox* pIn, UINT Count )
+{
+    XMASSERT( ( pOut && pIn ) || Count == 0 );
+
+    for( UINT i = 0; i < Count; i++ )
     {
-        XMVECTOR Axis, Dist, MinDist;
+        XMVECTOR Orientation = XMLoadFloat4( &pIn[i].Orientation );
+        XMASSERT( XMQuaternionIsUnit( Orientation ) );
 
-        // Compute an axis perpindicular to the edge (points out).
-        Axis = XMVector3Cross( N1, A1 - A0 );
-        Dist = XMVector3Dot( Axis, A0 );
+        XMMATRIX R = XMMatrixRotationQuaternion( Orientation );
 
-        // Test points of B against the axis.
-        MinDist = XMVector3Dot( B0, Axis );
-        MinDist = XMVectorMin( MinDist, XMVector3Dot( B1, Axis ) );
-        MinDist = XMVectorMin( MinDist, XMVector3Dot( B2, Axis ) );
-        if( XMVector4GreaterOrEqual( MinDist, Dist ) )
-            return FALSE;
+        pOut[i].Center = pIn[i].Center;
+        pOut[i].Extents = pIn[i].Extents;
+        XMStoreFloat3( &pOut[i].Axis[0], R.r[0] );
+        XMStoreFloat3( &pOut[i].Axis[1], R.r[1] );
+        XMStoreFloat3( &pOut[i].Axis[2], R.r[2] );
+        pOut[i].Pad = 0.0f;
+    }
+}
 
-        // Edge (A1, A2)
-        Axis = XMVector3Cross( N1, A2 - A1 );
-        Dist = XMVector3Dot( Axis, A1 );
 
-        MinDist = XMVector3Dot( B0, Axis );
-        MinDist = XMVectorMin( MinDist, XMVector3Dot( B1, Axis ) );
-        MinDist = XMVectorMin( MinDist, XMVector3Dot( B2, Axis ) );
-        if( XMVector4GreaterOrEqual( MinDist, Dist ) )
-            return FALSE;
 
-        // Edge (A2, A0)
-        Axis = XMVector3Cross( N1, A0 - A2 );
-        Dist = XMVector3Dot( Axis, A2 );
+//-----------------------------------------------------------------------------
+// Transform a sphere by an angle preserving transform.
+//-----------------------------------------------------------------------------
+VOID TransformSphere( Sphere* pOut, const Sphere* pIn, FLOAT Scale, FXMVECTOR Rotation, FXMVECTOR Translation )
+{
+    XMASSERT( pOut );
+    XMASSERT( pIn );
+    XMASSERT( XMQuaternionIsUnit( Rotation ) );
 
-        MinDist = XMVector3Dot( B0, Axis );
-        MinDist = XMVectorMin( MinDist, XMVector3Dot( B1, Axis ) );
-        MinDist = XMVectorMin( MinDist, XMVector3Dot( B2, Axis ) );
-        if( XMVector4GreaterOrEqual( MinDist, Dist ) )
-            return FALSE;
+    // Load the center of the sphere.
+    XMVECTOR Center = XMLoadFloat3( &pIn->Center );
 
-        // Edge (B0, B1)
-        Axis = XMVector3Cross( N2, B1 - B0 );
-        Dist = XMVector3Dot( Axis, B0 );
+    // Transform the center of the sphere.
+    Center = XMVector3Rotate( Center * XMVectorReplicate( Scale ), Rotation ) + Translation;
 
-        MinDist = XMVector3Dot( A0, Axis );
-        MinDist = XMVectorMin( MinDist, XMVector3Dot( A1, Axis ) );
-        MinDist = XMVectorMin( MinDist, XMVector3Dot( A2, Axis ) );
-        if( XMVector4GreaterOrEqual( MinDist, Dist ) )
-            return FALSE;
+    // Store the center sphere.
+    XMStoreFloat3( &pOut->Center, Center );
 
-        // Edge (B1, B2)
-        Axis = XMVector3Cross( N2, B2 - B1 );
-        Dist = XMVector3Dot( Axis, B1 );
+    // Scale the radius of the pshere.
+    pOut->Radius = pIn->Radius * Scale;
 
-        MinDist = XMVector3Dot( A0, Axis );
-        MinDist = XMVectorMin( MinDist, XMVector3Dot( A1, Axis ) );
-        MinDist = XMVectorMin( MinDist, XMVector3Dot( A2, Axis ) );
-        if( XMVector4GreaterOrEqual( MinDist, Dist ) )
-            return FALSE;
+    return;
+}
 
-        // Edge (B2,B0)
-        Axis = XMVector3Cross( N2, B0 - B2 );
-        Dist = XMVector3Dot( Axis, B2 );
 
-        MinDist = XMVector3Dot( A0, Axis );
-        MinDist = XMVectorMin( MinDist, XMVector3Dot( A1, Axis ) );
-        MinDist = XMVectorMin( MinDist, XMVector3Dot( A2, Axis ) );
-        if( XMVector4GreaterOrEqual( MinDist, Dist ) )
-            return FALSE;
 
-        return TRUE;
-    }
+//-----------------------------------------------------------------------------
+// Transform an axis aligned box by an angle preserving transform.
+//-----------------------------------------------------------------------------
+VOID TransformAxisAlignedBox( AxisAlignedBox* pOut, const AxisAlignedBox* pIn, FLOAT Scale, FXMVECTOR Rotation,
+                              FXMVECTOR Translation )
+{
+    XMASSERT( pOut );
+    XMASSERT( pIn );
+    XMASSERT( XMQuaternionIsUnit( Rotation ) );
 
-    //
-    // Find the single vertex of A and B (ie the vertex on the opposite side
-    // of the plane from the other two) and reorder the edges so we can compute 
-    // the signed edge/edge distances.
-    //
-    // if ( (V0 >= 0 && V1 <  0 && V2 <  0) ||
-    //      (V0 >  0 && V1 <= 0 && V2 <= 0) ||
-    //      (V0 <= 0 && V1 >  0 && V2 >  0) ||
-    //      (V0 <  0 && V1 >= 0 && V2 >= 0) ) then V0 is singular;
-    //
-    // If our singular vertex is not on the positive side of the plane we reverse
-    // the triangle winding so that the overlap comparisons will compare the 
-    // correct edges with the correct signs.
-    //
-    XMVECTOR ADistIsLessEqual = XMVectorOrInt( ADistIsLess, ADistIsZero );
-    XMVECTOR ADistIsGreaterEqual = XMVectorOrInt( ADistIsGreater, ADistIsZero );
+    static XMVECTOR Offset[8] =
+    {
+        { -1.0f, -1.0f, -1.0f, 0.0f },
+        { -1.0f, -1.0f,  1.0f, 0.0f },
+        { -1.0f,  1.0f, -1.0f, 0.0f },
+        { -1.0f,  1.0f,  1.0f, 0.0f },
+        {  1.0f, -1.0f, -1.0f, 0.0f },
+        {  1.0f, -1.0f,  1.0f, 0.0f },
+        {  1.0f,  1.0f, -1.0f, 0.0f },
+        {  1.0f,  1.0f,  1.0f, 0.0f }
+    };
 
-    XMVECTOR AA0, AA1, AA2;
-    bool bPositiveA;
+    // Load center and extents.
+    XMVECTOR Center = XMLoadFloat3( &pIn->Center );
+    XMVECTOR Extents = XMLoadFloat3( &pIn->Extents );
 
-    if( XMVector3AllTrue( XMVectorSelect( ADistIsGreaterEqual, ADistIsLess, Select0111 ) ) ||
-        XMVector3AllTrue( XMVectorSelect( ADistIsGreater, ADistIsLessEqual, Select0111 ) ) )
-    {
-        // A0 is singular, crossing from positive to negative.
-        AA0 = A0; AA1 = A1; AA2 = A2;
-        bPositiveA = true;
-    }
-    else if( XMVector3AllTrue( XMVectorSelect( ADistIsLessEqual, ADistIsGreater, Select0111 ) ) ||
-             XMVector3AllTrue( XMVectorSelect( ADistIsLess, ADistIsGreaterEqual, Select0111 ) ) )
-    {
-        // A0 is singular, crossing from negative to positive.
-        AA0 = A0; AA1 = A2; AA2 = A1;
-        bPositiveA = false;
-    }
-    else if( XMVector3AllTrue( XMVectorSelect( ADistIsGreaterEqual, ADistIsLess, Select1011 ) ) ||
-             XMVector3AllTrue( XMVectorSelect( ADistIsGreater, ADistIsLessEqual, Select1011 ) ) )
-    {
-        // A1 is singular, crossing from positive to negative.
-        AA0 = A1; AA1 = A2; AA2 = A0;
-        bPositiveA = true;
-    }
-    else if( XMVector3AllTrue( XMVectorSelect( ADistIsLessEqual, ADistIsGreater, Select1011 ) ) ||
-             XMVector3AllTrue( XMVectorSelect( ADistIsLess, ADistIsGreaterEqual, Select1011 ) ) )
-    {
-        // A1 is singular, crossing from negative to positive.
-        AA0 = A1; AA1 = A0; AA2 = A2;
-        bPositiveA = false;
-    }
-    else if( XMVector3AllTrue( XMVectorSelect( ADistIsGreaterEqual, ADistIsLess, Select1101 ) ) ||
-             XMVector3AllTrue( XMVectorSelect( ADistIsGreater, ADistIsLessEqual, Select1101 ) ) )
-    {
-        // A2 is singular, crossing from positive to negative.
-        AA0 = A2; AA1 = A0; AA2 = A1;
-        bPositiveA = true;
-    }
-    else if( XMVector3AllTrue( XMVectorSelect( ADistIsLessEqual, ADistIsGreater, Select1101 ) ) ||
-             XMVector3AllTrue( XMVectorSelect( ADistIsLess, ADistIsGreaterEqual, Select1101 ) ) )
-    {
-        // A2 is singular, crossing from negative to positive.
-        AA0 = A2; AA1 = A1; AA2 = A0;
-        bPositiveA = false;
-    }
-    else
-    {
-        XMASSERT( FALSE );
-        return FALSE;
-    }
+    XMVECTOR VectorScale = XMVectorReplicate( Scale );
 
-    XMVECTOR BDistIsLessEqual = XMVectorOrInt( BDistIsLess, BDistIsZero );
-    XMVECTOR BDistIsGreaterEqual = XMVectorOrInt( BDistIsGreater, BDistIsZero );
+    // Compute and transform the corners and find new min/max bounds.
+    XMVECTOR Corner = Center + Extents * Offset[0];
+    Corner = XMVector3Rotate( Corner * VectorScale, Rotation ) + Translation;
 
-    XMVECTOR BB0, BB1, BB2;
-    bool bPositiveB;
+    XMVECTOR Min, Max;
+    Min = Max = Corner;
 
-    if( XMVector3AllTrue( XMVectorSelect( BDistIsGreaterEqual, BDistIsLess, Select0111 ) ) ||
-        XMVector3AllTrue( XMVectorSelect( BDistIsGreater, BDistIsLessEqual, Select0111 ) ) )
-    {
-        // B0 is singular, crossing from positive to negative.
-        BB0 = B0; BB1 = B1; BB2 = B2;
-        bPositiveB = true;
-    }
-    else if( XMVector3AllTrue( XMVectorSelect( BDistIsLessEqual, BDistIsGreater, Select0111 ) ) ||
-             XMVector3AllTrue( XMVectorSelect( BDistIsLess, BDistIsGreaterEqual, Select0111 ) ) )
-    {
-        // B0 is singular, crossing from negative to positive.
-        BB0 = B0; BB1 = B2; BB2 = B1;
-        bPositiveB = false;
-    }
-    else if( XMVector3AllTrue( XMVectorSelect( BDistIsGreaterEqual, BDistIsLess, Select1011 ) ) ||
-             XMVector3AllTrue( XMVectorSelect( BDistIsGreater, BDistIsLessEqual, Select1011 ) ) )
-    {
-        // B1 is singular, crossing from positive to negative.
-        BB0 = B1; BB1 = B2; BB2 = B0;
-        bPositiveB = true;
-    }
-    else if( XMVector3AllTrue( XMVectorSelect( BDistIsLessEqual, BDistIsGreater, Select1011 ) ) ||
-             XMVector3AllTrue( XMVectorSelect( BDistIsLess, BDistIsGreaterEqual, Select1011 ) ) )
-    {
-        // B1 is singular, crossing from negative to positive.
-        BB0 = B1; BB1 = B0; BB2 = B2;
-        bPositiveB = false;
-    }
-    else if( XMVector3AllTrue( XMVectorSelect( BDistIsGreaterEqual, BDistIsLess, Select1101 ) ) ||
-             XMVector3AllTrue( XMVectorSelect( BDistIsGreater, BDistIsLessEqual, Select1101 ) ) )
-    {
-        // B2 is singular, crossing from positive to negative.
-        BB0 = B2; BB1 = B0; BB2 = B1;
-        bPositiveB = true;
-    }
-    else if( XMVector3AllTrue( XMVectorSelect( BDistIsLessEqual, BDistIsGreater, Select1101 ) ) ||
-             XMVector3AllTrue( XMVectorSelect( BDistIsLess, BDistIsGreaterEqual, Select1101 ) ) )
-    {
-        // B2 is singular, crossing from negative to positive.
-        BB0 = B2; BB1 = B1; BB2 = B0;
-        bPositiveB = false;
-    }
-    else
+    for( INT i = 1; i < 8; i++ )
     {
-        XMASSERT( FALSE );
-        return FALSE;
+        Corner = Center + Extents * Offset[i];
+        Corner = XMVector3Rotate( Corner * VectorScale, Rotation ) + Translation;
+
+        Min = XMVectorMin( Min, Corner );
+        Max = XMVectorMax( Max, Corner );
     }
 
-    XMVECTOR Delta0, Delta1;
+    // Store center and extents.
+    XMStoreFloat3( &pOut->Center, ( Min + Max ) * 0.5f );
+    XMStoreFloat3( &pOut->Extents, ( Max - Min ) * 0.5f );
 
-    // Reverse the direction of the test depending on whether the singular vertices are
-    // the same sign or different signs.
-    if( bPositiveA ^ bPositiveB )
-    {
-        Delta0 = ( BB0 - AA0 );
-        Delta1 = ( AA0 - BB0 );
-    }
-    else
-    {
-        Delta0 = ( AA0 - BB0 );
-        Delta1 = ( BB0 - AA0 );
-    }
+    return;
+}
 
-    // Check if the triangles overlap on the line of intersection between the
-    // planes of the two triangles by finding the signed line distances.
-    XMVECTOR Dist0 = XMVector3Dot( Delta0, XMVector3Cross( ( BB2 - BB0 ), ( AA2 - AA0 ) ) );
-    if( XMVector4Greater( Dist0, Zero ) )
-        return FALSE;
 
-    XMVECTOR Dist1 = XMVector3Dot( Delta1, XMVector3Cross( ( BB1 - BB0 ), ( AA1 - AA0 ) ) );
-    if( XMVector4Greater( Dist1, Zero ) )
-        return FALSE;
 
-    return TRUE;
+//-----------------------------------------------------------------------------
+// Transform an oriented box by an angle preserving transform.
+//-----------------------------------------------------------------------------
+VOID TransformOrientedBox( OrientedBox* pOut, const OrientedBox* pIn, FLOAT Scale, FXMVECTOR Rotation,
+                           FXMVECTOR Translation )
+{
+    XMASSERT( pOut );
+    XMASSERT( pIn );
+    XMASSERT( XMQuaternionIsUnit( Rotation ) );
+
+    // Load the box.
+    XMVECTOR Center = XMLoadFloat3( &pIn->Center );
+    XMVECTOR Extents = XMLoadFloat3( &pIn->Extents );
+    XMVECTOR Orientation = XMLoadFloat4( &pIn->Orientation );
+
+    XMASSERT( XMQuaternionIsUnit( Orientation ) );
+
+    // Composite the box rotation and the transform rotation.
+    Orientation = XMQuaternionMultiply( Orientation, Rotation );
+
+    // Transform the center.
+    XMVECTOR VectorScale = XMVectorReplicate( Scale );
+    Center = XMVector3Rotate( Center * VectorScale, Rotation ) + Translation;
+
+    // Scale the box extents.
+    Extents = Extents * VectorScale;
+
+    // Store the box.
+    XMStoreFloat3( &pOut->Center, Center );
+    XMStoreFloat3( &pOut->Extents, Extents );
+    XMStoreFloat4( &pOut->Orientation, Orientation );
+
+    return;
 }
 
 
 
 //-----------------------------------------------------------------------------
-BOOL IntersectTriangleSphere( FXMVECTOR V0, FXMVECTOR V1, FXMVECTOR V2, const Sphere* pVolume )
+// Transform a frustum by an angle preserving transform.
+//-----------------------------------------------------------------------------
+VOID TransformFrustum( Frustum* pOut, const Frustum* pIn, FLOAT Scale, FXMVECTOR Rotation, FXMVECTOR Translation )
 {
-    XMASSERT( pVolume );
+    XMASSERT( pOut );
+    XMASSERT( pIn );
+    XMASSERT( XMQuaternionIsUnit( Rotation ) );
 
-    // Load the sphere.    
-    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
-    XMVECTOR Radius = XMVectorReplicatePtr( &pVolume->Radius );
+    // Load the frustum.
+    XMVECTOR Origin = XMLoadFloat3( &pIn->Origin );
+    XMVECTOR Orientation = XMLoadFloat4( &pIn->Orientation );
 
-    // Compute the plane of the triangle (has to be normalized).
-    XMVECTOR N = XMVector3Normalize( XMVector3Cross( V1 - V0, V2 - V0 ) );
+    XMASSERT( XMQuaternionIsUnit( Orientation ) );
 
-    // Assert that the triangle is not degenerate.
-    XMASSERT( !XMVector3Equal( N, XMVectorZero() ) );
+    // Composite the frustum rotation and the transform rotation.
+    Orientation = XMQuaternionMultiply( Orientation, Rotation );
 
-    // Find the nearest feature on the triangle to the sphere.
-    XMVECTOR Dist = XMVector3Dot( Center - V0, N );
+    // Transform the origin.
+    Origin = XMVector3Rotate( Origin * XMVectorReplicate( Scale ), Rotation ) + Translation;
 
-    // If the center of the sphere is farther from the plane of the triangle than
-    // the radius of the sphere, then there cannot be an intersection.
-    XMVECTOR NoIntersection = XMVectorLess( Dist, -Radius );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Dist, Radius ) );
+    // Store the frustum.
+    XMStoreFloat3( &pOut->Origin, Origin );
+    XMStoreFloat4( &pOut->Orientation, Orientation );
 
-    // Project the center of the sphere onto the plane of the triangle.
-    XMVECTOR Point = Center - ( N * Dist );
+    // Scale the near and far distances (the slopes remain the same).
+    pOut->Near = pIn->Near * Scale;
+    pOut->Far = pIn->Far * Scale;
 
-    // Is it inside all the edges? If so we intersect because the distance 
-    // to the plane is less than the radius.
-    XMVECTOR Intersection = PointOnPlaneInsideTriangle( Point, V0, V1, V2 );
+    // Copy the slopes.
+    pOut->RightSlope = pIn->RightSlope;
+    pOut->LeftSlope = pIn->LeftSlope;
+    pOut->TopSlope = pIn->TopSlope;
+    pOut->BottomSlope = pIn->BottomSlope;
 
-    // Find the nearest point on each edge.
-    XMVECTOR RadiusSq = Radius * Radius;
+    return;
+}
 
-    // Edge 0,1
-    Point = PointOnLineSegmentNearestPoint( V0, V1, Center );
 
-    // If the distance to the center of the sphere to the point is less than 
-    // the radius of the sphere then it must intersect.
-    Intersection = XMVectorOrInt( Intersection, XMVectorLessOrEqual( XMVector3LengthSq( Center - Point ), RadiusSq ) );
 
-    // Edge 1,2
-    Point = PointOnLineSegmentNearestPoint( V1, V2, Center );
+//-----------------------------------------------------------------------------
+// Point in sphere test.
+//-----------------------------------------------------------------------------
+BOOL IntersectPointSphere( FXMVECTOR Point, const Sphere* pVolume )
+{
+    XMASSERT( pVolume );
 
-    // If the distance to the center of the sphere to the point is less than 
-    // the radius of the sphere then it must intersect.
-    Intersection = XMVectorOrInt( Intersection, XMVectorLessOrEqual( XMVector3LengthSq( Center - Point ), RadiusSq ) );
+    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
+    XMVECTOR Radius = XMVectorReplicatePtr( &pVolume->Radius );
 
-    // Edge 2,0
-    Point = PointOnLineSegmentNearestPoint( V2, V0, Center );
+    XMVECTOR DistanceSquared = XMVector3LengthSq( Point - Center );
+    XMVECTOR RadiusSquared = Radius * Radius;
 
-    // If the distance to the center of the sphere to the point is less than 
-    // the radius of the sphere then it must intersect.
-    Intersection = XMVectorOrInt( Intersection, XMVectorLessOrEqual( XMVector3LengthSq( Center - Point ), RadiusSq ) );
+    return XMVector4LessOrEqual( DistanceSquared, RadiusSquared );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Point in axis aligned box test.
+//-----------------------------------------------------------------------------
+BOOL IntersectPointAxisAlignedBox( FXMVECTOR Point, const AxisAlignedBox* pVolume )
+{
+    XMASSERT( pVolume );
+
+    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
+    XMVECTOR Extents = XMLoadFloat3( &pVolume->Extents );
+
+    return XMVector3InBounds( Point - Center, Extents );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Point in oriented box test.
+//-----------------------------------------------------------------------------
+BOOL IntersectPointOrientedBox( FXMVECTOR Point, const OrientedBox* pVolume )
+{
+    XMASSERT( pVolume );
+
+    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
+    XMVECTOR Extents = XMLoadFloat3( &pVolume->Extents );
+    XMVECTOR Orientation = XMLoadFloat4( &pVolume->Orientation );
+
+    XMASSERT( XMQuaternionIsUnit( Orientation ) );
+
+    // Transform the point to be local to the box.
+    XMVECTOR TPoint = XMVector3InverseRotate( Point - Center, Orientation );
+
+    return XMVector3InBounds( TPoint, Extents );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Point in frustum test.
+//-----------------------------------------------------------------------------
+BOOL IntersectPointFrustum( FXMVECTOR Point, const Frustum* pVolume )
+{
+    static const XMVECTORU32 SelectW = {XM_SELECT_0, XM_SELECT_0, XM_SELECT_0, XM_SELECT_1};
+    static const XMVECTORU32 SelectZ = {XM_SELECT_0, XM_SELECT_0, XM_SELECT_1, XM_SELECT_0};
+
+    static const XMVECTOR BasePlanes[6] = 
+    {
+        {  0.0f,  0.0f, -1.0f, 0.0f },
+        {  0.0f,  0.0f,  1.0f, 0.0f },
+        {  1.0f,  0.0f,  0.0f, 0.0f },
+        { -1.0f,  0.0f,  0.0f, 0.0f },
+        {  0.0f,  1.0f,  0.0f, 0.0f },
+        {  0.0f, -1.0f,  0.0f, 0.0f },
+    };
+
+    XMASSERT( pVolume );
+
+    // Build frustum planes.
+    XMVECTOR Planes[6];
+    Planes[0] = XMVectorSelect( BasePlanes[0], XMVectorSplatX(  XMLoadFloat( &pVolume->Near ) ),
+                                SelectW );
+    Planes[1] = XMVectorSelect( BasePlanes[1], XMVectorSplatX( -XMLoadFloat( &pVolume->Far ) ),
+                                SelectW );
+    Planes[2] = XMVectorSelect( BasePlanes[2], XMVectorSplatX( -XMLoadFloat( &pVolume->RightSlope ) ),
+                                SelectZ );
+    Planes[3] = XMVectorSelect( BasePlanes[3], XMVectorSplatX(  XMLoadFloat( &pVolume->LeftSlope ) ),
+                                SelectZ );
+    Planes[4] = XMVectorSelect( BasePlanes[4], XMVectorSplatX( -XMLoadFloat( &pVolume->TopSlope ) ),
+                                SelectZ );
+    Planes[5] = XMVectorSelect( BasePlanes[5], XMVectorSplatX(  XMLoadFloat( &pVolume->BottomSlope ) ),
+                                SelectZ );
+
+    // Load origin and orientation.
+    XMVECTOR Origin = XMLoadFloat3( &pVolume->Origin );
+    XMVECTOR Orientation = XMLoadFloat4( &pVolume->Orientation );
+
+    XMASSERT( XMQuaternionIsUnit( Orientation ) );
+
+    // Transform point into local space of frustum.
+    XMVECTOR TPoint = XMVector3InverseRotate( Point - Origin, Orientation );
+
+    // Set w to one.
+    TPoint = XMVectorInsert( TPoint, XMVectorSplatOne(), 0, 0, 0, 0, 1);
+
+    XMVECTOR Zero = XMVectorZero();
+    XMVECTOR Outside = Zero;
+
+    // Test point against each plane of the frustum.
+    for( INT i = 0; i < 6; i++ )
+    {
+        XMVECTOR Dot = XMVector4Dot( TPoint, Planes[i] );
+        Outside = XMVectorOrInt( Outside, XMVectorGreater( Dot, Zero ) );
+    }
+
+    return XMVector4NotEqualInt( Outside, XMVectorTrueInt() );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Compute the intersection of a ray (Origin, Direction) with a triangle 
+// (V0, V1, V2).  Return TRUE if there is an intersection and also set *pDist 
+// to the distance along the ray to the intersection.
+// 
+// The algorithm is based on Moller, Tomas and Trumbore, "Fast, Minimum Storage 
+// Ray-Triangle Intersection", Journal of Graphics Tools, vol. 2, no. 1, 
+// pp 21-28, 1997.
+//-----------------------------------------------------------------------------
+BOOL IntersectRayTriangle( FXMVECTOR Origin, FXMVECTOR Direction, FXMVECTOR V0, CXMVECTOR V1, CXMVECTOR V2,
+                           FLOAT* pDist )
+{
+    XMASSERT( pDist );
+    XMASSERT( XMVector3IsUnit( Direction ) );
+
+    static const XMVECTOR Epsilon =
+    {
+        1e-20f, 1e-20f, 1e-20f, 1e-20f
+    };
+
+    XMVECTOR Zero = XMVectorZero();
+
+    XMVECTOR e1 = V1 - V0;
+    XMVECTOR e2 = V2 - V0;
+
+    // p = Direction ^ e2;
+    XMVECTOR p = XMVector3Cross( Direction, e2 );
+
+    // det = e1 * p;
+    XMVECTOR det = XMVector3Dot( e1, p );
+
+    XMVECTOR u, v, t;
+
+    if( XMVector3GreaterOrEqual( det, Epsilon ) )
+    {
+        // Determinate is positive (front side of the triangle).
+        XMVECTOR s = Origin - V0;
+
+        // u = s * p;
+        u = XMVector3Dot( s, p );
+
+        XMVECTOR NoIntersection = XMVectorLess( u, Zero );
+        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( u, det ) );
+
+        // q = s ^ e1;
+        XMVECTOR q = XMVector3Cross( s, e1 );
+
+        // v = Direction * q;
+        v = XMVector3Dot( Direction, q );
+
+        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( v, Zero ) );
+        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( u + v, det ) );
+
+        // t = e2 * q;
+        t = XMVector3Dot( e2, q );
+
+        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( t, Zero ) );
+
+        if( XMVector4EqualInt( NoIntersection, XMVectorTrueInt() ) )
+            return FALSE;
+    }
+    else if( XMVector3LessOrEqual( det, -Epsilon ) )
+    {
+        // Determinate is negative (back side of the triangle).
+        XMVECTOR s = Origin - V0;
+
+        // u = s * p;
+        u = XMVector3Dot( s, p );
+
+        XMVECTOR NoIntersection = XMVectorGreater( u, Zero );
+        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( u, det ) );
+
+        // q = s ^ e1;
+        XMVECTOR q = XMVector3Cross( s, e1 );
+
+        // v = Direction * q;
+        v = XMVector3Dot( Direction, q );
+
+        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( v, Zero ) );
+        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( u + v, det ) );
+
+        // t = e2 * q;
+        t = XMVector3Dot( e2, q );
+
+        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( t, Zero ) );
+
+        if ( XMVector4EqualInt( NoIntersection, XMVectorTrueInt() ) )
+            return FALSE;
+    }
+    else
+    {
+        // Parallel ray.
+        return FALSE;
+    }
+
+    XMVECTOR inv_det = XMVectorReciprocal( det );
+
+    t *= inv_det;
+
+    // u * inv_det and v * inv_det are the barycentric cooridinates of the intersection.
+
+    // Store the x-component to *pDist
+    XMStoreFloat( pDist, t );
+
+    return TRUE;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// IntersectRayTriangle on four ray/triangle pairs stored a component at a
+// time.  Every lane goes through the same operations in the same order as
+// IntersectRayTriangle, so hits and distances match it exactly; the front
+// and back side cases are both evaluated and the determinant picks one.
+// Returns a mask with the lanes that intersect set to 0xffffffff.
+//-----------------------------------------------------------------------------
+static inline XMVECTOR IntersectRayTriangle4( const XMVECTOR* Origin, const XMVECTOR* Direction,
+                                              const XMVECTOR* V0, const XMVECTOR* E1, const XMVECTOR* E2,
+                                              XMVECTOR* pDist )
+{
+    static const XMVECTOR Epsilon =
+    {
+        1e-20f, 1e-20f, 1e-20f, 1e-20f
+    };
+
+    XMVECTOR Zero = XMVectorZero();
+
+    // p = Direction ^ e2;
+    XMVECTOR px = Direction[1] * E2[2] - Direction[2] * E2[1];
+    XMVECTOR py = Direction[2] * E2[0] - Direction[0] * E2[2];
+    XMVECTOR pz = Direction[0] * E2[1] - Direction[1] * E2[0];
+
+    // det = e1 * p;
+    XMVECTOR det = E1[0] * px + E1[1] * py + E1[2] * pz;
+
+    // s = Origin - V0;
+    XMVECTOR sx = Origin[0] - V0[0];
+    XMVECTOR sy = Origin[1] - V0[1];
+    XMVECTOR sz = Origin[2] - V0[2];
+
+    // u = s * p;
+    XMVECTOR u = sx * px + sy * py + sz * pz;
+
+    // q = s ^ e1;
+    XMVECTOR qx = sy * E1[2] - sz * E1[1];
+    XMVECTOR qy = sz * E1[0] - sx * E1[2];
+    XMVECTOR qz = sx * E1[1] - sy * E1[0];
+
+    // v = Direction * q;
+    XMVECTOR v = Direction[0] * qx + Direction[1] * qy + Direction[2] * qz;
+
+    // t = e2 * q;
+    XMVECTOR t = E2[0] * qx + E2[1] * qy + E2[2] * qz;
+
+    XMVECTOR uv = u + v;
+
+    // Determinate is positive (front side of the triangle).
+    XMVECTOR NoIntersection = XMVectorLess( u, Zero );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( u, det ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( v, Zero ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( uv, det ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( t, Zero ) );
+
+    XMVECTOR Front = XMVectorAndCInt( XMVectorGreaterOrEqual( det, Epsilon ), NoIntersection );
+
+    // Determinate is negative (back side of the triangle).
+    NoIntersection = XMVectorGreater( u, Zero );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( u, det ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( v, Zero ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( uv, det ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( t, Zero ) );
+
+    XMVECTOR Back = XMVectorAndCInt( XMVectorLessOrEqual( det, -Epsilon ), NoIntersection );
+
+    // Parallel rays are in neither case.
+    XMVECTOR inv_det = XMVectorReciprocal( det );
+
+    *pDist = t * inv_det;
+
+    return XMVectorOrInt( Front, Back );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Turn a lane mask into the bits of the lanes that are set.
+//-----------------------------------------------------------------------------
+static inline UINT LaneMaskToBits( FXMVECTOR Mask )
+{
+    XMVECTORU32 M;
+    M.v = Mask;
+
+    return ( M.u[0] & 1 ) | ( M.u[1] & 2 ) | ( M.u[2] & 4 ) | ( M.u[3] & 8 );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Compute the intersections of a ray (Origin, Direction) with a packet of four
+// triangles.  Return a bit for each triangle the ray intersects and set that
+// lane of *pDist to the distance along the ray to the intersection.
+//-----------------------------------------------------------------------------
+UINT IntersectRayTrianglePacket( FXMVECTOR Origin, FXMVECTOR Direction, const TrianglePacket* pTriangles,
+                                 XMVECTOR* pDist )
+{
+    XMASSERT( pTriangles );
+    XMASSERT( pDist );
+    XMASSERT( XMVector3IsUnit( Direction ) );
+
+    XMVECTOR O[3] = { XMVectorSplatX( Origin ), XMVectorSplatY( Origin ), XMVectorSplatZ( Origin ) };
+    XMVECTOR D[3] = { XMVectorSplatX( Direction ), XMVectorSplatY( Direction ), XMVectorSplatZ( Direction ) };
+
+    XMVECTOR Hit = IntersectRayTriangle4( O, D, pTriangles->V0, pTriangles->E1, pTriangles->E2, pDist );
+
+    return LaneMaskToBits( Hit );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Compute the intersections of a packet of four rays with a triangle
+// (V0, V1, V2).  Return a bit for each ray that intersects the triangle and set
+// that lane of *pDist to the distance along the ray to the intersection.
+//-----------------------------------------------------------------------------
+UINT IntersectRayPacketTriangle( const RayPacket* pRays, FXMVECTOR V0, FXMVECTOR V1, CXMVECTOR V2,
+                                 XMVECTOR* pDist )
+{
+    XMASSERT( pRays );
+    XMASSERT( pDist );
+
+    XMVECTOR e1 = V1 - V0;
+    XMVECTOR e2 = V2 - V0;
+
+    XMVECTOR TV0[3] = { XMVectorSplatX( V0 ), XMVectorSplatY( V0 ), XMVectorSplatZ( V0 ) };
+    XMVECTOR E1[3] = { XMVectorSplatX( e1 ), XMVectorSplatY( e1 ), XMVectorSplatZ( e1 ) };
+    XMVECTOR E2[3] = { XMVectorSplatX( e2 ), XMVectorSplatY( e2 ), XMVectorSplatZ( e2 ) };
+
+    XMVECTOR Hit = IntersectRayTriangle4( pRays->Origin, pRays->Direction, TV0, E1, E2, pDist );
+
+    return LaneMaskToBits( Hit );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Compute the intersection of a ray (Origin, Direction) with a sphere.
+//-----------------------------------------------------------------------------
+BOOL IntersectRaySphere( FXMVECTOR Origin, FXMVECTOR Direction, const Sphere* pVolume, FLOAT* pDist )
+{
+    XMASSERT( pVolume );
+    XMASSERT( pDist );
+    XMASSERT( XMVector3IsUnit( Direction ) );
+
+    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
+    XMVECTOR Radius = XMVectorReplicatePtr( &pVolume->Radius );
+
+    // l is the vector from the ray origin to the center of the sphere.
+    XMVECTOR l = Center - Origin;
+
+    // s is the projection of the l onto the ray direction.
+    XMVECTOR s = XMVector3Dot( l, Direction );
+
+    XMVECTOR l2 = XMVector3Dot( l, l );
+
+    XMVECTOR r2 = Radius * Radius;
+
+    // m2 is squared distance from the center of the sphere to the projection.
+    XMVECTOR m2 = l2 - s * s;
+
+    XMVECTOR NoIntersection;
+
+    // If the ray origin is outside the sphere and the center of the sphere is 
+    // behind the ray origin there is no intersection.
+    NoIntersection = XMVectorAndInt( XMVectorLess( s, XMVectorZero() ), XMVectorGreater( l2, r2 ) );
+
+    // If the squared distance from the center of the sphere to the projection
+    // is greater than the radius squared the ray will miss the sphere.
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( m2, r2 ) );
+
+    // The ray hits the sphere, compute the nearest intersection point.
+    XMVECTOR q = XMVectorSqrt( r2 - m2 );
+    XMVECTOR t1 = s - q;
+    XMVECTOR t2 = s + q;
+
+    XMVECTOR OriginInside = XMVectorLessOrEqual( l2, r2 );
+    XMVECTOR t = XMVectorSelect( t1, t2, OriginInside );
+
+    if( XMVector4NotEqualInt( NoIntersection, XMVectorTrueInt() ) )
+    {
+        // Store the x-component to *pDist.
+        XMStoreFloat( pDist, t );
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Compute the intersection of a ray (Origin, Direction) with an axis aligned 
+// box using the slabs method.
+//-----------------------------------------------------------------------------
+BOOL IntersectRayAxisAlignedBox( FXMVECTOR Origin, FXMVECTOR Direction, const AxisAlignedBox* pVolume, FLOAT* pDist )
+{
+    XMASSERT( pVolume );
+    XMASSERT( pDist );
+    XMASSERT( XMVector3IsUnit( Direction ) );
+
+    static const XMVECTOR Epsilon =
+    {
+        1e-20f, 1e-20f, 1e-20f, 1e-20f
+    };
+    static const XMVECTOR FltMin =
+    {
+        -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX
+    };
+    static const XMVECTOR FltMax =
+    {
+        FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX
+    };
+
+    // Load the box.
+    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
+    XMVECTOR Extents = XMLoadFloat3( &pVolume->Extents );
+
+    // Adjust ray origin to be relative to center of the box.
+    XMVECTOR TOrigin = Center - Origin;
+
+    // Compute the dot product againt each axis of the box.
+    // Since the axii are (1,0,0), (0,1,0), (0,0,1) no computation is necessary.
+    XMVECTOR AxisDotOrigin = TOrigin;
+    XMVECTOR AxisDotDirection = Direction;
+
+    // if (fabs(AxisDotDirection) <= Epsilon) the ray is nearly parallel to the slab.
+    XMVECTOR IsParallel = XMVectorLessOrEqual( XMVectorAbs( AxisDotDirection ), Epsilon );
+
+    // Test against all three axii simultaneously.
+    XMVECTOR InverseAxisDotDirection = XMVectorReciprocal( AxisDotDirection );
+    XMVECTOR t1 = ( AxisDotOrigin - Extents ) * InverseAxisDotDirection;
+    XMVECTOR t2 = ( AxisDotOrigin + Extents ) * InverseAxisDotDirection;
+
+    // Compute the max of min(t1,t2) and the min of max(t1,t2) ensuring we don't
+    // use the results from any directions parallel to the slab.
+    XMVECTOR t_min = XMVectorSelect( XMVectorMin( t1, t2 ), FltMin, IsParallel );
+    XMVECTOR t_max = XMVectorSelect( XMVectorMax( t1, t2 ), FltMax, IsParallel );
+
+    // t_min.x = maximum( t_min.x, t_min.y, t_min.z );
+    // t_max.x = minimum( t_max.x, t_max.y, t_max.z );
+    t_min = XMVectorMax( t_min, XMVectorSplatY( t_min ) );  // x = max(x,y)
+    t_min = XMVectorMax( t_min, XMVectorSplatZ( t_min ) );  // x = max(max(x,y),z)
+    t_max = XMVectorMin( t_max, XMVectorSplatY( t_max ) );  // x = min(x,y)
+    t_max = XMVectorMin( t_max, XMVectorSplatZ( t_max ) );  // x = min(min(x,y),z)
+
+    // if ( t_min > t_max ) return FALSE;
+    XMVECTOR NoIntersection = XMVectorGreater( XMVectorSplatX( t_min ), XMVectorSplatX( t_max ) );
+
+    // if ( t_max < 0.0f ) return FALSE;
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( XMVectorSplatX( t_max ), XMVectorZero() ) );
+
+    // if (IsParallel && (-Extents > AxisDotOrigin || Extents < AxisDotOrigin)) return FALSE;
+    XMVECTOR ParallelOverlap = XMVectorInBounds( AxisDotOrigin, Extents );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorAndCInt( IsParallel, ParallelOverlap ) );
+
+    if( !XMVector3AnyTrue( NoIntersection ) )
+    {
+        // Store the x-component to *pDist
+        XMStoreFloat( pDist, t_min );
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Compute the intersection of a ray (Origin, Direction) with an oriented box
+// using the slabs method.
+//-----------------------------------------------------------------------------
+BOOL IntersectRayOrientedBox( FXMVECTOR Origin, FXMVECTOR Direction, const OrientedBox* pVolume, FLOAT* pDist )
+{
+    XMASSERT( pVolume );
+    XMASSERT( pDist );
+    XMASSERT( XMVector3IsUnit( Direction ) );
+
+    static const XMVECTOR Epsilon =
+    {
+        1e-20f, 1e-20f, 1e-20f, 1e-20f
+    };
+    static const XMVECTOR FltMin =
+    {
+        -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX
+    };
+    static const XMVECTOR FltMax =
+    {
+        FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX
+    };
+    static const XMVECTORI32 SelectY =
+    {
+        XM_SELECT_0, XM_SELECT_1, XM_SELECT_0, XM_SELECT_0
+    };
+    static const XMVECTORI32 SelectZ =
+    {
+        XM_SELECT_0, XM_SELECT_0, XM_SELECT_1, XM_SELECT_0
+    };
+
+    // Load the box.
+    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
+    XMVECTOR Extents = XMLoadFloat3( &pVolume->Extents );
+    XMVECTOR Orientation = XMLoadFloat4( &pVolume->Orientation );
+
+    XMASSERT( XMQuaternionIsUnit( Orientation ) );
+
+    // Get the boxes normalized side directions.
+    XMMATRIX R = XMMatrixRotationQuaternion( Orientation );
+
+    // Adjust ray origin to be relative to center of the box.
+    XMVECTOR TOrigin = Center - Origin;
+
+    // Compute the dot product againt each axis of the box.
+    XMVECTOR AxisDotOrigin = XMVector3Dot( R.r[0], TOrigin );
+    AxisDotOrigin = XMVectorSelect( AxisDotOrigin, XMVector3Dot( R.r[1], TOrigin ), SelectY );
+    AxisDotOrigin = XMVectorSelect( AxisDotOrigin, XMVector3Dot( R.r[2], TOrigin ), SelectZ );
+
+    XMVECTOR AxisDotDirection = XMVector3Dot( R.r[0], Direction );
+    AxisDotDirection = XMVectorSelect( AxisDotDirection, XMVector3Dot( R.r[1], Direction ), SelectY );
+    AxisDotDirection = XMVectorSelect( AxisDotDirection, XMVector3Dot( R.r[2], Direction ), SelectZ );
+
+    // if (fabs(AxisDotDirection) <= Epsilon) the ray is nearly parallel to the slab.
+    XMVECTOR IsParallel = XMVectorLessOrEqual( XMVectorAbs( AxisDotDirection ), Epsilon );
+
+    // Test against all three axes simultaneously.
+    XMVECTOR InverseAxisDotDirection = XMVectorReciprocal( AxisDotDirection );
+    XMVECTOR t1 = ( AxisDotOrigin - Extents ) * InverseAxisDotDirection;
+    XMVECTOR t2 = ( AxisDotOrigin + Extents ) * InverseAxisDotDirection;
+
+    // Compute the max of min(t1,t2) and the min of max(t1,t2) ensuring we don't
+    // use the results from any directions parallel to the slab.
+    XMVECTOR t_min = XMVectorSelect( XMVectorMin( t1, t2 ), FltMin, IsParallel );
+    XMVECTOR t_max = XMVectorSelect( XMVectorMax( t1, t2 ), FltMax, IsParallel );
+
+    // t_min.x = maximum( t_min.x, t_min.y, t_min.z );
+    // t_max.x = minimum( t_max.x, t_max.y, t_max.z );
+    t_min = XMVectorMax( t_min, XMVectorSplatY( t_min ) );  // x = max(x,y)
+    t_min = XMVectorMax( t_min, XMVectorSplatZ( t_min ) );  // x = max(max(x,y),z)
+    t_max = XMVectorMin( t_max, XMVectorSplatY( t_max ) );  // x = min(x,y)
+    t_max = XMVectorMin( t_max, XMVectorSplatZ( t_max ) );  // x = min(min(x,y),z)
+
+    // if ( t_min > t_max ) return FALSE;
+    XMVECTOR NoIntersection = XMVectorGreater( XMVectorSplatX( t_min ), XMVectorSplatX( t_max ) );
+
+    // if ( t_max < 0.0f ) return FALSE;
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( XMVectorSplatX( t_max ), XMVectorZero() ) );
+
+    // if (IsParallel && (-Extents > AxisDotOrigin || Extents < AxisDotOrigin)) return FALSE;
+    XMVECTOR ParallelOverlap = XMVectorInBounds( AxisDotOrigin, Extents );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorAndCInt( IsParallel, ParallelOverlap ) );
+
+    if( !XMVector3AnyTrue( NoIntersection ) )
+    {
+        // Store the x-component to *pDist
+        XMStoreFloat( pDist, t_min );
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Test if two triangles intersect.
+//
+// The final test of algorithm is based on Shen, Heng, and Tang, "A Fast 
+// Triangle-Triangle Overlap Test Using Signed Distances", Journal of Graphics 
+// Tools, vol. 8, no. 1, pp 17-23, 2003 and Guigue and Devillers, "Fast and 
+// Robust Triangle-Triangle Overlap Test Using Orientation Predicates", Journal 
+// of Graphics Tools, vol. 8, no. 1, pp 25-32, 2003.
+//
+// The final test could be considered an edge-edge separating plane test with
+// the 9 possible cases narrowed down to the only two pairs of edges that can 
+// actaully result in a seperation.
+//-----------------------------------------------------------------------------
+BOOL IntersectTriangleTriangle( FXMVECTOR A0, FXMVECTOR A1, FXMVECTOR A2, CXMVECTOR B0, CXMVECTOR B1, CXMVECTOR B2 )
+{
+    static const XMVECTOR Epsilon =
+    {
+        1e-20f, 1e-20f, 1e-20f, 1e-20f
+    };
+    static const XMVECTORI32 SelectY =
+    {
+        XM_SELECT_0, XM_SELECT_1, XM_SELECT_0, XM_SELECT_0
+    };
+    static const XMVECTORI32 SelectZ =
+    {
+        XM_SELECT_0, XM_SELECT_0, XM_SELECT_1, XM_SELECT_0
+    };
+    static const XMVECTORI32 Select0111 =
+    {
+        XM_SELECT_0, XM_SELECT_1, XM_SELECT_1, XM_SELECT_1
+    };
+    static const XMVECTORI32 Select1011 =
+    {
+        XM_SELECT_1, XM_SELECT_0, XM_SELECT_1, XM_SELECT_1
+    };
+    static const XMVECTORI32 Select1101 =
+    {
+        XM_SELECT_1, XM_SELECT_1, XM_SELECT_0, XM_SELECT_1
+    };
+
+    XMVECTOR Zero = XMVectorZero();
+
+    // Compute the normal of triangle A.
+    XMVECTOR N1 = XMVector3Cross( A1 - A0, A2 - A0 );
+
+    // Assert that the triangle is not degenerate.
+    XMASSERT( !XMVector3Equal( N1, Zero ) );
+
+    // Test points of B against the plane of A.
+    XMVECTOR BDist = XMVector3Dot( N1, B0 - A0 );
+    BDist = XMVectorSelect( BDist, XMVector3Dot( N1, B1 - A0 ), SelectY );
+    BDist = XMVectorSelect( BDist, XMVector3Dot( N1, B2 - A0 ), SelectZ );
+
+    // Ensure robustness with co-planar triangles by zeroing small distances.
+    UINT BDistIsZeroCR;
+    XMVECTOR BDistIsZero = XMVectorGreaterR( &BDistIsZeroCR, Epsilon, XMVectorAbs( BDist ) );
+    BDist = XMVectorSelect( BDist, Zero, BDistIsZero );
+
+    UINT BDistIsLessCR;
+    XMVECTOR BDistIsLess = XMVectorGreaterR( &BDistIsLessCR, Zero, BDist );
+
+    UINT BDistIsGreaterCR;
+    XMVECTOR BDistIsGreater = XMVectorGreaterR( &BDistIsGreaterCR, BDist, Zero );
+
+    // If all the points are on the same side we don't intersect.
+    if( XMComparisonAllTrue( BDistIsLessCR ) || XMComparisonAllTrue( BDistIsGreaterCR ) )
+        return FALSE;
+
+    // Compute the normal of triangle B.
+    XMVECTOR N2 = XMVector3Cross( B1 - B0, B2 - B0 );
+
+    // Assert that the triangle is not degenerate.
+    XMASSERT( !XMVector3Equal( N2, Zero ) );
+
+    // Test points of A against the plane of B.
+    XMVECTOR ADist = XMVector3Dot( N2, A0 - B0 );
+    ADist = XMVectorSelect( ADist, XMVector3Dot( N2, A1 - B0 ), SelectY );
+    ADist = XMVectorSelect( ADist, XMVector3Dot( N2, A2 - B0 ), SelectZ );
+
+    // Ensure robustness with co-planar triangles by zeroing small distances.
+    UINT ADistIsZeroCR;
+    XMVECTOR ADistIsZero = XMVectorGreaterR( &ADistIsZeroCR, Epsilon, XMVectorAbs( BDist ) );
+    ADist = XMVectorSelect( ADist, Zero, ADistIsZero );
+
+    UINT ADistIsLessCR;
+    XMVECTOR ADistIsLess = XMVectorGreaterR( &ADistIsLessCR, Zero, ADist );
+
+    UINT ADistIsGreaterCR;
+    XMVECTOR ADistIsGreater = XMVectorGreaterR( &ADistIsGreaterCR, ADist, Zero );
+
+    // If all the points are on the same side we don't intersect.
+    if( XMComparisonAllTrue( ADistIsLessCR ) || XMComparisonAllTrue( ADistIsGreaterCR ) )
+        return FALSE;
+
+    // Special case for co-planar triangles.
+    if( XMComparisonAllTrue( ADistIsZeroCR ) || XMComparisonAllTrue( BDistIsZeroCR ) )
+    {
+        XMVECTOR Axis, Dist, MinDist;
+
+        // Compute an axis perpindicular to the edge (points out).
+        Axis = XMVector3Cross( N1, A1 - A0 );
+        Dist = XMVector3Dot( Axis, A0 );
+
+        // Test points of B against the axis.
+        MinDist = XMVector3Dot( B0, Axis );
+        MinDist = XMVectorMin( MinDist, XMVector3Dot( B1, Axis ) );
+        MinDist = XMVectorMin( MinDist, XMVector3Dot( B2, Axis ) );
+        if( XMVector4GreaterOrEqual( MinDist, Dist ) )
+            return FALSE;
+
+        // Edge (A1, A2)
+        Axis = XMVector3Cross( N1, A2 - A1 );
+        Dist = XMVector3Dot( Axis, A1 );
+
+        MinDist = XMVector3Dot( B0, Axis );
+        MinDist = XMVectorMin( MinDist, XMVector3Dot( B1, Axis ) );
+        MinDist = XMVectorMin( MinDist, XMVector3Dot( B2, Axis ) );
+        if( XMVector4GreaterOrEqual( MinDist, Dist ) )
+            return FALSE;
+
+        // Edge (A2, A0)
+        Axis = XMVector3Cross( N1, A0 - A2 );
+        Dist = XMVector3Dot( Axis, A2 );
+
+        MinDist = XMVector3Dot( B0, Axis );
+        MinDist = XMVectorMin( MinDist, XMVector3Dot( B1, Axis ) );
+        MinDist = XMVectorMin( MinDist, XMVector3Dot( B2, Axis ) );
+        if( XMVector4GreaterOrEqual( MinDist, Dist ) )
+            return FALSE;
+
+        // Edge (B0, B1)
+        Axis = XMVector3Cross( N2, B1 - B0 );
+        Dist = XMVector3Dot( Axis, B0 );
+
+        MinDist = XMVector3Dot( A0, Axis );
+        MinDist = XMVectorMin( MinDist, XMVector3Dot( A1, Axis ) );
+        MinDist = XMVectorMin( MinDist, XMVector3Dot( A2, Axis ) );
+        if( XMVector4GreaterOrEqual( MinDist, Dist ) )
+            return FALSE;
+
+        // Edge (B1, B2)
+        Axis = XMVector3Cross( N2, B2 - B1 );
+        Dist = XMVector3Dot( Axis, B1 );
+
+        MinDist = XMVector3Dot( A0, Axis );
+        MinDist = XMVectorMin( MinDist, XMVector3Dot( A1, Axis ) );
+        MinDist = XMVectorMin( MinDist, XMVector3Dot( A2, Axis ) );
+        if( XMVector4GreaterOrEqual( MinDist, Dist ) )
+            return FALSE;
+
+        // Edge (B2,B0)
+        Axis = XMVector3Cross( N2, B0 - B2 );
+        Dist = XMVector3Dot( Axis, B2 );
+
+        MinDist = XMVector3Dot( A0, Axis );
+        MinDist = XMVectorMin( MinDist, XMVector3Dot( A1, Axis ) );
+        MinDist = XMVectorMin( MinDist, XMVector3Dot( A2, Axis ) );
+        if( XMVector4GreaterOrEqual( MinDist, Dist ) )
+            return FALSE;
+
+        return TRUE;
+    }
+
+    //
+    // Find the single vertex of A and B (ie the vertex on the opposite side
+    // of the plane from the other two) and reorder the edges so we can compute 
+    // the signed edge/edge distances.
+    //
+    // if ( (V0 >= 0 && V1 <  0 && V2 <  0) ||
+    //      (V0 >  0 && V1 <= 0 && V2 <= 0) ||
+    //      (V0 <= 0 && V1 >  0 && V2 >  0) ||
+    //      (V0 <  0 && V1 >= 0 && V2 >= 0) ) then V0 is singular;
+    //
+    // If our singular vertex is not on the positive side of the plane we reverse
+    // the triangle winding so that the overlap comparisons will compare the 
+    // correct edges with the correct signs.
+    //
+    XMVECTOR ADistIsLessEqual = XMVectorOrInt( ADistIsLess, ADistIsZero );
+    XMVECTOR ADistIsGreaterEqual = XMVectorOrInt( ADistIsGreater, ADistIsZero );
+
+    XMVECTOR AA0, AA1, AA2;
+    bool bPositiveA;
+
+    if( XMVector3AllTrue( XMVectorSelect( ADistIsGreaterEqual, ADistIsLess, Select0111 ) ) ||
+        XMVector3AllTrue( XMVectorSelect( ADistIsGreater, ADistIsLessEqual, Select0111 ) ) )
+    {
+        // A0 is singular, crossing from positive to negative.
+        AA0 = A0; AA1 = A1; AA2 = A2;
+        bPositiveA = true;
+    }
+    else if( XMVector3AllTrue( XMVectorSelect( ADistIsLessEqual, ADistIsGreater, Select0111 ) ) ||
+             XMVector3AllTrue( XMVectorSelect( ADistIsLess, ADistIsGreaterEqual, Select0111 ) ) )
+    {
+        // A0 is singular, crossing from negative to positive.
+        AA0 = A0; AA1 = A2; AA2 = A1;
+        bPositiveA = false;
+    }
+    else if( XMVector3AllTrue( XMVectorSelect( ADistIsGreaterEqual, ADistIsLess, Select1011 ) ) ||
+             XMVector3AllTrue( XMVectorSelect( ADistIsGreater, ADistIsLessEqual, Select1011 ) ) )
+    {
+        // A1 is singular, crossing from positive to negative.
+        AA0 = A1; AA1 = A2; AA2 = A0;
+        bPositiveA = true;
+    }
+    else if( XMVector3AllTrue( XMVectorSelect( ADistIsLessEqual, ADistIsGreater, Select1011 ) ) ||
+             XMVector3AllTrue( XMVectorSelect( ADistIsLess, ADistIsGreaterEqual, Select1011 ) ) )
+    {
+        // A1 is singular, crossing from negative to positive.
+        AA0 = A1; AA1 = A0; AA2 = A2;
+        bPositiveA = false;
+    }
+    else if( XMVector3AllTrue( XMVectorSelect( ADistIsGreaterEqual, ADistIsLess, Select1101 ) ) ||
+             XMVector3AllTrue( XMVectorSelect( ADistIsGreater, ADistIsLessEqual, Select1101 ) ) )
+    {
+        // A2 is singular, crossing from positive to negative.
+        AA0 = A2; AA1 = A0; AA2 = A1;
+        bPositiveA = true;
+    }
+    else if( XMVector3AllTrue( XMVectorSelect( ADistIsLessEqual, ADistIsGreater, Select1101 ) ) ||
+             XMVector3AllTrue( XMVectorSelect( ADistIsLess, ADistIsGreaterEqual, Select1101 ) ) )
+    {
+        // A2 is singular, crossing from negative to positive.
+        AA0 = A2; AA1 = A1; AA2 = A0;
+        bPositiveA = false;
+    }
+    else
+    {
+        XMASSERT( FALSE );
+        return FALSE;
+    }
+
+    XMVECTOR BDistIsLessEqual = XMVectorOrInt( BDistIsLess, BDistIsZero );
+    XMVECTOR BDistIsGreaterEqual = XMVectorOrInt( BDistIsGreater, BDistIsZero );
+
+    XMVECTOR BB0, BB1, BB2;
+    bool bPositiveB;
+
+    if( XMVector3AllTrue( XMVectorSelect( BDistIsGreaterEqual, BDistIsLess, Select0111 ) ) ||
+        XMVector3AllTrue( XMVectorSelect( BDistIsGreater, BDistIsLessEqual, Select0111 ) ) )
+    {
+        // B0 is singular, crossing from positive to negative.
+        BB0 = B0; BB1 = B1; BB2 = B2;
+        bPositiveB = true;
+    }
+    else if( XMVector3AllTrue( XMVectorSelect( BDistIsLessEqual, BDistIsGreater, Select0111 ) ) ||
+             XMVector3AllTrue( XMVectorSelect( BDistIsLess, BDistIsGreaterEqual, Select0111 ) ) )
+    {
+        // B0 is singular, crossing from negative to positive.
+        BB0 = B0; BB1 = B2; BB2 = B1;
+        bPositiveB = false;
+    }
+    else if( XMVector3AllTrue( XMVectorSelect( BDistIsGreaterEqual, BDistIsLess, Select1011 ) ) ||
+             XMVector3AllTrue( XMVectorSelect( BDistIsGreater, BDistIsLessEqual, Select1011 ) ) )
+    {
+        // B1 is singular, crossing from positive to negative.
+        BB0 = B1; BB1 = B2; BB2 = B0;
+        bPositiveB = true;
+    }
+    else if( XMVector3AllTrue( XMVectorSelect( BDistIsLessEqual, BDistIsGreater, Select1011 ) ) ||
+             XMVector3AllTrue( XMVectorSelect( BDistIsLess, BDistIsGreaterEqual, Select1011 ) ) )
+    {
+        // B1 is singular, crossing from negative to positive.
+        BB0 = B1; BB1 = B0; BB2 = B2;
+        bPositiveB = false;
+    }
+    else if( XMVector3AllTrue( XMVectorSelect( BDistIsGreaterEqual, BDistIsLess, Select1101 ) ) ||
+             XMVector3AllTrue( XMVectorSelect( BDistIsGreater, BDistIsLessEqual, Select1101 ) ) )
+    {
+        // B2 is singular, crossing from positive to negative.
+        BB0 = B2; BB1 = B0; BB2 = B1;
+        bPositiveB = true;
+    }
+    else if( XMVector3AllTrue( XMVectorSelect( BDistIsLessEqual, BDistIsGreater, Select1101 ) ) ||
+             XMVector3AllTrue( XMVectorSelect( BDistIsLess, BDistIsGreaterEqual, Select1101 ) ) )
+    {
+        // B2 is singular, crossing from negative to positive.
+        BB0 = B2; BB1 = B1; BB2 = B0;
+        bPositiveB = false;
+    }
+    else
+    {
+        XMASSERT( FALSE );
+        return FALSE;
+    }
+
+    XMVECTOR Delta0, Delta1;
+
+    // Reverse the direction of the test depending on whether the singular vertices are
+    // the same sign or different signs.
+    if( bPositiveA ^ bPositiveB )
+    {
+        Delta0 = ( BB0 - AA0 );
+        Delta1 = ( AA0 - BB0 );
+    }
+    else
+    {
+        Delta0 = ( AA0 - BB0 );
+        Delta1 = ( BB0 - AA0 );
+    }
+
+    // Check if the triangles overlap on the line of intersection between the
+    // planes of the two triangles by finding the signed line distances.
+    XMVECTOR Dist0 = XMVector3Dot( Delta0, XMVector3Cross( ( BB2 - BB0 ), ( AA2 - AA0 ) ) );
+    if( XMVector4Greater( Dist0, Zero ) )
+        return FALSE;
+
+    XMVECTOR Dist1 = XMVector3Dot( Delta1, XMVector3Cross( ( BB1 - BB0 ), ( AA1 - AA0 ) ) );
+    if( XMVector4Greater( Dist1, Zero ) )
+        return FALSE;
+
+    return TRUE;
+}
+
+
+
+//-----------------------------------------------------------------------------
+BOOL IntersectTriangleSphere( FXMVECTOR V0, FXMVECTOR V1, FXMVECTOR V2, const Sphere* pVolume )
+{
+    XMASSERT( pVolume );
+
+    // Load the sphere.    
+    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
+    XMVECTOR Radius = XMVectorReplicatePtr( &pVolume->Radius );
+
+    // Compute the plane of the triangle (has to be normalized).
+    XMVECTOR N = XMVector3Normalize( XMVector3Cross( V1 - V0, V2 - V0 ) );
+
+    // Assert that the triangle is not degenerate.
+    XMASSERT( !XMVector3Equal( N, XMVectorZero() ) );
+
+    // Find the nearest feature on the triangle to the sphere.
+    XMVECTOR Dist = XMVector3Dot( Center - V0, N );
+
+    // If the center of the sphere is farther from the plane of the triangle than
+    // the radius of the sphere, then there cannot be an intersection.
+    XMVECTOR NoIntersection = XMVectorLess( Dist, -Radius );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Dist, Radius ) );
+
+    // Project the center of the sphere onto the plane of the triangle.
+    XMVECTOR Point = Center - ( N * Dist );
+
+    // Is it inside all the edges? If so we intersect because the distance 
+    // to the plane is less than the radius.
+    XMVECTOR Intersection = PointOnPlaneInsideTriangle( Point, V0, V1, V2 );
+
+    // Find the nearest point on each edge.
+    XMVECTOR RadiusSq = Radius * Radius;
+
+    // Edge 0,1
+    Point = PointOnLineSegmentNearestPoint( V0, V1, Center );
+
+    // If the distance to the center of the sphere to the point is less than 
+    // the radius of the sphere then it must intersect.
+    Intersection = XMVectorOrInt( Intersection, XMVectorLessOrEqual( XMVector3LengthSq( Center - Point ), RadiusSq ) );
+
+    // Edge 1,2
+    Point = PointOnLineSegmentNearestPoint( V1, V2, Center );
+
+    // If the distance to the center of the sphere to the point is less than 
+    // the radius of the sphere then it must intersect.
+    Intersection = XMVectorOrInt( Intersection, XMVectorLessOrEqual( XMVector3LengthSq( Center - Point ), RadiusSq ) );
+
+    // Edge 2,0
+    Point = PointOnLineSegmentNearestPoint( V2, V0, Center );
+
+    // If the distance to the center of the sphere to the point is less than 
+    // the radius of the sphere then it must intersect.
+    Intersection = XMVectorOrInt( Intersection, XMVectorLessOrEqual( XMVector3LengthSq( Center - Point ), RadiusSq ) );
+
+    return XMVector4EqualInt( XMVectorAndCInt( Intersection, NoIntersection ), XMVectorTrueInt() );
+}
+
+
+
+//-----------------------------------------------------------------------------
+BOOL IntersectTriangleAxisAlignedBox( FXMVECTOR V0, FXMVECTOR V1, FXMVECTOR V2, const AxisAlignedBox* pVolume )
+{
+    XMASSERT( pVolume );
+
+    static CONST XMVECTORI32 Permute0W1Z0Y0X =
+                 {
+                    XM_PERMUTE_0W, XM_PERMUTE_1Z, XM_PERMUTE_0Y, XM_PERMUTE_0X
+                 };
+    static CONST XMVECTORI32 Permute0Z0W1X0Y =
+                 {
+                    XM_PERMUTE_0Z, XM_PERMUTE_0W, XM_PERMUTE_1X, XM_PERMUTE_0Y
+                 };
+    static CONST XMVECTORI32 Permute1Y0X0W0Z =
+                 {
+                    XM_PERMUTE_1Y, XM_PERMUTE_0X, XM_PERMUTE_0W, XM_PERMUTE_0Z
+                 };
+
+    XMVECTOR Zero = XMVectorZero();
+
+    // Load the box.
+    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
+    XMVECTOR Extents = XMLoadFloat3( &pVolume->Extents );
+
+    XMVECTOR BoxMin = Center - Extents;
+    XMVECTOR BoxMax = Center + Extents;
+
+    // Test the axes of the box (in effect test the AAB against the minimal AAB 
+    // around the triangle).
+    XMVECTOR TriMin = XMVectorMin( XMVectorMin( V0, V1 ), V2 );
+    XMVECTOR TriMax = XMVectorMax( XMVectorMax( V0, V1 ), V2 );
+
+    // for each i in (x, y, z) if a_min(i) > b_max(i) or b_min(i) > a_max(i) then disjoint
+    XMVECTOR Disjoint = XMVectorOrInt( XMVectorGreater( TriMin, BoxMax ), XMVectorGreater( BoxMin, TriMax ) );
+    if( XMVector3AnyTrue( Disjoint ) )
+        return FALSE;
+
+    // Test the plane of the triangle.
+    XMVECTOR Normal = XMVector3Cross( V1 - V0, V2 - V0 );
+    XMVECTOR Dist = XMVector3Dot( Normal, V0 );
+
+    // Assert that the triangle is not degenerate.
+    XMASSERT( !XMVector3Equal( Normal, Zero ) );
+
+    // for each i in (x, y, z) if n(i) >= 0 then v_min(i)=b_min(i), v_max(i)=b_max(i)
+    // else v_min(i)=b_max(i), v_max(i)=b_min(i)
+    XMVECTOR NormalSelect = XMVectorGreater( Normal, Zero );
+    XMVECTOR V_Min = XMVectorSelect( BoxMax, BoxMin, NormalSelect );
+    XMVECTOR V_Max = XMVectorSelect( BoxMin, BoxMax, NormalSelect );
+
+    // if n dot v_min + d > 0 || n dot v_max + d < 0 then disjoint
+    XMVECTOR MinDist = XMVector3Dot( V_Min, Normal );
+    XMVECTOR MaxDist = XMVector3Dot( V_Max, Normal );
+
+    XMVECTOR NoIntersection = XMVectorGreater( MinDist, Dist );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( MaxDist, Dist ) );
+
+    // Move the box center to zero to simplify the following tests.
+    XMVECTOR TV0 = V0 - Center;
+    XMVECTOR TV1 = V1 - Center;
+    XMVECTOR TV2 = V2 - Center;
+
+    // Test the edge/edge axes (3*3).
+    XMVECTOR e0 = TV1 - TV0;
+    XMVECTOR e1 = TV2 - TV1;
+    XMVECTOR e2 = TV0 - TV2;
+
+    // Make w zero.
+    e0 = XMVectorInsert( e0, Zero, 0, 0, 0, 0, 1 );
+    e1 = XMVectorInsert( e1, Zero, 0, 0, 0, 0, 1 );
+    e2 = XMVectorInsert( e2, Zero, 0, 0, 0, 0, 1 );
+
+    XMVECTOR Axis;
+    XMVECTOR p0, p1, p2;
+    XMVECTOR Min, Max;
+    XMVECTOR Radius;
+
+    // Axis == (1,0,0) x e0 = (0, -e0.z, e0.y)
+    Axis = XMVectorPermute( e0, -e0, Permute0W1Z0Y0X );
+    p0 = XMVector3Dot( TV0, Axis );
+    // p1 = XMVector3Dot( V1, Axis ); // p1 = p0;
+    p2 = XMVector3Dot( TV2, Axis );
+    Min = XMVectorMin( p0, p2 );
+    Max = XMVectorMax( p0, p2 );
+    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+
+    // Axis == (1,0,0) x e1 = (0, -e1.z, e1.y)
+    Axis = XMVectorPermute( e1, -e1, Permute0W1Z0Y0X );
+    p0 = XMVector3Dot( TV0, Axis );
+    p1 = XMVector3Dot( TV1, Axis );
+    // p2 = XMVector3Dot( V2, Axis ); // p2 = p1;
+    Min = XMVectorMin( p0, p1 );
+    Max = XMVectorMax( p0, p1 );
+    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+
+    // Axis == (1,0,0) x e2 = (0, -e2.z, e2.y)
+    Axis = XMVectorPermute( e2, -e2, Permute0W1Z0Y0X );
+    p0 = XMVector3Dot( TV0, Axis );
+    p1 = XMVector3Dot( TV1, Axis );
+    // p2 = XMVector3Dot( V2, Axis ); // p2 = p0;
+    Min = XMVectorMin( p0, p1 );
+    Max = XMVectorMax( p0, p1 );
+    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+
+    // Axis == (0,1,0) x e0 = (e0.z, 0, -e0.x)
+    Axis = XMVectorPermute( e0, -e0, Permute0Z0W1X0Y );
+    p0 = XMVector3Dot( TV0, Axis );
+    // p1 = XMVector3Dot( V1, Axis ); // p1 = p0;
+    p2 = XMVector3Dot( TV2, Axis );
+    Min = XMVectorMin( p0, p2 );
+    Max = XMVectorMax( p0, p2 );
+    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+
+    // Axis == (0,1,0) x e1 = (e1.z, 0, -e1.x)
+    Axis = XMVectorPermute( e1, -e1, Permute0Z0W1X0Y );
+    p0 = XMVector3Dot( TV0, Axis );
+    p1 = XMVector3Dot( TV1, Axis );
+    // p2 = XMVector3Dot( V2, Axis ); // p2 = p1;
+    Min = XMVectorMin( p0, p1 );
+    Max = XMVectorMax( p0, p1 );
+    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+
+    // Axis == (0,0,1) x e2 = (e2.z, 0, -e2.x)
+    Axis = XMVectorPermute( e2, -e2, Permute0Z0W1X0Y );
+    p0 = XMVector3Dot( TV0, Axis );
+    p1 = XMVector3Dot( TV1, Axis );
+    // p2 = XMVector3Dot( V2, Axis ); // p2 = p0;
+    Min = XMVectorMin( p0, p1 );
+    Max = XMVectorMax( p0, p1 );
+    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+
+    // Axis == (0,0,1) x e0 = (-e0.y, e0.x, 0)
+    Axis = XMVectorPermute( e0, -e0, Permute1Y0X0W0Z );
+    p0 = XMVector3Dot( TV0, Axis );
+    // p1 = XMVector3Dot( V1, Axis ); // p1 = p0;
+    p2 = XMVector3Dot( TV2, Axis );
+    Min = XMVectorMin( p0, p2 );
+    Max = XMVectorMax( p0, p2 );
+    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+
+    // Axis == (0,0,1) x e1 = (-e1.y, e1.x, 0)
+    Axis = XMVectorPermute( e1, -e1, Permute1Y0X0W0Z );
+    p0 = XMVector3Dot( TV0, Axis );
+    p1 = XMVector3Dot( TV1, Axis );
+    // p2 = XMVector3Dot( V2, Axis ); // p2 = p1;
+    Min = XMVectorMin( p0, p1 );
+    Max = XMVectorMax( p0, p1 );
+    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+
+    // Axis == (0,0,1) x e2 = (-e2.y, e2.x, 0)
+    Axis = XMVectorPermute( e2, -e2, Permute1Y0X0W0Z );
+    p0 = XMVector3Dot( TV0, Axis );
+    p1 = XMVector3Dot( TV1, Axis );
+    // p2 = XMVector3Dot( V2, Axis ); // p2 = p0;
+    Min = XMVectorMin( p0, p1 );
+    Max = XMVectorMax( p0, p1 );
+    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+
+    return XMVector4NotEqualInt( NoIntersection, XMVectorTrueInt() );
+}
+
+
+
+//-----------------------------------------------------------------------------
+BOOL IntersectTriangleOrientedBox( FXMVECTOR V0, FXMVECTOR V1, FXMVECTOR V2, const OrientedBox* pVolume )
+{
+    XMASSERT( pVolume );
+
+    // Load the box center & orientation.
+    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
+    XMVECTOR Orientation = XMLoadFloat4( &pVolume->Orientation );
+
+    XMASSERT( XMQuaternionIsUnit( Orientation ) );
+
+    // Transform the triangle vertices into the space of the box.
+    XMVECTOR TV0 = XMVector3InverseRotate( V0 - Center, Orientation );
+    XMVECTOR TV1 = XMVector3InverseRotate( V1 - Center, Orientation );
+    XMVECTOR TV2 = XMVector3InverseRotate( V2 - Center, Orientation );
+
+    AxisAlignedBox Box;
+    Box.Center = XMFLOAT3( 0.0f, 0.0f, 0.0f );
+    Box.Extents = pVolume->Extents;
+
+    // Use the triangle vs axis aligned box intersection routine.
+    return IntersectTriangleAxisAlignedBox( TV0, TV1, TV2, &Box );
+}
+
+
+
+//-----------------------------------------------------------------------------
+BOOL IntersectSphereSphere( const Sphere* pVolumeA, const Sphere* pVolumeB )
+{
+    XMASSERT( pVolumeA );
+    XMASSERT( pVolumeB );
+
+    // Load A.
+    XMVECTOR CenterA = XMLoadFloat3( &pVolumeA->Center );
+    XMVECTOR RadiusA = XMVectorReplicatePtr( &pVolumeA->Radius );
+
+    // Load B.
+    XMVECTOR CenterB = XMLoadFloat3( &pVolumeB->Center );
+    XMVECTOR RadiusB = XMVectorReplicatePtr( &pVolumeB->Radius );
+
+    // Distance squared between centers.    
+    XMVECTOR Delta = CenterB - CenterA;
+    XMVECTOR DistanceSquared = XMVector3LengthSq( Delta );
+
+    // Sum of the radii sqaured.
+    XMVECTOR RadiusSquared = RadiusA + RadiusB;
+    RadiusSquared = RadiusSquared * RadiusSquared;
+
+    return XMVector4LessOrEqual( DistanceSquared, RadiusSquared );
+}
+
+
+
+//-----------------------------------------------------------------------------
+BOOL IntersectSphereAxisAlignedBox( const Sphere* pVolumeA, const AxisAlignedBox* pVolumeB )
+{
+    XMASSERT( pVolumeA );
+    XMASSERT( pVolumeB );
+
+    XMVECTOR SphereCenter = XMLoadFloat3( &pVolumeA->Center );
+    XMVECTOR SphereRadius = XMVectorReplicatePtr( &pVolumeA->Radius );
+
+    XMVECTOR BoxCenter = XMLoadFloat3( &pVolumeB->Center );
+    XMVECTOR BoxExtents = XMLoadFloat3( &pVolumeB->Extents );
+
+    XMVECTOR BoxMin = BoxCenter - BoxExtents;
+    XMVECTOR BoxMax = BoxCenter + BoxExtents;
+
+    // Find the distance to the nearest point on the box.
+    // for each i in (x, y, z)
+    // if (SphereCenter(i) < BoxMin(i)) d2 += (SphereCenter(i) - BoxMin(i)) ^ 2
+    // else if (SphereCenter(i) > BoxMax(i)) d2 += (SphereCenter(i) - BoxMax(i)) ^ 2
+
+    XMVECTOR d = XMVectorZero();
+
+    // Compute d for each dimension.
+    XMVECTOR LessThanMin = XMVectorLess( SphereCenter, BoxMin );
+    XMVECTOR GreaterThanMax = XMVectorGreater( SphereCenter, BoxMax );
+
+    XMVECTOR MinDelta = SphereCenter - BoxMin;
+    XMVECTOR MaxDelta = SphereCenter - BoxMax;
+
+    // Choose value for each dimension based on the comparison.
+    d = XMVectorSelect( d, MinDelta, LessThanMin );
+    d = XMVectorSelect( d, MaxDelta, GreaterThanMax );
+
+    // Use a dot-product to square them and sum them together.
+    XMVECTOR d2 = XMVector3Dot( d, d );
+
+    return XMVector4LessOrEqual( d2, XMVectorMultiply( SphereRadius, SphereRadius ) );
+}
+
+
+
+//-----------------------------------------------------------------------------
+BOOL IntersectSphereOrientedBox( const Sphere* pVolumeA, const OrientedBox* pVolumeB )
+{
+    XMASSERT( pVolumeA );
+    XMASSERT( pVolumeB );
+
+    XMVECTOR SphereCenter = XMLoadFloat3( &pVolumeA->Center );
+    XMVECTOR SphereRadius = XMVectorReplicatePtr( &pVolumeA->Radius );
+
+    XMVECTOR BoxCenter = XMLoadFloat3( &pVolumeB->Center );
+    XMVECTOR BoxExtents = XMLoadFloat3( &pVolumeB->Extents );
+    XMVECTOR BoxOrientation = XMLoadFloat4( &pVolumeB->Orientation );
+
+    XMASSERT( XMQuaternionIsUnit( BoxOrientation ) );
+
+    // Transform the center of the sphere to be local to the box.
+    // BoxMin = -BoxExtents
+    // BoxMax = +BoxExtents
+    SphereCenter = XMVector3InverseRotate( SphereCenter - BoxCenter, BoxOrientation );
+
+    // Find the distance to the nearest point on the box.
+    // for each i in (x, y, z)
+    // if (SphereCenter(i) < BoxMin(i)) d2 += (SphereCenter(i) - BoxMin(i)) ^ 2
+    // else if (SphereCenter(i) > BoxMax(i)) d2 += (SphereCenter(i) - BoxMax(i)) ^ 2
+
+    XMVECTOR d = XMVectorZero();
+
+    // Compute d for each dimension.
+    XMVECTOR LessThanMin = XMVectorLess( SphereCenter, -BoxExtents );
+    XMVECTOR GreaterThanMax = XMVectorGreater( SphereCenter, BoxExtents );
+
+    XMVECTOR MinDelta = SphereCenter + BoxExtents;
+    XMVECTOR MaxDelta = SphereCenter - BoxExtents;
+
+    // Choose value for each dimension based on the comparison.
+    d = XMVectorSelect( d, MinDelta, LessThanMin );
+    d = XMVectorSelect( d, MaxDelta, GreaterThanMax );
+
+    // Use a dot-product to square them and sum them together.
+    XMVECTOR d2 = XMVector3Dot( d, d );
+
+    return XMVector4LessOrEqual( d2, XMVectorMultiply( SphereRadius, SphereRadius ) );
+}
+
+
+
+//-----------------------------------------------------------------------------
+BOOL IntersectAxisAlignedBoxAxisAlignedBox( const AxisAlignedBox* pVolumeA, const AxisAlignedBox* pVolumeB )
+{
+    XMASSERT( pVolumeA );
+    XMASSERT( pVolumeB );
+
+    XMVECTOR CenterA = XMLoadFloat3( &pVolumeA->Center );
+    XMVECTOR ExtentsA = XMLoadFloat3( &pVolumeA->Extents );
+
+    XMVECTOR CenterB = XMLoadFloat3( &pVolumeB->Center );
+    XMVECTOR ExtentsB = XMLoadFloat3( &pVolumeB->Extents );
+
+    XMVECTOR MinA = CenterA - ExtentsA;
+    XMVECTOR MaxA = CenterA + ExtentsA;
+
+    XMVECTOR MinB = CenterB - ExtentsB;
+    XMVECTOR MaxB = CenterB + ExtentsB;
+
+    // for each i in (x, y, z) if a_min(i) > b_max(i) or b_min(i) > a_max(i) then return FALSE
+    XMVECTOR Disjoint = XMVectorOrInt( XMVectorGreater( MinA, MaxB ), XMVectorGreater( MinB, MaxA ) );
+
+    return !XMVector3AnyTrue( Disjoint );
+}
+
+
+
+//-----------------------------------------------------------------------------
+BOOL IntersectAxisAlignedBoxOrientedBox( const AxisAlignedBox* pVolumeA, const OrientedBox* pVolumeB )
+{
+    XMASSERT( pVolumeA );
+    XMASSERT( pVolumeB );
+
+    // Make the axis aligned box oriented and do an OBB vs OBB test.
+    OrientedBox BoxA;
+
+    BoxA.Center = pVolumeA->Center;
+    BoxA.Extents = pVolumeA->Extents;
+    BoxA.Orientation.x = 0.0f;
+    BoxA.Orientation.y = 0.0f;
+    BoxA.Orientation.z = 0.0f;
+    BoxA.Orientation.w = 1.0f;
+
+    return IntersectOrientedBoxOrientedBox( &BoxA, pVolumeB );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Fast oriented box / oriented box intersection test using the separating axis 
+// theorem.
+//-----------------------------------------------------------------------------
+BOOL IntersectOrientedBoxOrientedBox( const OrientedBox* pVolumeA, const OrientedBox* pVolumeB )
+{
+    static CONST XMVECTORI32 Permute0W1Z0Y0X =
+                 {
+                    XM_PERMUTE_0W, XM_PERMUTE_1Z, XM_PERMUTE_0Y, XM_PERMUTE_0X
+                 };
+    static CONST XMVECTORI32 Permute0Z0W1X0Y =
+                 {
+                    XM_PERMUTE_0Z, XM_PERMUTE_0W, XM_PERMUTE_1X, XM_PERMUTE_0Y
+                 };
+    static CONST XMVECTORI32 Permute1Y0X0W0Z =
+                 {
+                    XM_PERMUTE_1Y, XM_PERMUTE_0X, XM_PERMUTE_0W, XM_PERMUTE_0Z
+                 };
+    static CONST XMVECTORI32 PermuteWZYX =
+                 {
+                    XM_PERMUTE_0W, XM_PERMUTE_0Z, XM_PERMUTE_0Y, XM_PERMUTE_0X
+                 };
+    static CONST XMVECTORI32 PermuteZWXY =
+                 {
+                    XM_PERMUTE_0Z, XM_PERMUTE_0W, XM_PERMUTE_0X, XM_PERMUTE_0Y
+                 };
+    static CONST XMVECTORI32 PermuteYXWZ =
+                 {
+                    XM_PERMUTE_0Y, XM_PERMUTE_0X, XM_PERMUTE_0W, XM_PERMUTE_0Z
+                 };
+
+    XMASSERT( pVolumeA );
+    XMASSERT( pVolumeB );
+
+    // Build the 3x3 rotation matrix that defines the orientation of B relative to A.
+    XMVECTOR A_quat = XMLoadFloat4( &pVolumeA->Orientation );
+    XMVECTOR B_quat = XMLoadFloat4( &pVolumeB->Orientation );
+
+    XMASSERT( XMQuaternionIsUnit( A_quat ) );
+    XMASSERT( XMQuaternionIsUnit( B_quat ) );
+
+    XMVECTOR Q = XMQuaternionMultiply( A_quat, XMQuaternionConjugate( B_quat ) );
+    XMMATRIX R = XMMatrixRotationQuaternion( Q );
+
+    // Compute the translation of B relative to A.
+    XMVECTOR A_cent = XMLoadFloat3( &pVolumeA->Center );
+    XMVECTOR B_cent = XMLoadFloat3( &pVolumeB->Center );
+    XMVECTOR t = XMVector3InverseRotate( B_cent - A_cent, A_quat );
+
+    //
+    // h(A) = extents of A.
+    // h(B) = extents of B.
+    //
+    // a(u) = axes of A = (1,0,0), (0,1,0), (0,0,1)
+    // b(u) = axes of B relative to A = (r00,r10,r20), (r01,r11,r21), (r02,r12,r22)
+    //  
+    // For each possible separating axis l:
+    //   d(A) = sum (for i = u,v,w) h(A)(i) * abs( a(i) dot l )
+    //   d(B) = sum (for i = u,v,w) h(B)(i) * abs( b(i) dot l )
+    //   if abs( t dot l ) > d(A) + d(B) then disjoint
+    //
+
+    // Load extents of A and B.
+    XMVECTOR h_A = XMLoadFloat3( &pVolumeA->Extents );
+    XMVECTOR h_B = XMLoadFloat3( &pVolumeB->Extents );
+
+    // Rows. Note R[0,1,2]X.w = 0.
+    XMVECTOR R0X = R.r[0];
+    XMVECTOR R1X = R.r[1];
+    XMVECTOR R2X = R.r[2];
+
+    R = XMMatrixTranspose( R );
+
+    // Columns. Note RX[0,1,2].w = 0.
+    XMVECTOR RX0 = R.r[0];
+    XMVECTOR RX1 = R.r[1];
+    XMVECTOR RX2 = R.r[2];
+
+    // Absolute value of rows.
+    XMVECTOR AR0X = XMVectorAbs( R0X );
+    XMVECTOR AR1X = XMVectorAbs( R1X );
+    XMVECTOR AR2X = XMVectorAbs( R2X );
+
+    // Absolute value of columns.
+    XMVECTOR ARX0 = XMVectorAbs( RX0 );
+    XMVECTOR ARX1 = XMVectorAbs( RX1 );
+    XMVECTOR ARX2 = XMVectorAbs( RX2 );
+
+    // Test each of the 15 possible seperating axii.
+    XMVECTOR d, d_A, d_B;
+
+    // l = a(u) = (1, 0, 0)
+    // t dot l = t.x
+    // d(A) = h(A).x
+    // d(B) = h(B) dot abs(r00, r01, r02)
+    d = XMVectorSplatX( t );
+    d_A = XMVectorSplatX( h_A );
+    d_B = XMVector3Dot( h_B, AR0X );
+    XMVECTOR NoIntersection = XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) );
+
+    // l = a(v) = (0, 1, 0)
+    // t dot l = t.y
+    // d(A) = h(A).y
+    // d(B) = h(B) dot abs(r10, r11, r12)
+    d = XMVectorSplatY( t );
+    d_A = XMVectorSplatY( h_A );
+    d_B = XMVector3Dot( h_B, AR1X );
+    NoIntersection = XMVectorOrInt( NoIntersection, 
+                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+
+    // l = a(w) = (0, 0, 1)
+    // t dot l = t.z
+    // d(A) = h(A).z
+    // d(B) = h(B) dot abs(r20, r21, r22)
+    d = XMVectorSplatZ( t );
+    d_A = XMVectorSplatZ( h_A );
+    d_B = XMVector3Dot( h_B, AR2X );
+    NoIntersection = XMVectorOrInt( NoIntersection, 
+                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+
+    // l = b(u) = (r00, r10, r20)
+    // d(A) = h(A) dot abs(r00, r10, r20)
+    // d(B) = h(B).x
+    d = XMVector3Dot( t, RX0 );
+    d_A = XMVector3Dot( h_A, ARX0 );
+    d_B = XMVectorSplatX( h_B );
+    NoIntersection = XMVectorOrInt( NoIntersection, 
+                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+
+    // l = b(v) = (r01, r11, r21)
+    // d(A) = h(A) dot abs(r01, r11, r21)
+    // d(B) = h(B).y
+    d = XMVector3Dot( t, RX1 );
+    d_A = XMVector3Dot( h_A, ARX1 );
+    d_B = XMVectorSplatY( h_B );
+    NoIntersection = XMVectorOrInt( NoIntersection, 
+                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+
+    // l = b(w) = (r02, r12, r22)
+    // d(A) = h(A) dot abs(r02, r12, r22)
+    // d(B) = h(B).z
+    d = XMVector3Dot( t, RX2 );
+    d_A = XMVector3Dot( h_A, ARX2 );
+    d_B = XMVectorSplatZ( h_B );
+    NoIntersection = XMVectorOrInt( NoIntersection, 
+                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+
+    // l = a(u) x b(u) = (0, -r20, r10)
+    // d(A) = h(A) dot abs(0, r20, r10)
+    // d(B) = h(B) dot abs(0, r02, r01)
+    d = XMVector3Dot( t, XMVectorPermute( RX0, -RX0, Permute0W1Z0Y0X ) );
+    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX0, ARX0, PermuteWZYX ) );
+    d_B = XMVector3Dot( h_B, XMVectorPermute( AR0X, AR0X, PermuteWZYX ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, 
+                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+
+    // l = a(u) x b(v) = (0, -r21, r11)
+    // d(A) = h(A) dot abs(0, r21, r11)
+    // d(B) = h(B) dot abs(r02, 0, r00)
+    d = XMVector3Dot( t, XMVectorPermute( RX1, -RX1, Permute0W1Z0Y0X ) );
+    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX1, ARX1, PermuteWZYX ) );
+    d_B = XMVector3Dot( h_B, XMVectorPermute( AR0X, AR0X, PermuteZWXY ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, 
+                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+
+    // l = a(u) x b(w) = (0, -r22, r12)
+    // d(A) = h(A) dot abs(0, r22, r12)
+    // d(B) = h(B) dot abs(r01, r00, 0)
+    d = XMVector3Dot( t, XMVectorPermute( RX2, -RX2, Permute0W1Z0Y0X ) );
+    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX2, ARX2, PermuteWZYX ) );
+    d_B = XMVector3Dot( h_B, XMVectorPermute( AR0X, AR0X, PermuteYXWZ ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, 
+                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+
+    // l = a(v) x b(u) = (r20, 0, -r00)
+    // d(A) = h(A) dot abs(r20, 0, r00)
+    // d(B) = h(B) dot abs(0, r12, r11)
+    d = XMVector3Dot( t, XMVectorPermute( RX0, -RX0, Permute0Z0W1X0Y ) );
+    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX0, ARX0, PermuteZWXY ) );
+    d_B = XMVector3Dot( h_B, XMVectorPermute( AR1X, AR1X, PermuteWZYX ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, 
+                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+
+    // l = a(v) x b(v) = (r21, 0, -r01)
+    // d(A) = h(A) dot abs(r21, 0, r01)
+    // d(B) = h(B) dot abs(r12, 0, r10)
+    d = XMVector3Dot( t, XMVectorPermute( RX1, -RX1, Permute0Z0W1X0Y ) );
+    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX1, ARX1, PermuteZWXY ) );
+    d_B = XMVector3Dot( h_B, XMVectorPermute( AR1X, AR1X, PermuteZWXY ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, 
+                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+
+    // l = a(v) x b(w) = (r22, 0, -r02)
+    // d(A) = h(A) dot abs(r22, 0, r02)
+    // d(B) = h(B) dot abs(r11, r10, 0)
+    d = XMVector3Dot( t, XMVectorPermute( RX2, -RX2, Permute0Z0W1X0Y ) );
+    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX2, ARX2, PermuteZWXY ) );
+    d_B = XMVector3Dot( h_B, XMVectorPermute( AR1X, AR1X, PermuteYXWZ ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, 
+                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+
+    // l = a(w) x b(u) = (-r10, r00, 0)
+    // d(A) = h(A) dot abs(r10, r00, 0)
+    // d(B) = h(B) dot abs(0, r22, r21)
+    d = XMVector3Dot( t, XMVectorPermute( RX0, -RX0, Permute1Y0X0W0Z ) );
+    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX0, ARX0, PermuteYXWZ ) );
+    d_B = XMVector3Dot( h_B, XMVectorPermute( AR2X, AR2X, PermuteWZYX ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, 
+                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+
+    // l = a(w) x b(v) = (-r11, r01, 0)
+    // d(A) = h(A) dot abs(r11, r01, 0)
+    // d(B) = h(B) dot abs(r22, 0, r20)
+    d = XMVector3Dot( t, XMVectorPermute( RX1, -RX1, Permute1Y0X0W0Z ) );
+    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX1, ARX1, PermuteYXWZ ) );
+    d_B = XMVector3Dot( h_B, XMVectorPermute( AR2X, AR2X, PermuteZWXY ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, 
+                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+
+    // l = a(w) x b(w) = (-r12, r02, 0)
+    // d(A) = h(A) dot abs(r12, r02, 0)
+    // d(B) = h(B) dot abs(r21, r20, 0)
+    d = XMVector3Dot( t, XMVectorPermute( RX2, -RX2, Permute1Y0X0W0Z ) );
+    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX2, ARX2, PermuteYXWZ ) );
+    d_B = XMVector3Dot( h_B, XMVectorPermute( AR2X, AR2X, PermuteYXWZ ) );
+    NoIntersection = XMVectorOrInt( NoIntersection, 
+                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
 
-    return XMVector4EqualInt( XMVectorAndCInt( Intersection, NoIntersection ), XMVectorTrueInt() );
+    // No seperating axis found, boxes must intersect.
+    return XMVector4NotEqualInt( NoIntersection, XMVectorTrueInt() );
 }
 
 
 
 //-----------------------------------------------------------------------------
-BOOL IntersectTriangleAxisAlignedBox( FXMVECTOR V0, FXMVECTOR V1, FXMVECTOR V2, const AxisAlignedBox* pVolume )
+// Return the point on the triangle (V0, V1, V2) nearest the point P, from the
+// Voronoi region of the triangle that P is in.
+//-----------------------------------------------------------------------------
+static inline XMVECTOR PointOnTriangleNearestPoint( FXMVECTOR P, FXMVECTOR V0, FXMVECTOR V1, CXMVECTOR V2 )
 {
-    XMASSERT( pVolume );
-
-    static CONST XMVECTORI32 Permute0W1Z0Y0X =
-                 {
-                    XM_PERMUTE_0W, XM_PERMUTE_1Z, XM_PERMUTE_0Y, XM_PERMUTE_0X
-                 };
-    static CONST XMVECTORI32 Permute0Z0W1X0Y =
-                 {
-                    XM_PERMUTE_0Z, XM_PERMUTE_0W, XM_PERMUTE_1X, XM_PERMUTE_0Y
-                 };
-    static CONST XMVECTORI32 Permute1Y0X0W0Z =
-                 {
-                    XM_PERMUTE_1Y, XM_PERMUTE_0X, XM_PERMUTE_0W, XM_PERMUTE_0Z
-                 };
-
-    XMVECTOR Zero = XMVectorZero();
-
-    // Load the box.
-    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
-    XMVECTOR Extents = XMLoadFloat3( &pVolume->Extents );
+    XMVECTOR E1 = V1 - V0;
+    XMVECTOR E2 = V2 - V0;
+
+    // Vertex region of V0.
+    XMVECTOR P0 = P - V0;
+    FLOAT d1 = XMVectorGetX( XMVector3Dot( E1, P0 ) );
+    FLOAT d2 = XMVectorGetX( XMVector3Dot( E2, P0 ) );
+    if( d1 <= 0.0f && d2 <= 0.0f )
+        return V0;
+
+    // Vertex region of V1.
+    XMVECTOR P1 = P - V1;
+    FLOAT d3 = XMVectorGetX( XMVector3Dot( E1, P1 ) );
+    FLOAT d4 = XMVectorGetX( XMVector3Dot( E2, P1 ) );
+    if( d3 >= 0.0f && d4 <= d3 )
+        return V1;
+
+    // Edge region of V0 V1.
+    FLOAT vc = d1 * d4 - d3 * d2;
+    if( vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f )
+        return V0 + E1 * ( d1 / ( d1 - d3 ) );
+
+    // Vertex region of V2.
+    XMVECTOR P2 = P - V2;
+    FLOAT d5 = XMVectorGetX( XMVector3Dot( E1, P2 ) );
+    FLOAT d6 = XMVectorGetX( XMVector3Dot( E2, P2 ) );
+    if( d6 >= 0.0f && d5 <= d6 )
+        return V2;
+
+    // Edge region of V0 V2.
+    FLOAT vb = d5 * d2 - d1 * d6;
+    if( vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f )
+        return V0 + E2 * ( d2 / ( d2 - d6 ) );
+
+    // Edge region of V1 V2.
+    FLOAT va = d3 * d6 - d5 * d4;
+    if( va <= 0.0f && ( d4 - d3 ) >= 0.0f && ( d5 - d6 ) >= 0.0f )
+        return V1 + ( V2 - V1 ) * ( ( d4 - d3 ) / ( ( d4 - d3 ) + ( d5 - d6 ) ) );
+
+    // Face region.
+    FLOAT Denom = 1.0f / ( va + vb + vc );
+    return V0 + E1 * ( vb * Denom ) + E2 * ( vc * Denom );
+}
 
-    XMVECTOR BoxMin = Center - Extents;
-    XMVECTOR BoxMax = Center + Extents;
 
-    // Test the axes of the box (in effect test the AAB against the minimal AAB 
-    // around the triangle).
-    XMVECTOR TriMin = XMVectorMin( XMVectorMin( V0, V1 ), V2 );
-    XMVECTOR TriMax = XMVectorMax( XMVectorMax( V0, V1 ), V2 );
 
-    // for each i in (x, y, z) if a_min(i) > b_max(i) or b_min(i) > a_max(i) then disjoint
-    XMVECTOR Disjoint = XMVectorOrInt( XMVectorGreater( TriMin, BoxMax ), XMVectorGreater( BoxMin, TriMax ) );
-    if( XMVector3AnyTrue( Disjoint ) )
+//-----------------------------------------------------------------------------
+// Return the first time in [0, MaxTime] a sphere that starts outside the
+// point P, the segment (S1, S2) or its infinite cylinder of the same radius
+// reaches it.  Each solves |Center + t * Velocity - X|^2 = Radius^2 for the
+// smaller root, X being the point or the nearest point on the line.
+//-----------------------------------------------------------------------------
+static inline BOOL SolveSweepQuadratic( FLOAT a, FLOAT b, FLOAT c, FLOAT MaxTime, FLOAT* pTime )
+{
+    // c > 0: separated at time 0, so both roots have the sign of -b.
+    if( a <= 0.0f || c <= 0.0f || b >= 0.0f )
         return FALSE;
 
-    // Test the plane of the triangle.
-    XMVECTOR Normal = XMVector3Cross( V1 - V0, V2 - V0 );
-    XMVECTOR Dist = XMVector3Dot( Normal, V0 );
-
-    // Assert that the triangle is not degenerate.
-    XMASSERT( !XMVector3Equal( Normal, Zero ) );
-
-    // for each i in (x, y, z) if n(i) >= 0 then v_min(i)=b_min(i), v_max(i)=b_max(i)
-    // else v_min(i)=b_max(i), v_max(i)=b_min(i)
-    XMVECTOR NormalSelect = XMVectorGreater( Normal, Zero );
-    XMVECTOR V_Min = XMVectorSelect( BoxMax, BoxMin, NormalSelect );
-    XMVECTOR V_Max = XMVectorSelect( BoxMin, BoxMax, NormalSelect );
+    FLOAT Discriminant = b * b - 4.0f * a * c;
+    if( Discriminant < 0.0f )
+        return FALSE;
 
-    // if n dot v_min + d > 0 || n dot v_max + d < 0 then disjoint
-    XMVECTOR MinDist = XMVector3Dot( V_Min, Normal );
-    XMVECTOR MaxDist = XMVector3Dot( V_Max, Normal );
+    FLOAT t = ( -b - sqrtf( Discriminant ) ) / ( 2.0f * a );
+    if( t > MaxTime )
+        return FALSE;
 
-    XMVECTOR NoIntersection = XMVectorGreater( MinDist, Dist );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( MaxDist, Dist ) );
+    *pTime = ( t > 0.0f ) ? t : 0.0f;
+    return TRUE;
+}
 
-    // Move the box center to zero to simplify the following tests.
-    XMVECTOR TV0 = V0 - Center;
-    XMVECTOR TV1 = V1 - Center;
-    XMVECTOR TV2 = V2 - Center;
+static inline BOOL SweepSpherePoint( FXMVECTOR Center, FXMVECTOR Velocity, FLOAT Radius, CXMVECTOR P,
+                                     FLOAT MaxTime, FLOAT* pTime )
+{
+    XMVECTOR M = Center - P;
 
-    // Test the edge/edge axes (3*3).
-    XMVECTOR e0 = TV1 - TV0;
-    XMVECTOR e1 = TV2 - TV1;
-    XMVECTOR e2 = TV0 - TV2;
+    FLOAT a = XMVectorGetX( XMVector3LengthSq( Velocity ) );
+    FLOAT b = 2.0f * XMVectorGetX( XMVector3Dot( M, Velocity ) );
+    FLOAT c = XMVectorGetX( XMVector3LengthSq( M ) ) - Radius * Radius;
 
-    // Make w zero.
-    e0 = XMVectorInsert( e0, Zero, 0, 0, 0, 0, 1 );
-    e1 = XMVectorInsert( e1, Zero, 0, 0, 0, 0, 1 );
-    e2 = XMVectorInsert( e2, Zero, 0, 0, 0, 0, 1 );
+    return SolveSweepQuadratic( a, b, c, MaxTime, pTime );
+}
 
-    XMVECTOR Axis;
-    XMVECTOR p0, p1, p2;
-    XMVECTOR Min, Max;
-    XMVECTOR Radius;
+static inline BOOL SweepSphereSegment( FXMVECTOR Center, FXMVECTOR Velocity, FLOAT Radius, CXMVECTOR S1,
+                                       CXMVECTOR S2, FLOAT MaxTime, FLOAT* pTime )
+{
+    XMVECTOR E = S2 - S1;
+    FLOAT EE = XMVectorGetX( XMVector3LengthSq( E ) );
+    if( EE <= 0.0f )
+        return FALSE;
 
-    // Axis == (1,0,0) x e0 = (0, -e0.z, e0.y)
-    Axis = XMVectorPermute( e0, -e0, Permute0W1Z0Y0X );
-    p0 = XMVector3Dot( TV0, Axis );
-    // p1 = XMVector3Dot( V1, Axis ); // p1 = p0;
-    p2 = XMVector3Dot( TV2, Axis );
-    Min = XMVectorMin( p0, p2 );
-    Max = XMVectorMax( p0, p2 );
-    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+    // The parts of the offset and the velocity across the line.
+    XMVECTOR M = Center - S1;
+    XMVECTOR MPerp = M - E * ( XMVectorGetX( XMVector3Dot( M, E ) ) / EE );
+    XMVECTOR VPerp = Velocity - E * ( XMVectorGetX( XMVector3Dot( Velocity, E ) ) / EE );
 
-    // Axis == (1,0,0) x e1 = (0, -e1.z, e1.y)
-    Axis = XMVectorPermute( e1, -e1, Permute0W1Z0Y0X );
-    p0 = XMVector3Dot( TV0, Axis );
-    p1 = XMVector3Dot( TV1, Axis );
-    // p2 = XMVector3Dot( V2, Axis ); // p2 = p1;
-    Min = XMVectorMin( p0, p1 );
-    Max = XMVectorMax( p0, p1 );
-    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+    FLOAT a = XMVectorGetX( XMVector3LengthSq( VPerp ) );
+    FLOAT b = 2.0f * XMVectorGetX( XMVector3Dot( MPerp, VPerp ) );
+    FLOAT c = XMVectorGetX( XMVector3LengthSq( MPerp ) ) - Radius * Radius;
 
-    // Axis == (1,0,0) x e2 = (0, -e2.z, e2.y)
-    Axis = XMVectorPermute( e2, -e2, Permute0W1Z0Y0X );
-    p0 = XMVector3Dot( TV0, Axis );
-    p1 = XMVector3Dot( TV1, Axis );
-    // p2 = XMVector3Dot( V2, Axis ); // p2 = p0;
-    Min = XMVectorMin( p0, p1 );
-    Max = XMVectorMax( p0, p1 );
-    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+    FLOAT t;
+    if( !SolveSweepQuadratic( a, b, c, MaxTime, &t ) )
+        return FALSE;
 
-    // Axis == (0,1,0) x e0 = (e0.z, 0, -e0.x)
-    Axis = XMVectorPermute( e0, -e0, Permute0Z0W1X0Y );
-    p0 = XMVector3Dot( TV0, Axis );
-    // p1 = XMVector3Dot( V1, Axis ); // p1 = p0;
-    p2 = XMVector3Dot( TV2, Axis );
-    Min = XMVectorMin( p0, p2 );
-    Max = XMVectorMax( p0, p2 );
-    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+    // The cylinder only counts between the ends of the segment.
+    FLOAT s = XMVectorGetX( XMVector3Dot( M + Velocity * t, E ) ) / EE;
+    if( s < 0.0f || s > 1.0f )
+        return FALSE;
 
-    // Axis == (0,1,0) x e1 = (e1.z, 0, -e1.x)
-    Axis = XMVectorPermute( e1, -e1, Permute0Z0W1X0Y );
-    p0 = XMVector3Dot( TV0, Axis );
-    p1 = XMVector3Dot( TV1, Axis );
-    // p2 = XMVector3Dot( V2, Axis ); // p2 = p1;
-    Min = XMVectorMin( p0, p1 );
-    Max = XMVectorMax( p0, p1 );
-    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+    *pTime = t;
+    return TRUE;
+}
 
-    // Axis == (0,0,1) x e2 = (e2.z, 0, -e2.x)
-    Axis = XMVectorPermute( e2, -e2, Permute0Z0W1X0Y );
-    p0 = XMVector3Dot( TV0, Axis );
-    p1 = XMVector3Dot( TV1, Axis );
-    // p2 = XMVector3Dot( V2, Axis ); // p2 = p0;
-    Min = XMVectorMin( p0, p1 );
-    Max = XMVectorMax( p0, p1 );
-    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+// The first time in [0, MaxTime] a sphere reaches a capsule around (S1, S2).
+static inline BOOL SweepSphereCapsule( FXMVECTOR Center, FXMVECTOR Velocity, FLOAT Radius, CXMVECTOR S1,
+                                       CXMVECTOR S2, FLOAT MaxTime, FLOAT* pTime )
+{
+    BOOL Hit = FALSE;
+    FLOAT t;
 
-    // Axis == (0,0,1) x e0 = (-e0.y, e0.x, 0)
-    Axis = XMVectorPermute( e0, -e0, Permute1Y0X0W0Z );
-    p0 = XMVector3Dot( TV0, Axis );
-    // p1 = XMVector3Dot( V1, Axis ); // p1 = p0;
-    p2 = XMVector3Dot( TV2, Axis );
-    Min = XMVectorMin( p0, p2 );
-    Max = XMVectorMax( p0, p2 );
-    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+    if( SweepSphereSegment( Center, Velocity, Radius, S1, S2, MaxTime, &t ) )
+    {
+        MaxTime = t;
+        Hit = TRUE;
+    }
 
-    // Axis == (0,0,1) x e1 = (-e1.y, e1.x, 0)
-    Axis = XMVectorPermute( e1, -e1, Permute1Y0X0W0Z );
-    p0 = XMVector3Dot( TV0, Axis );
-    p1 = XMVector3Dot( TV1, Axis );
-    // p2 = XMVector3Dot( V2, Axis ); // p2 = p1;
-    Min = XMVectorMin( p0, p1 );
-    Max = XMVectorMax( p0, p1 );
-    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+    if( SweepSpherePoint( Center, Velocity, Radius, S1, MaxTime, &t ) )
+    {
+        MaxTime = t;
+        Hit = TRUE;
+    }
 
-    // Axis == (0,0,1) x e2 = (-e2.y, e2.x, 0)
-    Axis = XMVectorPermute( e2, -e2, Permute1Y0X0W0Z );
-    p0 = XMVector3Dot( TV0, Axis );
-    p1 = XMVector3Dot( TV1, Axis );
-    // p2 = XMVector3Dot( V2, Axis ); // p2 = p0;
-    Min = XMVectorMin( p0, p1 );
-    Max = XMVectorMax( p0, p1 );
-    Radius = XMVector3Dot( Extents, XMVectorAbs( Axis ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( Min, Radius ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, XMVectorLess( Max, -Radius ) );
+    if( SweepSpherePoint( Center, Velocity, Radius, S2, MaxTime, &t ) )
+    {
+        MaxTime = t;
+        Hit = TRUE;
+    }
 
-    return XMVector4NotEqualInt( NoIntersection, XMVectorTrueInt() );
+    *pTime = MaxTime;
+    return Hit;
 }
 
 
 
 //-----------------------------------------------------------------------------
-BOOL IntersectTriangleOrientedBox( FXMVECTOR V0, FXMVECTOR V1, FXMVECTOR V2, const OrientedBox* pVolume )
+// Unit normal pointing from a point on a surface to the center of a sphere
+// touching it, or Fallback when the center is on the surface.
+//-----------------------------------------------------------------------------
+static inline XMVECTOR ContactNormal( FXMVECTOR Center, FXMVECTOR SurfacePoint, FXMVECTOR Fallback )
 {
-    XMASSERT( pVolume );
-
-    // Load the box center & orientation.
-    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
-    XMVECTOR Orientation = XMLoadFloat4( &pVolume->Orientation );
-
-    XMASSERT( XMQuaternionIsUnit( Orientation ) );
-
-    // Transform the triangle vertices into the space of the box.
-    XMVECTOR TV0 = XMVector3InverseRotate( V0 - Center, Orientation );
-    XMVECTOR TV1 = XMVector3InverseRotate( V1 - Center, Orientation );
-    XMVECTOR TV2 = XMVector3InverseRotate( V2 - Center, Orientation );
+    XMVECTOR Delta = Center - SurfacePoint;
+    FLOAT LengthSq = XMVectorGetX( XMVector3LengthSq( Delta ) );
 
-    AxisAlignedBox Box;
-    Box.Center = XMFLOAT3( 0.0f, 0.0f, 0.0f );
-    Box.Extents = pVolume->Extents;
+    if( LengthSq <= 1.0e-12f )
+        return Fallback;
 
-    // Use the triangle vs axis aligned box intersection routine.
-    return IntersectTriangleAxisAlignedBox( TV0, TV1, TV2, &Box );
+    return Delta * ( 1.0f / sqrtf( LengthSq ) );
 }
 
 
 
 //-----------------------------------------------------------------------------
-BOOL IntersectSphereSphere( const Sphere* pVolumeA, const Sphere* pVolumeB )
+// Sphere moving by Velocity against a triangle: the sphere first comes within
+// its radius of the plane inside the triangle, or else of an edge or a vertex,
+// which are tested as cylinders and spheres of its radius.
+//-----------------------------------------------------------------------------
+BOOL IntersectSweptSphereTriangle( const Sphere* pVolume, FXMVECTOR Velocity, FXMVECTOR V0, FXMVECTOR V1,
+                                   CXMVECTOR V2, FLOAT* pTime, XMVECTOR* pNormal )
 {
-    XMASSERT( pVolumeA );
-    XMASSERT( pVolumeB );
-
-    // Load A.
-    XMVECTOR CenterA = XMLoadFloat3( &pVolumeA->Center );
-    XMVECTOR RadiusA = XMVectorReplicatePtr( &pVolumeA->Radius );
-
-    // Load B.
-    XMVECTOR CenterB = XMLoadFloat3( &pVolumeB->Center );
-    XMVECTOR RadiusB = XMVectorReplicatePtr( &pVolumeB->Radius );
-
-    // Distance squared between centers.    
-    XMVECTOR Delta = CenterB - CenterA;
-    XMVECTOR DistanceSquared = XMVector3LengthSq( Delta );
-
-    // Sum of the radii sqaured.
-    XMVECTOR RadiusSquared = RadiusA + RadiusB;
-    RadiusSquared = RadiusSquared * RadiusSquared;
+    XMASSERT( pVolume );
+    XMASSERT( pTime );
+    XMASSERT( pNormal );
 
-    return XMVector4LessOrEqual( DistanceSquared, RadiusSquared );
-}
+    XMVECTOR Center = XMLoadFloat3( &pVolume->Center );
+    FLOAT Radius = pVolume->Radius;
 
+    // Compute the plane of the triangle (has to be normalized).
+    XMVECTOR N = XMVector3Normalize( XMVector3Cross( V1 - V0, V2 - V0 ) );
 
+    // Assert that the triangle is not degenerate.
+    XMASSERT( !XMVector3Equal( N, XMVectorZero() ) );
 
-//-----------------------------------------------------------------------------
-BOOL IntersectSphereAxisAlignedBox( const Sphere* pVolumeA, const AxisAlignedBox* pVolumeB )
-{
-    XMASSERT( pVolumeA );
-    XMASSERT( pVolumeB );
+    FLOAT Dist = XMVectorGetX( XMVector3Dot( Center - V0, N ) );
+    FLOAT Speed = XMVectorGetX( XMVector3Dot( Velocity, N ) );
 
-    XMVECTOR SphereCenter = XMLoadFloat3( &pVolumeA->Center );
-    XMVECTOR SphereRadius = XMVectorReplicatePtr( &pVolumeA->Radius );
+    // Both sides of the triangle count; use the side the sphere starts on.
+    if( Dist < 0.0f )
+    {
+        N = -N;
+        Dist = -Dist;
+        Speed = -Speed;
+    }
 
-    XMVECTOR BoxCenter = XMLoadFloat3( &pVolumeB->Center );
-    XMVECTOR BoxExtents = XMLoadFloat3( &pVolumeB->Extents );
+    // Already touching?
+    XMVECTOR Nearest = PointOnTriangleNearestPoint( Center, V0, V1, V2 );
+    if( XMVectorGetX( XMVector3LengthSq( Center - Nearest ) ) <= Radius * Radius )
+    {
+        *pTime = 0.0f;
+        *pNormal = ContactNormal( Center, Nearest, N );
+        return TRUE;
+    }
 
-    XMVECTOR BoxMin = BoxCenter - BoxExtents;
-    XMVECTOR BoxMax = BoxCenter + BoxExtents;
+    // The sphere never comes within its radius of the plane.
+    if( Dist > Radius && Dist - Radius > -Speed )
+        return FALSE;
 
-    // Find the distance to the nearest point on the box.
-    // for each i in (x, y, z)
-    // if (SphereCenter(i) < BoxMin(i)) d2 += (SphereCenter(i) - BoxMin(i)) ^ 2
-    // else if (SphereCenter(i) > BoxMax(i)) d2 += (SphereCenter(i) - BoxMax(i)) ^ 2
+    if( Dist > Radius )
+    {
+        // The point of the sphere nearest the plane, when it reaches the plane.
+        FLOAT t = ( Dist - Radius ) / -Speed;
+        XMVECTOR Point = Center + Velocity * t - N * Radius;
 
-    XMVECTOR d = XMVectorZero();
+        if( XMVector4EqualInt( PointOnPlaneInsideTriangle( Point, V0, V1, V2 ), XMVectorTrueInt() ) )
+        {
+            *pTime = t;
+            *pNormal = N;
+            return TRUE;
+        }
+    }
 
-    // Compute d for each dimension.
-    XMVECTOR LessThanMin = XMVectorLess( SphereCenter, BoxMin );
-    XMVECTOR GreaterThanMax = XMVectorGreater( SphereCenter, BoxMax );
+    // The sphere passes the plane outside the triangle, or already straddles
+    // it: the first contact is with an edge or a vertex.
+    FLOAT t = 1.0f;
+    BOOL Hit = FALSE;
 
-    XMVECTOR MinDelta = SphereCenter - BoxMin;
-    XMVECTOR MaxDelta = SphereCenter - BoxMax;
+    Hit |= SweepSphereCapsule( Center, Velocity, Radius, V0, V1, t, &t );
+    Hit |= SweepSphereCapsule( Center, Velocity, Radius, V1, V2, t, &t );
+    Hit |= SweepSphereCapsule( Center, Velocity, Radius, V2, V0, t, &t );
 
-    // Choose value for each dimension based on the comparison.
-    d = XMVectorSelect( d, MinDelta, LessThanMin );
-    d = XMVectorSelect( d, MaxDelta, GreaterThanMax );
+    if( !Hit )
+        return FALSE;
 
-    // Use a dot-product to square them and sum them together.
-    XMVECTOR d2 = XMVector3Dot( d, d );
+    XMVECTOR Contact = Center + Velocity * t;
 
-    return XMVector4LessOrEqual( d2, XMVectorMultiply( SphereRadius, SphereRadius ) );
+    *pTime = t;
+    *pNormal = ContactNormal( Contact, PointOnTriangleNearestPoint( Contact, V0, V1, V2 ), N );
+    return TRUE;
 }
 
 
 
 //-----------------------------------------------------------------------------
-BOOL IntersectSphereOrientedBox( const Sphere* pVolumeA, const OrientedBox* pVolumeB )
+// Sphere moving by Velocity against an axis aligned box, as a ray from the
+// center of the sphere against the box rounded by the radius.  The ray first
+// enters the box grown by the radius; if it enters where only one coordinate
+// is outside the box it has hit a face, and otherwise it is near an edge or a
+// corner, whose capsules decide (Ericson, "Real-Time Collision Detection",
+// 5.5.7).
+//-----------------------------------------------------------------------------
+BOOL IntersectSweptSphereAxisAlignedBox( const Sphere* pVolumeA, FXMVECTOR Velocity,
+                                         const AxisAlignedBox* pVolumeB, FLOAT* pTime, XMVECTOR* pNormal )
 {
     XMASSERT( pVolumeA );
     XMASSERT( pVolumeB );
+    XMASSERT( pTime );
+    XMASSERT( pNormal );
 
-    XMVECTOR SphereCenter = XMLoadFloat3( &pVolumeA->Center );
-    XMVECTOR SphereRadius = XMVectorReplicatePtr( &pVolumeA->Radius );
+    XMVECTOR Center = XMLoadFloat3( &pVolumeA->Center );
+    FLOAT Radius = pVolumeA->Radius;
 
     XMVECTOR BoxCenter = XMLoadFloat3( &pVolumeB->Center );
     XMVECTOR BoxExtents = XMLoadFloat3( &pVolumeB->Extents );
-    XMVECTOR BoxOrientation = XMLoadFloat4( &pVolumeB->Orientation );
 
-    XMASSERT( XMQuaternionIsUnit( BoxOrientation ) );
+    XMVECTOR BoxMin = BoxCenter - BoxExtents;
+    XMVECTOR BoxMax = BoxCenter + BoxExtents;
 
-    // Transform the center of the sphere to be local to the box.
-    // BoxMin = -BoxExtents
-    // BoxMax = +BoxExtents
-    SphereCenter = XMVector3InverseRotate( SphereCenter - BoxCenter, BoxOrientation );
+    // Already touching?
+    XMVECTOR Nearest = XMVectorClamp( Center, BoxMin, BoxMax );
+    if( XMVectorGetX( XMVector3LengthSq( Center - Nearest ) ) <= Radius * Radius )
+    {
+        // With the center inside, push out through the nearest face.
+        XMFLOAT3 Offset, Depth;
+        XMStoreFloat3( &Offset, Center - BoxCenter );
+        XMStoreFloat3( &Depth, BoxExtents - XMVectorAbs( Center - BoxCenter ) );
 
-    // Find the distance to the nearest point on the box.
-    // for each i in (x, y, z)
-    // if (SphereCenter(i) < BoxMin(i)) d2 += (SphereCenter(i) - BoxMin(i)) ^ 2
-    // else if (SphereCenter(i) > BoxMax(i)) d2 += (SphereCenter(i) - BoxMax(i)) ^ 2
+        UINT Axis = ( Depth.x < Depth.y ) ? ( ( Depth.x < Depth.z ) ? 0 : 2 ) : ( ( Depth.y < Depth.z ) ? 1 : 2 );
+        FLOAT Face[3] = { 0.0f, 0.0f, 0.0f };
+        Face[Axis] = ( ( &Offset.x )[Axis] < 0.0f ) ? -1.0f : 1.0f;
 
-    XMVECTOR d = XMVectorZero();
+        *pTime = 0.0f;
+        *pNormal = ContactNormal( Center, Nearest, XMVectorSet( Face[0], Face[1], Face[2], 0.0f ) );
+        return TRUE;
+    }
 
-    // Compute d for each dimension.
-    XMVECTOR LessThanMin = XMVectorLess( SphereCenter, -BoxExtents );
-    XMVECTOR GreaterThanMax = XMVectorGreater( SphereCenter, BoxExtents );
+    XMFLOAT3 C, V, Lo, Hi;
+    XMStoreFloat3( &C, Center );
+    XMStoreFloat3( &V, Velocity );
+    XMStoreFloat3( &Lo, BoxMin );
+    XMStoreFloat3( &Hi, BoxMax );
 
-    XMVECTOR MinDelta = SphereCenter + BoxExtents;
-    XMVECTOR MaxDelta = SphereCenter - BoxExtents;
+    // Slab test against the box grown by the radius, over times [0, 1].
+    FLOAT Enter = 0.0f;
+    FLOAT Exit = 1.0f;
+    UINT EnterAxis = 3;
 
-    // Choose value for each dimension based on the comparison.
-    d = XMVectorSelect( d, MinDelta, LessThanMin );
-    d = XMVectorSelect( d, MaxDelta, GreaterThanMax );
+    for( UINT i = 0; i < 3; i++ )
+    {
+        FLOAT c = ( &C.x )[i];
+        FLOAT v = ( &V.x )[i];
+        FLOAT lo = ( &Lo.x )[i] - Radius;
+        FLOAT hi = ( &Hi.x )[i] + Radius;
 
-    // Use a dot-product to square them and sum them together.
-    XMVECTOR d2 = XMVector3Dot( d, d );
+        if( v == 0.0f )
+        {
+            if( c < lo || c > hi )
+                return FALSE;
+            continue;
+        }
 
-    return XMVector4LessOrEqual( d2, XMVectorMultiply( SphereRadius, SphereRadius ) );
-}
+        FLOAT t0 = ( lo - c ) / v;
+        FLOAT t1 = ( hi - c ) / v;
+        if( t0 > t1 )
+        {
+            FLOAT Temp = t0;
+            t0 = t1;
+            t1 = Temp;
+        }
 
+        if( t0 > Enter )
+        {
+            Enter = t0;
+            EnterAxis = i;
+        }
+        Exit = ( t1 < Exit ) ? t1 : Exit;
 
+        if( Enter > Exit )
+            return FALSE;
+    }
 
-//-----------------------------------------------------------------------------
-BOOL IntersectAxisAlignedBoxAxisAlignedBox( const AxisAlignedBox* pVolumeA, const AxisAlignedBox* pVolumeB )
-{
-    XMASSERT( pVolumeA );
-    XMASSERT( pVolumeB );
+    // Where the ray enters, which coordinates are below or above the box.
+    UINT Below = 0;
+    UINT Above = 0;
 
-    XMVECTOR CenterA = XMLoadFloat3( &pVolumeA->Center );
-    XMVECTOR ExtentsA = XMLoadFloat3( &pVolumeA->Extents );
+    for( UINT i = 0; i < 3; i++ )
+    {
+        FLOAT p = ( &C.x )[i] + Enter * ( &V.x )[i];
 
-    XMVECTOR CenterB = XMLoadFloat3( &pVolumeB->Center );
-    XMVECTOR ExtentsB = XMLoadFloat3( &pVolumeB->Extents );
+        // The coordinate the ray entered through is on the grown face.
+        if( i == EnterAxis )
+        {
+            if( ( &V.x )[i] > 0.0f )
+                Below |= 1 << i;
+            else
+                Above |= 1 << i;
+        }
+        else if( p < ( &Lo.x )[i] )
+        {
+            Below |= 1 << i;
+        }
+        else if( p > ( &Hi.x )[i] )
+        {
+            Above |= 1 << i;
+        }
+    }
 
-    XMVECTOR MinA = CenterA - ExtentsA;
-    XMVECTOR MaxA = CenterA + ExtentsA;
+    UINT Outside = Below | Above;
 
-    XMVECTOR MinB = CenterB - ExtentsB;
-    XMVECTOR MaxB = CenterB + ExtentsB;
+    if( Outside == 1 || Outside == 2 || Outside == 4 )
+    {
+        UINT Axis = ( Outside == 1 ) ? 0 : ( Outside == 2 ) ? 1 : 2;
 
-    // for each i in (x, y, z) if a_min(i) > b_max(i) or b_min(i) > a_max(i) then return FALSE
-    XMVECTOR Disjoint = XMVectorOrInt( XMVectorGreater( MinA, MaxB ), XMVectorGreater( MinB, MaxA ) );
+        FLOAT Face[3] = { 0.0f, 0.0f, 0.0f };
+        Face[Axis] = ( Below & Outside ) ? -1.0f : 1.0f;
 
-    return !XMVector3AnyTrue( Disjoint );
-}
+        *pTime = Enter;
+        *pNormal = XMVectorSet( Face[0], Face[1], Face[2], 0.0f );
+        return TRUE;
+    }
 
+    // The corner of the box nearest the region, and the edges to test: the
+    // one along the coordinate that is inside, or all three at a corner.
+    FLOAT Corner[3], Far[3];
+    for( UINT i = 0; i < 3; i++ )
+    {
+        BOOL Low = ( Below & ( 1 << i ) ) || !( Outside & ( 1 << i ) );
+        Corner[i] = Low ? ( &Lo.x )[i] : ( &Hi.x )[i];
+        Far[i] = Low ? ( &Hi.x )[i] : ( &Lo.x )[i];
+    }
 
+    XMVECTOR CornerV = XMVectorSet( Corner[0], Corner[1], Corner[2], 0.0f );
 
-//-----------------------------------------------------------------------------
-BOOL IntersectAxisAlignedBoxOrientedBox( const AxisAlignedBox* pVolumeA, const OrientedBox* pVolumeB )
-{
-    XMASSERT( pVolumeA );
-    XMASSERT( pVolumeB );
+    FLOAT t = 1.0f;
+    BOOL Hit = FALSE;
 
-    // Make the axis aligned box oriented and do an OBB vs OBB test.
-    OrientedBox BoxA;
+    for( UINT i = 0; i < 3; i++ )
+    {
+        if( Outside != 7 && ( Outside & ( 1 << i ) ) )
+            continue;
 
-    BoxA.Center = pVolumeA->Center;
-    BoxA.Extents = pVolumeA->Extents;
-    BoxA.Orientation.x = 0.0f;
-    BoxA.Orientation.y = 0.0f;
-    BoxA.Orientation.z = 0.0f;
-    BoxA.Orientation.w = 1.0f;
+        FLOAT End[3] = { Corner[0], Corner[1], Corner[2] };
+        End[i] = Far[i];
 
-    return IntersectOrientedBoxOrientedBox( &BoxA, pVolumeB );
+        Hit |= SweepSphereCapsule( Center, Velocity, Radius, CornerV, XMVectorSet( End[0], End[1], End[2], 0.0f ),
+                                   t, &t );
+    }
+
+    if( !Hit )
+        return FALSE;
+
+    XMVECTOR Contact = Center + Velocity * t;
+
+    *pTime = t;
+    *pNormal = ContactNormal( Contact, XMVectorClamp( Contact, BoxMin, BoxMax ), -XMVector3Normalize( Velocity ) );
+    return TRUE;
 }
 
 
 
 //-----------------------------------------------------------------------------
-// Fast oriented box / oriented box intersection test using the separating axis 
-// theorem.
+// Two oriented boxes moving by VelocityA and VelocityB.  On every axis the
+// separating axis test uses, the projections of the boxes overlap over an
+// interval of time; the boxes intersect over the intersection of those
+// intervals, and first touch where it starts.  The axis whose interval starts
+// last gives the normal.
 //-----------------------------------------------------------------------------
-BOOL IntersectOrientedBoxOrientedBox( const OrientedBox* pVolumeA, const OrientedBox* pVolumeB )
+BOOL IntersectSweptOrientedBoxOrientedBox( const OrientedBox* pVolumeA, FXMVECTOR VelocityA,
+                                           const OrientedBox* pVolumeB, FXMVECTOR VelocityB, FLOAT* pTime,
+                                           XMVECTOR* pNormal )
 {
-    static CONST XMVECTORI32 Permute0W1Z0Y0X =
-                 {
-                    XM_PERMUTE_0W, XM_PERMUTE_1Z, XM_PERMUTE_0Y, XM_PERMUTE_0X
-                 };
-    static CONST XMVECTORI32 Permute0Z0W1X0Y =
-                 {
-                    XM_PERMUTE_0Z, XM_PERMUTE_0W, XM_PERMUTE_1X, XM_PERMUTE_0Y
-                 };
-    static CONST XMVECTORI32 Permute1Y0X0W0Z =
-                 {
-                    XM_PERMUTE_1Y, XM_PERMUTE_0X, XM_PERMUTE_0W, XM_PERMUTE_0Z
-                 };
-    static CONST XMVECTORI32 PermuteWZYX =
-                 {
-                    XM_PERMUTE_0W, XM_PERMUTE_0Z, XM_PERMUTE_0Y, XM_PERMUTE_0X
-                 };
-    static CONST XMVECTORI32 PermuteZWXY =
-                 {
-                    XM_PERMUTE_0Z, XM_PERMUTE_0W, XM_PERMUTE_0X, XM_PERMUTE_0Y
-                 };
-    static CONST XMVECTORI32 PermuteYXWZ =
-                 {
-                    XM_PERMUTE_0Y, XM_PERMUTE_0X, XM_PERMUTE_0W, XM_PERMUTE_0Z
-                 };
-
     XMASSERT( pVolumeA );
     XMASSERT( pVolumeB );
+    XMASSERT( pTime );
+    XMASSERT( pNormal );
 
-    // Build the 3x3 rotation matrix that defines the orientation of B relative to A.
     XMVECTOR A_quat = XMLoadFloat4( &pVolumeA->Orientation );
     XMVECTOR B_quat = XMLoadFloat4( &pVolumeB->Orientation );
 
     XMASSERT( XMQuaternionIsUnit( A_quat ) );
     XMASSERT( XMQuaternionIsUnit( B_quat ) );
 
-    XMVECTOR Q = XMQuaternionMultiply( A_quat, XMQuaternionConjugate( B_quat ) );
-    XMMATRIX R = XMMatrixRotationQuaternion( Q );
-
-    // Compute the translation of B relative to A.
-    XMVECTOR A_cent = XMLoadFloat3( &pVolumeA->Center );
-    XMVECTOR B_cent = XMLoadFloat3( &pVolumeB->Center );
-    XMVECTOR t = XMVector3InverseRotate( B_cent - A_cent, A_quat );
+    // The rows are the axes of the boxes in world space.
+    XMMATRIX RA = XMMatrixRotationQuaternion( A_quat );
+    XMMATRIX RB = XMMatrixRotationQuaternion( B_quat );
 
-    //
-    // h(A) = extents of A.
-    // h(B) = extents of B.
-    //
-    // a(u) = axes of A = (1,0,0), (0,1,0), (0,0,1)
-    // b(u) = axes of B relative to A = (r00,r10,r20), (r01,r11,r21), (r02,r12,r22)
-    //  
-    // For each possible separating axis l:
-    //   d(A) = sum (for i = u,v,w) h(A)(i) * abs( a(i) dot l )
-    //   d(B) = sum (for i = u,v,w) h(B)(i) * abs( b(i) dot l )
-    //   if abs( t dot l ) > d(A) + d(B) then disjoint
-    //
+    // These take an axis to its coordinates along the axes of each box.
+    XMMATRIX InverseRA = XMMatrixTranspose( RA );
+    XMMATRIX InverseRB = XMMatrixTranspose( RB );
 
-    // Load extents of A and B.
     XMVECTOR h_A = XMLoadFloat3( &pVolumeA->Extents );
     XMVECTOR h_B = XMLoadFloat3( &pVolumeB->Extents );
 
-    // Rows. Note R[0,1,2]X.w = 0.
-    XMVECTOR R0X = R.r[0];
-    XMVECTOR R1X = R.r[1];
-    XMVECTOR R2X = R.r[2];
-
-    R = XMMatrixTranspose( R );
-
-    // Columns. Note RX[0,1,2].w = 0.
-    XMVECTOR RX0 = R.r[0];
-    XMVECTOR RX1 = R.r[1];
-    XMVECTOR RX2 = R.r[2];
-
-    // Absolute value of rows.
-    XMVECTOR AR0X = XMVectorAbs( R0X );
-    XMVECTOR AR1X = XMVectorAbs( R1X );
-    XMVECTOR AR2X = XMVectorAbs( R2X );
-
-    // Absolute value of columns.
-    XMVECTOR ARX0 = XMVectorAbs( RX0 );
-    XMVECTOR ARX1 = XMVectorAbs( RX1 );
-    XMVECTOR ARX2 = XMVectorAbs( RX2 );
-
-    // Test each of the 15 possible seperating axii.
-    XMVECTOR d, d_A, d_B;
-
-    // l = a(u) = (1, 0, 0)
-    // t dot l = t.x
-    // d(A) = h(A).x
-    // d(B) = h(B) dot abs(r00, r01, r02)
-    d = XMVectorSplatX( t );
-    d_A = XMVectorSplatX( h_A );
-    d_B = XMVector3Dot( h_B, AR0X );
-    XMVECTOR NoIntersection = XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) );
-
-    // l = a(v) = (0, 1, 0)
-    // t dot l = t.y
-    // d(A) = h(A).y
-    // d(B) = h(B) dot abs(r10, r11, r12)
-    d = XMVectorSplatY( t );
-    d_A = XMVectorSplatY( h_A );
-    d_B = XMVector3Dot( h_B, AR1X );
-    NoIntersection = XMVectorOrInt( NoIntersection, 
-                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
-
-    // l = a(w) = (0, 0, 1)
-    // t dot l = t.z
-    // d(A) = h(A).z
-    // d(B) = h(B) dot abs(r20, r21, r22)
-    d = XMVectorSplatZ( t );
-    d_A = XMVectorSplatZ( h_A );
-    d_B = XMVector3Dot( h_B, AR2X );
-    NoIntersection = XMVectorOrInt( NoIntersection, 
-                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
-
-    // l = b(u) = (r00, r10, r20)
-    // d(A) = h(A) dot abs(r00, r10, r20)
-    // d(B) = h(B).x
-    d = XMVector3Dot( t, RX0 );
-    d_A = XMVector3Dot( h_A, ARX0 );
-    d_B = XMVectorSplatX( h_B );
-    NoIntersection = XMVectorOrInt( NoIntersection, 
-                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+    // Offset of B from A, and the velocity of A relative to B.
+    XMVECTOR Offset = XMLoadFloat3( &pVolumeB->Center ) - XMLoadFloat3( &pVolumeA->Center );
+    XMVECTOR Velocity = VelocityA - VelocityB;
 
-    // l = b(v) = (r01, r11, r21)
-    // d(A) = h(A) dot abs(r01, r11, r21)
-    // d(B) = h(B).y
-    d = XMVector3Dot( t, RX1 );
-    d_A = XMVector3Dot( h_A, ARX1 );
-    d_B = XMVectorSplatY( h_B );
-    NoIntersection = XMVectorOrInt( NoIntersection, 
-                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+    XMVECTOR Axes[15];
+    UINT AxisCount = 0;
 
-    // l = b(w) = (r02, r12, r22)
-    // d(A) = h(A) dot abs(r02, r12, r22)
-    // d(B) = h(B).z
-    d = XMVector3Dot( t, RX2 );
-    d_A = XMVector3Dot( h_A, ARX2 );
-    d_B = XMVectorSplatZ( h_B );
-    NoIntersection = XMVectorOrInt( NoIntersection, 
-                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+    for( UINT i = 0; i < 3; i++ )
+        Axes[AxisCount++] = RA.r[i];
 
-    // l = a(u) x b(u) = (0, -r20, r10)
-    // d(A) = h(A) dot abs(0, r20, r10)
-    // d(B) = h(B) dot abs(0, r02, r01)
-    d = XMVector3Dot( t, XMVectorPermute( RX0, -RX0, Permute0W1Z0Y0X ) );
-    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX0, ARX0, PermuteWZYX ) );
-    d_B = XMVector3Dot( h_B, XMVectorPermute( AR0X, AR0X, PermuteWZYX ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, 
-                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+    for( UINT i = 0; i < 3; i++ )
+        Axes[AxisCount++] = RB.r[i];
 
-    // l = a(u) x b(v) = (0, -r21, r11)
-    // d(A) = h(A) dot abs(0, r21, r11)
-    // d(B) = h(B) dot abs(r02, 0, r00)
-    d = XMVector3Dot( t, XMVectorPermute( RX1, -RX1, Permute0W1Z0Y0X ) );
-    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX1, ARX1, PermuteWZYX ) );
-    d_B = XMVector3Dot( h_B, XMVectorPermute( AR0X, AR0X, PermuteZWXY ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, 
-                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+    // Edge cross products, leaving out pairs of nearly parallel edges, whose
+    // axes the face axes already cover.
+    for( UINT i = 0; i < 3; i++ )
+    {
+        for( UINT j = 0; j < 3; j++ )
+        {
+            XMVECTOR L = XMVector3Cross( RA.r[i], RB.r[j] );
+            FLOAT LengthSq = XMVectorGetX( XMVector3LengthSq( L ) );
 
-    // l = a(u) x b(w) = (0, -r22, r12)
-    // d(A) = h(A) dot abs(0, r22, r12)
-    // d(B) = h(B) dot abs(r01, r00, 0)
-    d = XMVector3Dot( t, XMVectorPermute( RX2, -RX2, Permute0W1Z0Y0X ) );
-    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX2, ARX2, PermuteWZYX ) );
-    d_B = XMVector3Dot( h_B, XMVectorPermute( AR0X, AR0X, PermuteYXWZ ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, 
-                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+            if( LengthSq > 1.0e-6f )
+                Axes[AxisCount++] = L * ( 1.0f / sqrtf( LengthSq ) );
+        }
+    }
 
-    // l = a(v) x b(u) = (r20, 0, -r00)
-    // d(A) = h(A) dot abs(r20, 0, r00)
-    // d(B) = h(B) dot abs(0, r12, r11)
-    d = XMVector3Dot( t, XMVectorPermute( RX0, -RX0, Permute0Z0W1X0Y ) );
-    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX0, ARX0, PermuteZWXY ) );
-    d_B = XMVector3Dot( h_B, XMVectorPermute( AR1X, AR1X, PermuteWZYX ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, 
-                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+    FLOAT Enter = -FLT_MAX;
+    FLOAT Exit = FLT_MAX;
+    XMVECTOR EnterNormal = XMVectorZero();
 
-    // l = a(v) x b(v) = (r21, 0, -r01)
-    // d(A) = h(A) dot abs(r21, 0, r01)
-    // d(B) = h(B) dot abs(r12, 0, r10)
-    d = XMVector3Dot( t, XMVectorPermute( RX1, -RX1, Permute0Z0W1X0Y ) );
-    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX1, ARX1, PermuteZWXY ) );
-    d_B = XMVector3Dot( h_B, XMVectorPermute( AR1X, AR1X, PermuteZWXY ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, 
-                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+    // Least penetration at time 0, for boxes that already intersect.
+    FLOAT LeastDepth = FLT_MAX;
+    XMVECTOR DepthNormal = XMVectorZero();
 
-    // l = a(v) x b(w) = (r22, 0, -r02)
-    // d(A) = h(A) dot abs(r22, 0, r02)
-    // d(B) = h(B) dot abs(r11, r10, 0)
-    d = XMVector3Dot( t, XMVectorPermute( RX2, -RX2, Permute0Z0W1X0Y ) );
-    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX2, ARX2, PermuteZWXY ) );
-    d_B = XMVector3Dot( h_B, XMVectorPermute( AR1X, AR1X, PermuteYXWZ ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, 
-                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+    for( UINT k = 0; k < AxisCount; k++ )
+    {
+        XMVECTOR L = Axes[k];
+
+        // The projections overlap while |D - t * W| <= Reach.
+        FLOAT Reach = XMVectorGetX( XMVector3Dot( h_A, XMVectorAbs( XMVector3TransformNormal( L, InverseRA ) ) ) ) +
+                      XMVectorGetX( XMVector3Dot( h_B, XMVectorAbs( XMVector3TransformNormal( L, InverseRB ) ) ) );
+        FLOAT D = XMVectorGetX( XMVector3Dot( Offset, L ) );
+        FLOAT W = XMVectorGetX( XMVector3Dot( Velocity, L ) );
+
+        // B is on the positive side of A along L when D > 0, and the normal
+        // from B to A is then -L.
+        FLOAT Depth = Reach - fabsf( D );
+        if( Depth < LeastDepth )
+        {
+            LeastDepth = Depth;
+            DepthNormal = ( D > 0.0f ) ? -L : L;
+        }
 
-    // l = a(w) x b(u) = (-r10, r00, 0)
-    // d(A) = h(A) dot abs(r10, r00, 0)
-    // d(B) = h(B) dot abs(0, r22, r21)
-    d = XMVector3Dot( t, XMVectorPermute( RX0, -RX0, Permute1Y0X0W0Z ) );
-    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX0, ARX0, PermuteYXWZ ) );
-    d_B = XMVector3Dot( h_B, XMVectorPermute( AR2X, AR2X, PermuteWZYX ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, 
-                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+        if( fabsf( W ) < 1.0e-12f )
+        {
+            // Not moving along this axis: apart for good, or no limit.
+            if( Depth < 0.0f )
+                return FALSE;
+            continue;
+        }
 
-    // l = a(w) x b(v) = (-r11, r01, 0)
-    // d(A) = h(A) dot abs(r11, r01, 0)
-    // d(B) = h(B) dot abs(r22, 0, r20)
-    d = XMVector3Dot( t, XMVectorPermute( RX1, -RX1, Permute1Y0X0W0Z ) );
-    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX1, ARX1, PermuteYXWZ ) );
-    d_B = XMVector3Dot( h_B, XMVectorPermute( AR2X, AR2X, PermuteZWXY ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, 
-                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+        FLOAT t0 = ( D - Reach ) / W;
+        FLOAT t1 = ( D + Reach ) / W;
+        if( t0 > t1 )
+        {
+            FLOAT Temp = t0;
+            t0 = t1;
+            t1 = Temp;
+        }
 
-    // l = a(w) x b(w) = (-r12, r02, 0)
-    // d(A) = h(A) dot abs(r12, r02, 0)
-    // d(B) = h(B) dot abs(r21, r20, 0)
-    d = XMVector3Dot( t, XMVectorPermute( RX2, -RX2, Permute1Y0X0W0Z ) );
-    d_A = XMVector3Dot( h_A, XMVectorPermute( ARX2, ARX2, PermuteYXWZ ) );
-    d_B = XMVector3Dot( h_B, XMVectorPermute( AR2X, AR2X, PermuteYXWZ ) );
-    NoIntersection = XMVectorOrInt( NoIntersection, 
-                                    XMVectorGreater( XMVectorAbs(d), XMVectorAdd( d_A, d_B ) ) );
+        if( t0 > Enter )
+        {
+            Enter = t0;
+            EnterNormal = ( D - t0 * W > 0.0f ) ? -L : L;
+        }
+        Exit = ( t1 < Exit ) ? t1 : Exit;
 
-    // No seperating axis found, boxes must intersect.
-    return XMVector4NotEqualInt( NoIntersection, XMVectorTrueInt() );
+        if( Enter > Exit || Enter > 1.0f || Exit < 0.0f )
+            return FALSE;
+    }
+
+    if( Enter <= 0.0f )
+    {
+        *pTime = 0.0f;
+        *pNormal = DepthNormal;
+        return TRUE;
+    }
+
+    *pTime = Enter;
+    *pNormal = EnterNormal;
+    return TRUE;
 }
 
 
@@ -3646,6 +5308,408 @@ INT IntersectFrustum6Planes( const Frustum* pVolume, FXMVECTOR Plane0, FXMVECTOR
 
 
 
+//-----------------------------------------------------------------------------
+// The six planes of a frustum with each component splatted across a vector,
+// for testing four volumes at a time.
+//-----------------------------------------------------------------------------
+struct CullPlanes
+{
+    XMVECTOR Nx[6], Ny[6], Nz[6], D[6];
+    XMVECTOR AbsNx[6], AbsNy[6], AbsNz[6];
+};
+
+static inline VOID ComputeCullPlanes( CullPlanes* pOut, const Frustum* pFrustum )
+{
+    XMVECTOR Planes[6];
+    ComputePlanesFromFrustum( pFrustum, &Planes[0], &Planes[1], &Planes[2], &Planes[3], &Planes[4], &Planes[5] );
+
+    for( UINT i = 0; i < 6; i++ )
+    {
+        pOut->Nx[i] = XMVectorSplatX( Planes[i] );
+        pOut->Ny[i] = XMVectorSplatY( Planes[i] );
+        pOut->Nz[i] = XMVectorSplatZ( Planes[i] );
+        pOut->D[i] = XMVectorSplatW( Planes[i] );
+
+        pOut->AbsNx[i] = XMVectorAbs( pOut->Nx[i] );
+        pOut->AbsNy[i] = XMVectorAbs( pOut->Ny[i] );
+        pOut->AbsNz[i] = XMVectorAbs( pOut->Nz[i] );
+    }
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Test four boxes against the planes.  The centers and extents are transposed
+// so that each vector holds one component of all four, and each plane is then
+// tested as in FastIntersectAxisAlignedBoxPlane.  Return a bit for each box
+// that is outside a plane.
+//-----------------------------------------------------------------------------
+static inline UINT CullVolumes4( const CullPlanes* pPlanes, const AxisAlignedBox* pVolumes )
+{
+    XMMATRIX Center( XMLoadFloat3( &pVolumes[0].Center ), XMLoadFloat3( &pVolumes[1].Center ),
+                     XMLoadFloat3( &pVolumes[2].Center ), XMLoadFloat3( &pVolumes[3].Center ) );
+    XMMATRIX Extents( XMLoadFloat3( &pVolumes[0].Extents ), XMLoadFloat3( &pVolumes[1].Extents ),
+                      XMLoadFloat3( &pVolumes[2].Extents ), XMLoadFloat3( &pVolumes[3].Extents ) );
+
+    Center = XMMatrixTranspose( Center );
+    Extents = XMMatrixTranspose( Extents );
+
+    XMVECTOR AnyOutside = XMVectorFalseInt();
+
+    for( UINT i = 0; i < 6; i++ )
+    {
+        XMVECTOR Dist = Center.r[0] * pPlanes->Nx[i] + Center.r[1] * pPlanes->Ny[i] +
+                        Center.r[2] * pPlanes->Nz[i] + pPlanes->D[i];
+        XMVECTOR Radius = Extents.r[0] * pPlanes->AbsNx[i] + Extents.r[1] * pPlanes->AbsNy[i] +
+                          Extents.r[2] * pPlanes->AbsNz[i];
+
+        AnyOutside = XMVectorOrInt( AnyOutside, XMVectorGreater( Dist, Radius ) );
+
+        // Most volumes of a large scene are behind the camera or off to the side,
+        // so all four are often out after the first few planes.
+        if( XMVector4EqualInt( AnyOutside, XMVectorTrueInt() ) )
+            break;
+    }
+
+    return LaneMaskToBits( AnyOutside );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Test four spheres against the planes, as in FastIntersectSpherePlane.
+// Return a bit for each sphere that is outside a plane.
+//-----------------------------------------------------------------------------
+static inline UINT CullVolumes4( const CullPlanes* pPlanes, const Sphere* pVolumes )
+{
+    // A sphere is a center followed by a radius, so it loads as one vector.
+    XMMATRIX Spheres( XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( &pVolumes[0] ) ),
+                      XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( &pVolumes[1] ) ),
+                      XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( &pVolumes[2] ) ),
+                      XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( &pVolumes[3] ) ) );
+
+    Spheres = XMMatrixTranspose( Spheres );
+
+    XMVECTOR AnyOutside = XMVectorFalseInt();
+
+    for( UINT i = 0; i < 6; i++ )
+    {
+        XMVECTOR Dist = Spheres.r[0] * pPlanes->Nx[i] + Spheres.r[1] * pPlanes->Ny[i] +
+                        Spheres.r[2] * pPlanes->Nz[i] + pPlanes->D[i];
+
+        AnyOutside = XMVectorOrInt( AnyOutside, XMVectorGreater( Dist, Spheres.r[3] ) );
+
+        if( XMVector4EqualInt( AnyOutside, XMVectorTrueInt() ) )
+            break;
+    }
+
+    return LaneMaskToBits( AnyOutside );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Cull the volumes [First, Last) and write the indices of the visible ones to
+// pVisibleIndices.  Return how many were written, at most Last - First.
+//-----------------------------------------------------------------------------
+template<typename VolumeType>
+static UINT CullRange( const CullPlanes* pPlanes, const VolumeType* pVolumes, UINT First, UINT Last,
+                       UINT* pVisibleIndices )
+{
+    UINT VisibleCount = 0;
+    UINT i = First;
+
+    for( ; i + 4 <= Last; i += 4 )
+    {
+        UINT Outside = CullVolumes4( pPlanes, pVolumes + i );
+
+        // Write every index but only advance past the visible ones, which keeps
+        // the loop free of unpredictable branches.
+        for( UINT k = 0; k < 4; k++ )
+        {
+            pVisibleIndices[VisibleCount] = i + k;
+            VisibleCount += ( ~Outside >> k ) & 1;
+        }
+    }
+
+    if( i < Last )
+    {
+        // Pad the last few volumes out to four with copies of the last one.
+        VolumeType Tail[4];
+        for( UINT k = 0; k < 4; k++ )
+            Tail[k] = pVolumes[ ( i + k < Last ) ? i + k : Last - 1 ];
+
+        UINT Outside = CullVolumes4( pPlanes, Tail );
+
+        for( UINT k = 0; i + k < Last; k++ )
+        {
+            pVisibleIndices[VisibleCount] = i + k;
+            VisibleCount += ( ~Outside >> k ) & 1;
+        }
+    }
+
+    return VisibleCount;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Call Range( First, Last, pIndices + First ) for chunks of ChunkSize items
+// of [0, Count), in parallel when a job system is given.  Each call writes the
+// indices of the items it keeps to the start of its own part of pIndices and
+// returns how many; the parts are then moved down to follow each other.
+// Return value: the number of indices kept.
+//-----------------------------------------------------------------------------
+template<typename RangeFunction>
+static UINT CompactChunks( UINT Count, UINT ChunkSize, UINT* pIndices, JobSystem* pJobSystem, RangeFunction Range )
+{
+    if( pJobSystem == NULL || Count <= ChunkSize )
+        return Range( 0, Count, pIndices );
+
+    UINT ChunkCount = ( Count + ChunkSize - 1 ) / ChunkSize;
+    std::vector<UINT> KeptCounts( ChunkCount );
+
+    pJobSystem->ParallelFor( 0, ChunkCount, 1, [&]( UINT FirstChunk, UINT LastChunk )
+    {
+        for( UINT c = FirstChunk; c < LastChunk; c++ )
+        {
+            UINT First = c * ChunkSize;
+            UINT Last = ( Count - First > ChunkSize ) ? First + ChunkSize : Count;
+
+            KeptCounts[c] = Range( First, Last, pIndices + First );
+        }
+    } );
+
+    UINT KeptCount = KeptCounts[0];
+
+    for( UINT c = 1; c < ChunkCount; c++ )
+    {
+        memmove( pIndices + KeptCount, pIndices + c * ChunkSize, KeptCounts[c] * sizeof( UINT ) );
+        KeptCount += KeptCounts[c];
+    }
+
+    return KeptCount;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Cull Count volumes against a frustum, in parallel chunks when a job system is
+// given.
+//-----------------------------------------------------------------------------
+template<typename VolumeType>
+static UINT CullVolumes( const Frustum* pFrustum, const VolumeType* pVolumes, UINT Count, UINT* pVisibleIndices,
+                         JobSystem* pJobSystem )
+{
+    XMASSERT( pFrustum );
+    XMASSERT( pVolumes || Count == 0 );
+    XMASSERT( pVisibleIndices || Count == 0 );
+
+    // Big enough that a job does far more culling than scheduling.
+    static const UINT ChunkSize = 4096;
+
+    CullPlanes Planes;
+    ComputeCullPlanes( &Planes, pFrustum );
+
+    return CompactChunks( Count, ChunkSize, pVisibleIndices, pJobSystem,
+                          [&]( UINT First, UINT Last, UINT* pOut )
+                          {
+                              return CullRange( &Planes, pVolumes, First, Last, pOut );
+                          } );
+}
+
+
+
+//-----------------------------------------------------------------------------
+UINT CullAxisAlignedBoxes( const Frustum* pFrustum, const AxisAlignedBox* pVolumes, UINT Count,
+                           UINT* pVisibleIndices, JobSystem* pJobSystem )
+{
+    return CullVolumes( pFrustum, pVolumes, Count, pVisibleIndices, pJobSystem );
+}
+
+
+
+//-----------------------------------------------------------------------------
+UINT CullSpheres( const Frustum* pFrustum, const Sphere* pVolumes, UINT Count, UINT* pVisibleIndices,
+                  JobSystem* pJobSystem )
+{
+    return CullVolumes( pFrustum, pVolumes, Count, pVisibleIndices, pJobSystem );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Load one box of each of four pairs, the first box of each pair for Side 0
+// and the second for Side 1, into Lanes: Lanes[f] holds float f of the four
+// OrientedBoxAxes, so that Lanes[0..2] are the centers, Lanes[3..5] the extents
+// and Lanes[6+3*i..8+3*i] axis i.
+//-----------------------------------------------------------------------------
+static inline VOID LoadOrientedBoxLanes( XMVECTOR Lanes[16], const OrientedBoxAxes* pBoxes, const UINT* pPairs,
+                                         UINT Side )
+{
+    const XMFLOAT4* pBox[4];
+    for( UINT k = 0; k < 4; k++ )
+        pBox[k] = reinterpret_cast<const XMFLOAT4*>( &pBoxes[ pPairs[ 2 * k + Side ] ] );
+
+    for( UINT q = 0; q < 4; q++ )
+    {
+        XMMATRIX M( XMLoadFloat4( pBox[0] + q ), XMLoadFloat4( pBox[1] + q ),
+                    XMLoadFloat4( pBox[2] + q ), XMLoadFloat4( pBox[3] + q ) );
+        M = XMMatrixTranspose( M );
+
+        Lanes[ 4 * q + 0 ] = M.r[0];
+        Lanes[ 4 * q + 1 ] = M.r[1];
+        Lanes[ 4 * q + 2 ] = M.r[2];
+        Lanes[ 4 * q + 3 ] = M.r[3];
+    }
+}
+
+
+
+//-----------------------------------------------------------------------------
+// The separating axis test of IntersectOrientedBoxOrientedBox on four pairs
+// at once.  Everything is measured along the axes of A:
+//   t = the offset from the center of A to the center of B,
+//   R[i][j] = axis i of A dot axis j of B.
+// Return a bit for each pair that intersects.
+//-----------------------------------------------------------------------------
+static inline UINT IntersectOrientedBoxPairs4( const OrientedBoxAxes* pBoxes, const UINT* pPairs )
+{
+    XMVECTOR A[16], B[16];
+    LoadOrientedBoxLanes( A, pBoxes, pPairs, 0 );
+    LoadOrientedBoxLanes( B, pBoxes, pPairs, 1 );
+
+    const XMVECTOR* h_A = A + 3;
+    const XMVECTOR* h_B = B + 3;
+
+    XMVECTOR D0 = B[0] - A[0];
+    XMVECTOR D1 = B[1] - A[1];
+    XMVECTOR D2 = B[2] - A[2];
+
+    XMVECTOR t[3], R[3][3], AR[3][3];
+
+    for( UINT i = 0; i < 3; i++ )
+    {
+        const XMVECTOR* a = A + 6 + 3 * i;
+        t[i] = D0 * a[0] + D1 * a[1] + D2 * a[2];
+
+        for( UINT j = 0; j < 3; j++ )
+        {
+            const XMVECTOR* b = B + 6 + 3 * j;
+            R[i][j] = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+            AR[i][j] = XMVectorAbs( R[i][j] );
+        }
+    }
+
+    XMVECTOR NoIntersection = XMVectorFalseInt();
+
+    // l = a(i)
+    for( UINT i = 0; i < 3; i++ )
+    {
+        XMVECTOR d_B = h_B[0] * AR[i][0] + h_B[1] * AR[i][1] + h_B[2] * AR[i][2];
+        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( XMVectorAbs( t[i] ), h_A[i] + d_B ) );
+    }
+
+    // l = b(j)
+    for( UINT j = 0; j < 3; j++ )
+    {
+        XMVECTOR d = t[0] * R[0][j] + t[1] * R[1][j] + t[2] * R[2][j];
+        XMVECTOR d_A = h_A[0] * AR[0][j] + h_A[1] * AR[1][j] + h_A[2] * AR[2][j];
+        NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( XMVectorAbs( d ), d_A + h_B[j] ) );
+    }
+
+    // Most pairs from a broad phase that are apart are found apart on the face
+    // axes.
+    if( XMVector4EqualInt( NoIntersection, XMVectorTrueInt() ) )
+        return 0;
+
+    // l = a(i) x b(j)
+    for( UINT i = 0; i < 3; i++ )
+    {
+        UINT i1 = ( i + 1 ) % 3;
+        UINT i2 = ( i + 2 ) % 3;
+
+        for( UINT j = 0; j < 3; j++ )
+        {
+            UINT j1 = ( j + 1 ) % 3;
+            UINT j2 = ( j + 2 ) % 3;
+
+            XMVECTOR d = t[i2] * R[i1][j] - t[i1] * R[i2][j];
+            XMVECTOR d_A = h_A[i1] * AR[i2][j] + h_A[i2] * AR[i1][j];
+            XMVECTOR d_B = h_B[j1] * AR[i][j2] + h_B[j2] * AR[i][j1];
+            NoIntersection = XMVectorOrInt( NoIntersection, XMVectorGreater( XMVectorAbs( d ), d_A + d_B ) );
+        }
+    }
+
+    return ~LaneMaskToBits( NoIntersection ) & 0xF;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Test the pairs [First, Last) and write the indices of the intersecting ones
+// to pIntersectingPairs.  Return how many were written.
+//-----------------------------------------------------------------------------
+static UINT IntersectOrientedBoxPairRange( const OrientedBoxAxes* pBoxes, const UINT* pPairs, UINT First, UINT Last,
+                                           UINT* pIntersectingPairs )
+{
+    UINT IntersectingCount = 0;
+    UINT i = First;
+
+    for( ; i + 4 <= Last; i += 4 )
+    {
+        UINT Hit = IntersectOrientedBoxPairs4( pBoxes, pPairs + 2 * i );
+
+        for( UINT k = 0; k < 4; k++ )
+        {
+            pIntersectingPairs[IntersectingCount] = i + k;
+            IntersectingCount += ( Hit >> k ) & 1;
+        }
+    }
+
+    if( i < Last )
+    {
+        // Pad the last few pairs out to four with copies of the last one.
+        UINT Tail[8];
+        for( UINT k = 0; k < 4; k++ )
+        {
+            UINT Pair = ( i + k < Last ) ? i + k : Last - 1;
+            Tail[ 2 * k ] = pPairs[ 2 * Pair ];
+            Tail[ 2 * k + 1 ] = pPairs[ 2 * Pair + 1 ];
+        }
+
+        UINT Hit = IntersectOrientedBoxPairs4( pBoxes, Tail );
+
+        for( UINT k = 0; i + k < Last; k++ )
+        {
+            pIntersectingPairs[IntersectingCount] = i + k;
+            IntersectingCount += ( Hit >> k ) & 1;
+        }
+    }
+
+    return IntersectingCount;
+}
+
+
+
+//-----------------------------------------------------------------------------
+UINT IntersectOrientedBoxPairs( const OrientedBoxAxes* pBoxes, const UINT* pPairs, UINT PairCount,
+                                UINT* pIntersectingPairs, JobSystem* pJobSystem )
+{
+    XMASSERT( ( pBoxes && pPairs && pIntersectingPairs ) || PairCount == 0 );
+
+    // Pairs cost several times what a culled box does, so chunks are smaller.
+    static const UINT ChunkSize = 1024;
+
+    return CompactChunks( PairCount, ChunkSize, pIntersectingPairs, pJobSystem,
+                          [&]( UINT First, UINT Last, UINT* pOut )
+                          {
+                              return IntersectOrientedBoxPairRange( pBoxes, pPairs, First, Last, pOut );
+                          } );
+}
+
+
+
 //-----------------------------------------------------------------------------
 INT IntersectTrianglePlane( FXMVECTOR V0, FXMVECTOR V1, FXMVECTOR V2, CXMVECTOR Plane )
 {
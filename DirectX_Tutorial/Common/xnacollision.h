@@ -14,6 +14,8 @@
 
 #include <xnamath.h>
 
+class JobSystem;
+
 namespace XNA
 {
 
@@ -47,6 +49,16 @@ _DECLSPEC_ALIGN_16_ struct OrientedBox
     XMFLOAT4 Orientation;       // Unit quaternion representing rotation (box -> world).
 };
 
+// An oriented box with its orientation expanded to the axes of the box, so
+// that a box tested against many others converts its quaternion only once.
+_DECLSPEC_ALIGN_16_ struct OrientedBoxAxes
+{
+    XMFLOAT3 Center;            // Center of the box.
+    XMFLOAT3 Extents;           // Distance from the center to each side.
+    XMFLOAT3 Axis[3];           // Unit axes of the box in world space (rows of the box -> world rotation).
+    FLOAT Pad;                  // Rounds the structure up to 64 bytes.
+};
+
 _DECLSPEC_ALIGN_16_ struct Frustum
 {
     XMFLOAT3 Origin;            // Origin of the frustum (and projection).
@@ -59,6 +71,23 @@ _DECLSPEC_ALIGN_16_ struct Frustum
     FLOAT Near, Far;            // Z of the near plane and far plane.
 };
 
+// Four triangles stored a component at a time: V0[0] holds the x of the first
+// vertex of each triangle, V0[1] the y's, V0[2] the z's.  E1 and E2 are the
+// edges V1 - V0 and V2 - V0.
+_DECLSPEC_ALIGN_16_ struct TrianglePacket
+{
+    XMVECTOR V0[3];
+    XMVECTOR E1[3];
+    XMVECTOR E2[3];
+};
+
+// Four rays stored the same way.
+_DECLSPEC_ALIGN_16_ struct RayPacket
+{
+    XMVECTOR Origin[3];
+    XMVECTOR Direction[3];
+};
+
 #pragma warning(pop)
 
 //-----------------------------------------------------------------------------
@@ -71,6 +100,32 @@ VOID ComputeFrustumFromProjection( Frustum* pOut, XMMATRIX* pProjection );
 VOID ComputePlanesFromFrustum( const Frustum* pVolume, XMVECTOR* pPlane0, XMVECTOR* pPlane1, XMVECTOR* pPlane2,
                                XMVECTOR* pPlane3, XMVECTOR* pPlane4, XMVECTOR* pPlane5 );
 
+// Bounding volumes for large point sets, such as the vertices of an imported
+// mesh.  The points are read four at a time and, given a JobSystem, in chunks
+// on all of its threads.
+//   -FitAxisAlignedBoxToPoints finds the same box as
+//    ComputeBoundingAxisAlignedBoxFromPoints.
+//   -FitSphereToPoints refines the sphere around a few extreme points until it
+//    is within about 0.01% of the smallest sphere around them all, where
+//    ComputeBoundingSphereFromPoints is often a few percent larger.
+//   -FitOrientedBoxToPoints finds the box of ComputeBoundingOrientedBoxFromPoints
+//    in two passes, or the axis aligned box when that is smaller.
+VOID FitAxisAlignedBoxToPoints( AxisAlignedBox* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride,
+                                JobSystem* pJobSystem = NULL );
+VOID FitSphereToPoints( Sphere* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride,
+                        JobSystem* pJobSystem = NULL );
+VOID FitOrientedBoxToPoints( OrientedBox* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride,
+                             JobSystem* pJobSystem = NULL );
+
+// Pack up to four triangles, given as indices into a vertex array, or up to
+// four rays.  Lanes past Count are left empty and never intersect.
+VOID ComputeTrianglePacket( TrianglePacket* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride,
+                            const UINT* pIndices );
+VOID ComputeRayPacket( RayPacket* pOut, UINT Count, const XMFLOAT3* pOrigins, const XMFLOAT3* pDirections );
+
+// Expand the orientations of Count boxes for IntersectOrientedBoxPairs.
+VOID ComputeOrientedBoxAxes( OrientedBoxAxes* pOut, const OrientedBox* pIn, UINT Count );
+
 
 
 //-----------------------------------------------------------------------------
@@ -110,6 +165,40 @@ BOOL IntersectOrientedBoxOrientedBox( const OrientedBox* pVolumeA, const Oriente
 
 
 
+//-----------------------------------------------------------------------------
+// Swept intersection testing routines.
+// The volume A moves from where it is by Velocity over times 0 to 1, without
+// turning, so a fast mover cannot pass through thin geometry between two
+// frames.  For OrientedBoxOrientedBox both boxes move.  Volumes that already
+// intersect at time 0 hit at time 0.
+// Return values: TRUE if the volumes touch by time 1, with *pTime the first
+//                time they do and *pNormal the unit normal at the contact,
+//                pointing from B (or the triangle) towards A.
+//-----------------------------------------------------------------------------
+BOOL IntersectSweptSphereTriangle( const Sphere* pVolume, FXMVECTOR Velocity, FXMVECTOR V0, FXMVECTOR V1,
+                                   CXMVECTOR V2, FLOAT* pTime, XMVECTOR* pNormal );
+BOOL IntersectSweptSphereAxisAlignedBox( const Sphere* pVolumeA, FXMVECTOR Velocity,
+                                         const AxisAlignedBox* pVolumeB, FLOAT* pTime, XMVECTOR* pNormal );
+BOOL IntersectSweptOrientedBoxOrientedBox( const OrientedBox* pVolumeA, FXMVECTOR VelocityA,
+                                           const OrientedBox* pVolumeB, FXMVECTOR VelocityB, FLOAT* pTime,
+                                           XMVECTOR* pNormal );
+
+
+
+//-----------------------------------------------------------------------------
+// Packet ray intersection testing routines.
+// Each tests four ray/triangle pairs at once and returns the same hits and
+// distances as IntersectRayTriangle would for each pair.
+// Return value: bit i is set if the pair in lane i intersects, and lane i of
+//               *pDist is then its distance along the ray.
+//-----------------------------------------------------------------------------
+UINT IntersectRayTrianglePacket( FXMVECTOR Origin, FXMVECTOR Direction, const TrianglePacket* pTriangles,
+                                 XMVECTOR* pDist );
+UINT IntersectRayPacketTriangle( const RayPacket* pRays, FXMVECTOR V0, FXMVECTOR V1, CXMVECTOR V2,
+                                 XMVECTOR* pDist );
+
+
+
 //-----------------------------------------------------------------------------
 // Frustum intersection testing routines.
 // Return values: 0 = no intersection, 
@@ -149,6 +238,39 @@ INT IntersectFrustum6Planes( const Frustum* pVolume, FXMVECTOR Plane0, FXMVECTOR
                              CXMVECTOR Plane3, CXMVECTOR Plane4, CXMVECTOR Plane5 );
 
 
+
+//-----------------------------------------------------------------------------
+// Batch frustum culling routines.
+// Test Count volumes against the six planes of a frustum the way the 6Planes
+// routines do, computing the planes once and testing four volumes at a time.
+// The indices of the volumes that are not outside any plane are written to
+// pVisibleIndices in increasing order, so it needs room for Count indices.
+// Given a JobSystem, the volumes are culled in chunks on all of its threads.
+// Return value: the number of visible volumes.
+//-----------------------------------------------------------------------------
+UINT CullAxisAlignedBoxes( const Frustum* pFrustum, const AxisAlignedBox* pVolumes, UINT Count,
+                           UINT* pVisibleIndices, JobSystem* pJobSystem = NULL );
+UINT CullSpheres( const Frustum* pFrustum, const Sphere* pVolumes, UINT Count, UINT* pVisibleIndices,
+                  JobSystem* pJobSystem = NULL );
+
+
+
+//-----------------------------------------------------------------------------
+// Batch oriented box intersection testing routine.
+// Test PairCount pairs of boxes, pair i being pBoxes[pPairs[2*i]] and
+// pBoxes[pPairs[2*i+1]], with the separating axis test of
+// IntersectOrientedBoxOrientedBox.  The boxes of four pairs are transposed so
+// that each vector holds one component of all four, and the 15 axes are tested
+// for the four pairs at once.  The indices of the pairs that intersect are
+// written to pIntersectingPairs in increasing order, so it needs room for
+// PairCount indices.  Given a JobSystem, the pairs are tested in chunks on all
+// of its threads.
+// Return value: the number of intersecting pairs.
+//-----------------------------------------------------------------------------
+UINT IntersectOrientedBoxPairs( const OrientedBoxAxes* pBoxes, const UINT* pPairs, UINT PairCount,
+                                UINT* pIntersectingPairs, JobSystem* pJobSystem = NULL );
+
+
 //-----------------------------------------------------------------------------
 // Volume vs plane intersection testing routines.
 // Return values: 0 = volume is outside the plane (on the positive sideof the plane),
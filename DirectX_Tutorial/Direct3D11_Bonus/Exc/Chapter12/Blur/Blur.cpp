@@ -8,6 +8,7 @@
 #include "BlurFilter.h"
 #include "GeometryGenerator.h"
 #include "RenderStates.h"
+#include "JobSystem.h"
 
 using namespace DirectX;
 
@@ -19,6 +20,7 @@ ID3D11Buffer*			  g_ScreenQuadVertexBuffer;
 ID3D11Buffer*			  g_ScreenQuadIndexBuffer;
 
 Waves					  g_Wave;
+JobSystem*				  g_JobSystem;
 UINT					  g_WaveIndexCount;
 ID3D11Buffer*			  g_WaveVertexBuffer;
 ID3D11Buffer*			  g_WaveIndexBuffer;
@@ -63,24 +65,23 @@ ID3D11RenderTargetView*		g_OffscreenRTV;
 
 
 
-float GetHillHeight(float x, float z)
+// f(x, z) = 0.3(z*sin(0.1x) + x*cos(0.1z)), four points at a time.
+class HillsHeightField : public GeometryGenerator::HeightField
 {
-	return 0.3f * (z * sinf(0.1f * x) + x * cosf(0.1f * z));
-}
-
-XMFLOAT3 GetHillNormal(float x, float z)
-{
-	// n = (-df/dx, 1, -df/dz)
-	XMFLOAT3 n(
-		-0.03f * z * cosf(0.1f * x) - 0.3f * cosf(0.1f * z),
-		1.0f,
-		-0.3f * sinf(0.1f * x) + 0.03f * x * sinf(0.1f * z));
+public:
+	void Evaluate(FXMVECTOR x, FXMVECTOR z, XMVECTOR& height, XMVECTOR& slopeX, XMVECTOR& slopeZ)const
+	{
+		XMVECTOR sinX, cosX, sinZ, cosZ;
+		XMVectorSinCos(&sinX, &cosX, 0.1f * x);
+		XMVectorSinCos(&sinZ, &cosZ, 0.1f * z);
 
-	XMVECTOR unitNormal = XMVector3Normalize(XMLoadFloat3(&n));
-	XMStoreFloat3(&n, unitNormal);
+		height = 0.3f * (z * sinX + x * cosZ);
 
-	return n;
-}
+		// df/dx and df/dz
+		slopeX = 0.03f * z * cosX + 0.3f * cosZ;
+		slopeZ = 0.3f * sinX - 0.03f * x * sinZ;
+	}
+};
 
 
 
@@ -227,6 +228,10 @@ HRESULT CALLBACK OnD3D11CreateDevice(ID3D11Device* pd3dDevice, const DXGI_SURFAC
 	//
 	g_Wave.Init(300, 300, 1.0f, 0.03f, 3.25f, 0.4f);
 
+	// Spread the wave update over a worker thread per core.
+	g_JobSystem = new JobSystem();
+	g_Wave.SetJobSystem(g_JobSystem);
+
 	// ===== WAVE VERTEX =====
 	D3D11_BUFFER_DESC waveVBD = {};
 	waveVBD.ByteWidth = sizeof(Vertex::Basic32) * g_Wave.VertexCount();
@@ -274,21 +279,19 @@ HRESULT CALLBACK OnD3D11CreateDevice(ID3D11Device* pd3dDevice, const DXGI_SURFAC
 	//
 	// Build Land Geometry 
 	//
+	// The grid comes out already raised to the hills, with their normals, its
+	// rows split over the job system.
 	GeometryGenerator::MeshData grid;
 	GeometryGenerator geoGen;
-	geoGen.CreateGrid(300.0f, 300.0f, 200, 200, grid);
+	geoGen.CreateGrid(300.0f, 300.0f, 200, 200, HillsHeightField(), grid, g_JobSystem);
 	g_LandIndexCount = grid.Indices.size();
 
 	// ===== LAND VERTEX =====
 	std::vector<Vertex::Basic32> landVertices(grid.Vertices.size());
 	for (size_t i = 0; i < grid.Vertices.size(); ++i)
 	{
-		XMFLOAT3 p = grid.Vertices[i].Position;
-
-		p.y = GetHillHeight(p.x, p.z);
-
-		landVertices[i].Pos = p;
-		landVertices[i].Normal = GetHillNormal(p.x, p.z);
+		landVertices[i].Pos = grid.Vertices[i].Position;
+		landVertices[i].Normal = grid.Vertices[i].Normal;
 		landVertices[i].Tex = grid.Vertices[i].TexC;
 	}
 
@@ -650,7 +653,8 @@ void CALLBACK OnD3D11FrameRender(ID3D11Device* pd3dDevice, ID3D11DeviceContext*
 //--------------------------------------------------------------------------------------
 void CALLBACK OnD3D11DestroyDevice(void* pUserContext)
 {
-
+	g_Wave.SetJobSystem(nullptr);
+	SAFE_DELETE(g_JobSystem);
 }
 
 
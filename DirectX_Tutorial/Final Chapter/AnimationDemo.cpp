@@ -14,6 +14,8 @@
 #include "RenderStates.h"
 #include "LoadM3d.h"
 #include "SkinnedModel.h"
+#include "SkinnedAnimationBatch.h"
+#include "../Common/JobSystem.h"
 
 
 
@@ -28,11 +30,189 @@ TextureMgr mTexMgr;
 SkinnedModel*			mCharacterModel;
 SkinnedModelInstance	mCharacterInstance1;
 SkinnedModelInstance	mCharacterInstance2;
+SkinnedModelInstance*	mCharacterInstances[] = { &mCharacterInstance1, &mCharacterInstance2 };
+SkinnedAnimationBatch	mAnimationBatch;
+JobSystem*				mJobSystem;
 
 //--------------------------------------------------------------------------------------
 // Function Helper
 //--------------------------------------------------------------------------------------
 
+//--------------------------------------------------------------------------------------
+// Headless pose-evaluation benchmark, run with "-benchmark" on the command line.
+// Animates 1, 100 and 10000 soldier instances and writes the throughput in
+// bones per second to AnimationBenchmark.txt for:
+//   Instance - SkinnedModelInstance::Update on each instance in turn (baseline)
+//   Batch    - SkinnedAnimationBatch::Update over all the instances
+//   Jobs     - as Batch, spread over a JobSystem
+//   Seek     - SkinnedData::GetFinalTransforms, binary key search per bone
+//   Uniform  - as Instance, with the clips baked to 60 keys per second
+//   Compressed - as Instance, decoding a CompressedAnimationClip
+// The model is loaded on a WARP device, so no window or GPU is needed.  It also
+// reports the size and the largest error of the compressed clip, and returns 2
+// if that error is larger than the compression tolerances.
+//--------------------------------------------------------------------------------------
+enum BenchmarkMode
+{
+	BenchmarkMode_Instance,
+	BenchmarkMode_Batch,
+	BenchmarkMode_Jobs,
+	BenchmarkMode_Seek
+};
+
+double MeasureBonesPerSecond(SkinnedModel& model, const std::string& clipName, UINT instanceCount,
+	BenchmarkMode mode, JobSystem& jobSystem)
+{
+	UINT numBones = model.SkinnedData.BoneCount();
+	float clipEnd = model.SkinnedData.GetClipEndTime(clipName);
+
+	// Stagger the instances along the clip so they don't all hit the same keys.
+	std::vector<SkinnedModelInstance> instances(instanceCount);
+	std::vector<SkinnedModelInstance*> instancePointers(instanceCount);
+	for(UINT i = 0; i < instanceCount; ++i)
+	{
+		instances[i].Model = &model;
+		instances[i].TimePos = clipEnd*i/instanceCount;
+		instances[i].ClipName = clipName;
+		instances[i].FinalTransforms.resize(numBones);
+		instancePointers[i] = &instances[i];
+	}
+
+	SkinnedAnimationBatch batch;
+
+	// Roughly the same amount of work for every instance count.
+	UINT frameCount = MathHelper::Max(20000 / instanceCount, 10u);
+	const float dt = 1.0f / 60.0f;
+
+	LARGE_INTEGER frequency, start, stop;
+	QueryPerformanceFrequency(&frequency);
+
+	// Frame -1 warms up the caches, the cursors and the batch's scratch buffers.
+	for(int frame = -1; frame < (int)frameCount; ++frame)
+	{
+		if( frame == 0 )
+			QueryPerformanceCounter(&start);
+
+		switch( mode )
+		{
+		case BenchmarkMode_Instance:
+			for(UINT i = 0; i < instanceCount; ++i)
+				instances[i].Update(dt);
+			break;
+		case BenchmarkMode_Batch:
+			batch.Update(&instancePointers[0], instanceCount, dt);
+			break;
+		case BenchmarkMode_Jobs:
+			batch.Update(jobSystem, &instancePointers[0], instanceCount, dt);
+			break;
+		case BenchmarkMode_Seek:
+			for(UINT i = 0; i < instanceCount; ++i)
+			{
+				SkinnedModelInstance& instance = instances[i];
+				instance.TimePos += dt;
+				model.SkinnedData.GetFinalTransforms(clipName, instance.TimePos, instance.FinalTransforms);
+				if( instance.TimePos > clipEnd )
+					instance.TimePos = 0.0f;
+			}
+			break;
+		}
+	}
+	QueryPerformanceCounter(&stop);
+
+	double seconds = (double)(stop.QuadPart - start.QuadPart) / frequency.QuadPart;
+	return (double)numBones*instanceCount*frameCount / seconds;
+}
+
+int RunAnimationBenchmark()
+{
+	ID3D11Device* device = 0;
+	ID3D11DeviceContext* context = 0;
+	if( FAILED(D3D11CreateDevice(0, D3D_DRIVER_TYPE_WARP, 0, 0, 0, 0, D3D11_SDK_VERSION, &device, 0, &context)) )
+		return 1;
+
+	int result;
+	{
+		TextureMgr texMgr;
+		texMgr.Init(device);
+
+		// The instances only read SkinnedData, which is swapped below for the
+		// resampled and compressed clips.
+		SkinnedModel model(device, texMgr, "Models/soldier.m3d", L"Textures/");
+		SkinnedData sourceData = model.SkinnedData;
+
+		SkinnedData uniformData = sourceData;
+		uniformData.ResampleClips(60.0f);
+
+		AnimationCompressionSettings compression;
+		SkinnedData compressedData = sourceData;
+		compressedData.CompressClips(compression);
+
+		JobSystem jobSystem;
+
+		std::ofstream fout("AnimationBenchmark.txt");
+		char line[256];
+
+		//
+		// Compression ratio and error against the source clip.
+		//
+
+		const AnimationClip& sourceClip = *sourceData.GetClip("Take1");
+		const CompressedAnimationClip& compressedClip = *compressedData.GetCompressedClip("Take1");
+
+		float translationError, scaleError, rotationError;
+		compressedClip.MeasureError(sourceClip, 600.0f, translationError, scaleError, rotationError);
+
+		sprintf_s(line, "Compression: %u -> %u bytes (x%.1f)  max error: translation %g, scale %g, rotation %g rad\n",
+			CompressedAnimationClip::GetSizeInBytes(sourceClip), compressedClip.GetSizeInBytes(),
+			(float)CompressedAnimationClip::GetSizeInBytes(sourceClip) / compressedClip.GetSizeInBytes(),
+			translationError, scaleError, rotationError);
+		fout << line;
+		OutputDebugStringA(line);
+
+		// The tolerances are enforced at the source keys; allow a little slack for
+		// the slerp curvature between them.
+		const float slack = 1.05f;
+		bool errorOk = translationError <= compression.TranslationTolerance*slack &&
+			scaleError <= compression.ScaleTolerance*slack &&
+			rotationError <= compression.RotationTolerance*slack;
+		if( !errorOk )
+			fout << "Compression error exceeds tolerance" << std::endl;
+
+		fout << "Bones: " << sourceData.BoneCount() << "  Threads: " << jobSystem.ThreadCount() << "  (bones/s)" << std::endl;
+
+		const UINT instanceCounts[] = { 1, 100, 10000 };
+		for(UINT i = 0; i < ARRAYSIZE(instanceCounts); ++i)
+		{
+			UINT count = instanceCounts[i];
+
+			model.SkinnedData = sourceData;
+			double instance = MeasureBonesPerSecond(model, "Take1", count, BenchmarkMode_Instance, jobSystem);
+			double batch    = MeasureBonesPerSecond(model, "Take1", count, BenchmarkMode_Batch, jobSystem);
+			double jobs     = MeasureBonesPerSecond(model, "Take1", count, BenchmarkMode_Jobs, jobSystem);
+			double seek     = MeasureBonesPerSecond(model, "Take1", count, BenchmarkMode_Seek, jobSystem);
+
+			model.SkinnedData = uniformData;
+			double uniform = MeasureBonesPerSecond(model, "Take1", count, BenchmarkMode_Instance, jobSystem);
+
+			model.SkinnedData = compressedData;
+			double compressed = MeasureBonesPerSecond(model, "Take1", count, BenchmarkMode_Instance, jobSystem);
+
+			sprintf_s(line, "Instances: %5u  Instance: %12.0f  Batch: %12.0f (x%.2f)  Jobs: %12.0f (x%.2f)  "
+				"Seek: %12.0f  Uniform: %12.0f  Compressed: %12.0f\n",
+				count, instance, batch, batch/instance, jobs, jobs/instance, seek, uniform, compressed);
+
+			fout << line;
+			OutputDebugStringA(line);
+		}
+
+		result = errorOk ? 0 : 2;
+	}
+
+	SAFE_RELEASE(context);
+	SAFE_RELEASE(device);
+	return result;
+}
+
 
 
 
@@ -101,6 +281,7 @@ HRESULT CALLBACK OnD3D11CreateDevice(ID3D11Device* pd3dDevice, const DXGI_SURFAC
 	// --------------------------------------------------------------------------------------
 	// --------------------------------------------------------------------------------------
 	mTexMgr.Init(pd3dDevice);
+	mJobSystem = new JobSystem();
 
 
 	mCharacterModel = new SkinnedModel(pd3dDevice, mTexMgr, "Models/soldier.m3d", L"Textures/");
@@ -233,8 +414,7 @@ void CALLBACK OnFrameMove(double fTime, float fElapsedTime, void* pUserContext)
 {
 	g_Camera.FrameMove(fElapsedTime);
 
-	mCharacterInstance1.Update(fElapsedTime);
-	mCharacterInstance2.Update(fElapsedTime);
+	mAnimationBatch.Update(*mJobSystem, mCharacterInstances, ARRAYSIZE(mCharacterInstances), fElapsedTime);
 }
 
 
@@ -246,7 +426,7 @@ void CALLBACK OnFrameMove(double fTime, float fElapsedTime, void* pUserContext)
 	//--------------------------------------------------------------------------------------
 void CALLBACK OnD3D11DestroyDevice(void* pUserContext)
 {
-
+	SAFE_DELETE(mJobSystem);
 }
 
 
@@ -348,6 +528,8 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
+	if( lpCmdLine && wcsstr(lpCmdLine, L"-benchmark") )
+		return RunAnimationBenchmark();
 
 	DXUTSetCallbackFrameMove(OnFrameMove);
 	DXUTSetCallbackKeyboard(OnKeyboard);
@@ -0,0 +1,356 @@
+#include "CompressedAnimation.h"
+#include "SkinnedData.h"
+#include <algorithm>
+
+namespace
+{
+	// The three stored components of a unit quaternion lie in [-1/sqrt(2), 1/sqrt(2)].
+	const float SmallestThreeRange = 0.70710678f;
+	const float PackedQuaternionScale = 32767.0f;
+
+	float VectorError(FXMVECTOR a, FXMVECTOR b)
+	{
+		return XMVectorGetX(XMVector3Length(a - b));
+	}
+
+	// Angle of the rotation that takes a to b.  Computed from the chord between
+	// the quaternions rather than acos of their dot product, which cannot
+	// resolve angles below about 1e-3 radians in single precision.
+	float RotationError(FXMVECTOR a, FXMVECTOR b)
+	{
+		XMVECTOR qa = XMQuaternionNormalize(a);
+		XMVECTOR qb = XMQuaternionNormalize(b);
+		if( XMVectorGetX(XMQuaternionDot(qa, qb)) < 0.0f )
+			qb = -qb;
+
+		float chord = XMVectorGetX(XMVector4Length(qa - qb));
+		return 4.0f*asinf(MathHelper::Min(0.5f*chord, 1.0f));
+	}
+
+	//
+	// Greedy key reduction.  Starting from the last key kept, a segment is
+	// extended one key at a time for as long as interpolating across it
+	// reproduces every skipped key within tolerance.  error(a, b, j) is the
+	// error at key j when interpolating between keys a and b.  The first and
+	// last keys are always kept.
+	//
+	template <typename ErrorFunction>
+	void SelectKeys(UINT keyCount, float tolerance, ErrorFunction error, std::vector<UINT>& kept)
+	{
+		kept.clear();
+		kept.push_back(0);
+
+		UINT a = 0;
+		for(UINT b = 2; b < keyCount; ++b)
+		{
+			for(UINT j = a + 1; j < b; ++j)
+			{
+				if( error(a, b, j) > tolerance )
+				{
+					a = b - 1;
+					kept.push_back(a);
+					break;
+				}
+			}
+		}
+
+		if( keyCount > 1 )
+			kept.push_back(keyCount - 1);
+	}
+
+	float LerpPercent(const std::vector<Keyframe>& keys, UINT a, UINT b, UINT j)
+	{
+		return (keys[j].TimePos - keys[a].TimePos) / (keys[b].TimePos - keys[a].TimePos);
+	}
+}
+
+AnimationCompressionSettings::AnimationCompressionSettings()
+	: TranslationTolerance(0.01f),
+	ScaleTolerance(0.0001f),
+	RotationTolerance(0.0005f)
+{
+}
+
+PackedQuaternion PackedQuaternion::Pack(FXMVECTOR q)
+{
+	XMFLOAT4 v;
+	XMStoreFloat4(&v, XMQuaternionNormalize(q));
+	float c[4] = { v.x, v.y, v.z, v.w };
+
+	UINT largest = 0;
+	for(UINT i = 1; i < 4; ++i)
+	{
+		if( fabsf(c[i]) > fabsf(c[largest]) )
+			largest = i;
+	}
+
+	// q and -q are the same rotation, so flip q to make the dropped component
+	// positive; Unpack() then only has to rebuild its magnitude.
+	float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+
+	PackedQuaternion p;
+	UINT n = 0;
+	for(UINT i = 0; i < 4; ++i)
+	{
+		if( i == largest )
+			continue;
+
+		float x = MathHelper::Clamp(sign*c[i] / SmallestThreeRange, -1.0f, 1.0f);
+		p.Data[n++] = (USHORT)((x*0.5f + 0.5f)*PackedQuaternionScale + 0.5f);
+	}
+
+	p.Data[0] |= (USHORT)((largest & 1) << 15);
+	p.Data[1] |= (USHORT)((largest >> 1) << 15);
+	return p;
+}
+
+XMVECTOR PackedQuaternion::Unpack()const
+{
+	UINT largest = (Data[0] >> 15) | ((Data[1] >> 15) << 1);
+
+	float c[4];
+	float sumSquares = 0.0f;
+	UINT n = 0;
+	for(UINT i = 0; i < 4; ++i)
+	{
+		if( i == largest )
+			continue;
+
+		float x = (Data[n++] & 0x7FFF) / PackedQuaternionScale;
+		c[i] = (x*2.0f - 1.0f)*SmallestThreeRange;
+		sumSquares += c[i]*c[i];
+	}
+	c[largest] = sqrtf(MathHelper::Max(1.0f - sumSquares, 0.0f));
+
+	return XMVectorSet(c[0], c[1], c[2], c[3]);
+}
+
+CompressedAnimationClip::CompressedAnimationClip()
+	: mStartTime(0.0f), mEndTime(0.0f)
+{
+}
+
+void CompressedAnimationClip::Compress(const AnimationClip& clip, const AnimationCompressionSettings& settings)
+{
+	UINT numBones = clip.BoneAnimations.size();
+
+	mStartTime = numBones > 0 ? clip.GetClipStartTime() : 0.0f;
+	mEndTime   = numBones > 0 ? clip.GetClipEndTime() : 0.0f;
+
+	mTracks.resize(numBones*Track_Count);
+	mVectorTimes.clear();
+	mVectorKeys.clear();
+	mRotationTimes.clear();
+	mRotationKeys.clear();
+
+	for(UINT i = 0; i < numBones; ++i)
+	{
+		const std::vector<Keyframe>& keys = clip.BoneAnimations[i].Keyframes;
+
+		CompressVectorTrack(keys, &Keyframe::Translation, settings.TranslationTolerance, mTracks[i*Track_Count + Track_Translation]);
+		CompressVectorTrack(keys, &Keyframe::Scale, settings.ScaleTolerance, mTracks[i*Track_Count + Track_Scale]);
+		CompressRotationTrack(keys, settings.RotationTolerance, mTracks[i*Track_Count + Track_Rotation]);
+	}
+}
+
+void CompressedAnimationClip::CompressVectorTrack(const std::vector<Keyframe>& keys, XMFLOAT3 Keyframe::* channel,
+												  float tolerance, Track& track)
+{
+	track.FirstKey = mVectorKeys.size();
+
+	// A constant track keeps only its first key.
+	bool constant = true;
+	XMVECTOR first = XMLoadFloat3(&(keys[0].*channel));
+	for(UINT j = 1; j < keys.size() && constant; ++j)
+		constant = VectorError(first, XMLoadFloat3(&(keys[j].*channel))) <= tolerance;
+
+	if( constant )
+	{
+		mVectorTimes.push_back(keys[0].TimePos);
+		mVectorKeys.push_back(keys[0].*channel);
+		track.KeyCount = 1;
+		return;
+	}
+
+	std::vector<UINT> kept;
+	SelectKeys(keys.size(), tolerance, [&](UINT a, UINT b, UINT j)
+	{
+		XMVECTOR v = XMVectorLerp(XMLoadFloat3(&(keys[a].*channel)), XMLoadFloat3(&(keys[b].*channel)), LerpPercent(keys, a, b, j));
+		return VectorError(v, XMLoadFloat3(&(keys[j].*channel)));
+	}, kept);
+
+	for(UINT k = 0; k < kept.size(); ++k)
+	{
+		mVectorTimes.push_back(keys[kept[k]].TimePos);
+		mVectorKeys.push_back(keys[kept[k]].*channel);
+	}
+	track.KeyCount = kept.size();
+}
+
+void CompressedAnimationClip::CompressRotationTrack(const std::vector<Keyframe>& keys, float tolerance, Track& track)
+{
+	track.FirstKey = mRotationKeys.size();
+
+	// Measure the reduction against the quantized keys, so the tolerance bounds
+	// the total error and not just the error of dropping keys.
+	std::vector<PackedQuaternion> packed(keys.size());
+	for(UINT j = 0; j < keys.size(); ++j)
+		packed[j] = PackedQuaternion::Pack(XMLoadFloat4(&keys[j].RotationQuat));
+
+	bool constant = true;
+	XMVECTOR first = packed[0].Unpack();
+	for(UINT j = 1; j < keys.size() && constant; ++j)
+		constant = RotationError(first, XMLoadFloat4(&keys[j].RotationQuat)) <= tolerance;
+
+	if( constant )
+	{
+		mRotationTimes.push_back(keys[0].TimePos);
+		mRotationKeys.push_back(packed[0]);
+		track.KeyCount = 1;
+		return;
+	}
+
+	std::vector<UINT> kept;
+	SelectKeys(keys.size(), tolerance, [&](UINT a, UINT b, UINT j)
+	{
+		XMVECTOR q = XMQuaternionSlerp(packed[a].Unpack(), packed[b].Unpack(), LerpPercent(keys, a, b, j));
+		return RotationError(q, XMLoadFloat4(&keys[j].RotationQuat));
+	}, kept);
+
+	for(UINT k = 0; k < kept.size(); ++k)
+	{
+		mRotationTimes.push_back(keys[kept[k]].TimePos);
+		mRotationKeys.push_back(packed[kept[k]]);
+	}
+	track.KeyCount = kept.size();
+}
+
+UINT CompressedAnimationClip::BoneCount()const
+{
+	return mTracks.size() / Track_Count;
+}
+
+float CompressedAnimationClip::GetClipStartTime()const
+{
+	return mStartTime;
+}
+
+float CompressedAnimationClip::GetClipEndTime()const
+{
+	return mEndTime;
+}
+
+const CompressedAnimationClip::Track& CompressedAnimationClip::GetTrack(UINT bone, TrackType type)const
+{
+	return mTracks[bone*Track_Count + type];
+}
+
+XMVECTOR CompressedAnimationClip::SampleVectorTrack(const Track& track, float t)const
+{
+	const float* times = &mVectorTimes[track.FirstKey];
+	const XMFLOAT3* keys = &mVectorKeys[track.FirstKey];
+
+	UINT last = track.KeyCount - 1;
+	if( last == 0 || t <= times[0] )
+		return XMLoadFloat3(&keys[0]);
+	if( t >= times[last] )
+		return XMLoadFloat3(&keys[last]);
+
+	UINT i = (UINT)(std::upper_bound(times, times + track.KeyCount, t) - times) - 1;
+	float lerpPercent = (t - times[i]) / (times[i+1] - times[i]);
+
+	return XMVectorLerp(XMLoadFloat3(&keys[i]), XMLoadFloat3(&keys[i+1]), lerpPercent);
+}
+
+XMVECTOR CompressedAnimationClip::SampleRotationTrack(const Track& track, float t)const
+{
+	const float* times = &mRotationTimes[track.FirstKey];
+	const PackedQuaternion* keys = &mRotationKeys[track.FirstKey];
+
+	UINT last = track.KeyCount - 1;
+	if( last == 0 || t <= times[0] )
+		return keys[0].Unpack();
+	if( t >= times[last] )
+		return keys[last].Unpack();
+
+	UINT i = (UINT)(std::upper_bound(times, times + track.KeyCount, t) - times) - 1;
+	float lerpPercent = (t - times[i]) / (times[i+1] - times[i]);
+
+	return XMQuaternionSlerp(keys[i].Unpack(), keys[i+1].Unpack(), lerpPercent);
+}
+
+void CompressedAnimationClip::Interpolate(UINT bone, float t, XMVECTOR& S, XMVECTOR& P, XMVECTOR& Q)const
+{
+	S = SampleVectorTrack(GetTrack(bone, Track_Scale), t);
+	P = SampleVectorTrack(GetTrack(bone, Track_Translation), t);
+	Q = SampleRotationTrack(GetTrack(bone, Track_Rotation), t);
+}
+
+void CompressedAnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms)const
+{
+	XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+
+	UINT numBones = BoneCount();
+	for(UINT i = 0; i < numBones; ++i)
+	{
+		XMVECTOR S, P, Q;
+		Interpolate(i, t, S, P, Q);
+
+		XMStoreFloat4x4(&boneTransforms[i], XMMatrixAffineTransformation(S, zero, Q, P));
+	}
+}
+
+UINT CompressedAnimationClip::GetSizeInBytes()const
+{
+	return sizeof(CompressedAnimationClip) +
+		mTracks.size()*sizeof(Track) +
+		mVectorTimes.size()*sizeof(float) +
+		mVectorKeys.size()*sizeof(XMFLOAT3) +
+		mRotationTimes.size()*sizeof(float) +
+		mRotationKeys.size()*sizeof(PackedQuaternion);
+}
+
+UINT CompressedAnimationClip::GetSizeInBytes(const AnimationClip& clip)
+{
+	UINT size = sizeof(AnimationClip) + clip.BoneAnimations.size()*sizeof(BoneAnimation);
+	for(UINT i = 0; i < clip.BoneAnimations.size(); ++i)
+		size += clip.BoneAnimations[i].Keyframes.size()*sizeof(Keyframe);
+
+	return size;
+}
+
+void CompressedAnimationClip::MeasureError(const AnimationClip& clip, float sampleRate,
+	float& maxTranslationError, float& maxScaleError, float& maxRotationError)const
+{
+	maxTranslationError = 0.0f;
+	maxScaleError = 0.0f;
+	maxRotationError = 0.0f;
+
+	UINT sampleCount = (UINT)((mEndTime - mStartTime)*sampleRate) + 1;
+
+	for(UINT i = 0; i < clip.BoneAnimations.size(); ++i)
+	{
+		const BoneAnimation& bone = clip.BoneAnimations[i];
+
+		std::vector<float> times;
+		for(UINT j = 0; j < bone.Keyframes.size(); ++j)
+			times.push_back(bone.Keyframes[j].TimePos);
+		for(UINT j = 0; j < sampleCount; ++j)
+			times.push_back(mStartTime + j/sampleRate);
+		std::sort(times.begin(), times.end());
+
+		UINT cursor = 0;
+		for(UINT j = 0; j < times.size(); ++j)
+		{
+			XMVECTOR S0, P0, Q0;
+			bone.Sample(times[j], cursor, S0, P0, Q0);
+
+			XMVECTOR S1, P1, Q1;
+			Interpolate(i, times[j], S1, P1, Q1);
+
+			maxTranslationError = MathHelper::Max(maxTranslationError, VectorError(P0, P1));
+			maxScaleError       = MathHelper::Max(maxScaleError, VectorError(S0, S1));
+			maxRotationError    = MathHelper::Max(maxRotationError, RotationError(Q0, Q1));
+		}
+	}
+}
@@ -0,0 +1,109 @@
+#ifndef COMPRESSEDANIMATION_H
+#define COMPRESSEDANIMATION_H
+
+#include <DXUT.h>
+#include <vector>
+
+using namespace DirectX;
+
+struct Keyframe;
+struct AnimationClip;
+
+///<summary>
+/// How far the compressed clip may deviate from the source keys.
+///</summary>
+struct AnimationCompressionSettings
+{
+	AnimationCompressionSettings();
+
+	float TranslationTolerance; // model units
+	float ScaleTolerance;
+	float RotationTolerance;    // radians
+};
+
+///<summary>
+/// Unit quaternion in 48 bits using the "smallest three" encoding.  The
+/// component with the largest magnitude is dropped and rebuilt from the other
+/// three, which all lie in [-1/sqrt(2), 1/sqrt(2)] and are stored in 15 bits
+/// each.  The index of the dropped component goes in the spare top bits.
+///</summary>
+struct PackedQuaternion
+{
+	USHORT Data[3];
+
+	static PackedQuaternion Pack(FXMVECTOR q);
+	XMVECTOR Unpack()const;
+};
+
+///<summary>
+/// Compressed copy of an AnimationClip.  Each bone has a translation, a scale
+/// and a rotation track with its own key times:
+///   - a track that stays within tolerance of its first key keeps one key;
+///   - rotations are stored as PackedQuaternions;
+///   - keys that interpolation between their neighbours reproduces within
+///     tolerance are removed.
+/// Interpolate() decodes the same pose AnimationClip::Interpolate would give,
+/// within the tolerances of the settings used to compress the clip.
+///</summary>
+class CompressedAnimationClip
+{
+public:
+	CompressedAnimationClip();
+
+	void Compress(const AnimationClip& clip, const AnimationCompressionSettings& settings);
+
+	UINT BoneCount()const;
+	float GetClipStartTime()const;
+	float GetClipEndTime()const;
+
+	void Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms)const;
+	void Interpolate(UINT bone, float t, XMVECTOR& S, XMVECTOR& P, XMVECTOR& Q)const;
+
+	UINT GetSizeInBytes()const;
+	static UINT GetSizeInBytes(const AnimationClip& clip);
+
+	// Largest per-bone (local space) differences from the source clip, sampled
+	// at its keys and at sampleRate samples per second in between.
+	void MeasureError(const AnimationClip& clip, float sampleRate,
+		float& maxTranslationError, float& maxScaleError, float& maxRotationError)const;
+
+private:
+	enum TrackType
+	{
+		Track_Translation,
+		Track_Scale,
+		Track_Rotation,
+		Track_Count
+	};
+
+	struct Track
+	{
+		UINT FirstKey;
+		UINT KeyCount;
+	};
+
+	void CompressVectorTrack(const std::vector<Keyframe>& keys, XMFLOAT3 Keyframe::* channel,
+		float tolerance, Track& track);
+	void CompressRotationTrack(const std::vector<Keyframe>& keys, float tolerance, Track& track);
+
+	const Track& GetTrack(UINT bone, TrackType type)const;
+
+	XMVECTOR SampleVectorTrack(const Track& track, float t)const;
+	XMVECTOR SampleRotationTrack(const Track& track, float t)const;
+
+private:
+	float mStartTime;
+	float mEndTime;
+
+	// Track_Count tracks per bone.
+	std::vector<Track> mTracks;
+
+	// Translation and scale keys.
+	std::vector<float> mVectorTimes;
+	std::vector<XMFLOAT3> mVectorKeys;
+
+	std::vector<float> mRotationTimes;
+	std::vector<PackedQuaternion> mRotationKeys;
+};
+
+#endif // COMPRESSEDANIMATION_H
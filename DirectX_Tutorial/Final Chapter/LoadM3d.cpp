@@ -81,6 +81,127 @@ bool M3DLoader::LoadM3d(const std::string& filename,
     return false;
 }
 
+bool M3DLoader::LoadM3db(const std::string& filename, 
+						 std::vector<Vertex::PosNormalTexTan>& vertices,
+						 std::vector<USHORT>& indices,
+						 std::vector<MeshGeometry::Subset>& subsets,
+						 std::vector<M3dMaterial>& mats,
+						 const std::string& sourceFilename)
+{
+	M3dbFile file;
+	if( !file.Open(filename) || (!sourceFilename.empty() && !file.IsConvertedFrom(sourceFilename)) )
+		return false;
+
+	ReadM3dbMeshData(file, vertices, indices, subsets, mats);
+
+	return true;
+}
+
+bool M3DLoader::LoadM3db(const std::string& filename, 
+						 std::vector<Vertex::PosNormalTexTan>& vertices,
+						 std::vector<USHORT>& indices,
+						 std::vector<MeshGeometry::Subset>& subsets,
+						 std::vector<M3dMaterial>& mats,
+						 SkinnedData& skinInfo,
+						 const std::string& sourceFilename)
+{
+	M3dbFile file;
+	if( !file.Open(filename) || (!sourceFilename.empty() && !file.IsConvertedFrom(sourceFilename)) )
+		return false;
+
+	ReadM3dbMeshData(file, vertices, indices, subsets, mats);
+
+	M3dbSpan<XMFLOAT4X4> offsetSpan = file.BoneOffsets();
+	M3dbSpan<int> hierarchySpan = file.BoneHierarchy();
+
+	std::vector<XMFLOAT4X4> boneOffsets(offsetSpan.begin(), offsetSpan.end());
+	std::vector<int> boneIndexToParentIndex(hierarchySpan.begin(), hierarchySpan.end());
+	std::map<std::string, AnimationClip> animations;
+
+	UINT numBones = file.BoneCount();
+	M3dbSpan<M3dbClip> clips = file.Clips();
+	for(UINT clipIndex = 0; clipIndex < clips.Count; ++clipIndex)
+	{
+		AnimationClip& clip = animations[clips[clipIndex].Name];
+		clip.BoneAnimations.resize(numBones);
+
+		for(UINT boneIndex = 0; boneIndex < numBones; ++boneIndex)
+		{
+			M3dbSpan<Keyframe> keys = file.BoneKeyframes(clipIndex, boneIndex);
+			clip.BoneAnimations[boneIndex].Keyframes.assign(keys.begin(), keys.end());
+		}
+	}
+
+	skinInfo.Set(boneIndexToParentIndex, boneOffsets, animations);
+
+	return true;
+}
+
+void M3DLoader::ReadM3dbMeshData(const M3dbFile& file,
+								 std::vector<Vertex::PosNormalTexTan>& vertices,
+								 std::vector<USHORT>& indices,
+								 std::vector<MeshGeometry::Subset>& subsets,
+								 std::vector<M3dMaterial>& mats)
+{
+	M3dbSpan<Vertex::PosNormalTexTan> vertexSpan = file.Vertices();
+	M3dbSpan<USHORT> indexSpan = file.Indices();
+	M3dbSpan<MeshGeometry::Subset> subsetSpan = file.Subsets();
+	M3dbSpan<M3dbMaterial> matSpan = file.Materials();
+
+	vertices.assign(vertexSpan.begin(), vertexSpan.end());
+	indices.assign(indexSpan.begin(), indexSpan.end());
+	subsets.assign(subsetSpan.begin(), subsetSpan.end());
+
+	mats.resize(matSpan.Count);
+	for(UINT i = 0; i < matSpan.Count; ++i)
+	{
+		mats[i].Mat            = matSpan[i].Mat;
+		mats[i].AlphaClip      = matSpan[i].AlphaClip != 0;
+		mats[i].EffectTypeName = matSpan[i].EffectTypeName;
+
+		std::string diffuseMapName = matSpan[i].DiffuseMapName;
+		std::string normalMapName  = matSpan[i].NormalMapName;
+		mats[i].DiffuseMapName.assign(diffuseMapName.begin(), diffuseMapName.end());
+		mats[i].NormalMapName.assign(normalMapName.begin(), normalMapName.end());
+	}
+}
+
+bool M3DLoader::ConvertM3dToM3db(const std::string& m3dFilename, const std::string& m3dbFilename,
+								 const std::vector<Vertex::PosNormalTexTan>& vertices,
+								 const std::vector<USHORT>& indices,
+								 const std::vector<MeshGeometry::Subset>& subsets,
+								 const std::vector<M3dMaterial>& mats,
+								 const SkinnedData& skinInfo)
+{
+	std::vector<M3dbMaterial> binaryMats(mats.size());
+	for(UINT i = 0; i < mats.size(); ++i)
+	{
+		M3dbMaterial& m = binaryMats[i];
+		ZeroMemory(&m, sizeof(m));
+
+		if( mats[i].EffectTypeName.size() >= sizeof(m.EffectTypeName) ||
+			mats[i].DiffuseMapName.size() >= sizeof(m.DiffuseMapName) ||
+			mats[i].NormalMapName.size() >= sizeof(m.NormalMapName) )
+		{
+			return false;
+		}
+
+		m.Mat       = mats[i].Mat;
+		m.AlphaClip = mats[i].AlphaClip ? 1 : 0;
+
+		// The texture names were widened char by char in ReadMaterials, so narrowing
+		// them the same way gives back the original bytes.
+		std::copy(mats[i].EffectTypeName.begin(), mats[i].EffectTypeName.end(), m.EffectTypeName);
+		for(UINT c = 0; c < mats[i].DiffuseMapName.size(); ++c)
+			m.DiffuseMapName[c] = (char)mats[i].DiffuseMapName[c];
+		for(UINT c = 0; c < mats[i].NormalMapName.size(); ++c)
+			m.NormalMapName[c] = (char)mats[i].NormalMapName[c];
+	}
+
+	return M3dbFile::Write(m3dbFilename, m3dFilename, binaryMats, subsets, vertices, indices,
+		skinInfo.GetBoneOffsets(), skinInfo.GetBoneHierarchy(), skinInfo.GetClips());
+}
+
 void M3DLoader::ReadMaterials(std::ifstream& fin, UINT numMaterials, std::vector<M3dMaterial>& mats)
 {
 	 std::string ignore;
@@ -5,6 +5,7 @@
 #include "LightHelper.h"
 #include "SkinnedData.h"
 #include "Vertex.h"
+#include "M3dBinary.h"
 
 struct M3dMaterial
 {
@@ -30,7 +31,39 @@ public:
 		std::vector<M3dMaterial>& mats,
 		SkinnedData& skinInfo);
 
+	// Same outputs as LoadM3d, read from a memory-mapped binary .m3db file.  If
+	// sourceFilename is given, fails unless the file was converted from it as
+	// it is now, so that a stale companion is not used.
+	bool LoadM3db(const std::string& filename, 
+		std::vector<Vertex::PosNormalTexTan>& vertices,
+		std::vector<USHORT>& indices,
+		std::vector<MeshGeometry::Subset>& subsets,
+		std::vector<M3dMaterial>& mats,
+		const std::string& sourceFilename = std::string());
+	bool LoadM3db(const std::string& filename, 
+		std::vector<Vertex::PosNormalTexTan>& vertices,
+		std::vector<USHORT>& indices,
+		std::vector<MeshGeometry::Subset>& subsets,
+		std::vector<M3dMaterial>& mats,
+		SkinnedData& skinInfo,
+		const std::string& sourceFilename = std::string());
+
+	// Writes the binary .m3db companion of the text .m3d file m3dFilename from
+	// what LoadM3d read from it.
+	bool ConvertM3dToM3db(const std::string& m3dFilename, const std::string& m3dbFilename,
+		const std::vector<Vertex::PosNormalTexTan>& vertices,
+		const std::vector<USHORT>& indices,
+		const std::vector<MeshGeometry::Subset>& subsets,
+		const std::vector<M3dMaterial>& mats,
+		const SkinnedData& skinInfo);
+
 private:
+	void ReadM3dbMeshData(const M3dbFile& file,
+		std::vector<Vertex::PosNormalTexTan>& vertices,
+		std::vector<USHORT>& indices,
+		std::vector<MeshGeometry::Subset>& subsets,
+		std::vector<M3dMaterial>& mats);
+
 	void ReadMaterials(std::ifstream& fin, UINT numMaterials, std::vector<M3dMaterial>& mats);
 	void ReadSubsetTable(std::ifstream& fin, UINT numSubsets, std::vector<MeshGeometry::Subset>& subsets);
 	void ReadVertices(std::ifstream& fin, UINT numVertices, std::vector<Vertex::PosNormalTexTan>& vertices);
@@ -0,0 +1,392 @@
+#include "M3dBinary.h"
+#include <algorithm>
+#include <fstream>
+
+namespace
+{
+	UINT AlignUp(UINT offset)
+	{
+		return (offset + M3DB_SECTION_ALIGNMENT - 1) & ~(M3DB_SECTION_ALIGNMENT - 1);
+	}
+
+	// Record size expected for each section type, indexed by M3dbSectionType.
+	const UINT SectionElementSize[M3dbSection_Count] =
+	{
+		sizeof(M3dbMaterial),
+		sizeof(MeshGeometry::Subset),
+		sizeof(Vertex::PosNormalTexTan),
+		sizeof(USHORT),
+		sizeof(XMFLOAT4X4),
+		sizeof(int),
+		sizeof(M3dbClip),
+		sizeof(M3dbTrack),
+		sizeof(Keyframe)
+	};
+
+	struct PendingSection
+	{
+		M3dbSectionType Type;
+		const void* Data;
+		UINT Count;
+	};
+
+	bool GetSourceStamp(const std::string& filename, UINT64& size, UINT64& writeTime)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if( !GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attributes) )
+			return false;
+
+		size = (UINT64)attributes.nFileSizeHigh << 32 | attributes.nFileSizeLow;
+		writeTime = (UINT64)attributes.ftLastWriteTime.dwHighDateTime << 32 | attributes.ftLastWriteTime.dwLowDateTime;
+		return true;
+	}
+
+	template <size_t N>
+	bool IsTerminated(const char (&name)[N])
+	{
+		return std::find(name, name + N, '\0') != name + N;
+	}
+}
+
+M3dbFile::M3dbFile()
+	: mFile(INVALID_HANDLE_VALUE), mMapping(0), mView(0), mSize(0), mHeader(0)
+{
+	ZeroMemory(mSections, sizeof(mSections));
+}
+
+M3dbFile::~M3dbFile()
+{
+	Close();
+}
+
+bool M3dbFile::Open(const std::string& filename)
+{
+	Close();
+
+	mFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if( mFile == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if( !GetFileSizeEx(mFile, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(M3dbHeader) )
+	{
+		Close();
+		return false;
+	}
+	mSize = (UINT64)fileSize.QuadPart;
+
+	mMapping = CreateFileMappingA(mFile, 0, PAGE_READONLY, 0, 0, 0);
+	if( mMapping == 0 )
+	{
+		Close();
+		return false;
+	}
+
+	mView = reinterpret_cast<const BYTE*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+	if( mView == 0 )
+	{
+		Close();
+		return false;
+	}
+
+	if( !Validate() )
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void M3dbFile::Close()
+{
+	if( mView )
+		UnmapViewOfFile(mView);
+	if( mMapping )
+		CloseHandle(mMapping);
+	if( mFile != INVALID_HANDLE_VALUE )
+		CloseHandle(mFile);
+
+	mFile    = INVALID_HANDLE_VALUE;
+	mMapping = 0;
+	mView    = 0;
+	mSize    = 0;
+	mHeader  = 0;
+	ZeroMemory(mSections, sizeof(mSections));
+}
+
+bool M3dbFile::IsOpen()const
+{
+	return mView != 0;
+}
+
+UINT M3dbFile::BoneCount()const
+{
+	return mHeader ? mHeader->NumBones : 0;
+}
+
+bool M3dbFile::IsConvertedFrom(const std::string& sourceFilename)const
+{
+	UINT64 size = 0;
+	UINT64 writeTime = 0;
+	return mHeader && GetSourceStamp(sourceFilename, size, writeTime) &&
+		mHeader->SourceSize == size && mHeader->SourceWriteTime == writeTime;
+}
+
+bool M3dbFile::Validate()
+{
+	mHeader = reinterpret_cast<const M3dbHeader*>(mView);
+
+	if( mHeader->Magic != M3DB_MAGIC || mHeader->Version != M3DB_VERSION )
+		return false;
+
+	UINT64 tableEnd = sizeof(M3dbHeader) + (UINT64)mHeader->SectionCount*sizeof(M3dbSectionEntry);
+	if( tableEnd > mSize )
+		return false;
+
+	const M3dbSectionEntry* table = reinterpret_cast<const M3dbSectionEntry*>(mView + sizeof(M3dbHeader));
+	for(UINT i = 0; i < mHeader->SectionCount; ++i)
+	{
+		const M3dbSectionEntry& entry = table[i];
+
+		// Skip section types written by a newer minor revision of the format.
+		if( entry.Type >= M3dbSection_Count )
+			continue;
+
+		if( mSections[entry.Type] != 0 )
+			return false; // duplicate section
+
+		if( entry.ElementSize != SectionElementSize[entry.Type] )
+			return false;
+
+		if( entry.Offset % M3DB_SECTION_ALIGNMENT != 0 || entry.Offset < tableEnd )
+			return false;
+
+		if( (UINT64)entry.Offset + (UINT64)entry.Count*entry.ElementSize > mSize )
+			return false;
+
+		mSections[entry.Type] = &entry;
+	}
+
+	//
+	// Cross-check the sections that index into each other so that the spans
+	// handed out later can be used without further bounds checks.
+	//
+
+	UINT numBones = mHeader->NumBones;
+	if( BoneOffsets().Count != numBones || BoneHierarchy().Count != numBones )
+		return false;
+
+	M3dbSpan<int> hierarchy = BoneHierarchy();
+	for(UINT i = 0; i < hierarchy.Count; ++i)
+	{
+		// Parents always precede their children; the root has index 0.
+		if( hierarchy[i] >= (int)i || (i > 0 && hierarchy[i] < 0) )
+			return false;
+	}
+
+	M3dbSpan<M3dbClip> clips = Clips();
+	M3dbSpan<M3dbTrack> tracks = Tracks();
+	M3dbSpan<Keyframe> keyframes = Keyframes();
+	for(UINT i = 0; i < clips.Count; ++i)
+	{
+		if( (UINT64)clips[i].FirstTrack + numBones > tracks.Count )
+			return false;
+		if( !IsTerminated(clips[i].Name) )
+			return false;
+	}
+
+	for(UINT i = 0; i < tracks.Count; ++i)
+	{
+		if( tracks[i].KeyframeCount == 0 )
+			return false;
+		if( (UINT64)tracks[i].FirstKeyframe + tracks[i].KeyframeCount > keyframes.Count )
+			return false;
+	}
+
+	// The loader turns the names into strings.
+	M3dbSpan<M3dbMaterial> mats = Materials();
+	for(UINT i = 0; i < mats.Count; ++i)
+	{
+		if( !IsTerminated(mats[i].EffectTypeName) || !IsTerminated(mats[i].DiffuseMapName) ||
+			!IsTerminated(mats[i].NormalMapName) )
+			return false;
+	}
+
+	UINT vertexCount = Vertices().Count;
+	M3dbSpan<USHORT> indices = Indices();
+	for(UINT i = 0; i < indices.Count; ++i)
+	{
+		if( indices[i] >= vertexCount )
+			return false;
+	}
+
+	M3dbSpan<MeshGeometry::Subset> subsets = Subsets();
+	for(UINT i = 0; i < subsets.Count; ++i)
+	{
+		if( (UINT64)subsets[i].VertexStart + subsets[i].VertexCount > vertexCount )
+			return false;
+		if( ((UINT64)subsets[i].FaceStart + subsets[i].FaceCount)*3 > Indices().Count )
+			return false;
+	}
+
+	return true;
+}
+
+M3dbSpan<M3dbMaterial> M3dbFile::Materials()const
+{
+	return GetSection<M3dbMaterial>(M3dbSection_Materials);
+}
+
+M3dbSpan<MeshGeometry::Subset> M3dbFile::Subsets()const
+{
+	return GetSection<MeshGeometry::Subset>(M3dbSection_Subsets);
+}
+
+M3dbSpan<Vertex::PosNormalTexTan> M3dbFile::Vertices()const
+{
+	return GetSection<Vertex::PosNormalTexTan>(M3dbSection_Vertices);
+}
+
+M3dbSpan<USHORT> M3dbFile::Indices()const
+{
+	return GetSection<USHORT>(M3dbSection_Indices);
+}
+
+M3dbSpan<XMFLOAT4X4> M3dbFile::BoneOffsets()const
+{
+	return GetSection<XMFLOAT4X4>(M3dbSection_BoneOffsets);
+}
+
+M3dbSpan<int> M3dbFile::BoneHierarchy()const
+{
+	return GetSection<int>(M3dbSection_BoneHierarchy);
+}
+
+M3dbSpan<M3dbClip> M3dbFile::Clips()const
+{
+	return GetSection<M3dbClip>(M3dbSection_Clips);
+}
+
+M3dbSpan<M3dbTrack> M3dbFile::Tracks()const
+{
+	return GetSection<M3dbTrack>(M3dbSection_Tracks);
+}
+
+M3dbSpan<Keyframe> M3dbFile::Keyframes()const
+{
+	return GetSection<Keyframe>(M3dbSection_Keyframes);
+}
+
+M3dbSpan<Keyframe> M3dbFile::BoneKeyframes(UINT clipIndex, UINT boneIndex)const
+{
+	const M3dbTrack& track = Tracks()[Clips()[clipIndex].FirstTrack + boneIndex];
+	return M3dbSpan<Keyframe>(Keyframes().Data + track.FirstKeyframe, track.KeyframeCount);
+}
+
+bool M3dbFile::Write(const std::string& filename,
+					 const std::string& sourceFilename,
+					 const std::vector<M3dbMaterial>& mats,
+					 const std::vector<MeshGeometry::Subset>& subsets,
+					 const std::vector<Vertex::PosNormalTexTan>& vertices,
+					 const std::vector<USHORT>& indices,
+					 const std::vector<XMFLOAT4X4>& boneOffsets,
+					 const std::vector<int>& boneHierarchy,
+					 const std::map<std::string, AnimationClip>& animations)
+{
+	UINT numBones = (UINT)boneOffsets.size();
+
+	UINT64 sourceSize = 0;
+	UINT64 sourceWriteTime = 0;
+	if( !GetSourceStamp(sourceFilename, sourceSize, sourceWriteTime) )
+		return false;
+
+	//
+	// Flatten the clips into a clip table, a track table and one keyframe pool.
+	//
+
+	std::vector<M3dbClip> clips;
+	std::vector<M3dbTrack> tracks;
+	std::vector<Keyframe> keyframes;
+
+	for(auto it = animations.begin(); it != animations.end(); ++it)
+	{
+		if( it->first.size() >= sizeof(M3dbClip().Name) || it->second.BoneAnimations.size() != numBones )
+			return false;
+
+		M3dbClip clip;
+		ZeroMemory(&clip, sizeof(clip));
+		std::copy(it->first.begin(), it->first.end(), clip.Name);
+		clip.FirstTrack = (UINT)tracks.size();
+		clips.push_back(clip);
+
+		for(UINT boneIndex = 0; boneIndex < numBones; ++boneIndex)
+		{
+			const std::vector<Keyframe>& boneKeys = it->second.BoneAnimations[boneIndex].Keyframes;
+
+			M3dbTrack track;
+			track.FirstKeyframe = (UINT)keyframes.size();
+			track.KeyframeCount = (UINT)boneKeys.size();
+			tracks.push_back(track);
+
+			keyframes.insert(keyframes.end(), boneKeys.begin(), boneKeys.end());
+		}
+	}
+
+	PendingSection sections[M3dbSection_Count] =
+	{
+		{ M3dbSection_Materials,     mats.empty()          ? 0 : &mats[0],          (UINT)mats.size() },
+		{ M3dbSection_Subsets,       subsets.empty()       ? 0 : &subsets[0],       (UINT)subsets.size() },
+		{ M3dbSection_Vertices,      vertices.empty()      ? 0 : &vertices[0],      (UINT)vertices.size() },
+		{ M3dbSection_Indices,       indices.empty()       ? 0 : &indices[0],       (UINT)indices.size() },
+		{ M3dbSection_BoneOffsets,   boneOffsets.empty()   ? 0 : &boneOffsets[0],   (UINT)boneOffsets.size() },
+		{ M3dbSection_BoneHierarchy, boneHierarchy.empty() ? 0 : &boneHierarchy[0], (UINT)boneHierarchy.size() },
+		{ M3dbSection_Clips,         clips.empty()         ? 0 : &clips[0],         (UINT)clips.size() },
+		{ M3dbSection_Tracks,        tracks.empty()        ? 0 : &tracks[0],        (UINT)tracks.size() },
+		{ M3dbSection_Keyframes,     keyframes.empty()     ? 0 : &keyframes[0],     (UINT)keyframes.size() }
+	};
+
+	M3dbHeader header;
+	ZeroMemory(&header, sizeof(header));
+	header.Magic           = M3DB_MAGIC;
+	header.Version         = M3DB_VERSION;
+	header.SectionCount    = M3dbSection_Count;
+	header.NumBones        = numBones;
+	header.SourceSize      = sourceSize;
+	header.SourceWriteTime = sourceWriteTime;
+
+	M3dbSectionEntry table[M3dbSection_Count];
+	UINT offset = AlignUp(sizeof(M3dbHeader) + sizeof(table));
+	for(UINT i = 0; i < M3dbSection_Count; ++i)
+	{
+		table[i].Type        = sections[i].Type;
+		table[i].ElementSize = SectionElementSize[sections[i].Type];
+		table[i].Count       = sections[i].Count;
+		table[i].Offset      = offset;
+
+		offset = AlignUp(offset + table[i].ElementSize*table[i].Count);
+	}
+
+	std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+	if( !fout )
+		return false;
+
+	fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	fout.write(reinterpret_cast<const char*>(table), sizeof(table));
+
+	const char padding[M3DB_SECTION_ALIGNMENT] = { 0 };
+	UINT written = sizeof(header) + sizeof(table);
+	for(UINT i = 0; i < M3dbSection_Count; ++i)
+	{
+		fout.write(padding, table[i].Offset - written);
+
+		UINT size = table[i].ElementSize*table[i].Count;
+		if( size > 0 )
+			fout.write(reinterpret_cast<const char*>(sections[i].Data), size);
+
+		written = table[i].Offset + size;
+	}
+
+	return fout.good();
+}
@@ -0,0 +1,174 @@
+#ifndef M3DBINARY_H
+#define M3DBINARY_H
+
+#include "MeshGeometry.h"
+#include "LightHelper.h"
+#include "SkinnedData.h"
+#include "Vertex.h"
+
+///<summary>
+/// Binary companion of the text .m3d format.  The file is a fixed header,
+/// followed by a table of sections, followed by the section payloads.  Every
+/// payload is a tightly packed array of one of the record types below, so a
+/// mapped view of the file can be read in place without parsing.
+///
+///   M3dbHeader
+///   M3dbSectionEntry[SectionCount]
+///   payloads (each aligned to M3DB_SECTION_ALIGNMENT)
+///</summary>
+
+#define M3DB_MAGIC             0x4244334D // 'M' '3' 'D' 'B' read as a little-endian UINT
+#define M3DB_VERSION           2
+#define M3DB_SECTION_ALIGNMENT 16
+
+enum M3dbSectionType
+{
+	M3dbSection_Materials     = 0,
+	M3dbSection_Subsets       = 1,
+	M3dbSection_Vertices      = 2,
+	M3dbSection_Indices       = 3,
+	M3dbSection_BoneOffsets   = 4,
+	M3dbSection_BoneHierarchy = 5,
+	M3dbSection_Clips         = 6,
+	M3dbSection_Tracks        = 7,
+	M3dbSection_Keyframes     = 8,
+	M3dbSection_Count
+};
+
+struct M3dbHeader
+{
+	UINT Magic;
+	UINT Version;
+	UINT SectionCount;
+	UINT Flags;       // Reserved, always 0.
+	UINT NumBones;
+	UINT Reserved;
+
+	// Size and last write time (a FILETIME) of the .m3d file this was
+	// converted from; the .m3db is stale once they no longer match.
+	UINT64 SourceSize;
+	UINT64 SourceWriteTime;
+};
+
+struct M3dbSectionEntry
+{
+	UINT Type;        // One of M3dbSectionType.
+	UINT ElementSize; // sizeof the record stored in the payload.
+	UINT Count;       // Number of records.
+	UINT Offset;      // Byte offset of the payload from the start of the file.
+};
+
+struct M3dbMaterial
+{
+	Material Mat;
+	UINT AlphaClip;
+	char EffectTypeName[32];
+	char DiffuseMapName[96];
+	char NormalMapName[96];
+};
+
+struct M3dbClip
+{
+	char Name[64];
+	UINT FirstTrack; // Index of the clip's first bone track; a clip owns NumBones tracks.
+};
+
+struct M3dbTrack
+{
+	UINT FirstKeyframe;
+	UINT KeyframeCount;
+};
+
+///<summary>
+/// Read-only view over an array that lives inside a mapped .m3db file.
+///</summary>
+template <typename T>
+struct M3dbSpan
+{
+	M3dbSpan() : Data(0), Count(0) {}
+	M3dbSpan(const T* data, UINT count) : Data(data), Count(count) {}
+
+	const T& operator[](UINT i)const { return Data[i]; }
+	const T* begin()const { return Data; }
+	const T* end()const { return Data + Count; }
+	bool empty()const { return Count == 0; }
+
+	const T* Data;
+	UINT Count;
+};
+
+///<summary>
+/// Memory maps a .m3db file and hands out zero-copy spans over its sections.
+/// Nothing is copied or parsed on Open() besides the header and the section
+/// table; the OS pages a section in the first time it is touched.
+///</summary>
+class M3dbFile
+{
+public:
+	M3dbFile();
+	~M3dbFile();
+
+	// Maps the file and validates the header and section table.  Returns false
+	// if the file is missing, truncated, of another version or inconsistent.
+	bool Open(const std::string& filename);
+	void Close();
+
+	bool IsOpen()const;
+	UINT BoneCount()const;
+
+	// True if the file was converted from sourceFilename as it is now.
+	bool IsConvertedFrom(const std::string& sourceFilename)const;
+
+	M3dbSpan<M3dbMaterial> Materials()const;
+	M3dbSpan<MeshGeometry::Subset> Subsets()const;
+	M3dbSpan<Vertex::PosNormalTexTan> Vertices()const;
+	M3dbSpan<USHORT> Indices()const;
+	M3dbSpan<XMFLOAT4X4> BoneOffsets()const;
+	M3dbSpan<int> BoneHierarchy()const;
+	M3dbSpan<M3dbClip> Clips()const;
+	M3dbSpan<M3dbTrack> Tracks()const;
+	M3dbSpan<Keyframe> Keyframes()const;
+
+	// Keyframes of the given bone in the given clip.
+	M3dbSpan<Keyframe> BoneKeyframes(UINT clipIndex, UINT boneIndex)const;
+
+	// Writes the file, stamped with the size and write time of sourceFilename.
+	static bool Write(const std::string& filename, const std::string& sourceFilename,
+		const std::vector<M3dbMaterial>& mats,
+		const std::vector<MeshGeometry::Subset>& subsets,
+		const std::vector<Vertex::PosNormalTexTan>& vertices,
+		const std::vector<USHORT>& indices,
+		const std::vector<XMFLOAT4X4>& boneOffsets,
+		const std::vector<int>& boneHierarchy,
+		const std::map<std::string, AnimationClip>& animations);
+
+private:
+	M3dbFile(const M3dbFile& rhs);
+	M3dbFile& operator=(const M3dbFile& rhs);
+
+	bool Validate();
+
+	template <typename T>
+	M3dbSpan<T> GetSection(M3dbSectionType type)const;
+
+private:
+	HANDLE mFile;
+	HANDLE mMapping;
+	const BYTE* mView;
+	UINT64 mSize;
+
+	const M3dbHeader* mHeader;
+	const M3dbSectionEntry* mSections[M3dbSection_Count];
+};
+
+template <typename T>
+M3dbSpan<T> M3dbFile::GetSection(M3dbSectionType type)const
+{
+	const M3dbSectionEntry* entry = mSections[type];
+	if( entry == 0 )
+		return M3dbSpan<T>();
+
+	return M3dbSpan<T>(reinterpret_cast<const T*>(mView + entry->Offset), entry->Count);
+}
+
+#endif // M3DBINARY_H
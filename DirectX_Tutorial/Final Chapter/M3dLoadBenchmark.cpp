@@ -0,0 +1,216 @@
+//***************************************************************************************
+// M3dLoadBenchmark.cpp
+//
+// Headless benchmark of M3DLoader::LoadM3db, which reads the memory-mapped
+// binary companion of a model, against LoadM3d, which parses the text .m3d.
+// The companion is written next to the model first (as SkinnedModel does the
+// first time it loads one).  For each model it reports
+//   -the sizes of the two files,
+//   -milliseconds to write the companion,
+//   -milliseconds per load of the text file and of the companion, and the
+//    speedup.
+// The OS file cache is warm for both after the first load, so the times are
+// those of parsing and copying, not of the disk.
+//
+// Both loads must give the same vertices, indices, subsets, materials, bones
+// and clips, and the companion must be rejected once it no longer matches the
+// model.  Returns 1 if any model fails that or cannot be read.
+//
+// Build with the DXUT Core directory on the include path, as for the demo:
+//   cl /EHsc /O2 LoadM3d.cpp M3dBinary.cpp SkinnedData.cpp CompressedAnimation.cpp
+//      MathHelper.cpp M3dLoadBenchmark.cpp
+//
+// Usage: M3dLoadBenchmark [repeats [model.m3d ...]]
+//        (default 10 Models/soldier.m3d)
+//***************************************************************************************
+
+#include "LoadM3d.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	struct LoadedModel
+	{
+		std::vector<Vertex::PosNormalTexTan> Vertices;
+		std::vector<USHORT> Indices;
+		std::vector<MeshGeometry::Subset> Subsets;
+		std::vector<M3dMaterial> Mats;
+		SkinnedData Skin;
+	};
+
+	UINT64 FileSize(const std::string& filename)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if( !GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attributes) )
+			return 0;
+		return (UINT64)attributes.nFileSizeHigh << 32 | attributes.nFileSizeLow;
+	}
+
+	bool SameKeyframes(const std::vector<Keyframe>& a, const std::vector<Keyframe>& b)
+	{
+		if( a.size() != b.size() )
+			return false;
+
+		for(size_t i = 0; i < a.size(); ++i)
+		{
+			if( a[i].TimePos != b[i].TimePos ||
+				memcmp(&a[i].Translation, &b[i].Translation, sizeof(XMFLOAT3)) != 0 ||
+				memcmp(&a[i].Scale, &b[i].Scale, sizeof(XMFLOAT3)) != 0 ||
+				memcmp(&a[i].RotationQuat, &b[i].RotationQuat, sizeof(XMFLOAT4)) != 0 )
+				return false;
+		}
+		return true;
+	}
+
+	bool SameModel(const LoadedModel& a, const LoadedModel& b)
+	{
+		if( a.Vertices.size() != b.Vertices.size() || a.Indices != b.Indices ||
+			a.Subsets.size() != b.Subsets.size() || a.Mats.size() != b.Mats.size() )
+			return false;
+
+		if( !a.Vertices.empty() &&
+			memcmp(&a.Vertices[0], &b.Vertices[0], a.Vertices.size()*sizeof(a.Vertices[0])) != 0 )
+			return false;
+
+		for(size_t i = 0; i < a.Subsets.size(); ++i)
+		{
+			if( a.Subsets[i].VertexStart != b.Subsets[i].VertexStart || a.Subsets[i].VertexCount != b.Subsets[i].VertexCount ||
+				a.Subsets[i].FaceStart != b.Subsets[i].FaceStart || a.Subsets[i].FaceCount != b.Subsets[i].FaceCount )
+				return false;
+		}
+
+		for(size_t i = 0; i < a.Mats.size(); ++i)
+		{
+			if( memcmp(&a.Mats[i].Mat, &b.Mats[i].Mat, sizeof(Material)) != 0 || a.Mats[i].AlphaClip != b.Mats[i].AlphaClip ||
+				a.Mats[i].EffectTypeName != b.Mats[i].EffectTypeName || a.Mats[i].DiffuseMapName != b.Mats[i].DiffuseMapName ||
+				a.Mats[i].NormalMapName != b.Mats[i].NormalMapName )
+				return false;
+		}
+
+		const std::vector<XMFLOAT4X4>& offsetsA = a.Skin.GetBoneOffsets();
+		const std::vector<XMFLOAT4X4>& offsetsB = b.Skin.GetBoneOffsets();
+		if( a.Skin.GetBoneHierarchy() != b.Skin.GetBoneHierarchy() || offsetsA.size() != offsetsB.size() ||
+			(!offsetsA.empty() && memcmp(&offsetsA[0], &offsetsB[0], offsetsA.size()*sizeof(XMFLOAT4X4)) != 0) )
+			return false;
+
+		const std::map<std::string, AnimationClip>& clipsA = a.Skin.GetClips();
+		const std::map<std::string, AnimationClip>& clipsB = b.Skin.GetClips();
+		if( clipsA.size() != clipsB.size() )
+			return false;
+
+		for(auto it = clipsA.begin(); it != clipsA.end(); ++it)
+		{
+			auto other = clipsB.find(it->first);
+			if( other == clipsB.end() || other->second.BoneAnimations.size() != it->second.BoneAnimations.size() )
+				return false;
+
+			for(size_t bone = 0; bone < it->second.BoneAnimations.size(); ++bone)
+			{
+				if( !SameKeyframes(it->second.BoneAnimations[bone].Keyframes, other->second.BoneAnimations[bone].Keyframes) )
+					return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	UINT repeats = argc > 1 ? (UINT)max(1, atoi(argv[1])) : 10;
+
+	std::vector<std::string> filenames;
+	for(int i = 2; i < argc; ++i)
+		filenames.push_back(argv[i]);
+	if( filenames.empty() )
+		filenames.push_back("Models/soldier.m3d");
+
+	printf("%-24s %10s %10s %10s %10s %10s %8s %8s\n", "model", "text KB", "binary KB", "write ms",
+		"text ms", "binary ms", "speedup", "failed");
+
+	M3DLoader loader;
+	bool passed = true;
+
+	for(size_t f = 0; f < filenames.size(); ++f)
+	{
+		const std::string& filename = filenames[f];
+		std::string binaryFilename = filename + "b";
+
+		LoadedModel text;
+		if( !loader.LoadM3d(filename, text.Vertices, text.Indices, text.Subsets, text.Mats, text.Skin) ||
+			text.Vertices.empty() )
+		{
+			printf("cannot read %s\n", filename.c_str());
+			passed = false;
+			continue;
+		}
+
+		double start = Now();
+		bool valid = loader.ConvertM3dToM3db(filename, binaryFilename, text.Vertices, text.Indices, text.Subsets,
+			text.Mats, text.Skin);
+		double writeTime = Now() - start;
+
+		start = Now();
+		for(UINT r = 0; r < repeats; ++r)
+		{
+			LoadedModel model;
+			loader.LoadM3d(filename, model.Vertices, model.Indices, model.Subsets, model.Mats, model.Skin);
+		}
+		double textTime = (Now() - start) / repeats;
+
+		LoadedModel binary;
+		start = Now();
+		for(UINT r = 0; r < repeats && valid; ++r)
+		{
+			LoadedModel model;
+			valid = loader.LoadM3db(binaryFilename, model.Vertices, model.Indices, model.Subsets, model.Mats,
+				model.Skin, filename);
+			if( r == 0 )
+				binary = model;
+		}
+		double binaryTime = (Now() - start) / repeats;
+
+		valid = valid && SameModel(text, binary);
+
+		// A companion older than its model must be refused.
+		if( valid )
+		{
+			HANDLE file = CreateFileA(filename.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, 0, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL, 0);
+			FILETIME fileTime, later;
+			if( file != INVALID_HANDLE_VALUE && GetFileTime(file, 0, 0, &fileTime) )
+			{
+				later = fileTime;
+				later.dwLowDateTime += 10000000; // a second later
+				if( later.dwLowDateTime < fileTime.dwLowDateTime )
+					++later.dwHighDateTime;
+
+				LoadedModel stale;
+				SetFileTime(file, 0, 0, &later);
+				valid = !loader.LoadM3db(binaryFilename, stale.Vertices, stale.Indices, stale.Subsets, stale.Mats,
+					stale.Skin, filename);
+				SetFileTime(file, 0, 0, &fileTime);
+			}
+			if( file != INVALID_HANDLE_VALUE )
+				CloseHandle(file);
+		}
+
+		if( !valid )
+			passed = false;
+
+		printf("%-24s %10.0f %10.0f %10.2f %10.2f %10.2f %8.1f %8s\n", filename.c_str(), FileSize(filename)/1024.0,
+			FileSize(binaryFilename)/1024.0, writeTime*1000.0, textTime*1000.0, binaryTime*1000.0,
+			textTime/binaryTime, valid ? "" : "yes");
+	}
+
+	printf("\n%s\n", passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
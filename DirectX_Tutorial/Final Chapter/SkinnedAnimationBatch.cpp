@@ -0,0 +1,242 @@
+#include "SkinnedAnimationBatch.h"
+#include "../Common/JobSystem.h"
+#include <algorithm>
+
+namespace
+{
+	const XMVECTORU32 SignMask = { 0x80000000, 0x80000000, 0x80000000, 0x80000000 };
+
+	// XMQuaternionSlerp falls back to a lerp once the quaternions are this close.
+	const XMVECTORF32 OneMinusEpsilon = { 1.0f - 0.00001f, 1.0f - 0.00001f, 1.0f - 0.00001f, 1.0f - 0.00001f };
+
+	XMVECTOR LoadChannel(const SoaAnimationClip& clip, UINT k, SoaAnimationClip::Channel c, UINT firstBone)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(clip.GetChannel(k, c) + firstBone));
+	}
+
+	XMVECTOR LerpChannel(const SoaAnimationClip& clip, UINT k0, UINT k1, SoaAnimationClip::Channel c,
+		UINT firstBone, FXMVECTOR lerpPercent)
+	{
+		XMVECTOR v0 = LoadChannel(clip, k0, c, firstBone);
+		XMVECTOR v1 = LoadChannel(clip, k1, c, firstBone);
+		return XMVectorLerpV(v0, v1, lerpPercent);
+	}
+
+	void StoreRow(XMFLOAT4X4* transforms, UINT row, FXMMATRIX rows)
+	{
+		for(UINT j = 0; j < 4; ++j)
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(transforms[j].m[row]), rows.r[j]);
+	}
+}
+
+SkinnedAnimationBatch::SkinnedAnimationBatch()
+	: mScratch(1)
+{
+}
+
+SkinnedAnimationBatch::~SkinnedAnimationBatch()
+{
+}
+
+void SkinnedAnimationBatch::Update(SkinnedModelInstance* const* instances, UINT count, float dt)
+{
+	for(UINT i = 0; i < count; ++i)
+		UpdateInstance(*instances[i], dt, mScratch[0]);
+}
+
+void SkinnedAnimationBatch::Update(JobSystem& jobSystem, SkinnedModelInstance* const* instances, UINT count, float dt)
+{
+	if( mScratch.size() < jobSystem.ThreadCount() )
+		mScratch.resize(jobSystem.ThreadCount());
+
+	// A skeleton takes a few microseconds, so hand out a handful per job.
+	jobSystem.ParallelFor(0, count, 4, [&](UINT first, UINT last)
+	{
+		Scratch& scratch = mScratch[JobSystem::ThreadIndex()];
+		for(UINT i = first; i < last; ++i)
+			UpdateInstance(*instances[i], dt, scratch);
+	});
+}
+
+void SkinnedAnimationBatch::UpdateInstance(SkinnedModelInstance& instance, float dt, Scratch& scratch)
+{
+	const SkinnedData& skinnedData = instance.Model->SkinnedData;
+	const SoaAnimationClip* clip = skinnedData.GetSoaClip(instance.ClipName);
+
+	// Compressed clips have no SoA copy; let the instance decode its own pose.
+	if( clip == 0 )
+	{
+		instance.Update(dt);
+		return;
+	}
+
+	instance.TimePos += dt;
+	Evaluate(skinnedData, *clip, instance.TimePos, &instance.FinalTransforms[0], scratch);
+
+	// Loop animation
+	if( instance.TimePos > clip->EndTime )
+		instance.TimePos = 0.0f;
+}
+
+void SkinnedAnimationBatch::Evaluate(const SkinnedData& skinnedData, const SoaAnimationClip& clip,
+									 float timePos, XMFLOAT4X4* finalTransforms)
+{
+	Evaluate(skinnedData, clip, timePos, finalTransforms, mScratch[0]);
+}
+
+void SkinnedAnimationBatch::Evaluate(const SkinnedData& skinnedData, const SoaAnimationClip& clip,
+									 float timePos, XMFLOAT4X4* finalTransforms, Scratch& scratch)
+{
+	UINT numBones = clip.BoneCount;
+	if( numBones == 0 )
+		return;
+
+	SampleToParentTransforms(clip, timePos, scratch);
+
+	//
+	// Traverse the hierarchy and transform all the bones to the root space, then
+	// premultiply by the bone offset transform.  Parents precede their children,
+	// so one pass does both.
+	//
+
+	const std::vector<int>& boneHierarchy = skinnedData.GetBoneHierarchy();
+	const std::vector<XMFLOAT4X4>& boneOffsets = skinnedData.GetBoneOffsets();
+
+	std::vector<XMFLOAT4X4>& toParentTransforms = scratch.ToParentTransforms;
+	std::vector<XMFLOAT4X4>& toRootTransforms = scratch.ToRootTransforms;
+
+	for(UINT i = 0; i < numBones; ++i)
+	{
+		XMMATRIX toRoot = XMLoadFloat4x4(&toParentTransforms[i]);
+		if( i > 0 )
+		{
+			XMMATRIX parentToRoot = XMLoadFloat4x4(&toRootTransforms[boneHierarchy[i]]);
+			toRoot = XMMatrixMultiply(toRoot, parentToRoot);
+		}
+		XMStoreFloat4x4(&toRootTransforms[i], toRoot);
+
+		XMMATRIX offset = XMLoadFloat4x4(&boneOffsets[i]);
+		XMStoreFloat4x4(&finalTransforms[i], XMMatrixMultiply(offset, toRoot));
+	}
+}
+
+void SkinnedAnimationBatch::SampleToParentTransforms(const SoaAnimationClip& clip, float timePos, Scratch& scratch)
+{
+	if( scratch.ToParentTransforms.size() < clip.PaddedBoneCount )
+	{
+		scratch.ToParentTransforms.resize(clip.PaddedBoneCount);
+		scratch.ToRootTransforms.resize(clip.PaddedBoneCount);
+	}
+
+	//
+	// One key search for the whole skeleton.  Before the first key and after the
+	// last one the pose is clamped, as in BoneAnimation::Interpolate.
+	//
+
+	const std::vector<float>& times = clip.Times;
+
+	UINT k0 = 0;
+	UINT k1 = 0;
+	float percent = 0.0f;
+	if( timePos >= times.back() )
+	{
+		k0 = k1 = times.size() - 1;
+	}
+	else if( timePos > times.front() )
+	{
+		k1 = std::upper_bound(times.begin(), times.end(), timePos) - times.begin();
+		k0 = k1 - 1;
+		percent = (timePos - times[k0]) / (times[k1] - times[k0]);
+	}
+
+	XMVECTOR lerpPercent = XMVectorReplicate(percent);
+	XMVECTOR oneMinusPercent = XMVectorReplicate(1.0f - percent);
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR zero = XMVectorZero();
+
+	for(UINT i = 0; i < clip.PaddedBoneCount; i += 4)
+	{
+		XMVECTOR px = LerpChannel(clip, k0, k1, SoaAnimationClip::TranslationX, i, lerpPercent);
+		XMVECTOR py = LerpChannel(clip, k0, k1, SoaAnimationClip::TranslationY, i, lerpPercent);
+		XMVECTOR pz = LerpChannel(clip, k0, k1, SoaAnimationClip::TranslationZ, i, lerpPercent);
+
+		XMVECTOR sx = LerpChannel(clip, k0, k1, SoaAnimationClip::ScaleX, i, lerpPercent);
+		XMVECTOR sy = LerpChannel(clip, k0, k1, SoaAnimationClip::ScaleY, i, lerpPercent);
+		XMVECTOR sz = LerpChannel(clip, k0, k1, SoaAnimationClip::ScaleZ, i, lerpPercent);
+
+		//
+		// Slerp the rotations of four bones, following XMQuaternionSlerp: take
+		// the shortest arc and fall back to a lerp for nearly equal quaternions.
+		//
+
+		XMVECTOR q0x = LoadChannel(clip, k0, SoaAnimationClip::RotationX, i);
+		XMVECTOR q0y = LoadChannel(clip, k0, SoaAnimationClip::RotationY, i);
+		XMVECTOR q0z = LoadChannel(clip, k0, SoaAnimationClip::RotationZ, i);
+		XMVECTOR q0w = LoadChannel(clip, k0, SoaAnimationClip::RotationW, i);
+
+		XMVECTOR q1x = LoadChannel(clip, k1, SoaAnimationClip::RotationX, i);
+		XMVECTOR q1y = LoadChannel(clip, k1, SoaAnimationClip::RotationY, i);
+		XMVECTOR q1z = LoadChannel(clip, k1, SoaAnimationClip::RotationZ, i);
+		XMVECTOR q1w = LoadChannel(clip, k1, SoaAnimationClip::RotationW, i);
+
+		XMVECTOR cosOmega = q0x*q1x + q0y*q1y + q0z*q1z + q0w*q1w;
+		XMVECTOR sign = XMVectorAndInt(cosOmega, SignMask);
+		cosOmega = XMVectorXorInt(cosOmega, sign);
+
+		XMVECTOR sinOmega = XMVectorSqrt(XMVectorMax(one - cosOmega*cosOmega, zero));
+		XMVECTOR omega = XMVectorATan2(sinOmega, cosOmega);
+		XMVECTOR invSinOmega = XMVectorReciprocal(sinOmega);
+
+		XMVECTOR useSlerp = XMVectorLess(cosOmega, OneMinusEpsilon);
+		XMVECTOR s0 = XMVectorSelect(oneMinusPercent, XMVectorSin(oneMinusPercent*omega)*invSinOmega, useSlerp);
+		XMVECTOR s1 = XMVectorSelect(lerpPercent, XMVectorSin(lerpPercent*omega)*invSinOmega, useSlerp);
+		s1 = XMVectorXorInt(s1, sign);
+
+		XMVECTOR qx = q0x*s0 + q1x*s1;
+		XMVECTOR qy = q0y*s0 + q1y*s1;
+		XMVECTOR qz = q0z*s0 + q1z*s1;
+		XMVECTOR qw = q0w*s0 + q1w*s1;
+
+		//
+		// Build S*R*T (XMMatrixAffineTransformation with a zero rotation origin)
+		// for four bones, one matrix element per register.
+		//
+
+		XMVECTOR xx = qx*qx, yy = qy*qy, zz = qz*qz;
+		XMVECTOR xy = qx*qy, xz = qx*qz, yz = qy*qz;
+		XMVECTOR xw = qx*qw, yw = qy*qw, zw = qz*qw;
+
+		XMVECTOR two = one + one;
+
+		XMMATRIX row0;
+		row0.r[0] = sx*(one - two*(yy + zz));
+		row0.r[1] = sx*two*(xy + zw);
+		row0.r[2] = sx*two*(xz - yw);
+		row0.r[3] = zero;
+
+		XMMATRIX row1;
+		row1.r[0] = sy*two*(xy - zw);
+		row1.r[1] = sy*(one - two*(xx + zz));
+		row1.r[2] = sy*two*(yz + xw);
+		row1.r[3] = zero;
+
+		XMMATRIX row2;
+		row2.r[0] = sz*two*(xz + yw);
+		row2.r[1] = sz*two*(yz - xw);
+		row2.r[2] = sz*(one - two*(xx + yy));
+		row2.r[3] = zero;
+
+		XMMATRIX row3;
+		row3.r[0] = px;
+		row3.r[1] = py;
+		row3.r[2] = pz;
+		row3.r[3] = one;
+
+		// Transposing turns the element-per-register layout into one row per bone.
+		XMFLOAT4X4* toParent = &scratch.ToParentTransforms[i];
+		StoreRow(toParent, 0, XMMatrixTranspose(row0));
+		StoreRow(toParent, 1, XMMatrixTranspose(row1));
+		StoreRow(toParent, 2, XMMatrixTranspose(row2));
+		StoreRow(toParent, 3, XMMatrixTranspose(row3));
+	}
+}
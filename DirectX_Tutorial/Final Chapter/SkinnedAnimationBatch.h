@@ -0,0 +1,55 @@
+#ifndef SKINNEDANIMATIONBATCH_H
+#define SKINNEDANIMATIONBATCH_H
+
+#include "SkinnedModel.h"
+
+class JobSystem;
+
+///<summary>
+/// Evaluates the pose of many SkinnedModelInstances per call.  Keyframes are
+/// read from the SoaAnimationClip that SkinnedData builds for each clip, and
+/// the bones are interpolated four at a time in SIMD registers.  The scratch
+/// buffers are kept between calls and only grow, so once they have seen the
+/// largest skeleton an update does not allocate.  Each job system thread gets
+/// its own scratch buffers.
+///</summary>
+class SkinnedAnimationBatch
+{
+public:
+	SkinnedAnimationBatch();
+	~SkinnedAnimationBatch();
+
+	// Same as calling SkinnedModelInstance::Update(dt) on every instance: advances
+	// TimePos, writes FinalTransforms and loops the clip once it has finished.
+	// Every instance's FinalTransforms must already hold BoneCount() matrices.
+	void Update(SkinnedModelInstance* const* instances, UINT count, float dt);
+
+	// Same as above, with the instances spread over the job system's threads.
+	void Update(JobSystem& jobSystem, SkinnedModelInstance* const* instances, UINT count, float dt);
+
+	// Writes the final transforms of the skeleton at the given time; the same
+	// result as SkinnedData::GetFinalTransforms.
+	void Evaluate(const SkinnedData& skinnedData, const SoaAnimationClip& clip,
+		float timePos, XMFLOAT4X4* finalTransforms);
+
+private:
+	SkinnedAnimationBatch(const SkinnedAnimationBatch& rhs);
+	SkinnedAnimationBatch& operator=(const SkinnedAnimationBatch& rhs);
+
+	struct Scratch
+	{
+		std::vector<XMFLOAT4X4> ToParentTransforms;
+		std::vector<XMFLOAT4X4> ToRootTransforms;
+	};
+
+	void UpdateInstance(SkinnedModelInstance& instance, float dt, Scratch& scratch);
+	void Evaluate(const SkinnedData& skinnedData, const SoaAnimationClip& clip,
+		float timePos, XMFLOAT4X4* finalTransforms, Scratch& scratch);
+	void SampleToParentTransforms(const SoaAnimationClip& clip, float timePos, Scratch& scratch);
+
+private:
+	// One per job system thread; the first is also used without a job system.
+	std::vector<Scratch> mScratch;
+};
+
+#endif // SKINNEDANIMATIONBATCH_H
@@ -2,6 +2,7 @@
 
 #include "SkinnedData.h"
 #include "MeshGeometry.h"
+#include <algorithm>
 
 Keyframe::Keyframe()
 	: TimePos(0.0f),
@@ -15,6 +16,11 @@ Keyframe::~Keyframe()
 {
 }
  
+BoneAnimation::BoneAnimation()
+	: SampleRate(0.0f)
+{
+}
+
 float BoneAnimation::GetStartTime()const
 {
 	// Keyframes are sorted by time, so first keyframe gives start time.
@@ -31,52 +37,104 @@ float BoneAnimation::GetEndTime()const
 
 void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M)const
 {
-	if( t <= Keyframes.front().TimePos )
+	UINT cursor = 0;
+	Interpolate(t, cursor, M);
+}
+
+void BoneAnimation::Interpolate(float t, UINT& cursor, XMFLOAT4X4& M)const
+{
+	XMVECTOR S, P, Q;
+	Sample(t, cursor, S, P, Q);
+
+	XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+}
+
+UINT BoneAnimation::FindKey(float t, UINT cursor)const
+{
+	UINT lastKey = Keyframes.size() - 2;
+
+	if( SampleRate > 0.0f )
 	{
-		XMVECTOR S = XMLoadFloat3(&Keyframes.front().Scale);
-		XMVECTOR P = XMLoadFloat3(&Keyframes.front().Translation);
-		XMVECTOR Q = XMLoadFloat4(&Keyframes.front().RotationQuat);
+		UINT i = (UINT)((t - Keyframes.front().TimePos) * SampleRate);
+		return i < lastKey ? i : lastKey;
+	}
+
+	// Try the cursor's key and the one after it before searching.
+	if( cursor <= lastKey && Keyframes[cursor].TimePos <= t )
+	{
+		if( t < Keyframes[cursor+1].TimePos )
+			return cursor;
+		if( cursor+1 <= lastKey && t < Keyframes[cursor+2].TimePos )
+			return cursor+1;
+	}
+
+	auto key = std::upper_bound(Keyframes.begin(), Keyframes.end(), t,
+		[](float time, const Keyframe& k) { return time < k.TimePos; });
+
+	UINT i = (UINT)(key - Keyframes.begin()) - 1;
+	return i < lastKey ? i : lastKey;
+}
 
-		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+void BoneAnimation::Sample(float t, UINT& cursor, XMVECTOR& S, XMVECTOR& P, XMVECTOR& Q)const
+{
+	if( t <= Keyframes.front().TimePos )
+	{
+		S = XMLoadFloat3(&Keyframes.front().Scale);
+		P = XMLoadFloat3(&Keyframes.front().Translation);
+		Q = XMLoadFloat4(&Keyframes.front().RotationQuat);
 	}
 	else if( t >= Keyframes.back().TimePos )
 	{
-		XMVECTOR S = XMLoadFloat3(&Keyframes.back().Scale);
-		XMVECTOR P = XMLoadFloat3(&Keyframes.back().Translation);
-		XMVECTOR Q = XMLoadFloat4(&Keyframes.back().RotationQuat);
-
-		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+		S = XMLoadFloat3(&Keyframes.back().Scale);
+		P = XMLoadFloat3(&Keyframes.back().Translation);
+		Q = XMLoadFloat4(&Keyframes.back().RotationQuat);
 	}
 	else
 	{
-		for(UINT i = 0; i < Keyframes.size()-1; ++i)
-		{
-			if( t >= Keyframes[i].TimePos && t <= Keyframes[i+1].TimePos )
-			{
-				float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i+1].TimePos - Keyframes[i].TimePos);
+		UINT i = FindKey(t, cursor);
+		cursor = i;
+
+		float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i+1].TimePos - Keyframes[i].TimePos);
+
+		XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
+		XMVECTOR s1 = XMLoadFloat3(&Keyframes[i+1].Scale);
 
-				XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
-				XMVECTOR s1 = XMLoadFloat3(&Keyframes[i+1].Scale);
+		XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
+		XMVECTOR p1 = XMLoadFloat3(&Keyframes[i+1].Translation);
 
-				XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
-				XMVECTOR p1 = XMLoadFloat3(&Keyframes[i+1].Translation);
+		XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
+		XMVECTOR q1 = XMLoadFloat4(&Keyframes[i+1].RotationQuat);
 
-				XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
-				XMVECTOR q1 = XMLoadFloat4(&Keyframes[i+1].RotationQuat);
+		S = XMVectorLerp(s0, s1, lerpPercent);
+		P = XMVectorLerp(p0, p1, lerpPercent);
+		Q = XMQuaternionSlerp(q0, q1, lerpPercent);
+	}
+}
 
-				XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
-				XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
-				XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
+BoneAnimation BoneAnimation::ResampleUniform(float startTime, float endTime, UINT keyCount)const
+{
+	BoneAnimation result;
+	result.Keyframes.resize(keyCount);
 
-				XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-				XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+	float spacing = (endTime - startTime) / (keyCount - 1);
+	result.SampleRate = spacing > 0.0f ? 1.0f / spacing : 0.0f;
 
-				break;
-			}
-		}
+	UINT cursor = 0;
+	for(UINT i = 0; i < keyCount; ++i)
+	{
+		Keyframe& key = result.Keyframes[i];
+		key.TimePos = i + 1 < keyCount ? startTime + i*spacing : endTime;
+
+		XMVECTOR S, P, Q;
+		Sample(key.TimePos, cursor, S, P, Q);
+
+		XMStoreFloat3(&key.Scale, S);
+		XMStoreFloat3(&key.Translation, P);
+		XMStoreFloat4(&key.RotationQuat, Q);
 	}
+
+	return result;
 }
 
 float AnimationClip::GetClipStartTime()const
@@ -111,14 +169,155 @@ void AnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms
 	}
 }
 
+void AnimationClip::Interpolate(float t, std::vector<UINT>& cursors, std::vector<XMFLOAT4X4>& boneTransforms)const
+{
+	for(UINT i = 0; i < BoneAnimations.size(); ++i)
+	{
+		BoneAnimations[i].Interpolate(t, cursors[i], boneTransforms[i]);
+	}
+}
+
+AnimationClip AnimationClip::ResampleUniform(float sampleRate)const
+{
+	float startTime = GetClipStartTime();
+	float endTime = GetClipEndTime();
+
+	// Round up so the keys are at most 1/sampleRate apart.
+	UINT keyCount = (UINT)ceilf((endTime - startTime) * sampleRate) + 1;
+	keyCount = MathHelper::Max(keyCount, 2u);
+
+	AnimationClip result;
+	result.BoneAnimations.resize(BoneAnimations.size());
+	for(UINT i = 0; i < BoneAnimations.size(); ++i)
+	{
+		result.BoneAnimations[i] = BoneAnimations[i].ResampleUniform(startTime, endTime, keyCount);
+	}
+
+	return result;
+}
+
+void SoaAnimationClip::Build(const AnimationClip& clip)
+{
+	BoneCount = clip.BoneAnimations.size();
+	PaddedBoneCount = (BoneCount + 3) & ~3;
+	EndTime = BoneCount > 0 ? clip.GetClipEndTime() : 0.0f;
+
+	// The shared timeline is the union of every bone's key times.
+	Times.clear();
+	for(UINT i = 0; i < BoneCount; ++i)
+	{
+		const std::vector<Keyframe>& keys = clip.BoneAnimations[i].Keyframes;
+		for(UINT j = 0; j < keys.size(); ++j)
+			Times.push_back(keys[j].TimePos);
+	}
+	std::sort(Times.begin(), Times.end());
+	Times.erase(std::unique(Times.begin(), Times.end()), Times.end());
+
+	UINT keyStride = ChannelCount*PaddedBoneCount;
+	Data.assign(Times.size()*keyStride, 0.0f);
+
+	for(UINT k = 0; k < Times.size(); ++k)
+	{
+		float* key = &Data[k*keyStride];
+
+		// Padding lanes hold an identity transform so the SIMD path never
+		// sees garbage.
+		for(UINT i = BoneCount; i < PaddedBoneCount; ++i)
+		{
+			key[ScaleX*PaddedBoneCount + i] = 1.0f;
+			key[ScaleY*PaddedBoneCount + i] = 1.0f;
+			key[ScaleZ*PaddedBoneCount + i] = 1.0f;
+			key[RotationW*PaddedBoneCount + i] = 1.0f;
+		}
+	}
+
+	for(UINT i = 0; i < BoneCount; ++i)
+	{
+		const std::vector<Keyframe>& keys = clip.BoneAnimations[i].Keyframes;
+
+		UINT seg = 0;
+		for(UINT k = 0; k < Times.size(); ++k)
+		{
+			float t = Times[k];
+
+			XMFLOAT3 scale;
+			XMFLOAT3 translation;
+			XMFLOAT4 rotation;
+
+			// Same clamping and interpolation as BoneAnimation::Interpolate.
+			if( t <= keys.front().TimePos || t >= keys.back().TimePos )
+			{
+				const Keyframe& key = t <= keys.front().TimePos ? keys.front() : keys.back();
+				scale       = key.Scale;
+				translation = key.Translation;
+				rotation    = key.RotationQuat;
+			}
+			else
+			{
+				while( keys[seg+1].TimePos < t )
+					++seg;
+
+				if( keys[seg+1].TimePos == t )
+				{
+					scale       = keys[seg+1].Scale;
+					translation = keys[seg+1].Translation;
+					rotation    = keys[seg+1].RotationQuat;
+				}
+				else
+				{
+					float lerpPercent = (t - keys[seg].TimePos) / (keys[seg+1].TimePos - keys[seg].TimePos);
+
+					XMVECTOR s0 = XMLoadFloat3(&keys[seg].Scale);
+					XMVECTOR s1 = XMLoadFloat3(&keys[seg+1].Scale);
+
+					XMVECTOR p0 = XMLoadFloat3(&keys[seg].Translation);
+					XMVECTOR p1 = XMLoadFloat3(&keys[seg+1].Translation);
+
+					XMVECTOR q0 = XMLoadFloat4(&keys[seg].RotationQuat);
+					XMVECTOR q1 = XMLoadFloat4(&keys[seg+1].RotationQuat);
+
+					XMStoreFloat3(&scale, XMVectorLerp(s0, s1, lerpPercent));
+					XMStoreFloat3(&translation, XMVectorLerp(p0, p1, lerpPercent));
+					XMStoreFloat4(&rotation, XMQuaternionSlerp(q0, q1, lerpPercent));
+				}
+			}
+
+			float* key = &Data[k*keyStride];
+			key[TranslationX*PaddedBoneCount + i] = translation.x;
+			key[TranslationY*PaddedBoneCount + i] = translation.y;
+			key[TranslationZ*PaddedBoneCount + i] = translation.z;
+			key[ScaleX*PaddedBoneCount + i]       = scale.x;
+			key[ScaleY*PaddedBoneCount + i]       = scale.y;
+			key[ScaleZ*PaddedBoneCount + i]       = scale.z;
+			key[RotationX*PaddedBoneCount + i]    = rotation.x;
+			key[RotationY*PaddedBoneCount + i]    = rotation.y;
+			key[RotationZ*PaddedBoneCount + i]    = rotation.z;
+			key[RotationW*PaddedBoneCount + i]    = rotation.w;
+		}
+	}
+}
+
+const float* SoaAnimationClip::GetChannel(UINT k, Channel c)const
+{
+	return &Data[(k*ChannelCount + c)*PaddedBoneCount];
+}
+
 float SkinnedData::GetClipStartTime(const std::string& clipName)const
 {
+	auto compressed = mCompressedAnimations.find(clipName);
+	if( compressed != mCompressedAnimations.end() )
+		return compressed->second.GetClipStartTime();
+
 	auto clip = mAnimations.find(clipName);
 	return clip->second.GetClipStartTime();
 }
 
 float SkinnedData::GetClipEndTime(const std::string& clipName)const
 {
+	auto compressed = mCompressedAnimations.find(clipName);
+	if( compressed != mCompressedAnimations.end() )
+		return compressed->second.GetClipEndTime();
+
 	auto clip = mAnimations.find(clipName);
 	return clip->second.GetClipEndTime();
 }
@@ -128,6 +327,39 @@ UINT SkinnedData::BoneCount()const
 	return mBoneHierarchy.size();
 }
 
+const std::vector<int>& SkinnedData::GetBoneHierarchy()const
+{
+	return mBoneHierarchy;
+}
+
+const std::vector<XMFLOAT4X4>& SkinnedData::GetBoneOffsets()const
+{
+	return mBoneOffsets;
+}
+
+const std::map<std::string, AnimationClip>& SkinnedData::GetClips()const
+{
+	return mAnimations;
+}
+
+const AnimationClip* SkinnedData::GetClip(const std::string& clipName)const
+{
+	auto clip = mAnimations.find(clipName);
+	return clip != mAnimations.end() ? &clip->second : 0;
+}
+
+const CompressedAnimationClip* SkinnedData::GetCompressedClip(const std::string& clipName)const
+{
+	auto clip = mCompressedAnimations.find(clipName);
+	return clip != mCompressedAnimations.end() ? &clip->second : 0;
+}
+
+const SoaAnimationClip* SkinnedData::GetSoaClip(const std::string& clipName)const
+{
+	auto clip = mSoaAnimations.find(clipName);
+	return clip != mSoaAnimations.end() ? &clip->second : 0;
+}
+
 void SkinnedData::Set(std::vector<int>& boneHierarchy, 
 		              std::vector<XMFLOAT4X4>& boneOffsets,
 		              std::map<std::string, AnimationClip>& animations)
@@ -135,6 +367,39 @@ void SkinnedData::Set(std::vector<int>& boneHierarchy,
 	mBoneHierarchy = boneHierarchy;
 	mBoneOffsets   = boneOffsets;
 	mAnimations    = animations;
+
+	mCompressedAnimations.clear();
+	BuildSoaClips();
+}
+
+void SkinnedData::ResampleClips(float sampleRate)
+{
+	for(auto it = mAnimations.begin(); it != mAnimations.end(); ++it)
+	{
+		it->second = it->second.ResampleUniform(sampleRate);
+	}
+
+	BuildSoaClips();
+}
+
+void SkinnedData::CompressClips(const AnimationCompressionSettings& settings)
+{
+	for(auto it = mAnimations.begin(); it != mAnimations.end(); ++it)
+	{
+		mCompressedAnimations[it->first].Compress(it->second, settings);
+	}
+
+	mAnimations.clear();
+	mSoaAnimations.clear();
+}
+
+void SkinnedData::BuildSoaClips()
+{
+	mSoaAnimations.clear();
+	for(auto it = mAnimations.begin(); it != mAnimations.end(); ++it)
+	{
+		mSoaAnimations[it->first].Build(it->second);
+	}
 }
  
 void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos,  std::vector<XMFLOAT4X4>& finalTransforms)const
@@ -144,8 +409,51 @@ void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos,
 	std::vector<XMFLOAT4X4> toParentTransforms(numBones);
 
 	// Interpolate all the bones of this clip at the given time instance.
-	auto clip = mAnimations.find(clipName);
-	clip->second.Interpolate(timePos, toParentTransforms);
+	auto compressed = mCompressedAnimations.find(clipName);
+	if( compressed != mCompressedAnimations.end() )
+	{
+		compressed->second.Interpolate(timePos, toParentTransforms);
+	}
+	else
+	{
+		auto clip = mAnimations.find(clipName);
+		clip->second.Interpolate(timePos, toParentTransforms);
+	}
+
+	ToFinalTransforms(toParentTransforms, finalTransforms);
+}
+
+void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos, 
+	std::vector<UINT>& cursors, std::vector<XMFLOAT4X4>& finalTransforms)const
+{
+	UINT numBones = mBoneOffsets.size();
+
+	std::vector<XMFLOAT4X4> toParentTransforms(numBones);
+
+	if( cursors.size() != numBones )
+		cursors.assign(numBones, 0);
+
+	// Interpolate all the bones of this clip at the given time instance.  The
+	// tracks of a compressed clip each have their own keys, so it does its own
+	// key search instead of using the cursors.
+	auto compressed = mCompressedAnimations.find(clipName);
+	if( compressed != mCompressedAnimations.end() )
+	{
+		compressed->second.Interpolate(timePos, toParentTransforms);
+	}
+	else
+	{
+		auto clip = mAnimations.find(clipName);
+		clip->second.Interpolate(timePos, cursors, toParentTransforms);
+	}
+
+	ToFinalTransforms(toParentTransforms, finalTransforms);
+}
+
+void SkinnedData::ToFinalTransforms(const std::vector<XMFLOAT4X4>& toParentTransforms, 
+	std::vector<XMFLOAT4X4>& finalTransforms)const
+{
+	UINT numBones = mBoneOffsets.size();
 
 	//
 	// Traverse the hierarchy and transform all the bones to the root space.
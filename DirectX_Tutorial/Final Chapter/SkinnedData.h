@@ -5,6 +5,7 @@
 #include <map>
 #include <string>
 #include "MathHelper.h"
+#include "CompressedAnimation.h"
 
 using namespace DirectX;
 
@@ -31,13 +32,36 @@ struct Keyframe
 ///</summary>
 struct BoneAnimation
 {
+	BoneAnimation();
+
 	float GetStartTime()const;
 	float GetEndTime()const;
 
     void Interpolate(float t, XMFLOAT4X4& M)const;
 
+	// Same as above, but the key search starts at cursor, the key the previous
+	// sample of this track landed on, and cursor is updated.  Playback moves
+	// forward at most a key or two per frame, so that costs a couple of
+	// comparisons; seeks fall back to a binary search.
+	void Interpolate(float t, UINT& cursor, XMFLOAT4X4& M)const;
+
+	// Returns this track sampled at keyCount evenly spaced times from
+	// startTime to endTime.
+	BoneAnimation ResampleUniform(float startTime, float endTime, UINT keyCount)const;
+
 	std::vector<Keyframe> Keyframes; 	
 
+	// Keys per second if the keys are evenly spaced (see ResampleUniform), in
+	// which case the key for a time is found directly; 0 otherwise.
+	float SampleRate;
+
+	// Interpolated scale, translation and rotation at time t; cursor is used as
+	// in Interpolate.
+	void Sample(float t, UINT& cursor, XMVECTOR& S, XMVECTOR& P, XMVECTOR& Q)const;
+
+private:
+	// Index i of the keys with Keyframes[i].TimePos <= t < Keyframes[i+1].TimePos.
+	UINT FindKey(float t, UINT cursor)const;
 };
 
 ///<summary>
@@ -52,9 +76,49 @@ struct AnimationClip
 
     void Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms)const;
 
+	// cursors holds one key cursor per bone; see BoneAnimation::Interpolate.
+	void Interpolate(float t, std::vector<UINT>& cursors, std::vector<XMFLOAT4X4>& boneTransforms)const;
+
+	// Returns this clip with every bone track baked to sampleRate evenly
+	// spaced keys per second over the clip's time range.
+	AnimationClip ResampleUniform(float sampleRate)const;
+
     std::vector<BoneAnimation> BoneAnimations; 	
 };
 
+///<summary>
+/// Structure-of-arrays copy of an AnimationClip for SkinnedAnimationBatch.
+/// Every bone is resampled onto the union of all the bones' key times, so a
+/// single key search serves the whole skeleton.  For each key, a channel is
+/// stored contiguously over the bones (padded to a multiple of four), so four
+/// bones load into one SIMD register.
+///
+/// Inserting keys on a linear/spherical segment does not change the curve,
+/// so sampling this clip matches AnimationClip::Interpolate.
+///</summary>
+struct SoaAnimationClip
+{
+	enum Channel
+	{
+		TranslationX, TranslationY, TranslationZ,
+		ScaleX, ScaleY, ScaleZ,
+		RotationX, RotationY, RotationZ, RotationW,
+		ChannelCount
+	};
+
+	void Build(const AnimationClip& clip);
+
+	// Returns channel c of key k for bones [0, PaddedBoneCount).
+	const float* GetChannel(UINT k, Channel c)const;
+
+	UINT BoneCount;
+	UINT PaddedBoneCount;
+	float EndTime;
+
+	std::vector<float> Times;
+	std::vector<float> Data; // [key][channel][bone]
+};
+
 class SkinnedData
 {
 public:
@@ -64,6 +128,18 @@ public:
 	float GetClipStartTime(const std::string& clipName)const;
 	float GetClipEndTime(const std::string& clipName)const;
 
+	const std::vector<int>& GetBoneHierarchy()const;
+	const std::vector<XMFLOAT4X4>& GetBoneOffsets()const;
+
+	// Returns null if there is no uncompressed clip with the given name.
+	const AnimationClip* GetClip(const std::string& clipName)const;
+
+	// The uncompressed clips by name.
+	const std::map<std::string, AnimationClip>& GetClips()const;
+
+	// Returns null if there is no clip with the given name.
+	const SoaAnimationClip* GetSoaClip(const std::string& clipName)const;
+
 	void Set(
 		std::vector<int>& boneHierarchy, 
 		std::vector<XMFLOAT4X4>& boneOffsets,
@@ -75,6 +151,27 @@ public:
     void GetFinalTransforms(const std::string& clipName, float timePos, 
 		 std::vector<XMFLOAT4X4>& finalTransforms)const;
 
+	// Same as above, with per-bone key cursors kept by the caller between
+	// frames.  cursors is resized to BoneCount() if needed.
+    void GetFinalTransforms(const std::string& clipName, float timePos, 
+		 std::vector<UINT>& cursors, std::vector<XMFLOAT4X4>& finalTransforms)const;
+
+	// Bakes every clip to evenly spaced keys so that key lookup is O(1).
+	void ResampleClips(float sampleRate);
+
+	// Replaces every clip with a CompressedAnimationClip.  GetFinalTransforms then
+	// decodes the compressed clips, and GetSoaClip returns null for them.
+	void CompressClips(const AnimationCompressionSettings& settings);
+
+	// Returns null if there is no compressed clip with the given name.
+	const CompressedAnimationClip* GetCompressedClip(const std::string& clipName)const;
+
+private:
+	void BuildSoaClips();
+
+	void ToFinalTransforms(const std::vector<XMFLOAT4X4>& toParentTransforms,
+		std::vector<XMFLOAT4X4>& finalTransforms)const;
+
 private:
     // Gives parentIndex of ith bone.
 	std::vector<int> mBoneHierarchy;
@@ -82,6 +179,12 @@ private:
 	std::vector<XMFLOAT4X4> mBoneOffsets;
    
 	std::map<std::string, AnimationClip> mAnimations;
+
+	// Built from mAnimations in Set() for batched sampling.
+	std::map<std::string, SoaAnimationClip> mSoaAnimations;
+
+	// Clips moved out of mAnimations by CompressClips().
+	std::map<std::string, CompressedAnimationClip> mCompressedAnimations;
 };
  
 #endif // SKINNEDDATA_H
\ No newline at end of file
@@ -5,7 +5,16 @@ SkinnedModel::SkinnedModel(ID3D11Device* device, TextureMgr& texMgr, const std::
 {
 	std::vector<M3dMaterial> mats;
 	M3DLoader m3dLoader;
-	m3dLoader.LoadM3d(modelFilename, Vertices, Indices, Subsets, mats, SkinnedData);
+
+	// Prefer the memory-mapped binary companion (soldier.m3d -> soldier.m3db).  The
+	// first time a model is loaded, or after the text file changed, we parse the
+	// text file and write the companion.
+	std::string binaryFilename = modelFilename + "b";
+	if( !m3dLoader.LoadM3db(binaryFilename, Vertices, Indices, Subsets, mats, SkinnedData, modelFilename) )
+	{
+		if( m3dLoader.LoadM3d(modelFilename, Vertices, Indices, Subsets, mats, SkinnedData) )
+			m3dLoader.ConvertM3dToM3db(modelFilename, binaryFilename, Vertices, Indices, Subsets, mats, SkinnedData);
+	}
 
 	ModelMesh.SetVertices(device, &Vertices[0], Vertices.size());
 	ModelMesh.SetIndices(device, &Indices[0], Indices.size());
@@ -32,7 +41,7 @@ SkinnedModel::~SkinnedModel()
 void SkinnedModelInstance::Update(float dt)
 {
 	TimePos += dt;
-	Model->SkinnedData.GetFinalTransforms(ClipName, TimePos, FinalTransforms);
+	Model->SkinnedData.GetFinalTransforms(ClipName, TimePos, KeyframeCursors, FinalTransforms);
 
 	// Loop animation
 	if(TimePos > Model->SkinnedData.GetClipEndTime(ClipName))
@@ -36,6 +36,9 @@ struct SkinnedModelInstance
 	XMFLOAT4X4 World;
 	std::vector<XMFLOAT4X4> FinalTransforms;
 
+	// Per-bone key cursors so sampling resumes where the last frame left off.
+	std::vector<UINT> KeyframeCursors;
+
 	void Update(float dt);
 };
 